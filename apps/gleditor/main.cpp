@@ -7,10 +7,13 @@
  * on this library takes belong to the library -- see gleditor/app.hpp -- which
  * is what keeps this file to the part that is actually about editing.
  */
+#include <cstdint>
 #include <cstdlib>
 #include <exception>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -20,10 +23,13 @@
 
 #include <gleditor/android_bootstrap.hpp>
 #include <gleditor/app.hpp>
+#include <gleditor/doc.hpp>
 #include <gleditor/render/types.hpp>
+#include <gleditor/render_state.hpp>
 #include <gleditor/renderer.hpp>
 #include <gleditor/sdl_compat.hpp>
 #include <gleditor/state.hpp>
+#include <gleditor/text_search.hpp>
 
 // On every other platform this program's own main() is the process entry
 // point. On Android it is not: SDL_main.h renames it and SDL's Java Activity
@@ -53,10 +59,61 @@ bool wantsEveryOption(const int argc, const char *const *const argv) {
   return false;
 }
 
+/// Which way a key steps through the hits of --find.
+enum class HitStep : std::uint8_t { next, previous, nextPage };
+
+/**
+ * @brief Select the hit a step from the caret reaches.
+ *
+ * The caret's document is searched first if it is not the one being searched
+ * already, so the first press in a document starts its search. Render thread,
+ * which is the only one that may read a document.
+ */
+void stepToHit(RenderState &renderState, AbstractRenderer &renderer,
+               gleditor::TextSearch &search,
+               const gleditor::SearchPattern &pattern, const HitStep step) {
+  auto *const caret = renderer.editCaret();
+  if (nullptr == caret || renderState.docs.empty()) {
+    return;
+  }
+  const auto which = caret->documentIndex() < renderState.docs.size()
+                         ? caret->documentIndex()
+                         : 0U;
+  const auto &doc = renderState.docs[which];
+  if (search.document() != doc) {
+    search.search(doc, pattern);
+  }
+  const auto from = caret->byteOffset();
+  std::optional<gleditor::SearchHit> hit;
+  switch (step) {
+  case HitStep::next:
+    hit = search.nextHit(from);
+    break;
+  case HitStep::previous:
+    hit = search.previousHit(from);
+    break;
+  case HitStep::nextPage:
+    // The first hit on the next page that has any.
+    if (const auto anchor = doc->anchorFor(from)) {
+      if (const auto found = search.nextPageWithHit(anchor->pageIndex)) {
+        hit = found->hit;
+      }
+    }
+    break;
+  }
+  if (hit) {
+    caret->placeAt(which, hit->start);
+    caret->anchorSelection();
+    caret->extendTo(hit->end);
+  }
+}
+
 /// Bind the keys this program answers to. The camera controls come from the
 /// library, since they are about the view rather than about editing.
 void bindCommands(gleditor::Application &app, const AppStateRef &state,
-                  const RendererRef &renderer) {
+                  const RendererRef &renderer,
+                  const std::shared_ptr<gleditor::TextSearch> &search,
+                  const std::optional<gleditor::SearchPattern> &pattern) {
   app.bindDefaultViewCommands();
   app.commands().bind(SDL_SCANCODE_Q, "quit", "close the editor",
                       [state] { state->alive = false; });
@@ -76,6 +133,44 @@ void bindCommands(gleditor::Application &app, const AppStateRef &state,
   app.commands().bind(SDL_SCANCODE_S, Mod::Ctrl, "save",
                       "write the most recently opened document back to disk",
                       [renderer] { renderer->push(RenderItemSaveDoc()); });
+  // Ctrl as well. Queued as typing is, so however long the clipboard is it
+  // reaches the document as one insertion -- which, past a megabyte, is
+  // paginated off the render thread; see Doc::insert().
+  app.commands().bind(SDL_SCANCODE_V, Mod::Ctrl, "paste",
+                      "insert the clipboard's text at the caret", [state] {
+                        char *const clipboard = SDL_GetClipboardText();
+                        if (nullptr == clipboard) {
+                          return;
+                        }
+                        {
+                          const std::lock_guard locker(state->typedMutex);
+                          state->typedText += clipboard;
+                        }
+                        SDL_free(clipboard);
+                      });
+
+  if (!pattern) {
+    return;
+  }
+  // Ctrl for the same reason as save. The hits are found and drawn without
+  // any key; these only move the caret between them.
+  const auto stepping = [renderer, search, pattern](const HitStep step) {
+    return [renderer, search, pattern, step] {
+      renderer->runWithState(
+          [renderer, search, pattern, step](RenderState &renderState) {
+            stepToHit(renderState, *renderer, *search, *pattern, step);
+          });
+    };
+  };
+  app.commands().bind(SDL_SCANCODE_G, Mod::Ctrl, "next hit",
+                      "select the next place --find was found",
+                      stepping(HitStep::next));
+  app.commands().bind(SDL_SCANCODE_G, Mod::Ctrl | Mod::Shift, "previous hit",
+                      "select the previous place --find was found",
+                      stepping(HitStep::previous));
+  app.commands().bind(SDL_SCANCODE_G, Mod::Ctrl | Mod::Alt, "next page of hits",
+                      "select the first hit on the next page with any",
+                      stepping(HitStep::nextPage));
 }
 
 } // namespace
@@ -91,6 +186,12 @@ int main(const int argc, char **argv) {
 
   argparse::ArgumentParser parser("gleditor", TOSTRING(GLEDITOR_VERSION));
   gleditor::addCommonArguments(parser, detailed);
+  parser.add_argument("--find").help(
+      "highlight every place this text is found, and bind ctrl-g to step "
+      "between them");
+  parser.add_argument("--find-regex")
+      .help("take --find as a regular expression, matched a line at a time")
+      .flag();
   parser.add_argument("files").help("input files").remaining();
 
   // Answered before parse_args, because a request for help is the whole of
@@ -103,11 +204,22 @@ int main(const int argc, char **argv) {
 
   render::Backend backend = render::Backend::OpenGL;
   RendererRef renderer;
+  std::optional<gleditor::SearchPattern> pattern;
+  const auto search = std::make_shared<gleditor::TextSearch>();
   try {
     parser.parse_args(argc, argv);
     backend  = gleditor::applyCommonArguments(parser, state, argc, argv);
     renderer = Renderer::create(state, backend);
 
+    // Compiled here, so that an expression that is not one is reported with
+    // the usage rather than the first time somebody presses a key.
+    if (const auto find = parser.present("--find"); find && !find->empty()) {
+      pattern = parser["--find-regex"] == true
+                    ? gleditor::SearchPattern::expression(*find)
+                    : gleditor::SearchPattern::literal(*find);
+      renderer->addSpanDecorator(search.get());
+    }
+
     // Which SDL this binary was built against is not something the command line
     // can change, and a bug report is much easier to read with it stated.
     // Suppressed for --print-asset-dir, whose whole output is one path a script
@@ -140,7 +252,7 @@ int main(const int argc, char **argv) {
 
   try {
     gleditor::Application app(state, renderer, backend, "GL Editor");
-    bindCommands(app, state, renderer);
+    bindCommands(app, state, renderer, search, pattern);
     return app.run();
   } catch (const std::exception &err) {
     std::cerr << "Error: " << err.what() << "\n";
@@ -250,8 +250,7 @@ public:
       if (!where.hasRange) {
         return;
       }
-      state.docs[where.doc]->erase(state, where.start, where.end - where.start,
-                                   caret);
+      state.docs[where.doc]->erase(where.start, where.end - where.start, caret);
     });
   }
 
@@ -537,7 +537,8 @@ void HypertimeMap::drawFrame(gleditor::FrameContext &ctx) {
   // re-uploading, so it is done when something changed rather than per frame.
   const auto opCount = session.store().opCount();
   if (opCount != builtForOps || current != builtForCurrent ||
-      !builtForVisible || ctx.screenHeight != builtForHeight) {
+      !builtForVisible || ctx.screenHeight != builtForHeight ||
+      canvas->glyphsMoved(ctx.state.glyphCache)) {
     builtForOps     = opCount;
     builtForCurrent = current;
     builtForVisible = true;
@@ -189,6 +189,25 @@ public:
    */
   void trim();
 
+  /**
+   * @brief Move allocations out of the way of the free room in the middle of
+   *        the buffer, then trim.
+   *
+   * A trim can only give back the end of the buffer, which is enough after a
+   * load and not after pages scattered through a document have given their
+   * rows back: the room is there, but in holes between allocations still in
+   * use. Allocations are names rather than places, so the ones nearest the
+   * end can be moved into the holes nearest the start -- a copy each -- until
+   * the free room has collected at the end where a trim can reach it.
+   *
+   * Only an allocation that fits a hole before it wholly is moved, so no copy
+   * overlaps itself, and none is moved further back. Meant to be run now and
+   * again, after a batch of releases, not after each one.
+   *
+   * @return Allocations moved.
+   */
+  std::uint32_t compact();
+
   /**
    * @brief Write rows into an allocation.
    * @param allocation Run to write into.
@@ -198,6 +217,21 @@ public:
   void write(const Allocation &allocation, std::uint32_t firstRow,
              std::span<const std::byte> data);
 
+  /**
+   * @brief Write part of one row, leaving the rest of it as it is.
+   *
+   * For a holder changing a field or two of rows it no longer keeps a copy
+   * of: each patch is an upload of its own, so it is for a few fields of
+   * scattered rows, not for rewriting them.
+   *
+   * @param allocation Run to write into.
+   * @param row Row index within the allocation.
+   * @param offset Byte offset within the row.
+   * @param data Bytes to write; must not run past the row.
+   */
+  void patch(const Allocation &allocation, std::uint32_t row,
+             std::size_t offset, std::span<const std::byte> data);
+
   /**
    * @brief Byte offset of an allocation within the buffer, as it is now.
    *
@@ -31,8 +31,10 @@
 #include <glm/ext/matrix_float4x4.hpp>
 
 #include <gleditor/buffer_pool.hpp>
+#include <gleditor/glyphcache/citation.hpp>
 #include <gleditor/render/types.hpp>
 
+class GlyphCache;
 struct RenderState;
 
 namespace render {
@@ -91,6 +93,16 @@ public:
   /// rebuilding a canvas whose contents changed.
   void clear();
 
+  /**
+   * @brief Whether the glyph cache has repacked its atlas since this canvas's
+   *        text was laid out.
+   *
+   * The glyphs are still there -- the canvas cites them -- but not where its
+   * rows say, so a canvas whose owner finds this true wants rebuilding as
+   * though its contents had changed.
+   */
+  [[nodiscard]] bool glyphsMoved(const GlyphCache &glyphs) const;
+
   /**
    * @brief Identity written into every primitive added from here on.
    *
@@ -193,6 +205,10 @@ private:
   /// document model and is not worth dragging into this header.
   std::vector<std::byte> rows;
   std::uint32_t pendingInstances{};
+  /// Every glyph the text added since clear() draws.
+  GlyphCitation citation;
+  /// GlyphCache::repacks() when the first of them was asked for.
+  std::uint64_t glyphsAt{};
 };
 
 } // namespace gleditor
@@ -0,0 +1,161 @@
+/**
+ * @file cluster_table.hpp
+ * @brief A page's clusters, kept in a fraction of the memory a box each took.
+ *
+ * Every page holds a table of its clusters for as long as the document is
+ * open -- it is what turns a picked glyph back into a place in the text, and
+ * a selection into the glyphs to tint -- and it used to be a ClusterBox per
+ * cluster: twelve bytes for every glyph of the document, more than the text.
+ *
+ * Nearly all of it is the same few numbers. Almost every cluster is one byte
+ * and one character long, or two or three bytes and one character in a
+ * script that is not Latin, and each starts where the one before it ended. So
+ * the table is held as runs: so many clusters of this length in bytes and in
+ * characters, three bytes a run, in blocks of a fixed number of clusters with
+ * the offset each block starts at. A page of English is a few runs a block,
+ * well under a byte a cluster.
+ *
+ * Finding cluster N is finding its block and walking that block's runs, which
+ * is bounded by the block size rather than by the page. Finding the clusters
+ * a range of bytes covers is a binary search on the blocks' offsets first.
+ * A cluster that does not fit a run -- longer than a byte can count, or not
+ * starting where the one before ended -- is held whole, off to the side.
+ */
+#ifndef GLEDITOR_CLUSTER_TABLE_H
+#define GLEDITOR_CLUSTER_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace gleditor {
+
+/**
+ * @brief One shaped cluster of the page's text.
+ *
+ * A cluster is Pango's unit of indivisible shaping: a ligature such as "ffi",
+ * a base letter with its combining marks, or an emoji sequence is one cluster
+ * drawn as one quad, while covering several characters of the text. Hit
+ * testing has to know both, which is why the byte range and the character
+ * count are kept rather than assuming one quad is one character.
+ *
+ * A cluster covering no bytes at all is room a paragraph has been left to grow
+ * into; see PageParagraph::clusterRoom.
+ */
+struct ClusterBox {
+  /// Byte offset of the cluster within the page's own text.
+  std::uint32_t byteStart{};
+  /// Length of the cluster in bytes.
+  std::uint32_t byteLength{};
+  /// Characters the cluster covers. Greater than one for a ligature, which is
+  /// what makes a click inside the quad ambiguous without interpolation.
+  std::uint32_t charCount{};
+
+  friend bool operator==(const ClusterBox &, const ClusterBox &) = default;
+};
+
+/// Memory cluster tables hold, against what a box a cluster would, for a
+/// report.
+struct ClusterMemory {
+  std::size_t held{};
+  std::size_t asBoxes{};
+};
+
+/**
+ * @brief A page's ClusterBoxes, held as runs in blocks.
+ *
+ * Read as the boxes it was made from, one at a time or all together; the
+ * encoding is never seen from outside.
+ */
+class ClusterTable {
+public:
+  /// Clusters a block holds, and so the most runs finding one has to walk.
+  static constexpr std::uint32_t blockClusters = 64;
+
+  ClusterTable() = default;
+  explicit ClusterTable(std::span<const ClusterBox> boxes);
+
+  [[nodiscard]] std::size_t size() const { return count; }
+  [[nodiscard]] bool empty() const { return 0 == count; }
+
+  /// Cluster @p index, which must be less than size().
+  [[nodiscard]] ClusterBox operator[](std::size_t index) const;
+
+  /// Every cluster, as the boxes the table was made from.
+  [[nodiscard]] std::vector<ClusterBox> boxes() const;
+
+  /**
+   * @brief The first and last clusters holding any byte of [@p from, @p to).
+   *
+   * Room, which holds no bytes, is never either. Logarithmic in the page when
+   * the clusters are in text order and do not overlap, which is how Pango
+   * hands them over; a table that is not is searched from end to end.
+   */
+  [[nodiscard]] std::optional<std::pair<std::size_t, std::size_t>>
+  covering(std::uint32_t from, std::uint32_t to) const;
+
+  /**
+   * @brief Put @p fresh in place of the clusters from @p first on, as many as
+   *        it holds, and move every cluster after them by @p shift bytes.
+   *
+   * Only the blocks @p fresh lands in are encoded again; those after it only
+   * have their offsets moved.
+   */
+  void replace(std::size_t first, std::span<const ClusterBox> fresh,
+               std::int32_t shift);
+
+  /// Memory the table holds, for a report.
+  [[nodiscard]] std::size_t memoryBytes() const;
+
+private:
+  /// So many clusters of one length, each starting where the last ended. A
+  /// count of zero is one cluster held in `loose` instead.
+  struct Run {
+    std::uint8_t count{};
+    std::uint8_t byteLength{};
+    std::uint8_t charCount{};
+  };
+  /// A cluster no run could hold, by index, where it starts counted from its
+  /// block's start so that moving the block moves it too.
+  struct Loose {
+    std::uint32_t index{};
+    std::int64_t fromBlock{};
+    std::uint32_t byteLength{};
+    std::uint32_t charCount{};
+  };
+
+  std::vector<Run> runs;
+  /// Where each block's first cluster starts, and its first run.
+  std::vector<std::uint32_t> blockStarts;
+  std::vector<std::uint32_t> blockRuns;
+  /// By index.
+  std::vector<Loose> loose;
+  std::size_t count{};
+  /// Neighbouring clusters where one starts before the last has ended: the
+  /// table is in text order, and can be searched, while there are none.
+  std::size_t disorder{};
+
+  [[nodiscard]] std::size_t blocks() const { return blockStarts.size(); }
+  /// Runs of block @p block, as [first, end).
+  [[nodiscard]] std::pair<std::size_t, std::size_t>
+  runsOf(std::size_t block) const;
+  /// Clusters of blocks [@p first, @p end).
+  [[nodiscard]] std::vector<ClusterBox> decode(std::size_t first,
+                                               std::size_t end) const;
+  /// What encode() makes of some whole blocks, to be spliced in.
+  struct Encoded;
+  /// Encode @p boxes, the whole of the blocks from cluster @p firstIndex on.
+  [[nodiscard]] static Encoded encode(std::size_t firstIndex,
+                                      std::span<const ClusterBox> boxes);
+  /// Neighbours out of order among @p boxes.
+  [[nodiscard]] static std::size_t
+  disorderOf(std::span<const ClusterBox> boxes);
+};
+
+} // namespace gleditor
+
+#endif // GLEDITOR_CLUSTER_TABLE_H
+// vi: set sw=2 sts=2 ts=2 et:
@@ -0,0 +1,130 @@
+/**
+ * @file cull_tree.hpp
+ * @brief Finding the pages in view without testing every page.
+ *
+ * A page used to be tested against the view by transforming its eight corners,
+ * one page at a time, every frame: a few dozen large documents make that tens
+ * of thousands of tests to find the handful of pages on screen. Here a
+ * document's pages are boxes in a tree, each node bounding the boxes under it,
+ * and a frame tests the nodes the view reaches and only the pages under those.
+ *
+ * The tree is built in the document's own space, not the world's, and the view
+ * is brought to it instead: the planes of the frustum are read off the
+ * document's transform, so they arrive already in its space. A document moving
+ * -- arriving, leaving, easing up when one before it closes -- changes only
+ * that transform, and the tree does not have to hear about it. Only what moves
+ * a page within its document builds it again: a page built, renumbered, added
+ * or taken away.
+ *
+ * Leaves hold their boxes as columns, a column per coordinate, so that one
+ * plane is tested against a leaf's worth of boxes in a loop with nothing in it
+ * but arithmetic on neighbouring floats: what a compiler turns into vector
+ * instructions on every target, without a kernel per instruction set.
+ */
+#ifndef GLEDITOR_CULL_TREE_H
+#define GLEDITOR_CULL_TREE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace gleditor {
+
+/// A plane, as the coefficients of x*p.x + y*p.y + z*p.z + w: a point is
+/// behind it when that is negative.
+struct CullPlane {
+  float x{};
+  float y{};
+  float z{};
+  float w{};
+};
+
+/// The four side planes of a view, facing in. The depth range is left out, as
+/// outsideFrustum() leaves it out; see gleditor/draw_budget.hpp.
+using CullFrustum = std::array<CullPlane, 4>;
+
+/// A page's box: flat in x and y, reaching from its plane to the tree's depth.
+struct CullBox {
+  float centreX{};
+  float centreY{};
+  float halfWidth{};
+  float halfHeight{};
+};
+
+/// A box a query found, and whether it is in view or only near it.
+struct CullHit {
+  std::uint32_t index{};
+  bool inView{};
+};
+
+class CullTree {
+public:
+  /// Boxes a leaf holds: a column of each is one or two vector registers wide.
+  static constexpr std::size_t leafSize = 8;
+
+  /**
+   * @brief Build the tree over @p boxes, each reaching @p depth in front of
+   *        its plane.
+   *
+   * Boxes are grouped by where they are in the list, not by where they are in
+   * space, so neighbours in the list should be neighbours on screen -- which
+   * pages in text order are, stacked down the document.
+   */
+  void rebuild(std::span<const CullBox> boxes, float depth);
+
+  /// Boxes the tree was built over.
+  [[nodiscard]] std::size_t size() const { return count; }
+
+  /**
+   * @brief Append to @p hits every box within reach of @p frustum, in the
+   *        order the boxes were given.
+   *
+   * A box is out of view when it is entirely behind one of the planes, which
+   * is what outsideFrustum() decides corner by corner. Within reach is the
+   * same test of the box grown about its centre by @p grow in width and
+   * height, for what is near enough to the view to be got ready for it.
+   *
+   * @param grow At least one.
+   * @return The nodes tested, leaves included.
+   */
+  std::uint32_t query(const CullFrustum &frustum, float grow,
+                      std::vector<CullHit> &hits) const;
+
+private:
+  /**
+   * @brief A run of leaves, and the box around all their boxes.
+   *
+   * Kept in one array in depth-first order, so a node's first child is the
+   * node after it, and `skip` is where the walk goes when the node is out of
+   * reach: past everything under it.
+   */
+  struct Node {
+    float centreX{};
+    float centreY{};
+    float halfWidth{};
+    float halfHeight{};
+    std::uint32_t firstLeaf{};
+    std::uint32_t leaves{};
+    std::uint32_t skip{};
+  };
+
+  std::vector<Node> nodes;
+  /// The boxes by column, padded to whole leaves.
+  std::vector<float> centreX;
+  std::vector<float> centreY;
+  std::vector<float> halfWidth;
+  std::vector<float> halfHeight;
+  float reach{};
+  std::size_t count{};
+
+  /// Add the node over leaves [@p first, @p first + @p leaves), and the
+  /// nodes under it.
+  void build(std::uint32_t first, std::uint32_t leaves);
+};
+
+} // namespace gleditor
+
+#endif // GLEDITOR_CULL_TREE_H
+// vi: set sw=2 sts=2 ts=2 et:
@@ -2,10 +2,11 @@
 #define GLEDITOR_DOC_H
 
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <choreograph/Choreograph.h>
+#include <chrono>
 #include <cstdint>
-#include <deque>
 #include <gleditor/buffer_pool.hpp>
 #include <gleditor/drawable.hpp>
 #include <gleditor/renderer.hpp>
@@ -14,17 +15,32 @@
 #include <glm/ext/matrix_float4x4.hpp>
 #include <glm/ext/vector_float3.hpp>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <pangomm/layout.h>
+#include <span>
 #include <string>
 #include <string_view>
+#include <utility>
 #include <vector>
 
+#include <gleditor/cull_tree.hpp>
 #include <gleditor/draw_budget.hpp>
+#include <gleditor/edit_span.hpp>
+#include <gleditor/layout_budget.hpp>
+#include <gleditor/page_cache.hpp>
+#include <gleditor/page_index.hpp>
+#include <gleditor/page_paragraphs.hpp>
+#include <gleditor/piece_table.hpp>
+#include <gleditor/reflow_backlog.hpp>
+#include <gleditor/save_file.hpp>
+#include <gleditor/residency.hpp>
 #include <gleditor/render/types.hpp>
 
 class Caret;
 class Doc;
+class GlyphCache;
+class GlyphCitation;
 struct RenderState;
 
 namespace render {
@@ -33,27 +49,13 @@ class RenderDevice;
 
 namespace gleditor {
 class DocumentObserver;
+struct ImpostorWant;
+struct PaginationLine;
 class TextSource;
 } // namespace gleditor
 
-/**
- * @brief One shaped cluster of the page's text.
- *
- * A cluster is Pango's unit of indivisible shaping: a ligature such as "ffi",
- * a base letter with its combining marks, or an emoji sequence is one cluster
- * drawn as one quad, while covering several characters of the text. Hit
- * testing has to know both, which is why the byte range and the character
- * count are kept rather than assuming one quad is one character.
- */
-struct ClusterBox {
-  /// Byte offset of the cluster within the page's own text.
-  std::uint32_t byteStart{};
-  /// Length of the cluster in bytes.
-  std::uint32_t byteLength{};
-  /// Characters the cluster covers. Greater than one for a ligature, which is
-  /// what makes a click inside the quad ambiguous without interpolation.
-  std::uint32_t charCount{};
-};
+using gleditor::ClusterBox;
+using gleditor::ClusterTable;
 
 class Page : public Drawable {
 private:
@@ -84,32 +86,87 @@ private:
    * buffer the layout has done its job, and a reader who never puts a cursor
    * in the document never needs it again.
    *
-   * So it is released when the page is built and shaped again on demand -- by
+   * So a page is built without keeping it, and shaped again on demand -- by
    * the same call on the same text, so it comes back identical. Only placing a
    * caret and reflowing an edit need one, and both are things a person does to
    * one page at a time.
    */
   mutable Glib::RefPtr<Pango::Layout> layout;
-  /// Byte offset of this page's text within the whole document, so a picking
-  /// result can name a position in the document rather than in the page.
-  std::uint32_t textOffset{};
-  /// Every cluster on the page, in text order.
-  std::vector<ClusterBox> clusters;
+  /// One paragraph's shaping, kept on the same terms: a caret needs only the
+  /// paragraph it is in, and an edit has just shaped it.
+  mutable Glib::RefPtr<Pango::Layout> paragraphLayout;
+  /// Which paragraph that is.
+  mutable std::size_t paragraphShaped{};
+  /// Every cluster on the page, in text order, with room left after each
+  /// paragraph's; see gleditor/page_paragraphs.hpp. Held as runs for as long
+  /// as the page is, which is as long as the document is open; see
+  /// gleditor/cluster_table.hpp.
+  ClusterTable clusters;
+  /// The paragraphs the page stacks, in text order. Empty for a placeholder.
+  std::vector<gleditor::PageParagraph> paragraphs;
   /// This page's position in its document, carried in the picking tag.
   std::uint32_t pageIndex{};
-  /// The picking identity every quad of this page shares -- its document and
-  /// page, with no kind, since that is the part each quad supplies. Passed to
-  /// the draw rather than written into a million instances.
-  std::uint32_t identity{};
   /// Bytes of document text this page lays out.
   std::uint32_t textBytes{};
   /// Offset applied to layout coordinates so the page is centred on its own
   /// origin; kept so caret geometry lands in the same space as the glyphs.
   float originX{};
   float originY{};
+  /// False for a placeholder: paginated, so where it starts and what it holds
+  /// are known, but drawn blank until it is built.
+  bool shaped{};
+  /// The last frame the page was in view or near it; see
+  /// gleditor/residency.hpp.
+  mutable std::uint64_t lastSeen{};
+  /// Asked to be built again after giving its rows back, and not yet.
+  mutable bool restoring{};
+  /// Names what the page shows, for a picture of it to be found by; see
+  /// gleditor/page_impostors.hpp. Given afresh whenever its rows change.
+  std::uint64_t contentKey{};
+  /// Keeps every glyph the rows draw in the atlas for as long as the page
+  /// holds them. Let go of with the rows.
+  std::shared_ptr<GlyphCitation> citation;
+  /// The glyph each row of the detailed draw shows, by its number in the
+  /// glyph cache, or GlyphCache::noGlyph: what relocateGlyphs() rewrites.
+  std::vector<std::uint32_t> glyphOfRow;
+  /// GlyphCache::repacks() as of the last time every glyph row was written.
+  std::uint64_t glyphsAt{};
+
+  /// Paragraph @p index shaped on its own, kept until the page lets its
+  /// shaping go.
+  [[nodiscard]] Glib::RefPtr<Pango::Layout>
+  shapeParagraph(std::size_t index) const;
 
 public:
+  /// A page worked out but not yet on the device. Defined after Doc, whose
+  /// row format it holds.
+  struct Built;
+
   /**
+   * @brief Work a page out from its shaping: its quads, both draws of them,
+   *        and its cluster table.
+   *
+   * The first half of building a page, and nearly all of its cost -- walking
+   * the clusters, rasterising every glyph not seen before. It touches nothing
+   * the render thread owns, and glyphs are only reserved, so a loader thread
+   * can do it while the render thread keeps drawing. Asks @p layout everything
+   * it will ever be asked, so the layout can be let go of afterwards.
+   */
+  [[nodiscard]] static Built build(const Glib::RefPtr<Pango::Layout> &layout,
+                                   GlyphCache &glyphs);
+
+  /**
+   * @brief A blank page of the usual size standing in for @p bytes of text
+   *        that have been paginated but not built.
+   *
+   * Holds the page's place while a document loads -- it is culled, picked and
+   * stacked like any other page -- and costs one row and no shaping.
+   */
+  [[nodiscard]] static Built placeholder(std::uint32_t bytes);
+
+  /**
+   * @brief The second half: write a built page's rows into its document's
+   *        pool. Render thread only, and cheap.
    * @param inherited Rows a page being replaced was using, for this one to
    *        take over. A reflow rebuilds a page in place of another of nearly
    *        the same length, so handing the rows on saves returning them to the
@@ -117,29 +174,51 @@ public:
    *        hole fitted, moved the page across the buffer on every keystroke.
    *        Empty for a page that has no predecessor.
    */
-  Page(std::shared_ptr<Doc> aDoc, RenderState &state, glm::mat4 &model,
-       Glib::RefPtr<Pango::Layout> aLayout, std::uint32_t aTextOffset,
+  Page(std::shared_ptr<Doc> aDoc, glm::mat4 &model, Built aBuilt,
        std::uint32_t aPageIndex, const BufferPool::Allocation &inherited = {});
+  Page(const Page &)            = default;
+  Page &operator=(const Page &) = default;
+  Page(Page &&)                 = default;
+  Page &operator=(Page &&)      = default;
   /**
-   * @brief Append this page's draw to @p batches, or decide it needs none.
+   * @brief Append the draw of this page, which is in view, to @p batches.
    * @param docTransform projection * view * document model.
+   * @param documentIndex The document the draw is picked as: this page's own,
+   *        or that of a document drawing its pages; see Doc::borrowPagesOf().
    *
    * Collected rather than issued so that the whole frame's page draws reach the
    * device in one call, which is what a backend needs in order to record them
-   * on more than one thread. Two decisions are made here rather than by the
-   * device, because both need to know what the page is rather than what the
-   * draw is: a page entirely outside the view contributes nothing and is
-   * skipped, and a page too small on screen for its glyphs to be legible is
-   * drawn as one solid bar per line instead.
+   * on more than one thread. Whether the page is in view at all is the
+   * document's to decide, for all its pages at once; see cullBox(). What is
+   * decided here needs to know what the page is rather than what the draw is:
+   * a page too small on screen for its glyphs to be legible is drawn as a
+   * picture of itself, or as one solid bar per line.
+   *
+   * @return Whether the page is in view, which for a placeholder is what says
+   *         it should be built next.
    */
-  void collect(std::vector<render::GlyphBatch> &batches,
+  bool collect(std::vector<render::GlyphBatch> &batches,
                const glm::mat4 &docTransform, float opacity,
-               const DrawBudget &budget, DrawStats &stats) const;
+               std::uint32_t documentIndex, const DrawBudget &budget,
+               DrawStats &stats) const;
+  /// Stamp the page as in or near view on @p frame, and ask for its rows back
+  /// if it has given them up.
+  void noticed(std::uint64_t frame) const;
+  /// The page's box in its document's space, for finding it in view; see
+  /// gleditor/cull_tree.hpp.
+  [[nodiscard]] gleditor::CullBox cullBox() const;
 
-  [[nodiscard]] std::uint32_t baseOffset() const { return textOffset; }
-  [[nodiscard]] const std::vector<ClusterBox> &clusterBoxes() const {
-    return clusters;
-  }
+  /**
+   * @brief Byte offset of this page's text within the whole document, so a
+   *        picking result can name a position in the document rather than in
+   *        the page.
+   *
+   * Not stored on the page: the document's PageIndex works it out from what
+   * the pages before this one span, which is what lets an edit move every
+   * later page without touching any of them.
+   */
+  [[nodiscard]] std::uint32_t baseOffset() const;
+  [[nodiscard]] const ClusterTable &clusterBoxes() const { return clusters; }
   /**
    * @brief This page's shaping, produced again if it is not being kept.
    *
@@ -148,19 +227,94 @@ public:
    */
   [[nodiscard]] Glib::RefPtr<Pango::Layout> ensureLayout() const;
   /// Let go of the shaping. Whatever needs it next asks for it again.
-  void dropLayout() const { layout.reset(); }
+  void dropLayout() const {
+    layout.reset();
+    paragraphLayout.reset();
+  }
+  /// Whether the whole page's shaping is being kept.
+  [[nodiscard]] bool hasLayout() const { return static_cast<bool>(layout); }
+  /**
+   * @brief Take @p shaped as this page's shaping, made ahead of being asked
+   *        for. Render thread only.
+   *
+   * It must be what ensureLayout() would have made, and made on a thread that
+   * has let go of it: a layout is never shared between two threads.
+   */
+  void adoptLayout(Glib::RefPtr<Pango::Layout> shaped) const {
+    layout = std::move(shaped);
+  }
+  /// Memory the shaping being kept is estimated to hold.
+  [[nodiscard]] std::size_t layoutBytes() const;
   [[nodiscard]] const BufferPool::Allocation &allocation() const {
     return pageBacking;
   }
-  /// Move this page's text offset without touching its shaping or its rows,
-  /// which an edit earlier in the document leaves byte-identical. Negative for
-  /// an edit that removed text.
-  void shiftBaseOffset(const std::int32_t bytes) {
-    textOffset = static_cast<std::uint32_t>(
-        static_cast<std::int64_t>(textOffset) + bytes);
-  }
+  /// Whether the page's rows are on the device. False once it has given them
+  /// back, and until it has been built again.
+  [[nodiscard]] bool resident() const { return !pageBacking.empty(); }
+  /// The last frame the page was in view or near it.
+  [[nodiscard]] std::uint64_t seenOn() const { return lastSeen; }
+  /// Whether it has asked to be built again and is waiting.
+  [[nodiscard]] bool restorePending() const { return restoring; }
+  /// A restore that came to nothing: the page asks again when next seen.
+  void cancelRestore() const { restoring = false; }
+  /**
+   * @brief Give the page's rows back to the pool, keeping everything else.
+   *
+   * Where it starts, what it holds and its clusters stay, so the page can
+   * still be found, picked and highlighted, and is built again from its start
+   * when it comes back towards the view.
+   */
+  void evict();
+  /**
+   * @brief Point the page's glyph rows at where the atlas has its glyphs now,
+   *        when it has been repacked since they were written.
+   *
+   * A repack moves glyphs, and this page's rows name them by texel. Only the
+   * two fields that say where -- the atlas origin and the layer -- are
+   * rewritten, row by row, since nothing keeps a copy of the rest. A repack
+   * comes once a quarter of the atlas has been drawn anew, so this is rare.
+   * Render thread only, after the glyph cache's commit().
+   *
+   * @return False when yet another repack is waiting to be committed, and the
+   *         rows have to wait with it.
+   */
+  bool relocateGlyphs(const GlyphCache &glyphs);
+  /**
+   * @brief Give this page a new position in its document, without touching
+   *        its shaping or its rows.
+   *
+   * For a reflow that changed how many pages come before this one. The text is
+   * byte-identical, so only what depends on the index moves: where the page is
+   * drawn and the picking identity its draw carries.
+   */
+  void renumber(std::uint32_t index, const glm::mat4 &placed);
   /// Bytes of document text this page lays out.
   [[nodiscard]] std::uint32_t textLength() const { return textBytes; }
+  [[nodiscard]] const std::vector<gleditor::PageParagraph> &
+  paragraphTable() const {
+    return paragraphs;
+  }
+  /**
+   * @brief Lay paragraph @p index out again after an edit inside it changed
+   *        it by @p delta bytes, and rewrite its rows and nothing else.
+   *
+   * Taken only when the paragraph comes out the same height and no wider than
+   * the page: then no other paragraph moves, and the page ends where it did.
+   * Its glyph rows are erased and the new ones written into whatever erased
+   * run fits -- the spare rows at the end of the detailed draw to begin with
+   * -- and its bars, one per line, are written over where they were.
+   *
+   * Render thread only, and only for a resident, shaped page. When this
+   * returns false the paragraph did not fit where it was, and some of its rows
+   * may already have been erased: the caller has to rebuild the page.
+   *
+   * @param local The paragraph shaped alone, without its line break.
+   */
+  [[nodiscard]] bool relayParagraph(std::size_t index,
+                                    const Glib::RefPtr<Pango::Layout> &local,
+                                    std::int32_t delta, GlyphCache &glyphs);
+  /// False while the page is a placeholder; see placeholder().
+  [[nodiscard]] bool isShaped() const { return shaped; }
   /// True when a document-global byte offset falls within this page's text.
   [[nodiscard]] bool contains(std::uint32_t globalOffset) const;
 
@@ -188,10 +342,16 @@ public:
   [[nodiscard]] float leftPixels() const { return originX; }
   [[nodiscard]] float topPixels() const { return originY; }
 
-  /// This page's own text, as a view into the document's. The offsets the
-  /// cluster table carries are relative to its start, and asking the document
-  /// rather than the layout is what lets the layout be let go of.
-  [[nodiscard]] std::string_view pageText() const;
+  /**
+   * @brief This page's own text, as a view into the document's.
+   *
+   * The offsets the cluster table carries are relative to its start, and
+   * asking the document rather than the layout is what lets the layout be let
+   * go of. A page whose text lies in one piece of the document -- every page
+   * but one that an edit has split -- is viewed in place; otherwise its bytes
+   * are gathered into @p scratch, which the view then points into.
+   */
+  [[nodiscard]] std::string_view pageText(std::string &scratch) const;
 
   /**
    * @brief Resolve a picked cluster and fractional position to a byte offset.
@@ -215,11 +375,12 @@ public:
    * cluster and not nothing. Single-character clusters come out as 0 or 1,
    * which is the same rule with nothing to divide.
    *
+   * @param documentIndex As for collect().
    * @return nullopt when the range does not reach this page.
    */
   [[nodiscard]] std::optional<render::HighlightRange>
   highlightFor(std::uint32_t selStart, std::uint32_t selEnd,
-               std::uint32_t colour) const;
+               std::uint32_t colour, std::uint32_t documentIndex) const;
   ~Page() override = default;
 };
 
@@ -230,7 +391,9 @@ public:
  * a change that quietly stopped taking them would still look correct.
  */
 enum class ReflowScope : std::uint8_t {
-  Line,     ///< The edit stayed within one line: no line break moved.
+  /// The edit stayed within its paragraph's lines: that paragraph alone was
+  /// laid out again, or, on a page rebuilt whole, no line break moved.
+  Line,
   Page,     ///< Line breaks moved, but the page still ends where it did.
   Document, ///< The page spilled, so pagination changed after it.
 };
@@ -241,7 +404,8 @@ class Doc : public Drawable, public std::enable_shared_from_this<Doc> {
 private:
   std::vector<Page> pages;
   /**
-   * @brief Pages whose shaping is currently being kept, oldest first.
+   * @brief Which pages' shaping is currently being kept; see
+   *        gleditor/layout_budget.hpp.
    *
    * A page gives up its layout as soon as its quads exist, and shapes again
    * when a caret or an edit needs it. Without a bound the pages a person
@@ -249,26 +413,137 @@ private:
    * which is the cost this exists to avoid; with one, a long session keeps as
    * many as a person can be working on at once.
    */
-  mutable std::deque<std::uint32_t> liveLayouts;
-  /// Kept because a reflow shapes the edited page and the pages after it, and
-  /// a caret sits in one page while an edit rebuilds another.
-  static constexpr std::size_t maxLiveLayouts = 4;
+  mutable gleditor::LayoutBudget layouts{layoutBudgetBytes};
+  /// Where each page starts, held as what each page spans. Parallel to
+  /// `pages`; see gleditor/page_index.hpp.
+  gleditor::PageIndex pageStarts;
+  /// What the layouts kept may hold: forty or so pages of prose, which is the
+  /// caret's page, the edit's, and the pages either side of a few places a
+  /// person has been working.
+  static constexpr std::size_t layoutBudgetBytes = std::size_t{16} << 20;
+  /// The page the caret was last found on, whose neighbours have been asked
+  /// to be shaped ahead of it; see wantShapedAround().
+  mutable std::optional<std::size_t> shapedAround;
+  /// Pages to shape off the render thread before a caret needs them, since
+  /// they were last handed to the renderer. Render thread only.
+  mutable std::vector<std::uint32_t> wantedShaped;
   /// What this document is called: a path for one opened from disk, whatever
   /// the source said otherwise.
   std::string docName;
-  Glib::ustring text;
+  /// The text, as pieces of what was loaded and what has been typed since.
+  /// See gleditor/piece_table.hpp for why it is not one string.
+  gleditor::PieceTable text;
   /// Told about every edit. Bare pointers, not owned; see DocumentObserver.
   std::vector<gleditor::DocumentObserver *> observers;
+  /// The first byte an edit has touched since the text last matched its file,
+  /// or nullopt when none has.
+  std::optional<std::uint64_t> unsavedFrom;
+  /// The file as it was when the text last matched it byte for byte. Nullopt
+  /// when it never has -- a file repaired or stripped of its byte order mark
+  /// on the way in, or text with no file at all -- or a save failed since.
+  std::optional<gleditor::FileStamp> savedStamp;
+  /// Whether some of the text is still read from the file at docName, mapped:
+  /// true from a source that lent its bytes until a save replaces the file.
+  /// See SaveRequest::mapsFile.
+  bool mapsFile{};
+  /// Saves begun and not yet ended. While one is writing, the file is about to
+  /// stop matching any stamp held, so a save begun meanwhile replaces it.
+  std::uint32_t savesInFlight{};
   RendererRef renderer;
   /// Vertex storage shared by every page of this document.
   std::unique_ptr<BufferPool> pool;
+  /**
+   * @brief Pages estimated to be in the text not yet paginated, while the
+   *        document loads.
+   *
+   * Drawn as placeholders after the last page, so that the document is as
+   * long as it is going to be from the start: culling has something to test,
+   * the camera something to look at, and the loader a way to hear that the
+   * reader is looking past where pagination has got to. Render thread only.
+   */
+  std::uint32_t remainderPages{};
+  /// The one row every placeholder past the last page is drawn from. Held only
+  /// while the document loads.
+  BufferPool::Allocation placeholderRow{};
+  /// Guards the two below: the render thread writes them as it draws, and the
+  /// loader reads them to decide what to build next.
+  mutable std::mutex focusGuard;
+  /// Placeholders in view on the last frame, by page index -- including those
+  /// past the last page.
+  mutable std::vector<std::uint32_t> placeholdersInView;
+  /// The last offset the caret or an anchor was wanted at and no built page
+  /// held.
+  mutable std::optional<std::uint32_t> wantedOffset;
+  /// Pages that came near the view without their rows, since they were last
+  /// handed to the renderer to build again. Render thread only.
+  mutable std::vector<std::uint32_t> wantedBack;
+  /// From opening until the last page is on the device. Pages of a document
+  /// still loading are not evicted: its pool has been sized for all of them,
+  /// and giving rows back would only have them asked for again.
+  bool loading{};
+  /// The text as it was when loading began, which every loader thread reads
+  /// instead of the table: an edit made while the document is still loading
+  /// goes on in the table under them. Let go of once the last page is in.
+  std::shared_ptr<const gleditor::PieceTable::Snapshot> loadText;
   /// Position among the open documents; see setDocIndex().
   std::uint32_t docIndex{};
   /// Outcome of the most recent reflow, for reporting and for tests.
   ReflowScope reflowScope{ReflowScope::Document};
   /// Bumped by every splice of the text. See editGeneration().
   std::uint64_t edits{};
+  /// What textSnapshot() last took, and at which edit.
+  mutable std::shared_ptr<const gleditor::PieceTable::Snapshot> snapshotTaken;
+  mutable std::uint64_t snapshotEdits{};
   std::size_t reflowPages{};
+  /// Edits the most recent reflow covered.
+  std::size_t reflowEdits{};
+  /**
+   * @brief Edits made since the last reflow, merged into one; see
+   *        gleditor/edit_span.hpp. Nothing while none is waiting.
+   *
+   * Render thread only, like the edits themselves. Every page still describes
+   * the text as it was before the first of them, which is what lets the one
+   * reflow compare against it.
+   */
+  std::optional<gleditor::EditSpan> pendingEdits;
+  /// Line breaks of the page the first of them landed on, before it was made;
+  /// see lineBreaksAround(). Not taken when it stayed inside a paragraph.
+  std::vector<int> pendingStarts;
+  /// Which page those are of.
+  std::size_t pendingStartsPage{};
+  /// Whether the first of them was inside a paragraph of a built page and none
+  /// of them has taken a newline away; see withinParagraph().
+  bool pendingLocal{};
+  /// The pages a reflow ran out of time before reaching, while there are any;
+  /// see gleditor/reflow_backlog.hpp. Render thread only.
+  std::optional<gleditor::ReflowBacklog> backlog;
+  /**
+   * @brief A paste too long to reflow on the render thread, while a loader
+   *        paginates it; see insert(). Render thread only.
+   *
+   * The page the paste landed on stands in for all of it, as a placeholder
+   * grown by what was pasted, so that every page after it is where it should
+   * be from the moment of the splice. The loader's pages go in before it a
+   * batch at a time, each taking its bytes from it, and whatever is left of it
+   * when the loader reaches the end of the paste is handed to reflowPending()
+   * as an edit of its own.
+   */
+  struct StreamedInsert {
+    /// What edits will be once the paste is spliced. Any later edit ends the
+    /// stream, which is how a batch arriving after one knows to go unused.
+    std::uint64_t generation{};
+    /// The placeholder.
+    std::size_t page{};
+    /// Just past the pasted text.
+    std::uint32_t to{};
+    /// Whether a loader has been asked for its pages.
+    bool started{};
+  };
+  std::optional<StreamedInsert> streaming;
+  /// The generation of the stream a loader should still be paginating for,
+  /// or zero. Read by the loader between pages, so that one overtaken by an
+  /// edit stops rather than laying out the rest of a paste nobody will use.
+  std::atomic<std::uint64_t> streamWanted{0};
   /**
    * @brief Where the document actually is, as opposed to where it belongs.
    *
@@ -283,15 +558,142 @@ private:
   /// Whether a departure has been started, so the owner knows this document is
   /// on its way out rather than merely transparent for a moment.
   bool closing{};
+  /**
+   * @brief The document whose pages this one draws instead of its own, while
+   *        both hold the same text; see borrowPagesOf().
+   *
+   * Held, so that the pages outlive their document closing under a borrower
+   * that is still fading in. Render thread only.
+   */
+  std::shared_ptr<Doc> lender;
+  /// Documents drawing this one's pages. Render thread only.
+  std::vector<std::weak_ptr<Doc>> borrowers;
+  /// Stopped borrowing, and not yet begun building pages of its own; see
+  /// needsPages().
+  bool wantsOwnPages{};
+
+  /// The document whose pages are drawn for this one: itself, unless it is
+  /// borrowing.
+  [[nodiscard]] const Doc &drawn() const { return lender ? *lender : *this; }
+  /// Give the borrowed pages back and ask for pages of its own, of the text as
+  /// it now stands.
+  void stopBorrowing();
+  /**
+   * @brief Every page and placeholder as a box, for the view to find the ones
+   *        it reaches without visiting the rest.
+   *
+   * Kept as the pages are, in the document's own space; see
+   * gleditor/cull_tree.hpp. Built again when a page is built or renumbered, or
+   * when the count of pages and placeholders changes. Render thread only.
+   */
+  mutable gleditor::CullTree pageTree;
+  mutable bool pageTreeStale{true};
+  /// GlyphCache::committedRepacks() as of when every page's glyph rows were
+  /// last known to agree with it, and whether a page since built may not.
+  std::uint64_t glyphsAt{};
+  bool glyphsStale{};
+  /// What the last query of pageTree found. Scratch, kept to be reused.
+  mutable std::vector<gleditor::CullHit> pageHits;
+  /// The first and last built pages this document drew on the last frame,
+  /// which may be its lender's; see textInView(). Render thread only.
+  mutable std::optional<std::pair<std::size_t, std::size_t>> pagesShown;
+
+  /// Build pageTree again if it no longer matches the pages.
+  void refreshPageTree() const;
+  /// Append the draws of this document's pages to @p batches, as @p viewer
+  /// sees them: with its transform, its opacity and its picking identity.
+  void collectFor(const Doc &viewer, std::vector<render::GlyphBatch> &batches,
+                  const glm::mat4 &docTransform, const DrawBudget &budget,
+                  DrawStats &stats) const;
 
+  /// A layout in the page's font and width, holding nothing yet.
+  [[nodiscard]] Glib::RefPtr<Pango::Layout> blankLayout() const;
   /// Build a page layout for text starting at @p offset, with the page
-  /// geometry makePages() uses. Safe to call off the render thread.
+  /// geometry makePages() uses. Reads the table, so render thread only.
   [[nodiscard]] Glib::RefPtr<Pango::Layout>
   layoutFrom(std::uint32_t offset) const;
+  /// The same, of a snapshot of the text, which the render thread can go on
+  /// editing while it is read.
+  [[nodiscard]] Glib::RefPtr<Pango::Layout>
+  layoutFrom(const gleditor::PieceTable::Snapshot &snapshot,
+             std::uint32_t offset) const;
+  /// Append each line of @p source starting in [@p from, @p to), wrapped as
+  /// a page would wrap it, with its height. Both ends are paragraph starts.
+  /// Safe to call off the render thread, from several at once.
+  void wrapLines(const gleditor::PieceTable::Snapshot &source,
+                 std::uint32_t from, std::uint32_t to,
+                 std::vector<gleditor::PaginationLine> &out) const;
+  /// The first byte of @p source after a newline at or after @p offset, or
+  /// the end of it.
+  [[nodiscard]] static std::uint32_t
+  paragraphStart(const gleditor::PieceTable::Snapshot &source,
+                 std::uint32_t offset);
 
-  /// Record that page @p pageIndex has shaped itself again, and let go of the
-  /// least recently shaped page once more than a few are being kept.
-  void keepLayoutOf(std::uint32_t pageIndex) const;
+  /// What this document's pages are built from, as the page cache keys it:
+  /// @p source, the font and the page geometry.
+  [[nodiscard]] gleditor::PageCacheKey
+  pageCacheKey(const gleditor::PieceTable::Snapshot &source) const;
+  /**
+   * @brief Hand on every page of @p source from the cache written for @p key,
+   *        if there is one, as makePages() would have built them.
+   *
+   * Nothing is shaped: each page's rows are read back as written, and all that
+   * is done to them is to ask the glyph cache where their glyphs are this time.
+   * Run on the loader thread, with the glyphs looked up on several. @p source
+   * is the text @p key was taken of, so that an edit meanwhile cannot pair
+   * one text's pages with another's bytes.
+   *
+   * @return Whether the pages came from the cache. When they did not, nothing
+   *         has been handed on, and the pages are to be built as usual.
+   */
+  bool pagesFromCache(RenderState &state, const gleditor::PageCacheKey &key,
+                      const gleditor::PieceTable::Snapshot &source);
+  /**
+   * @brief Queue what follows the last page being handed on: build any page
+   *        still blank, give back what the pool reserved for growth, and
+   *        publish the page cache @p cache was writing, if it is still this
+   *        text's.
+   */
+  void finishLoading(RenderState &state,
+                     std::shared_ptr<gleditor::PageCacheWriter> cache);
+
+  /// What a loading document should build first, as the render thread last
+  /// drew it.
+  struct LoadFocus {
+    std::vector<std::uint32_t> pages;
+    std::optional<std::uint32_t> offset;
+  };
+  [[nodiscard]] LoadFocus loadFocus() const;
+  /// Record that @p offset was asked for before a built page held it.
+  void want(std::uint32_t offset) const;
+  /// Queue the page built from @p start in place of placeholder @p index.
+  void replacePlaceholder(RenderState &state, std::uint32_t index,
+                          std::uint32_t start, Page::Built &&built);
+
+  /// Record that page @p pageIndex has shaped itself again, in @p cost or in
+  /// an unmeasured time when zero, and let go of the layouts least worth
+  /// keeping once they hold more than the budget.
+  void keepLayoutOf(std::uint32_t pageIndex,
+                    std::chrono::nanoseconds cost) const;
+  /// The caret is on page @p pageIndex: the first time it is found there, ask
+  /// for the pages either side to be shaped ahead of it.
+  void wantShapedAround(std::size_t pageIndex) const;
+
+  /// The page an edit at @p offset lands on: the last one starting at or
+  /// before it. Logarithmic in the page count. Pages must not be empty.
+  [[nodiscard]] std::size_t pageAt(std::uint32_t offset) const;
+  /// Where page @p page starts in the text, through the backlog while there is
+  /// one. A @p page equal to the page count is the end of the text.
+  [[nodiscard]] std::uint32_t pageStart(std::size_t page) const;
+  /**
+   * @brief The first page whose text holds @p offset, or nothing.
+   *
+   * Not quite pageAt(): an offset at the end of one page is also the start of
+   * the next, and a caret there belongs to the end of the line it was typed
+   * on, which is the earlier page.
+   */
+  [[nodiscard]] std::optional<std::size_t>
+  pageHolding(std::uint32_t offset) const;
 
 public:
   /**
@@ -335,27 +737,118 @@ public:
    */
   static void fillPage(const Glib::RefPtr<Pango::Layout> &layout,
                        const char *from, std::size_t remaining);
+  /**
+   * @brief The same, for the text of a document from byte @p offset.
+   *
+   * Each slice offered is one contiguous run, taken in place when it lies in
+   * one piece and gathered otherwise, so what Pango is handed never grows past
+   * what the page needs however fragmented editing has left the text.
+   */
+  static void fillPage(const Glib::RefPtr<Pango::Layout> &layout,
+                       const gleditor::PieceTable &text, std::size_t offset);
+  /// And for a snapshot of it.
+  static void fillPage(const Glib::RefPtr<Pango::Layout> &layout,
+                       const gleditor::PieceTable::Snapshot &text,
+                       std::size_t offset);
 
 private:
   /// Byte offsets at which each line of a layout starts.
   [[nodiscard]] static std::vector<int>
   lineStarts(const Glib::RefPtr<Pango::Layout> &layout);
   /**
-   * @brief Rebuild the pages an edit disturbed. Render thread only.
-   * @param delta Bytes the document grew by, negative for a removal. Every
-   *        offset after the edit moves by exactly this, which is what lets the
-   *        pages past the damage keep their shaping and only renumber.
-   */
-  void reflowFrom(RenderState &state, std::size_t firstPage, std::uint32_t at,
-                  std::int32_t delta, const std::vector<int> &oldStarts,
-                  std::uint32_t oldConsumed);
-  /// Shared tail of insert() and erase(): find the damaged page, record what
-  /// its lines looked like, and schedule the reflow.
-  void scheduleReflow(RenderState &state, std::uint32_t at, std::int32_t delta,
-                      const std::vector<int> &oldStarts);
+   * @brief Rebuild the pages a burst of edits disturbed. Render thread only.
+   * @param span What the edits changed. Every offset past its end moves by
+   *        exactly its delta, which is what lets the pages past the damage
+   *        keep their shaping and only renumber.
+   * @param deadline When to stop and leave the rest to the backlog, once the
+   *        pages the edits landed on have been laid out again.
+   */
+  void reflowFrom(RenderState &state, std::size_t firstPage,
+                  const gleditor::EditSpan &span,
+                  const std::vector<int> &oldStarts, bool local,
+                  std::chrono::steady_clock::time_point deadline);
+  /// Pages to lay out again from one start, and how the pages after them have
+  /// moved; see relayPages().
+  struct Relay {
+    /// The first page replaced.
+    std::size_t firstPage;
+    /// Where laying out starts, which is where the index puts firstPage.
+    std::uint32_t start;
+    /// Just past the pages the edits landed on, which have to be replaced
+    /// whatever else happens. firstPage when there are none.
+    std::size_t blockEnd;
+    /// What the text moved by after them, which pageStart() does not know yet.
+    std::int64_t shift;
+    /// The first page the reflow may stop before when out of time. Before
+    /// it, where the pages start is not out by a constant.
+    std::size_t pauseFrom;
+  };
+  /// What relayPages() did.
+  struct Relayed {
+    /// New pages.
+    std::size_t rebuilt{};
+    /// Old pages they stand in for.
+    std::size_t replaced{};
+    /// Whether pagination came back to the old pages' or to the end of the
+    /// text, rather than stopping for time.
+    bool caughtUp{};
+    /// The layout of the first new page.
+    Glib::RefPtr<Pango::Layout> first;
+  };
+  /**
+   * @brief Lay pages out from @p relay's start until they end where an old
+   *        page starts, the text ends, or @p deadline passes, and put them in
+   *        place of the old pages they cover. Render thread only.
+   *
+   * Stopping for time leaves, or replaces, the backlog.
+   */
+  Relayed relayPages(RenderState &state, const Relay &relay,
+                     std::chrono::steady_clock::time_point deadline);
+  /**
+   * @brief Shared part of insert() and erase(): merge an edit replacing
+   *        @p removed at @p at with @p inserted bytes into those waiting for
+   *        the next reflow.
+   *
+   * Must be called before the text is changed: the first edit of a burst
+   * records what its page's lines looked like.
+   */
+  void noteEdit(std::uint32_t at, std::string_view removed,
+                std::uint32_t inserted);
+  /// Whether inserting @p inserted bytes at @p at is paginated by a loader
+  /// rather than reflowed; see streaming.
+  [[nodiscard]] bool streams(std::uint32_t at, std::uint32_t inserted) const;
+  /// Make the page an insertion of @p inserted bytes at @p at lands on the
+  /// placeholder for it. Before the text is changed, as noteEdit() is.
+  void beginStream(std::uint32_t at, std::uint32_t inserted);
+  /// Hand what the placeholder still covers to the next reflow, and end the
+  /// stream.
+  void settleStream();
+  /// Put pages a loader built of the paste in before the placeholder, with
+  /// how many bytes of it each covers.
+  void acceptStreamed(
+      std::vector<std::pair<std::uint32_t, Page::Built>> &&laid);
   /// The line breaks of the page an edit at @p at lands on, as they are before
   /// it is made. Must be called before the text is changed.
   [[nodiscard]] std::vector<int> lineBreaksAround(std::uint32_t at) const;
+  /**
+   * @brief Whether an edit at @p at taking away @p removed stays inside one
+   *        whole paragraph of a built page. Must be called before the text is
+   *        changed.
+   *
+   * Such an edit is reflowed by laying out its paragraph first, and needs
+   * nothing of the page's own shaping -- which lineBreaksAround() would
+   * otherwise shape the page again to provide, for every keystroke.
+   */
+  [[nodiscard]] bool withinParagraph(std::uint32_t at,
+                                     std::string_view removed) const;
+  /// Reflow edits inside one paragraph of page @p pageIndex by laying out
+  /// that paragraph alone, when it still fits; see Page::relayParagraph().
+  bool reflowParagraph(RenderState &state, std::size_t pageIndex,
+                       const gleditor::EditSpan &span);
+  /// The @p bytes of text from @p offset laid out alone, wrapped as a page
+  /// wraps them but not bounded by height.
+  [[nodiscard]] Glib::RefPtr<Pango::Layout>
+  layoutOf(std::uint32_t offset, std::uint32_t bytes) const;
   // token to keep anything other than Doc::create from using our constructor
   struct Private {
     explicit Private() = default;
@@ -497,6 +990,15 @@ public:
       return rgb565(rgb) << 16 | (cluster & 0xFFFFU);
     }
 
+    /// @p quad with its atlas layer changed to @p layer: what a glyph that
+    /// has moved in the atlas needs besides @ref atlas.
+    static constexpr unsigned int onLayer(const unsigned int quad,
+                                          const unsigned char layer) {
+      assert(layer < maxAtlasLayers);
+      constexpr unsigned int layerMask = 0x3FU << 2;
+      return (quad & ~layerMask) | static_cast<unsigned int>(layer) << 2;
+    }
+
     /// Pack a glyph's origin in the atlas, in texels.
     static constexpr unsigned int atlasAt(const unsigned int texelX,
                                           const unsigned int texelY) {
@@ -566,6 +1068,18 @@ public:
   Doc(const RendererRef &renderer, render::RenderDevice *device,
       const glm::mat4 &model, const gleditor::TextSource &source, Private);
   ~Doc() override = default;
+  /**
+   * @brief Lay the whole text out as pages, handing each to the render thread
+   *        as it is ready.
+   *
+   * Run on a loader thread. A large document is paginated across several
+   * more; see gleditor/paginator.hpp. Either way the pages arrive in order,
+   * and are the pages one thread would have made.
+   *
+   * What is built first follows the view. A page nobody is looking at is left
+   * a placeholder while pagination runs ahead to where the reader is, and
+   * built afterwards, nearest the view first; see gleditor/load_queue.hpp.
+   */
   void makePages(RenderState &state);
   /// Append every visible page's draw to @p batches.
   /// @param viewProjection projection * view; the document's own model matrix
@@ -573,19 +1087,176 @@ public:
   void collect(std::vector<render::GlyphBatch> &batches,
                const glm::mat4 &viewProjection, const DrawBudget &budget,
                DrawStats &stats) const;
-  void newPage(RenderState &state, Glib::RefPtr<Pango::Layout> &layout,
-               std::uint32_t textOffset);
+  /// Queue a page after the last, built from its layout already and spanning
+  /// @p consumed bytes of the text -- where the page after it will start.
+  /// @param remainder Pages estimated to follow it; see remainderPages.
+  void newPage(Page::Built &&built, std::uint32_t consumed,
+               std::uint32_t remainder);
+
+  /// A page to build again, having given its rows back.
+  struct Restore {
+    std::uint32_t index{};
+    std::uint32_t start{};
+    std::uint32_t bytes{};
+    /// The text when it was asked for, which the page is laid out from: the
+    /// render thread goes on editing the table meanwhile.
+    std::shared_ptr<const gleditor::PieceTable::Snapshot> text;
+  };
+  /**
+   * @brief Draw @p other's pages rather than building any of its own, for as
+   *        long as neither document is edited. Render thread only.
+   *
+   * For a document opened again while it is already open: `gleditor a.txt
+   * a.txt`, or a program showing one text in two places. The text is the
+   * same and so is the font -- every document is laid out in the renderer's
+   * -- so the pages would be the same pages, rows for rows; building them
+   * twice would cost the shaping twice and the device memory twice. A
+   * borrower costs its own transform, opacity and picking identity, which
+   * are the draw's rather than the rows'.
+   *
+   * Copy on write, with the pages as the thing copied: the first edit to
+   * either document stops the borrowing, and the borrower builds pages of its
+   * own -- of its text before the edit if it was the lender that was edited,
+   * which the page cache usually holds already. The lender's pages are never
+   * disturbed for a borrower.
+   *
+   * Refused unless @p other holds this document's text byte for byte, has no
+   * reflow waiting, is not closing and is not itself borrowing; a borrower is
+   * lent to by the document it borrows from instead.
+   *
+   * @return Whether this document now borrows. When not, it is to be loaded
+   *         as usual; see beginLoading().
+   */
+  bool borrowPagesOf(const std::shared_ptr<Doc> &other);
+  /// Whether the pages drawn for this document are another document's.
+  [[nodiscard]] bool borrowsPages() const { return nullptr != lender; }
+  /// Whether this document has stopped borrowing and has no pages of its own
+  /// yet: the renderer is to beginLoading() and makePages() it.
+  [[nodiscard]] bool needsPages() const { return wantsOwnPages; }
+  /**
+   * @brief Get ready for makePages(): size the pool for the whole text, and
+   *        take the snapshot of it the pages are laid out from. Render thread
+   *        only.
+   *
+   * Not done by the constructor, because a document that borrows its pages
+   * needs no room for any.
+   */
+  void beginLoading();
+  /// Have every document borrowing this one's pages build its own. For a
+  /// document about to close, whose pages will stop being looked after.
+  void stopLending();
+  /// Device memory this document's pool holds, used or not.
+  [[nodiscard]] std::size_t deviceBytes() const;
+  /// Memory the pages' cluster tables hold.
+  [[nodiscard]] gleditor::ClusterMemory clusterMemory() const;
+  /**
+   * @brief Append every page that could give its rows back to @p candidates,
+   *        and its index to @p indices.
+   *
+   * Built pages with rows and no restore pending, of a document that has
+   * finished loading. Render thread only.
+   */
+  void evictionCandidates(
+      std::vector<gleditor::PageResidency::Candidate> &candidates,
+      std::vector<std::uint32_t> &indices) const;
+  /// Give back the rows of the pages at @p indices, and compact the pool so
+  /// that the device memory goes too. Render thread only.
+  void evict(std::span<const std::uint32_t> indices);
+  /**
+   * @brief Rewrite the glyph rows of every page built before the glyph
+   *        atlas was last repacked. Render thread only, once a frame, after
+   *        the glyph cache has committed.
+   *
+   * Nothing but a comparison when no page needs it, which is nearly always.
+   */
+  void relocateGlyphs(const GlyphCache &glyphs);
+  /// The pages that came near the view without their rows since the last
+  /// call. Render thread only.
+  [[nodiscard]] std::vector<Restore> takeRestores();
+  /// The pages to shape ahead of the caret since the last call. Render thread
+  /// only.
+  [[nodiscard]] std::vector<Restore> takePrefetches();
+  /**
+   * @brief Shape @p wanted off the render thread and queue each layout to be
+   *        kept by its page.
+   *
+   * What a caret arriving on one of them would otherwise have shaped on the
+   * render thread, and waited for. Shaped from the snapshot each carries,
+   * never the table. Discarded if the text has been edited since generation
+   * @p edited, or the page has been rebuilt or has shaped itself in the
+   * meantime.
+   */
+  void prefetchLayouts(const std::vector<Restore> &wanted,
+                       std::uint64_t edited);
+
+  /// Bytes of text inserted at once from which the pages are laid out by a
+  /// loader rather than by the reflow; see insert().
+  static constexpr std::uint32_t streamedInsertBytes = 1U << 20;
+  /// Pages of a streamed insertion a loader hands over at a time.
+  static constexpr std::size_t streamedBatchPages = 16;
+  /// What a loader paginates a streamed insertion from.
+  struct StreamedPages {
+    std::uint64_t generation{};
+    gleditor::PieceTable::Snapshot text;
+    /// Where the placeholder starts, which is where the first new page does.
+    std::uint32_t from{};
+    /// Just past the pasted text.
+    std::uint32_t to{};
+  };
+  /// The streamed insertion still waiting for a loader, once. Render thread
+  /// only.
+  [[nodiscard]] std::optional<StreamedPages> takeStreamedInsert();
+  /**
+   * @brief Lay out and build the pages of a streamed insertion off the render
+   *        thread, queueing them a batch at a time.
+   *
+   * Stops at the last page that ends inside the pasted text: the one after
+   * reaches into the pages already there, and finding where it comes back to
+   * them is the reflow's business. Gives up when the document is edited
+   * meanwhile.
+   */
+  void paginateInserted(RenderState &state, const StreamedPages &wanted);
+  /// What keeping layouts has saved and cost this document.
+  [[nodiscard]] const gleditor::LayoutStats &layoutStats() const {
+    return layouts.stats();
+  }
+  /**
+   * @brief Build @p wanted again and queue each to replace its page.
+   *
+   * Off the render thread, the same way a loader builds a page: the render
+   * thread only writes the rows. Laid out from the snapshot each carries,
+   * never the table. A page an edit has changed in the meantime is left for
+   * the next time it is seen.
+   */
+  void restorePages(RenderState &state, const std::vector<Restore> &wanted);
+  /**
+   * @brief Draw a picture of each page in @p wanted and queue it to be placed
+   *        among the pictures in @p state.
+   *
+   * Off the render thread, as a restore is: the page is shaped again from
+   * where it starts in the snapshot the want carries, and its lines drawn
+   * with Cairo. A picture of text edited since it was asked for is of a page
+   * that may no longer exist, and is let go of instead.
+   */
+  void renderImpostors(RenderState &state,
+                       const std::vector<gleditor::ImpostorWant> &wanted);
 
   /**
    * @brief Insert UTF-8 text at a document-global byte offset.
    *
-   * The text is spliced immediately, so the document is authoritative at once;
-   * the layout that follows is scheduled off the render thread, because
-   * shaping a page is far too slow to do between a keystroke and the next
-   * frame.
+   * The text is spliced immediately, so the document is authoritative at once,
+   * and observers are told straight away. Laying the pages out again waits for
+   * reflowPending(), so that a burst of keystrokes between two frames costs one
+   * reflow rather than one each.
+   *
+   * Except for a paste of streamedInsertBytes or more, whose pages the reflow
+   * would lay out one after another within a single frame -- the deadline only
+   * applies once the pages an edit landed on are done, and all of a paste
+   * lands on one. Those are paginated by a loader instead, from a snapshot,
+   * and arrive over the frames that follow; observers still hear of one
+   * insertion, now. See takeStreamedInsert().
    */
-  void insert(RenderState &state, std::uint32_t offset, const std::string &utf8,
-              Caret *caret);
+  void insert(std::uint32_t offset, const std::string &utf8, Caret *caret);
 
   /**
    * @brief Remove @p bytes of text from a document-global byte offset.
@@ -597,8 +1268,7 @@ public:
    *
    * @return What was actually removed, which is empty when the range was.
    */
-  std::string erase(RenderState &state, std::uint32_t offset,
-                    std::uint32_t bytes, Caret *caret);
+  std::string erase(std::uint32_t offset, std::uint32_t bytes, Caret *caret);
 
   /**
    * @brief Start or stop being told about this document's edits.
@@ -612,6 +1282,30 @@ public:
   /// What this document is called. A path, for one opened from a file.
   [[nodiscard]] const std::string &name() const { return docName; }
 
+  /// A save of this document under way: the text it is writing, and how.
+  struct PendingSave {
+    gleditor::PieceTable::Snapshot text;
+    gleditor::SaveRequest request;
+    /// Where the text stopped matching the file when the save began, given
+    /// back if the save fails.
+    std::optional<std::uint64_t> unsavedFrom;
+  };
+  /**
+   * @brief Take what a save to name() needs, now. Render thread only.
+   * @param inPlace Whether the save may rewrite only what follows the first
+   *        byte changed since the file last matched; see
+   *        gleditor/save_file.hpp.
+   *
+   * The text is a snapshot, so editing carries on while it is written. Every
+   * save begun has to be ended with endSave(), succeeded or not.
+   */
+  [[nodiscard]] PendingSave beginSave(bool inPlace);
+  /// Record how @p save turned out. Render thread only.
+  void endSave(const PendingSave &save, const gleditor::SaveOutcome &outcome);
+  /// Whether some of the text is still read from a mapping of the file at
+  /// name(), which nothing may rewrite in place while this document is open.
+  [[nodiscard]] bool mapsItsFile() const { return mapsFile; }
+
   /**
    * @brief How many times this document's text has changed.
    *
@@ -623,16 +1317,58 @@ public:
    */
   [[nodiscard]] std::uint64_t editGeneration() const { return edits; }
 
-  /// Scope of the most recent reflow, and how many pages it rebuilt.
+  /**
+   * @brief The text as it stands, for a worker to lay pages out from while
+   *        the table goes on being edited. Render thread only.
+   *
+   * The table itself is never read off the render thread, loading included:
+   * an edit splits and merges its tree and grows the vectors holding it,
+   * under any reader. A load reads the one taken by beginLoading(). Taken
+   * once between two edits and shared after that, so asking every frame costs
+   * a comparison.
+   */
+  [[nodiscard]] std::shared_ptr<const gleditor::PieceTable::Snapshot>
+  textSnapshot() const;
+
+  /// Scope of the most recent reflow, how many pages it rebuilt, and how many
+  /// edits it covered.
   [[nodiscard]] ReflowScope lastReflowScope() const { return reflowScope; }
   [[nodiscard]] std::size_t lastReflowPages() const { return reflowPages; }
-  [[nodiscard]] const Glib::ustring &contents() const { return text; }
+  [[nodiscard]] std::size_t lastReflowEdits() const { return reflowEdits; }
+  /**
+   * @brief Lay the pages out again for every edit made since the last call,
+   *        in one reflow, then carry on with any backlog until @p deadline.
+   *        Render thread only.
+   *
+   * Called by the renderer once a frame, before anything is drawn. The scope
+   * reported afterwards is that of the merged reflow. A deadline is kept to
+   * a page: the pages an edit landed on are always laid out again at once,
+   * and a backlog moves on by at least one page a call.
+   */
+  void reflowPending(RenderState &state,
+                     std::chrono::steady_clock::time_point deadline);
+  /// Whether edits are waiting for reflowPending(), or pages for a reflow or
+  /// a streamed insertion still under way to reach them.
+  [[nodiscard]] bool reflowIsPending() const {
+    return pendingEdits.has_value() || backlog.has_value() ||
+           streaming.has_value();
+  }
+  /// Pages a reflow still under way has yet to reach.
+  [[nodiscard]] std::size_t reflowBacklog() const {
+    return backlog ? backlog->pagesLeft(pageStarts) : 0;
+  }
+  /// The text as it stands. Read it in ranges -- slice(), forEachRun() -- and
+  /// copy the whole of it with str() only where every byte is wanted anyway.
+  [[nodiscard]] const gleditor::PieceTable &contents() const { return text; }
   /// Position among the renderer's open documents, carried in the picking tag
   /// so a result names which document was clicked.
   void setDocIndex(const std::uint32_t index) { docIndex = index; }
   [[nodiscard]] std::uint32_t documentIndex() const { return docIndex; }
+  /// Page @p index of those drawn for this document, which are another
+  /// document's while it borrows them.
   [[nodiscard]] const Page *page(const std::size_t index) const {
-    return index < pages.size() ? &pages[index] : nullptr;
+    const auto &shown = drawn().pages;
+    return index < shown.size() ? &shown[index] : nullptr;
   }
 
   /**
@@ -694,7 +1430,19 @@ public:
   void highlightsFor(std::uint32_t selStart, std::uint32_t selEnd,
                      std::uint32_t colour,
                      std::vector<render::HighlightRange> &out) const;
-  [[nodiscard]] size_t numPages() const { return pages.size(); }
+  [[nodiscard]] size_t numPages() const { return drawn().pages.size(); }
+
+  /**
+   * @brief The text on the pages drawn last frame, as a half-open range of
+   *        bytes, or nothing when none were.
+   *
+   * What a decorator over a large document confines itself to; see
+   * gleditor/span_decorator.hpp. A frame behind, since decorating comes before
+   * drawing, so a caller wanting nothing to appear late as the view moves
+   * should reach a little past either end.
+   */
+  [[nodiscard]] std::optional<std::pair<std::uint32_t, std::uint32_t>>
+  textInView() const;
 
   /**
    * @brief Ease this document into place and fade it in.
@@ -742,4 +1490,32 @@ public:
   friend class Page;
 };
 
+struct Page::Built {
+  /// The detailed draw's rows followed by the coarse draw's; see
+  /// Page::detailInstances.
+  std::vector<Doc::VBORow> rows;
+  std::vector<ClusterBox> clusters;
+  std::vector<gleditor::PageParagraph> paragraphs;
+  /// What each glyph row was reserved under, which is what the page cache
+  /// reserves it by again; the form is walkClusters()'s. Empty for a page read
+  /// back from the cache, which is not written again.
+  std::string glyphKeys;
+  /// What the page goes on holding of the glyphs it drew; see Page::citation,
+  /// Page::glyphOfRow and Page::glyphsAt.
+  std::shared_ptr<GlyphCitation> citation;
+  std::vector<std::uint32_t> glyphOfRow;
+  std::uint64_t glyphsAt{};
+  std::uint32_t detailInstances{};
+  /// Empty rows at the end of the detailed draw, handed to the pool as erased
+  /// so that a paragraph laid out again can grow into them.
+  std::uint32_t spareRows{};
+  std::uint32_t coarseInstances{};
+  std::uint32_t textBytes{};
+  float pageWidth{};
+  float pageHeight{};
+  float originX{};
+  float originY{};
+  bool shaped{};
+};
+
 #endif // GLEDITOR_DOC_H
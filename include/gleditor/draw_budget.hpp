@@ -19,6 +19,12 @@
 #include <glm/geometric.hpp>
 #include <limits>
 
+#include <gleditor/cull_tree.hpp>
+
+namespace gleditor {
+class PageImpostors;
+}
+
 /**
  * @brief How much of the frame a page is allowed to cost, and what it takes to
  *        decide that.
@@ -38,17 +44,43 @@ struct DrawBudget {
    * screen pixels a glyph feature gets". Zero disables the coarse path.
    */
   float coarseBelow{};
+  /**
+   * @brief Screen pixels per layout pixel below which a page, if not drawn
+   *        coarsely, is drawn as a picture of itself.
+   *
+   * The band between this and coarseBelow is where glyphs are too small to be
+   * worth a quad each and still large enough that bars would not pass for
+   * text. Zero, or no impostors, disables it.
+   */
+  float impostorBelow{};
+  /// Where the pictures are kept and asked for. Render thread only.
+  gleditor::PageImpostors *impostors{};
   /// Whether pages outside the view frustum are skipped.
   bool cull{true};
+  /// The frame being collected, which a page in or near the view is stamped
+  /// with so that it is not evicted; see gleditor/residency.hpp.
+  std::uint64_t frame{};
 };
 
 /// What one frame's collection decided, for reporting. Culling that is not
 /// counted is culling nobody can check.
 struct DrawStats {
-  std::uint32_t pages{};    ///< Pages considered.
-  std::uint32_t culled{};   ///< Skipped as entirely outside the view.
-  std::uint32_t coarse{};   ///< Drawn as solid bars rather than glyphs.
-  std::uint32_t detailed{}; ///< Drawn glyph by glyph.
+  std::uint32_t pages{};     ///< Pages considered.
+  std::uint32_t culled{};    ///< Skipped as entirely outside the view.
+  std::uint32_t coarse{};    ///< Drawn as solid bars rather than glyphs.
+  std::uint32_t detailed{};  ///< Drawn glyph by glyph.
+  std::uint32_t impostors{}; ///< Drawn as one quad showing a picture.
+  /// Nodes of the documents' page trees tested to find the pages in view; see
+  /// gleditor/cull_tree.hpp. What culling cost, where culled is what it saved.
+  std::uint32_t nodesVisited{};
+  /// Of those drawn, how many were blank because the page has not been built
+  /// yet -- which is what tells the loader to build them next.
+  std::uint32_t placeholders{};
+  /// In view with their rows on the device.
+  std::uint32_t resident{};
+  /// In view with their rows given back, so not drawn until they are built
+  /// again.
+  std::uint32_t evicted{};
 };
 
 /**
@@ -97,6 +129,28 @@ inline bool outsideFrustum(const glm::mat4 &mvp, const float halfW,
          allOutside([](const glm::vec4 &pos) { return pos.y > pos.w; });
 }
 
+/**
+ * @brief The side planes of the view, in the space @p mvp transforms from.
+ *
+ * The same four outsideFrustum() compares against, read off the rows of the
+ * matrix rather than applied to each corner: a point is left of the view when
+ * its clip x is below -w, which is the sum of the first and last rows being
+ * negative there. So a box is outside one of these planes exactly when
+ * outsideFrustum() would say so, and testing it costs no transform at all.
+ */
+inline gleditor::CullFrustum frustumPlanes(const glm::mat4 &mvp) {
+  const auto row = [&mvp](const int index) {
+    return glm::vec4(mvp[0][index], mvp[1][index], mvp[2][index],
+                     mvp[3][index]);
+  };
+  const auto plane = [](const glm::vec4 &coefficients) {
+    return gleditor::CullPlane{coefficients.x, coefficients.y, coefficients.z,
+                               coefficients.w};
+  };
+  return {plane(row(3) + row(0)), plane(row(3) - row(0)),
+          plane(row(3) + row(1)), plane(row(3) - row(1))};
+}
+
 /**
  * @brief Screen pixels one model unit covers at the origin of @p mvp.
  *
@@ -0,0 +1,51 @@
+/**
+ * @file edit_span.hpp
+ * @brief The text a burst of edits has disturbed, as one range and one shift.
+ *
+ * Every keystroke used to schedule a reflow of its own. Typing is faster than
+ * a frame often enough -- key repeat, a paste typed out by automation, a fast
+ * typist -- and a burst of five hundred characters queued five hundred reflows
+ * of the same page, each shaping it again to throw away what the one before
+ * had built.
+ *
+ * So edits between two reflows are merged. Everything before the first byte
+ * any of them touched is as it was; everything after the last byte any of them
+ * left changed is as it was, shifted by what they added and took away between
+ * them. That is all a reflow needs to know: where to start laying out, how far
+ * it has to go before pagination can be trusted to re-sync, and by how much
+ * the rest has moved.
+ */
+#ifndef GLEDITOR_EDIT_SPAN_H
+#define GLEDITOR_EDIT_SPAN_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace gleditor {
+
+struct EditSpan {
+  /// First byte any edit touched. Nothing before it has changed, so it is the
+  /// same offset before the edits as after.
+  std::uint32_t from{};
+  /// Just past the last byte any edit left changed, in the text as it is now.
+  /// Past here, the text is what it was before the edits, shifted by delta.
+  std::uint32_t to{};
+  /// Bytes the text grew by across every edit, negative when it shrank.
+  std::int64_t delta{};
+  /// Edits merged.
+  std::size_t edits{};
+
+  /// The span of one edit that replaced @p removed bytes at @p at with
+  /// @p inserted.
+  [[nodiscard]] static EditSpan of(std::uint32_t at, std::uint32_t removed,
+                                   std::uint32_t inserted);
+
+  /// Fold in an edit made after the ones already merged, at an offset into
+  /// the text as they left it.
+  void merge(std::uint32_t at, std::uint32_t removed, std::uint32_t inserted);
+};
+
+} // namespace gleditor
+
+#endif // GLEDITOR_EDIT_SPAN_H
+// vi: set sw=2 sts=2 ts=2 et:
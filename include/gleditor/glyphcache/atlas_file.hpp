@@ -0,0 +1,147 @@
+/**
+ * @file atlas_file.hpp
+ * @brief The glyph atlas kept on disk, so that a start is reading glyphs back
+ *        rather than drawing them again.
+ *
+ * Every start used to draw every glyph its documents asked for, although the
+ * last run had drawn the same glyphs in the same fonts with the same settings
+ * and packed them into an atlas it then threw away. A warm page cache makes
+ * this the larger part of opening a file: the pages come back from disk and
+ * then wait on their glyphs. So the cache writes the atlas down on the way
+ * out -- each layer's pixels, how its lanes are filled, where each glyph sits
+ * and what it was asked for under -- and the next run maps the file and
+ * uploads a layer at a time.
+ *
+ * A glyph is named by its cluster and its font's description, and neither
+ * says what the font file holds: an updated font keeps its name. So each font
+ * is written down with a fingerprint of its file, and the settings glyphs are
+ * drawn with go into the header; a file whose settings differ is never read,
+ * and the cache checks the fingerprints against the fonts as they are now
+ * before taking anything from it. A file that is short, or not one of these,
+ * is treated as absent.
+ *
+ * Only the layout of the file is here, with nothing of Pango or the device,
+ * so that it can be tested on its own. GlyphCache decides what goes in it.
+ */
+#ifndef GLEDITOR_GLYPH_ATLAS_FILE_H
+#define GLEDITOR_GLYPH_ATLAS_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// One atlas layer: which, how far up it is filled, and the filled part's
+/// pixels, imageWidth by usedHeight, lowest row first.
+struct AtlasPaletteRecord {
+  std::int32_t layer{};
+  std::int32_t usedHeight{};
+  /// Across the widest lane; nothing to its right has been packed.
+  std::int32_t imageWidth{};
+  std::uint32_t reserved{};
+  /// Where the pixels are in the file. Filled in by the writer.
+  std::uint64_t imageAt{};
+};
+
+/// One lane of a layer: which layer, by its index among the palettes, where
+/// it starts, how tall it is and how much of it is taken.
+struct AtlasLaneRecord {
+  std::uint32_t palette{};
+  std::int32_t yOffset{};
+  std::int32_t height{};
+  std::int32_t usedWidth{};
+};
+
+/// One glyph's padded box in its layer.
+struct AtlasPlacementRecord {
+  std::int32_t layer{};
+  std::int32_t x{};
+  std::int32_t y{};
+  std::int32_t width{};
+  std::int32_t height{};
+  std::uint32_t reserved{};
+};
+
+/// A font glyphs were drawn in: its casefolded description, as a range of
+/// the names, and the fingerprint of its file when they were.
+struct AtlasFontRecord {
+  std::uint64_t fingerprint{};
+  std::uint32_t nameAt{};
+  std::uint32_t nameBytes{};
+};
+
+/// What a cluster in a font was handed out as, and under which key.
+struct AtlasGlyphRecord {
+  std::uint32_t keyAt{};
+  std::uint32_t keyBytes{};
+  /// Index among the fonts.
+  std::uint32_t font{};
+  std::int32_t layer{};
+  /// Where the glyph sits, in texels, and its size in pixels.
+  float x{};
+  float y{};
+  float width{};
+  float height{};
+  std::int32_t pixelWidth{};
+  std::int32_t pixelHeight{};
+  float ink{};
+  std::uint32_t reserved{};
+};
+
+/**
+ * @brief An atlas as written, or as read back.
+ *
+ * The images are views: written from wherever the caller holds them, and
+ * read back where they lie in the mapped file, so that uploading a layer
+ * copies nothing on the way.
+ */
+struct AtlasFile {
+  /// Side length of each layer, and how many there are.
+  std::int32_t size{};
+  std::int32_t layers{};
+  std::vector<AtlasPaletteRecord> palettes;
+  std::vector<AtlasLaneRecord> lanes;
+  std::vector<AtlasPlacementRecord> placements;
+  std::vector<AtlasFontRecord> fonts;
+  std::vector<AtlasGlyphRecord> glyphs;
+  /// Font descriptions and glyph keys, which the records point into.
+  std::string names;
+  /// Each palette's pixels, in the same order as palettes.
+  std::vector<std::span<const std::byte>> images;
+
+  [[nodiscard]] std::string_view fontName(const AtlasFontRecord &font) const {
+    return std::string_view(names).substr(font.nameAt, font.nameBytes);
+  }
+  [[nodiscard]] std::string_view key(const AtlasGlyphRecord &glyph) const {
+    return std::string_view(names).substr(glyph.keyAt, glyph.keyBytes);
+  }
+};
+
+/**
+ * @brief Write @p atlas to @p file, drawn with @p settings.
+ *
+ * Under a temporary name, renamed into place once whole, so that a reader
+ * never sees half an atlas. Nothing here throws.
+ *
+ * @return Whether it is there.
+ */
+bool writeAtlasFile(const std::filesystem::path &file, const AtlasFile &atlas,
+                    std::uint64_t settings);
+
+/**
+ * @brief The atlas in @p bytes, if they are a whole one drawn with
+ *        @p settings.
+ *
+ * Every table is checked to lie inside the file, and every lane, placement
+ * and glyph inside the layer it names, so that nothing read back can send an
+ * upload or a sample outside the atlas.
+ */
+[[nodiscard]] std::optional<AtlasFile> readAtlasFile(std::string_view bytes,
+                                                     std::uint64_t settings);
+
+#endif // GLEDITOR_GLYPH_ATLAS_FILE_H
+// vi: set sw=2 sts=2 ts=2 et:
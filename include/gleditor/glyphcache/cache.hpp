@@ -4,25 +4,30 @@
  *
  * Exposes a GlyphCache used by rendering code to request glyph texture
  * coordinates for character clusters in specific fonts. Internally, the cache
- * uses GlyphPalette and GlyphLane to bin-pack rectangles and maintains a
- * per-font map of cached entries. All device interaction goes through
- * RenderDevice, so the cache is the same on every backend.
+ * uses GlyphPalette and GlyphLane to bin-pack rectangles, and files what it
+ * has handed out in a GlyphTable by font and cluster. All device interaction
+ * goes through RenderDevice, so the cache is the same on every backend.
  */
 #ifndef GLEDITOR_GLYPH_CACHE_H
 #define GLEDITOR_GLYPH_CACHE_H
 
-#include <compare>
 #include <cstddef>
-#include <functional>
+#include <cstdint>
+#include <filesystem>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <pangomm/font.h>
 
 #include "glibmm/refptr.h"
-#include "glibmm/ustring.h"
+#include <gleditor/glyphcache/citation.hpp>
+#include <gleditor/glyphcache/glyph_table.hpp>
 #include <gleditor/glyphcache/palette.hpp>
+#include <gleditor/glyphcache/raster.hpp>
 #include <gleditor/glyphcache/types.hpp>
 #include <gleditor/log.hpp>
 #include <gleditor/render/types.hpp>
+#include <span>
 #include <string>
 #include <string_view>
 #include <unordered_map>
@@ -31,122 +36,18 @@
 
 namespace render {
 class RenderDevice;
-}
-
-/**
- * @brief Helper for creating an overload set of call operators.
- *
- * Useful together with std::variant visitation and transparent hashing to
- * combine multiple functors into one.
- */
-template <typename... Bases> struct overload : Bases... {
-  using is_transparent = void;
-  using Bases::operator()...;
-};
-
-/**
- * @brief Transparent hasher for raw C string pointers.
- * Allows unordered_map with heterogeneous lookup using const char*.
- */
-struct char_pointer_hash {
-  auto operator()(const char *ptr) const noexcept {
-    return std::hash<std::string_view>{}(ptr);
-  }
-};
-
-/// Transparent string hasher enabling heterogeneous lookup on std::string,
-/// std::string_view, and const char*.
-using transparent_string_hash =
-    overload<std::hash<std::string>, std::hash<std::string_view>,
-             char_pointer_hash>;
+class WorkerPool;
+} // namespace render
 
 /// Shared pointer alias to a Pango font instance.
 using FontPtr = Glib::RefPtr<Pango::Font>;
 
-/**
- * @class FontMapKeyAdapter
- * @brief Compares Pango::Font objects by their fully described absolute size
- * strings.
- *
- * Provides a strict-weak-ordering and hash based on the casefolded string
- * from Pango's describe_with_absolute_size(). Useful as a key in maps.
- */
-class FontMapKeyAdapter {
-private:
-  FontPtr font_;
-  /**
-   * @brief The casefolded description, worked out once here.
-   *
-   * Describing a font, printing the description and casefolding the result are
-   * three allocations, and this used to do all three on every comparison --
-   * twice, once for each side -- and again for every hash. A hash lookup does
-   * that once to find the bucket and once more per key already in it, so the
-   * cost fell on the cache's hottest path: a glyph is looked up per cluster
-   * per page.
-   *
-   * Held as bytes rather than as a ustring because what is wanted of it is
-   * equality, and casefolding is what makes byte equality the right question.
-   */
-  std::string key_;
-  /// Worked out with the key, so that a probe that will fail usually fails on
-  /// a size_t comparison rather than on a string one.
-  std::size_t hash_;
-
-public:
-  explicit FontMapKeyAdapter(FontPtr font)
-      : font_(std::move(font)),
-        key_(font_->describe_with_absolute_size().to_string().casefold().raw()),
-        hash_(std::hash<std::string>{}(key_)) {}
-  FontMapKeyAdapter(const FontMapKeyAdapter &oth)            = default;
-  FontMapKeyAdapter &operator=(const FontMapKeyAdapter &oth) = default;
-  FontMapKeyAdapter(FontMapKeyAdapter &&oth)                 = default;
-  FontMapKeyAdapter &operator=(FontMapKeyAdapter &&oth)      = default;
-
-  /**
-   * @brief Access the underlying Pango font reference.
-   */
-  [[nodiscard]] const FontPtr &font() const { return font_; }
-
-  /// The casefolded description this compares and hashes by.
-  [[nodiscard]] const std::string &key() const { return key_; }
-  [[nodiscard]] std::size_t hash() const { return hash_; }
-
-  /**
-   * @brief Equality based on casefolded absolute-size font description.
-   */
-  bool operator==(const FontMapKeyAdapter &oth) const {
-    return hash_ == oth.hash_ && key_ == oth.key_;
-  }
-
-  /**
-   * @brief Three-way comparison using the casefolded font description.
-   *
-   * Byte order over the casefolded description, where this used to use
-   * g_utf8_collate. Nothing orders these -- they are keys of an unordered_map
-   * and only equality is ever asked for -- and collation answers a question
-   * about how a person would sort names, at a price this path cannot pay.
-   * Casefolded equality is unchanged, which is the part anything relies on.
-   */
-  std::partial_ordering operator<=>(const FontMapKeyAdapter &oth) const {
-    return key_ <=> oth.key_;
-  }
-};
-
-/**
- * @brief std::hash specialization for FontMapKeyAdapter based on font
- * description.
- */
-template <> struct std::hash<FontMapKeyAdapter> {
-  std::size_t operator()(const FontMapKeyAdapter &adapter) const noexcept {
-    return adapter.hash();
-  }
-};
-
 /**
  * @class GlyphCache
  * @brief Caches rendered glyphs into a device array texture and returns UVs.
  *
- * GlyphCache uses Pango/Cairo to rasterize text for a given Pango::Font,
+ * GlyphCache uses Cairo to rasterize a cluster's glyphs in a given
+ * Pango::Font, or Pango to lay its text out when only the text is known,
  * converts the result to single-channel coverage, and packs it into a layered
  * texture via GlyphPalette. The put() API returns texture coordinates, in
  * texels, and pixel dimensions for rendering.
@@ -156,9 +57,32 @@ template <> struct std::hash<FontMapKeyAdapter> {
  * because doubling a layer buys four times the room where a second layer buys
  * two. Nothing already packed moves when it grows, which is what lets the
  * coordinates already written into a page's vertex buffer stay correct.
+ *
+ * Glyphs are asked for from loader threads as well as the render thread, and
+ * only the render thread may touch the device. So a glyph is handed out in two
+ * steps. reserve() rasterises it and decides where it goes -- including
+ * deciding that the atlas will have to grow to hold it -- and its coordinates
+ * are final from that moment, which is all a page needs to write its rows.
+ * commit() then does what that needs of the device: it grows the texture to
+ * what the reservations planned and uploads every glyph reserved since it
+ * last ran. A glyph can be reserved long before it can be sampled, and the
+ * render thread commits before it draws anything.
+ *
+ * Growth stops at the hardware's largest layer and at maxEncodableLayers.
+ * Past that, a glyph that will not fit evicts glyphs instead: those no
+ * GlyphCitation holds and nothing has asked for since the last commit(),
+ * least recently used first, until a share of the atlas is free. Then the
+ * survivors are packed again from scratch, tallest first, because what the
+ * evicted glyphs leave is holes between lanes that nothing new would fit.
+ * That moves glyphs, which is the one thing growing never does, so a repack
+ * is counted: a holder notes repacks() before it reserves, and once
+ * committedRepacks() has passed that, asks lookUp() where its glyphs are now
+ * and rewrites its rows. Sessions of any length keep to the ceiling that way.
  */
 class GlyphCache : public Loggable {
 public:
+  /// The glyph number of a blank glyph, which takes no room in the atlas.
+  static constexpr std::uint32_t noGlyph = 0xFFFFFFFF;
   /**
    * @brief Return values for a cached glyph.
    * texCoords locate the glyph in its layer, in texels; dims are the pixel
@@ -185,6 +109,16 @@ public:
      * without anything being assumed about the typeface.
      */
     float ink{};
+    /**
+     * @brief The glyph's number, which lookUp() finds it by after a repack,
+     *        or noGlyph when it is blank.
+     *
+     * The cluster and font it was asked for are what name it to the cache,
+     * but a holder of rows would have to keep both for every row to ask
+     * again. A number is four bytes, and stays the glyph's for as long as
+     * anything cites it.
+     */
+    std::uint32_t glyph{noGlyph};
   };
   /**
    * @brief Construct the glyph cache and allocate its device array texture.
@@ -207,28 +141,133 @@ public:
   GlyphCache(GlyphCache &oth)           = delete;
   void operator=(const GlyphCache &oth) = delete;
 
-  /// Longest cluster the cache will key on. Long enough for emoji sequences
-  /// joined by zero-width joiners; a bound only so that a pathological run
-  /// cannot become a cache key.
+  /// Longest key the cache will take. Long enough for emoji sequences joined
+  /// by zero-width joiners, and for a shaped key of maxShapedGlyphs glyphs; a
+  /// bound only so that a pathological run cannot become a cache key.
   static constexpr std::size_t maxClusterBytes = 64;
 
   /**
    * @brief Retrieve or create a glyph entry for one shaped cluster.
-   * @param chr UTF-8 text of a whole cluster -- a ligature, or a base
-   *            character with its combining marks -- rasterised as a unit so
-   *            that what is drawn matches what Pango shaped.
-   * @param font Loaded Pango font to use for rasterization.
+   * @param chr What names the cluster: the glyphs its page shaped it into, as
+   *            a key made by appendShapedKey(), or the UTF-8 text of the whole
+   *            cluster -- a ligature, or a base character with its combining
+   *            marks -- to be laid out and drawn as a unit.
+   * @param font Loaded Pango font to use for rasterization: for a shaped key,
+   *             the font its glyph IDs are in.
+   * @param citing Cites the glyph, when given, until it lets go.
    * @return Sizes with texel coordinates and pixel dimensions.
    * @throws std::invalid_argument if the cluster exceeds maxClusterBytes.
+   *
+   * Render thread only: reserve() and then commit().
    */
-  Sizes put(const std::string_view &chr, const FontPtr &font);
+  Sizes put(const std::string_view &chr, const FontPtr &font,
+            GlyphCitation *citing = nullptr);
+
+  /**
+   * @brief Retrieve a glyph, or rasterise and place one, without touching the
+   *        device.
+   *
+   * Safe from any thread, and from several at once; the rasterising is done
+   * outside the lock, so loader threads only queue for the packing. What comes
+   * back is where the glyph will be, and stays true until the next repack,
+   * but nothing can sample it there until the render thread has called
+   * commit(). A glyph nothing cites is only safe from eviction until the
+   * commit() after next.
+   *
+   * @throws std::invalid_argument if the cluster exceeds maxClusterBytes.
+   * @throws std::overflow_error if no atlas the device allows could hold it,
+   *         even with every glyph nothing cites evicted.
+   */
+  Sizes reserve(const std::string_view &chr, const FontPtr &font,
+                GlyphCitation *citing = nullptr);
+
+  /**
+   * @brief reserve() for every cluster of @p clusters at once, in order.
+   *
+   * What a page being built asks for: every cluster it draws, most of them
+   * already cached and the rest drawn together. The misses are drawn once
+   * each however often they repeat, spread across a pool of threads when
+   * there are enough of them to be worth it and no other batch has the pool,
+   * and packed under one hold of the lock.
+   *
+   * @throws std::invalid_argument if a cluster exceeds maxClusterBytes.
+   * @throws std::overflow_error if no atlas the device allows could hold one.
+   */
+  std::vector<Sizes> reserveAll(std::span<const std::string_view> clusters,
+                                const FontPtr &font,
+                                GlyphCitation *citing = nullptr);
+
+  /**
+   * @brief Make every reserved glyph real: grow the texture to what the
+   *        reservations planned, and upload whatever has not been.
+   *
+   * Render thread only. flush() calls it, so a frame never samples a glyph
+   * that was only reserved.
+   */
+  void commit();
+
+  /**
+   * @brief Write the atlas down to @p file for restore() to take up on the
+   *        next run: every glyph's pixels, where it sits, and what it was
+   *        asked for under.
+   *
+   * Render thread, with nothing still reserving. Nothing is written when no
+   * glyph has arrived since the atlas was restored or last saved, so that a
+   * run which drew nothing new leaves the file as it was. Glyphs in a font
+   * whose file cannot be fingerprinted are left out, since they could never
+   * be trusted on the way back in.
+   *
+   * @return Whether it was written.
+   */
+  bool save(const std::filesystem::path &file) const;
+
+  /**
+   * @brief Take up the atlas save() wrote to @p file, uploading it a layer at
+   *        a time, so that its glyphs are hits rather than drawn again.
+   *
+   * Only before anything has been reserved, and only an atlas drawn with
+   * today's rasterSettings(), in fonts whose fontFingerprint() is what it was,
+   * that this device can hold. Anything else -- including no file -- leaves
+   * the cache as it was; the file is an optimisation, and failing to use one
+   * is never an error. Render thread only.
+   *
+   * @return Whether the atlas was taken up.
+   */
+  bool restore(const std::filesystem::path &file);
+
+  /**
+   * @brief Repacks planned so far, counting any commit() has yet to make.
+   *
+   * What a holder of rows notes before it reserves the glyphs they name: if
+   * committedRepacks() is ever anything else, some of them may have moved.
+   * Any thread.
+   */
+  [[nodiscard]] std::uint64_t repacks() const;
+  /// Repacks the texture has been through, as of the last commit(). Render
+  /// thread only.
+  [[nodiscard]] std::uint64_t committedRepacks() const { return repacksDone; }
+
+  /**
+   * @brief Where each glyph numbered in @p glyphs is in the texture now, into
+   *        the same place in @p into.
+   *
+   * A blank glyph, or one no longer held, comes back as Sizes{}. Nothing
+   * comes back while a repack is planned that commit() has not made: the
+   * rows would then name a layout the texture does not have yet.
+   *
+   * @return The committedRepacks() the answer is for.
+   */
+  std::optional<std::uint64_t> lookUp(std::span<const std::uint32_t> glyphs,
+                                      std::span<Sizes> into) const;
 
   /// Handle of the array texture holding every cached glyph.
   [[nodiscard]] render::TextureHandle textureHandle() const { return texture; }
 
-  /// Side length of each atlas layer as it stands. Grows as glyphs arrive.
+  /// Side length of each atlas layer as allocated, which is as of the last
+  /// commit(). Grows as glyphs arrive. Render thread only.
   [[nodiscard]] int atlasSize() const { return size; }
-  /// Array layers allocated as it stands. Grows once the side length cannot.
+  /// Array layers allocated as of the last commit(). Grows once the side
+  /// length cannot. Render thread only.
   [[nodiscard]] int atlasLayers() const { return layerCount; }
   /// Ceilings growth stops at: the hardware's, narrowed by what a vertex can
   /// name.
@@ -236,8 +275,8 @@ public:
   [[nodiscard]] int atlasMaxLayers() const { return maxLayers; }
 
   /**
-   * @brief Rebuild the atlas mip chain if any glyph has been added since the
-   *        last call.
+   * @brief Commit what has been reserved, then rebuild the atlas mip chain if
+   *        any glyph has been added since the last call.
    *
    * Called once per frame rather than once per glyph: loading a document adds
    * thousands of clusters between two frames, and the chain only has to be
@@ -247,6 +286,18 @@ public:
   void flush();
 
 private:
+  /// Citation counts and recency, shared with every GlyphCitation.
+  std::shared_ptr<GlyphLedger> ledger;
+  /**
+   * @brief Held over everything reserve() and commit() share: the maps, the
+   *        palettes, the placements, the planned atlas size and the ledger.
+   *
+   * The ledger's, so that a citation can let go under it. The texture itself
+   * and the size it was allocated at are the render thread's alone, and are
+   * not behind it.
+   */
+  std::mutex &guard;
+
   std::vector<GlyphPalette> palettes; ///< Palette layers used for packing.
 
   /**
@@ -270,56 +321,130 @@ private:
     int width{};
     int height{};
     std::vector<std::byte> coverage;
+    /// The glyph placed here, or noGlyph for one read back from a file that
+    /// nothing is filed under any more.
+    std::uint32_t glyph{noGlyph};
   };
   std::vector<Placement> placements;
+  /// How many of @ref placements are on the device. The rest were reserved
+  /// since the last commit().
+  std::size_t uploaded{};
+
+  /// A placed glyph, by number: what it is filed under, and where it sits.
+  struct Held {
+    std::uint32_t font{};
+    std::string key;
+    std::size_t placement{};
+    bool live{};
+  };
+  std::vector<Held> held;
+  /// Numbers of evicted glyphs, handed out again before new ones.
+  std::vector<std::uint32_t> freeNumbers;
+  /// Repacks planned, and made by commit(). @ref repacksPlanned is ahead from
+  /// a repack until the next commit(), which reallocates to make it.
+  std::uint64_t repacksPlanned{}, repacksDone{};
 
   /// Reallocate the atlas at @p newSize / @p newLayers and put every glyph back
-  /// where it was.
+  /// where it was. Render thread only, with the guard held.
   void reallocate(int newSize, int newLayers);
-  /// Make room for a padded glyph box, growing the atlas if that is what it
-  /// takes. Throws when neither the size nor the layer count can grow further.
+  /// Make room for a padded glyph box, planning a larger atlas if that is what
+  /// it takes -- which commit() then allocates -- and evicting and repacking
+  /// once it cannot grow. Throws when none of that makes room.
   void makeRoomFor(const Rect &padded);
   /**
-   * @brief The key for @p font, worked out once per font rather than per
-   *        lookup.
+   * @brief Evict the least recently used glyphs nothing cites, until a share
+   *        of the atlas and at least @p padded is free, and pack the rest
+   *        again. With the guard held.
    *
-   * Building a key describes the font and prints the description, and printing
-   * it formats the size as a float -- which is glibc's floating point printf,
-   * and it showed up in a profile as several percent of a whole document load.
-   * A cluster is looked up per glyph per page and every one of those was
-   * building the same key from the same font.
+   * The repack is worked out on fresh palettes and only taken up if every
+   * survivor fits, so a failure leaves the cache as it was.
    *
-   * Keyed on the font's address, though what a key *means* is still its
-   * description: two font objects describing the same font produce equal keys
-   * here as they always did, so nothing about cache hits changes. This only
-   * avoids working the description out again for a font already seen.
+   * @return Whether anything was evicted.
    */
-  const FontMapKeyAdapter &keyFor(const FontPtr &font);
+  bool reclaim(const Rect &padded);
+  /// A number for a glyph about to be filed under @p font and @p key, placed
+  /// at @p placement. With the guard held.
+  std::uint32_t numberGlyph(std::uint32_t font, std::string_view key,
+                            std::size_t placement);
+  /// Note that @p glyph was handed out, under @p citing if that is given.
+  /// With the guard held.
+  void handOut(std::uint32_t glyph, GlyphCitation *citing);
+  /// The cached glyph for @p chr in font @p font, or null. With the guard
+  /// held. Allocates nothing.
+  [[nodiscard]] const Sizes *cached(std::string_view chr,
+                                    std::uint32_t font) const;
+  /**
+   * @brief The number @p font's glyphs are filed under, worked out once per
+   *        font object rather than per lookup. With the guard held.
+   *
+   * Numbering a font describes it and prints the description, and printing it
+   * formats the size as a float -- which is glibc's floating point printf, and
+   * it showed up in a profile as several percent of a whole document load. A
+   * cluster is looked up per glyph per page, and every one of those used to
+   * work out the same description from the same font.
+   *
+   * What a number *means* is still the casefolded description: two font
+   * objects describing the same font get the same number, so nothing about
+   * cache hits changes. The font looked up last is remembered beside the
+   * map, since a page asks for one font for cluster after cluster.
+   */
+  std::uint32_t fontIdOf(const FontPtr &font);
+  /// The number for the casefolded @p description, handed out the first time
+  /// it is asked for. With the guard held.
+  std::uint32_t internFont(const std::string &description);
 
-  /// Keys by font address. Holds a reference to each font through the adapter,
-  /// so an address used as a key cannot be reused by a different font.
-  std::unordered_map<const Pango::Font *, FontMapKeyAdapter> fontKeys;
-  std::unordered_map<std::string, std::unordered_map<FontMapKeyAdapter, Sizes>,
-                     transparent_string_hash, std::equal_to<>>
-      glyphs; ///< Map: character string -> (font -> cached sizes).
+  /// A font object as the cache knows it. Held, so an address used as a key
+  /// cannot be reused by a different font.
+  struct KnownFont {
+    FontPtr font;
+    std::uint32_t id{};
+  };
+  std::unordered_map<const Pango::Font *, KnownFont> fontsByAddress;
+  const Pango::Font *lastFont{};
+  std::uint32_t lastFontId{};
+  /// Numbers by casefolded description, and descriptions by number. A font
+  /// read back from disk has a number before any font object describes it.
+  std::unordered_map<std::string, std::uint32_t> fontIds;
+  std::vector<std::string> fontNames;
+  /// What has been handed out, by font number and cluster.
+  GlyphTable<Sizes, maxClusterBytes> glyphs;
   render::RenderDevice *device;    ///< Device the atlas lives on.
   render::TextureHandle texture{}; ///< Array texture holding the glyph atlas.
   int size{};                      ///< Current side length of each atlas layer.
   int layerCount{};                ///< Array layers currently allocated.
+  /// What the reservations so far need the atlas to be. Ahead of size and
+  /// layerCount between a reservation that grows it and the next commit().
+  int plannedSize{}, plannedLayers{};
   /// Ceilings growth stops at: what the hardware reports, narrowed by what the
   /// vertex encoding can address.
   int maxSize{}, maxLayers{};
   /// A glyph has been written to level zero since the mip chain was last built.
   bool atlasDirty{};
+  /// Glyphs added since the atlas was restored or saved. Mutable because
+  /// saving is not a change to the cache.
+  mutable std::size_t unsaved{};
 
   /**
    * @brief Find or create a palette capable of fitting the given rectangle.
    */
   auto getBestPalette(const Rect &charBox);
   /**
-   * @brief Rasterize and pack a new glyph into the cache.
+   * @brief Pack a glyph that has been rasterised into @p coverage, @p width by
+   *        @p height, and record it. With the guard held.
    */
-  Sizes addToCache(const std::string &chr, const FontPtr &font);
+  Sizes addToCache(std::string_view chr, std::uint32_t font, int width,
+                   int height, std::vector<std::byte> coverage);
+  /// Draw @p missed in @p font for reserveAll(), on the pool if it is free.
+  /// Without the guard.
+  std::vector<GlyphRaster> rasterise(const std::vector<std::string> &missed,
+                                     const FontPtr &font);
+
+  /// Held by the batch using @ref rasterisers. Apart from the guard, which
+  /// must not be held while drawing.
+  std::mutex rasterising;
+  /// Threads a batch of misses is drawn on, started by the first batch large
+  /// enough to want them.
+  std::unique_ptr<render::WorkerPool> rasterisers;
 };
 
 #endif // GLEDITOR_GLYPH_CACHE_H
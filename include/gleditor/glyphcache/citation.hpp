@@ -0,0 +1,79 @@
+/**
+ * @file citation.hpp
+ * @brief Which glyphs something drawing from the atlas has written into its
+ *        rows, so that the glyph cache evicts none of them while it draws.
+ *
+ * The atlas has a ceiling -- sixty-four layers, as far as the vertex encoding
+ * can name -- and a long session of documents in many fonts and sizes reaches
+ * it. Once it has, the cache makes room by dropping glyphs nobody draws any
+ * more. A page, a toast or a canvas cites each glyph it asks for, and lets go
+ * of them all at once when it stops drawing them: when a page is evicted or
+ * rebuilt, when a toast expires, when a canvas is cleared. A glyph nothing
+ * cites can go.
+ */
+#ifndef GLEDITOR_GLYPH_CITATION_H
+#define GLEDITOR_GLYPH_CITATION_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief What the glyph cache shares with every citation of its glyphs.
+ *
+ * Apart from the cache, because a citation can outlive it: a page built on a
+ * loader thread at shutdown may still be sitting in a queue when the atlas is
+ * gone. Letting go then takes a lock that still exists and changes counts no
+ * one reads.
+ */
+struct GlyphLedger {
+  /// The glyph cache's lock, over everything its threads share as well as
+  /// these counts, so that citing is done under the hold a lookup already
+  /// takes.
+  std::mutex guard;
+  /// How many citations each glyph has, by its number.
+  std::vector<std::uint32_t> citations;
+  /// The clock when each glyph was last handed out or let go of: the least
+  /// recently used go first.
+  std::vector<std::uint64_t> lastUsed;
+  /// The last citation to cite each glyph, by serial, so that one asking for
+  /// the same glyph a thousand times cites it once.
+  std::vector<std::uint64_t> citedBy;
+  /// Ticks once per GlyphCache::commit(), which is once per frame.
+  std::uint64_t clock{};
+  /// Serials handed out so far. Zero is no citation.
+  std::uint64_t serials{};
+};
+
+/**
+ * @class GlyphCitation
+ * @brief The glyphs one holder of rows draws, kept from eviction until it
+ *        lets go of them.
+ *
+ * Passed to GlyphCache::reserve(), reserveAll() or put(), which cite every
+ * glyph they hand out under it. Used by one thread at a time, like the rows
+ * it speaks for. Lets go when destroyed.
+ */
+class GlyphCitation {
+public:
+  GlyphCitation() = default;
+  ~GlyphCitation() { release(); }
+  GlyphCitation(const GlyphCitation &)            = delete;
+  GlyphCitation &operator=(const GlyphCitation &) = delete;
+
+  /// Let go of every glyph cited, leaving this free to cite afresh.
+  void release();
+  /// Whether anything is cited.
+  [[nodiscard]] bool empty() const { return glyphs.empty(); }
+
+private:
+  friend class GlyphCache;
+  std::shared_ptr<GlyphLedger> ledger;
+  std::uint64_t serial{};
+  /// Each glyph cited, by number; once each, nearly always.
+  std::vector<std::uint32_t> glyphs;
+};
+
+#endif // GLEDITOR_GLYPH_CITATION_H
+// vi: set sw=2 sts=2 ts=2 et:
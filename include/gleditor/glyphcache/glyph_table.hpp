@@ -0,0 +1,261 @@
+/**
+ * @file glyph_table.hpp
+ * @brief The glyph cache's index: one flat table from a font and a cluster to
+ *        what was handed out for them.
+ *
+ * Every cluster of every page is looked up here, and nearly every lookup is a
+ * hit. It used to be a map from the cluster's text to a map from a font key
+ * to the glyph -- two hash lookups, each a walk along a bucket's chain of
+ * separately allocated nodes, and the inner one comparing font keys that held
+ * a casefolded description apiece -- behind a third, from the font's address
+ * to its key. A font is now a small number the cache hands out once, and the
+ * cluster is held in the slot itself, so a lookup is one hash of the cluster's
+ * bytes and a probe of one flat array.
+ *
+ * The table is open addressing with a control byte per slot, as SwissTable
+ * lays it out: the byte says the slot is empty, or holds seven bits of the
+ * hash of whatever is in it. A probe compares sixteen control bytes with the
+ * seven bits at once -- SSE2 on x86, NEON on ARM, a byte at a time elsewhere
+ * -- and only looks at a slot whose byte matched, so a hit is nearly always
+ * one comparison of a cluster, and a miss usually none. Nothing is allocated
+ * on a lookup, and nothing on an insert that does not grow the table.
+ *
+ * An entry is removed by leaving a tombstone, a control byte that is neither
+ * empty nor full: a probe passes over it, since something filed after it may
+ * lie beyond, and an insert takes it back. The cache removes glyphs only when
+ * the atlas is full and it evicts a batch of them at once, so tombstones are
+ * few, and growing -- or refiling at the same size, when it is mostly
+ * tombstones that filled it -- clears them all.
+ */
+#ifndef GLEDITOR_GLYPH_TABLE_H
+#define GLEDITOR_GLYPH_TABLE_H
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace glyph_table {
+
+/// Slots a probe compares at once, and the most control bytes it reads.
+inline constexpr std::size_t groupWidth = 16;
+/// The control byte of a slot with nothing in it. Any full slot's byte has
+/// the top bit clear.
+inline constexpr std::uint8_t emptyControl = 0x80;
+/// The control byte of a slot whose entry was removed.
+inline constexpr std::uint8_t deletedControl = 0xFE;
+
+/**
+ * @brief Which of the groupWidth control bytes from @p group are @p control,
+ *        as a bit each, the first byte lowest.
+ *
+ * The one thing here done a vector at a time.
+ */
+[[nodiscard]] std::uint32_t matchControl(const std::uint8_t *group,
+                                         std::uint8_t control);
+
+/// The hash a cluster of font @p font is filed under. Its low seven bits are
+/// its control byte, and the rest say where its probe starts.
+[[nodiscard]] std::size_t hashCluster(std::uint32_t font,
+                                      std::string_view cluster);
+
+} // namespace glyph_table
+
+/**
+ * @brief A map from a font number and a cluster of at most @p MaxBytes bytes
+ *        to a @p Value, in one flat array.
+ */
+template <typename Value, std::size_t MaxBytes> class GlyphTable {
+public:
+  /// Clusters longer than this cannot be held; the caller refuses them first.
+  static constexpr std::size_t maxBytes = MaxBytes;
+
+  GlyphTable() { reset(glyph_table::groupWidth); }
+
+  /// The value for @p cluster in @p font, or null. Allocates nothing.
+  [[nodiscard]] const Value *find(const std::uint32_t font,
+                                  const std::string_view cluster) const {
+    const auto found =
+        locate(glyph_table::hashCluster(font, cluster), font, cluster);
+    return found.second ? &slots[found.first].value : nullptr;
+  }
+  /// The same, to be changed in place.
+  [[nodiscard]] Value *find(const std::uint32_t font,
+                            const std::string_view cluster) {
+    return const_cast<Value *>(std::as_const(*this).find(font, cluster));
+  }
+
+  /**
+   * @brief File @p value under @p cluster in @p font, unless something is
+   *        already there.
+   * @return What is filed there now, and whether it is @p value.
+   */
+  std::pair<const Value *, bool> insert(const std::uint32_t font,
+                                        const std::string_view cluster,
+                                        const Value &value) {
+    const auto hash = glyph_table::hashCluster(font, cluster);
+    if (const auto found = locate(hash, font, cluster); found.second) {
+      return {&slots[found.first].value, false};
+    }
+    // Grown at seven eighths full, tombstones counted: past that, probes
+    // lengthen quickly, and there must always be an empty slot for a probe to
+    // stop at. Refiled at the same size when half of that is tombstones.
+    if ((count + buried + 1) * 8 > capacity() * 7) {
+      reset((count + 1) * 2 > capacity() ? capacity() * 2 : capacity());
+    }
+    const auto at = vacancy(hash);
+    if (glyph_table::deletedControl == control[at]) {
+      buried--;
+    }
+    auto &slot  = slots[at];
+    slot.font   = font;
+    slot.length = static_cast<std::uint8_t>(cluster.size());
+    std::memcpy(slot.bytes.data(), cluster.data(), cluster.size());
+    slot.value = value;
+    setControl(at, controlOf(hash));
+    count++;
+    return {&slot.value, true};
+  }
+
+  /// Remove what is filed under @p cluster in @p font, if anything is.
+  /// @return Whether something was.
+  bool erase(const std::uint32_t font, const std::string_view cluster) {
+    const auto found =
+        locate(glyph_table::hashCluster(font, cluster), font, cluster);
+    if (!found.second) {
+      return false;
+    }
+    slots[found.first] = Slot{};
+    setControl(found.first, glyph_table::deletedControl);
+    count--;
+    buried++;
+    return true;
+  }
+
+  [[nodiscard]] std::size_t size() const { return count; }
+  [[nodiscard]] bool empty() const { return 0 == count; }
+
+  /// Call @p visit with the font, the cluster and the value of every entry,
+  /// in no particular order.
+  template <typename Visit> void forEach(Visit &&visit) const {
+    for (std::size_t i = 0; i < capacity(); i++) {
+      if (isFull(control[i])) {
+        const auto &slot = slots[i];
+        visit(slot.font, std::string_view(slot.bytes.data(), slot.length),
+              slot.value);
+      }
+    }
+  }
+
+private:
+  struct Slot {
+    std::uint32_t font{};
+    std::uint8_t length{};
+    std::array<char, MaxBytes> bytes{};
+    Value value{};
+  };
+  static_assert(MaxBytes <= 0xFF, "a slot counts its cluster in a byte");
+
+  /// A control byte per slot, then the first groupWidth - 1 of them again, so
+  /// that a group starting near the end reads on round to the beginning
+  /// without a second load.
+  std::vector<std::uint8_t> control;
+  std::vector<Slot> slots;
+  std::size_t count{};
+  /// Slots holding a tombstone.
+  std::size_t buried{};
+
+  [[nodiscard]] std::size_t capacity() const { return slots.size(); }
+
+  static std::uint8_t controlOf(const std::size_t hash) {
+    return static_cast<std::uint8_t>(hash & 0x7F);
+  }
+  static bool isFull(const std::uint8_t byte) { return 0 == (byte & 0x80); }
+
+  void setControl(const std::size_t slot, const std::uint8_t byte) {
+    control[slot] = byte;
+    if (slot < glyph_table::groupWidth - 1) {
+      control[capacity() + slot] = byte;
+    }
+  }
+
+  /**
+   * @brief Where @p cluster in @p font, whose hashCluster() is @p hash, is,
+   *        or the empty slot its probe ends at.
+   *
+   * Groups are visited at triangular steps, which on a power-of-two table
+   * reaches every group before repeating one.
+   */
+  [[nodiscard]] std::pair<std::size_t, bool>
+  locate(const std::size_t hash, const std::uint32_t font,
+         const std::string_view cluster) const {
+    const auto tag  = controlOf(hash);
+    const auto mask = capacity() - 1;
+    auto pos        = (hash >> 7) & mask;
+    for (std::size_t step = glyph_table::groupWidth;;
+         step += glyph_table::groupWidth) {
+      const auto *const group = control.data() + pos;
+      for (auto hits = glyph_table::matchControl(group, tag); 0 != hits;
+           hits &= hits - 1) {
+        const auto at = (pos + std::countr_zero(hits)) & mask;
+        const auto &slot = slots[at];
+        if (slot.font == font && slot.length == cluster.size() &&
+            0 == std::memcmp(slot.bytes.data(), cluster.data(),
+                             cluster.size())) {
+          return {at, true};
+        }
+      }
+      if (const auto empties =
+              glyph_table::matchControl(group, glyph_table::emptyControl);
+          0 != empties) {
+        return {(pos + std::countr_zero(empties)) & mask, false};
+      }
+      pos = (pos + step) & mask;
+    }
+  }
+
+  /// The first slot along @p hash's probe that is empty or a tombstone: where
+  /// something not in the table goes.
+  [[nodiscard]] std::size_t vacancy(const std::size_t hash) const {
+    const auto mask = capacity() - 1;
+    auto pos        = (hash >> 7) & mask;
+    for (std::size_t step = glyph_table::groupWidth;;
+         step += glyph_table::groupWidth) {
+      const auto *const group = control.data() + pos;
+      auto free = glyph_table::matchControl(group, glyph_table::emptyControl);
+      if (0 != buried) {
+        free |= glyph_table::matchControl(group, glyph_table::deletedControl);
+      }
+      if (0 != free) {
+        return (pos + std::countr_zero(free)) & mask;
+      }
+      pos = (pos + step) & mask;
+    }
+  }
+
+  /// Start again at @p slotCount slots, a power of two, with every entry
+  /// filed anew and no tombstones.
+  void reset(const std::size_t slotCount) {
+    const auto oldControl = std::move(control);
+    const auto oldSlots   = std::move(slots);
+    slots.assign(slotCount, Slot{});
+    control.assign(slotCount + glyph_table::groupWidth - 1,
+                   glyph_table::emptyControl);
+    count  = 0;
+    buried = 0;
+    for (std::size_t i = 0; i < oldSlots.size(); i++) {
+      if (isFull(oldControl[i])) {
+        const auto &slot = oldSlots[i];
+        insert(slot.font, std::string_view(slot.bytes.data(), slot.length),
+               slot.value);
+      }
+    }
+  }
+};
+
+#endif // GLEDITOR_GLYPH_TABLE_H
+// vi: set sw=2 sts=2 ts=2 et:
@@ -46,10 +46,12 @@ public:
    * texture.
    * @param box Width of the lane (box.width) and max character height
    * (box.height).
+   * @param used Width already taken, for a lane read back from disk.
    */
-  GlyphLane(const Offset paletteYOffset, const Rect &box)
+  GlyphLane(const Offset paletteYOffset, const Rect &box,
+            const Length used = Length{})
       : maxCharHeight(box.height), paletteYOffset(paletteYOffset),
-        paletteWidth(box.width) {}
+        paletteWidth(box.width), usedWidth(used) {}
   ~GlyphLane() override = default;
 
   /**
@@ -80,6 +82,12 @@ public:
     return Length{std::to_underlying(paletteWidth) -
                   std::to_underlying(usedWidth)};
   }
+  /// Where the lane starts, how tall it is and how much of it is taken: what
+  /// is kept of it between runs.
+  [[nodiscard]] Offset yOffset() const { return paletteYOffset; }
+  [[nodiscard]] Length height() const { return maxCharHeight; }
+  [[nodiscard]] Length used() const { return usedWidth; }
+
   /**
    * @brief Insert a glyph of the given width into the lane.
    * @param charWidth Width of the glyph to insert.
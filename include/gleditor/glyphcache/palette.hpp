@@ -121,6 +121,18 @@ public:
    */
   void grow(const Rect &newDims, render::TextureHandle aTexture);
 
+  /// How far up the layer its lanes reach, and the lanes themselves.
+  [[nodiscard]] Length used() const { return usedHeight; }
+  [[nodiscard]] const std::vector<GlyphLane> &laneList() const {
+    return lanes;
+  }
+  /**
+   * @brief Take up @p restored as the lanes, as they were when written down.
+   *
+   * The layer is filled as far up as the highest of them reaches.
+   */
+  void restore(std::vector<GlyphLane> restored);
+
   /// Index of the array texture layer this palette owns.
   [[nodiscard]] int layerIndex() const { return layer; }
 
@@ -0,0 +1,152 @@
+/**
+ * @file raster.hpp
+ * @brief Drawing clusters of text into coverage bitmaps for the glyph cache.
+ *
+ * A miss in the glyph cache used to build, for one cluster, a Cairo surface
+ * and context to measure against, a Pango layout on them, and then a surface
+ * and context the size of the glyph to draw into -- four objects made and
+ * thrown away per glyph. A document in a script with thousands of distinct
+ * clusters, or any document in a font not seen before, pays that thousands of
+ * times over. Here each thread keeps one of each and reuses them, the drawing
+ * surface growing to the largest glyph it has drawn; and a batch of clusters
+ * can be spread across a WorkerPool, each worker with its own.
+ *
+ * A cluster is asked for by a key. Usually that is the glyphs its page already
+ * shaped it into -- their IDs in the page's font and where each sits -- and
+ * drawing it is one cairo_show_glyphs() with nothing laid out again. A cluster
+ * that cannot be described that way is asked for by its text, which is laid
+ * out and drawn as it always was. A shaped key starts with a byte no UTF-8
+ * text starts with, so the two cannot be confused.
+ */
+#ifndef GLEDITOR_GLYPH_RASTER_H
+#define GLEDITOR_GLYPH_RASTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cairomm/fontoptions.h>
+#include <glibmm/refptr.h>
+#include <pangomm/font.h>
+#include <pangomm/fontdescription.h>
+
+namespace render {
+class WorkerPool;
+}
+
+/// A cluster drawn as tightly packed coverage, ready to be placed.
+struct GlyphRaster {
+  int width{};
+  int height{};
+  /// A byte per pixel, bottom row first. Empty for a zero-area cluster.
+  std::vector<std::byte> coverage;
+};
+
+/// One glyph of a shaped cluster: its ID in the cluster's font, and where its
+/// origin is from the cluster's left edge and baseline, in Pango units.
+struct ShapedGlyph {
+  std::uint32_t id{};
+  std::int32_t x{};
+  std::int32_t y{};
+};
+
+/// Glyphs a shaped key holds at most. A cluster shaped into more is asked for
+/// by its text.
+inline constexpr std::size_t maxShapedGlyphs = 4;
+
+/// Bytes in the shaped key for @p glyphs glyphs.
+[[nodiscard]] constexpr std::size_t shapedKeyBytes(const std::size_t glyphs) {
+  return 9 + (12 * glyphs);
+}
+
+/// Whether @p key names a cluster by its glyphs rather than by its text.
+[[nodiscard]] bool isShapedKey(std::string_view key);
+
+/**
+ * @brief Append to @p key the key drawing @p glyphs in a box @p width by
+ *        @p height pixels with its baseline @p baseline Pango units down.
+ * @return false, with nothing appended, for more than maxShapedGlyphs.
+ */
+bool appendShapedKey(std::string &key, int width, int height, int baseline,
+                     std::span<const ShapedGlyph> glyphs);
+
+/// Where a shaped key's glyph IDs point: the font face and its size.
+struct GlyphFace;
+
+/**
+ * @brief What a batch of keys is drawn in.
+ *
+ * Worked out on the thread that loaded the font, which is the only one Pango
+ * lets use it; what it holds can be drawn with from any.
+ */
+struct RasterFont {
+  /// What a text key is laid out in.
+  Pango::FontDescription description;
+  /// What a shaped key's glyphs are drawn from. Null for a font that is not
+  /// Cairo's, whose shaped keys draw blank.
+  std::shared_ptr<const GlyphFace> face;
+};
+
+/// @p font as a RasterFont. On the thread that loaded it.
+[[nodiscard]] RasterFont rasterFontOf(const Glib::RefPtr<Pango::Font> &font);
+
+/// The antialiasing and hinting every glyph is drawn with.
+[[nodiscard]] Cairo::FontOptions getFontOptions();
+
+/**
+ * @brief A number that changes when what a glyph looks like could: the font
+ *        options above, and the versions of Pango and Cairo drawing with them.
+ */
+[[nodiscard]] std::uint64_t rasterSettings();
+
+/**
+ * @brief A number that changes when @p font's file does, or the options it is
+ *        drawn with.
+ *
+ * A description names a family, a style and a size, and an updated font file
+ * -- or one installed in front of it -- answers to the same name. This hashes
+ * the font's 'head' table, whose checksum covers the whole file and whose
+ * dates say when it was made, with its glyph count and the options the font
+ * itself adds to the ones it is drawn with, which is where fontconfig's
+ * hinting lands. Zero when none of that can be read, which matches nothing.
+ * On the thread that loaded the font.
+ */
+[[nodiscard]] std::uint64_t fontFingerprint(
+    const Glib::RefPtr<Pango::Font> &font);
+/// fontFingerprint() of the font @p description loads, on the calling thread.
+[[nodiscard]] std::uint64_t fontFingerprint(const std::string &description);
+
+/**
+ * @brief Draw @p chr in @p font.
+ *
+ * Touches nothing shared, so any thread may call it, and several at once;
+ * what it reuses between calls is the calling thread's own.
+ */
+[[nodiscard]] GlyphRaster rasteriseCluster(const std::string &chr,
+                                           const Pango::FontDescription &font);
+
+/**
+ * @brief Draw the cluster @p key names in @p font: its glyphs if it is a
+ *        shaped key, otherwise its text through rasteriseCluster().
+ *
+ * Any thread, as rasteriseCluster().
+ */
+[[nodiscard]] GlyphRaster rasteriseKey(const std::string &key,
+                                       const RasterFont &font);
+
+/**
+ * @brief Draw each of @p keys in @p font, spread across @p workers.
+ *
+ * The same bitmaps rasteriseKey() draws, in the same order. Without a pool,
+ * or with one key, they are drawn on the calling thread.
+ */
+[[nodiscard]] std::vector<GlyphRaster>
+rasteriseClusters(std::span<const std::string> keys, const RasterFont &font,
+                  render::WorkerPool *workers);
+
+#endif // GLEDITOR_GLYPH_RASTER_H
+// vi: set sw=2 sts=2 ts=2 et:
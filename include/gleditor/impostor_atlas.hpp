@@ -0,0 +1,144 @@
+/**
+ * @file impostor_atlas.hpp
+ * @brief Where pages drawn as one picture are kept, and which go to make room.
+ *
+ * Between the distance at which a page is drawn glyph by glyph and the one at
+ * which it is drawn as a bar per line there is a wide band in which the page
+ * is a few hundred pixels across: too small for its glyphs to be worth a quad
+ * each, too large for bars to pass for text. There a page is drawn as an
+ * impostor -- a picture of the page, made once at about the size it covers on
+ * screen, and drawn as one quad until the page changes or comes closer.
+ *
+ * The pictures share a texture array. A layer is cut into cells of one size,
+ * a power of two each way at least as large as the picture, so that placing
+ * one is finding a free cell rather than packing: pages are all about the
+ * same shape, so a layer holds the pages of one distance with little waste,
+ * and a cell freed by one page fits the next page of that distance exactly.
+ * When no cell is free and no layer is left, the picture used least recently
+ * goes -- from a layer cut to the size wanted if there is one, and otherwise
+ * taking the rest of its layer with it, so that the layer can be cut afresh.
+ *
+ * This decides where pictures go and which are let go of. Making them, and
+ * the texture they are drawn into, are gleditor/page_impostors.hpp's.
+ */
+#ifndef GLEDITOR_IMPOSTOR_ATLAS_H
+#define GLEDITOR_IMPOSTOR_ATLAS_H
+
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace gleditor {
+
+/// Where one picture is, in texels of its layer.
+struct ImpostorSlot {
+  std::uint32_t layer{};
+  std::uint32_t x{};
+  std::uint32_t y{};
+  /// The picture's own size, which is no more than its cell's.
+  std::uint32_t width{};
+  std::uint32_t height{};
+  /**
+   * @brief A small number no other picture held at the same time has.
+   *
+   * For storage kept per picture -- the row a picture is drawn with -- which
+   * then needs as many entries as there are pictures, rather than cells.
+   */
+  std::uint32_t row{};
+};
+
+/// What drawing pages as pictures has saved and cost, for a report.
+struct ImpostorStats {
+  /// Pictures made and placed.
+  std::uint64_t placed{};
+  /// Pictures let go of to make room for another.
+  std::uint64_t evictions{};
+};
+
+class ImpostorAtlas {
+public:
+  /// Smallest cell a layer is cut into, each way.
+  static constexpr std::uint32_t minCell = 32;
+
+  /**
+   * @param layerSize Width and height of a layer in texels. A picture larger
+   *        than this either way is not held at all.
+   * @param maxLayers Layers the pictures may spread across.
+   */
+  ImpostorAtlas(std::uint32_t layerSize, std::uint32_t maxLayers);
+
+  /**
+   * @brief The picture of @p page made at scale step @p step, if one is held.
+   *
+   * A picture found is counted as used, which is what keeps it from being the
+   * next to go. One held at another step is not the picture asked for, and is
+   * not found.
+   */
+  [[nodiscard]] std::optional<ImpostorSlot> find(std::uint64_t page,
+                                                 std::int32_t step);
+
+  /**
+   * @brief Make room for a picture of @p page, @p width by @p height texels
+   *        and made at scale step @p step, letting others go as need be.
+   *
+   * Replaces whatever picture @p page had. Nothing is placed, and nothing let
+   * go of, for a picture larger than a layer.
+   */
+  [[nodiscard]] std::optional<ImpostorSlot>
+  place(std::uint64_t page, std::int32_t step, std::uint32_t width,
+        std::uint32_t height);
+
+  /// Let @p page's picture go, if it has one.
+  void forget(std::uint64_t page);
+
+  [[nodiscard]] bool holds(std::uint64_t page) const {
+    return held.contains(page);
+  }
+  /// Layers cut so far: how many a texture holding the pictures must have.
+  [[nodiscard]] std::uint32_t layersUsed() const {
+    return static_cast<std::uint32_t>(layers.size());
+  }
+  [[nodiscard]] std::uint32_t layerSize() const { return size; }
+  /// Layers the pictures may ever take.
+  [[nodiscard]] std::uint32_t layerLimit() const { return maxLayers; }
+  [[nodiscard]] const ImpostorStats &stats() const { return counts; }
+
+private:
+  struct Layer {
+    std::uint32_t cellWidth{};
+    std::uint32_t cellHeight{};
+    /// The page each cell's picture is of, or nullopt for a free cell.
+    std::vector<std::optional<std::uint64_t>> cells;
+  };
+  struct Held {
+    ImpostorSlot slot;
+    std::int32_t step{};
+    std::uint32_t cell{};
+    /// When it was last placed or found, on a clock of its own.
+    std::uint64_t used{};
+  };
+
+  std::uint32_t size;
+  std::uint32_t maxLayers;
+  std::vector<Layer> layers;
+  std::unordered_map<std::uint64_t, Held> held;
+  /// Rows given back, to be handed out again before any new one.
+  std::vector<std::uint32_t> freeRows;
+  std::uint32_t nextRow{};
+  std::uint64_t clock{};
+  ImpostorStats counts;
+
+  /// Cut layer @p layer into cells of @p width by @p height, all free.
+  void cut(Layer &layer, std::uint32_t width, std::uint32_t height) const;
+  /// The picture used least recently, among those @p among accepts.
+  template <typename Among>
+  [[nodiscard]] std::optional<std::uint64_t> leastRecent(Among among) const;
+  /// Let the picture of @p page go, counting it when @p evicted.
+  void release(std::uint64_t page, bool evicted);
+};
+
+} // namespace gleditor
+
+#endif // GLEDITOR_IMPOSTOR_ATLAS_H
+// vi: set sw=2 sts=2 ts=2 et:
@@ -0,0 +1,118 @@
+/**
+ * @file layout_budget.hpp
+ * @brief Which pages keep their shaping, under a budget in bytes.
+ *
+ * A page lets go of its Pango layout once its rows are built, and shapes again
+ * when a caret or an edit needs it; see Page::ensureLayout(). Which layouts
+ * are kept used to be the last four pages shaped. Four was too few for a
+ * caret being paged down a document -- every page it reached was shaped again
+ * on the render thread, a visible hitch each time -- and a count was the wrong
+ * measure anyway: a page of dense prose costs several times what a page of
+ * short lines does, to hold and to shape.
+ *
+ * So layouts are held up to a number of bytes, and when that is exceeded the
+ * one to go is the one least worth keeping: the cheapest to shape again for
+ * the memory it holds, with age wearing down what a layout was worth when it
+ * was made. That is GreedyDual-Size. Each layout is given a credit of its
+ * shaping time per byte, on top of a floor; the layout with the least credit
+ * goes, and the floor rises to what it had, so that everything kept from
+ * before that point has that much less in hand next time. A layout used
+ * again is given its credit afresh against the raised floor.
+ *
+ * This decides which pages go. What a layout costs is measured by whoever
+ * shaped it, and letting it go is the page's business.
+ */
+#ifndef GLEDITOR_LAYOUT_BUDGET_H
+#define GLEDITOR_LAYOUT_BUDGET_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace gleditor {
+
+/// What keeping layouts has saved and cost, for a report.
+struct LayoutStats {
+  /// Layouts shaped on the thread that wanted them, because none was kept.
+  std::uint64_t shaped{};
+  /// Layouts shaped ahead of being wanted, off that thread.
+  std::uint64_t prefetched{};
+  /// Layouts let go of to stay within the budget.
+  std::uint64_t evictions{};
+};
+
+class LayoutBudget {
+public:
+  /**
+   * @brief Bytes a Pango layout holds per byte of text it shapes.
+   *
+   * Measured rather than asked for, since Pango will not say: the layouts of
+   * every page of a megabyte of text came to ninety megabytes.
+   */
+  static constexpr std::size_t bytesPerTextByte = 90;
+
+  /// @param budgetBytes What the layouts kept may hold between them. Zero
+  ///        keeps none beyond the one most recently shaped.
+  explicit LayoutBudget(std::size_t budgetBytes) : budget(budgetBytes) {}
+
+  /**
+   * @brief Record that page @p page holds shaping of @p bytes, which took
+   *        @p cost to produce, and say which pages are to let theirs go.
+   *
+   * Replaces whatever was recorded for @p page. A @p cost of zero is one
+   * nobody measured -- a paragraph shaped as part of an edit -- and is taken
+   * to be the going rate for that many bytes.
+   *
+   * @p page itself is never chosen, however large: it has just been shaped
+   * because it is wanted, and the budget is overrun rather than met by letting
+   * it go. The pages chosen are forgotten here and counted as evictions.
+   */
+  [[nodiscard]] std::vector<std::uint32_t>
+  keep(std::uint32_t page, std::size_t bytes, std::chrono::nanoseconds cost);
+
+  /// Page @p page's layout was used again: its credit is renewed. Nothing for
+  /// a page not held.
+  void touch(std::uint32_t page);
+
+  /// Page @p page has let its layout go on its own account.
+  void forget(std::uint32_t page);
+
+  [[nodiscard]] bool holds(std::uint32_t page) const {
+    return held.contains(page);
+  }
+  /// What the layouts kept hold between them.
+  [[nodiscard]] std::size_t heldBytes() const { return total; }
+  [[nodiscard]] std::size_t budgetBytes() const { return budget; }
+
+  /// Count a layout shaped by the thread that wanted it.
+  void recordShaped() { counts.shaped++; }
+  /// Count a layout shaped ahead of being wanted.
+  void recordPrefetched() { counts.prefetched++; }
+  [[nodiscard]] const LayoutStats &stats() const { return counts; }
+
+private:
+  struct Entry {
+    std::size_t bytes{};
+    /// Shaping time per byte, in nanoseconds.
+    double costPerByte{};
+    /// Floor at the last keep or touch, plus costPerByte.
+    double credit{};
+  };
+
+  std::size_t budget;
+  std::size_t total{};
+  /// Everything evicted so far had at most this much credit.
+  double floor{};
+  /// Shaping time and bytes measured so far, for pricing what was not.
+  std::chrono::nanoseconds measuredCost{};
+  std::size_t measuredBytes{};
+  std::unordered_map<std::uint32_t, Entry> held;
+  LayoutStats counts;
+};
+
+} // namespace gleditor
+
+#endif // GLEDITOR_LAYOUT_BUDGET_H
+// vi: set sw=2 sts=2 ts=2 et:
@@ -0,0 +1,74 @@
+/**
+ * @file load_queue.hpp
+ * @brief Which of a loading document's unbuilt pages to build next.
+ *
+ * A document opens page by page, and building a page -- shaping it, walking
+ * its clusters, rasterising its glyphs -- is most of what opening costs. Built
+ * in text order, a document opened while the camera is somewhere else, or
+ * looked at from its last page, shows nothing where anyone is looking until
+ * everything before it is done.
+ *
+ * So a page that nobody is looking at can be paginated without being built:
+ * where it starts and how much it holds is known, and it is drawn as a blank
+ * placeholder of the right size. It waits here, and is built when what is in
+ * view has been. What is in view is decided by the renderer's own culling --
+ * the same test that skips a page outside the frustum says which placeholders
+ * are inside it -- so the order follows the camera as it moves.
+ *
+ * Nothing here knows what a page is; it orders indices.
+ */
+#ifndef GLEDITOR_LOAD_QUEUE_H
+#define GLEDITOR_LOAD_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <span>
+#include <vector>
+
+namespace gleditor {
+
+class LoadQueue {
+public:
+  /// A page paginated but not built.
+  struct Deferred {
+    std::uint32_t index{};
+    /// Where its text starts, which is all it takes to lay it out again.
+    std::uint32_t start{};
+  };
+
+  /// Page @p page has been paginated and left unbuilt.
+  void defer(const Deferred &page) { waiting[page.index] = page.start; }
+
+  [[nodiscard]] bool empty() const { return waiting.empty(); }
+  [[nodiscard]] std::size_t size() const { return waiting.size(); }
+
+  /**
+   * @brief Up to @p count pages to build now, taken out of the queue.
+   *
+   * Nearest to a page in @p focus first, nearest meaning fewest pages away;
+   * with no focus, in text order, since that is the order a reader goes in.
+   * Ties go to the earlier page.
+   */
+  [[nodiscard]] std::vector<Deferred>
+  take(std::size_t count, std::span<const std::uint32_t> focus);
+
+  /**
+   * @brief Every page within @p reach pages of one in @p focus, taken out of
+   *        the queue, in text order.
+   *
+   * What cannot wait for pagination to finish: a page in view, and the few
+   * either side of it that a reader gets to next.
+   */
+  [[nodiscard]] std::vector<Deferred>
+  takeNear(std::span<const std::uint32_t> focus, std::uint32_t reach);
+
+private:
+  /// Index to start, so that the page nearest an index is a lookup.
+  std::map<std::uint32_t, std::uint32_t> waiting;
+};
+
+} // namespace gleditor
+
+#endif // GLEDITOR_LOAD_QUEUE_H
+// vi: set sw=2 sts=2 ts=2 et:
@@ -0,0 +1,205 @@
+/**
+ * @file page_cache.hpp
+ * @brief Built pages kept on disk, so that opening a file again is reading
+ *        them rather than shaping them.
+ *
+ * Opening the 4.6 MB sample shapes 1152 pages, and opening it again shapes the
+ * same 1152 pages into the same rows: nothing a page is built from -- its
+ * text, the font, the page size, Pango -- has changed. So the first open
+ * writes every page down as it is built, rows, clusters and paragraphs, and a
+ * later one maps the file and hands those straight to the pool.
+ *
+ * One thing in a row belongs to the session that wrote it: where its glyph
+ * sits in the atlas, which is packed in whatever order glyphs happened to be
+ * asked for. A page read back names its glyphs again, by what each was
+ * reserved under when the page was built -- kept beside the rows, since a
+ * glyph drawn from the IDs Pango shaped its cluster into cannot be named by
+ * the cluster's text -- and that is all the work a warm open does.
+ *
+ * The cache is addressed by its content. Everything a page depends on goes
+ * into PageCacheKey, the key names the file, and the file repeats it: a cache
+ * written under any other font, page size, Pango or row format is simply
+ * never found, and nothing has to be invalidated. A file that is short, or
+ * not one of these, is treated as absent; the cache is an optimisation, and
+ * failing to use one is never an error.
+ *
+ * Only the layout of the file is here, with nothing of Pango or the device,
+ * so that it can be tested on its own. Doc decides what goes in a page.
+ */
+#ifndef GLEDITOR_PAGE_CACHE_H
+#define GLEDITOR_PAGE_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <gleditor/page_paragraphs.hpp>
+
+namespace gleditor {
+
+/// Seed for hashText(); what a hash of no bytes at all comes to.
+inline constexpr std::uint64_t textHashSeed = 14695981039346656037ULL;
+
+/**
+ * @brief Fold @p bytes into @p hash, which starts as textHashSeed.
+ *
+ * FNV-1a. Chained, so a text held in pieces hashes the same as the one string
+ * they make up. Not for anything adversarial: it tells a file from an edited
+ * copy of itself, which is all a cache key is asked.
+ */
+[[nodiscard]] std::uint64_t hashText(std::uint64_t hash,
+                                     std::string_view bytes);
+
+/// Everything pages are built from besides how they are built.
+struct PageCacheKey {
+  /// hashText() of the whole text, and how long it is.
+  std::uint64_t textHash{};
+  std::uint64_t textBytes{};
+  /// The font description every page is laid out in.
+  std::string font;
+  /// The page's layout box and margin, in Pango units.
+  std::int32_t pageWidth{};
+  std::int32_t pageHeight{};
+  std::int32_t margin{};
+  /// Pango's version, whose shaping and line breaking the pages record.
+  std::string pango;
+  /// Bytes in a vertex row, so that a change to the row format misses.
+  std::uint32_t rowBytes{};
+
+  /// All of the above as one number.
+  [[nodiscard]] std::uint64_t digest() const;
+  /// The name of the cache file for this key.
+  [[nodiscard]] std::string fileName() const;
+};
+
+/// One page's numbers, as stored.
+struct CachedPageHeader {
+  std::uint32_t textBytes{};
+  std::uint32_t rowCount{};
+  std::uint32_t clusterCount{};
+  std::uint32_t paragraphCount{};
+  /// Bytes of the page's glyph keys, whose form is the document's business.
+  std::uint32_t glyphBytes{};
+  std::uint32_t detailInstances{};
+  std::uint32_t spareRows{};
+  std::uint32_t coarseInstances{};
+  float pageWidth{};
+  float pageHeight{};
+  float originX{};
+  float originY{};
+};
+
+/// One page read back: its numbers, and views of its tables in the file.
+struct CachedPage {
+  CachedPageHeader header;
+  /// header.rowCount rows of the key's rowBytes each.
+  std::span<const std::byte> rows;
+  std::span<const std::byte> clusters;
+  std::span<const std::byte> paragraphs;
+  std::span<const std::byte> glyphs;
+
+  /// The cluster table, copied out of the file.
+  [[nodiscard]] std::vector<ClusterBox> clusterTable() const;
+  /// The paragraph table, copied out of the file.
+  [[nodiscard]] std::vector<PageParagraph> paragraphTable() const;
+};
+
+/**
+ * @brief A cache file written page by page, in whatever order pages are
+ *        built, and published only once every page is in it.
+ *
+ * Written under a temporary name and renamed into place by finish(), so a
+ * reader never sees half a cache: one run interrupted, or two writing the
+ * same file at once, leave at worst a stray temporary. Nothing here throws;
+ * a write that fails marks the writer failed, and finish() then publishes
+ * nothing. Pages may be added from several threads at once.
+ */
+class PageCacheWriter {
+public:
+  PageCacheWriter(const std::filesystem::path &dir, const PageCacheKey &key);
+  ~PageCacheWriter();
+
+  PageCacheWriter(const PageCacheWriter &)            = delete;
+  PageCacheWriter &operator=(const PageCacheWriter &) = delete;
+  PageCacheWriter(PageCacheWriter &&)                 = delete;
+  PageCacheWriter &operator=(PageCacheWriter &&)      = delete;
+
+  /// Write page @p index. @p rows is header.rowCount rows of the key's size,
+  /// and @p glyphs header.glyphBytes bytes.
+  void add(std::uint32_t index, const CachedPageHeader &header,
+           std::span<const std::byte> rows,
+           std::span<const ClusterBox> clusters,
+           std::span<const PageParagraph> paragraphs,
+           std::span<const std::byte> glyphs);
+  /**
+   * @brief Finish a cache of @p pages pages and put it where readers look.
+   * @return Whether it is there: false when a page is missing or a write
+   *         failed, in which case the temporary is removed instead.
+   */
+  bool finish(std::uint32_t pages);
+  /// Give up, and remove the temporary.
+  void abandon();
+  /// Where the finished cache goes.
+  [[nodiscard]] const std::filesystem::path &path() const { return target; }
+
+private:
+  struct Entry {
+    CachedPageHeader header;
+    std::uint64_t rowsAt{};
+    std::uint64_t clustersAt{};
+    std::uint64_t paragraphsAt{};
+    std::uint64_t glyphsAt{};
+    bool written{};
+  };
+
+  PageCacheKey key;
+  std::filesystem::path target;
+  std::filesystem::path temporary;
+  std::mutex lock;
+  std::ofstream out;
+  std::vector<Entry> entries;
+  bool failed{};
+  bool done{};
+
+  /// Write @p bytes at the end of the file, aligned, and say where.
+  std::uint64_t append(std::span<const std::byte> bytes);
+};
+
+/**
+ * @brief A cache file's pages, read where they lie.
+ *
+ * Holds nothing but a view of the bytes; whoever mapped them keeps them.
+ */
+class PageCacheView {
+public:
+  /**
+   * @brief The pages in @p bytes, if they are a whole cache written for
+   *        @p key.
+   *
+   * Every table is checked to lie inside the file, so a truncated or foreign
+   * file comes back as nothing rather than as a read past the end.
+   */
+  [[nodiscard]] static std::optional<PageCacheView>
+  open(std::string_view bytes, const PageCacheKey &key);
+
+  [[nodiscard]] std::size_t size() const { return entries; }
+  [[nodiscard]] CachedPage page(std::size_t index) const;
+
+private:
+  std::string_view bytes;
+  std::size_t entries{};
+  std::uint32_t rowBytes{};
+  std::uint64_t tableAt{};
+};
+
+} // namespace gleditor
+
+#endif // GLEDITOR_PAGE_CACHE_H
+// vi: set sw=2 sts=2 ts=2 et:
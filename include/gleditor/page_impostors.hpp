@@ -0,0 +1,200 @@
+/**
+ * @file page_impostors.hpp
+ * @brief Pages drawn as a picture of themselves, in the band of distances
+ *        where a glyph is too small to be worth a quad.
+ *
+ * At `--fov 60` a handful of pages fill the view and every glyph of every one
+ * of them is an instance: tens of thousands of quads, most of them a pixel or
+ * two across, for pages nobody is close enough to read. A page there is drawn
+ * instead as one quad showing a picture of the page, made at about the size
+ * the page covers on screen; see gleditor/impostor_atlas.hpp for where the
+ * pictures are kept and which go.
+ *
+ * A picture is made off the render thread, by shaping the page again and
+ * drawing the lines it holds with Cairo -- the device has no way to draw into
+ * a texture, and would have to be taught one on every backend for what is a
+ * few milliseconds of a worker's time. Until it arrives the page is drawn as
+ * before. What is asked of a picture is that the page has been the same for
+ * two frames running, and small enough on screen for one, which keeps a page
+ * being typed into, or swept past on the way somewhere, from being drawn over
+ * and over for a frame each.
+ *
+ * The pictures are drawn through a pipeline of their own, built from the
+ * glyph shaders as the caret's is. On Vulkan the texture a draw samples is
+ * bound through its pipeline's descriptor set, which the document's draws
+ * are still to read when these are recorded; binding the pictures there
+ * would have the pages sample them too.
+ *
+ * A picture is of a page's content, not of the page: it is named by a number
+ * the page is given afresh whenever its rows change, so an edited page is
+ * simply a page with no picture, and one opened in two documents shares one.
+ *
+ * Render thread only, apart from what is said otherwise.
+ */
+#ifndef GLEDITOR_PAGE_IMPOSTORS_H
+#define GLEDITOR_PAGE_IMPOSTORS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <unordered_set>
+#include <vector>
+
+#include <glm/ext/matrix_float4x4.hpp>
+
+#include <gleditor/buffer_pool.hpp>
+#include <gleditor/impostor_atlas.hpp>
+#include <gleditor/piece_table.hpp>
+#include <gleditor/render/types.hpp>
+
+class Doc;
+
+namespace render {
+class RenderDevice;
+}
+
+namespace gleditor {
+
+/// A page that would be drawn as a picture if it had one.
+struct ImpostorWant {
+  /// The document whose page it is, which is what can shape it again.
+  std::shared_ptr<Doc> doc;
+  /// The page's content, by the name the page gives it.
+  std::uint64_t page{};
+  /// The scale to draw it at, as PageImpostors::stepFor() gives it.
+  std::int32_t step{};
+  /// Where the page's text starts in its document, and how much it holds.
+  std::uint32_t start{};
+  std::uint32_t bytes{};
+  /// The page's size in layout pixels.
+  float width{};
+  float height{};
+  /// The document's edits when it was asked for: a picture made after another
+  /// has landed is of text the page may no longer hold.
+  std::uint64_t edited{};
+  /// The document's text at that edit, which the picture is shaped from: the
+  /// table itself goes on being edited while a worker draws.
+  std::shared_ptr<const PieceTable::Snapshot> text;
+};
+
+/// A picture made for an ImpostorWant, to be placed and uploaded.
+struct ImpostorImage {
+  std::uint64_t page{};
+  std::int32_t step{};
+  std::uint32_t width{};
+  std::uint32_t height{};
+  /// Coverage, one byte a texel, bottom row first, as the atlas has it.
+  std::vector<std::byte> coverage;
+};
+
+class PageImpostors {
+public:
+  /// Width and height of a layer of the pictures' texture.
+  static constexpr std::uint32_t layerSize = 2048;
+  /// Layers the pictures may spread across: sixteen megabytes in all, which
+  /// is over a hundred pages at half their size.
+  static constexpr std::uint32_t maxLayers = 4;
+  /// Pictures begun a frame. Each is a page shaped again on a worker, so a
+  /// view swept across a document starts a few rather than all of them.
+  static constexpr std::size_t begunPerFrame = 2;
+
+  /**
+   * @param aDevice Device the pictures are drawn from. Not owned; must
+   *        outlive this. Nothing is allocated on it until the first picture
+   *        arrives.
+   */
+  explicit PageImpostors(render::RenderDevice *aDevice);
+  ~PageImpostors();
+
+  PageImpostors(const PageImpostors &)            = delete;
+  PageImpostors &operator=(const PageImpostors &) = delete;
+  PageImpostors(PageImpostors &&)                 = delete;
+  PageImpostors &operator=(PageImpostors &&)      = delete;
+
+  /**
+   * @brief The step of scale a picture for a page drawn at @p scale screen
+   *        pixels per layout pixel is made at.
+   *
+   * Powers of two, rounded up, so that a picture has at least a texel for
+   * every pixel it covers and zooming within a factor of two of where it was
+   * made draws the same one. Any thread.
+   */
+  [[nodiscard]] static std::int32_t stepFor(float scale);
+  /// Screen pixels per layout pixel a picture at @p step is made at.
+  [[nodiscard]] static float scaleOf(std::int32_t step);
+
+  /// Build the pipeline the pictures are drawn with: the document's, under
+  /// another name.
+  void createPipeline(const render::PipelineDesc &documentDesc);
+
+  /// Start a frame's collection. Pages with a span highlighted on them are
+  /// drawn in full, since a picture cannot show where a span starts.
+  void beginFrame(std::span<const render::HighlightRange> highlights);
+
+  /// Whether the page whose draws carry @p identity has a span on it.
+  [[nodiscard]] bool highlighted(std::uint32_t identity) const;
+
+  /**
+   * @brief Collect a draw of the picture of @p page at @p step, if there is
+   *        one.
+   *
+   * @param mvp         The page's own transform, in which the page is
+   *                    @p pageWidth by @p pageHeight about the origin.
+   * @param identity    The draw's picking identity, as a page's is.
+   * @return Whether the page was drawn.
+   */
+  bool collect(std::uint64_t page, std::int32_t step, const glm::mat4 &mvp,
+               float pageWidth, float pageHeight, float opacity,
+               std::uint32_t identity);
+
+  /// Ask for a picture, for a page collect() had none of.
+  void want(ImpostorWant wanted);
+
+  /// The pictures to begin making, each of which is to be handed back to
+  /// install() or, if it came to nothing, abandon().
+  [[nodiscard]] std::vector<ImpostorWant> takeWanted();
+
+  /// A picture made. Placed and uploaded by the next flush().
+  void install(ImpostorImage image);
+  /// A picture begun and not made, which may be asked for again.
+  void abandon(std::uint64_t page);
+
+  /// Place and upload the pictures installed since the last call. Inside a
+  /// frame, before anything is drawn.
+  void flush();
+
+  /// Draw what this frame's collection found pictures of. Leaves the
+  /// pictures' pipeline bound.
+  void draw();
+
+  [[nodiscard]] const ImpostorStats &stats() const { return atlas.stats(); }
+
+private:
+  render::RenderDevice *device;
+  ImpostorAtlas atlas;
+  render::PipelineHandle pipeline{};
+  render::TextureHandle pictures{};
+  /// One row a picture, by ImpostorSlot::row. Made with the texture.
+  std::unique_ptr<BufferPool> rows;
+  BufferPool::Allocation backing{};
+  std::vector<render::GlyphBatch> frameBatches;
+  /// Pages asked for this frame and the one before: only one asked for by
+  /// both is begun.
+  std::unordered_set<std::uint64_t> askedNow;
+  std::unordered_set<std::uint64_t> askedBefore;
+  std::vector<ImpostorWant> wanted;
+  /// Begun, and neither installed nor abandoned yet.
+  std::unordered_set<std::uint64_t> pending;
+  std::vector<ImpostorImage> installed;
+  /// Identities of the pages a span is highlighted on, with no kind.
+  std::vector<std::uint32_t> spanned;
+
+  /// Write @p slot's row, growing the rows if it is past them.
+  void writeRow(const ImpostorSlot &slot);
+};
+
+} // namespace gleditor
+
+#endif // GLEDITOR_PAGE_IMPOSTORS_H
+// vi: set sw=2 sts=2 ts=2 et:
@@ -0,0 +1,90 @@
+/**
+ * @file page_index.hpp
+ * @brief Where each page of a document starts, kept so that an edit moves
+ *        every later page without visiting any of them.
+ *
+ * A page used to carry its own byte offset. That made finding the page under
+ * an offset a scan of every page, and made every edit a walk of every page
+ * after it to move each offset by what the edit added -- on the 4.6 MB sample,
+ * a thousand pages touched per keystroke, even when the edit changed nothing
+ * but the one line it was on.
+ *
+ * What is stored instead is how many bytes each page spans. A page's start is
+ * the sum of the spans before it, and a Fenwick tree gives that sum, and finds
+ * the page a given sum falls in, in time logarithmic in the page count. An
+ * edit changes the span of the page it lands on; every page after it has
+ * moved, and nothing about them had to be written down for that to be true.
+ */
+#ifndef GLEDITOR_PAGE_INDEX_H
+#define GLEDITOR_PAGE_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace gleditor {
+
+/**
+ * @class PageIndex
+ * @brief Prefix sums over page spans, with point updates and search.
+ */
+class PageIndex {
+public:
+  /// Pages indexed.
+  [[nodiscard]] std::size_t size() const { return spans.size(); }
+  [[nodiscard]] bool empty() const { return spans.empty(); }
+  /// Bytes covered by every page together.
+  [[nodiscard]] std::uint64_t total() const { return startOf(spans.size()); }
+
+  void clear();
+
+  /// Add a page after the last one, spanning @p bytes.
+  void push_back(std::uint32_t bytes);
+
+  /// Bytes page @p page spans.
+  [[nodiscard]] std::uint32_t span(const std::size_t page) const {
+    return spans[page];
+  }
+  /// Change what page @p page spans. Every page after it moves by the
+  /// difference; none of them is visited.
+  void setSpan(std::size_t page, std::uint32_t bytes);
+
+  /// Where page @p page starts: the bytes spanned by every page before it. A
+  /// @p page equal to size() is the end of the last page.
+  [[nodiscard]] std::uint64_t startOf(std::size_t page) const;
+
+  /**
+   * @brief The last page starting at or before @p offset.
+   *
+   * Which page an offset is on, with an offset past the end landing on the
+   * last page. Zero for an empty index, which the caller has to tell apart by
+   * asking empty().
+   */
+  [[nodiscard]] std::size_t pageAt(std::uint64_t offset) const;
+
+  /**
+   * @brief Replace @p count pages from @p first with pages spanning @p bytes.
+   *
+   * For a reflow that changed how many pages there are. Linear, because the
+   * pages after the change are renumbered and the tree over them is rebuilt --
+   * which is only ever asked for alongside shaping at least one whole page, so
+   * it is never the larger cost.
+   */
+  void splice(std::size_t first, std::size_t count,
+              std::span<const std::uint32_t> bytes);
+
+private:
+  /// What each page spans, as given.
+  std::vector<std::uint32_t> spans;
+  /// The Fenwick tree, one-based: entry i sums the spans of the lowbit(i)
+  /// pages ending at page i - 1. Entry zero is unused.
+  std::vector<std::uint64_t> tree{0};
+
+  void rebuild();
+};
+
+} // namespace gleditor
+
+#endif // GLEDITOR_PAGE_INDEX_H
+// vi: set sw=2 sts=2 ts=2 et:
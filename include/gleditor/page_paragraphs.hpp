@@ -0,0 +1,119 @@
+/**
+ * @file page_paragraphs.hpp
+ * @brief A page as the paragraphs it stacks, so an edit can lay out one again.
+ *
+ * Pango wraps each paragraph on its own: nothing before a newline decides where
+ * a line after it breaks. So a paragraph laid out alone comes out line for line
+ * as it does inside its page, only higher up, and a page is its paragraphs'
+ * layouts stacked one under another.
+ *
+ * That is what makes an edit local. A keystroke that leaves its paragraph as
+ * many lines tall as it was cannot move anything else on the page: every other
+ * paragraph keeps its lines, its glyphs and its rows, and the page still ends
+ * where it did. Shaping that one paragraph again and rewriting its rows is the
+ * whole job, where laying out the page again shaped some 4500 bytes and wrote
+ * every row of it for each character typed.
+ *
+ * This records where each paragraph sits among its page's clusters, rows and
+ * lines, and keeps the cluster table in step when one is laid out again. What
+ * a row holds and how a paragraph is shaped are the document's business.
+ */
+#ifndef GLEDITOR_PAGE_PARAGRAPHS_H
+#define GLEDITOR_PAGE_PARAGRAPHS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include <gleditor/cluster_table.hpp>
+
+namespace gleditor {
+
+/// Where one paragraph of a page sits in everything the page is made of.
+struct PageParagraph {
+  /// Where it starts within the page's text, and its bytes up to the next
+  /// paragraph or the end of the page, its line break included.
+  std::uint32_t byteStart{};
+  std::uint32_t bytes{};
+  /**
+   * @brief Its run of the page's cluster table: what it uses, and what it may
+   *        grow into.
+   *
+   * A glyph names its cluster by index, and the highlight of a selection is a
+   * range of those indices, so the table has to stay in text order and a
+   * paragraph that gained a cluster cannot push every later index along
+   * without every later row being written again. Each paragraph is left a
+   * little room after its clusters instead, filled with empty ones.
+   */
+  std::uint32_t firstCluster{};
+  std::uint32_t clusterCount{};
+  std::uint32_t clusterRoom{};
+  /// Its glyph rows within the detailed draw, which are one run.
+  std::uint32_t firstRow{};
+  std::uint32_t rowCount{};
+  /// Its first line on the page and how many it has, which is also where its
+  /// bars are in the coarse draw: there is one per line.
+  std::uint32_t firstLine{};
+  std::uint32_t lines{};
+  /// Below the top of the page's text, its height, and the right edge of its
+  /// widest line, in Pango units.
+  int top{};
+  int height{};
+  int width{};
+  /// Whether its line break is on the page. The last paragraph of a page
+  /// usually runs on to the next one, and laying it out alone would say
+  /// nothing about where the page ends.
+  bool whole{};
+};
+
+/// Where each paragraph of @p text begins: at its start, and after every
+/// newline that has something after it.
+[[nodiscard]] std::vector<std::uint32_t>
+paragraphStarts(std::string_view text);
+
+/// The bytes a paragraph's line break takes at its end: two for "\r\n", one
+/// for "\n", and none when it does not end in one.
+[[nodiscard]] std::uint32_t trailingBreak(std::string_view paragraph);
+
+/// Cluster slots a paragraph of @p clusters clusters is given: an eighth more,
+/// and at least a few, which is a good deal of typing before it runs out.
+[[nodiscard]] std::uint32_t clusterRoomFor(std::uint32_t clusters);
+
+/// Empty rows a page keeps at the end of its detailed draw for paragraphs that
+/// grow to take: a sixteenth of its glyph rows, and at least a line's worth.
+[[nodiscard]] std::uint32_t spareRowsFor(std::uint32_t glyphRows);
+
+/**
+ * @brief The paragraph holding page-local byte @p offset.
+ *
+ * The end of the last paragraph counts as inside it, as the end of a page is a
+ * place a caret can be. Nothing for an offset past that, or for a page with no
+ * paragraphs recorded.
+ */
+[[nodiscard]] std::optional<std::size_t>
+paragraphHolding(std::span<const PageParagraph> paragraphs,
+                 std::uint32_t offset);
+
+/**
+ * @brief Put @p fresh in place of paragraph @p index's clusters after an edit
+ *        changed its length by @p delta bytes.
+ *
+ * @p fresh is in page-local bytes already. What is left of the paragraph's
+ * room is emptied, and everything after it moves by @p delta, paragraphs and
+ * clusters both. Nothing is changed when @p fresh does not fit the room.
+ *
+ * @return Whether it fitted.
+ */
+[[nodiscard]] bool relayClusters(ClusterTable &clusters,
+                                 std::vector<PageParagraph> &paragraphs,
+                                 std::size_t index,
+                                 std::span<const ClusterBox> fresh,
+                                 std::int32_t delta);
+
+} // namespace gleditor
+
+#endif // GLEDITOR_PAGE_PARAGRAPHS_H
+// vi: set sw=2 sts=2 ts=2 et:
@@ -0,0 +1,130 @@
+/**
+ * @file paginator.hpp
+ * @brief Cutting a document into pages on several threads at once.
+ *
+ * Pagination is a chain: a page starts where the one before it stopped, and
+ * where that is depends on how the text before it was shaped and wrapped. A
+ * document used to be paginated by one loader thread walking that chain, so
+ * opening a large file kept one core busy however many there were.
+ *
+ * The chain can be guessed ahead of itself, because of the rule reflowing an
+ * edit already relies on: a page laid out from the start of one of the
+ * document's lines breaks its lines where the whole document would, so two
+ * paginations that ever start a page at the same byte agree from there on.
+ * What is not known in advance is which line each page starts on. Guessing
+ * that takes two things:
+ *
+ * - where every line starts, and how tall it is. Lines restart at every
+ *   paragraph, so the text is cut at paragraph boundaries spread through it,
+ *   and each piece is wrapped on its own thread. These are the document's true
+ *   lines, whichever thread found them.
+ * - how many of those lines a page holds, which the caller knows how to work
+ *   out from their heights.
+ *
+ * Each round lays out a batch of guessed pages in parallel, and a stitch pass
+ * then walks them in order. A page whose guessed start is where the previous
+ * page really stopped is kept; at a seam where the guess was wrong, the true
+ * page is laid out on its own, and if it stops at a later guessed start the
+ * guesses from there on are kept. If it does not, the rest of the round is
+ * thrown away and the next round guesses again from the truth. What is handed
+ * on is therefore exactly the chain one thread would have produced, in the
+ * same order -- only sooner.
+ *
+ * Nothing here knows what a page is. The caller lays pages out, and says where
+ * paragraphs and lines start; this decides which pages to ask for and which to
+ * keep.
+ */
+#ifndef GLEDITOR_PAGINATOR_H
+#define GLEDITOR_PAGINATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+namespace gleditor {
+
+/// One line of the document, wrapped as a page would wrap it.
+struct PaginationLine {
+  std::uint32_t start{};
+  /// In whatever unit the caller measures pages in.
+  std::int32_t height{};
+};
+
+/**
+ * @brief What the paginator asks of the caller.
+ *
+ * layPage and lines are called from several threads at once, and must not
+ * touch anything they share without saying so. The rest are called on the
+ * thread that called paginate(), and accept in page order.
+ */
+struct PaginationHooks {
+  /// Lay out the page starting at byte @p start, keep it as slot @p slot, and
+  /// return how many bytes it holds -- where the page after it starts. Never
+  /// zero for a start within the text. Slots are below paginationSlots().
+  std::function<std::uint32_t(std::uint32_t start, std::size_t slot)> layPage;
+  /// Append to @p out each line starting in [@p from, @p to), in order. Both
+  /// ends are paragraph starts, or the ends of the text.
+  std::function<void(std::uint32_t from, std::uint32_t to,
+                     std::vector<PaginationLine> &out)>
+      lines;
+  /**
+   * @brief How many of @p lines a page laid out from the first of them would
+   *        hold.
+   *
+   * A guess, and only ever used as one: what layPage says is what counts. A
+   * guess that is often wrong costs time, never correctness. Optional; without
+   * it each page is guessed to hold as many lines as the last one did.
+   */
+  std::function<std::size_t(std::span<const PaginationLine> lines)>
+      linesPerPage;
+  /// The first paragraph start at or after @p offset, or the end of the text.
+  std::function<std::uint32_t(std::uint32_t offset)> paragraphStart;
+  /// The page in slot @p slot, holding @p consumed bytes, is the next page.
+  std::function<void(std::size_t slot, std::uint32_t consumed)> accept;
+};
+
+/// How a pagination went, for a report.
+struct PaginationStats {
+  std::size_t pages{};
+  /// Batches laid out in parallel.
+  std::size_t rounds{};
+  /// Pages laid out one at a time, at a seam where the guess was wrong.
+  std::size_t seamPages{};
+  /// Pages laid out and thrown away.
+  std::size_t discarded{};
+  /// Threads used, the calling one included.
+  std::uint32_t threads{};
+};
+
+/// Slots the pages of one round are kept in: every slot passed to
+/// PaginationHooks::layPage is below this.
+[[nodiscard]] std::size_t paginationSlots(std::uint32_t parallelism);
+
+/**
+ * @brief Threads worth paginating @p bytes of text on, given @p cores.
+ *
+ * One for a short document, or a machine with few cores. Every page is shaped
+ * twice when paginating in parallel -- once to find line starts, once as a
+ * page -- so it is only worth doing with enough threads to more than make that
+ * up, and enough text for the setup to vanish.
+ */
+[[nodiscard]] std::uint32_t paginationParallelism(std::size_t bytes,
+                                                  std::uint32_t cores);
+
+/**
+ * @brief Cut @p textSize bytes into pages, handing each to hooks.accept in
+ *        order.
+ *
+ * The first page is laid out before anything else, so a document has
+ * something to show while the rest is being worked out. With a parallelism of
+ * one this is the plain chain and nothing is guessed.
+ */
+PaginationStats paginate(std::uint32_t textSize, std::uint32_t parallelism,
+                         const PaginationHooks &hooks);
+
+} // namespace gleditor
+
+#endif // GLEDITOR_PAGINATOR_H
+// vi: set sw=2 sts=2 ts=2 et:
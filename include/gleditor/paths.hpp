@@ -54,6 +54,17 @@ namespace gleditor {
  */
 void resetAssetDirForTesting();
 
+/**
+ * @brief Directory for files the program writes to save itself work, and can
+ *        always do without.
+ *
+ * `$GLEDITOR_CACHE_DIR` if set, otherwise `gleditor` under the platform's
+ * user cache directory -- `$XDG_CACHE_HOME` or `~/.cache` on Unix, the local
+ * application data folder on Windows. Not created here: whatever writes to it
+ * does that, and whatever only reads from it need not.
+ */
+[[nodiscard]] std::string cacheDir();
+
 } // namespace gleditor
 
 #endif // GLEDITOR_PATHS_H
@@ -0,0 +1,215 @@
+/**
+ * @file piece_table.hpp
+ * @brief A document's text as a sequence of slices of buffers that never
+ *        change, so that an edit costs the same however long the text is.
+ *
+ * A document used to be one Glib::ustring, and an edit copied it out, spliced
+ * it and assigned it back -- three passes over the whole text per keystroke.
+ * On the 4.6 MB sample that is around fourteen megabytes moved to insert one
+ * byte, and typing slowed in proportion to the size of the file.
+ *
+ * Here the text is never moved. What was loaded stays where it was loaded, and
+ * everything typed is appended to a separate buffer; the document is a list of
+ * pieces, each naming a run of one or the other. An edit splits at most one
+ * piece and adds at most one, so what it costs depends on how many pieces there
+ * are and not on how many bytes.
+ *
+ * The pieces are kept in a balanced tree whose nodes know how many bytes lie
+ * beneath them, so finding the piece at a byte offset is a descent of the
+ * tree's height rather than a walk of the list. A long editing session makes
+ * thousands of pieces; without the tree, finding the right one would be the
+ * new linear cost.
+ *
+ * The text loaded need not be the table's own. Given a view of bytes that live
+ * elsewhere -- a mapped file -- the table reads them where they are, and since
+ * nothing is ever written over a piece, editing leaves every piece it does not
+ * touch pointing at them still. That is copy-on-write at the granularity of a
+ * piece: what is typed is the only text the table ever holds itself.
+ */
+#ifndef GLEDITOR_PIECE_TABLE_H
+#define GLEDITOR_PIECE_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace gleditor {
+
+/**
+ * @class PieceTable
+ * @brief UTF-8 text with logarithmic insertion and removal.
+ *
+ * Offsets are in bytes throughout, as everywhere else a document is addressed.
+ * Nothing here knows about characters except the two alignment helpers, which
+ * are here because the text is no longer one contiguous string that
+ * gleditor/utf8.hpp could be handed.
+ *
+ * Not thread safe. Readers on another thread -- the page loader -- must not
+ * overlap an edit, which is the same rule the string this replaced had.
+ */
+class PieceTable {
+public:
+  PieceTable();
+  /// Text to start from. Kept as it is, and never copied again.
+  explicit PieceTable(std::string loaded);
+  /// Text to start from that lives somewhere else, and is read there for as
+  /// long as the table exists. @p owner is held for that long.
+  PieceTable(std::string_view bytes, std::shared_ptr<const void> owner);
+  ~PieceTable();
+
+  PieceTable(const PieceTable &)            = delete;
+  PieceTable &operator=(const PieceTable &) = delete;
+  PieceTable(PieceTable &&) noexcept;
+  PieceTable &operator=(PieceTable &&) noexcept;
+
+  /// Bytes of text.
+  [[nodiscard]] std::size_t size() const;
+  [[nodiscard]] bool empty() const { return 0 == size(); }
+
+  /// Pieces the text is currently made of. One for text that has not been
+  /// edited; grows by at most two per edit.
+  [[nodiscard]] std::size_t pieceCount() const;
+
+  /// Insert @p text before byte @p offset, which is clamped to the end.
+  void insert(std::size_t offset, std::string_view text);
+  /// Remove up to @p bytes from @p offset. Bytes past the end are ignored.
+  void erase(std::size_t offset, std::size_t bytes);
+
+  /// The byte at @p offset, which must be within the text.
+  [[nodiscard]] char at(std::size_t offset) const;
+
+  /// A copy of up to @p bytes from @p offset.
+  [[nodiscard]] std::string substr(std::size_t offset, std::size_t bytes) const;
+  /// A copy of the whole text. Linear, and meant for the occasions that need
+  /// every byte anyway: saving, and handing the text to a screen reader.
+  [[nodiscard]] std::string str() const;
+
+  /**
+   * @brief Up to @p bytes from @p offset, as one contiguous run.
+   *
+   * A view straight into the buffer holding it when the range lies within a
+   * single piece -- which is every page of a document nobody has typed into,
+   * and every page but the one being typed on of one that has been. Otherwise
+   * the range is gathered into @p scratch and the view is of that, so it lives
+   * as long as whichever of the two it points into.
+   *
+   * What Pango is handed: it wants one pointer and a length, and copies what
+   * it is given, so a page's worth of copying at most is all this costs.
+   */
+  [[nodiscard]] std::string_view slice(std::size_t offset, std::size_t bytes,
+                                       std::string &scratch) const;
+
+  /**
+   * @brief Call @p visit with each contiguous run covering a range, in order.
+   *
+   * The way to read a range without copying it. Stops early when @p visit
+   * returns false.
+   */
+  void forEachRun(std::size_t offset, std::size_t bytes,
+                  const std::function<bool(std::string_view)> &visit) const;
+
+  /**
+   * @brief Whether @p other holds the same bytes, however each is cut up.
+   *
+   * Linear, and stops at the first difference. Compares the text and nothing
+   * else: two tables that arrived at it through different edits are the same.
+   */
+  [[nodiscard]] bool sameText(const PieceTable &other) const;
+
+  /**
+   * @class Snapshot
+   * @brief The text as it was when taken, readable on another thread while
+   *        the table goes on being edited.
+   *
+   * What a save writes. Taking one copies the list of pieces, not the bytes --
+   * a piece's bytes are never written over, and the buffers they are in are
+   * shared with the snapshot, which keeps them alive past the table if need
+   * be. The one buffer still being typed into only ever grows past what any
+   * piece covers, so nothing the snapshot reads is ever written to.
+   */
+  class Snapshot {
+  public:
+    /// Bytes of text.
+    [[nodiscard]] std::size_t size() const { return bytes; }
+    /// As PieceTable::forEachRun(). Linear in the pieces before @p offset.
+    void forEachRun(std::size_t offset, std::size_t bytes,
+                    const std::function<bool(std::string_view)> &visit) const;
+    /// As PieceTable::slice().
+    [[nodiscard]] std::string_view slice(std::size_t offset, std::size_t bytes,
+                                         std::string &scratch) const;
+    /// A copy of the whole text.
+    [[nodiscard]] std::string str() const;
+
+  private:
+    friend class PieceTable;
+    std::vector<std::string_view> runs;
+    std::vector<std::shared_ptr<const void>> owners;
+    std::size_t bytes{};
+  };
+  /// The text as it stands, in O(pieces). See Snapshot.
+  [[nodiscard]] Snapshot snapshot() const;
+
+  /// See gleditor::alignToCharacterStart(), which this is for a piece table.
+  [[nodiscard]] std::size_t alignToCharacterStart(std::size_t offset) const;
+  /// See gleditor::alignToCharacterEnd().
+  [[nodiscard]] std::size_t alignToCharacterEnd(std::size_t offset) const;
+
+private:
+  struct Node;
+  using NodeIndex = std::int32_t;
+  static constexpr NodeIndex none = -1;
+
+  /// The text the table started from, which is buffer zero to a piece, and
+  /// whatever keeps it where it is.
+  std::string_view original;
+  std::shared_ptr<const void> originalOwner;
+  /**
+   * @brief Where insertions go: buffer one onwards to a piece. Each only ever
+   *        grows at its end, and only up to the capacity it was given, so a
+   *        view into one stays valid for as long as the table does.
+   *
+   * Taken in blocks rather than as one growing string: a string that
+   * reallocated would move every byte ever typed and invalidate every view
+   * into them. Shared, so that a Snapshot can keep them.
+   */
+  std::vector<std::shared_ptr<std::string>> buffers;
+  /// Tree nodes, addressed by index so that a node is a few words and the
+  /// whole tree moves with the table. Freed slots are reused.
+  std::vector<Node> nodes;
+  std::vector<NodeIndex> freeNodes;
+  NodeIndex root{none};
+  /// State of the generator the tree's balancing priorities come from. Fixed,
+  /// so that a given sequence of edits always builds the same tree.
+  std::uint32_t seed{0x9E3779B9U};
+
+  NodeIndex makeNode(std::uint32_t buffer, std::size_t start,
+                     std::size_t length);
+  void freeTree(NodeIndex node);
+  void update(NodeIndex node);
+  [[nodiscard]] std::size_t bytesUnder(NodeIndex node) const;
+  [[nodiscard]] std::size_t countUnder(NodeIndex node) const;
+  /// Cut the tree under @p node into the first @p offset bytes and the rest,
+  /// dividing the piece the offset lands in if it lands inside one.
+  void split(NodeIndex node, std::size_t offset, NodeIndex &left,
+             NodeIndex &right);
+  [[nodiscard]] NodeIndex merge(NodeIndex left, NodeIndex right);
+  /// Lengthen the last piece under @p node by @p bytes, if it ends exactly
+  /// where the next insertion into @p buffer will be written.
+  bool extendLast(NodeIndex node, std::uint32_t buffer, std::size_t end,
+                  std::size_t bytes);
+  /// Append @p text to the insertion buffers, returning where it went.
+  std::pair<std::uint32_t, std::size_t> append(std::string_view text);
+  [[nodiscard]] std::string_view viewOf(const Node &node) const;
+  bool visitRange(NodeIndex node, std::size_t offset, std::size_t bytes,
+                  const std::function<bool(std::string_view)> &visit) const;
+};
+
+} // namespace gleditor
+
+#endif // GLEDITOR_PIECE_TABLE_H
+// vi: set sw=2 sts=2 ts=2 et:
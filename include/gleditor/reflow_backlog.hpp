@@ -0,0 +1,65 @@
+/**
+ * @file reflow_backlog.hpp
+ * @brief Pages a reflow has not reached yet, and where they are meanwhile.
+ *
+ * An edit that spills its page lays pages out until pagination re-syncs, and
+ * some edits never let it: delete the one paragraph break of a file that is
+ * otherwise a single paragraph, and every page after it ends somewhere else.
+ * Done in one go that is hundreds of pages shaped inside one frame.
+ *
+ * So a reflow that runs out of its frame's time stops after a whole page and
+ * carries on in the next frame. Until it gets there, the pages it has not
+ * reached are still the pages they were: laid out from where they used to
+ * start, over text that has not changed since, only moved along by what the
+ * edit did. Each is still a good page of the text it holds, and it goes on
+ * being drawn and picked. It is only its place among the new pages that is
+ * wrong -- the first of them starts a little before the last new page ends,
+ * so the text between is on both.
+ *
+ * The page index keeps what every page spans, the new pages and the old ones,
+ * so it sums to a little more than the text. Past the last new page, then, it
+ * is out by a constant: where a page not yet reached really starts is where
+ * the index says, plus the skew. Through that, an offset picked on one of
+ * those pages comes back an offset into the text as it is now.
+ */
+#ifndef GLEDITOR_REFLOW_BACKLOG_H
+#define GLEDITOR_REFLOW_BACKLOG_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <gleditor/page_index.hpp>
+
+namespace gleditor {
+
+struct ReflowBacklog {
+  /// The first page the reflow has not reached. Every page from here on is
+  /// one of the old ones.
+  std::size_t firstStale{};
+  /// Where a page from firstStale on really starts, less where the index puts
+  /// it. Never positive: a reflow only stops once it has passed the start of
+  /// the page it stops before.
+  std::int64_t skew{};
+
+  /// Where page @p page starts in the text. A @p page equal to the index's
+  /// size is the end of the text.
+  [[nodiscard]] std::uint64_t startOf(const PageIndex &index,
+                                      std::size_t page) const;
+  /// Which page @p offset is on: a new page up to where the reflow has got
+  /// to, and one not yet reached after.
+  [[nodiscard]] std::size_t pageAt(const PageIndex &index,
+                                   std::uint64_t offset) const;
+  /// Where the reflow carries on from: the end of the last new page.
+  [[nodiscard]] std::uint64_t resumeAt(const PageIndex &index) const {
+    return index.startOf(firstStale);
+  }
+  /// Pages still to be reached.
+  [[nodiscard]] std::size_t pagesLeft(const PageIndex &index) const {
+    return index.size() - firstStale;
+  }
+};
+
+} // namespace gleditor
+
+#endif // GLEDITOR_REFLOW_BACKLOG_H
+// vi: set sw=2 sts=2 ts=2 et:
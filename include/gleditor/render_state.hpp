@@ -10,9 +10,12 @@
 #define GLEDITOR_RENDER_STATE_H
 
 #include <memory>
+#include <string>
 #include <vector>
 
 #include <gleditor/glyphcache/cache.hpp>
+#include <gleditor/page_impostors.hpp>
+#include <gleditor/residency.hpp>
 #include <gleditor/render/types.hpp>
 
 namespace render {
@@ -31,7 +34,7 @@ struct RenderState {
    *        must outlive the state.
    */
   explicit RenderState(render::RenderDevice *aDevice)
-      : device(aDevice), glyphCache(aDevice) {}
+      : device(aDevice), glyphCache(aDevice), impostors(aDevice) {}
 
   render::RenderDevice *device;           ///< Active graphics device.
   GlyphCache glyphCache;                  ///< Shared glyph atlas.
@@ -47,6 +50,16 @@ struct RenderState {
    * between frames so that collecting it costs no allocation.
    */
   std::vector<render::GlyphBatch> pageBatches;
+  /// Which pages of the open documents keep their rows on the device, across
+  /// all of them: the budget is the device's, not any one document's.
+  gleditor::PageResidency residency;
+  /// Where documents' built pages are kept between runs, so that a file opened
+  /// again is not shaped again; see gleditor/page_cache.hpp. Empty keeps none.
+  /// Set before the first document opens, and read by the loader threads.
+  std::string pageCacheDir;
+  /// Pictures of the pages held far enough off to be drawn as one, across
+  /// every document; see gleditor/page_impostors.hpp.
+  gleditor::PageImpostors impostors;
 };
 
 #endif // GLEDITOR_RENDER_STATE_H
@@ -22,11 +22,15 @@
 // graphics API, so this costs nothing in coupling.
 #include <gleditor/a11y/documents.hpp>
 #include <gleditor/caret.hpp>
+#include <gleditor/cluster_table.hpp>
+#include <gleditor/impostor_atlas.hpp>
 #include <gleditor/draw_budget.hpp>
 #include <gleditor/frame_contributor.hpp>
+#include <gleditor/layout_budget.hpp>
 #include <gleditor/pick_observer.hpp>
 #include <gleditor/render/device.hpp>
 #include <gleditor/render/types.hpp>
+#include <gleditor/residency.hpp>
 #include <gleditor/span_decorator.hpp>
 #include <gleditor/state.hpp>
 #include <gleditor/text_source.hpp>
@@ -107,9 +111,11 @@ struct RenderItemOpenDoc : RenderItem {
   explicit RenderItemOpenDoc(std::shared_ptr<gleditor::TextSource> aSource)
       : RenderItem(Type::OpenDoc), source(std::move(aSource)) {}
   /// Convenience for the common case: a document that is a file on disk.
+  /// Mapped, so that a very large one is not read before it is shown.
   explicit RenderItemOpenDoc(const std::string &fileName)
       : RenderItem(Type::OpenDoc),
-        source(std::make_shared<gleditor::FileTextSource>(fileName)) {}
+        source(std::make_shared<gleditor::FileTextSource>(
+            fileName, gleditor::FileTextSource::Access::map)) {}
   ~RenderItemOpenDoc() override = default;
 };
 
@@ -307,6 +313,15 @@ private:
   /// RenderState by reference, so the render loop waits on them before
   /// returning.
   std::vector<std::future<void>> pendingDocLoads;
+  /**
+   * @brief Saves still writing, oldest first.
+   *
+   * Each waits for the one before it to finish before it writes, so that two
+   * saves of one file land in the order they were asked for, and the last
+   * text saved is the one the file ends up holding. Shared, for the next save
+   * to wait on.
+   */
+  std::vector<std::shared_future<void>> pendingSaves;
 
   /**
    * @brief Every animation in flight, stepped once per frame.
@@ -362,6 +377,17 @@ private:
   /// skipped as off screen, and drew coarsely. Reported by --benchmark, since
   /// culling that is not counted is culling nobody can check.
   DrawStats lastDraw{};
+  /// Residency as of the last measured frame, with the device memory the
+  /// documents' pools held and the budget it was held to.
+  gleditor::ResidencyStats benchResidency{};
+  std::size_t benchDeviceBytes{};
+  std::size_t benchBudgetBytes{};
+  /// Page shaping across the open documents as of the last measured frame.
+  gleditor::LayoutStats benchLayouts{};
+  /// The pages' cluster tables, as held and as they would be a box a cluster.
+  gleditor::ClusterMemory benchClusters{};
+  /// Pictures of pages made and let go of, as of the last measured frame.
+  gleditor::ImpostorStats benchImpostors{};
   /// Print the gathered timings. Reports the median rather than the mean: a
   /// software rasteriser under a virtual display produces occasional
   /// hundred-millisecond frames that no amount of averaging removes.
@@ -369,6 +395,28 @@ private:
   /// Drop loads that have already finished, so the list cannot grow without
   /// bound over the lifetime of the process.
   void reapFinishedDocLoads();
+  /// The same for saves.
+  void reapFinishedSaves();
+  /// Lay out the pages of @p docPtr off the render thread, as a load.
+  void loadPages(RenderState &state, const std::shared_ptr<Doc> &docPtr);
+  /// Build again, off the render thread, every page that came near the view
+  /// this frame without its rows.
+  void restoreWantedPages(RenderState &state);
+  /// Shape, off the render thread, the pages either side of wherever the
+  /// caret arrived this frame.
+  void prefetchLayouts(RenderState &state);
+  /// Paginate, off the render thread, any paste made this frame too long for
+  /// the reflow; see Doc::insert().
+  void streamInsertions(RenderState &state);
+  /// Draw, off the render thread, the pictures of pages asked for this frame
+  /// and the one before.
+  void renderImpostors(RenderState &state);
+  /// Give back the rows of the pages out of view longest, across every open
+  /// document, while their pools hold more than the page memory budget.
+  void enforcePageBudget(RenderState &state);
+  /// Reflow every document's edits since the last frame, and carry on with
+  /// reflows spread over frames, within the reflow budget between them.
+  void reflowPending(RenderState &state) const;
   /// True while the render queue is non-empty or a document load is still
   /// running.
   [[nodiscard]] bool hasPendingWork() const;
@@ -425,6 +473,10 @@ protected:
    * silently is worse than one that never ran: the document at @p index has
    * no name yet (created with "new"), the write itself failed (permissions,
    * a full disk, a revoked Android Uri grant), or it succeeded.
+   *
+   * The writing happens on a thread of its own, from a snapshot of the text
+   * taken here, so the frame that asked for the save is not held up by it
+   * and neither is the typing after. The toast comes when it is done.
    */
   void saveDoc(RenderState &state, std::uint32_t index);
 
@@ -0,0 +1,114 @@
+/**
+ * @file residency.hpp
+ * @brief Which pages keep their geometry on the device, under a budget.
+ *
+ * A page's vertex rows stay in its document's buffer pool for as long as the
+ * document is open, at a row per glyph: a few megabytes of log comes to more
+ * than a hundred megabytes of device memory, and a software rasteriser runs out
+ * of it with a few such documents open. Most of those rows belong to pages
+ * nobody has looked at since they were loaded.
+ *
+ * So a page that has been out of view for a while can give its rows back. It
+ * keeps what it needs to be found and picked -- where it starts, how much text
+ * it holds, its clusters -- and builds its rows again when it comes back
+ * towards the view, the same way a loader thread built them the first time.
+ *
+ * This decides which pages go and counts what happened. Which pages there are,
+ * and what giving rows back involves, is the documents' business.
+ */
+#ifndef GLEDITOR_RESIDENCY_H
+#define GLEDITOR_RESIDENCY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace gleditor {
+
+/// What residency has cost, for a report.
+struct ResidencyStats {
+  /// Page draws whose rows were there when the page was in view.
+  std::uint64_t hits{};
+  /// Page draws whose rows had been given back, so the page was not drawn
+  /// until they had been built again.
+  std::uint64_t misses{};
+  /// Pages that gave their rows back.
+  std::uint64_t evictions{};
+  /// Pages whose rows were built again after an eviction.
+  std::uint64_t restores{};
+};
+
+class PageResidency {
+public:
+  /// A page that could give its rows back.
+  struct Candidate {
+    /// Device memory its rows hold.
+    std::size_t bytes{};
+    /// The last frame it was in view or near it.
+    std::uint64_t lastSeen{};
+  };
+
+  /**
+   * @brief Frames a page has to have been out of view for before it can be
+   *        evicted.
+   *
+   * A couple of seconds. A page the camera has just swung away from is the
+   * page it is most likely to swing back to, and building it again costs far
+   * more than the frames its rows sat unused.
+   */
+  static constexpr std::uint64_t defaultGraceFrames = 120;
+
+  /// @param budgetBytes Device memory the documents' vertex rows may hold
+  ///        between them. Zero is no limit.
+  explicit PageResidency(std::size_t budgetBytes = 0,
+                         std::uint64_t graceFrames = defaultGraceFrames)
+      : budget(budgetBytes), grace(graceFrames) {}
+
+  void setBudget(std::size_t budgetBytes) { budget = budgetBytes; }
+  [[nodiscard]] std::size_t budgetBytes() const { return budget; }
+
+  /// Start a frame. Pages seen during it are stamped with frame().
+  void beginFrame() { current++; }
+  [[nodiscard]] std::uint64_t frame() const { return current; }
+
+  /// Whether @p deviceBytes of rows is more than the budget allows.
+  [[nodiscard]] bool overBudget(std::size_t deviceBytes) const {
+    return 0 != budget && deviceBytes > budget;
+  }
+
+  /**
+   * @brief The candidates to evict to bring @p deviceBytes within the budget,
+   *        by position in @p candidates.
+   *
+   * Least recently seen first, and only those out of view for the grace
+   * period: a budget too small for what is in view is overrun rather than met
+   * by evicting pages that would be built again next frame. Counted as
+   * evictions; the caller has to carry them out.
+   */
+  [[nodiscard]] std::vector<std::size_t>
+  chooseEvictions(std::span<const Candidate> candidates,
+                  std::size_t deviceBytes);
+
+  /// Count a frame's page draws: @p hits drawn from their rows, @p misses
+  /// in view with none.
+  void recordDraws(std::uint32_t hits, std::uint32_t misses) {
+    counts.hits += hits;
+    counts.misses += misses;
+  }
+  /// Count a page that has its rows back.
+  void recordRestore() { counts.restores++; }
+
+  [[nodiscard]] const ResidencyStats &stats() const { return counts; }
+
+private:
+  std::size_t budget;
+  std::uint64_t grace;
+  std::uint64_t current{};
+  ResidencyStats counts;
+};
+
+} // namespace gleditor
+
+#endif // GLEDITOR_RESIDENCY_H
+// vi: set sw=2 sts=2 ts=2 et:
@@ -0,0 +1,100 @@
+/**
+ * @file save_file.hpp
+ * @brief Writing a document's text to its file, off the render thread.
+ *
+ * A save used to copy the whole text into one string and hand it to
+ * Glib::file_set_contents() on the render thread, which then waited for the
+ * write and the fsync before drawing another frame. On the 4.6 MB sample that
+ * is a visible stall, and on a slow disk a long one. Here the text arrives as
+ * a PieceTable::Snapshot -- the pieces, not the bytes -- and is written run by
+ * run on whatever thread calls saveText(), while the document goes on being
+ * edited.
+ *
+ * There are two ways to write it. Replacing writes the whole text to a
+ * temporary beside the file, flushes it to the disk and renames it over the
+ * file, so that the file is at every moment either the old text or the new one.
+ * Rewriting the tail writes only what follows the first byte that changed, in
+ * place: for an edit near the end of a long file that is a few kilobytes
+ * rather than megabytes, at the price of a window in which an interrupted
+ * write leaves the file half old and half new. It is asked for, never chosen,
+ * and taken only when the file is still exactly what the document last read
+ * or wrote -- same size, same modification time -- since the bytes it leaves
+ * alone are only known to be right if nobody else has written there since.
+ * Nor is it taken while the text is still read from a mapping of the file
+ * itself, as a document opened from disk is until its first save replaces the
+ * file: the write would change the text under the pieces that read it, and a
+ * shorter file would take pages out from under the mapping.
+ */
+#ifndef GLEDITOR_SAVE_FILE_H
+#define GLEDITOR_SAVE_FILE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+#include <gleditor/piece_table.hpp>
+
+namespace gleditor {
+
+/// What a file looked like when it was last read or written: enough to tell
+/// that nobody has written it since.
+struct FileStamp {
+  std::uint64_t bytes{};
+  std::filesystem::file_time_type modified;
+
+  bool operator==(const FileStamp &) const = default;
+};
+
+/// @p path's stamp, or nullopt when it cannot be had.
+[[nodiscard]] std::optional<FileStamp> stampOf(const std::filesystem::path &path);
+
+enum class SaveMethod : std::uint8_t {
+  /// The whole text to a temporary, renamed over the file.
+  replace,
+  /// What follows the first changed byte, over the file in place.
+  tail,
+};
+
+struct SaveRequest {
+  std::filesystem::path path;
+  /// Leading bytes the text and the file are known to have in common, when
+  /// the file is as @ref expected says.
+  std::uint64_t unchanged{};
+  /// The file as it was when the text last matched it. Nullopt when it never
+  /// has, or nobody knows: a replace, then, whatever @ref inPlace says.
+  std::optional<FileStamp> expected;
+  /// Whether rewriting the tail is allowed.
+  bool inPlace{};
+  /// Whether some of the text is read from a mapping of the file at @ref path
+  /// -- this one, not a copy of it. A replace, then, whatever @ref inPlace
+  /// says; see FileTextSource.
+  bool mapsFile{};
+};
+
+struct SaveOutcome {
+  SaveMethod method{SaveMethod::replace};
+  /// Bytes written to the disk.
+  std::uint64_t written{};
+  /// The file as this left it. Meaningful only when ok().
+  FileStamp stamp;
+  /// Why the save failed; empty when it did not.
+  std::string error;
+
+  [[nodiscard]] bool ok() const { return error.empty(); }
+};
+
+/**
+ * @brief Write @p text to @p request.path, as the request allows.
+ *
+ * Blocking, and meant for a thread of its own. Reports failure rather than
+ * throwing: a save that fails is something to tell the person, not a reason
+ * for the thread to stop. A replace that fails leaves the file as it was.
+ */
+[[nodiscard]] SaveOutcome saveText(const PieceTable::Snapshot &text,
+                                   const SaveRequest &request);
+
+} // namespace gleditor
+
+#endif // GLEDITOR_SAVE_FILE_H
+// vi: set sw=2 sts=2 ts=2 et:
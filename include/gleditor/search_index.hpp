@@ -0,0 +1,344 @@
+/**
+ * @file search_index.hpp
+ * @brief Every place a pattern occurs in a document, kept true as it is edited.
+ *
+ * Finding a word in a document of a gigabyte takes a good part of a second
+ * even at memory speed, and an editor that did that on the thread drawing the
+ * frame would stop drawing for as long. So the whole text is searched on a
+ * thread of its own, a chunk at a time, from a snapshot of the piece table --
+ * which goes on being edited meanwhile -- and what each chunk finds is handed
+ * back as it is found, so the first hits are on screen long before the last
+ * are known.
+ *
+ * An edit does not start the search again. What it can have changed is
+ * confined to the bytes it touched and the few either side a match could reach
+ * across: for a literal, one byte fewer than the pattern; for an expression,
+ * which is matched a line at a time, the line. The hits there are dropped, the
+ * ones after are moved by what the edit added or took away, and only that
+ * window is searched again. Hits still on their way from a search begun before
+ * the edit are put through the same edits when they arrive, from a journal
+ * kept until nothing older than it is outstanding.
+ *
+ * Moving every hit after an edit would make a keystroke near the top of a file
+ * with millions of them cost millions of writes. The hits are kept in blocks
+ * instead, each with an offset its hits are all moved by, so an edit rewrites
+ * the block it lands in and adds a number to each block after it.
+ */
+#ifndef GLEDITOR_SEARCH_INDEX_H
+#define GLEDITOR_SEARCH_INDEX_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <regex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <gleditor/piece_table.hpp>
+#include <gleditor/utf8.hpp>
+
+namespace gleditor {
+
+/// Where a pattern was found: a half-open range of document-global bytes.
+struct SearchHit {
+  std::uint32_t start{};
+  std::uint32_t end{};
+
+  friend bool operator==(const SearchHit &, const SearchHit &) = default;
+};
+
+/**
+ * @brief Offset of the first @p needle in @p haystack at or after @p from, or
+ *        std::string_view::npos.
+ *
+ * Compares the needle's first and last bytes with a vector's worth of
+ * positions at once, and only the positions where both agree byte by byte, so
+ * that text full of the first letter alone is still crossed a vector at a
+ * time. Runs on whichever of the UTF-8 kernels the machine has, since it needs
+ * the same instructions; see gleditor/utf8.hpp. A kernel the machine cannot
+ * run is taken as scalar.
+ */
+[[nodiscard]] std::size_t findLiteral(std::string_view haystack,
+                                      std::string_view needle,
+                                      std::size_t from = 0);
+[[nodiscard]] std::size_t findLiteral(std::string_view haystack,
+                                      std::string_view needle,
+                                      std::size_t from, Utf8Kernel kernel);
+
+/**
+ * @class SearchPattern
+ * @brief What is being looked for, and looking for it in a run of text.
+ *
+ * A literal is found wherever it starts, overlapping occurrences included, so
+ * whether a place is a hit depends only on the bytes there and never on where
+ * the search began -- which is what lets a window be searched on its own after
+ * an edit and agree with a search of the whole text. An expression is
+ * ECMAScript, as std::regex has it, matched against each line without its
+ * newline; empty matches are not hits.
+ *
+ * std::regex is never given more than expressionWindow bytes at once: the
+ * library's matcher recurses once for every character a match attempt
+ * consumes, and a line of a few tens of kilobytes runs it off the end of the
+ * stack. A longer line is matched in windows that overlap by half, each
+ * keeping the matches that start in its first half, so a match is found
+ * whole up to half a window long; a longer one only as far as its window
+ * reaches, if at all.
+ */
+class SearchPattern {
+public:
+  /// Most bytes of a line std::regex is asked to match against at once.
+  static constexpr std::size_t expressionWindow = 1024;
+
+  SearchPattern() = default;
+
+  /// @p bytes as they are.
+  [[nodiscard]] static SearchPattern literal(std::string bytes);
+
+  /// @throws std::regex_error when @p source is not an expression.
+  [[nodiscard]] static SearchPattern expression(std::string source,
+                                                bool ignoreCase = false);
+
+  /// Whether there is nothing to look for.
+  [[nodiscard]] bool empty() const { return text.empty(); }
+  /// Whether a match is confined to a line, rather than to its own length.
+  [[nodiscard]] bool linewise() const { return compiled.has_value(); }
+  /// What was asked for, as it was written.
+  [[nodiscard]] const std::string &source() const { return text; }
+
+  /// Bytes a literal match reaches past the place it starts. Nothing for an
+  /// expression, whose window is its line.
+  [[nodiscard]] std::uint32_t reach() const;
+
+  /**
+   * @brief Append every match in @p run, @p base being the offset of its first
+   *        byte, in order.
+   *
+   * For an expression the run should hold whole lines: one cut short is
+   * matched as though it ended there.
+   */
+  void find(std::string_view run, std::uint32_t base,
+            std::vector<SearchHit> &out) const;
+
+private:
+  std::string text;
+  std::optional<std::regex> compiled;
+
+  /// find() for an expression, over the line [@p begin, @p end) of @p run.
+  void findInLine(std::string_view run, std::size_t begin, std::size_t end,
+                  std::uint32_t base, std::vector<SearchHit> &out) const;
+};
+
+/**
+ * @class SearchHits
+ * @brief Hits in order of where they start, moved cheaply by an edit.
+ *
+ * Hits are ordered by their ends as well as their starts, which both kinds of
+ * pattern guarantee -- a literal's hits are all one length, and an
+ * expression's do not overlap -- and which is what finding the first hit an
+ * edit reaches relies on.
+ */
+class SearchHits {
+public:
+  /// Hits a block holds after it is split; one grows to twice this first.
+  static constexpr std::size_t blockSize = 1024;
+
+  [[nodiscard]] std::size_t size() const { return count; }
+  [[nodiscard]] bool empty() const { return 0 == count; }
+  void clear();
+
+  /// Merge @p found, which is in order, into the hits there are.
+  void add(std::span<const SearchHit> found);
+
+  /**
+   * @brief Follow an edit that replaced @p removed bytes at @p at with
+   *        @p inserted.
+   *
+   * A hit the edit cut into or removed is dropped; one after it is moved by
+   * the difference; one before it stays where it is.
+   */
+  void edit(std::uint32_t at, std::uint32_t removed, std::uint32_t inserted);
+
+  /// Drop every hit reaching into [@p from, @p to), or across @p from when
+  /// the two are the same.
+  void drop(std::uint32_t from, std::uint32_t to);
+
+  /// The first hit starting at or after @p offset.
+  [[nodiscard]] std::optional<SearchHit> firstFrom(std::uint32_t offset) const;
+  /// The last hit starting before @p offset.
+  [[nodiscard]] std::optional<SearchHit>
+  lastBefore(std::uint32_t offset) const;
+  /// The first hit and the last.
+  [[nodiscard]] std::optional<SearchHit> first() const;
+  [[nodiscard]] std::optional<SearchHit> last() const;
+
+  /// Append to @p out, in order, the hits reaching into [@p from, @p to), no
+  /// more than @p limit of them.
+  void within(std::uint32_t from, std::uint32_t to, std::size_t limit,
+              std::vector<SearchHit> &out) const;
+
+  /// Every hit, in order. Linear; for tests.
+  [[nodiscard]] std::vector<SearchHit> all() const;
+
+  /// Blocks the hits are in, for tests.
+  [[nodiscard]] std::size_t blockCount() const { return blocks.size(); }
+
+private:
+  /// A run of hits, stored less @p shift: an edit before the block moves all
+  /// of them by changing that.
+  struct Block {
+    std::vector<SearchHit> hits;
+    std::int64_t shift{};
+  };
+
+  std::vector<Block> blocks;
+  std::size_t count{};
+
+  [[nodiscard]] static SearchHit placed(const Block &block, std::size_t i);
+  /// Fold a block's shift into its hits, so they can be changed one by one.
+  static void settle(Block &block);
+  /// The first block with a hit ending after @p offset.
+  [[nodiscard]] std::size_t firstEndingAfter(std::uint32_t offset) const;
+  /// Break a block grown too large into blocks of blockSize.
+  void split(std::size_t index);
+  /// Remove @p index if it has no hits left. Returns whether it did.
+  bool removeIfEmpty(std::size_t index);
+};
+
+/**
+ * @class SearchIndex
+ * @brief The hits of one pattern in one text, found off the calling thread
+ *        and kept true through edits.
+ *
+ * Everything but the scanning happens on the thread that owns the text -- the
+ * render thread, for a document -- and is called with the text as it is after
+ * the change being reported. The scanning thread only ever reads snapshots.
+ */
+class SearchIndex {
+public:
+  /// Bytes the scanning thread searches between handing back what it found.
+  static constexpr std::uint32_t chunkBytes = 1U << 20;
+  /// A window an edit leaves to be searched again is searched at once up to
+  /// this size, and handed to the scanning thread past it.
+  static constexpr std::uint32_t inlineBytes = 64U << 10;
+  /// Furthest an expression's line is looked for either side of an edit. A
+  /// longer line is searched in pieces of about this length.
+  static constexpr std::uint32_t lineLimit = chunkBytes;
+
+  SearchIndex();
+  ~SearchIndex();
+
+  SearchIndex(const SearchIndex &)            = delete;
+  SearchIndex &operator=(const SearchIndex &) = delete;
+  SearchIndex(SearchIndex &&)                 = delete;
+  SearchIndex &operator=(SearchIndex &&)      = delete;
+
+  /// Search @p text for @p pattern from the beginning, forgetting whatever was
+  /// being searched for before. An empty pattern is the same as stop().
+  void start(const PieceTable &text, SearchPattern pattern);
+  /// Forget the search, and anything the scanning thread is still doing for
+  /// it.
+  void stop();
+
+  /// @p bytes were inserted into @p text at @p at.
+  void inserted(const PieceTable &text, std::uint32_t at, std::uint32_t bytes);
+  /// @p bytes were removed from @p text at @p at.
+  void erased(const PieceTable &text, std::uint32_t at, std::uint32_t bytes);
+
+  /**
+   * @brief Take in what the scanning thread has found since last asked, up to
+   *        about @p limit hits of it.
+   *
+   * The limit is what keeps a pattern with millions of hits from costing one
+   * frame the time to merge all of them; the rest wait for the next call.
+   *
+   * @return Whether the hits changed.
+   */
+  bool collect(std::size_t limit = std::size_t{1} << 18);
+
+  /// Wait for the scanning thread to finish and take in everything it found.
+  void finish();
+
+  /// Whether any part of the text is still to be searched.
+  [[nodiscard]] bool scanning() const { return 0 != outstanding; }
+  /// The pattern searched for, or nothing.
+  [[nodiscard]] const SearchPattern *pattern() const { return current.get(); }
+  [[nodiscard]] const SearchHits &hits() const { return found; }
+
+private:
+  /// A change, as hits found before it must be moved through it: the bytes
+  /// replaced, and the window whose hits it may have changed.
+  struct Edit {
+    std::uint64_t generation{};
+    std::uint32_t at{};
+    std::uint32_t removed{};
+    std::uint32_t inserted{};
+    std::uint32_t from{};
+    std::uint32_t to{};
+  };
+
+  /// A range for the scanning thread: search [scanFrom, scanTo) of the text as
+  /// it was at `generation`, and keep what reaches into [keepFrom, keepTo).
+  struct Job {
+    std::uint64_t search{};
+    std::uint64_t generation{};
+    std::shared_ptr<const SearchPattern> pattern;
+    PieceTable::Snapshot text;
+    std::uint32_t scanFrom{};
+    std::uint32_t scanTo{};
+    std::uint32_t keepFrom{};
+    std::uint32_t keepTo{};
+  };
+
+  /// What a chunk of a job found. `last` when the job is finished.
+  struct Batch {
+    std::uint64_t search{};
+    std::uint64_t generation{};
+    std::vector<SearchHit> hits;
+    bool last{};
+  };
+
+  void changed(const PieceTable &text, std::uint32_t at, std::uint32_t removed,
+               std::uint32_t inserted);
+  /// Search [from, to) of @p text here and now, keeping what reaches into
+  /// [keepFrom, keepTo).
+  void searchNow(const PieceTable &text, std::uint32_t from, std::uint32_t to,
+                 std::uint32_t keepFrom, std::uint32_t keepTo);
+  void queue(const PieceTable &text, std::uint32_t scanFrom,
+             std::uint32_t scanTo, std::uint32_t keepFrom,
+             std::uint32_t keepTo);
+  void workerLoop();
+  void scan(const Job &job);
+
+  SearchHits found;
+  std::shared_ptr<const SearchPattern> current;
+  /// Edits since the oldest job still outstanding was queued.
+  std::vector<Edit> journal;
+  std::uint64_t generation{};
+  /// Jobs queued for this search whose last batch has not been collected.
+  std::uint32_t outstanding{};
+
+  /// Guards everything below it.
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable idle;
+  std::deque<Job> jobs;
+  std::vector<Batch> batches;
+  /// The search the scanning thread should still be working for. A job for
+  /// any other is abandoned between chunks.
+  std::uint64_t search{};
+  bool busy{};
+  bool stopping{};
+  std::thread worker;
+};
+
+} // namespace gleditor
+
+#endif // GLEDITOR_SEARCH_INDEX_H
+// vi: set sw=2 sts=2 ts=2 et:
@@ -104,6 +104,15 @@ struct AppState {
    * what makes the two paths comparable.
    */
   float coarseBelow{0.15F};
+  /**
+   * @brief Screen pixels per layout pixel below which a page not drawn coarsely
+   *        is drawn as a picture of itself, one quad for the whole page.
+   *
+   * Half a screen pixel per layout pixel is a glyph of about ten pixels: still
+   * legible, and already several thousand quads a page for what a picture of
+   * a few hundred pixels shows as well. Zero draws those pages glyph by glyph.
+   */
+  float impostorBelow{0.5F};
   /// Whether pages outside the view are skipped. Off draws every page of every
   /// document, which is how the culled frame is checked against the unculled
   /// one.
@@ -113,6 +122,35 @@ struct AppState {
   /// drawn while pages are still being built is measuring the loader, not the
   /// renderer.
   std::size_t benchmarkFrames{};
+  /**
+   * @brief Device memory, in bytes, the open documents' vertex rows may hold
+   *        between them before pages out of view give theirs back.
+   *
+   * A quarter of a gigabyte: two documents of a few megabytes each, entirely
+   * on the device, which is more than anybody is looking at. Zero keeps every
+   * page's rows for as long as its document is open.
+   */
+  std::size_t pageMemoryBudget{std::size_t{256} << 20};
+  /**
+   * @brief Time a frame may spend laying pages out again after an edit.
+   *
+   * Past it, a reflow that has not re-synced stops after the page it is on
+   * and carries on next frame; see gleditor/reflow_backlog.hpp. Four
+   * milliseconds leaves most of a 60 Hz frame for drawing, and is a handful of
+   * pages. Zero lays everything out in the frame the edit was made in.
+   */
+  std::chrono::milliseconds reflowBudget{4};
+  /// Whether pages built on opening a file are kept on disk for the next time
+  /// it is opened, and used when they are there, and the glyph atlas with
+  /// them. Off shapes every page and draws every glyph every time, which is
+  /// how a page read back is checked against one built.
+  bool pageCache{true};
+  /// Whether a save may rewrite only what follows the first byte changed
+  /// since the file was last read or written, in place, rather than replacing
+  /// the whole file. Quicker for an edit near the end of a long file; an
+  /// interrupted write then leaves the file half old and half new. See
+  /// gleditor/save_file.hpp.
+  bool saveInPlace{};
   /// When set, a driver error ends the render thread instead of being shown as
   /// a notification. Automated runs want it: a frame rendered by a driver that
   /// was reporting errors proves nothing, however plausible it looks.
@@ -0,0 +1,108 @@
+/**
+ * @file text_search.hpp
+ * @brief Finding text in an open document, and showing where it was found.
+ *
+ * Built only out of the hooks a program outside the library has: it hears
+ * about edits as a DocumentObserver and colours what it found as a
+ * SpanDecorator. The searching itself is gleditor/search_index.hpp, which
+ * knows nothing about documents; this is what ties one to a Doc, and what
+ * answers the two questions a reader asks of a search -- where is the next
+ * one, and which of these on screen are hits.
+ */
+#ifndef GLEDITOR_TEXT_SEARCH_H
+#define GLEDITOR_TEXT_SEARCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <gleditor/document_observer.hpp>
+#include <gleditor/search_index.hpp>
+#include <gleditor/span_decorator.hpp>
+
+class Doc;
+
+namespace gleditor {
+
+/**
+ * @class TextSearch
+ * @brief One pattern searched for in one document at a time.
+ *
+ * Render thread only, as observers and decorators are: it is called with the
+ * document mid-frame and mid-edit, and reads its text there. Register it with
+ * the renderer as a decorator; search() registers it with the document as an
+ * observer, and stop() or the destructor takes it off again.
+ */
+class TextSearch : public DocumentObserver, public SpanDecorator {
+public:
+  /// A warm yellow, distinct from the selection's blue, which wins where the
+  /// two overlap.
+  static constexpr std::uint32_t defaultColour = 0xFFE066FFU;
+
+  explicit TextSearch(std::uint32_t colour = defaultColour)
+      : hitColour(colour) {}
+  ~TextSearch() override;
+
+  TextSearch(const TextSearch &)            = delete;
+  TextSearch &operator=(const TextSearch &) = delete;
+  TextSearch(TextSearch &&)                 = delete;
+  TextSearch &operator=(TextSearch &&)      = delete;
+
+  /// Search @p doc for @p pattern, instead of whatever was being searched.
+  void search(const std::shared_ptr<Doc> &doc, SearchPattern pattern);
+  /// Search nothing.
+  void stop();
+
+  /// The document searched, while it is still open.
+  [[nodiscard]] std::shared_ptr<Doc> document() const { return target.lock(); }
+  /// Hits found so far.
+  [[nodiscard]] std::size_t hitCount() const { return index.hits().size(); }
+  /// Whether some of the document is still to be searched.
+  [[nodiscard]] bool scanning() const { return index.scanning(); }
+
+  /// The first hit starting after @p offset, coming round to the first of all
+  /// past the last. Takes in what the search has found since it was last
+  /// asked, so a hit can be stepped to before it has been drawn.
+  [[nodiscard]] std::optional<SearchHit> nextHit(std::uint32_t offset);
+  /// The last hit starting before @p offset, coming round to the last.
+  [[nodiscard]] std::optional<SearchHit> previousHit(std::uint32_t offset);
+
+  /// A hit, and the page it starts on.
+  struct PageHit {
+    std::size_t page{};
+    SearchHit hit;
+  };
+
+  /**
+   * @brief The first page after @p page with a hit on it, coming round, and
+   *        the first hit there.
+   *
+   * For stepping through a document a page of hits at a time, which for a
+   * pattern found thousands of times is the only stepping that gets anywhere.
+   */
+  [[nodiscard]] std::optional<PageHit> nextPageWithHit(std::size_t page);
+
+  void textInserted(Doc &doc, std::uint32_t at,
+                    const std::string &utf8) override;
+  void textErased(Doc &doc, std::uint32_t at,
+                  const std::string &removed) override;
+
+  /// The hits on the pages in view, and a little way either side.
+  void decorate(const Doc &doc, std::vector<SpanStyle> &out) override;
+
+private:
+  SearchIndex index;
+  std::weak_ptr<Doc> target;
+  /// Which document target was, for telling it from others without locking.
+  const Doc *watched{};
+  std::uint32_t hitColour;
+  /// Scratch for decorate().
+  std::vector<SearchHit> shown;
+};
+
+} // namespace gleditor
+
+#endif // GLEDITOR_TEXT_SEARCH_H
+// vi: set sw=2 sts=2 ts=2 et:
@@ -17,11 +17,27 @@
 #ifndef GLEDITOR_TEXT_SOURCE_H
 #define GLEDITOR_TEXT_SOURCE_H
 
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <utility>
 
 namespace gleditor {
 
+/**
+ * @brief Bytes a source lends rather than hands over, and what keeps them.
+ *
+ * The document holds @c owner for as long as any of its text is still these
+ * bytes, which for a document nobody edits is its whole life.
+ */
+struct SharedText {
+  std::string_view bytes;
+  std::shared_ptr<const void> owner;
+};
+
 /**
  * @brief Supplies a document's initial content.
  *
@@ -29,6 +45,9 @@ namespace gleditor {
  * thread built it -- which is a background loader thread for anything opened
  * from the command line. An implementation that touches shared state has to
  * say so.
+ *
+ * The document asks share() first and text() only when that has nothing to
+ * lend, so a source offering both is read once, not twice.
  */
 class TextSource {
 public:
@@ -50,6 +69,19 @@ public:
    */
   [[nodiscard]] virtual std::string text() const = 0;
 
+  /**
+   * @brief The document's text, in place, if it already exists somewhere that
+   *        can be pointed at.
+   *
+   * For text too large to want a copy of. The same rules as text() apply to
+   * what the bytes may contain; the difference is only that the document
+   * references them instead of owning them, and makes a copy of its own
+   * solely when they need repairing. Nothing to lend by default.
+   */
+  [[nodiscard]] virtual std::optional<SharedText> share() const {
+    return std::nullopt;
+  }
+
   /// What to call this document in diagnostics and in the window. Need not be
   /// a path, and need not be unique.
   [[nodiscard]] virtual std::string name() const = 0;
@@ -70,18 +102,56 @@ public:
  */
 [[nodiscard]] std::string stripByteOrderMark(std::string bytes);
 
-/// Reads the whole of a file. What a plain editor opens from its command line.
+/// How many leading bytes of @p bytes are a UTF-8 byte order mark: three or
+/// none. Refuses UTF-16 and UTF-32 as stripByteOrderMark() does, for a caller
+/// that wants to skip the mark without copying what follows it.
+[[nodiscard]] std::size_t byteOrderMarkLength(std::string_view bytes);
+
+/**
+ * @brief A file on disk. What a plain editor opens from its command line.
+ *
+ * Read into memory by default. Mapped, the file is never read as a whole:
+ * share() lends the mapping, the document's unedited text stays in it, and
+ * opening a file of a gigabyte costs the pages that are shaped rather than a
+ * gigabyte of reading and several of copying.
+ *
+ * A mapping sees whatever happens to the file while it is open, so a mapped
+ * file must not be rewritten in place by anybody -- this program included --
+ * while a document shows it. Replacing it, as saving does through a temporary
+ * file and a rename, leaves the mapping on the original and is safe.
+ * Shortening it is not: reading a page the file no longer reaches raises
+ * SIGBUS, which ends the program. A file written to in the last minute before
+ * opening is therefore read even when mapping is asked for, and lent from the
+ * copy, since the files that get truncated -- logs under logrotate's
+ * copytruncate -- are the ones still being written. One that has been quiet
+ * for longer and is truncated anyway is still fatal; open it with
+ * Access::read where that can happen.
+ */
 class FileTextSource : public TextSource {
 public:
-  explicit FileTextSource(std::string path) : filePath(std::move(path)) {}
+  enum class Access : std::uint8_t {
+    /// The file is read into a string and the document owns that.
+    read,
+    /// The file is mapped and the document reads it in place, unless it
+    /// was written to a moment ago; see the class.
+    map,
+  };
+
+  explicit FileTextSource(std::string path, const Access how = Access::read)
+      : filePath(std::move(path)), access(how) {}
 
   /// @throws Glib::FileError if the file cannot be read, and std::logic_error
   ///         for a UTF-16 or UTF-32 byte order mark.
   [[nodiscard]] std::string text() const override;
+  /// The mapping, past any byte order mark, when opened with Access::map; a
+  /// copy, when the file has only just been written to.
+  /// @throws As text() does.
+  [[nodiscard]] std::optional<SharedText> share() const override;
   [[nodiscard]] std::string name() const override { return filePath; }
 
 private:
   std::string filePath;
+  Access access;
 };
 
 /// Text a caller already has. The source for a document built rather than
@@ -27,6 +27,7 @@
 
 #include <gleditor/a11y/tree.hpp>
 #include <gleditor/buffer_pool.hpp>
+#include <gleditor/glyphcache/citation.hpp>
 #include <gleditor/render/diagnostics.hpp>
 #include <gleditor/render/types.hpp>
 
@@ -123,6 +124,14 @@ private:
     /// second notification with the same words as the first is a second
     /// notification and gets announced again.
     std::uint64_t serial{};
+    /// The glyph each row draws, by number, or GlyphCache::noGlyph: what finds
+    /// the rows again when the atlas is repacked under them.
+    std::vector<std::uint32_t> glyphOfRow;
+    /// Keeps those glyphs in the atlas for as long as the toast is up. Held
+    /// apart because a citation does not move.
+    std::unique_ptr<GlyphCitation> citation;
+    /// GlyphCache::repacks() before the first glyph was asked for.
+    std::uint64_t glyphsAt{};
   };
 
 public:
@@ -166,6 +175,9 @@ private:
   static constexpr std::uint32_t initialPoolRows = 1U << 12U;
 
   void dropOldest();
+  /// Rewrite where @p toast's glyphs are in the atlas, if it has been
+  /// repacked since they were asked for.
+  void relocateGlyphs(Toast &toast, const RenderState &state);
 
   render::RenderDevice *device;
   std::string fontName;
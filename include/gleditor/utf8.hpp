@@ -13,15 +13,31 @@
  * backwards and the end forwards covers whole characters; snapping both the
  * same way collapses a range naming part of one character to nothing, or
  * silently drops a character from the end.
+ *
+ * Validating and counting are here too, and are the part that is paid for by
+ * the megabyte: every document is validated once when it is opened, and every
+ * cluster of every page built is counted in characters. Both have vector
+ * kernels -- SSE2 and AVX2 on x86, NEON on ARM -- picked once, by what the
+ * processor running the program can do, with a plain byte loop underneath
+ * for everything else. Finding a boundary has none: in valid text it is at
+ * most three bytes away, which is fewer than it takes to load a vector.
  */
 #ifndef GLEDITOR_UTF8_H
 #define GLEDITOR_UTF8_H
 
+#include <cstddef>
 #include <cstdint>
+#include <span>
 #include <string_view>
 
 namespace gleditor {
 
+/// Whether @p byte continues a character rather than starting one.
+/// Continuation bytes are 10xxxxxx.
+[[nodiscard]] constexpr bool continuesCharacter(const char byte) {
+  return 0x80 == (static_cast<unsigned char>(byte) & 0xC0);
+}
+
 /**
  * @brief Move @p offset back to the start of the character it lands in.
  *
@@ -41,6 +57,79 @@ namespace gleditor {
 [[nodiscard]] std::uint32_t alignToCharacterEnd(std::string_view text,
                                                 std::uint32_t offset);
 
+/**
+ * @brief Byte offset of the character after the one starting at @p offset.
+ *
+ * Always advances, so a caller stepping through text cannot get stuck on a
+ * malformed byte; stops at the end.
+ */
+[[nodiscard]] std::size_t nextCharacter(std::string_view text,
+                                        std::size_t offset);
+
+/// The ways of validating and counting there are. Which of them a machine can
+/// run is utf8Kernels(); all of them give the same answers.
+enum class Utf8Kernel : std::uint8_t {
+  /// A byte at a time. Everywhere, and the reference for the others.
+  scalar,
+  /// Sixteen bytes at a time, on any x86-64. Skips ASCII a vector at a time
+  /// and validates what is not a byte at a time.
+  sse2,
+  /// Thirty-two bytes at a time, validating without branching on what the
+  /// bytes are. Most x86 processors since 2013.
+  avx2,
+  /// Sixteen bytes at a time, as AVX2 does it. Every 64-bit ARM processor.
+  neon,
+};
+
+/// Kernels this machine can run, fastest last.
+[[nodiscard]] std::span<const Utf8Kernel> utf8Kernels();
+
+/// The kernel used when none is named: the last of utf8Kernels().
+[[nodiscard]] Utf8Kernel utf8Kernel();
+
+/// @p kernel's name, for logs and the benchmark.
+[[nodiscard]] std::string_view nameOf(Utf8Kernel kernel);
+
+/**
+ * @brief Bytes from the start of @p text that are valid UTF-8.
+ *
+ * The whole text when all of it is, and otherwise the offset of the first
+ * byte of the first bad sequence. Overlong forms, surrogates, code points past
+ * U+10FFFF and nul bytes are all bad, as they are to Pango. A kernel this
+ * machine cannot run is taken as scalar.
+ */
+[[nodiscard]] std::size_t validUtf8(std::string_view text);
+[[nodiscard]] std::size_t validUtf8(std::string_view text, Utf8Kernel kernel);
+
+/**
+ * @brief Characters in @p text, counting the bytes that are not continuations.
+ *
+ * Exact for valid text; for anything else, a count of lead bytes.
+ */
+[[nodiscard]] std::size_t countCharacters(std::string_view text);
+[[nodiscard]] std::size_t countCharacters(std::string_view text,
+                                          Utf8Kernel kernel);
+
+/// What scanUtf8() found.
+struct Utf8Scan {
+  /// Bytes from the start that are valid UTF-8. The whole text when all of it
+  /// is, and otherwise the offset of the first bad sequence.
+  std::size_t valid{};
+  /// Characters in those bytes.
+  std::size_t characters{};
+};
+
+/**
+ * @brief Validate @p text and count its characters, in one pass.
+ *
+ * One pass, in chunks small enough to stay in cache between the two jobs: a
+ * document opened from a mapped file is read here for the first time, and
+ * validating all of it before counting any of it would bring every page in
+ * from disk twice. Invalid as validUtf8() has it.
+ */
+[[nodiscard]] Utf8Scan scanUtf8(std::string_view text);
+[[nodiscard]] Utf8Scan scanUtf8(std::string_view text, Utf8Kernel kernel);
+
 } // namespace gleditor
 
 #endif // GLEDITOR_UTF8_H
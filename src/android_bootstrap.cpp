@@ -252,6 +252,11 @@ copyOpenableUriToInternalStorage(JNIEnv *env, jobject activity, jobject uri,
   // this never has to sanitise whatever a content provider's own display
   // name happens to contain.
   const auto destPath = destDir / "opened-document";
+  // Removed rather than truncated: the document opened last time may still be
+  // showing, mapped from this file (FileTextSource::Access::map), and writing
+  // over it in place would change that document's text underneath it.
+  // Unlinked, the old file lives on for as long as its mapping does.
+  std::filesystem::remove(destPath, err);
   std::ofstream out(destPath, std::ios::binary | std::ios::trunc);
 
   constexpr jsize kChunkSize = 1 << 16;
@@ -463,7 +468,7 @@ bool androidSaveDocument(const std::string &documentPath,
     return false;
   }
   // "wt": truncate before writing, matching what overwriting a plain file
-  // (Glib::file_set_contents, the non-Android save path) already does. The
+  // (gleditor::saveText(), the non-Android save path) already does. The
   // plain "w" ContentResolver itself documents also truncates, but only for
   // providers that interpret it that way, which is not guaranteed of every
   // one a Uri could have come from.
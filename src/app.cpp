@@ -6,6 +6,7 @@
 
 #include <algorithm>
 #include <array>
+#include <chrono>
 #include <clocale>
 #include <cstdint>
 #include <cstdlib>
@@ -403,6 +404,37 @@ void addCommonArguments(argparse::ArgumentParser &parser, const bool detailed) {
       "covers fewer than this many screen pixels. Zero draws every "
       "visible page in full detail, which is far slower on a document "
       "held at a distance.");
+  everyday(
+      parser.add_argument("--impostor-below").default_value(std::string{"0.5"}),
+      "draw mid-distance pages as a picture below this scale",
+      "Draw a page as one quad showing a picture of it once one layout pixel "
+      "of it covers fewer than this many screen pixels, until --coarse-below "
+      "takes over. The picture is made on a worker and kept until the page "
+      "changes; zero draws those pages glyph by glyph.");
+  everyday(
+      parser.add_argument("--page-memory").default_value(std::string{"256"}),
+      "MiB of page geometry to keep on the device",
+      "Keep at most this many MiB of page geometry on the device across "
+      "every open document. Past it, the pages out of view longest give "
+      "their geometry back and build it again when they come back into "
+      "view. Zero keeps everything.");
+  everyday(
+      parser.add_argument("--reflow-budget").default_value(std::string{"4"}),
+      "milliseconds a frame may spend reflowing pages",
+      "Spend at most this many milliseconds of a frame laying pages out "
+      "again after an edit. An edit whose effect runs further carries on "
+      "over the frames after, showing the pages not yet reached as they "
+      "were. Zero finishes every reflow in the frame it started in.");
+  everyday(parser.add_argument("--save-in-place").flag(),
+           "save by rewriting only what changed, at the end of the file",
+           "Save by rewriting the file in place from the first byte that "
+           "changed since it was last read or written, rather than writing "
+           "the whole text to a temporary and renaming it over the file. "
+           "Much less to write after an edit near the end of a long file, "
+           "but a save that is interrupted leaves the file half old and half "
+           "new. Taken only when nothing else has written the file since, "
+           "and never by the first save of a file opened from disk, whose "
+           "text is still read from the file itself.");
 
   // Everything below drives the program without a person at the keyboard.
   // Grouped only in the detailed listing: argparse prints a group's heading
@@ -434,6 +466,15 @@ void addCommonArguments(argparse::ArgumentParser &parser, const bool detailed) {
              "Draw every page of every document, including those entirely "
              "outside the view. Only useful for checking that culling changes "
              "nothing it should not: the frame must come out identical.");
+  automation(parser.add_argument("--no-page-cache").flag(),
+             "shape every page, rather than reading back the last run's",
+             "Lay every page out and shape it, rather than reading back the "
+             "pages kept from the last time the same file was opened in the "
+             "same font, and keep nothing for next time. The glyph atlas the "
+             "last run drew is not read back either, so every glyph is drawn "
+             "afresh. For checking a page read back against the page it was: "
+             "the frame must come out identical. The cache is under "
+             "$GLEDITOR_CACHE_DIR, or the platform's user cache directory.");
   automation(parser.add_argument("--benchmark").default_value(std::string{"0"}),
              "draw N settled frames, report the timings and quit",
              "Draw N frames once the document has settled, then report frame, "
@@ -542,7 +583,15 @@ render::Backend applyCommonArguments(argparse::ArgumentParser &parser,
   state->printAssetDir   = parser["--print-asset-dir"] == true;
   state->benchmarkFrames = std::stoul(parser.get<std::string>("--benchmark"));
   state->cullPages       = parser["--no-cull"] == false;
+  state->pageCache       = parser["--no-page-cache"] == false;
+  state->saveInPlace     = parser["--save-in-place"] == true;
   state->coarseBelow     = std::stof(parser.get<std::string>("--coarse-below"));
+  state->impostorBelow =
+      std::stof(parser.get<std::string>("--impostor-below"));
+  state->pageMemoryBudget =
+      std::stoull(parser.get<std::string>("--page-memory")) << 20;
+  state->reflowBudget = std::chrono::milliseconds(
+      std::stoul(parser.get<std::string>("--reflow-budget")));
   state->screenshotPath  = parser.get<std::string>("--screenshot");
   state->dumpAccessibility = parser["--dump-a11y"] == true;
   state->strictDiagnostics = parser["--strict-diagnostics"] == true;
@@ -6,6 +6,7 @@
 
 #include <algorithm>
 #include <format>
+#include <functional>
 #include <limits>
 #include <list>
 #include <optional>
@@ -358,6 +359,47 @@ void BufferPool::trim() {
   }
 }
 
+std::uint32_t BufferPool::compact() {
+  // Last in the buffer first, since those are what stand between the holes and
+  // the end.
+  std::vector<std::pair<std::uint32_t, std::uint32_t>> byOffset;
+  byOffset.reserve(placements.size());
+  for (const auto &[id, placement] : placements) {
+    byOffset.emplace_back(placement.rowOffset, id);
+  }
+  std::ranges::sort(byOffset, std::greater{});
+
+  std::uint32_t moved = 0;
+  for (const auto &[offset, id] : byOffset) {
+    auto &placement = placements.at(id);
+    const auto hole = std::ranges::find_if(free, [&](const auto &run) {
+      return run.second >= placement.roomRows &&
+             run.first + placement.roomRows <= offset;
+    });
+    if (free.end() == hole) {
+      continue;
+    }
+    const auto target = hole->first;
+    hole->first += placement.roomRows;
+    hole->second -= placement.roomRows;
+    if (0 == hole->second) {
+      free.erase(hole);
+    }
+    if (0 != placement.rowCount) {
+      device->copyBufferRange(
+          handle, static_cast<std::size_t>(offset) * rowStrideBytes,
+          static_cast<std::size_t>(target) * rowStrideBytes,
+          static_cast<std::size_t>(placement.rowCount) * rowStrideBytes);
+    }
+    placement.rowOffset = target;
+    insertRun(free, offset, placement.roomRows);
+    movesMade++;
+    moved++;
+  }
+  trim();
+  return moved;
+}
+
 void BufferPool::write(const Allocation &allocation,
                        const std::uint32_t firstRow,
                        const std::span<const std::byte> data) {
@@ -381,4 +423,26 @@ void BufferPool::write(const Allocation &allocation,
   device->updateBuffer(handle, offset, data);
 }
 
+void BufferPool::patch(const Allocation &allocation, const std::uint32_t row,
+                       const std::size_t offset,
+                       const std::span<const std::byte> data) {
+  if (offset + data.size() > rowStrideBytes) {
+    throw std::invalid_argument(
+        std::format("BufferPool::patch: {} bytes at {} overrun a row of {}",
+                    data.size(), offset, rowStrideBytes));
+  }
+  const auto &placement = placementOf(allocation, "patch");
+  if (row >= placement.rowCount) {
+    throw std::out_of_range(
+        std::format("BufferPool::patch: row {} is past an allocation of {} "
+                    "rows",
+                    row, placement.rowCount));
+  }
+  device->updateBuffer(
+      handle,
+      (static_cast<std::size_t>(placement.rowOffset + row) * rowStrideBytes) +
+          offset,
+      data);
+}
+
 // vi: set sw=2 sts=2 ts=2 et:
@@ -109,6 +109,11 @@ void Canvas::createPipeline(const render::PipelineDesc &documentDesc,
 void Canvas::clear() {
   rows.clear();
   pendingInstances = 0;
+  citation.release();
+}
+
+bool Canvas::glyphsMoved(const GlyphCache &glyphs) const {
+  return !citation.empty() && glyphsAt != glyphs.committedRepacks();
 }
 
 void Canvas::setTag(const std::uint32_t kind, const std::uint32_t index) {
@@ -246,7 +251,10 @@ TextMetrics Canvas::addText(RenderState &state, const float left,
     }
     const std::string_view chr(raw.data() + cluster.start, length);
 
-    const auto glyph  = state.glyphCache.put(chr, font);
+    if (citation.empty()) {
+      glyphsAt = state.glyphCache.repacks();
+    }
+    const auto glyph  = state.glyphCache.put(chr, font, &citation);
     const auto width  = static_cast<float>(static_cast<int>(glyph.dims.width));
     const auto height = static_cast<float>(static_cast<int>(glyph.dims.height));
     if (0.0F == width || 0.0F == height) {
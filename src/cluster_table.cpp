@@ -0,0 +1,310 @@
+/**
+ * @file cluster_table.cpp
+ * @brief Encoding a page's clusters as runs, and finding them again.
+ */
+#include <gleditor/cluster_table.hpp> // IWYU pragma: associated
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace gleditor {
+
+namespace {
+
+constexpr std::uint32_t runLimit = std::numeric_limits<std::uint8_t>::max();
+
+std::uint32_t endOf(const ClusterBox &box) {
+  return box.byteStart + box.byteLength;
+}
+
+} // namespace
+
+struct ClusterTable::Encoded {
+  std::vector<Run> runs;
+  std::vector<std::uint32_t> blockStarts;
+  /// Counted from the first of these runs.
+  std::vector<std::uint32_t> blockRuns;
+  std::vector<Loose> loose;
+};
+
+ClusterTable::Encoded
+ClusterTable::encode(const std::size_t firstIndex,
+                     const std::span<const ClusterBox> boxes) {
+  Encoded out;
+  std::uint32_t at = 0;
+  // Runs stop at the end of a block, so that a block can be walked on its own
+  // and encoded again without its neighbours.
+  bool runOpen = false;
+  for (std::size_t i = 0; i < boxes.size(); i++) {
+    const auto &box = boxes[i];
+    if (0 == i % blockClusters) {
+      out.blockStarts.push_back(box.byteStart);
+      out.blockRuns.push_back(static_cast<std::uint32_t>(out.runs.size()));
+      at      = box.byteStart;
+      runOpen = false;
+    }
+    if (box.byteStart != at || box.byteLength >= runLimit ||
+        box.charCount >= runLimit) {
+      out.loose.push_back(
+          {.index      = static_cast<std::uint32_t>(firstIndex + i),
+           .fromBlock  = static_cast<std::int64_t>(box.byteStart) -
+                        static_cast<std::int64_t>(out.blockStarts.back()),
+           .byteLength = box.byteLength,
+           .charCount  = box.charCount});
+      out.runs.push_back({});
+      runOpen = false;
+    } else if (runOpen && out.runs.back().count < runLimit &&
+               out.runs.back().byteLength == box.byteLength &&
+               out.runs.back().charCount == box.charCount) {
+      out.runs.back().count++;
+    } else {
+      out.runs.push_back({1, static_cast<std::uint8_t>(box.byteLength),
+                          static_cast<std::uint8_t>(box.charCount)});
+      runOpen = true;
+    }
+    at = endOf(box);
+  }
+  return out;
+}
+
+ClusterTable::ClusterTable(const std::span<const ClusterBox> boxes)
+    : count(boxes.size()), disorder(disorderOf(boxes)) {
+  auto encoded = encode(0, boxes);
+  runs         = std::move(encoded.runs);
+  blockStarts  = std::move(encoded.blockStarts);
+  blockRuns    = std::move(encoded.blockRuns);
+  loose        = std::move(encoded.loose);
+}
+
+std::pair<std::size_t, std::size_t>
+ClusterTable::runsOf(const std::size_t block) const {
+  return {blockRuns[block],
+          block + 1 < blocks() ? blockRuns[block + 1] : runs.size()};
+}
+
+ClusterBox ClusterTable::operator[](const std::size_t index) const {
+  const auto block = index / blockClusters;
+  auto skip        = index % blockClusters;
+  auto at          = static_cast<std::int64_t>(blockStarts[block]);
+  const auto [first, end] = runsOf(block);
+  auto looseAt            = loose.end();
+  bool looseFound         = false;
+  for (auto r = first; r < end; r++) {
+    const auto &run = runs[r];
+    if (0 == run.count) {
+      // Loose clusters are rare, so finding the first of them in this block
+      // is left until there is one.
+      if (!looseFound) {
+        looseAt    = std::ranges::lower_bound(loose, block * blockClusters, {},
+                                              &Loose::index);
+        looseFound = true;
+      }
+      const auto &held  = *looseAt++;
+      const auto start  = blockStarts[block] + held.fromBlock;
+      const ClusterBox box{static_cast<std::uint32_t>(start), held.byteLength,
+                           held.charCount};
+      if (0 == skip) {
+        return box;
+      }
+      skip--;
+      at = static_cast<std::int64_t>(endOf(box));
+      continue;
+    }
+    if (skip < run.count) {
+      return {static_cast<std::uint32_t>(at + (skip * run.byteLength)),
+              run.byteLength, run.charCount};
+    }
+    skip -= run.count;
+    at += static_cast<std::int64_t>(run.count) * run.byteLength;
+  }
+  return {};
+}
+
+std::vector<ClusterBox> ClusterTable::decode(const std::size_t first,
+                                             const std::size_t end) const {
+  std::vector<ClusterBox> out;
+  if (first >= end) {
+    return out;
+  }
+  out.reserve(std::min(count, end * blockClusters) - (first * blockClusters));
+  auto looseAt = std::ranges::lower_bound(loose, first * blockClusters, {},
+                                          &Loose::index);
+  for (auto block = first; block < end; block++) {
+    std::uint32_t at        = blockStarts[block];
+    const auto [from, upTo] = runsOf(block);
+    for (auto r = from; r < upTo; r++) {
+      const auto &run = runs[r];
+      if (0 == run.count) {
+        const auto &held = *looseAt++;
+        out.push_back({static_cast<std::uint32_t>(blockStarts[block] +
+                                                  held.fromBlock),
+                       held.byteLength, held.charCount});
+        at = endOf(out.back());
+        continue;
+      }
+      for (std::uint32_t k = 0; k < run.count; k++) {
+        out.push_back({at, run.byteLength, run.charCount});
+        at += run.byteLength;
+      }
+    }
+  }
+  return out;
+}
+
+std::vector<ClusterBox> ClusterTable::boxes() const {
+  return decode(0, blocks());
+}
+
+std::size_t
+ClusterTable::disorderOf(const std::span<const ClusterBox> boxes) {
+  std::size_t out = 0;
+  for (std::size_t i = 1; i < boxes.size(); i++) {
+    if (boxes[i].byteStart < endOf(boxes[i - 1]) ||
+        boxes[i].byteStart < boxes[i - 1].byteStart) {
+      out++;
+    }
+  }
+  return out;
+}
+
+std::optional<std::pair<std::size_t, std::size_t>>
+ClusterTable::covering(const std::uint32_t from, const std::uint32_t to) const {
+  if (empty() || to <= from) {
+    return std::nullopt;
+  }
+  const auto holds = [from, to](const ClusterBox &box) {
+    return 0 != box.byteLength && endOf(box) > from && box.byteStart < to;
+  };
+  std::optional<std::size_t> first;
+  std::size_t last = 0;
+  const auto consider = [&](const std::size_t base,
+                            const std::span<const ClusterBox> some) {
+    for (std::size_t i = 0; i < some.size(); i++) {
+      if (holds(some[i])) {
+        first = first.value_or(base + i);
+        last  = base + i;
+      }
+    }
+  };
+  if (0 != disorder) {
+    consider(0, boxes());
+    if (!first) {
+      return std::nullopt;
+    }
+    return std::pair{*first, last};
+  }
+
+  // In order, so the clusters holding the range are one stretch of the table,
+  // which starts in the block holding @p from and ends in the one holding the
+  // byte before @p to. Each end is looked for from there -- forwards for the
+  // first and backwards for the last, past any blocks of nothing but room --
+  // so a selection of the whole page decodes two blocks, not all of them.
+  const auto after = [this](const std::uint32_t offset) {
+    return static_cast<std::size_t>(
+        std::ranges::upper_bound(blockStarts, offset) - blockStarts.begin());
+  };
+  const auto firstBlock = std::max<std::size_t>(after(from), 1) - 1;
+  const auto endBlock   = after(to - 1);
+  for (auto block = firstBlock; block < endBlock && !first; block++) {
+    consider(block * blockClusters, decode(block, block + 1));
+  }
+  if (!first) {
+    return std::nullopt;
+  }
+  const auto found = *first;
+  for (auto block = endBlock; block-- > found / blockClusters;) {
+    first.reset();
+    consider(block * blockClusters, decode(block, block + 1));
+    if (first) {
+      break;
+    }
+  }
+  return std::pair{found, last};
+}
+
+void ClusterTable::replace(const std::size_t first,
+                           const std::span<const ClusterBox> fresh,
+                           const std::int32_t shift) {
+  if (fresh.empty()) {
+    return;
+  }
+  const auto firstBlock = first / blockClusters;
+  const auto endBlock =
+      std::min(blocks(), (first + fresh.size() + blockClusters - 1) /
+                             blockClusters);
+  const auto base = firstBlock * blockClusters;
+  auto window     = decode(firstBlock, endBlock);
+
+  // The pairs at either edge of the window are the only ones whose order can
+  // change: inside the window the clusters are new, and past it every one
+  // moves by the same amount.
+  const auto withEdges = [&](const std::vector<ClusterBox> &inside,
+                             const std::int32_t moved) {
+    std::vector<ClusterBox> edged;
+    if (0 != base) {
+      edged.push_back((*this)[base - 1]);
+    }
+    edged.insert(edged.end(), inside.begin(), inside.end());
+    if (base + inside.size() < count) {
+      auto next = (*this)[base + inside.size()];
+      next.byteStart =
+          static_cast<std::uint32_t>(static_cast<std::int64_t>(next.byteStart) +
+                                     moved);
+      edged.push_back(next);
+    }
+    return disorderOf(edged);
+  };
+  const auto before = withEdges(window, 0);
+
+  std::ranges::copy(fresh, window.begin() +
+                               static_cast<std::ptrdiff_t>(first - base));
+  for (auto i = first - base + fresh.size(); i < window.size(); i++) {
+    window[i].byteStart = static_cast<std::uint32_t>(
+        static_cast<std::int64_t>(window[i].byteStart) + shift);
+  }
+  disorder = disorder - before + withEdges(window, shift);
+
+  auto encoded            = encode(base, window);
+  const auto runsFrom     = blockRuns[firstBlock];
+  const auto runsTo       = endBlock < blocks() ? blockRuns[endBlock]
+                                                : runs.size();
+  const auto runsBefore   = static_cast<std::int64_t>(runsTo - runsFrom);
+  const auto runsAfter    = static_cast<std::int64_t>(encoded.runs.size());
+  runs.erase(runs.begin() + runsFrom, runs.begin() + runsTo);
+  runs.insert(runs.begin() + runsFrom, encoded.runs.begin(),
+              encoded.runs.end());
+  for (auto block = firstBlock; block < endBlock; block++) {
+    blockStarts[block] = encoded.blockStarts[block - firstBlock];
+    blockRuns[block]   = runsFrom + encoded.blockRuns[block - firstBlock];
+  }
+  for (auto block = endBlock; block < blocks(); block++) {
+    blockStarts[block] = static_cast<std::uint32_t>(
+        static_cast<std::int64_t>(blockStarts[block]) + shift);
+    blockRuns[block] = static_cast<std::uint32_t>(
+        static_cast<std::int64_t>(blockRuns[block]) + runsAfter - runsBefore);
+  }
+
+  const auto looseFrom =
+      std::ranges::lower_bound(loose, base, {}, &Loose::index);
+  const auto looseTo = std::ranges::lower_bound(
+      loose, base + window.size(), {}, &Loose::index);
+  const auto at = loose.erase(looseFrom, looseTo);
+  loose.insert(at, encoded.loose.begin(), encoded.loose.end());
+}
+
+std::size_t ClusterTable::memoryBytes() const {
+  return sizeof(*this) + (runs.capacity() * sizeof(Run)) +
+         (blockStarts.capacity() * sizeof(std::uint32_t)) +
+         (blockRuns.capacity() * sizeof(std::uint32_t)) +
+         (loose.capacity() * sizeof(Loose));
+}
+
+} // namespace gleditor
+
+// vi: set sw=2 sts=2 ts=2 et:
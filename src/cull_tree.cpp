@@ -0,0 +1,152 @@
+/**
+ * @file cull_tree.cpp
+ * @brief Building the tree of page boxes, and walking it for a view.
+ */
+#include <gleditor/cull_tree.hpp> // IWYU pragma: associated
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+namespace gleditor {
+
+namespace {
+
+/// How far in front of @p plane the furthest point of a box gets: its centre's
+/// distance plus the most its extents can add in the plane's direction.
+float furthest(const CullPlane &plane, const float centreX,
+               const float centreY, const float halfWidth,
+               const float halfHeight, const float halfDepth) {
+  return (plane.x * centreX) + (plane.y * centreY) + (plane.z * halfDepth) +
+         plane.w + (std::abs(plane.x) * halfWidth) +
+         (std::abs(plane.y) * halfHeight) + (std::abs(plane.z) * halfDepth);
+}
+
+} // namespace
+
+void CullTree::rebuild(const std::span<const CullBox> boxes,
+                       const float depth) {
+  count          = boxes.size();
+  reach          = depth;
+  const auto all = (count + leafSize - 1) / leafSize;
+  centreX.assign(all * leafSize, 0.0F);
+  centreY.assign(all * leafSize, 0.0F);
+  halfWidth.assign(all * leafSize, 0.0F);
+  halfHeight.assign(all * leafSize, 0.0F);
+  for (std::size_t i = 0; i < count; i++) {
+    centreX[i]    = boxes[i].centreX;
+    centreY[i]    = boxes[i].centreY;
+    halfWidth[i]  = boxes[i].halfWidth;
+    halfHeight[i] = boxes[i].halfHeight;
+  }
+  nodes.clear();
+  if (0 != all) {
+    nodes.reserve((2 * all) - 1);
+    build(0, static_cast<std::uint32_t>(all));
+  }
+}
+
+void CullTree::build(const std::uint32_t first, const std::uint32_t leaves) {
+  const auto at = nodes.size();
+  nodes.emplace_back();
+  auto minX = std::numeric_limits<float>::infinity();
+  auto minY = minX;
+  auto maxX = -minX;
+  auto maxY = -minX;
+  const auto take = [&](const float cx, const float cy, const float hw,
+                        const float hh) {
+    minX = std::min(minX, cx - hw);
+    minY = std::min(minY, cy - hh);
+    maxX = std::max(maxX, cx + hw);
+    maxY = std::max(maxY, cy + hh);
+  };
+  if (1 == leaves) {
+    const auto base = std::size_t{first} * leafSize;
+    for (auto i = base; i < std::min(base + leafSize, count); i++) {
+      take(centreX[i], centreY[i], halfWidth[i], halfHeight[i]);
+    }
+  } else {
+    const auto half = leaves / 2;
+    for (const auto [from, span] :
+         {std::array{first, half}, std::array{first + half, leaves - half}}) {
+      const auto child = nodes.size();
+      build(from, span);
+      const auto &made = nodes[child];
+      take(made.centreX, made.centreY, made.halfWidth, made.halfHeight);
+    }
+  }
+  nodes[at] = Node{.centreX    = (minX + maxX) / 2.0F,
+                   .centreY    = (minY + maxY) / 2.0F,
+                   .halfWidth  = (maxX - minX) / 2.0F,
+                   .halfHeight = (maxY - minY) / 2.0F,
+                   .firstLeaf  = first,
+                   .leaves     = leaves,
+                   .skip       = static_cast<std::uint32_t>(nodes.size())};
+}
+
+std::uint32_t CullTree::query(const CullFrustum &frustum, const float grow,
+                              std::vector<CullHit> &hits) const {
+  const auto scale     = std::max(grow, 1.0F);
+  const auto halfDepth = reach / 2.0F;
+  std::uint32_t tested = 0;
+  for (std::size_t at = 0; at < nodes.size();) {
+    const auto &node = nodes[at];
+    tested++;
+    // Grown about its own centre, a node still holds its boxes grown about
+    // theirs: none is further from the node's edge than its own half extent.
+    const bool away = std::ranges::any_of(frustum, [&](const auto &plane) {
+      return furthest(plane, node.centreX, node.centreY,
+                      scale * node.halfWidth, scale * node.halfHeight,
+                      halfDepth) < 0.0F;
+    });
+    if (away) {
+      at = node.skip;
+      continue;
+    }
+    at++;
+    if (1 != node.leaves) {
+      continue;
+    }
+
+    // The nearest each box gets to being in front of every plane: behind any
+    // one of them is out. Columns in, columns out, one plane at a time.
+    std::array<float, leafSize> exact{};
+    std::array<float, leafSize> grown{};
+    exact.fill(std::numeric_limits<float>::infinity());
+    grown.fill(std::numeric_limits<float>::infinity());
+    const auto base = std::size_t{node.firstLeaf} * leafSize;
+    const auto *const cx = centreX.data() + base;
+    const auto *const cy = centreY.data() + base;
+    const auto *const hw = halfWidth.data() + base;
+    const auto *const hh = halfHeight.data() + base;
+    for (const auto &plane : frustum) {
+      const auto ax    = std::abs(plane.x);
+      const auto ay    = std::abs(plane.y);
+      const auto front = (plane.z * halfDepth) + plane.w +
+                         (std::abs(plane.z) * halfDepth);
+      for (std::size_t lane = 0; lane < leafSize; lane++) {
+        const auto centre = (plane.x * cx[lane]) + (plane.y * cy[lane]) + front;
+        const auto across = (ax * hw[lane]) + (ay * hh[lane]);
+        exact[lane]       = std::min(exact[lane], centre + across);
+        grown[lane]       = std::min(grown[lane], centre + (scale * across));
+      }
+    }
+    for (std::size_t lane = 0; lane < std::min(leafSize, count - base);
+         lane++) {
+      if (grown[lane] >= 0.0F) {
+        hits.push_back(CullHit{static_cast<std::uint32_t>(base + lane),
+                               exact[lane] >= 0.0F});
+      }
+    }
+  }
+  return tested;
+}
+
+} // namespace gleditor
+
+// vi: set sw=2 sts=2 ts=2 et:
@@ -1,37 +1,57 @@
 #include <algorithm>                      // for min, max
+#include <array>                          // for array
+#include <atomic>                         // for atomic
+#include <cairomm/context.h>              // for Context
+#include <cairomm/matrix.h>               // for Matrix
+#include <cairomm/surface.h>              // for ImageSurface
+#include <chrono>                         // for steady_clock
 #include <cmath>                          // for ceil, lround
-#include <cstddef>                        // for byte
+#include <cstddef>                        // for byte, offsetof
 #include <cstdint>                        // for uint32_t
+#include <cstring>                        // for memcpy
+#include <filesystem>                     // for path
 #include <format>                         // for format
 #include <gleditor/animation.hpp>         // for docArrival, docArrivalDepth
+#include <gleditor/cull_tree.hpp>         // for CullTree, CullBox, CullHit
 #include <gleditor/doc.hpp>               // IWYU pragma: associated
 #include <gleditor/document_observer.hpp> // for DocumentObserver
+#include <gleditor/load_queue.hpp>        // for LoadQueue
+#include <gleditor/page_cache.hpp>        // for PageCacheWriter, PageCache...
+#include <gleditor/page_impostors.hpp>    // for PageImpostors, ImpostorWant
+#include <gleditor/page_paragraphs.hpp>   // for PageParagraph, relayClusters
+#include <gleditor/paginator.hpp>         // for paginate
 #include <gleditor/render/device.hpp>     // for RenderDevice
+#include <gleditor/render/worker_pool.hpp> // for WorkerPool
 #include <gleditor/render_state.hpp>      // for RenderState
 #include <gleditor/renderer.hpp>          // for Renderer, RendererRef
 #include <gleditor/text_source.hpp>       // for TextSource
-#include <gleditor/utf8.hpp>              // for alignToCharacterStart
+#include <gleditor/utf8.hpp>              // for scanUtf8, alignToChar...
 #include <glm/detail/qualifier.hpp>       // for qualifier
 #include <glm/ext/matrix_float4x4.hpp>    // for mat4
 #include <glm/ext/vector_float3.hpp>      // for vec3
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream> // for basic_ostream, operator<<
+#include <iterator> // for make_move_iterator
 #include <limits>
 #include <memory>                 // for __shared_ptr_access, shared...
+#include <mutex>                  // for lock_guard
 #include <pangomm/cairofontmap.h> // for CairoFontMap
 #include <span>                   // for span
 #include <stdexcept>              // for logic_error
 #include <string>                 // for char_traits, basic_string
 #include <string_view>            // for string_view
+#include <thread>                 // for hardware_concurrency
 #include <utility>                // for move
 #include <vector>                 // for vector
 
+#include "glib.h"                        // for g_mapped_file_new
 #include "glibmm/convert.h"              // for get_charset
 #include "glibmm/fileutils.h"            // for file_get_contents
 #include "glibmm/refptr.h"               // for RefPtr
 #include "glibmm/ustring.h"              // for ustring, operator==, UStrin...
 #include "pango/pango-layout.h"          // for pango_layout_set_text
 #include "pango/pango-types.h"           // for PANGO_SCALE
+#include "pango/pango-utils.h"           // for pango_version_string
 #include "pangomm/attributes.h"          // for AttrFontDesc, Attribute
 #include "pangomm/attrlist.h"            // for AttrList
 #include "pangomm/fontdescription.h"     // for FontDescription
@@ -42,6 +62,8 @@
 #include <gleditor/caret.hpp>            // for Caret
 #include <gleditor/drawable.hpp>         // for Drawable
 #include <gleditor/glyphcache/cache.hpp> // for GlyphCache
+#include <gleditor/glyphcache/citation.hpp> // for GlyphCitation
+#include <gleditor/glyphcache/raster.hpp> // for appendShapedKey, ShapedGlyph
 #include <gleditor/glyphcache/types.hpp> // for TextureCoords, PointF, Rect
 #include <glm/gtx/string_cast.hpp>
 
@@ -62,16 +84,17 @@ constexpr std::uint32_t initialPoolRows = 4096;
  * One quad per cluster, and a cluster is a character except where several
  * combine into one -- so the character count is an over-estimate of the glyphs
  * and the pages add a background and a bar per line on top. An eighth covers
- * the bars and the room the pool leaves around each page to grow into, and
- * being a little over is the point: the buffer is allocated once at this size
- * instead of being grown through every size on the way there, and whatever is
- * left over is given back by a trim when the document has finished loading.
+ * the bars and the room the pool leaves around each page to grow into, another
+ * the spare rows each page keeps for its paragraphs to grow into, and being a
+ * little over is the point: the buffer is allocated once at this size instead
+ * of being grown through every size on the way there, and whatever is left
+ * over is given back by a trim when the document has finished loading.
  *
  * Characters rather than bytes, so that text outside ASCII is not over-counted
  * threefold.
  */
 std::uint32_t rowsFor(const std::size_t characters) {
-  const auto estimate = characters + (characters / 8) + initialPoolRows;
+  const auto estimate = characters + (characters / 4) + initialPoolRows;
   return static_cast<std::uint32_t>(std::min<std::size_t>(
       estimate, std::numeric_limits<std::uint32_t>::max()));
 }
@@ -79,6 +102,51 @@ std::uint32_t rowsFor(const std::size_t characters) {
 /// Margin in layout pixels between the page edge and its text.
 constexpr float pageMargin = 24.0F;
 
+/// Where the names a page gives what it shows come from. One count for every
+/// document, since the pictures of all of them share one atlas.
+std::atomic<std::uint64_t> contentKeys{1};
+
+/// A page's text area in Pango units: the proportions of US Letter, at the
+/// scale pages are laid out at.
+const int pageWidthUnits =
+    static_cast<int>(std::ceil(139.70 * 8.5 * PANGO_SCALE));
+const int pageHeightUnits =
+    static_cast<int>(std::ceil(139.70 * 11 * PANGO_SCALE));
+
+/**
+ * @brief Text wrapped at a time when finding where lines start.
+ *
+ * Pango keeps the glyphs of everything a layout has wrapped until the layout
+ * goes, so wrapping a whole stretch of a document in one layout costs memory
+ * in proportion to it. A slice this size is a dozen pages; it is extended to
+ * the next paragraph, since lines only restart there.
+ */
+constexpr std::uint32_t wrapSliceBytes = 64 * 1024;
+
+/**
+ * @brief How many of @p lines Pango fits on a page before the one it cuts.
+ *
+ * Pango picks a height-bounded layout's last line as it goes: a line is the
+ * last when two more the height of the line before it would not fit in what
+ * is left. That line takes the ellipsis, and consumedBytes() hands it to the
+ * next page, so a page holds the lines before it -- or that line alone, when
+ * it is the first. The parallel paginator's guess, which laying the page out
+ * then confirms or not.
+ */
+std::size_t
+linesBeforeCut(const std::span<const gleditor::PaginationLine> lines) {
+  auto remaining = pageHeightUnits;
+  auto previous  = lines.empty() ? 0 : lines.front().height;
+  for (std::size_t i = 0; i < lines.size(); i++) {
+    if (2 * previous > remaining) {
+      return std::max<std::size_t>(i, 1);
+    }
+    remaining -= lines[i].height;
+    previous = lines[i].height;
+  }
+  return lines.size();
+}
+
 /// How far in front of the page background its glyphs and bars sit, in the
 /// same layout-pixel space. Small enough to be a depth tie-break rather than a
 /// visible offset, and part of the box the frustum test uses. A quad carries
@@ -102,29 +170,64 @@ unsigned char greekedShade(const float coverage) {
   return static_cast<unsigned char>(std::lround(255.0F * (1.0F - inked)));
 }
 
+/**
+ * @brief Where page @p index of a document sits within it.
+ *
+ * Pages are laid out in pixels and scaled here, so the stacking distance is in
+ * world units while everything inside the page is not.
+ */
+glm::mat4 pagePlacement(const std::size_t index) {
+  const auto trans =
+      glm::translate(glm::mat4(1.0),
+                     glm::vec3(0.0F, -100 * static_cast<float>(index), 0.0F));
+  return glm::scale(trans,
+                    glm::vec3(Doc::pixelsToWorld, Doc::pixelsToWorld, 1.0F));
+}
+
 /// Convert Pango units to pixels.
 double toPixels(const int pangoUnits) {
   return static_cast<double>(pangoUnits) / PANGO_SCALE;
 }
 
-/// Byte offset of the character after the one starting at @p pos. Always
-/// advances, so a caller stepping through text cannot get stuck on a malformed
-/// byte.
-std::size_t nextCharacter(const std::string &text, std::size_t pos) {
-  pos = std::min(pos + 1, text.size());
-  while (pos < text.size() &&
-         0x80 == (static_cast<unsigned char>(text[pos]) & 0xC0)) {
-    pos++;
-  }
-  return pos;
+/// Paper behind a page that has not been built: a shade off white, so that a
+/// page still loading does not pass for an empty one.
+constexpr unsigned char placeholderShade = 235;
+
+/// A placeholder is drawn at the size of a full page, which is what nearly
+/// every page it stands in for turns out to be.
+float placeholderWidth() {
+  return static_cast<float>(toPixels(pageWidthUnits)) + (2 * pageMargin);
 }
+float placeholderHeight() {
+  return static_cast<float>(toPixels(pageHeightUnits)) + (2 * pageMargin);
+}
+
+/**
+ * @brief Pages a loader builds as soon as they are paginated when they are
+ *        this close to one in view.
+ *
+ * Those in view, and the next and previous couple, which is where a reader
+ * looking at them goes next. Further out waits for pagination to finish.
+ */
+constexpr std::uint32_t buildReach = 2;
 
-/// Number of characters in a UTF-8 range, counting lead bytes.
-std::size_t utf8Length(const std::string_view text) {
-  return static_cast<std::size_t>(
-      std::ranges::count_if(text, [](const char chr) {
-        return 0x80 != (static_cast<unsigned char>(chr) & 0xC0);
-      }));
+/**
+ * @brief How much larger than a page the box is that says it is near the view.
+ *
+ * A page within a page's width or height of the view is stamped as seen, so
+ * that it keeps its rows, and is built again if it has given them back: by the
+ * time the camera has brought it into view its rows are usually there.
+ */
+constexpr float nearViewScale = 3.0F;
+
+/// The box of a page @p width by @p height layout pixels, placed by @p placed
+/// in its document.
+gleditor::CullBox cullBoxOf(const glm::mat4 &placed, const float width,
+                            const float height) {
+  return gleditor::CullBox{.centreX    = placed[3].x,
+                           .centreY    = placed[3].y,
+                           .halfWidth  = width * placed[0].x / 2.0F,
+                           .halfHeight = height * placed[1].y / 2.0F};
 }
 
 /// View a row vector as the raw bytes the buffer pool wants.
@@ -175,95 +278,161 @@ render::VertexLayout Doc::vertexLayout() {
   return layout;
 }
 
-// The constructor parameters are named with a leading `a` so that the body can
-// refer to the members without ambiguity: the members are move-constructed from
-// the parameters, which leaves the parameters empty.
-Page::Page(std::shared_ptr<Doc> aDoc, RenderState &state, glm::mat4 &model,
-           Glib::RefPtr<Pango::Layout> aLayout, const std::uint32_t aTextOffset,
-           const std::uint32_t aPageIndex,
-           const BufferPool::Allocation &inherited)
-    : Drawable(model), doc(std::move(aDoc)), pageBacking(inherited),
-      layout(std::move(aLayout)), textOffset(aTextOffset),
-      pageIndex(aPageIndex) {
-  const auto &layout = this->layout;
+namespace {
 
-  const auto color = Doc::VBORow::color;
-  const auto box   = Doc::VBORow::box;
+/// Where the rows of a run of text go on its page: the page's origin, and how
+/// far below the top of the page's text the run starts.
+struct RowPlacement {
+  float originX{};
+  float originY{};
+  /// Pango units. Nothing for a whole page; a paragraph's top for one laid
+  /// out on its own.
+  int top{};
+};
+
+// Sizes are clamped rather than asserted. They come from whatever font the
+// caller asked for, and a glyph too large to describe is a visual mistake where
+// a failed assertion is a crash.
+unsigned int quadExtent(const float value) {
+  return static_cast<unsigned int>(std::clamp(
+      value, 0.0F, static_cast<float>(Doc::VBORow::maxQuadExtent)));
+}
 
-  // Everything below is in layout pixels, the unit Pango reports positions and
-  // sizes in. The page's model matrix scales them to world units, so a glyph's
-  // quad and the advance that places it shrink together -- they did not before,
-  // and the mismatch drew every glyph on top of its neighbours.
-  int textWidthPx  = 0;
-  int textHeightPx = 0;
-  layout->get_pixel_size(textWidthPx, textHeightPx);
-  pageWidth  = static_cast<float>(textWidthPx) + (2 * pageMargin);
-  pageHeight = static_cast<float>(textHeightPx) + (2 * pageMargin);
+/**
+ * @brief The glyphs Pango shaped each cluster of a layout into, followed along
+ *        a LayoutIter.
+ *
+ * A run's glyphs are in the order the iterator visits its clusters, each
+ * cluster's together, so the cluster the iterator is on starts where the one
+ * before it ended and only a new run starts again from its first glyph.
+ */
+class ShapedClusters {
+public:
+  struct Cluster {
+    /// Null past the end of a line, where there is no run.
+    const PangoLayoutRun *run{};
+    int first{};
+    int last{};
+  };
 
-  // The page is centred on its own origin, so that the model matrix placing it
-  // in the scene positions its middle rather than its top left corner. Kept as
-  // members so caret geometry lands in the same space as the glyphs.
-  originX = -pageWidth / 2.0F;
-  originY = pageHeight / 2.0F;
+  /// The glyphs of the cluster @p iter is on, which must be the one after the
+  /// last asked about.
+  Cluster next(Pango::LayoutIter &iter) {
+    const auto *const run = pango_layout_iter_get_run_readonly(iter.gobj());
+    if (run != current) {
+      current = run;
+      glyph   = 0;
+    }
+    if (nullptr == run) {
+      return {};
+    }
+    const auto *const glyphs = run->glyphs;
+    const auto first         = glyph;
+    while (glyph < glyphs->num_glyphs &&
+           glyphs->log_clusters[glyph] == glyphs->log_clusters[first]) {
+      glyph++;
+    }
+    return {run, first, glyph};
+  }
 
-  // Which document and page these quads belong to is the same for every one of
-  // them, so it is not written into any of them: the draw carries it, and a
-  // quad carries only the kind, which does vary -- the background and the bars
-  // are the page itself, where a glyph is a character within it.
-  identity = render::packTagIdentity(0, this->doc->documentIndex(), aPageIndex);
+private:
+  const PangoLayoutRun *current{};
+  int glyph{};
+};
 
-  // The allocation holds two draws back to back: the full-detail one -- page
-  // background followed by a glyph per cluster -- and then the coarse one,
-  // which repeats the background and follows it with a solid bar per line.
-  // Repeating the background costs one row and is what lets either draw be
-  // aimed at with a byte offset and a count, with no second allocation and no
-  // stitching of two ranges.
-  std::vector<Doc::VBORow> vertexData;
-  const auto pushBackground = [&] {
-    vertexData.push_back(Doc::VBORow{
-        {0.0F, 0.0F},
-        Doc::VBORow::fill(color(255), Doc::VBORow::onPaper),
-        0,
-        box(0,
-            std::min(Doc::VBORow::maxQuadExtent,
-                     static_cast<unsigned int>(pageWidth)),
-            std::min(Doc::VBORow::maxQuadExtent,
-                     static_cast<unsigned int>(pageHeight)),
-            render::tagKindPage),
-        // A click on bare paper resolves to the start of the page, which is
-        // what a page-kind tag with no cluster already means.
-        Doc::VBORow::paperAt(color(255), 0)});
-  };
-  pushBackground();
+/**
+ * @brief Append to @p key the shaped key drawing @p cluster, which starts at
+ *        byte @p start and has @p logical for its box and @p baseline for its
+ *        baseline.
+ * @return false, with nothing appended, for a cluster that has to be drawn
+ *         from its text: one with no run, more glyphs than a key holds, or a
+ *         glyph the font does not have -- Pango draws those as a box with the
+ *         character's code in it, which only laying the text out reproduces.
+ */
+bool appendShapedCluster(std::string &key,
+                         const ShapedClusters::Cluster &cluster,
+                         const std::size_t start,
+                         const Pango::Rectangle &logical, const int baseline) {
+  if (nullptr == cluster.run || cluster.first == cluster.last) {
+    return false;
+  }
+  const auto *const item   = cluster.run->item;
+  const auto *const glyphs = cluster.run->glyphs;
+  if (std::cmp_not_equal(item->offset +
+                             glyphs->log_clusters[cluster.first],
+                         start)) {
+    return false;
+  }
+  std::array<ShapedGlyph, maxShapedGlyphs> shaped{};
+  std::size_t count = 0;
+  int x             = 0;
+  for (int i = cluster.first; i < cluster.last; i++) {
+    const auto &info = glyphs->glyphs[i];
+    if (0 != (info.glyph & PANGO_GLYPH_UNKNOWN_FLAG)) {
+      return false;
+    }
+    // An empty glyph takes room and draws nothing, as a zero-width joiner.
+    if (PANGO_GLYPH_EMPTY != info.glyph) {
+      if (count == shaped.size()) {
+        return false;
+      }
+      shaped[count++] = ShapedGlyph{info.glyph, x + info.geometry.x_offset,
+                                    info.geometry.y_offset};
+    }
+    x += info.geometry.width;
+  }
+  return appendShapedKey(key, PANGO_PIXELS_CEIL(logical.get_width()),
+                         PANGO_PIXELS_CEIL(logical.get_height()),
+                         baseline - logical.get_y(),
+                         std::span(shaped.data(), count));
+}
+
+/**
+ * @brief Walk @p layout's clusters short of @p limit into glyph rows and
+ *        cluster boxes.
+ *
+ * The part of building a page that shaping a paragraph again repeats, so the
+ * two cannot come out different.
+ *
+ * A cluster's glyph is asked for by the glyphs Pango shaped it into here, in
+ * the font of the run it is in, so that drawing a miss is not shaping it a
+ * second time. A cluster those cannot describe is asked for by its text, in
+ * the layout's font.
+ *
+ * @param citing Cites every glyph reserved, for the page holding the rows.
+ * @param firstCluster Index in its page's table that the first cluster pushed
+ *        onto @p clusters will have; a glyph names its cluster by that index.
+ * @param glyphOfRow The glyph number of each row of @p rows, or
+ *        GlyphCache::noGlyph for a row that is not a glyph's, up to the last
+ *        glyph row pushed.
+ * @param atCluster Told where each cluster starts before it is recorded.
+ * @param lineInk Glyph box area per line of @p layout, added to.
+ * @param glyphKeys If given, what each glyph row was reserved under, for the
+ *        page cache: a byte counting the fonts, each font's description after
+ *        a byte of its length, then for each row a byte naming its font, a
+ *        byte of its key's length and the key. Left empty should there be
+ *        more fonts, or longer descriptions, than a byte can count.
+ * @return Where the walk stopped: @p limit, or short of it when the page ran
+ *         out of cluster indices.
+ */
+template <typename AtCluster>
+std::size_t walkClusters(const Glib::RefPtr<Pango::Layout> &layout,
+                         GlyphCache &glyphs, GlyphCitation *const citing,
+                         const RowPlacement &placed, std::size_t limit,
+                         const std::uint32_t firstCluster,
+                         std::vector<Doc::VBORow> &rows,
+                         std::vector<std::uint32_t> &glyphOfRow,
+                         std::vector<ClusterBox> &clusters,
+                         std::vector<float> &lineInk,
+                         const AtCluster &atCluster,
+                         std::string *const glyphKeys = nullptr) {
+  const auto color = Doc::VBORow::color;
+  const auto box   = Doc::VBORow::box;
 
   const auto text = layout->get_text().raw();
   const auto font =
       layout->get_context()->load_font(layout->get_font_description());
 
-  // A page layout is handed the whole rest of the document and limited by
-  // height, so its text runs far past what the page shows. Everything below is
-  // bounded by what the page actually consumes -- without which the final
-  // cluster's end ran to the end of the document, producing a "cluster" of
-  // tens of kilobytes.
-  // Not const: a page that would hold more clusters than one can name gives
-  // the rest back to the next page, which is what keeps every cluster on this
-  // one pickable.
-  auto limit = std::min<std::size_t>(text.size(), Doc::consumedBytes(layout));
-
-  // Sizes are clamped rather than asserted. They come from whatever font the
-  // caller asked for, and a glyph too large to describe is a visual mistake
-  // where a failed assertion is a crash.
-  const auto extent = [](const float value) {
-    return static_cast<unsigned int>(std::clamp(
-        value, 0.0F, static_cast<float>(Doc::VBORow::maxQuadExtent)));
-  };
-
-  // Glyph box area per line, accumulated as the clusters are placed. This is
-  // what tells the coarse path how full each line is, so that its bar is as
-  // dark as the glyphs it stands in for without anything having to be assumed
-  // about the text.
-  std::vector<float> lineInk(
-      static_cast<std::size_t>(std::max(0, layout->get_line_count())), 0.0F);
   std::size_t lineOfCluster = 0;
   // Byte at which the next line begins, so the running cluster offset can be
   // attributed to a line without searching. Clusters arrive in text order.
@@ -276,6 +445,36 @@ Page::Page(std::shared_ptr<Doc> aDoc, RenderState &state, glm::mat4 &model,
                            ? lineStartAt(1)
                            : std::numeric_limits<std::size_t>::max();
 
+  // The keys wanted in each font, end to end, and where each one is. A page
+  // is in one font and whatever its text falls back to, so a handful at most.
+  struct Batch {
+    FontPtr font;
+    std::string keys;
+    std::vector<std::pair<std::size_t, std::size_t>> spans;
+  };
+  std::vector<Batch> batches;
+  const auto batchFor = [&batches](PangoFont *const wanted) -> std::size_t {
+    for (std::size_t i = 0; i < batches.size(); i++) {
+      if (batches[i].font->gobj() == wanted) {
+        return i;
+      }
+    }
+    batches.push_back(Batch{Glib::wrap(wanted, true), {}, {}});
+    return batches.size() - 1;
+  };
+  // A cluster to draw, kept until the whole walk's glyphs are reserved at once
+  // so that the ones not yet cached are drawn together.
+  struct Drawn {
+    std::size_t batch{};
+    std::size_t slot{};
+    float left{};
+    float top{};
+    std::size_t line{};
+    std::uint32_t cluster{};
+  };
+  std::vector<Drawn> drawn;
+  ShapedClusters shaped;
+
   // Walk the clusters. A cluster is the smallest run Pango will not break
   // apart, so it is what one quad can represent: an "ffi" ligature or a letter
   // with its combining marks is one cluster covering several characters.
@@ -284,6 +483,8 @@ Page::Page(std::shared_ptr<Doc> aDoc, RenderState &state, glm::mat4 &model,
     Pango::Rectangle clusterInk;
     Pango::Rectangle clusterLogical;
     iter.get_cluster_extents(clusterInk, clusterLogical);
+    const auto baseline = iter.get_baseline();
+    const auto glyphRun = shaped.next(iter);
 
     const auto start = static_cast<std::size_t>(std::max(0, iter.get_index()));
     const bool more  = iter.next_cluster();
@@ -297,7 +498,7 @@ Page::Page(std::shared_ptr<Doc> aDoc, RenderState &state, glm::mat4 &model,
     // from what was actually consumed.
     const auto end = std::min(
         limit, more ? static_cast<std::size_t>(std::max(0, iter.get_index()))
-                    : nextCharacter(text, start));
+                    : gleditor::nextCharacter(text, start));
 
     if (start >= limit) {
       break;
@@ -318,11 +519,12 @@ Page::Page(std::shared_ptr<Doc> aDoc, RenderState &state, glm::mat4 &model,
       drawEnd--;
     }
 
+    atCluster(start);
     // A quad names its cluster in sixteen bits, so a page holds that many and
     // no more. Reached only at font sizes small enough that a page carries
     // fourteen times what a real one does; the page simply ends here and the
     // next one starts where it left off.
-    if (clusters.size() >= Doc::VBORow::maxClustersPerPage) {
+    if (firstCluster + clusters.size() >= Doc::VBORow::maxClustersPerPage) {
       limit = start;
       break;
     }
@@ -330,7 +532,7 @@ Page::Page(std::shared_ptr<Doc> aDoc, RenderState &state, glm::mat4 &model,
     clusters.push_back(
         ClusterBox{static_cast<std::uint32_t>(start),
                    static_cast<std::uint32_t>(end - start),
-                   static_cast<std::uint32_t>(utf8Length(
+                   static_cast<std::uint32_t>(gleditor::countCharacters(
                        std::string_view(text).substr(start, end - start)))});
 
     if (drawEnd == start) {
@@ -351,15 +553,6 @@ Page::Page(std::shared_ptr<Doc> aDoc, RenderState &state, glm::mat4 &model,
       }
       continue;
     }
-    const std::string_view chr(text.data() + start, drawEnd - start);
-    const auto glyph    = state.glyphCache.put(chr, font);
-    const auto &coords  = glyph.texCoords;
-    const auto &extents = glyph.dims;
-
-    const auto glyphWidth = static_cast<float>(static_cast<int>(extents.width));
-    const auto glyphHeight =
-        static_cast<float>(static_cast<int>(extents.height));
-
     while (start >= nextLineStart && lineOfCluster + 1 < lineInk.size()) {
       lineOfCluster++;
       nextLineStart = lineOfCluster + 1 < lineInk.size()
@@ -367,102 +560,395 @@ Page::Page(std::shared_ptr<Doc> aDoc, RenderState &state, glm::mat4 &model,
                           : std::numeric_limits<std::size_t>::max();
     }
 
+    // The glyphs as shaped, in their run's font; failing that the text, in
+    // the layout's, where laying it out finds any fallback face again.
+    auto owner = batchFor(nullptr != glyphRun.run
+                              ? glyphRun.run->item->analysis.font
+                              : font->gobj());
+    auto from  = batches[owner].keys.size();
+    if (!appendShapedCluster(batches[owner].keys, glyphRun, start,
+                             clusterLogical, baseline)) {
+      owner = batchFor(font->gobj());
+      from  = batches[owner].keys.size();
+      batches[owner].keys.append(text, start, drawEnd - start);
+    }
+    auto &batch = batches[owner];
+    batch.spans.emplace_back(from, batch.keys.size() - from);
+
+    // Pango measures from the top left of the text block downwards; the page
+    // runs upwards from its own origin, hence the negated Y below.
+    drawn.push_back(Drawn{
+        owner, batch.spans.size() - 1,
+        pageMargin + static_cast<float>(toPixels(clusterLogical.get_x())),
+        pageMargin +
+            static_cast<float>(toPixels(placed.top + clusterLogical.get_y())),
+        lineOfCluster,
+        static_cast<std::uint32_t>(firstCluster + clusters.size() - 1)});
+
+    if (!more) {
+      break;
+    }
+  }
+
+  std::vector<std::vector<GlyphCache::Sizes>> reserved;
+  std::vector<std::vector<std::string_view>> keysOf(batches.size());
+  for (std::size_t i = 0; i < batches.size(); i++) {
+    for (const auto &[from, bytes] : batches[i].spans) {
+      keysOf[i].emplace_back(batches[i].keys.data() + from, bytes);
+    }
+    reserved.push_back(
+        glyphs.reserveAll(keysOf[i], batches[i].font, citing));
+  }
+
+  constexpr std::size_t byteCount = 255;
+  bool recording = nullptr != glyphKeys && batches.size() <= byteCount;
+  if (recording) {
+    glyphKeys->push_back(static_cast<char>(batches.size()));
+    for (const auto &batch : batches) {
+      const auto name = batch.font->describe_with_absolute_size().to_string();
+      if (name.bytes() > byteCount) {
+        glyphKeys->clear();
+        recording = false;
+        break;
+      }
+      glyphKeys->push_back(static_cast<char>(name.bytes()));
+      glyphKeys->append(name.raw());
+    }
+  }
+
+  for (const auto &at : drawn) {
+    const auto &glyph   = reserved[at.batch][at.slot];
+    const auto &coords  = glyph.texCoords;
+    const auto &extents = glyph.dims;
+
+    const auto glyphWidth = static_cast<float>(static_cast<int>(extents.width));
+    const auto glyphHeight =
+        static_cast<float>(static_cast<int>(extents.height));
+
     if (0.0F < glyphWidth && 0.0F < glyphHeight) {
-      if (lineOfCluster < lineInk.size()) {
-        lineInk[lineOfCluster] += glyphWidth * glyphHeight * glyph.ink;
+      if (at.line < lineInk.size()) {
+        lineInk[at.line] += glyphWidth * glyphHeight * glyph.ink;
       }
-      // Pango measures from the top left of the text block downwards; the page
-      // runs upwards from its own origin, hence the negated Y.
-      const auto left =
-          pageMargin + static_cast<float>(toPixels(clusterLogical.get_x()));
-      const auto top =
-          pageMargin + static_cast<float>(toPixels(clusterLogical.get_y()));
-
-      vertexData.push_back(Doc::VBORow{
-          {originX + left + (glyphWidth / 2.0F),
-           originY - (top + (glyphHeight / 2.0F))},
+      glyphOfRow.resize(rows.size(), GlyphCache::noGlyph);
+      glyphOfRow.push_back(glyph.glyph);
+      rows.push_back(Doc::VBORow{
+          {placed.originX + at.left + (glyphWidth / 2.0F),
+           placed.originY - (at.top + (glyphHeight / 2.0F))},
           Doc::VBORow::ink(color(0), Doc::VBORow::onText, false),
           // Where the glyph sits in the atlas. How large it is there is not
           // written down: the atlas holds it at its own size, so the box below
           // is the same rectangle in texels as it is in layout pixels.
           Doc::VBORow::atlasAt(static_cast<unsigned int>(coords.topLeft.x),
                                static_cast<unsigned int>(coords.topLeft.y)),
-          box(static_cast<unsigned char>(glyph.layer), extent(glyphWidth),
-              extent(glyphHeight), render::tagKindGlyph),
+          box(static_cast<unsigned char>(glyph.layer), quadExtent(glyphWidth),
+              quadExtent(glyphHeight), render::tagKindGlyph),
           // The cluster index into this page's cluster table, which is what
           // turns a picked fragment back into a text position; the draw says
           // which document and page that table belongs to.
-          Doc::VBORow::paperAt(
-              color(255), static_cast<unsigned int>(clusters.size() - 1))});
+          Doc::VBORow::paperAt(color(255), at.cluster)});
+      if (recording) {
+        const auto key = keysOf[at.batch][at.slot];
+        glyphKeys->push_back(static_cast<char>(at.batch));
+        glyphKeys->push_back(static_cast<char>(key.size()));
+        glyphKeys->append(key);
+      }
     }
+  }
+  return limit;
+}
 
-    if (!more) {
+/**
+ * @brief A bar for each line of @p layout starting short of @p limit, onto
+ *        @p rows.
+ *
+ * One quad per line, covering the line's ink box -- the box the glyphs
+ * actually mark, not the logical box, which runs to the wrapping width whether
+ * or not there is text out there. At the size this is used at a line is a few
+ * pixels tall and its glyphs are indistinguishable anyway, so what matters is
+ * that the bar sits where the text sits and is about as dark.
+ *
+ * A blank line gets an empty row rather than none, so that line @em n's bar is
+ * always the @em n th and a paragraph laid out again knows where its own are.
+ *
+ * @return How many of the bars have anything to draw.
+ */
+std::size_t pushLineBars(const Glib::RefPtr<Pango::Layout> &layout,
+                         const RowPlacement &placed, const std::size_t limit,
+                         const std::vector<float> &lineInk,
+                         std::vector<Doc::VBORow> &rows) {
+  const auto color      = Doc::VBORow::color;
+  std::size_t drawn     = 0;
+  auto lineIter         = layout->get_iter();
+  std::size_t lineIndex = 0;
+  do {
+    const auto &line = layout->get_const_line(static_cast<int>(lineIndex));
+    // Lines past what this page consumes belong to the next page; the layout
+    // is handed the rest of the document and bounded by height, so it has
+    // them and the page must not draw them.
+    if (!line || static_cast<std::size_t>(line->get_start_index()) >= limit) {
       break;
     }
-  }
+    const auto inkArea = lineIndex < lineInk.size() ? lineInk[lineIndex] : 0.0F;
+    lineIndex++;
+
+    Pango::Rectangle ink;
+    Pango::Rectangle logical;
+    lineIter.get_line_extents(ink, logical);
+
+    const auto barWidth  = static_cast<float>(toPixels(ink.get_width()));
+    const auto barHeight = static_cast<float>(toPixels(ink.get_height()));
+    // A blank line has no ink and needs no bar.
+    if (0.0F >= barWidth || 0.0F >= barHeight) {
+      rows.push_back(Doc::VBORow{});
+      continue;
+    }
+    const auto left = pageMargin + static_cast<float>(toPixels(ink.get_x()));
+    const auto top =
+        pageMargin + static_cast<float>(toPixels(placed.top + ink.get_y()));
+
+    // Solid, so the fragment stage fills it with this colour and never
+    // samples the atlas. That is what lets the coarse path share the glyph
+    // pipeline instead of needing one of its own, and it keeps all eight
+    // bits of the shade: a bar is drawn as ink, not as paper.
+    const auto shade = greekedShade(inkArea / (barWidth * barHeight));
+    rows.push_back(Doc::VBORow{
+        {placed.originX + left + (barWidth / 2.0F),
+         placed.originY - (top + (barHeight / 2.0F))},
+        Doc::VBORow::fill(color(shade), Doc::VBORow::onText),
+        0,
+        Doc::VBORow::box(0, quadExtent(barWidth), quadExtent(barHeight),
+                         render::tagKindPage),
+        Doc::VBORow::paperAt(color(shade), 0)});
+    drawn++;
+  } while (lineIter.next_line());
+  return drawn;
+}
+
+/// Glyph box area per line of @p layout, to be filled in by walkClusters().
+std::vector<float> lineInkFor(const Glib::RefPtr<Pango::Layout> &layout) {
+  return std::vector<float>(
+      static_cast<std::size_t>(std::max(0, layout->get_line_count())), 0.0F);
+}
+
+} // namespace
+
+Page::Built Page::build(const Glib::RefPtr<Pango::Layout> &layout,
+                        GlyphCache &glyphs) {
+  Built built;
+  const auto color = Doc::VBORow::color;
+  const auto box   = Doc::VBORow::box;
+
+  // Everything below is in layout pixels, the unit Pango reports positions and
+  // sizes in. The page's model matrix scales them to world units, so a glyph's
+  // quad and the advance that places it shrink together -- they did not before,
+  // and the mismatch drew every glyph on top of its neighbours.
+  int textWidthPx  = 0;
+  int textHeightPx = 0;
+  layout->get_pixel_size(textWidthPx, textHeightPx);
+  built.pageWidth  = static_cast<float>(textWidthPx) + (2 * pageMargin);
+  built.pageHeight = static_cast<float>(textHeightPx) + (2 * pageMargin);
 
-  textBytes       = static_cast<std::uint32_t>(limit);
-  detailInstances = static_cast<std::uint32_t>(vertexData.size());
+  // The page is centred on its own origin, so that the model matrix placing it
+  // in the scene positions its middle rather than its top left corner. Kept as
+  // members so caret geometry lands in the same space as the glyphs.
+  built.originX = -built.pageWidth / 2.0F;
+  built.originY = built.pageHeight / 2.0F;
+  const RowPlacement placed{built.originX, built.originY, 0};
+  // Noted before the first glyph is reserved: a repack after that may have
+  // moved any of them.
+  built.citation = std::make_shared<GlyphCitation>();
+  built.glyphsAt = glyphs.repacks();
 
-  // The coarse draw. One quad per line, covering the line's ink box -- the box
-  // the glyphs actually mark, not the logical box, which runs to the wrapping
-  // width whether or not there is text out there. At the size this is used at
-  // a line is a few pixels tall and its glyphs are indistinguishable anyway,
-  // so what matters is that the bar sits where the text sits and is about as
-  // dark.
+  // The allocation holds two draws back to back: the full-detail one -- page
+  // background followed by a glyph per cluster -- and then the coarse one,
+  // which repeats the background and follows it with a solid bar per line.
+  // Repeating the background costs one row and is what lets either draw be
+  // aimed at with a byte offset and a count, with no second allocation and no
+  // stitching of two ranges.
+  const auto pushBackground = [&] {
+    built.rows.push_back(Doc::VBORow{
+        {0.0F, 0.0F},
+        Doc::VBORow::fill(color(255), Doc::VBORow::onPaper),
+        0,
+        box(0,
+            std::min(Doc::VBORow::maxQuadExtent,
+                     static_cast<unsigned int>(built.pageWidth)),
+            std::min(Doc::VBORow::maxQuadExtent,
+                     static_cast<unsigned int>(built.pageHeight)),
+            render::tagKindPage),
+        // A click on bare paper resolves to the start of the page, which is
+        // what a page-kind tag with no cluster already means.
+        Doc::VBORow::paperAt(color(255), 0)});
+  };
   pushBackground();
+
+  const auto text = layout->get_text().raw();
+
+  // A page layout is handed the whole rest of the document and limited by
+  // height, so its text runs far past what the page shows. Everything below is
+  // bounded by what the page actually consumes -- without which the final
+  // cluster's end ran to the end of the document, producing a "cluster" of
+  // tens of kilobytes.
+  // Not const: a page that would hold more clusters than one can name gives
+  // the rest back to the next page, which is what keeps every cluster on this
+  // one pickable.
+  auto limit = std::min<std::size_t>(text.size(), Doc::consumedBytes(layout));
+
+  // Glyph box area per line, accumulated as the clusters are placed. This is
+  // what tells the coarse path how full each line is, so that its bar is as
+  // dark as the glyphs it stands in for without anything having to be assumed
+  // about the text.
+  auto lineInk = lineInkFor(layout);
+
+  // The paragraphs, each taking a run of the cluster table with some room
+  // after it, and a run of the glyph rows.
+  auto starts =
+      gleditor::paragraphStarts(std::string_view(text).substr(0, limit));
+  built.paragraphs.resize(starts.size());
+  built.paragraphs.front().firstRow = 1;
+  std::size_t paragraph = 0;
+  const auto closeParagraph = [&](const std::size_t end) {
+    auto &para        = built.paragraphs[paragraph];
+    para.byteStart    = starts[paragraph];
+    para.bytes        = static_cast<std::uint32_t>(end) - para.byteStart;
+    para.clusterCount = static_cast<std::uint32_t>(built.clusters.size()) -
+                        para.firstCluster;
+    para.rowCount =
+        static_cast<std::uint32_t>(built.rows.size()) - para.firstRow;
+    para.clusterRoom =
+        std::min(gleditor::clusterRoomFor(para.clusterCount),
+                 Doc::VBORow::maxClustersPerPage - para.firstCluster);
+    para.whole = 0 != gleditor::trailingBreak(
+                          std::string_view(text).substr(para.byteStart,
+                                                        para.bytes));
+    built.clusters.resize(para.firstCluster + para.clusterRoom,
+                          ClusterBox{static_cast<std::uint32_t>(end), 0, 0});
+  };
+  const auto atCluster = [&](const std::size_t start) {
+    while (paragraph + 1 < starts.size() && start >= starts[paragraph + 1]) {
+      closeParagraph(starts[paragraph + 1]);
+      paragraph++;
+      built.paragraphs[paragraph].firstCluster =
+          static_cast<std::uint32_t>(built.clusters.size());
+      built.paragraphs[paragraph].firstRow =
+          static_cast<std::uint32_t>(built.rows.size());
+    }
+  };
+  limit = walkClusters(layout, glyphs, built.citation.get(), placed, limit, 0,
+                       built.rows, built.glyphOfRow, built.clusters, lineInk,
+                       atCluster, &built.glyphKeys);
+  // A page cut short by running out of cluster indices ends before some of the
+  // paragraphs it started with -- perhaps right at the start of one, in which
+  // case the one before has been closed already.
+  while (starts.size() > 1 && starts.back() >= limit) {
+    starts.pop_back();
+  }
+  built.paragraphs.resize(starts.size());
+  if (paragraph < starts.size()) {
+    atCluster(limit);
+    closeParagraph(limit);
+  }
+
+  built.textBytes = static_cast<std::uint32_t>(limit);
+  // Room at the end of the detailed draw for paragraphs laid out again to grow
+  // into. Empty rows, so they draw nothing until one does.
+  built.spareRows =
+      gleditor::spareRowsFor(static_cast<std::uint32_t>(built.rows.size()) - 1);
+  built.rows.resize(built.rows.size() + built.spareRows);
+  built.detailInstances = static_cast<std::uint32_t>(built.rows.size());
+  built.glyphOfRow.resize(built.detailInstances, GlyphCache::noGlyph);
+
+  // Where each paragraph's lines are, and how much room they take.
   {
-    auto lineIter         = layout->get_iter();
-    std::size_t lineIndex = 0;
+    auto lineIter  = layout->get_iter();
+    std::size_t at = 0;
+    int lineIndex  = 0;
     do {
-      const auto &line = layout->get_const_line(static_cast<int>(lineIndex));
-      // Lines past what this page consumes belong to the next page; the layout
-      // is handed the rest of the document and bounded by height, so it has
-      // them and the page must not draw them.
+      const auto &line = layout->get_const_line(lineIndex);
       if (!line || static_cast<std::size_t>(line->get_start_index()) >= limit) {
         break;
       }
-      const auto inkArea =
-          lineIndex < lineInk.size() ? lineInk[lineIndex] : 0.0F;
-      lineIndex++;
-
+      const auto lineStart = static_cast<std::size_t>(line->get_start_index());
+      while (at + 1 < built.paragraphs.size() &&
+             lineStart >= built.paragraphs[at + 1].byteStart) {
+        at++;
+      }
       Pango::Rectangle ink;
       Pango::Rectangle logical;
       lineIter.get_line_extents(ink, logical);
-
-      const auto barWidth  = static_cast<float>(toPixels(ink.get_width()));
-      const auto barHeight = static_cast<float>(toPixels(ink.get_height()));
-      // A blank line has no ink and needs no bar.
-      if (0.0F >= barWidth || 0.0F >= barHeight) {
-        continue;
+      auto &para = built.paragraphs[at];
+      if (0 == para.lines) {
+        para.firstLine = static_cast<std::uint32_t>(lineIndex);
+        para.top       = logical.get_y();
       }
-      const auto left = pageMargin + static_cast<float>(toPixels(ink.get_x()));
-      const auto top  = pageMargin + static_cast<float>(toPixels(ink.get_y()));
-
-      // Solid, so the fragment stage fills it with this colour and never
-      // samples the atlas. That is what lets the coarse path share the glyph
-      // pipeline instead of needing one of its own, and it keeps all eight
-      // bits of the shade: a bar is drawn as ink, not as paper.
-      const auto shade = greekedShade(inkArea / (barWidth * barHeight));
-      vertexData.push_back(Doc::VBORow{
-          {originX + left + (barWidth / 2.0F),
-           originY - (top + (barHeight / 2.0F))},
-          Doc::VBORow::fill(color(shade), Doc::VBORow::onText),
-          0,
-          box(0, extent(barWidth), extent(barHeight), render::tagKindPage),
-          Doc::VBORow::paperAt(color(shade), 0)});
+      para.lines++;
+      para.height = logical.get_y() + logical.get_height() - para.top;
+      para.width  = std::max(para.width, logical.get_x() + logical.get_width());
+      lineIndex++;
     } while (lineIter.next_line());
   }
-  coarseInstances =
-      static_cast<std::uint32_t>(vertexData.size()) - detailInstances;
+
+  // The coarse draw: the background again, and a bar per line.
+  pushBackground();
+  const auto bars = pushLineBars(layout, placed, limit, lineInk, built.rows);
+  built.coarseInstances =
+      static_cast<std::uint32_t>(built.rows.size()) - built.detailInstances;
   // A page with no lines to bar would draw its background alone, which is not
   // what the page looks like; fall back to the detailed draw instead.
-  if (1 >= coarseInstances) {
-    vertexData.resize(detailInstances);
-    coarseInstances = 0;
+  if (0 == bars) {
+    built.rows.resize(built.detailInstances);
+    built.coarseInstances = 0;
   }
+  built.shaped = true;
+  return built;
+}
+
+Page::Built Page::placeholder(const std::uint32_t bytes) {
+  Built built;
+  built.pageWidth  = placeholderWidth();
+  built.pageHeight = placeholderHeight();
+  built.originX    = -built.pageWidth / 2.0F;
+  built.originY    = built.pageHeight / 2.0F;
+  built.textBytes  = bytes;
+  const auto color = Doc::VBORow::color;
+  built.rows.push_back(Doc::VBORow{
+      {0.0F, 0.0F},
+      Doc::VBORow::fill(color(placeholderShade), Doc::VBORow::onPaper),
+      0,
+      Doc::VBORow::box(0,
+                       std::min(Doc::VBORow::maxQuadExtent,
+                                static_cast<unsigned int>(built.pageWidth)),
+                       std::min(Doc::VBORow::maxQuadExtent,
+                                static_cast<unsigned int>(built.pageHeight)),
+                       render::tagKindPage),
+      Doc::VBORow::paperAt(color(placeholderShade), 0)});
+  built.detailInstances = 1;
+  return built;
+}
 
-  const auto rows = static_cast<std::uint32_t>(vertexData.size());
+// The constructor parameters are named with a leading `a` so that the body can
+// refer to the members without ambiguity: the members are move-constructed from
+// the parameters, which leaves the parameters empty.
+Page::Page(std::shared_ptr<Doc> aDoc, glm::mat4 &model, Built aBuilt,
+           const std::uint32_t aPageIndex,
+           const BufferPool::Allocation &inherited)
+    : Drawable(model), doc(std::move(aDoc)), pageBacking(inherited),
+      detailInstances(aBuilt.detailInstances),
+      coarseInstances(aBuilt.coarseInstances), pageWidth(aBuilt.pageWidth),
+      pageHeight(aBuilt.pageHeight), clusters(aBuilt.clusters),
+      paragraphs(std::move(aBuilt.paragraphs)), pageIndex(aPageIndex),
+      textBytes(aBuilt.textBytes), originX(aBuilt.originX),
+      originY(aBuilt.originY), shaped(aBuilt.shaped),
+      contentKey(contentKeys.fetch_add(1, std::memory_order_relaxed)),
+      citation(std::move(aBuilt.citation)),
+      glyphOfRow(std::move(aBuilt.glyphOfRow)), glyphsAt(aBuilt.glyphsAt) {
+  // Its box may not be the one it replaces.
+  this->doc->pageTreeStale = true;
+  // Built while the atlas was being repacked, perhaps; see relocateGlyphs().
+  if (!glyphOfRow.empty() && glyphsAt != this->doc->glyphsAt) {
+    this->doc->glyphsStale = true;
+  }
+  const auto rows = static_cast<std::uint32_t>(aBuilt.rows.size());
   if (pageBacking.empty()) {
     pageBacking = this->doc->pool->reserve(rows);
   } else {
@@ -471,81 +957,351 @@ Page::Page(std::shared_ptr<Doc> aDoc, RenderState &state, glm::mat4 &model,
     // if it does have to move them.
     this->doc->pool->resize(pageBacking, rows, BufferPool::Contents::Discard);
   }
-  this->doc->pool->write(pageBacking, 0, asBytes(vertexData));
-
-  // The shaping has done what it was for: the quads are in the buffer and the
-  // cluster table records where each one came from. Keeping it is what made a
-  // megabyte of text cost ninety megabytes of Pango, and a document that is
-  // read rather than edited never asks for it again. See Page::layout.
-  dropLayout();
+  this->doc->pool->write(pageBacking, 0, asBytes(aBuilt.rows));
+  // Written as empty rows with the rest, and told to the pool as erased so
+  // that relayParagraph() is handed them when a paragraph grows.
+  if (0 != aBuilt.spareRows) {
+    this->doc->pool->eraseRows(pageBacking,
+                               detailInstances - aBuilt.spareRows,
+                               aBuilt.spareRows);
+  }
 }
 
-bool Page::contains(const std::uint32_t globalOffset) const {
-  // The end of the last page is a valid caret position, so the upper bound is
-  // inclusive there and exclusive everywhere else -- otherwise the caret could
-  // not be put after the final character.
-  return globalOffset >= textOffset && globalOffset <= textOffset + textBytes;
+std::uint32_t Page::baseOffset() const {
+  return doc->pageStart(pageIndex);
 }
 
-void Doc::keepLayoutOf(const std::uint32_t pageIndex) const {
-  // Already the most recent, so there is nothing to record and nothing to
-  // drop; a caret sitting still asks its page for a layout every frame.
-  if (!liveLayouts.empty() && liveLayouts.back() == pageIndex) {
-    return;
+void Page::noticed(const std::uint64_t frame) const {
+  lastSeen = frame;
+  if (!resident() && !restoring) {
+    restoring = true;
+    doc->wantedBack.push_back(pageIndex);
   }
-  std::erase(liveLayouts, pageIndex);
-  liveLayouts.push_back(pageIndex);
+}
 
-  while (liveLayouts.size() > maxLiveLayouts) {
-    const auto oldest = liveLayouts.front();
-    liveLayouts.pop_front();
-    // Pages are renumbered by a reflow, so an index recorded before one may
-    // now name a different page or none at all. Dropping the wrong page's
+gleditor::CullBox Page::cullBox() const {
+  return cullBoxOf(model, pageWidth, pageHeight);
+}
+
+void Page::evict() {
+  doc->pool->release(pageBacking);
+  pageBacking = {};
+  // Nothing draws its glyphs now, so nothing need keep them in the atlas.
+  citation.reset();
+  glyphOfRow = {};
+  dropLayout();
+  doc->layouts.forget(pageIndex);
+}
+
+bool Page::relocateGlyphs(const GlyphCache &glyphs) {
+  const auto repacks = glyphs.committedRepacks();
+  if (glyphsAt == repacks) {
+    return true;
+  }
+  if (!resident() || glyphOfRow.empty()) {
+    glyphsAt = repacks;
+    return true;
+  }
+  std::vector<GlyphCache::Sizes> now(glyphOfRow.size());
+  const auto answered = glyphs.lookUp(glyphOfRow, now);
+  if (!answered) {
+    return false;
+  }
+  static_assert(offsetof(Doc::VBORow, quad) ==
+                    offsetof(Doc::VBORow, atlas) + sizeof(unsigned int),
+                "a glyph's atlas origin and its layer are patched together");
+  auto &pool = *doc->pool;
+  for (std::uint32_t row = 0; row < glyphOfRow.size(); row++) {
+    const auto &glyph = now[row];
+    if (GlyphCache::noGlyph == glyph.glyph) {
+      continue;
+    }
+    const auto &coords = glyph.texCoords;
+    // The box as walkClusters() wrote it, on the glyph's new layer.
+    const std::array<unsigned int, 2> fields{
+        Doc::VBORow::atlasAt(static_cast<unsigned int>(coords.topLeft.x),
+                             static_cast<unsigned int>(coords.topLeft.y)),
+        Doc::VBORow::box(
+            static_cast<unsigned char>(glyph.layer),
+            quadExtent(
+                static_cast<float>(std::to_underlying(glyph.dims.width))),
+            quadExtent(
+                static_cast<float>(std::to_underlying(glyph.dims.height))),
+            render::tagKindGlyph)};
+    pool.patch(pageBacking, row, offsetof(Doc::VBORow, atlas),
+               std::as_bytes(std::span(fields)));
+  }
+  glyphsAt = *answered;
+  return true;
+}
+
+void Doc::relocateGlyphs(const GlyphCache &glyphs) {
+  const auto repacks = glyphs.committedRepacks();
+  if (!glyphsStale && glyphsAt == repacks) {
+    return;
+  }
+  bool settled = true;
+  for (auto &page : pages) {
+    settled = page.relocateGlyphs(glyphs) && settled;
+  }
+  if (settled) {
+    glyphsAt    = repacks;
+    glyphsStale = false;
+  }
+}
+
+void Page::renumber(const std::uint32_t index, const glm::mat4 &placed) {
+  pageIndex          = index;
+  model              = placed;
+  doc->pageTreeStale = true;
+  // A restore asked for under the old index will not find this page, so it
+  // asks again under the new one.
+  restoring = false;
+}
+
+bool Page::contains(const std::uint32_t globalOffset) const {
+  // The end of the last page is a valid caret position, so the upper bound is
+  // inclusive there and exclusive everywhere else -- otherwise the caret could
+  // not be put after the final character.
+  const auto start = baseOffset();
+  return globalOffset >= start && globalOffset <= start + textBytes;
+}
+
+std::size_t Page::layoutBytes() const {
+  std::size_t bytes = layout ? textBytes : 0;
+  if (paragraphLayout && paragraphShaped < paragraphs.size()) {
+    bytes += paragraphs[paragraphShaped].bytes;
+  }
+  return bytes * gleditor::LayoutBudget::bytesPerTextByte;
+}
+
+void Doc::keepLayoutOf(const std::uint32_t pageIndex,
+                       const std::chrono::nanoseconds cost) const {
+  const auto bytes = pageIndex < pages.size() ? pages[pageIndex].layoutBytes()
+                                              : std::size_t{0};
+  for (const auto other : layouts.keep(pageIndex, bytes, cost)) {
+    // Pages are renumbered by a reflow, so an index recorded before one may
+    // now name a different page or none at all. Dropping the wrong page's
     // layout costs it a reshaping and nothing else, and dropping none is only
     // a page kept a little longer.
-    if (oldest < pages.size()) {
-      pages[oldest].dropLayout();
+    if (other < pages.size()) {
+      pages[other].dropLayout();
     }
   }
 }
 
-std::string_view Page::pageText() const {
-  const std::string_view whole{doc->contents().raw()};
-  if (textOffset >= whole.size()) {
-    return {};
+void Doc::wantShapedAround(const std::size_t pageIndex) const {
+  // Every frame the caret is drawn asks; only arriving on a page does
+  // anything, and paging on through the document asks again on each page.
+  if (shapedAround == pageIndex) {
+    return;
+  }
+  shapedAround = pageIndex;
+  if (0 < pageIndex) {
+    wantedShaped.push_back(static_cast<std::uint32_t>(pageIndex - 1));
   }
-  return whole.substr(textOffset, textBytes);
+  if (pageIndex + 1 < pages.size()) {
+    wantedShaped.push_back(static_cast<std::uint32_t>(pageIndex + 1));
+  }
+}
+
+std::string_view Page::pageText(std::string &scratch) const {
+  return doc->contents().slice(baseOffset(), textBytes, scratch);
 }
 
 Glib::RefPtr<Pango::Layout> Page::ensureLayout() const {
-  if (!layout) {
-    // The same call, on the same bytes, that produced this page in the first
-    // place, so what comes back is what was drawn.
-    layout = doc->layoutFrom(textOffset);
-    doc->keepLayoutOf(pageIndex);
+  if (layout) {
+    doc->layouts.touch(pageIndex);
+    return layout;
   }
+  // The same call, on the same bytes, that produced this page in the first
+  // place, so what comes back is what was drawn.
+  const auto started = std::chrono::steady_clock::now();
+  layout             = doc->layoutFrom(baseOffset());
+  doc->layouts.recordShaped();
+  doc->keepLayoutOf(pageIndex, std::chrono::steady_clock::now() - started);
   return layout;
 }
 
+Glib::RefPtr<Pango::Layout>
+Page::shapeParagraph(const std::size_t index) const {
+  if (!paragraphLayout || paragraphShaped != index) {
+    const auto started = std::chrono::steady_clock::now();
+    const auto &para   = paragraphs[index];
+    const auto offset = baseOffset() + para.byteStart;
+    std::string scratch;
+    const auto own = doc->contents().slice(offset, para.bytes, scratch);
+    // Without its line break, which would otherwise be laid out as an empty
+    // line after it: on the page, that line is the next paragraph's first.
+    paragraphLayout =
+        doc->layoutOf(offset, para.bytes - gleditor::trailingBreak(own));
+    // Asked now rather than by the caller, so that the time taken is the
+    // shaping's: a layout breaks its lines the first time it is asked about
+    // them.
+    static_cast<void>(paragraphLayout->get_line_count());
+    paragraphShaped = index;
+    doc->keepLayoutOf(pageIndex, std::chrono::steady_clock::now() - started);
+  } else {
+    doc->layouts.touch(pageIndex);
+  }
+  return paragraphLayout;
+}
+
+bool Page::relayParagraph(const std::size_t index,
+                          const Glib::RefPtr<Pango::Layout> &local,
+                          const std::int32_t delta, GlyphCache &glyphs) {
+  auto &para = paragraphs[index];
+  // As many lines as before and as tall, so that every paragraph after it
+  // stays where it is. Without a coarse draw there are no bars to rewrite, and
+  // whether the page should now have one is a question for a rebuild.
+  if (0 == coarseInstances ||
+      std::cmp_not_equal(local->get_line_count(), para.lines)) {
+    return false;
+  }
+  Pango::Rectangle ink;
+  Pango::Rectangle logical;
+  local->get_extents(ink, logical);
+  if (logical.get_height() != para.height) {
+    return false;
+  }
+  // Nor can the page change width, which would move its origin and with it
+  // every row on it.
+  int others = 0;
+  for (std::size_t i = 0; i < paragraphs.size(); i++) {
+    if (i != index) {
+      others = std::max(others, paragraphs[i].width);
+    }
+  }
+  const auto width = logical.get_x() + logical.get_width();
+  if (std::max(others, width) != std::max(others, para.width)) {
+    return false;
+  }
+
+  const RowPlacement placed{originX, originY, para.top};
+  const auto laidOut = local->get_text().bytes();
+  std::vector<Doc::VBORow> rows;
+  std::vector<std::uint32_t> glyphOfRows;
+  std::vector<ClusterBox> fresh;
+  auto lineInk = lineInkFor(local);
+  // Cited alongside the glyphs the page already draws. Those the edit took
+  // away stay cited until the page is next built, which is a few glyphs.
+  if (!citation) {
+    citation = std::make_shared<GlyphCitation>();
+  }
+  if (walkClusters(local, glyphs, citation.get(), placed, laidOut,
+                   para.firstCluster, rows, glyphOfRows, fresh, lineInk,
+                   [](std::size_t) {}) < laidOut) {
+    return false;
+  }
+  for (auto &cluster : fresh) {
+    cluster.byteStart += para.byteStart;
+  }
+  // The line break that was left out of the shaping belongs to the last
+  // cluster, as it does when the page is built; an empty paragraph is its line
+  // break and nothing else.
+  const auto lineBreak = static_cast<std::uint32_t>(
+      static_cast<std::int64_t>(para.bytes) + delta -
+      static_cast<std::int64_t>(laidOut));
+  if (0 != lineBreak) {
+    if (fresh.empty()) {
+      fresh.push_back(ClusterBox{
+          para.byteStart + static_cast<std::uint32_t>(laidOut), 0, 0});
+    }
+    fresh.back().byteLength += lineBreak;
+    fresh.back().charCount += lineBreak;
+  }
+
+  std::vector<Doc::VBORow> bars;
+  pushLineBars(local, placed, std::numeric_limits<std::size_t>::max(),
+               lineInk, bars);
+  if (bars.size() != para.lines ||
+      !gleditor::relayClusters(clusters, paragraphs, index, fresh, delta)) {
+    return false;
+  }
+
+  // The old glyphs go, and the new ones take whatever erased run fits: their
+  // own, when the paragraph did not grow.
+  auto &pool = *doc->pool;
+  // Erased rows are zeroed, and must stay so: relocateGlyphs() has to know
+  // they show no glyph.
+  const auto glyphRows = [this](const std::uint32_t first,
+                                const std::uint32_t count) {
+    glyphOfRow.resize(std::max<std::size_t>(glyphOfRow.size(), first + count),
+                      GlyphCache::noGlyph);
+    return glyphOfRow.begin() + first;
+  };
+  if (0 != para.rowCount) {
+    pool.eraseRows(pageBacking, para.firstRow, para.rowCount);
+    std::fill_n(glyphRows(para.firstRow, para.rowCount), para.rowCount,
+                GlyphCache::noGlyph);
+  }
+  para.rowCount = static_cast<std::uint32_t>(rows.size());
+  if (!rows.empty()) {
+    const auto at = pool.reuseRows(pageBacking, para.rowCount);
+    if (!at) {
+      return false;
+    }
+    para.firstRow = *at;
+    pool.write(pageBacking, para.firstRow, asBytes(rows));
+    glyphOfRows.resize(rows.size(), GlyphCache::noGlyph);
+    std::ranges::copy(glyphOfRows, glyphRows(para.firstRow, para.rowCount));
+  }
+  // One bar per line, and as many lines as before, so they go where the old
+  // ones were: after the coarse draw's background.
+  pool.write(pageBacking, detailInstances + 1 + para.firstLine,
+             asBytes(bars));
+
+  para.width = width;
+  textBytes  = static_cast<std::uint32_t>(
+      static_cast<std::int64_t>(textBytes) + delta);
+  // The page's own shaping is of the text before the edit; the paragraph's is
+  // the one just made.
+  layout.reset();
+  paragraphLayout = local;
+  paragraphShaped = index;
+  doc->keepLayoutOf(pageIndex, {});
+  // Nor is any picture of the page a picture of it any more.
+  contentKey = contentKeys.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
 bool Page::caretGeometry(const std::uint32_t globalOffset, float &posX,
                          float &posY, float &height) const {
   // Whether the caret is on this page is answered before the page is shaped
   // again, or drawing a caret would shape every page of the document to find
   // the one page it is on.
-  if (!contains(globalOffset)) {
+  // Nor is a placeholder shaped for it: its geometry is not the page's, and
+  // the loader is asked for the page instead; see Doc::want().
+  if (!shaped || !contains(globalOffset)) {
     return false;
   }
-  const auto shaped = ensureLayout();
-  if (!shaped) {
+  // Only the paragraph the caret is in is shaped, and placed where it sits on
+  // the page: typing shapes that paragraph anyway, and the caret following it
+  // should not have the whole page shaped again to find where it went.
+  auto local = globalOffset - baseOffset();
+  int above  = 0;
+  Glib::RefPtr<Pango::Layout> lay;
+  if (const auto held = gleditor::paragraphHolding(paragraphs, local)) {
+    const auto &para = paragraphs[*held];
+    lay              = shapeParagraph(*held);
+    // Past the end of what was shaped is only ever inside its line break,
+    // which a caret is drawn before.
+    local = std::min<std::uint32_t>(local - para.byteStart,
+                                    lay ? lay->get_text().bytes() : 0);
+    above = para.top;
+  } else {
+    lay = ensureLayout();
+  }
+  if (!lay) {
     return false;
   }
   Pango::Rectangle strong;
   Pango::Rectangle weak;
-  shaped->get_cursor_pos(static_cast<int>(globalOffset - textOffset), strong,
-                         weak);
+  lay->get_cursor_pos(static_cast<int>(local), strong, weak);
 
   const auto left = pageMargin + static_cast<float>(toPixels(strong.get_x()));
-  const auto top  = pageMargin + static_cast<float>(toPixels(strong.get_y()));
+  const auto top =
+      pageMargin + static_cast<float>(toPixels(above + strong.get_y()));
   const auto tall = static_cast<float>(toPixels(strong.get_height()));
 
   posX   = originX + left + (Caret::widthPixels / 2.0F);
@@ -560,7 +1316,7 @@ Page::offsetForCluster(const std::uint32_t clusterIndex,
   if (clusterIndex >= clusters.size()) {
     return std::nullopt;
   }
-  const auto &cluster = clusters[clusterIndex];
+  const auto cluster = clusters[clusterIndex];
 
   const auto steps = render::clusterCharStep(cluster.charCount, fraction);
 
@@ -569,7 +1325,8 @@ Page::offsetForCluster(const std::uint32_t clusterIndex,
   auto offset = static_cast<std::size_t>(cluster.byteStart);
   const auto end =
       static_cast<std::size_t>(cluster.byteStart + cluster.byteLength);
-  const auto text = pageText();
+  std::string scratch;
+  const auto text = pageText(scratch);
   for (std::uint32_t taken = 0; taken < steps && offset < end;) {
     offset++;
     while (offset < end &&
@@ -579,30 +1336,57 @@ Page::offsetForCluster(const std::uint32_t clusterIndex,
     taken++;
   }
 
-  return textOffset + static_cast<std::uint32_t>(offset);
+  return baseOffset() + static_cast<std::uint32_t>(offset);
 }
 
 // Always called from the render thread
-void Page::collect(std::vector<render::GlyphBatch> &batches,
+bool Page::collect(std::vector<render::GlyphBatch> &batches,
                    const glm::mat4 &docTransform, const float opacity,
-                   const DrawBudget &budget, DrawStats &stats) const {
+                   const std::uint32_t documentIndex, const DrawBudget &budget,
+                   DrawStats &stats) const {
   if (0 == detailInstances) {
-    return;
+    return false;
   }
-  stats.pages++;
-
   const auto mvp = docTransform * model;
-  // The page is flat: a rectangle in x and y, with the glyphs sitting just in
-  // front of the background in z.
-  if (budget.cull &&
-      outsideFrustum(mvp, pageWidth / 2.0F, pageHeight / 2.0F, glyphDepth)) {
-    stats.culled++;
-    return;
+  noticed(budget.frame);
+  if (!resident()) {
+    stats.evicted++;
+    return true;
+  }
+  stats.resident++;
+  if (!shaped) {
+    stats.placeholders++;
   }
 
-  const bool coarse =
-      0 != coarseInstances &&
-      screenScaleAt(mvp, budget.screenWidth) < budget.coarseBelow;
+  // Which document and page these quads belong to is the same for every one of
+  // them, so it is not written into any of them: the draw carries it, and a
+  // quad carries only the kind, which does vary -- the background and the bars
+  // are the page itself, where a glyph is a character within it.
+  const auto identity = render::packTagIdentity(0, documentIndex, pageIndex);
+  const auto scale    = screenScaleAt(mvp, budget.screenWidth);
+  const bool coarse   = 0 != coarseInstances && scale < budget.coarseBelow;
+  // Between the two, a picture of the page if there is one, and a request for
+  // one if not; the page is drawn glyph by glyph until it arrives.
+  if (!coarse && shaped && nullptr != budget.impostors &&
+      scale < budget.impostorBelow &&
+      !budget.impostors->highlighted(identity)) {
+    const auto step = gleditor::PageImpostors::stepFor(scale);
+    if (budget.impostors->collect(contentKey, step, mvp, pageWidth,
+                                  pageHeight, opacity, identity)) {
+      stats.impostors++;
+      return true;
+    }
+    budget.impostors->want(gleditor::ImpostorWant{
+        .doc    = doc,
+        .page   = contentKey,
+        .step   = step,
+        .start  = baseOffset(),
+        .bytes  = textBytes,
+        .width  = pageWidth,
+        .height = pageHeight,
+        .edited = doc->editGeneration(),
+        .text   = doc->textSnapshot()});
+  }
   if (coarse) {
     stats.coarse++;
   } else {
@@ -619,6 +1403,7 @@ void Page::collect(std::vector<render::GlyphBatch> &batches,
       doc->pool->buffer(),
       doc->pool->byteOffset(pageBacking) + (first * sizeof(Doc::VBORow)),
       count});
+  return true;
 }
 
 // Always called from the render thread
@@ -630,38 +1415,188 @@ void Doc::collect(std::vector<render::GlyphBatch> &batches,
   if (opacity() <= 0.0F) {
     return;
   }
-  const auto docTransform = viewProjection * modelMatrix();
+  drawn().collectFor(*this, batches, viewProjection * modelMatrix(), budget,
+                     stats);
+}
+
+void Doc::refreshPageTree() const {
+  const auto total = pages.size() + remainderPages;
+  if (!pageTreeStale && pageTree.size() == total) {
+    return;
+  }
+  std::vector<gleditor::CullBox> boxes;
+  boxes.reserve(total);
   for (const auto &page : pages) {
-    page.collect(batches, docTransform, opacity(), budget, stats);
+    boxes.push_back(page.cullBox());
+  }
+  for (auto index = pages.size(); index < total; index++) {
+    boxes.push_back(cullBoxOf(pagePlacement(index), placeholderWidth(),
+                              placeholderHeight()));
+  }
+  // The page is flat: a rectangle in x and y, with the glyphs sitting just in
+  // front of the background in z.
+  pageTree.rebuild(boxes, glyphDepth);
+  pageTreeStale = false;
+}
+
+void Doc::collectFor(const Doc &viewer,
+                     std::vector<render::GlyphBatch> &batches,
+                     const glm::mat4 &docTransform, const DrawBudget &budget,
+                     DrawStats &stats) const {
+  const auto alpha = viewer.opacity();
+  std::vector<std::uint32_t> inView;
+  viewer.pagesShown.reset();
+
+  // The text not yet paginated is drawn as the pages it is expected to make,
+  // after the pages there are. They are all the same quad, so they share its
+  // one row and differ only in where the draw puts them.
+  const auto draw = [&](const std::size_t index) {
+    if (index < pages.size()) {
+      auto &shown = viewer.pagesShown;
+      shown       = shown ? std::pair{std::min(shown->first, index),
+                                      std::max(shown->second, index)}
+                          : std::pair{index, index};
+      if (pages[index].collect(batches, docTransform, alpha, viewer.docIndex,
+                               budget, stats) &&
+          !pages[index].isShaped()) {
+        inView.push_back(static_cast<std::uint32_t>(index));
+      }
+      return;
+    }
+    stats.detailed++;
+    stats.placeholders++;
+    inView.push_back(static_cast<std::uint32_t>(index));
+    batches.push_back(render::GlyphBatch{
+        render::DrawUniforms{toArray(docTransform * pagePlacement(index)),
+                             alpha,
+                             render::packTagIdentity(
+                                 0, viewer.docIndex,
+                                 static_cast<std::uint32_t>(index))},
+        pool->buffer(), pool->byteOffset(placeholderRow), 1});
+  };
+
+  const auto total = pages.size() + remainderPages;
+  stats.pages += static_cast<std::uint32_t>(total);
+  if (!budget.cull) {
+    for (std::size_t index = 0; index < total; index++) {
+      draw(index);
+    }
+  } else {
+    // Only the pages under the nodes the view reaches are visited; a page near
+    // the view without being in it is stamped as seen, so that it keeps its
+    // rows or is built again before it arrives.
+    refreshPageTree();
+    pageHits.clear();
+    stats.nodesVisited +=
+        pageTree.query(frustumPlanes(docTransform), nearViewScale, pageHits);
+    std::size_t drawnHere = 0;
+    for (const auto &hit : pageHits) {
+      if (!hit.inView) {
+        if (hit.index < pages.size()) {
+          pages[hit.index].noticed(budget.frame);
+        }
+        continue;
+      }
+      drawnHere++;
+      draw(hit.index);
+    }
+    stats.culled += static_cast<std::uint32_t>(total - drawnHere);
+  }
+
+  const std::lock_guard lock(focusGuard);
+  if (&viewer == this) {
+    placeholdersInView = std::move(inView);
+    return;
+  }
+  // A borrower is drawn after its lender, and what it shows is as much what
+  // the loader should build first as what the lender shows.
+  for (const auto index : inView) {
+    if (std::ranges::find(placeholdersInView, index) ==
+        placeholdersInView.end()) {
+      placeholdersInView.push_back(index);
+    }
   }
 }
 
+std::optional<std::pair<std::uint32_t, std::uint32_t>>
+Doc::textInView() const {
+  const auto &shown = drawn().pages;
+  if (!pagesShown || pagesShown->second >= shown.size()) {
+    return std::nullopt;
+  }
+  const auto &last = shown[pagesShown->second];
+  return std::pair{shown[pagesShown->first].baseOffset(),
+                   last.baseOffset() + last.textLength()};
+}
+
+Doc::LoadFocus Doc::loadFocus() const {
+  const std::lock_guard lock(focusGuard);
+  return {.pages = placeholdersInView, .offset = wantedOffset};
+}
+
+void Doc::want(const std::uint32_t offset) const {
+  const std::lock_guard lock(focusGuard);
+  wantedOffset = offset;
+}
+
 glm::mat4 Doc::modelMatrix() const {
   return glm::translate(glm::mat4(1.0F), position());
 }
 
+std::size_t Doc::pageAt(const std::uint32_t offset) const {
+  return backlog ? backlog->pageAt(pageStarts, offset)
+                 : pageStarts.pageAt(offset);
+}
+
+std::uint32_t Doc::pageStart(const std::size_t page) const {
+  return static_cast<std::uint32_t>(backlog ? backlog->startOf(pageStarts, page)
+                                            : pageStarts.startOf(page));
+}
+
+std::optional<std::size_t>
+Doc::pageHolding(const std::uint32_t offset) const {
+  if (pages.empty()) {
+    return std::nullopt;
+  }
+  // The page the offset lands on, unless it is the very start of that page
+  // and so also the end of the one before -- which is the one it belongs to,
+  // as the first page to claim it.
+  const auto found = pageAt(offset);
+  if (found > 0 && pages[found - 1].contains(offset)) {
+    return found - 1;
+  }
+  if (pages[found].contains(offset)) {
+    return found;
+  }
+  return std::nullopt;
+}
+
 std::optional<Doc::Anchor>
 Doc::anchorFor(const std::uint32_t globalOffset) const {
-  for (std::size_t i = 0; i < pages.size(); i++) {
-    // Asked page by page rather than by searching, because the same call
-    // decides whether the offset is on the page and where -- and the deciding
-    // half is answered without shaping anything.
-    Anchor anchor{static_cast<std::uint32_t>(i), 0.0F, 0.0F, 0.0F};
-    if (pages[i].caretGeometry(globalOffset, anchor.x, anchor.y,
-                               anchor.height)) {
-      return anchor;
-    }
+  if (lender) {
+    return lender->anchorFor(globalOffset);
   }
-  return std::nullopt;
+  const auto holding = pageHolding(globalOffset);
+  if (!holding || !pages[*holding].isShaped()) {
+    want(globalOffset);
+    return std::nullopt;
+  }
+  Anchor anchor{static_cast<std::uint32_t>(*holding), 0.0F, 0.0F, 0.0F};
+  if (!pages[*holding].caretGeometry(globalOffset, anchor.x, anchor.y,
+                                     anchor.height)) {
+    return std::nullopt;
+  }
+  return anchor;
 }
 
 std::optional<glm::vec3> Doc::worldPoint(const std::uint32_t pageIndex,
                                          const float posX,
                                          const float posY) const {
-  if (pageIndex >= pages.size()) {
+  const auto *const placed = page(pageIndex);
+  if (nullptr == placed) {
     return std::nullopt;
   }
-  const auto point = modelMatrix() * pages[pageIndex].getModel() *
+  const auto point = modelMatrix() * placed->getModel() *
                      glm::vec4(posX, posY, 0.0F, 1.0F);
   return glm::vec3(point);
 }
@@ -708,61 +1643,53 @@ void Doc::animateMoveTo(ch::Timeline &timeline, const glm::vec3 &target) {
 
 std::optional<render::HighlightRange>
 Page::highlightFor(const std::uint32_t selStart, const std::uint32_t selEnd,
-                   const std::uint32_t colour) const {
+                   const std::uint32_t colour,
+                   const std::uint32_t documentIndex) const {
   if (selEnd <= selStart || clusters.empty()) {
     return std::nullopt;
   }
   // Clip the span to this page, in page-local bytes.
-  const auto pageStart = textOffset;
-  const auto pageEnd   = textOffset + textBytes;
+  const auto pageStart = baseOffset();
+  const auto pageEnd   = pageStart + textBytes;
   if (selEnd <= pageStart || selStart >= pageEnd) {
     return std::nullopt;
   }
-  const auto localStart = std::max(selStart, pageStart) - textOffset;
-  const auto localEnd   = std::min(selEnd, pageEnd) - textOffset;
-
-  const auto text = pageText();
+  const auto localStart = std::max(selStart, pageStart) - pageStart;
+  const auto localEnd   = std::min(selEnd, pageEnd) - pageStart;
 
-  std::optional<std::size_t> first;
-  std::size_t last = 0;
-  for (std::size_t i = 0; i < clusters.size(); i++) {
-    const auto &box  = clusters[i];
-    const auto begin = box.byteStart;
-    const auto end   = box.byteStart + box.byteLength;
-    // Half-open overlap: a cluster is covered when any of its bytes are.
-    if (end <= localStart || begin >= localEnd) {
-      continue;
-    }
-    if (!first) {
-      first = i;
-    }
-    last = i;
-  }
-  if (!first) {
+  // Half-open overlap: a cluster is covered when any of its bytes are. Room
+  // left for a paragraph to grow into covers none.
+  const auto covered = clusters.covering(localStart, localEnd);
+  if (!covered) {
     return std::nullopt;
   }
+  const auto [first, last] = *covered;
+
+  std::string scratch;
+  const auto text = pageText(scratch);
 
   // Where inside the edge clusters the span begins and ends, counted in
   // characters so the edge cannot land mid-glyph of a ligature.
-  const auto fractionInto = [&text](const ClusterBox &box,
-                                    const std::uint32_t offset) -> float {
+  const auto fractionInto = [text](const ClusterBox &box,
+                                   const std::uint32_t offset) -> float {
     if (0 == box.charCount) {
       return 0.0F;
     }
     const auto clamped =
         std::clamp(offset, box.byteStart, box.byteStart + box.byteLength);
-    const auto chars = utf8Length(
-        std::string_view(text).substr(box.byteStart, clamped - box.byteStart));
+    const auto chars =
+        gleditor::countCharacters(
+            text.substr(box.byteStart, clamped - box.byteStart));
     return static_cast<float>(chars) / static_cast<float>(box.charCount);
   };
 
   render::HighlightRange range;
   range.identity      = render::packTagIdentity(render::tagKindGlyph,
-                                                doc->documentIndex(), pageIndex);
-  range.firstCluster  = static_cast<std::uint32_t>(*first);
+                                                documentIndex, pageIndex);
+  range.firstCluster  = static_cast<std::uint32_t>(first);
   range.lastCluster   = static_cast<std::uint32_t>(last);
   range.colour        = colour;
-  range.startFraction = fractionInto(clusters[*first], localStart);
+  range.startFraction = fractionInto(clusters[first], localStart);
   range.endFraction   = fractionInto(clusters[last], localEnd);
   return range;
 }
@@ -770,8 +1697,16 @@ Page::highlightFor(const std::uint32_t selStart, const std::uint32_t selEnd,
 void Doc::highlightsFor(const std::uint32_t selStart,
                         const std::uint32_t selEnd, const std::uint32_t colour,
                         std::vector<render::HighlightRange> &out) const {
-  for (const auto &page : pages) {
-    if (auto range = page.highlightFor(selStart, selEnd, colour)) {
+  const auto &from = drawn();
+  if (from.pages.empty() || selEnd <= selStart) {
+    return;
+  }
+  // Only the pages the range can reach, rather than asking every page of the
+  // document whether it overlaps.
+  const auto last = from.pageAt(selEnd);
+  for (auto i = from.pageAt(selStart); i <= last; i++) {
+    if (auto range =
+            from.pages[i].highlightFor(selStart, selEnd, colour, docIndex)) {
       out.push_back(*range);
     }
   }
@@ -796,17 +1731,24 @@ void Doc::drawCaret(RenderState &state, const glm::mat4 &viewProjection,
   if (!caret.active() || caret.documentIndex() != docIndex) {
     return;
   }
-  for (const auto &pageOn : pages) {
-    float posX   = 0.0F;
-    float posY   = 0.0F;
-    float height = 0.0F;
-    if (!pageOn.caretGeometry(caret.byteOffset(), posX, posY, height)) {
-      continue;
-    }
-    caret.setGeometry(posX, posY, height);
-    caret.draw(state, viewProjection * modelMatrix() * pageOn.getModel());
+  const auto &from   = drawn();
+  const auto holding = from.pageHolding(caret.byteOffset());
+  if (!holding || !from.pages[*holding].isShaped()) {
+    // Somewhere the document has not loaded yet: wherever that is, it is
+    // where the loader should be.
+    from.want(caret.byteOffset());
+    return;
+  }
+  const auto &pageOn = from.pages[*holding];
+  from.wantShapedAround(*holding);
+  float posX         = 0.0F;
+  float posY         = 0.0F;
+  float height       = 0.0F;
+  if (!pageOn.caretGeometry(caret.byteOffset(), posX, posY, height)) {
     return;
   }
+  caret.setGeometry(posX, posY, height);
+  caret.draw(state, viewProjection * modelMatrix() * pageOn.getModel());
 }
 
 const char *reflowScopeName(const ReflowScope scope) {
@@ -821,7 +1763,7 @@ const char *reflowScopeName(const ReflowScope scope) {
   return "unknown";
 }
 
-Glib::RefPtr<Pango::Layout> Doc::layoutFrom(const std::uint32_t offset) const {
+Glib::RefPtr<Pango::Layout> Doc::blankLayout() const {
   const auto fontDesc =
       Pango::FontDescription(renderer->defaultFontName().data());
   const auto fonts = Pango::CairoFontMap::get_default();
@@ -831,20 +1773,43 @@ Glib::RefPtr<Pango::Layout> Doc::layoutFrom(const std::uint32_t offset) const {
   auto lay = Pango::Layout::create(ctx);
   lay->set_font_description(fontDesc);
   lay->set_single_paragraph_mode(false);
-  lay->set_height(std::ceil(139.70 * 11 * PANGO_SCALE));
-  lay->set_width(std::ceil(139.70 * 8.5 * PANGO_SCALE));
+  lay->set_width(pageWidthUnits);
+  return lay;
+}
+
+Glib::RefPtr<Pango::Layout> Doc::layoutOf(const std::uint32_t offset,
+                                          const std::uint32_t bytes) const {
+  auto lay = blankLayout();
+  std::string scratch;
+  const auto slice = text.slice(offset, bytes, scratch);
+  pango_layout_set_text(lay->gobj(), slice.data(),
+                        static_cast<int>(slice.size()));
+  return lay;
+}
+
+Glib::RefPtr<Pango::Layout> Doc::layoutFrom(const std::uint32_t offset) const {
+  auto lay = blankLayout();
+  lay->set_height(pageHeightUnits);
   lay->set_ellipsize(Pango::EllipsizeMode::END);
 
-  const char *txt = text.raw().c_str();
-  const auto size = text.bytes();
-  if (offset >= size) {
+  if (offset >= text.size()) {
     lay->set_text("");
     return lay;
   }
   // The same slice makePages() uses. This path is the one an edit reflows
   // through, so leaving it handing Pango the whole document would have left
   // the fault in place for every keystroke in a long one.
-  fillPage(lay, txt + offset, size - offset);
+  fillPage(lay, text, offset);
+  return lay;
+}
+
+Glib::RefPtr<Pango::Layout>
+Doc::layoutFrom(const gleditor::PieceTable::Snapshot &snapshot,
+                const std::uint32_t offset) const {
+  auto lay = blankLayout();
+  lay->set_height(pageHeightUnits);
+  lay->set_ellipsize(Pango::EllipsizeMode::END);
+  fillPage(lay, snapshot, offset);
   return lay;
 }
 
@@ -948,53 +1913,351 @@ std::vector<int> Doc::lineBreaksAround(const std::uint32_t at) const {
   if (pages.empty()) {
     return {};
   }
-  std::size_t firstPage = 0;
-  for (std::size_t i = 0; i < pages.size(); i++) {
-    if (at >= pages[i].baseOffset()) {
-      firstPage = i;
-    }
+  return lineStarts(pages[pageAt(at)].ensureLayout());
+}
+
+bool Doc::withinParagraph(const std::uint32_t at,
+                          const std::string_view removed) const {
+  // Taking a newline away joins two paragraphs, which neither one laid out
+  // again can account for.
+  if (pages.empty() || std::string_view::npos != removed.find('\n')) {
+    return false;
   }
-  return lineStarts(pages[firstPage].ensureLayout());
+  const auto &page = pages[pageAt(at)];
+  return page.isShaped() && page.resident() &&
+         gleditor::paragraphHolding(page.paragraphTable(),
+                                    at - page.baseOffset())
+             .has_value();
 }
 
-void Doc::scheduleReflow(RenderState &state, const std::uint32_t at,
-                         const std::int32_t delta,
-                         const std::vector<int> &oldStarts) {
-  // Which page holds the edit. Everything before it is untouched by
-  // construction: text ahead of an edit cannot reflow.
-  std::size_t firstPage = 0;
-  for (std::size_t i = 0; i < pages.size(); i++) {
-    if (at >= pages[i].baseOffset()) {
-      firstPage = i;
+bool Doc::reflowParagraph(RenderState &state, const std::size_t pageIndex,
+                          const gleditor::EditSpan &span) {
+  auto &page = pages[pageIndex];
+  if (!page.isShaped() || !page.resident()) {
+    return false;
+  }
+  const auto start = page.baseOffset();
+  const auto delta = span.delta;
+  const auto held =
+      gleditor::paragraphHolding(page.paragraphTable(), span.from - start);
+  if (!held) {
+    return false;
+  }
+  const auto &para = page.paragraphTable()[*held];
+  // Its line break has to be on the page, or it has to run to the end of the
+  // text. A paragraph the page ends partway through says nothing, laid out
+  // alone, about where the page ends.
+  const auto pageEnd = static_cast<std::int64_t>(start) + page.textLength();
+  if (!para.whole &&
+      pageEnd + delta != static_cast<std::int64_t>(text.size())) {
+    return false;
+  }
+  const auto offset = start + para.byteStart;
+  const auto bytes  = static_cast<std::uint32_t>(
+      static_cast<std::int64_t>(para.bytes) + delta);
+  std::string scratch;
+  const auto own = text.slice(offset, bytes, scratch);
+  const auto body = bytes - gleditor::trailingBreak(own);
+  // Every edit of the burst has to have landed in this paragraph too.
+  if (span.to > offset + body) {
+    return false;
+  }
+  const auto lay = layoutOf(offset, body);
+  if (!page.relayParagraph(*held, lay, static_cast<std::int32_t>(delta),
+                           state.glyphCache)) {
+    return false;
+  }
+  pageStarts.setSpan(pageIndex, page.textLength());
+  return true;
+}
+
+void Doc::noteEdit(const std::uint32_t at, const std::string_view removed,
+                   const std::uint32_t inserted) {
+  const auto removedBytes = static_cast<std::uint32_t>(removed.size());
+  unsavedFrom = std::min<std::uint64_t>(unsavedFrom.value_or(at), at);
+  // Copy on write: the pages stay with whichever document was not edited,
+  // and the one that was -- or the ones borrowing from it -- build their own.
+  stopLending();
+  stopBorrowing();
+  if (wantsOwnPages) {
+    // No pages to reflow: the ones it builds are of the text as it stands.
+    return;
+  }
+  if (streaming) {
+    // Whatever the loader has yet to hand over is laid out by the reflow this
+    // edit joins, rather than by a loader paginating text that has changed.
+    settleStream();
+  }
+  if (removed.empty() && streams(at, inserted)) {
+    beginStream(at, inserted);
+    return;
+  }
+  if (pendingEdits) {
+    // The pages still show the text as it was before the first of these, so
+    // only that one could record what they looked like.
+    pendingEdits->merge(at, removedBytes, inserted);
+    pendingLocal = pendingLocal && std::string_view::npos == removed.find('\n');
+    return;
+  }
+  pendingEdits = gleditor::EditSpan::of(at, removedBytes, inserted);
+  // Before the splice: see lineBreaksAround(). Not wanted when the edit stays
+  // inside a paragraph, which is laid out on its own first.
+  pendingLocal      = withinParagraph(at, removed);
+  pendingStarts     = pendingLocal ? std::vector<int>{} : lineBreaksAround(at);
+  pendingStartsPage = pages.empty() ? 0 : pageAt(at);
+}
+
+bool Doc::streams(const std::uint32_t at,
+                  const std::uint32_t inserted) const {
+  // Only onto pages that are all there, and with no other reflow waiting to
+  // cross the same ones. A backlog is no obstacle while the paste lands ahead
+  // of it: the pages a stream adds only move it along.
+  return inserted >= streamedInsertBytes && !loading && !pages.empty() &&
+         !pendingEdits && !streaming &&
+         (!backlog || pageAt(at) < backlog->firstStale);
+}
+
+void Doc::beginStream(const std::uint32_t at, const std::uint32_t inserted) {
+  const auto page = pageAt(at);
+  const auto span = pageStarts.span(page) + inserted;
+  pageStarts.setSpan(page, span);
+  // What the page drew is of text the paste has just moved, so until the
+  // loader's pages take its place it is drawn as a page still loading is. It
+  // keeps its rows, which the reflow that finally replaces it inherits.
+  layouts.forget(static_cast<std::uint32_t>(page));
+  auto placed = pagePlacement(page);
+  pages[page] = Page(getPtr(), placed, Page::placeholder(span),
+                     static_cast<std::uint32_t>(page),
+                     pages[page].allocation());
+  streaming = StreamedInsert{
+      .generation = edits + 1, .page = page, .to = at + inserted};
+  streamWanted.store(streaming->generation, std::memory_order_relaxed);
+}
+
+void Doc::settleStream() {
+  const auto page  = streaming->page;
+  const auto from  = pageStart(page);
+  const auto bytes = streaming->to - from;
+  streaming.reset();
+  streamWanted.store(0, std::memory_order_relaxed);
+  // The placeholder's bytes replaced by as many: the pages after it are
+  // where they belong already, and only it is laid out again, until
+  // pagination comes back to them.
+  pendingEdits      = gleditor::EditSpan::of(from, bytes, bytes);
+  pendingLocal      = false;
+  pendingStarts     = {};
+  pendingStartsPage = page;
+}
+
+void Doc::acceptStreamed(
+    std::vector<std::pair<std::uint32_t, Page::Built>> &&laid) {
+  if (laid.empty()) {
+    return;
+  }
+  const auto first = streaming->page;
+  std::vector<std::uint32_t> spans;
+  spans.reserve(laid.size() + 1);
+  std::uint32_t covered = 0;
+  for (const auto &page : laid) {
+    spans.push_back(page.first);
+    covered += page.first;
+  }
+  // The placeholder goes on after them, covering what they do not.
+  const auto rest = pageStarts.span(first) - covered;
+  spans.push_back(rest);
+  pageStarts.splice(first, 1, spans);
+
+  const auto rows = pages[first].allocation();
+  pages.erase(pages.begin() + static_cast<std::ptrdiff_t>(first));
+  std::vector<Page> fresh;
+  fresh.reserve(spans.size());
+  for (std::size_t i = 0; i < laid.size(); i++) {
+    auto placed = pagePlacement(first + i);
+    fresh.emplace_back(getPtr(), placed, std::move(laid[i].second),
+                       static_cast<std::uint32_t>(first + i));
+  }
+  const auto after = first + laid.size();
+  auto placed      = pagePlacement(after);
+  fresh.emplace_back(getPtr(), placed, Page::placeholder(rest),
+                     static_cast<std::uint32_t>(after), rows);
+  pages.insert(pages.begin() + static_cast<std::ptrdiff_t>(first),
+               std::make_move_iterator(fresh.begin()),
+               std::make_move_iterator(fresh.end()));
+  // Linear in the pages, as a reflow that changes how many there are is, and
+  // for the same reason: only alongside building a batch of them.
+  for (auto i = after + 1; i < pages.size(); i++) {
+    pages[i].renumber(static_cast<std::uint32_t>(i), pagePlacement(i));
+  }
+  streaming->page = after;
+  if (backlog) {
+    backlog->firstStale += laid.size();
+  }
+}
+
+std::optional<Doc::StreamedPages> Doc::takeStreamedInsert() {
+  if (!streaming || streaming->started) {
+    return std::nullopt;
+  }
+  streaming->started = true;
+  return StreamedPages{.generation = streaming->generation,
+                       .text       = text.snapshot(),
+                       .from       = pageStart(streaming->page),
+                       .to         = streaming->to};
+}
+
+void Doc::paginateInserted(RenderState &state, const StreamedPages &wanted) {
+  const auto started = std::chrono::steady_clock::now();
+  auto self          = getPtr();
+  using Laid         = std::vector<std::pair<std::uint32_t, Page::Built>>;
+  Laid laid;
+  std::size_t built = 0;
+  const auto handOver = [&](const bool last) {
+    // Shared rather than captured by value, as newPage() hands its page on.
+    auto batch = std::make_shared<Laid>(std::move(laid));
+    laid       = {};
+    renderer->run([self, batch, last, generation = wanted.generation] {
+      // Edited since: the reflow that edit joined has what these would have
+      // been.
+      if (!self->streaming || self->streaming->generation != generation) {
+        return;
+      }
+      self->acceptStreamed(std::move(*batch));
+      if (last) {
+        self->settleStream();
+      }
+    });
+  };
+
+  const auto wantedStill = [this, &wanted] {
+    return wanted.generation == streamWanted.load(std::memory_order_relaxed);
+  };
+  auto offset = wanted.from;
+  while (offset < wanted.to && wantedStill()) {
+    // Laid out and built here, as makePages() does, and for the same reason;
+    // the layout never leaves this thread.
+    const auto lay      = layoutFrom(wanted.text, offset);
+    const auto consumed = consumedBytes(lay);
+    // A page reaching past the paste is the reflow's, which lays it out again
+    // against the pages after it; this one is thrown away.
+    if (0 == consumed || wanted.to - offset < consumed) {
+      break;
+    }
+    laid.emplace_back(consumed, Page::build(lay, state.glyphCache));
+    offset += consumed;
+    built++;
+    if (streamedBatchPages == laid.size()) {
+      handOver(false);
     }
   }
-  if (pages.empty()) {
+  handOver(true);
+  std::cout << std::format(
+      "streamed insert: {} pages of {} bytes in {:.1f} ms\n", built,
+      wanted.to - wanted.from,
+      std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - started)
+          .count());
+}
+
+Doc::PendingSave Doc::beginSave(const bool inPlace) {
+  PendingSave save;
+  save.text              = text.snapshot();
+  save.unsavedFrom       = unsavedFrom;
+  save.request.path      = docName;
+  save.request.unchanged = unsavedFrom.value_or(text.size());
+  save.request.inPlace   = inPlace;
+  save.request.mapsFile  = mapsFile;
+  if (0 == savesInFlight) {
+    save.request.expected = savedStamp;
+  }
+  unsavedFrom.reset();
+  savesInFlight++;
+  return save;
+}
+
+void Doc::endSave(const PendingSave &save,
+                  const gleditor::SaveOutcome &outcome) {
+  savesInFlight--;
+  if (outcome.ok()) {
+    savedStamp = outcome.stamp;
+    // A new file under the old name. The mapping stays on the one it
+    // replaced, so the text no longer reads from whatever is at the path.
+    if (gleditor::SaveMethod::replace == outcome.method) {
+      mapsFile = false;
+    }
     return;
   }
+  // What the save would have written is still to write, and the file may be
+  // half of it: only a replace is safe until one succeeds.
+  if (save.unsavedFrom) {
+    unsavedFrom = std::min(*save.unsavedFrom,
+                           unsavedFrom.value_or(*save.unsavedFrom));
+  }
+  savedStamp.reset();
+}
 
-  const auto oldConsumed = pages[firstPage].textLength();
+void Doc::reflowPending(RenderState &state,
+                        const std::chrono::steady_clock::time_point deadline) {
+  if (pendingEdits) {
+    const auto span = *pendingEdits;
+    pendingEdits.reset();
+    // Which page holds the first edit. Everything before it is untouched by
+    // construction: text ahead of an edit cannot reflow.
+    if (!pages.empty()) {
+      const auto firstPage = pageAt(span.from);
+      // Line breaks taken of some other page would compare as nothing in
+      // particular; without any, the scope is reported as page rather than
+      // line.
+      const auto oldStarts =
+          firstPage == pendingStartsPage ? std::move(pendingStarts)
+                                         : std::vector<int>{};
+      reflowFrom(state, firstPage, span, oldStarts, pendingLocal, deadline);
+    }
+    pendingStarts.clear();
+  }
 
-  auto self = getPtr();
-  renderer->run([self, &state, firstPage, at, delta, oldStarts, oldConsumed] {
-    self->reflowFrom(state, firstPage, at, delta, oldStarts, oldConsumed);
-  });
+  // A reflow left over from an earlier frame carries on with what time this
+  // one has left -- none, when the edits above took it all, and then it waits
+  // for the next.
+  if (!backlog || std::chrono::steady_clock::now() >= deadline) {
+    return;
+  }
+  const auto started = std::chrono::steady_clock::now();
+  const auto from    = backlog->firstStale;
+  // Where the index puts the first page not yet reached, which is the end of
+  // the last new page; the skew is already in pageStart(), so nothing is
+  // shifted on top of it.
+  const auto relayed = relayPages(
+      state,
+      {.firstPage = from,
+       .start     = static_cast<std::uint32_t>(backlog->resumeAt(pageStarts)),
+       .blockEnd  = from,
+       .shift     = 0,
+       .pauseFrom = from},
+      deadline);
+  reflowPages += relayed.rebuilt;
+  std::cout << std::format(
+      "reflow: continued, {} pages in {:.1f} ms, backlog {} pages\n",
+      relayed.rebuilt,
+      std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - started)
+          .count(),
+      reflowBacklog());
 }
 
-void Doc::insert(RenderState &state, const std::uint32_t offset,
-                 const std::string &utf8, Caret *caret) {
+void Doc::insert(const std::uint32_t offset, const std::string &utf8,
+                 Caret *caret) {
   if (utf8.empty()) {
     return;
   }
   const auto inserted = static_cast<std::uint32_t>(utf8.size());
-  const auto at       = std::min<std::uint32_t>(offset, text.bytes());
-  // Before the splice: see lineBreaksAround().
-  const auto oldStarts = lineBreaksAround(at);
+  const auto at =
+      std::min<std::uint32_t>(offset, static_cast<std::uint32_t>(text.size()));
+  noteEdit(at, {}, inserted);
 
   // Splice first: the document is the source of truth and must be correct
-  // before anything asynchronous looks at it.
-  auto raw = text.raw();
-  raw.insert(at, utf8);
-  text = raw;
+  // before anything asynchronous looks at it. A piece table, so this costs the
+  // same in a four-megabyte document as in an empty one.
+  text.insert(at, utf8);
   edits++;
 
   if (nullptr != caret) {
@@ -1004,14 +2267,11 @@ void Doc::insert(RenderState &state, const std::uint32_t offset,
   for (auto *const observer : observers) {
     observer->textInserted(*this, at, utf8);
   }
-
-  scheduleReflow(state, at, static_cast<std::int32_t>(inserted), oldStarts);
 }
 
-std::string Doc::erase(RenderState &state, const std::uint32_t offset,
-                       const std::uint32_t bytes, Caret *caret) {
-  auto raw = text.raw();
-  if (0 == bytes || raw.empty() || offset >= raw.size()) {
+std::string Doc::erase(const std::uint32_t offset, const std::uint32_t bytes,
+                       Caret *caret) {
+  if (0 == bytes || text.empty() || offset >= text.size()) {
     return {};
   }
 
@@ -1021,22 +2281,19 @@ std::string Doc::erase(RenderState &state, const std::uint32_t offset,
   // collapse a range naming part of one character to nothing, and would make
   // "delete one byte of a two-byte character" mean something other than
   // deleting that character.
-  const auto start = gleditor::alignToCharacterStart(raw, offset);
-  const auto end   = gleditor::alignToCharacterEnd(
-      raw, std::min<std::uint32_t>(offset + bytes,
-                                     static_cast<std::uint32_t>(raw.size())));
+  const auto start =
+      static_cast<std::uint32_t>(text.alignToCharacterStart(offset));
+  const auto end = static_cast<std::uint32_t>(text.alignToCharacterEnd(
+      std::min<std::size_t>(std::size_t{offset} + bytes, text.size())));
   if (end <= start) {
     return {};
   }
-  const auto removed = raw.substr(start, end - start);
-  // Before the erasure, for the same reason as in insert().
-  const auto oldStarts = lineBreaksAround(start);
+  const auto removed = text.substr(start, end - start);
+  noteEdit(start, removed, 0);
 
-  raw.erase(start, removed.size());
-  text = raw;
+  text.erase(start, removed.size());
   edits++;
 
-  const auto delta = -static_cast<std::int32_t>(removed.size());
   if (nullptr != caret) {
     caret->shiftForErasure(start, static_cast<std::uint32_t>(removed.size()));
   }
@@ -1045,77 +2302,158 @@ std::string Doc::erase(RenderState &state, const std::uint32_t offset,
     observer->textErased(*this, start, removed);
   }
 
-  scheduleReflow(state, start, delta, oldStarts);
   return removed;
 }
 
 void Doc::reflowFrom(RenderState &state, const std::size_t firstPage,
-                     const std::uint32_t at, const std::int32_t delta,
-                     const std::vector<int> &oldStarts,
-                     const std::uint32_t oldConsumed) {
+                     const gleditor::EditSpan &span,
+                     const std::vector<int> &oldStarts, const bool local,
+                     const std::chrono::steady_clock::time_point deadline) {
+  reflowEdits = span.edits;
+  // An edit inside one paragraph is tried on that paragraph alone first. When
+  // it comes out as many lines tall as it was, nothing else on the page moves,
+  // and shaping some hundreds of bytes is the whole of the reflow.
+  if (local && reflowParagraph(state, firstPage, span)) {
+    reflowScope = ReflowScope::Line;
+    reflowPages = 0;
+    std::cout << std::format(
+        "reflow: scope line, one paragraph of page {} for {} edits\n",
+        firstPage, span.edits);
+    return;
+  }
+
   // Lay the edited page out again and see how far the damage reaches.
   //
-  // Pagination re-syncs as soon as a page ends where it used to, shifted by
-  // what the edit changed. From there on every later page holds byte-identical
-  // text: its shaping, its glyphs and its vertex rows are all unchanged, and
-  // only the offset it reports moves. That is what keeps a keystroke from
-  // costing a relayout of the whole document.
+  // Pagination re-syncs as soon as a page ends where one used to, shifted by
+  // what the edits changed. From there on every later page holds
+  // byte-identical text: its shaping, its glyphs and its vertex rows are all
+  // unchanged, and only where it starts moves -- which the page index answers
+  // from the spans before it, so nothing about those pages has to be written
+  // at all. That is what keeps a keystroke from costing a relayout of the
+  // whole document, or a visit to every page after the one it landed on.
+  const auto shift      = span.delta;
+  const auto firstStart = pageStart(firstPage);
+  // The pages the edits landed on run to the one that held where the last of
+  // them ended, as the text was before any of them.
+  const auto oldEnd = static_cast<std::uint32_t>(std::max<std::int64_t>(
+      span.from, static_cast<std::int64_t>(span.to) - shift));
+  const auto blockEnd = std::max(firstPage, pageAt(oldEnd)) + 1;
+  // Stopping for time leaves the pages after the new ones out by a single
+  // amount. Those of an earlier reflow not yet reached are out by its skew,
+  // and the pages before them by this shift alone, so a reflow starting
+  // before them goes on until it reaches them -- and one starting among them
+  // goes on until it is done.
+  auto pauseFrom = blockEnd;
+  if (backlog) {
+    pauseFrom = firstPage < backlog->firstStale
+                    ? std::max(blockEnd, backlog->firstStale)
+                    : std::numeric_limits<std::size_t>::max();
+  }
+  const auto relayed = relayPages(state,
+                                  {.firstPage = firstPage,
+                                   .start     = firstStart,
+                                   .blockEnd  = blockEnd,
+                                   .shift     = shift,
+                                   .pauseFrom = pauseFrom},
+                                  deadline);
+
+  // The edited page absorbed the change when it alone was replaced, by one
+  // page that ends where it did, shifted by what the edits added or took away.
+  auto scope = ReflowScope::Document;
+  if (relayed.caughtUp && 1 == relayed.rebuilt && 1 == relayed.replaced &&
+      firstPage + 1 == blockEnd) {
+    const auto relativeAt = static_cast<int>(span.from - firstStart);
+    scope = sameLineBreaks(oldStarts, lineStarts(relayed.first), relativeAt,
+                           static_cast<int>(shift))
+                ? ReflowScope::Line
+                : ReflowScope::Page;
+  }
+  reflowScope = scope;
+  reflowPages = relayed.rebuilt;
+  std::cout << std::format(
+      "reflow: scope {} pages rebuilt {} of {} for {} edits\n",
+      reflowScopeName(scope), relayed.rebuilt, pages.size(), span.edits);
+  if (!relayed.caughtUp) {
+    std::cout << std::format("reflow: out of time, backlog {} pages\n",
+                             reflowBacklog());
+  }
+}
+
+Doc::Relayed
+Doc::relayPages(RenderState &state, const Relay &relay,
+                const std::chrono::steady_clock::time_point deadline) {
+  // Where an old page starts now: where it did, moved by the shift. Past the
+  // last page is the end of the text.
   //
-  // The comparisons are made in 64-bit signed arithmetic because a removal
-  // makes the shift negative, and every offset in sight is unsigned: the
-  // re-sync test would otherwise be an unsigned subtraction that wraps rather
-  // than going below zero, and would match at a wildly wrong page.
-  const auto shift = static_cast<std::int64_t>(delta);
+  // In 64-bit signed arithmetic because a removal makes the shift negative,
+  // and every offset in sight is unsigned: the re-sync test would otherwise
+  // be an unsigned subtraction that wraps rather than going below zero, and
+  // would match at a wildly wrong page.
+  const auto movedStart = [this, &relay](const std::size_t page) {
+    if (page >= pages.size()) {
+      return static_cast<std::int64_t>(text.size());
+    }
+    return static_cast<std::int64_t>(pageStart(page)) + relay.shift;
+  };
+  // What each rebuilt page spans, and its shaping.
   std::vector<std::pair<std::uint32_t, Glib::RefPtr<Pango::Layout>>> rebuilt;
-  auto offset     = pages[firstPage].baseOffset();
-  auto pageCursor = firstPage;
-  auto scope      = ReflowScope::Document;
-
-  while (offset < text.bytes()) {
+  auto offset = relay.start;
+  // The first old page the new ones have not yet covered.
+  auto next = relay.blockEnd;
+  // Whether a new page ended where an old one starts. From there on the old
+  // pages are intact; without it, either the text ran out first -- and the
+  // pages left hold text that no longer exists -- or time did.
+  bool resynced = false;
+  bool paused   = false;
+
+  while (offset < text.size()) {
     auto lay            = layoutFrom(offset);
     const auto consumed = consumedBytes(lay);
-    rebuilt.emplace_back(offset, lay);
-
-    if (pageCursor == firstPage) {
-      // The edited page absorbed the change when it still ends where it did,
-      // shifted by what the edit added or took away.
-      if (static_cast<std::int64_t>(consumed) ==
-          static_cast<std::int64_t>(oldConsumed) + shift) {
-        const auto relativeAt =
-            static_cast<int>(at - pages[firstPage].baseOffset());
-        scope = sameLineBreaks(oldStarts, lineStarts(lay), relativeAt,
-                               static_cast<int>(delta))
-                    ? ReflowScope::Line
-                    : ReflowScope::Page;
-      }
-    }
-
+    rebuilt.emplace_back(consumed, lay);
     offset += consumed;
-    pageCursor++;
 
-    if (ReflowScope::Document != scope) {
-      break; // pagination re-synced: later pages are untouched.
+    if (static_cast<std::int64_t>(offset) < movedStart(relay.blockEnd)) {
+      continue; // still among the pages the edits landed on.
     }
-    if (pageCursor >= pages.size()) {
-      break; // ran past the pages that existed; the tail is being rebuilt.
+    while (next < pages.size() &&
+           movedStart(next + 1) <= static_cast<std::int64_t>(offset)) {
+      next++;
     }
-    if (static_cast<std::int64_t>(offset) ==
-        static_cast<std::int64_t>(pages[pageCursor].baseOffset()) + shift) {
-      break; // re-synced further down.
+    if (next < pages.size() &&
+        movedStart(next) == static_cast<std::int64_t>(offset)) {
+      resynced = true;
+      break; // pagination re-synced: later pages are untouched.
+    }
+    // Checked after a whole page, and only with an old page left to stand in
+    // for what has not been laid out.
+    if (next >= relay.pauseFrom && next < pages.size() &&
+        std::chrono::steady_clock::now() >= deadline) {
+      paused = true;
+      break;
     }
   }
 
-  // The rows of the pages being replaced. A rebuilt page takes over the rows
-  // of the page it stands in for -- nearly the same length, since it covers
-  // nearly the same text -- rather than handing them back and asking for them
-  // again. Given back, the pool would satisfy the request from the first hole
-  // that fitted, which is how a page came to move across the buffer on every
-  // keystroke.
-  const auto lastRebuilt = firstPage + rebuilt.size();
-  const auto replaced    = std::min(lastRebuilt, pages.size());
+  // The old pages the new ones cover, or every page from the first on when
+  // the text ran out. Taken before anything changes: the skew is how far the
+  // first page left behind is from where the index will put it.
+  const auto replacing =
+      (resynced || paused ? next : pages.size()) - relay.firstPage;
+  const auto skew = paused ? movedStart(next) - offset : 0;
+  // Whether this reflow started at or before where the backlog carries on
+  // from, and so takes it over.
+  const bool overtakes =
+      backlog && (relay.firstPage < backlog->firstStale ||
+                  relay.start == backlog->resumeAt(pageStarts));
+
+  // A rebuilt page takes over the rows of the page it stands in for -- nearly
+  // the same length, since it covers nearly the same text -- rather than
+  // handing them back and asking for them again. Given back, the pool would
+  // satisfy the request from the first hole that fitted, which is how a page
+  // came to move across the buffer on every keystroke.
+  const auto firstPage = relay.firstPage;
   std::vector<BufferPool::Allocation> inherited;
-  inherited.reserve(replaced - firstPage);
-  for (std::size_t i = firstPage; i < replaced; i++) {
+  inherited.reserve(replacing);
+  for (std::size_t i = firstPage; i < firstPage + replacing; i++) {
     inherited.push_back(pages[i].allocation());
   }
   // Any page that has no successor gives its rows back for good.
@@ -1124,38 +2462,71 @@ void Doc::reflowFrom(RenderState &state, const std::size_t firstPage,
   }
   inherited.resize(std::min(inherited.size(), rebuilt.size()));
 
-  const auto tailFrom = std::min(lastRebuilt, pages.size());
-  std::vector<Page> tail;
-  tail.reserve(pages.size() - tailFrom);
-  for (std::size_t i = tailFrom; i < pages.size(); i++) {
-    tail.push_back(std::move(pages[i]));
-  }
-  pages.erase(pages.begin() + static_cast<std::ptrdiff_t>(firstPage),
-              pages.end());
-
-  for (std::size_t i = 0; i < rebuilt.size(); i++) {
-    auto &[base, lay] = rebuilt[i];
-    const auto index  = firstPage + i;
-    glm::mat4 trans =
-        glm::translate(glm::mat4(1.0),
-                       glm::vec3(0.0F, -100 * static_cast<float>(index), 0.0F));
-    trans = glm::scale(trans, glm::vec3(pixelsToWorld, pixelsToWorld, 1.0F));
-    pages.emplace_back(
-        getPtr(), state, trans, lay, base, static_cast<std::uint32_t>(index),
-        i < inherited.size() ? inherited[i] : BufferPool::Allocation{});
-  }
-  // Untouched pages keep their shaping and their vertex rows; only the offset
-  // they report moves.
-  for (auto &page : tail) {
-    page.shiftBaseOffset(delta);
-    pages.push_back(std::move(page));
+  std::vector<std::uint32_t> spans;
+  spans.reserve(rebuilt.size());
+  for (const auto &page : rebuilt) {
+    spans.push_back(page.first);
   }
 
-  reflowScope = scope;
-  reflowPages = rebuilt.size();
-  std::cout << std::format("reflow: scope {} pages rebuilt {} of {}\n",
-                           reflowScopeName(scope), rebuilt.size(),
-                           pages.size());
+  const auto build = [&](const std::size_t i) {
+    const auto index = firstPage + i;
+    auto placed      = pagePlacement(index);
+    // The page it replaces lets its shaping go with it.
+    layouts.forget(static_cast<std::uint32_t>(index));
+    return Page(getPtr(), placed,
+                Page::build(rebuilt[i].second, state.glyphCache),
+                static_cast<std::uint32_t>(index),
+                i < inherited.size() ? inherited[i] : BufferPool::Allocation{});
+  };
+
+  if (rebuilt.size() == replacing) {
+    // As many pages as before, which is every edit that re-synced within the
+    // page it landed on: each rebuilt page is replaced where it stands and
+    // its span updated, and every page after it moves with the span without
+    // being visited.
+    for (std::size_t i = 0; i < rebuilt.size(); i++) {
+      pageStarts.setSpan(firstPage + i, spans[i]);
+    }
+    for (std::size_t i = 0; i < rebuilt.size(); i++) {
+      pages[firstPage + i] = build(i);
+    }
+  } else {
+    // Pagination changed how many pages there are, so those after the change
+    // are renumbered -- linear in the pages, but only alongside shaping whole
+    // pages, which costs far more.
+    pageStarts.splice(firstPage, replacing, spans);
+    const auto from = pages.begin() + static_cast<std::ptrdiff_t>(firstPage);
+    pages.erase(from, from + static_cast<std::ptrdiff_t>(replacing));
+    std::vector<Page> fresh;
+    fresh.reserve(rebuilt.size());
+    for (std::size_t i = 0; i < rebuilt.size(); i++) {
+      fresh.push_back(build(i));
+    }
+    pages.insert(pages.begin() + static_cast<std::ptrdiff_t>(firstPage),
+                 std::make_move_iterator(fresh.begin()),
+                 std::make_move_iterator(fresh.end()));
+    for (auto i = firstPage + rebuilt.size(); i < pages.size(); i++) {
+      pages[i].renumber(static_cast<std::uint32_t>(i), pagePlacement(i));
+    }
+  }
+
+  if (paused) {
+    backlog = gleditor::ReflowBacklog{.firstStale = firstPage + rebuilt.size(),
+                                      .skew       = skew};
+  } else if (overtakes) {
+    if (next >= backlog->firstStale) {
+      backlog.reset(); // caught up with the pages it had not reached.
+    } else {
+      // Finished short of them, which only moved them along.
+      backlog->firstStale = backlog->firstStale + rebuilt.size() - replacing;
+    }
+  }
+
+  return Relayed{.rebuilt  = rebuilt.size(),
+                 .replaced = replacing,
+                 .caughtUp = !paused,
+                 .first    = rebuilt.empty() ? nullptr
+                                             : rebuilt.front().second};
 }
 
 Doc::Doc(const RendererRef &renderer, render::RenderDevice *device,
@@ -1171,29 +2542,101 @@ Doc::Doc(const RendererRef &renderer, render::RenderDevice *device,
   docName = source.name();
   std::cout << "NEW DOC: " << this << " " << docName << " "
             << glm::to_string(model) << "\n";
-  text = source.text();
+  // Before reading, so that a write landing between the two makes the stamp
+  // older than the text rather than newer: the first save then replaces.
+  const auto stamp = gleditor::stampOf(docName);
+  // A source that can lend its bytes -- a mapped file -- is read where they
+  // are, and the document keeps referring to them: its unedited text is never
+  // copied at all. Anything else is read into a string the document owns.
+  auto shared = source.share();
+  std::string loaded;
+  if (!shared) {
+    loaded = source.text();
+  }
+  const std::string_view bytes = shared ? shared->bytes : loaded;
 
   // Validated here rather than by the source, because every source needs it
   // and none of them can promise otherwise: the bytes come from a file
   // somebody else wrote, or from a program that assembled them out of pieces.
   // A document holding invalid UTF-8 crashes Pango somewhere inside shaping,
   // a long way from whatever produced it.
-  auto iter = text.begin();
-  if (!text.validate(iter)) {
-    // Only a failed validate() leaves `iter` on a real character; on success it
-    // is the end iterator and must not be dereferenced.
+  const auto scan = gleditor::scanUtf8(bytes);
+  if (scan.valid != bytes.size()) {
     std::cout << "invalid utf-8 in " << docName
-              << ", first bad offset: " << std::distance(text.begin(), iter)
-              << "\n";
-    text = text.make_valid();
+              << ", first bad offset: " << scan.valid << "\n";
+    // Repairing is the one case that copies lent bytes: they are not the
+    // document's to change.
+    loaded = Glib::ustring(std::string(bytes)).make_valid().raw();
+    shared.reset();
+  }
+  // Handed over rather than copied either way: lent bytes, or the loaded text,
+  // become the table's original buffer and stay where they are for the life
+  // of the document.
+  mapsFile = shared.has_value();
+  text = shared ? gleditor::PieceTable(shared->bytes, std::move(shared->owner))
+                : gleditor::PieceTable(std::move(loaded));
+  // The text is the file only if nothing was taken off or repaired on the way
+  // in, which is when the two are the same length.
+  if (stamp && stamp->bytes == text.size() && scan.valid == bytes.size()) {
+    savedStamp = stamp;
   }
+}
 
+bool Doc::borrowPagesOf(const std::shared_ptr<Doc> &other) {
+  if (!other) {
+    return false;
+  }
+  // One lender for every copy, rather than a chain to follow on every draw.
+  const auto &from = other->lender ? other->lender : other;
+  if (from.get() == this || lender || from->closing || from->wantsOwnPages ||
+      from->reflowIsPending() || !from->text.sameText(text)) {
+    return false;
+  }
+  lender = from;
+  from->borrowers.push_back(weak_from_this());
+  std::cout << std::format("share: {} draws the pages of document {}\n",
+                           docName, from->docIndex);
+  return true;
+}
+
+void Doc::stopBorrowing() {
+  if (!lender) {
+    return;
+  }
+  std::erase_if(lender->borrowers, [this](const std::weak_ptr<Doc> &one) {
+    const auto held = one.lock();
+    return !held || held.get() == this;
+  });
+  lender.reset();
+  wantsOwnPages = true;
+}
+
+void Doc::stopLending() {
+  // Taken first: each borrower would otherwise take itself off the list being
+  // walked.
+  for (const auto &one : std::exchange(borrowers, {})) {
+    if (const auto borrower = one.lock()) {
+      borrower->lender.reset();
+      borrower->wantsOwnPages = true;
+    }
+  }
+}
+
+void Doc::beginLoading() {
+  wantsOwnPages = false;
+  std::size_t characters = 0;
+  text.forEachRun(0, text.size(), [&characters](const std::string_view run) {
+    characters += gleditor::countCharacters(run);
+    return true;
+  });
   // The whole buffer in one allocation, before a page of it is laid out. Doing
   // it by growth instead cost more than the buffer itself: each intermediate
   // size is an allocation the driver keeps rather than returns, so arriving at
   // twenty-five megabytes through seven of them was worse for peak memory than
   // arriving at forty-eight through four.
-  pool->reserveCapacity(rowsFor(text.length()));
+  pool->reserveCapacity(rowsFor(characters));
+  loadText = textSnapshot();
+  loading  = true;
 }
 
 namespace {
@@ -1208,18 +2651,30 @@ namespace {
  */
 constexpr std::size_t firstPageGuess = 8 * 1024;
 
-} // namespace
+/// Longest UTF-8 sequence past its lead byte: how far a slice has to reach
+/// beyond its budget for the cut to be moved to the end of a character.
+constexpr std::size_t maxContinuationBytes = 3;
 
-void Doc::fillPage(const Glib::RefPtr<Pango::Layout> &layout, const char *from,
-                   const std::size_t remaining) {
+/**
+ * @brief The slicing loop of Doc::fillPage(), whatever the text is held in.
+ * @param window Returns the first @p n bytes of what remains, contiguously.
+ */
+template <typename Window>
+void fillPageFrom(const Glib::RefPtr<Pango::Layout> &layout,
+                  const std::size_t remaining, const Window &window) {
   for (auto budget = firstPageGuess;; budget *= 4) {
     if (remaining <= budget) {
-      pango_layout_set_text(layout->gobj(), from, static_cast<int>(remaining));
+      const std::string_view all = window(remaining);
+      pango_layout_set_text(layout->gobj(), all.data(),
+                            static_cast<int>(all.size()));
       return;
     }
+    const std::string_view span =
+        window(std::min(remaining, budget + maxContinuationBytes));
     const auto offered = gleditor::alignToCharacterEnd(
-        std::string_view{from, remaining}, static_cast<std::uint32_t>(budget));
-    pango_layout_set_text(layout->gobj(), from, static_cast<int>(offered));
+        span, static_cast<std::uint32_t>(budget));
+    pango_layout_set_text(layout->gobj(), span.data(),
+                          static_cast<int>(offered));
     if (layout->is_ellipsized()) {
       // Out of room, so the rest of the document could not have been shown on
       // this page however much of it Pango had been given.
@@ -1228,48 +2683,799 @@ void Doc::fillPage(const Glib::RefPtr<Pango::Layout> &layout, const char *from,
   }
 }
 
+} // namespace
+
+void Doc::fillPage(const Glib::RefPtr<Pango::Layout> &layout, const char *from,
+                   const std::size_t remaining) {
+  fillPageFrom(layout, remaining, [from](const std::size_t bytes) {
+    return std::string_view{from, bytes};
+  });
+}
+
+void Doc::fillPage(const Glib::RefPtr<Pango::Layout> &layout,
+                   const gleditor::PieceTable &text, const std::size_t offset) {
+  if (offset >= text.size()) {
+    pango_layout_set_text(layout->gobj(), "", 0);
+    return;
+  }
+  // Pango copies what it is handed, so one scratch buffer serves every slice
+  // the loop offers and need outlive none of them.
+  std::string scratch;
+  fillPageFrom(layout, text.size() - offset,
+               [&text, &scratch, offset](const std::size_t bytes) {
+                 return text.slice(offset, bytes, scratch);
+               });
+}
+
+void Doc::fillPage(const Glib::RefPtr<Pango::Layout> &layout,
+                   const gleditor::PieceTable::Snapshot &text,
+                   const std::size_t offset) {
+  if (offset >= text.size()) {
+    pango_layout_set_text(layout->gobj(), "", 0);
+    return;
+  }
+  // As the table's own slice(): in place when the slice lies in one run.
+  std::string scratch;
+  fillPageFrom(layout, text.size() - offset,
+               [&text, &scratch, offset](const std::size_t bytes) {
+                 std::string_view whole;
+                 scratch.clear();
+                 text.forEachRun(offset, bytes,
+                                 [&](const std::string_view run) {
+                                   if (scratch.empty() && run.size() >= bytes) {
+                                     whole = run.substr(0, bytes);
+                                     return false;
+                                   }
+                                   scratch.append(run);
+                                   return true;
+                                 });
+                 return whole.empty() ? std::string_view{scratch} : whole;
+               });
+}
+
+std::uint32_t Doc::paragraphStart(const gleditor::PieceTable::Snapshot &source,
+                                  const std::uint32_t offset) {
+  auto found = static_cast<std::uint32_t>(source.size());
+  auto at    = offset;
+  source.forEachRun(offset, source.size(), [&](const std::string_view run) {
+    const auto newline = run.find('\n');
+    if (std::string_view::npos != newline) {
+      found = at + static_cast<std::uint32_t>(newline) + 1;
+      return false;
+    }
+    at += static_cast<std::uint32_t>(run.size());
+    return true;
+  });
+  return found;
+}
+
+void Doc::wrapLines(const gleditor::PieceTable::Snapshot &source,
+                    std::uint32_t from, const std::uint32_t to,
+                    std::vector<gleditor::PaginationLine> &out) const {
+  std::string scratch;
+  while (from < to) {
+    const auto end =
+        to - from <= wrapSliceBytes
+            ? to
+            : std::min(to, paragraphStart(source, from + wrapSliceBytes));
+    const auto slice = source.slice(from, end - from, scratch);
+    // Wrapped as a page wraps, but neither bounded by height nor ellipsized:
+    // every line, at its full height.
+    auto lay = blankLayout();
+    pango_layout_set_text(lay->gobj(), slice.data(),
+                          static_cast<int>(slice.size()));
+    auto iter = lay->get_iter();
+    do {
+      Pango::Rectangle ink;
+      Pango::Rectangle logical;
+      iter.get_line_extents(ink, logical);
+      const auto start =
+          from + static_cast<std::uint32_t>(std::max(0, iter.get_index()));
+      // A slice ending in a newline has an empty line after it, which is the
+      // next slice's first.
+      if (start < end) {
+        out.push_back({.start = start, .height = logical.get_height()});
+      }
+    } while (iter.next_line());
+    from = end;
+  }
+}
+
+namespace {
+
+/// A built page's numbers, as the page cache stores them.
+gleditor::CachedPageHeader cachedHeader(const Page::Built &built) {
+  const auto count = [](const auto &table) {
+    return static_cast<std::uint32_t>(table.size());
+  };
+  return {.textBytes       = built.textBytes,
+          .rowCount        = count(built.rows),
+          .clusterCount    = count(built.clusters),
+          .paragraphCount  = count(built.paragraphs),
+          .glyphBytes      = count(built.glyphKeys),
+          .detailInstances = built.detailInstances,
+          .spareRows       = built.spareRows,
+          .coarseInstances = built.coarseInstances,
+          .pageWidth       = built.pageWidth,
+          .pageHeight      = built.pageHeight,
+          .originX         = built.originX,
+          .originY         = built.originY};
+}
+
+void addToCache(gleditor::PageCacheWriter *cache, const std::uint32_t index,
+                const Page::Built &built) {
+  if (nullptr != cache) {
+    cache->add(index, cachedHeader(built), std::as_bytes(std::span(built.rows)),
+               built.clusters, built.paragraphs,
+               std::as_bytes(std::span(built.glyphKeys)));
+  }
+}
+
+/**
+ * @brief A page read back from the cache, its glyphs found in this session's
+ *        atlas.
+ * @param text The page's text, which its cluster table is relative to.
+ *
+ * The page keeps what each glyph was reserved under when it was built, and in
+ * which font, so reserving them again finds the same bitmap -- already in the
+ * atlas, if another page got there first. Only where it sits can differ, so
+ * that is all that is rewritten. The rest of a row, its size included, is as
+ * the font drew it and the font is part of the key. A page whose record of
+ * that does not add up has its glyphs named by their clusters' text instead.
+ *
+ * @param layout A layout of the calling thread's, whose context the fonts are
+ *        loaded in.
+ */
+Page::Built builtFromCache(const gleditor::CachedPage &cached,
+                           const std::string_view text, GlyphCache &glyphs,
+                           const Glib::RefPtr<Pango::Layout> &layout) {
+  const auto context = layout->get_context();
+  const auto font    = context->load_font(layout->get_font_description());
+  const std::string_view record(
+      reinterpret_cast<const char *>(cached.glyphs.data()),
+      cached.glyphs.size());
+  const auto byteAt = [&record](const std::size_t at) {
+    return static_cast<std::size_t>(static_cast<unsigned char>(record[at]));
+  };
+  // The fonts first, then a font, a length and a key per glyph row.
+  std::vector<FontPtr> fonts;
+  std::size_t at = 0;
+  if (!record.empty()) {
+    const auto count = byteAt(at++);
+    while (fonts.size() < count && at < record.size() &&
+           at + 1 + byteAt(at) <= record.size()) {
+      const auto name = record.substr(at + 1, byteAt(at));
+      fonts.push_back(
+          context->load_font(Pango::FontDescription(std::string(name))));
+      at += 1 + name.size();
+    }
+    if (fonts.size() != count) {
+      fonts.clear();
+    }
+  }
+  const auto recorded = [&](std::string_view &key, FontPtr &in) {
+    if (fonts.empty() || at + 2 > record.size() ||
+        byteAt(at) >= fonts.size() || at + 2 + byteAt(at + 1) > record.size()) {
+      return false;
+    }
+    in  = fonts[byteAt(at)];
+    key = record.substr(at + 2, byteAt(at + 1));
+    at += 2 + key.size();
+    return true;
+  };
+
+  const auto &shape = cached.header;
+  Page::Built built;
+  built.rows.resize(shape.rowCount);
+  if (!built.rows.empty()) {
+    std::memcpy(built.rows.data(), cached.rows.data(), cached.rows.size());
+  }
+  built.clusters        = cached.clusterTable();
+  built.paragraphs      = cached.paragraphTable();
+  built.detailInstances = shape.detailInstances;
+  built.spareRows       = shape.spareRows;
+  built.coarseInstances = shape.coarseInstances;
+  built.textBytes       = shape.textBytes;
+  built.pageWidth       = shape.pageWidth;
+  built.pageHeight      = shape.pageHeight;
+  built.originX         = shape.originX;
+  built.originY         = shape.originY;
+  built.shaped          = true;
+  built.citation        = std::make_shared<GlyphCitation>();
+  built.glyphsAt        = glyphs.repacks();
+
+  constexpr unsigned int kindMask = 0x3U;
+  const auto detail =
+      std::min<std::size_t>(shape.detailInstances, built.rows.size());
+  built.glyphOfRow.assign(shape.detailInstances, GlyphCache::noGlyph);
+  for (std::size_t i = 0; i < detail; i++) {
+    auto &row = built.rows[i];
+    if (render::tagKindGlyph != (row.quad & kindMask)) {
+      continue;
+    }
+    std::string_view chr;
+    auto in = font;
+    if (!recorded(chr, in)) {
+      const auto cluster = row.paper & 0xFFFFU;
+      if (cluster >= built.clusters.size()) {
+        continue;
+      }
+      const auto &box = built.clusters[cluster];
+      if (box.byteStart > text.size()) {
+        continue;
+      }
+      chr = text.substr(box.byteStart, box.byteLength);
+      while (!chr.empty() && ('\n' == chr.back() || '\r' == chr.back())) {
+        chr.remove_suffix(1);
+      }
+    }
+    const auto glyph   = glyphs.reserve(chr, in, built.citation.get());
+    const auto &coords = glyph.texCoords;
+    row.atlas =
+        Doc::VBORow::atlasAt(static_cast<unsigned int>(coords.topLeft.x),
+                             static_cast<unsigned int>(coords.topLeft.y));
+    row.quad =
+        Doc::VBORow::onLayer(row.quad, static_cast<unsigned char>(glyph.layer));
+    built.glyphOfRow[i] = glyph.glyph;
+  }
+  return built;
+}
+
+} // namespace
+
+gleditor::PageCacheKey
+Doc::pageCacheKey(const gleditor::PieceTable::Snapshot &source) const {
+  auto hash = gleditor::textHashSeed;
+  source.forEachRun(0, source.size(), [&hash](const std::string_view run) {
+    hash = gleditor::hashText(hash, run);
+    return true;
+  });
+  return {.textHash   = hash,
+          .textBytes  = source.size(),
+          .font       = std::string(renderer->defaultFontName()),
+          .pageWidth  = pageWidthUnits,
+          .pageHeight = pageHeightUnits,
+          .margin     = static_cast<std::int32_t>(
+              std::lround(pageMargin * PANGO_SCALE)),
+          .pango      = pango_version_string(),
+          .rowBytes   = sizeof(VBORow)};
+}
+
+bool Doc::pagesFromCache(RenderState &state, const gleditor::PageCacheKey &key,
+                         const gleditor::PieceTable::Snapshot &source) {
+  const auto started = std::chrono::steady_clock::now();
+  const auto file =
+      (std::filesystem::path(state.pageCacheDir) / key.fileName()).string();
+  // Mapped, not read: the rows are copied straight out of the file into each
+  // page, and nothing else of it is wanted once they have been. No error is
+  // asked for, because every error means the same thing here -- no cache.
+  GMappedFile *mapped = g_mapped_file_new(file.c_str(), FALSE, nullptr);
+  if (nullptr == mapped) {
+    return false;
+  }
+  const std::shared_ptr<GMappedFile> owner(mapped, g_mapped_file_unref);
+  const auto view = gleditor::PageCacheView::open(
+      {g_mapped_file_get_contents(mapped), g_mapped_file_get_length(mapped)},
+      key);
+  if (!view || 0 == view->size()) {
+    std::cout << std::format("page cache: {} is not for this text, ignored\n",
+                             file);
+    return false;
+  }
+
+  std::vector<std::uint32_t> starts(view->size());
+  for (std::size_t i = 1; i < starts.size(); i++) {
+    starts[i] = starts[i - 1] + view->page(i - 1).header.textBytes;
+  }
+  // In batches, handed on in order between them, so that the first pages are
+  // on screen while the rest are still being read.
+  render::WorkerPool workers(
+      std::max(1U, std::thread::hardware_concurrency()));
+  const std::size_t batch = std::size_t{workers.parallelism()} * 8;
+  for (std::size_t first = 0; first < view->size(); first += batch) {
+    const auto count = std::min(batch, view->size() - first);
+    std::vector<Page::Built> built(count);
+    workers.run(static_cast<std::uint32_t>(count), [&](const std::uint32_t i) {
+      const auto index = first + i;
+      const auto page  = view->page(index);
+      std::string scratch;
+      const auto pageText =
+          source.slice(starts[index], page.header.textBytes, scratch);
+      // Fonts of its own on each thread, as each thread laying pages out has
+      // its own layout; Pango does not promise one can be shared.
+      built[i] = builtFromCache(page, pageText, state.glyphCache,
+                                blankLayout());
+    });
+    for (std::size_t i = 0; i < count; i++) {
+      const auto consumed = built[i].textBytes;
+      newPage(std::move(built[i]), consumed,
+              static_cast<std::uint32_t>(view->size() - first - i - 1));
+    }
+  }
+  std::cout << std::format(
+      "page cache: {} pages from {} in {:.1f} ms\n", view->size(), file,
+      std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - started)
+          .count());
+  finishLoading(state, nullptr);
+  return true;
+}
+
 void Doc::makePages(RenderState &state) {
   std::cout << "MAKING PAGES: " << this << " " << glm::to_string(model) << "\n";
-  auto tSize = 0UL;
-  while (tSize < text.bytes()) {
+  const auto started = std::chrono::steady_clock::now();
+  // Everything below reads the text as it was when loading began, not the
+  // table: the render thread goes on taking edits meanwhile, and an edit
+  // grows the vectors a reader of the table is walking. An edit is the
+  // reflow's to lay out, and the text past it is the same text moved along,
+  // so a page of the snapshot handed on after it is still the right page.
+  const auto loaded = loadText;
+  const auto &source = *loaded;
+  // This text opened before in this font and on these pages: the pages are
+  // the ones built then, and there is nothing to shape. Otherwise they are
+  // written down as they are built, for next time.
+  std::shared_ptr<gleditor::PageCacheWriter> cache;
+  if (!state.pageCacheDir.empty()) {
+    const auto key = pageCacheKey(source);
+    if (pagesFromCache(state, key, source)) {
+      return;
+    }
+    cache = std::make_shared<gleditor::PageCacheWriter>(state.pageCacheDir,
+                                                        key);
+  }
+  const auto parallelism = gleditor::paginationParallelism(
+      source.size(), std::max(1U, std::thread::hardware_concurrency()));
+  // Each page waits here between being built, on whichever thread, and being
+  // handed on in order.
+  std::vector<Page::Built> laid(gleditor::paginationSlots(parallelism));
+
+  // Where every page handed on starts, so that an offset the reader wants can
+  // be turned into the page holding it; the render thread's index lags behind
+  // this one by whatever it has not yet been given.
+  std::vector<std::uint32_t> starts;
+  std::uint32_t frontier = 0;
+  // Pages handed on as placeholders, waiting to be built.
+  gleditor::LoadQueue unbuilt;
+  // Pages starting before this are paginated and left unbuilt, because the
+  // reader is looking further on. Read by every thread laying pages out.
+  std::atomic<std::uint32_t> buildFrom{0};
+
+  // Bytes in a page, going by the pages so far: what turns an offset beyond
+  // where pagination has got to into a guess at the page it will be on.
+  const auto averageSpan = [&] {
+    return starts.empty() ? firstPageGuess
+                          : std::max<std::size_t>(1, frontier / starts.size());
+  };
+  // The pages the reader wants, as the render thread last saw it.
+  const auto focus = [&] {
+    auto wanted = loadFocus();
+    if (wanted.offset) {
+      const auto offset = *wanted.offset;
+      if (offset < frontier) {
+        wanted.pages.push_back(static_cast<std::uint32_t>(
+            std::ranges::upper_bound(starts, offset) - starts.begin() - 1));
+      } else {
+        wanted.pages.push_back(static_cast<std::uint32_t>(
+            starts.size() + ((offset - frontier) / averageSpan())));
+      }
+    }
+    return wanted.pages;
+  };
+  const auto buildNow = [this, &state, &cache,
+                         &source](const gleditor::LoadQueue::Deferred &page) {
+    auto built = Page::build(layoutFrom(source, page.start), state.glyphCache);
+    addToCache(cache.get(), page.index, built);
+    replacePlaceholder(state, page.index, page.start, std::move(built));
+  };
+
+  gleditor::PaginationHooks hooks;
+  hooks.layPage = [this, &state, &laid, &buildFrom,
+                   &source](const std::uint32_t start, const std::size_t slot) {
     // The same call a page uses to shape itself again once it has let its
     // layout go, so what a caret is placed against is what was drawn. These
     // were two copies of the same page setup until a page's layout became
     // something it could be without; two copies that had to agree exactly and
     // nothing to say so.
-    auto lay = layoutFrom(static_cast<std::uint32_t>(tSize));
-    // Measured before the layout is handed over, never after. newPage() queues
-    // the page onto the render thread and the layout goes with it, so from
-    // that call on it belongs to two threads at once -- and a Pango layout
-    // computes its lines lazily, so merely asking it a question mutates it.
-    // Reading it here means this thread does that work while it is still the
-    // only owner. The same measure the page itself will record, so that page
-    // N+1 starts exactly where page N stopped drawing.
+    const auto lay = layoutFrom(source, start);
+    // The same measure the page itself records, so that page N+1 starts
+    // exactly where page N stopped drawing.
     const auto consumed = consumedBytes(lay);
-    newPage(state, lay, static_cast<std::uint32_t>(tSize));
-    tSize += consumed;
+    // Built here, on this thread, rather than on the render thread: walking
+    // the clusters and rasterising glyphs is nearly all of what loading costs,
+    // and done there it took the frame rate down with it for as long as a
+    // document was loading. The layout never leaves this thread -- a Pango
+    // layout computes its lines lazily, so asking it anything mutates it, and
+    // two threads holding one crashed -- and is let go of when this returns.
+    //
+    // Unless the reader is looking further on, in which case all that is
+    // needed of this page now is where it stops.
+    laid[slot] = start >= buildFrom.load(std::memory_order_relaxed)
+                     ? Page::build(lay, state.glyphCache)
+                     : Page::Built{};
+    return consumed;
+  };
+  hooks.lines = [this, &source](const std::uint32_t from,
+                                const std::uint32_t to,
+                                std::vector<gleditor::PaginationLine> &out) {
+    wrapLines(source, from, to, out);
+  };
+  hooks.linesPerPage   = linesBeforeCut;
+  hooks.paragraphStart = [&source](const std::uint32_t offset) {
+    return paragraphStart(source, offset);
+  };
+  std::size_t deferred = 0;
+  hooks.accept = [&](const std::size_t slot, const std::uint32_t consumed) {
+    const auto index = static_cast<std::uint32_t>(starts.size());
+    const auto start = frontier;
+    starts.push_back(start);
+    frontier += consumed;
+    const auto remaining = source.size() - frontier;
+    const auto remainder = static_cast<std::uint32_t>(
+        (remaining + averageSpan() - 1) / averageSpan());
+    if (laid[slot].shaped) {
+      addToCache(cache.get(), index, laid[slot]);
+      newPage(std::move(laid[slot]), consumed, remainder);
+    } else {
+      newPage(Page::placeholder(consumed), consumed, remainder);
+      unbuilt.defer({.index = index, .start = start});
+      deferred++;
+    }
+
+    // What is in view cannot wait for the rest of the document. Built here,
+    // one at a time, which holds pagination up -- by a handful of pages, and
+    // only when the reader has looked somewhere pagination has already been.
+    const auto wanted = focus();
+    for (const auto &page : unbuilt.takeNear(wanted, buildReach)) {
+      buildNow(page);
+    }
+    // And the pages near what is in view further on are built as pagination
+    // reaches them, and the pages on the way there are not.
+    std::optional<std::uint32_t> ahead;
+    for (const auto page : wanted) {
+      if (page > index && (!ahead || page < *ahead)) {
+        ahead = page;
+      }
+    }
+    const auto pagesToGo =
+        ahead ? std::max(*ahead - index, buildReach + 1) - buildReach - 1 : 0U;
+    buildFrom.store(
+        static_cast<std::uint32_t>(std::min<std::size_t>(
+            frontier + (pagesToGo * averageSpan()), source.size())),
+        std::memory_order_relaxed);
+  };
+
+  const auto stats = gleditor::paginate(
+      static_cast<std::uint32_t>(source.size()), parallelism, hooks);
+  std::cout << std::format(
+      "paginated {} pages in {:.1f} ms on {} threads: {} rounds, {} pages "
+      "re-laid at seams, {} guesses discarded, {} left to build\n",
+      stats.pages,
+      std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - started)
+          .count(),
+      stats.threads, stats.rounds, stats.seamPages, stats.discarded,
+      unbuilt.size());
+
+  // Then the pages skipped on the way, several at a time and nearest the view
+  // first; the view is asked again after every batch, so a reader moving
+  // around while this runs is followed.
+  if (!unbuilt.empty()) {
+    render::WorkerPool workers(
+        std::max(1U, std::thread::hardware_concurrency()));
+    while (!unbuilt.empty()) {
+      const auto batch = unbuilt.take(workers.parallelism() * 2, focus());
+      std::vector<Page::Built> built(batch.size());
+      workers.run(static_cast<std::uint32_t>(batch.size()),
+                  [&](const std::uint32_t i) {
+                    built[i] = Page::build(layoutFrom(source, batch[i].start),
+                                           state.glyphCache);
+                  });
+      for (std::size_t i = 0; i < batch.size(); i++) {
+        addToCache(cache.get(), batch[i].index, built[i]);
+        replacePlaceholder(state, batch[i].index, batch[i].start,
+                           std::move(built[i]));
+      }
+    }
+    std::cout << std::format("built {} pages out of order in {:.1f} ms\n",
+                             deferred,
+                             std::chrono::duration<double, std::milli>(
+                                 std::chrono::steady_clock::now() - started)
+                                 .count());
   }
 
+  finishLoading(state, std::move(cache));
+}
+
+void Doc::finishLoading(RenderState &state,
+                        std::shared_ptr<gleditor::PageCacheWriter> cache) {
   // The document is as long as it is going to get without an edit, so the room
   // growth reserved beyond it can go back. Queued rather than done here: the
   // pool belongs to the render thread, which is still building the last pages
   // this loop handed it, and it is those pages that say how much is in use.
   auto self = getPtr();
-  renderer->run([self] { self->pool->trim(); });
+  renderer->run([self, &state, cache = std::move(cache)] {
+    // An edit while loading that changed how many pages there are leaves a
+    // placeholder's index naming some other page, so the build meant for it
+    // went elsewhere or nowhere. Whatever is still blank is built now.
+    for (std::size_t i = 0; i < self->pages.size(); i++) {
+      if (!self->pages[i].isShaped()) {
+        auto placed = pagePlacement(i);
+        self->pages[i] =
+            Page(self, placed,
+                 Page::build(self->layoutFrom(self->pages[i].baseOffset()),
+                             state.glyphCache),
+                 static_cast<std::uint32_t>(i), self->pages[i].allocation());
+      }
+    }
+    self->remainderPages = 0;
+    self->loading        = false;
+    self->loadText.reset();
+    if (!self->placeholderRow.empty()) {
+      self->pool->release(self->placeholderRow);
+      self->placeholderRow = {};
+    }
+    self->pool->trim();
+    // Published only for the text it was keyed on. An edit made while the
+    // pages were being built moved some of them, and those were written as
+    // they were built, not as they are now.
+    if (!cache) {
+      return;
+    }
+    const auto pages = static_cast<std::uint32_t>(self->pages.size());
+    if (0 == self->edits && cache->finish(pages)) {
+      std::cout << std::format("page cache: wrote {}\n",
+                               cache->path().string());
+    } else {
+      cache->abandon();
+    }
+  });
 }
 
-void Doc::newPage(RenderState &state, Glib::RefPtr<Pango::Layout> &layout,
-                  const std::uint32_t textOffset) {
-  renderer->run([this, &state, layout, textOffset] {
+void Doc::newPage(Page::Built &&built, const std::uint32_t consumed,
+                  const std::uint32_t remainder) {
+  // Shared rather than captured by value: the queue copies what it is given,
+  // and this is a page's worth of rows.
+  auto page = std::make_shared<Page::Built>(std::move(built));
+  renderer->run([this, page, consumed, remainder] {
     const auto numPages = this->pages.size();
-    // Pages are laid out in pixels and scaled here, so the stacking distance is
-    // in world units while everything inside the page is not.
-    glm::mat4 trans = glm::translate(
-        glm::mat4(1.0),
-        glm::vec3(0.0F, -100 * static_cast<float>(numPages), 0.0F));
-    trans = glm::scale(trans, glm::vec3(pixelsToWorld, pixelsToWorld, 1.0F));
-    pages.emplace_back(this->getPtr(), state, trans, layout, textOffset,
+    auto trans          = pagePlacement(numPages);
+    // Indexed before the page is committed, so that the page can already say
+    // where it starts.
+    pageStarts.push_back(consumed);
+    pages.emplace_back(this->getPtr(), trans, std::move(*page),
                        static_cast<std::uint32_t>(numPages));
+    if (0 != remainder && placeholderRow.empty()) {
+      placeholderRow = pool->reserve(1);
+      pool->write(placeholderRow, 0, asBytes(Page::placeholder(0).rows));
+    }
+    remainderPages = remainder;
   });
 }
+
+void Doc::replacePlaceholder(RenderState &state, const std::uint32_t index,
+                             const std::uint32_t start, Page::Built &&built) {
+  auto page = std::make_shared<Page::Built>(std::move(built));
+  auto self = getPtr();
+  renderer->run([self, &state, index, start, page] {
+    // An edit got there first: the page was rebuilt by the reflow, or there is
+    // no longer a page there at all.
+    if (index >= self->pages.size() || self->pages[index].isShaped()) {
+      return;
+    }
+    auto &stale = self->pages[index];
+    if (stale.baseOffset() != start) {
+      // An edit before it moved where it starts. Its own text is what it was,
+      // or the reflow would have rebuilt it, so it is laid out again from
+      // where it is now; rare, and one page.
+      *page = Page::build(self->layoutFrom(stale.baseOffset()),
+                          state.glyphCache);
+    }
+    auto placed = pagePlacement(index);
+    stale = Page(self, placed, std::move(*page), index, stale.allocation());
+  });
+}
+
+std::size_t Doc::deviceBytes() const {
+  return static_cast<std::size_t>(pool->capacityRows()) * pool->rowStride();
+}
+
+gleditor::ClusterMemory Doc::clusterMemory() const {
+  gleditor::ClusterMemory out;
+  for (const auto &page : pages) {
+    out.held += page.clusterBoxes().memoryBytes();
+    out.asBoxes += page.clusterBoxes().size() * sizeof(ClusterBox);
+  }
+  return out;
+}
+
+void Doc::evictionCandidates(
+    std::vector<gleditor::PageResidency::Candidate> &candidates,
+    std::vector<std::uint32_t> &indices) const {
+  if (loading) {
+    return;
+  }
+  for (std::size_t i = 0; i < pages.size(); i++) {
+    const auto &page = pages[i];
+    if (!page.isShaped() || !page.resident() || page.restorePending()) {
+      continue;
+    }
+    candidates.push_back(
+        {.bytes = static_cast<std::size_t>(pool->roomFor(page.allocation())) *
+                  pool->rowStride(),
+         .lastSeen = page.seenOn()});
+    indices.push_back(static_cast<std::uint32_t>(i));
+  }
+}
+
+void Doc::evict(const std::span<const std::uint32_t> indices) {
+  for (const auto index : indices) {
+    pages[index].evict();
+  }
+  // The rows given back are scattered through the buffer, where nothing but a
+  // page of this document can use them. Compacted, they collect at the end,
+  // and the device memory goes back rather than just the rows.
+  pool->compact();
+}
+
+std::shared_ptr<const gleditor::PieceTable::Snapshot>
+Doc::textSnapshot() const {
+  if (!snapshotTaken || snapshotEdits != edits) {
+    snapshotTaken =
+        std::make_shared<const gleditor::PieceTable::Snapshot>(text.snapshot());
+    snapshotEdits = edits;
+  }
+  return snapshotTaken;
+}
+
+std::vector<Doc::Restore> Doc::takeRestores() {
+  std::vector<Restore> wanted;
+  for (const auto index : wantedBack) {
+    // Renumbered by a reflow since it asked, or given its rows by one.
+    if (index >= pages.size() || pages[index].resident()) {
+      continue;
+    }
+    wanted.push_back({.index = index,
+                      .start = pages[index].baseOffset(),
+                      .bytes = pages[index].textLength(),
+                      .text  = textSnapshot()});
+  }
+  wantedBack.clear();
+  return wanted;
+}
+
+std::vector<Doc::Restore> Doc::takePrefetches() {
+  std::vector<Restore> wanted;
+  for (const auto index : wantedShaped) {
+    // Renumbered by a reflow since it asked, or shaped already.
+    if (index >= pages.size() || !pages[index].isShaped() ||
+        pages[index].hasLayout()) {
+      continue;
+    }
+    wanted.push_back({.index = index,
+                      .start = pages[index].baseOffset(),
+                      .bytes = pages[index].textLength(),
+                      .text  = textSnapshot()});
+  }
+  wantedShaped.clear();
+  return wanted;
+}
+
+void Doc::prefetchLayouts(const std::vector<Restore> &wanted,
+                          const std::uint64_t edited) {
+  auto self = getPtr();
+  for (const auto &prefetch : wanted) {
+    const auto started = std::chrono::steady_clock::now();
+    auto shaped        = layoutFrom(*prefetch.text, prefetch.start);
+    const std::chrono::nanoseconds cost =
+        std::chrono::steady_clock::now() - started;
+    // Handed over whole: filling the page has broken every line already, and
+    // nothing on this thread touches the layout once it is queued, so it is
+    // never held by two threads that both ask it things.
+    renderer->run([self, prefetch, edited, cost, shaped = std::move(shaped)] {
+      if (self->edits != edited || prefetch.index >= self->pages.size()) {
+        return;
+      }
+      const auto &page = self->pages[prefetch.index];
+      if (page.hasLayout() || page.baseOffset() != prefetch.start ||
+          page.textLength() != prefetch.bytes) {
+        return;
+      }
+      page.adoptLayout(shaped);
+      self->layouts.recordPrefetched();
+      self->keepLayoutOf(prefetch.index, cost);
+    });
+  }
+}
+
+void Doc::restorePages(RenderState &state, const std::vector<Restore> &wanted) {
+  auto self = getPtr();
+  for (const auto &restore : wanted) {
+    auto built = std::make_shared<Page::Built>(
+        Page::build(layoutFrom(*restore.text, restore.start),
+                    state.glyphCache));
+    renderer->run([self, &state, restore, built] {
+      if (restore.index >= self->pages.size()) {
+        return;
+      }
+      auto &page = self->pages[restore.index];
+      // An edit has been here since, which either built the page already or
+      // moved it; in the second case it asks again next time it is seen.
+      if (page.resident() || page.baseOffset() != restore.start ||
+          page.textLength() != restore.bytes) {
+        page.cancelRestore();
+        return;
+      }
+      auto placed = pagePlacement(restore.index);
+      page        = Page(self, placed, std::move(*built), restore.index);
+      state.residency.recordRestore();
+    });
+  }
+}
+
+void Doc::renderImpostors(RenderState &state,
+                          const std::vector<gleditor::ImpostorWant> &wanted) {
+  auto self = getPtr();
+  for (const auto &want : wanted) {
+    const auto scale  = gleditor::PageImpostors::scaleOf(want.step);
+    const auto width  = static_cast<int>(std::ceil(want.width * scale));
+    const auto height = static_cast<int>(std::ceil(want.height * scale));
+    auto image        = std::make_shared<gleditor::ImpostorImage>(
+        gleditor::ImpostorImage{.page   = want.page,
+                                .step   = want.step,
+                                .width  = static_cast<std::uint32_t>(width),
+                                .height = static_cast<std::uint32_t>(height),
+                                .coverage = {}});
+    if (0 < width && 0 < height) {
+      // Coverage alone, as the glyphs are: the pipeline mixes paper to ink by
+      // it, so the picture is in the page's own colours without holding them.
+      constexpr auto format = Cairo::Surface::Format::A8;
+      const auto stride =
+          Cairo::ImageSurface::format_stride_for_width(format, width);
+      std::vector<unsigned char> data(static_cast<std::size_t>(height) *
+                                      stride);
+      const auto surface = Cairo::ImageSurface::create(data.data(), format,
+                                                       width, height, stride);
+      const auto ctx     = Cairo::Context::create(surface);
+      // Bottom row first, as the atlas addresses them; see rasterise() in
+      // glyphcache/cache.cpp.
+      ctx->transform(Cairo::Matrix(1.0, 0.0, 0.0, -1.0, 0.0, height));
+      ctx->scale(scale, scale);
+      ctx->set_source_rgba(0, 0, 0, 1);
+
+      // Line by line, and only the lines the page holds: the layout is handed
+      // the rest of the document, as it is when the page is built.
+      const auto layout = layoutFrom(*want.text, want.start);
+      auto iter         = layout->get_iter();
+      do {
+        const auto line = iter.get_line();
+        if (!line || std::cmp_greater_equal(line->get_start_index(),
+                                            want.bytes)) {
+          break;
+        }
+        Pango::Rectangle ink;
+        Pango::Rectangle logical;
+        iter.get_line_extents(ink, logical);
+        ctx->move_to(pageMargin + toPixels(logical.get_x()),
+                     pageMargin + toPixels(iter.get_baseline()));
+        line->show_in_cairo_context(ctx);
+      } while (iter.next_line());
+      surface->flush();
+
+      image->coverage.resize(static_cast<std::size_t>(width) * height);
+      for (int row = 0; row < height; row++) {
+        std::memcpy(image->coverage.data() +
+                        (static_cast<std::size_t>(row) * width),
+                    data.data() + (static_cast<std::size_t>(row) * stride),
+                    static_cast<std::size_t>(width));
+      }
+    }
+    renderer->run([self, &state, image, edited = want.edited] {
+      if (self->edits != edited || image->coverage.empty()) {
+        state.impostors.abandon(image->page);
+        return;
+      }
+      state.impostors.install(std::move(*image));
+    });
+  }
+}
 // vi: set sw=2 sts=2 ts=2 et:
@@ -0,0 +1,39 @@
+/**
+ * @file edit_span.cpp
+ * @brief Merging edits into the range a reflow has to cover.
+ */
+#include <gleditor/edit_span.hpp> // IWYU pragma: associated
+
+#include <algorithm>
+#include <cstdint>
+
+namespace gleditor {
+
+EditSpan EditSpan::of(const std::uint32_t at, const std::uint32_t removed,
+                      const std::uint32_t inserted) {
+  return {.from  = at,
+          .to    = at + inserted,
+          .delta = static_cast<std::int64_t>(inserted) - removed,
+          .edits = 1};
+}
+
+void EditSpan::merge(const std::uint32_t at, const std::uint32_t removed,
+                     const std::uint32_t inserted) {
+  // Where the end of the disturbed range is now. Past what this edit removed
+  // it moves with the edit; inside it, it is swallowed, and the edit's own end
+  // stands in for it.
+  std::uint32_t end = to;
+  if (end >= at + removed) {
+    end = end - removed + inserted;
+  } else if (end > at) {
+    end = at;
+  }
+  from = std::min(from, at);
+  to   = std::max(end, at + inserted);
+  delta += static_cast<std::int64_t>(inserted) - removed;
+  edits++;
+}
+
+} // namespace gleditor
+
+// vi: set sw=2 sts=2 ts=2 et:
@@ -624,7 +624,8 @@ void Form::drawFrame(FrameContext &ctx) {
   const bool complaining = subheading != note;
 
   if (seen != builtFor || ctx.screenWidth != builtWidth ||
-      ctx.screenHeight != builtHeight) {
+      ctx.screenHeight != builtHeight ||
+      canvas->glyphsMoved(ctx.state.glyphCache)) {
     builtFor    = seen;
     builtWidth  = ctx.screenWidth;
     builtHeight = ctx.screenHeight;
@@ -0,0 +1,274 @@
+/**
+ * @file atlas_file.cpp
+ * @brief The on-disk form of the glyph atlas described in atlas_file.hpp.
+ *
+ * A file is a header, then the palettes, lanes, placements, fonts and glyphs
+ * as tables, then the names, then each palette's pixels. The header's counts
+ * are enough to find every table, and each palette says where its pixels are.
+ * Everything is 8-byte aligned, so a mapped file can be read in place.
+ */
+#include <gleditor/glyphcache/atlas_file.hpp> // IWYU pragma: associated
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+constexpr std::array<char, 8> magic{'G', 'L', 'E', 'D', 'A', 'T', 'L', 'S'};
+/// Bumped whenever the layout below changes.
+constexpr std::uint32_t formatVersion = 1;
+constexpr std::uint64_t alignment     = 8;
+
+struct FileHeader {
+  std::array<char, 8> magic{};
+  std::uint32_t version{};
+  std::uint32_t reserved{};
+  std::uint64_t settings{};
+  std::int32_t size{};
+  std::int32_t layers{};
+  std::uint32_t palettes{};
+  std::uint32_t lanes{};
+  std::uint32_t placements{};
+  std::uint32_t fonts{};
+  std::uint32_t glyphs{};
+  std::uint32_t nameBytes{};
+};
+
+static_assert(std::is_trivially_copyable_v<FileHeader>);
+static_assert(std::is_trivially_copyable_v<AtlasPaletteRecord>);
+static_assert(std::is_trivially_copyable_v<AtlasLaneRecord>);
+static_assert(std::is_trivially_copyable_v<AtlasPlacementRecord>);
+static_assert(std::is_trivially_copyable_v<AtlasFontRecord>);
+static_assert(std::is_trivially_copyable_v<AtlasGlyphRecord>);
+static_assert(0 == sizeof(FileHeader) % alignment);
+static_assert(0 == sizeof(AtlasPaletteRecord) % alignment);
+static_assert(0 == sizeof(AtlasLaneRecord) % alignment);
+static_assert(0 == sizeof(AtlasPlacementRecord) % alignment);
+static_assert(0 == sizeof(AtlasFontRecord) % alignment);
+static_assert(0 == sizeof(AtlasGlyphRecord) % alignment);
+
+std::uint64_t aligned(const std::uint64_t at) {
+  return (at + alignment - 1) / alignment * alignment;
+}
+
+/// Where each table starts, worked out from the header's counts alone, so
+/// that the writer and the reader cannot disagree.
+struct Offsets {
+  std::uint64_t palettes{};
+  std::uint64_t lanes{};
+  std::uint64_t placements{};
+  std::uint64_t fonts{};
+  std::uint64_t glyphs{};
+  std::uint64_t names{};
+  std::uint64_t images{};
+};
+
+Offsets offsetsOf(const FileHeader &header) {
+  Offsets at;
+  at.palettes   = sizeof(FileHeader);
+  at.lanes      = at.palettes + header.palettes * sizeof(AtlasPaletteRecord);
+  at.placements = at.lanes + header.lanes * sizeof(AtlasLaneRecord);
+  at.fonts =
+      at.placements + header.placements * sizeof(AtlasPlacementRecord);
+  at.glyphs = at.fonts + header.fonts * sizeof(AtlasFontRecord);
+  at.names  = at.glyphs + header.glyphs * sizeof(AtlasGlyphRecord);
+  at.images = aligned(at.names + header.nameBytes);
+  return at;
+}
+
+template <typename T>
+std::vector<T> copyOut(const std::string_view bytes, const std::uint64_t at,
+                       const std::uint32_t count) {
+  std::vector<T> items(count);
+  if (!items.empty()) {
+    std::memcpy(items.data(), bytes.data() + at, items.size() * sizeof(T));
+  }
+  return items;
+}
+
+template <typename T>
+void writeTable(std::ofstream &out, const std::vector<T> &items) {
+  out.write(reinterpret_cast<const char *>(items.data()),
+            static_cast<std::streamsize>(items.size() * sizeof(T)));
+}
+
+void pad(std::ofstream &out, const std::uint64_t bytes) {
+  constexpr std::array<char, alignment> padding{};
+  out.write(padding.data(),
+            static_cast<std::streamsize>(aligned(bytes) - bytes));
+}
+
+/// Whether @p at and @p bytes name a range of @p names.
+bool within(const std::uint32_t at, const std::uint32_t bytes,
+            const std::size_t names) {
+  return at <= names && bytes <= names - at;
+}
+
+/// Whether every record of @p atlas lies inside what it names.
+bool consistent(const AtlasFile &atlas) {
+  const std::int64_t size = atlas.size;
+  // Which palette holds each layer; a layer held twice is not an atlas.
+  std::unordered_map<std::int32_t, const AtlasPaletteRecord *> byLayer;
+  for (const auto &palette : atlas.palettes) {
+    if (palette.layer < 0 || palette.layer >= atlas.layers ||
+        palette.usedHeight < 0 || palette.usedHeight > size ||
+        palette.imageWidth < 0 || palette.imageWidth > size ||
+        !byLayer.try_emplace(palette.layer, &palette).second) {
+      return false;
+    }
+  }
+  for (const auto &lane : atlas.lanes) {
+    if (lane.palette >= atlas.palettes.size()) {
+      return false;
+    }
+    const auto &palette = atlas.palettes[lane.palette];
+    if (lane.yOffset < 0 || lane.height <= 0 ||
+        std::int64_t{lane.yOffset} + lane.height > palette.usedHeight ||
+        lane.usedWidth < 0 || lane.usedWidth > palette.imageWidth) {
+      return false;
+    }
+  }
+  for (const auto &placed : atlas.placements) {
+    const auto found = byLayer.find(placed.layer);
+    if (found == byLayer.end() || placed.x < 0 || placed.y < 0 ||
+        placed.width <= 0 || placed.height <= 0 ||
+        std::int64_t{placed.x} + placed.width > found->second->imageWidth ||
+        std::int64_t{placed.y} + placed.height > found->second->usedHeight) {
+      return false;
+    }
+  }
+  for (const auto &font : atlas.fonts) {
+    if (!within(font.nameAt, font.nameBytes, atlas.names.size())) {
+      return false;
+    }
+  }
+  for (const auto &glyph : atlas.glyphs) {
+    if (glyph.font >= atlas.fonts.size() ||
+        !within(glyph.keyAt, glyph.keyBytes, atlas.names.size()) ||
+        glyph.layer < 0 || glyph.layer >= atlas.layers ||
+        glyph.pixelWidth < 0 || glyph.pixelHeight < 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+bool writeAtlasFile(const std::filesystem::path &file, const AtlasFile &atlas,
+                    const std::uint64_t settings) {
+  if (atlas.images.size() != atlas.palettes.size()) {
+    return false;
+  }
+  std::error_code err;
+  std::filesystem::create_directories(file.parent_path(), err);
+  const std::filesystem::path temporary =
+      file.string() + "." + std::to_string(std::mt19937_64{
+                                std::random_device{}()}()) +
+      ".tmp";
+
+  const FileHeader header{
+      .magic      = magic,
+      .version    = formatVersion,
+      .settings   = settings,
+      .size       = atlas.size,
+      .layers     = atlas.layers,
+      .palettes   = static_cast<std::uint32_t>(atlas.palettes.size()),
+      .lanes      = static_cast<std::uint32_t>(atlas.lanes.size()),
+      .placements = static_cast<std::uint32_t>(atlas.placements.size()),
+      .fonts      = static_cast<std::uint32_t>(atlas.fonts.size()),
+      .glyphs     = static_cast<std::uint32_t>(atlas.glyphs.size()),
+      .nameBytes  = static_cast<std::uint32_t>(atlas.names.size())};
+  // The pixels follow one another from the end of the names, each palette
+  // told where its own start.
+  auto palettes = atlas.palettes;
+  auto imageAt  = offsetsOf(header).images;
+  for (std::size_t i = 0; i < palettes.size(); i++) {
+    palettes[i].imageAt = imageAt;
+    imageAt             = aligned(imageAt + atlas.images[i].size());
+  }
+
+  std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  writeTable(out, palettes);
+  writeTable(out, atlas.lanes);
+  writeTable(out, atlas.placements);
+  writeTable(out, atlas.fonts);
+  writeTable(out, atlas.glyphs);
+  out.write(atlas.names.data(),
+            static_cast<std::streamsize>(atlas.names.size()));
+  pad(out, atlas.names.size());
+  for (const auto image : atlas.images) {
+    out.write(reinterpret_cast<const char *>(image.data()),
+              static_cast<std::streamsize>(image.size()));
+    pad(out, image.size());
+  }
+  out.close();
+  auto ok = !out.fail();
+  if (ok) {
+    std::filesystem::rename(temporary, file, err);
+    ok = !err;
+  }
+  if (!ok) {
+    std::filesystem::remove(temporary, err);
+  }
+  return ok;
+}
+
+std::optional<AtlasFile> readAtlasFile(const std::string_view bytes,
+                                       const std::uint64_t settings) {
+  FileHeader header;
+  if (bytes.size() < sizeof(header)) {
+    return std::nullopt;
+  }
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  const auto at = offsetsOf(header);
+  if (header.magic != magic || formatVersion != header.version ||
+      settings != header.settings || header.size <= 0 || header.layers <= 0 ||
+      at.images > bytes.size()) {
+    return std::nullopt;
+  }
+
+  AtlasFile atlas;
+  atlas.size   = header.size;
+  atlas.layers = header.layers;
+  atlas.palettes =
+      copyOut<AtlasPaletteRecord>(bytes, at.palettes, header.palettes);
+  atlas.lanes = copyOut<AtlasLaneRecord>(bytes, at.lanes, header.lanes);
+  atlas.placements =
+      copyOut<AtlasPlacementRecord>(bytes, at.placements, header.placements);
+  atlas.fonts  = copyOut<AtlasFontRecord>(bytes, at.fonts, header.fonts);
+  atlas.glyphs = copyOut<AtlasGlyphRecord>(bytes, at.glyphs, header.glyphs);
+  atlas.names  = std::string(bytes.substr(at.names, header.nameBytes));
+  if (!consistent(atlas)) {
+    return std::nullopt;
+  }
+  const auto *const base = reinterpret_cast<const std::byte *>(bytes.data());
+  for (const auto &palette : atlas.palettes) {
+    const auto length = std::uint64_t{static_cast<std::uint32_t>(
+                            palette.imageWidth)} *
+                        static_cast<std::uint32_t>(palette.usedHeight);
+    if (palette.imageAt < at.images || palette.imageAt > bytes.size() ||
+        length > bytes.size() - palette.imageAt) {
+      return std::nullopt;
+    }
+    atlas.images.emplace_back(base + palette.imageAt, length);
+  }
+  return atlas;
+}
+
+// vi: set sw=2 sts=2 ts=2 et:
@@ -1,41 +1,51 @@
 /**
  * @file cache.cpp
- * @brief Implementation of the glyph cache: rasterization and texture packing.
+ * @brief Implementation of the glyph cache: texture packing and upload.
  *
- * Implements GlyphCache helpers to rasterize text via Pango/Cairo, manage the
- * device array texture, and pack glyphs into palettes and lanes.
+ * Implements GlyphCache helpers to manage the device array texture and pack
+ * glyphs into palettes and lanes. The drawing itself is raster.cpp's.
  */
 #include <gleditor/glyphcache/cache.hpp> // IWYU pragma: associated
 
-#include <algorithm>         // for min, sort
-#include <cairomm/context.h> // for Context
-#include <cairomm/surface.h> // for ImageSurface, Surface
-#include <cstddef>           // for byte
-#include <cstdlib>           // for getenv
+#include <algorithm>                           // for min, sort, copy_n, any_of
+#include <cstddef>                             // for byte
+#include <cstdint>                             // for uint32_t, uint64_t
+#include <cstdlib>                             // for getenv
+#include <filesystem>                          // for path
 #include <format>
-#include <gleditor/glyphcache/palette.hpp> // for GlyphPalette, operator<=>
-#include <gleditor/glyphcache/types.hpp>   // for TextureCoords, Rect
-#include <gleditor/render/device.hpp>      // for RenderDevice
-#include <iostream>                        // for basic_ostream, operator<<
-#include <memory>                          // for shared_ptr
-#include <numeric>                         // for format
-#include <optional>                        // for optional
-#include <ranges>                          // for find_if
-#include <span>                            // for span
-#include <stdexcept>                       // for invalid_argument, overflo...
-#include <string>                          // for char_traits, string, oper...
-#include <string_view>                     // for operator==, string_view
-#include <tuple>                           // for make_tuple, tuple
-#include <unordered_map>                   // for unordered_map, operator==
-#include <utility>                         // for to_underlying, move
-#include <vector>                          // for vector
-
-#include "cairomm/enums.h"       // for ANTIALIAS_SUBPIXEL, Antia...
-#include "cairomm/fontoptions.h" // for FontOptions
-#include "cairomm/matrix.h"      // for Matrix
-#include "glibmm/refptr.h"       // for RefPtr
-#include "pangomm/font.h"        // for Font
-#include "pangomm/layout.h"      // for Layout
+#include <functional>                          // for greater
+#include <gleditor/glyphcache/atlas_file.hpp>  // for AtlasFile, readAtlasFile
+#include <gleditor/glyphcache/glyph_table.hpp> // for GlyphTable
+#include <gleditor/glyphcache/lane.hpp>        // for GlyphLane
+#include <gleditor/glyphcache/palette.hpp>     // for GlyphPalette, operator<=>
+#include <gleditor/glyphcache/raster.hpp>      // for rasteriseKey, GlyphRaster
+#include <gleditor/glyphcache/types.hpp>       // for TextureCoords, Rect
+#include <gleditor/page_cache.hpp>             // for hashText
+#include <gleditor/render/device.hpp>          // for RenderDevice
+#include <gleditor/render/worker_pool.hpp>     // for WorkerPool
+#include <iostream>                            // for basic_ostream, operator<<
+#include <iterator>                            // for prev
+#include <limits>                              // for numeric_limits
+#include <map>                                 // for map
+#include <memory>                              // for shared_ptr
+#include <mutex>                               // for scoped_lock
+#include <numeric>                             // for format
+#include <optional>                            // for optional
+#include <ranges>                              // for find_if
+#include <span>                                // for span
+#include <stdexcept>                           // for invalid_argument, overf...
+#include <string>                              // for char_traits, string, op...
+#include <string_view>                         // for operator==, string_view
+#include <thread>                              // for hardware_concurrency
+#include <tuple>                               // for tuple
+#include <unordered_map>                       // for unordered_map, operator==
+#include <utility>                             // for to_underlying, move, cm...
+#include <vector>                              // for vector
+
+#include "glib.h"           // for g_mapped_file_new
+#include "glibmm/refptr.h"  // for RefPtr
+#include "glibmm/ustring.h" // for ustring
+#include "pangomm/font.h"   // for Font
 
 enum class Length : int;
 
@@ -115,47 +125,21 @@ std::vector<std::byte> withPadding(const std::span<const std::byte> coverage,
   return padded;
 }
 
-/**
- * @brief Convert a Cairo ARGB32 surface to tightly packed single-channel
- *        coverage.
- *
- * Every backend can upload an R8 rectangle identically, whereas asking the
- * driver to derive one channel from a BGRA upload is an OpenGL-specific
- * convenience that Vulkan has no equivalent for. Doing the narrowing here
- * keeps the device interface honest and the upload path the same everywhere.
- *
- * The glyph is drawn in opaque red on a transparent background, so in Cairo's
- * premultiplied ARGB32 the alpha byte already holds the coverage. On a
- * little-endian host the bytes of each pixel are ordered B, G, R, A.
- */
-std::vector<std::byte> toCoverage(const std::span<const unsigned char> surface,
-                                  const int width, const int height,
-                                  const int stride) {
-  std::vector<std::byte> coverage(static_cast<std::size_t>(width) *
-                                  static_cast<std::size_t>(height));
-  for (int row = 0; row < height; row++) {
-    const auto *src = surface.data() + static_cast<std::size_t>(row) *
-                                           static_cast<std::size_t>(stride);
-    auto *dst = coverage.data() +
-                static_cast<std::size_t>(row) * static_cast<std::size_t>(width);
-    for (int col = 0; col < width; col++) {
-      dst[col] = static_cast<std::byte>(src[(col * 4) + 3]);
-    }
-  }
-  return coverage;
-}
-
 } // namespace
 
-GlyphCache::GlyphCache(render::RenderDevice *aDevice) : device(aDevice) {
+GlyphCache::GlyphCache(render::RenderDevice *aDevice)
+    : ledger(std::make_shared<GlyphLedger>()), guard(ledger->guard),
+      device(aDevice) {
   const auto limits = device->textureLimits();
   // The hardware's ceiling is the ceiling. A device that reports less than the
   // opening size gets a smaller opening size, not an allocation it cannot
   // make; the one thing not allowed is zero, which no device means literally.
   maxSize    = std::max(1, limits.maxSize);
   maxLayers  = std::min(maxEncodableLayers, std::max(1, limits.maxLayers));
-  size       = std::min(openingAtlasSize(), maxSize);
-  layerCount = std::min(initialAtlasLayers, maxLayers);
+  size          = std::min(openingAtlasSize(), maxSize);
+  layerCount    = std::min(initialAtlasLayers, maxLayers);
+  plannedSize   = size;
+  plannedLayers = layerCount;
   std::cerr << std::format(
       "glyph cache: atlas {}x{} x{} layers, growing to at most {}x{} x{} "
       "(device allows {}x{} x{}, the vertex encoding {} layers)\n",
@@ -167,6 +151,7 @@ GlyphCache::GlyphCache(render::RenderDevice *aDevice) : device(aDevice) {
 }
 
 void GlyphCache::flush() {
+  commit();
   if (!atlasDirty || nullptr == device || !texture.valid()) {
     return;
   }
@@ -189,11 +174,11 @@ auto GlyphCache::getBestPalette(const Rect &charBox) {
       it != palettes.end()) {
     return it;
   }
-  if (palettes.size() < static_cast<unsigned long>(layerCount)) {
+  if (palettes.size() < static_cast<unsigned long>(plannedLayers)) {
     // Layers are handed out in creation order; the palette keeps its own index
     // so that sorting the vector cannot detach a palette from its layer.
-    palettes.emplace_back(Rect{Length{size}, Length{size}}, device, texture,
-                          static_cast<int>(palettes.size()));
+    palettes.emplace_back(Rect{Length{plannedSize}, Length{plannedSize}},
+                          device, texture, static_cast<int>(palettes.size()));
     // The sort moves the new palette somewhere unpredictable -- palettes with
     // equal fill compare equivalent and std::sort is not stable -- so look it
     // up again rather than assuming it is still the last element.
@@ -244,111 +229,318 @@ void GlyphCache::reallocate(const int newSize, const int newLayers) {
     device->updateTextureLayer(texture, placed.layer, placed.x, placed.y,
                                placed.width, placed.height, placed.coverage);
   }
+  uploaded   = placements.size();
   atlasDirty = true;
 }
 
+void GlyphCache::commit() {
+  const std::scoped_lock lock(guard);
+  // Whatever was handed out before this is fair game for eviction from the
+  // next commit on, unless something cites it.
+  ledger->clock++;
+  // A new texture is filled from every placement, reserved or not, so growing
+  // is the whole of the commit when it happens. A repack is a new texture at
+  // the same size: the old one has glyphs everywhere the new layout does not.
+  if (plannedSize != size || plannedLayers != layerCount ||
+      repacksPlanned != repacksDone) {
+    reallocate(plannedSize, plannedLayers);
+    repacksDone = repacksPlanned;
+    return;
+  }
+  for (; uploaded < placements.size(); uploaded++) {
+    const auto &placed = placements[uploaded];
+    device->updateTextureLayer(texture, placed.layer, placed.x, placed.y,
+                               placed.width, placed.height, placed.coverage);
+    atlasDirty = true;
+  }
+}
+
+std::uint64_t GlyphCache::repacks() const {
+  const std::scoped_lock lock(guard);
+  return repacksPlanned;
+}
+
+std::optional<std::uint64_t>
+GlyphCache::lookUp(const std::span<const std::uint32_t> glyphs,
+                   const std::span<Sizes> into) const {
+  const std::scoped_lock lock(guard);
+  if (repacksPlanned != repacksDone) {
+    return std::nullopt;
+  }
+  for (std::size_t i = 0; i < glyphs.size(); i++) {
+    const auto number = glyphs[i];
+    if (noGlyph == number || !held[number].live) {
+      into[i] = Sizes{};
+      continue;
+    }
+    into[i] = *cached(held[number].key, held[number].font);
+  }
+  return repacksDone;
+}
+
+std::uint32_t GlyphCache::numberGlyph(const std::uint32_t font,
+                                      const std::string_view key,
+                                      const std::size_t placement) {
+  auto &book = *ledger;
+  std::uint32_t number = 0;
+  if (freeNumbers.empty()) {
+    number = static_cast<std::uint32_t>(held.size());
+    held.emplace_back();
+    book.citations.push_back(0);
+    book.lastUsed.push_back(0);
+    book.citedBy.push_back(0);
+  } else {
+    number = freeNumbers.back();
+    freeNumbers.pop_back();
+  }
+  held[number]           = Held{font, std::string(key), placement, true};
+  book.citations[number] = 0;
+  book.lastUsed[number]  = book.clock;
+  book.citedBy[number]   = 0;
+  return number;
+}
+
+void GlyphCache::handOut(const std::uint32_t glyph, GlyphCitation *citing) {
+  if (noGlyph == glyph) {
+    return;
+  }
+  auto &book           = *ledger;
+  book.lastUsed[glyph] = book.clock;
+  if (nullptr == citing) {
+    return;
+  }
+  if (!citing->ledger) {
+    citing->ledger = ledger;
+    citing->serial = ++book.serials;
+  }
+  if (book.citedBy[glyph] == citing->serial) {
+    return;
+  }
+  book.citedBy[glyph] = citing->serial;
+  book.citations[glyph]++;
+  citing->glyphs.push_back(glyph);
+}
+
 void GlyphCache::makeRoomFor(const Rect &padded) {
   const auto needed = std::max(std::to_underlying(padded.width),
                                std::to_underlying(padded.height));
   while (true) {
     // A glyph wider or taller than a whole layer can only be housed by a
     // larger layer, however many layers there are.
-    if (needed <= size && palettes.end() != getBestPalette(padded)) {
+    if (needed <= plannedSize && palettes.end() != getBestPalette(padded)) {
       return;
     }
     // Size first: a layer twice as wide holds four times as much, where a
     // second layer only doubles it, and layers are the scarcer resource --
     // the vertex encoding allows a few dozen and the hardware allows a
-    // texture thousands of pixels across.
-    if (size < maxSize) {
-      reallocate(std::min(maxSize, size * 2), layerCount);
+    // texture thousands of pixels across. Only planned here: the palettes
+    // pack into the larger layer at once, and the texture catches up on the
+    // next commit(), however many doublings that turns out to be.
+    if (plannedSize < maxSize) {
+      plannedSize = std::min(maxSize, plannedSize * 2);
+      for (auto &palette : palettes) {
+        palette.grow(Rect{Length{plannedSize}, Length{plannedSize}}, texture);
+      }
       continue;
     }
     // Only when the glyph would fit a layer. A glyph too big for one is too
-    // big for a hundred, and reallocating anyway would copy the whole atlas
-    // into a larger one to no purpose before failing regardless.
-    if (needed <= size && layerCount < maxLayers) {
-      reallocate(size, std::min(maxLayers, layerCount * 2));
+    // big for a hundred, and growing anyway would copy the whole atlas into a
+    // larger one to no purpose before failing regardless.
+    if (needed <= plannedSize && plannedLayers < maxLayers) {
+      plannedLayers = std::min(maxLayers, plannedLayers * 2);
+      continue;
+    }
+    // At the ceiling: room has to come from glyphs nothing draws any more.
+    // Each pass evicts at least one, so this runs out rather than forever.
+    if (needed <= plannedSize && reclaim(padded)) {
       continue;
     }
     throw std::overflow_error(std::format(
         "GlyphCache: the atlas is full at {}x{} across {} layers, and a "
         "{}x{} glyph will not fit",
-        size, size, layerCount, std::to_underlying(padded.width),
-        std::to_underlying(padded.height)));
+        plannedSize, plannedSize, plannedLayers,
+        std::to_underlying(padded.width), std::to_underlying(padded.height)));
   }
 }
 
-inline Glib::RefPtr<Pango::Layout>
-getLayout(const std::string &chr, const FontPtr &font,
-          const Cairo::Surface::Format format) {
-  const auto tempSurf = Cairo::ImageSurface::create(format, 0, 0);
-  const auto ctx      = Cairo::Context::create(tempSurf);
-  auto layout         = Pango::Layout::create(ctx);
-  const auto desc     = font->describe_with_absolute_size();
-  layout->set_font_description(desc);
-  layout->set_text(chr);
-  return layout;
+namespace {
+
+/// The share of the atlas, as one over this, that eviction frees at a time:
+/// enough that the next many misses fit without another repack, and little
+/// enough that what a document drew a page ago is still there.
+constexpr std::size_t reclaimShare = 4;
+
+std::size_t areaOf(const int width, const int height) {
+  return static_cast<std::size_t>(width) * static_cast<std::size_t>(height);
+}
+
+} // namespace
+
+bool GlyphCache::reclaim(const Rect &padded) {
+  const auto &book = *ledger;
+  // Anything handed out since the last commit() may be in rows not yet
+  // built, whose builder never cited it; anything cited is in rows that draw.
+  std::vector<std::uint32_t> idle;
+  for (std::uint32_t number = 0; number < held.size(); number++) {
+    if (held[number].live && 0 == book.citations[number] &&
+        book.lastUsed[number] < book.clock) {
+      idle.push_back(number);
+    }
+  }
+  std::ranges::stable_sort(idle, {}, [&book](const std::uint32_t number) {
+    return book.lastUsed[number];
+  });
+
+  // Placements read back from a file with nothing filed under them go first,
+  // costing nothing.
+  std::vector<bool> dropped(placements.size(), false);
+  std::size_t freed = 0;
+  for (std::size_t i = 0; i < placements.size(); i++) {
+    if (noGlyph == placements[i].glyph) {
+      dropped[i] = true;
+      freed += areaOf(placements[i].width, placements[i].height);
+    }
+  }
+  const auto wanted =
+      std::max(areaOf(std::to_underlying(padded.width),
+                      std::to_underlying(padded.height)),
+               areaOf(plannedSize, plannedSize) *
+                   static_cast<std::size_t>(plannedLayers) / reclaimShare);
+  std::size_t evicted = 0;
+  for (; evicted < idle.size() && freed < wanted; evicted++) {
+    const auto at = held[idle[evicted]].placement;
+    dropped[at]   = true;
+    freed += areaOf(placements[at].width, placements[at].height);
+  }
+  if (0 == freed) {
+    return false;
+  }
+
+  // Tallest first, so that each lane is opened by the tallest glyph it will
+  // hold and the rest fill in beside it. Planned on palettes of its own: if
+  // the survivors do not fit, the atlas is left exactly as it was.
+  std::vector<std::size_t> order;
+  for (std::size_t i = 0; i < placements.size(); i++) {
+    if (!dropped[i]) {
+      order.push_back(i);
+    }
+  }
+  std::ranges::stable_sort(order, std::greater{}, [this](const std::size_t i) {
+    return std::pair{placements[i].height, placements[i].width};
+  });
+  const auto layerBox = Rect{Length{plannedSize}, Length{plannedSize}};
+  std::vector<GlyphPalette> packed;
+  // Layer, x and y, by placement.
+  std::vector<std::tuple<int, int, int>> moved(placements.size());
+  for (const auto i : order) {
+    const auto box = Rect{Length{placements[i].width},
+                          Length{placements[i].height}};
+    auto into      = std::ranges::find_if(
+        packed, [&box](GlyphPalette &pal) { return pal.canFit(box); });
+    if (into == packed.end()) {
+      if (std::cmp_greater_equal(packed.size(), plannedLayers)) {
+        return false;
+      }
+      packed.emplace_back(layerBox, device, texture,
+                          static_cast<int>(packed.size()));
+      into = std::prev(packed.end());
+    }
+    const auto placed = into->put(box, {});
+    if (!placed.has_value()) {
+      return false;
+    }
+    moved[i] = {into->layerIndex(), static_cast<int>(placed->topLeft.x),
+                static_cast<int>(placed->topLeft.y)};
+  }
+
+  // Taken up. Every survivor is written to the new texture by the next
+  // commit(), so the placements start again as not yet uploaded.
+  std::vector<Placement> kept;
+  kept.reserve(order.size());
+  for (const auto i : order) {
+    auto &placed = placements[i];
+    std::tie(placed.layer, placed.x, placed.y) = moved[i];
+    if (noGlyph != placed.glyph) {
+      auto &record     = held[placed.glyph];
+      record.placement = kept.size();
+      auto *const sizes = glyphs.find(record.font, record.key);
+      sizes->texCoords.topLeft =
+          PointF{static_cast<float>(placed.x + glyphPadding),
+                 static_cast<float>(placed.y + glyphPadding)};
+      sizes->layer = placed.layer;
+    }
+    kept.push_back(std::move(placed));
+  }
+  for (std::size_t i = 0; i < evicted; i++) {
+    auto &record = held[idle[i]];
+    glyphs.erase(record.font, record.key);
+    record = Held{};
+    freeNumbers.push_back(idle[i]);
+  }
+  std::cerr << std::format(
+      "glyph cache: atlas full at {}x{} x{}, evicted {} of {} glyphs and "
+      "repacked the rest\n",
+      plannedSize, plannedSize, plannedLayers, evicted,
+      held.size() - freeNumbers.size() + evicted);
+  placements = std::move(kept);
+  palettes   = std::move(packed);
+  std::ranges::sort(palettes);
+  uploaded = 0;
+  repacksPlanned++;
+  unsaved++;
+  return true;
 }
 
-inline std::tuple<int, int, int>
-getLayoutInfo(const Glib::RefPtr<Pango::Layout> &layout,
-              const Cairo::Surface::Format format) {
-  int width;
-  int height;
-  layout->get_pixel_size(width, height);
-  int stride = Cairo::ImageSurface::format_stride_for_width(format, width);
-  return std::make_tuple(width, height, stride);
+namespace {
+
+/// Misses below which a batch is drawn on the thread that asked: waking the
+/// pool costs more than a few glyphs do.
+constexpr std::size_t parallelMisses = 8;
+
+/// What an atlas file must have been written under to be taken up: how its
+/// glyphs were drawn, and how they were padded for the mip chain.
+std::uint64_t atlasSettings() {
+  return gleditor::hashText(rasterSettings(), std::format(" {} {}",
+                                                          glyphPadding,
+                                                          atlasMipLevels));
 }
 
-inline auto getFontOptions() {
-  Cairo::FontOptions opts;
-  opts.set_antialias(Cairo::Antialias::ANTIALIAS_SUBPIXEL);
-  opts.set_hint_metrics(Cairo::FontOptions::HintMetrics::ON);
-  opts.set_hint_style(Cairo::FontOptions::HintStyle::FULL);
-  return opts;
+static_assert(shapedKeyBytes(maxShapedGlyphs) <= GlyphCache::maxClusterBytes,
+              "a cluster shaped into as many glyphs as a key holds must fit "
+              "the key length the cache accepts");
+
+/// @throws std::invalid_argument when @p chr is too long to key on.
+void checkCluster(const std::string_view chr) {
+  // A whole shaped cluster is cached, not a single codepoint: a ligature or a
+  // base letter with its combining marks is one quad covering several
+  // characters, and rasterising only the first of them dropped the rest from
+  // the page. The bound is generous enough for emoji sequences joined by
+  // zero-width joiners, and exists only so that a pathological run cannot
+  // become a cache key.
+  if (chr.size() > GlyphCache::maxClusterBytes) {
+    throw std::invalid_argument(
+        std::format("GlyphCache: cluster of {} bytes exceeds the {}-byte limit",
+                    chr.size(), GlyphCache::maxClusterBytes));
+  }
 }
 
-GlyphCache::Sizes GlyphCache::addToCache(const std::string &chr,
-                                         const FontPtr &font) {
-  constexpr auto format = Cairo::Surface::Format::ARGB32;
-  const auto layout     = getLayout(chr, font, format);
+} // namespace
 
-  auto [width, height, stride] = getLayoutInfo(layout, format);
-  const auto extents           = Rect{Length{width}, Length{height}};
+GlyphCache::Sizes GlyphCache::addToCache(const std::string_view chr,
+                                         const std::uint32_t font,
+                                         const int width, const int height,
+                                         std::vector<std::byte> coverage) {
+  const auto extents = Rect{Length{width}, Length{height}};
 
   // A zero-area cluster -- an isolated newline, for instance -- has nothing to
   // rasterize, but still needs an entry so the caller can advance the pen.
   if (0 == width || 0 == height) {
-    const auto empty          = Sizes{TextureCoords{}, extents, 0, 0.0F};
-    glyphs[chr][keyFor(font)] = empty;
+    const auto empty = Sizes{TextureCoords{}, extents, 0, 0.0F};
+    glyphs.insert(font, chr, empty);
+    unsaved++;
     return empty;
   }
 
-  // create layout drawing context
-  std::vector<unsigned char> data(static_cast<long>(height) * stride);
-  const auto layoutSurf =
-      Cairo::ImageSurface::create(data.data(), format, width, height, stride);
-  const auto layCtx = Cairo::Context::create(layoutSurf);
-
-  // clear surface
-  layCtx->set_source_rgba(0, 0, 0, 0);
-  layCtx->rectangle(0, 0, width, height);
-  layCtx->fill();
-
-  // Flip the image vertically: texture rows are addressed from the bottom up,
-  // Cairo draws from the top down.
-  const Cairo::Matrix matrix(1.0, 0.0, 0.0, -1.0, 0.0, height);
-  layCtx->transform(matrix);
-  // draw text cluster
-  layCtx->set_source_rgba(1, 0, 0, 1);
-  layCtx->set_font_options(getFontOptions());
-  layout->show_in_cairo_context(layCtx);
-  // Cairo may still be holding drawing operations; flush before reading back.
-  layoutSurf->flush();
-
-  const auto coverage = toCoverage(data, width, height, stride);
-
   // The glyph goes into the atlas inside a zeroed border, so that the mip
   // chain averages it with empty space rather than with its neighbour. The
   // palette packs the padded box and knows nothing about the padding; the
@@ -363,16 +555,20 @@ GlyphCache::Sizes GlyphCache::addToCache(const std::string &chr,
         std::format("GlyphCache: no palette has room for glyph: {}", chr));
   }
   auto paddedCoverage = withPadding(coverage, width, height);
-  const auto placed   = palette->put(padded, paddedCoverage);
+  // Placed without being uploaded: the palette is given no bytes, and the
+  // upload waits for commit(), on the one thread allowed to make it.
+  const auto placed = palette->put(padded, {});
   if (!placed.has_value()) {
     throw std::overflow_error(
         std::format("GlyphCache: failed to place glyph: {}", chr));
   }
-  // Remembered so that growing the atlas can put it back exactly here.
+  // Remembered so that commit() can upload it, and so that growing the atlas
+  // can put it back exactly here.
+  const auto number = numberGlyph(font, chr, placements.size());
   placements.push_back(Placement{
       palette->layerIndex(), static_cast<int>(placed->topLeft.x),
       static_cast<int>(placed->topLeft.y), std::to_underlying(padded.width),
-      std::to_underlying(padded.height), std::move(paddedCoverage)});
+      std::to_underlying(padded.height), std::move(paddedCoverage), number});
 
   // Narrow the placed rectangle from the padded box to the glyph inside it.
   // Texels, so that growing the atlas leaves this glyph where it is; the
@@ -392,43 +588,372 @@ GlyphCache::Sizes GlyphCache::addToCache(const std::string &chr,
                       }) /
       (255.0 * static_cast<double>(coverage.size()));
 
-  const auto sizes =
-      Sizes{inner, extents, palette->layerIndex(), static_cast<float>(inked)};
-  // Level zero moved, so the chain below it is stale until it is rebuilt.
-  atlasDirty                = true;
-  glyphs[chr][keyFor(font)] = sizes;
+  const auto sizes = Sizes{inner, extents, palette->layerIndex(),
+                           static_cast<float>(inked), number};
+  glyphs.insert(font, chr, sizes);
+  unsaved++;
   return sizes;
 }
 
-const FontMapKeyAdapter &GlyphCache::keyFor(const FontPtr &font) {
-  const auto found = fontKeys.find(font.get());
-  if (found != fontKeys.end()) {
-    return found->second;
+std::uint32_t GlyphCache::internFont(const std::string &description) {
+  const auto [known, fresh] = fontIds.try_emplace(
+      description, static_cast<std::uint32_t>(fontNames.size()));
+  if (fresh) {
+    fontNames.push_back(description);
+  }
+  return known->second;
+}
+
+std::uint32_t GlyphCache::fontIdOf(const FontPtr &font) {
+  if (font.get() == lastFont) {
+    return lastFontId;
+  }
+  auto found = fontsByAddress.find(font.get());
+  if (found == fontsByAddress.end()) {
+    const auto id = internFont(
+        font->describe_with_absolute_size().to_string().casefold().raw());
+    found = fontsByAddress.emplace(font.get(), KnownFont{font, id}).first;
   }
-  return fontKeys.emplace(font.get(), FontMapKeyAdapter(font)).first->second;
+  lastFont   = font.get();
+  lastFontId = found->second.id;
+  return lastFontId;
+}
+
+const GlyphCache::Sizes *GlyphCache::cached(const std::string_view chr,
+                                            const std::uint32_t font) const {
+  return glyphs.find(font, chr);
 }
 
 GlyphCache::Sizes GlyphCache::put(const std::string_view &chr,
-                                  const FontPtr &font) {
-  // A whole shaped cluster is cached, not a single codepoint: a ligature or a
-  // base letter with its combining marks is one quad covering several
-  // characters, and rasterising only the first of them dropped the rest from
-  // the page. The bound is generous enough for emoji sequences joined by
-  // zero-width joiners, and exists only so that a pathological run cannot
-  // become a cache key.
-  if (chr.size() > maxClusterBytes) {
-    throw std::invalid_argument(
-        std::format("GlyphCache: cluster of {} bytes exceeds the {}-byte limit",
-                    chr.size(), maxClusterBytes));
-  }
-  if (const auto &chrToFontMap = glyphs.find(chr);
-      chrToFontMap != glyphs.cend()) {
-    if (const auto &fontMapToGlyphSizes =
-            chrToFontMap->second.find(keyFor(font));
-        fontMapToGlyphSizes != chrToFontMap->second.cend()) {
-      return fontMapToGlyphSizes->second;
+                                  const FontPtr &font,
+                                  GlyphCitation *const citing) {
+  const auto sizes = reserve(chr, font, citing);
+  commit();
+  return sizes;
+}
+
+GlyphCache::Sizes GlyphCache::reserve(const std::string_view &chr,
+                                      const FontPtr &font,
+                                      GlyphCitation *const citing) {
+  checkCluster(chr);
+  std::uint32_t id = 0;
+  {
+    const std::scoped_lock lock(guard);
+    id = fontIdOf(font);
+    if (const auto *const hit = cached(chr, id)) {
+      handOut(hit->glyph, citing);
+      return *hit;
     }
   }
-  return addToCache(std::string{chr}, font);
+  // Drawn without the lock, which is most of what a miss costs. Two threads
+  // missing on the same cluster at once both draw it, and the second finds
+  // the first's entry below and throws its own away.
+  std::string key{chr};
+  auto raster = rasteriseKey(key, rasterFontOf(font));
+  const std::scoped_lock lock(guard);
+  if (const auto *const hit = cached(chr, id)) {
+    handOut(hit->glyph, citing);
+    return *hit;
+  }
+  const auto sizes = addToCache(key, id, raster.width, raster.height,
+                                std::move(raster.coverage));
+  handOut(sizes.glyph, citing);
+  return sizes;
+}
+
+std::vector<GlyphCache::Sizes>
+GlyphCache::reserveAll(const std::span<const std::string_view> clusters,
+                       const FontPtr &font, GlyphCitation *const citing) {
+  for (const auto chr : clusters) {
+    checkCluster(chr);
+  }
+  std::vector<Sizes> out(clusters.size());
+  // Each distinct miss once, and which of them each cluster was.
+  constexpr auto hit = std::numeric_limits<std::size_t>::max();
+  std::vector<std::string> missed;
+  std::vector<std::size_t> missOf;
+  std::uint32_t id = 0;
+  {
+    const std::scoped_lock lock(guard);
+    id = fontIdOf(font);
+    std::unordered_map<std::string_view, std::size_t> seen;
+    for (std::size_t i = 0; i < clusters.size(); i++) {
+      if (const auto *const found = cached(clusters[i], id)) {
+        handOut(found->glyph, citing);
+        out[i] = *found;
+        continue;
+      }
+      if (missOf.empty()) {
+        missOf.assign(clusters.size(), hit);
+      }
+      const auto [at, fresh] = seen.try_emplace(clusters[i], missed.size());
+      if (fresh) {
+        missed.emplace_back(clusters[i]);
+      }
+      missOf[i] = at->second;
+    }
+  }
+  if (missed.empty()) {
+    return out;
+  }
+
+  auto drawn = rasterise(missed, font);
+  std::vector<Sizes> placed(missed.size());
+  {
+    // Packed under one hold of the lock, and uploaded by the next commit()
+    // with whatever else arrived since the last.
+    const std::scoped_lock lock(guard);
+    for (std::size_t i = 0; i < missed.size(); i++) {
+      if (const auto *const found = cached(missed[i], id)) {
+        placed[i] = *found;
+      } else {
+        placed[i] = addToCache(missed[i], id, drawn[i].width,
+                               drawn[i].height, std::move(drawn[i].coverage));
+      }
+      handOut(placed[i].glyph, citing);
+    }
+  }
+  for (std::size_t i = 0; i < clusters.size(); i++) {
+    if (hit != missOf[i]) {
+      out[i] = placed[missOf[i]];
+    }
+  }
+  return out;
+}
+
+bool GlyphCache::save(const std::filesystem::path &file) const {
+  const std::scoped_lock lock(guard);
+  if (0 == unsaved) {
+    return false;
+  }
+  AtlasFile atlas;
+  atlas.size   = plannedSize;
+  atlas.layers = plannedLayers;
+
+  // Each layer as high as its lanes reach and as wide as the widest of them:
+  // past that nothing has been packed, and the texture there is already
+  // clear.
+  std::vector<std::vector<std::byte>> images;
+  std::unordered_map<int, std::size_t> paletteOf;
+  for (const auto &palette : palettes) {
+    const auto index = static_cast<std::uint32_t>(atlas.palettes.size());
+    int width        = 0;
+    for (const auto &lane : palette.laneList()) {
+      atlas.lanes.push_back({.palette   = index,
+                             .yOffset   = std::to_underlying(lane.yOffset()),
+                             .height    = std::to_underlying(lane.height()),
+                             .usedWidth = std::to_underlying(lane.used())});
+      width = std::max(width, std::to_underlying(lane.used()));
+    }
+    const auto height = std::to_underlying(palette.used());
+    atlas.palettes.push_back({.layer      = palette.layerIndex(),
+                              .usedHeight = height,
+                              .imageWidth = width});
+    images.emplace_back(static_cast<std::size_t>(width) *
+                            static_cast<std::size_t>(height),
+                        std::byte{0});
+    paletteOf.emplace(palette.layerIndex(), index);
+  }
+  for (const auto &placed : placements) {
+    const auto index = paletteOf.at(placed.layer);
+    const auto width =
+        static_cast<std::size_t>(atlas.palettes[index].imageWidth);
+    auto &image = images[index];
+    for (int row = 0; row < placed.height; row++) {
+      std::copy_n(placed.coverage.data() +
+                      (static_cast<std::size_t>(row) * placed.width),
+                  placed.width,
+                  image.data() + ((placed.y + row) * width) + placed.x);
+    }
+    atlas.placements.push_back({.layer  = placed.layer,
+                                .x      = placed.x,
+                                .y      = placed.y,
+                                .width  = placed.width,
+                                .height = placed.height});
+  }
+
+  // Each font's index in the file, by the number this run filed it under;
+  // fingerprinted the first time one of its glyphs comes up.
+  constexpr auto unknown   = std::numeric_limits<std::uint32_t>::max();
+  constexpr auto unchecked = unknown - 1;
+  std::vector<std::uint32_t> fontOf(fontNames.size(), unchecked);
+  glyphs.forEach([&](const std::uint32_t font, const std::string_view key,
+                     const Sizes &sizes) {
+    auto &known = fontOf[font];
+    if (unchecked == known) {
+      known = unknown;
+      // By description, as restore() will check it: the font objects this
+      // run holds were loaded on whichever thread first asked.
+      const auto &name       = fontNames[font];
+      const auto fingerprint = fontFingerprint(name);
+      if (0 != fingerprint) {
+        known = static_cast<std::uint32_t>(atlas.fonts.size());
+        atlas.fonts.push_back(
+            {.fingerprint = fingerprint,
+             .nameAt      = static_cast<std::uint32_t>(atlas.names.size()),
+             .nameBytes   = static_cast<std::uint32_t>(name.size())});
+        atlas.names += name;
+      }
+    }
+    if (unknown == known) {
+      return;
+    }
+    atlas.glyphs.push_back(
+        {.keyAt       = static_cast<std::uint32_t>(atlas.names.size()),
+         .keyBytes    = static_cast<std::uint32_t>(key.size()),
+         .font        = known,
+         .layer       = sizes.layer,
+         .x           = sizes.texCoords.topLeft.x,
+         .y           = sizes.texCoords.topLeft.y,
+         .width       = sizes.texCoords.box.width,
+         .height      = sizes.texCoords.box.height,
+         .pixelWidth  = std::to_underlying(sizes.dims.width),
+         .pixelHeight = std::to_underlying(sizes.dims.height),
+         .ink         = sizes.ink});
+    atlas.names += key;
+  });
+
+  atlas.images.assign(images.begin(), images.end());
+  if (!writeAtlasFile(file, atlas, atlasSettings())) {
+    return false;
+  }
+  unsaved = 0;
+  return true;
+}
+
+bool GlyphCache::restore(const std::filesystem::path &file) {
+  GMappedFile *mapped = g_mapped_file_new(file.c_str(), FALSE, nullptr);
+  if (nullptr == mapped) {
+    return false;
+  }
+  const std::shared_ptr<GMappedFile> owner(mapped, g_mapped_file_unref);
+  const auto atlas =
+      readAtlasFile({g_mapped_file_get_contents(mapped),
+                     g_mapped_file_get_length(mapped)},
+                    atlasSettings());
+  // Layers are handed out in order, so the palettes have to be the first
+  // few: a gap would see getBestPalette() hand a held layer out again.
+  if (!atlas || atlas->size > maxSize || atlas->layers > maxLayers ||
+      std::ranges::any_of(atlas->palettes, [&](const auto &palette) {
+        return std::cmp_greater_equal(palette.layer, atlas->palettes.size());
+      })) {
+    return false;
+  }
+  // A font that has been updated, or that its description now finds in
+  // another file, draws its glyphs differently or names them by other IDs.
+  for (const auto &font : atlas->fonts) {
+    if (font.fingerprint !=
+        fontFingerprint(std::string(atlas->fontName(font)))) {
+      return false;
+    }
+  }
+
+  const std::scoped_lock lock(guard);
+  if (!placements.empty() || !glyphs.empty()) {
+    return false;
+  }
+  if (atlas->size != size || atlas->layers != layerCount) {
+    plannedSize   = atlas->size;
+    plannedLayers = atlas->layers;
+    reallocate(plannedSize, plannedLayers);
+  }
+
+  const auto layerBox = Rect{Length{size}, Length{size}};
+  std::vector<std::vector<GlyphLane>> lanes(atlas->palettes.size());
+  for (const auto &lane : atlas->lanes) {
+    lanes[lane.palette].emplace_back(
+        Offset{lane.yOffset}, Rect{Length{size}, Length{lane.height}},
+        Length{lane.usedWidth});
+  }
+  std::unordered_map<int, std::size_t> paletteOf;
+  palettes.clear();
+  for (std::size_t i = 0; i < atlas->palettes.size(); i++) {
+    const auto &record = atlas->palettes[i];
+    palettes.emplace_back(layerBox, device, texture, record.layer);
+    palettes.back().restore(std::move(lanes[i]));
+    paletteOf.emplace(record.layer, i);
+    // The one upload per layer: everything packed into it, in place.
+    if (!atlas->images[i].empty()) {
+      device->updateTextureLayer(texture, record.layer, 0, 0, record.imageWidth,
+                                 record.usedHeight, atlas->images[i]);
+    }
+  }
+  std::ranges::sort(palettes);
+
+  // Each glyph's own pixels are still kept, out of the layer they were read
+  // back in, for when the atlas grows and has to be filled again.
+  std::map<std::tuple<int, int, int>, std::size_t> placementAt;
+  for (const auto &placed : atlas->placements) {
+    const auto index = paletteOf.at(placed.layer);
+    const auto width =
+        static_cast<std::size_t>(atlas->palettes[index].imageWidth);
+    const auto image = atlas->images[index];
+    std::vector<std::byte> coverage(static_cast<std::size_t>(placed.width) *
+                                    static_cast<std::size_t>(placed.height));
+    for (int row = 0; row < placed.height; row++) {
+      std::copy_n(image.data() + ((placed.y + row) * width) + placed.x,
+                  placed.width,
+                  coverage.data() +
+                      (static_cast<std::size_t>(row) * placed.width));
+    }
+    placementAt.emplace(std::tuple{placed.layer, placed.x, placed.y},
+                        placements.size());
+    placements.push_back(Placement{placed.layer, placed.x, placed.y,
+                                   placed.width, placed.height,
+                                   std::move(coverage)});
+  }
+  uploaded = placements.size();
+
+  for (const auto &glyph : atlas->glyphs) {
+    const auto key = atlas->key(glyph);
+    const auto font =
+        internFont(std::string(atlas->fontName(atlas->fonts[glyph.font])));
+    // A key longer than the cache takes was not written by it.
+    if (key.size() > maxClusterBytes || nullptr != cached(key, font)) {
+      continue;
+    }
+    auto sizes =
+        Sizes{TextureCoords{PointF{glyph.x, glyph.y},
+                            RectF{glyph.width, glyph.height}},
+              Rect{Length{glyph.pixelWidth}, Length{glyph.pixelHeight}},
+              glyph.layer, glyph.ink};
+    // Numbered by the padded box its coordinates sit inside, so that it can
+    // be evicted and moved like any glyph drawn this run.
+    if (const auto at = placementAt.find(
+            std::tuple{glyph.layer, static_cast<int>(glyph.x) - glyphPadding,
+                       static_cast<int>(glyph.y) - glyphPadding});
+        0 != glyph.pixelWidth && 0 != glyph.pixelHeight &&
+        at != placementAt.end() && noGlyph == placements[at->second].glyph) {
+      sizes.glyph = numberGlyph(font, key, at->second);
+      placements[at->second].glyph = sizes.glyph;
+    }
+    glyphs.insert(font, key, sizes);
+  }
+  unsaved    = 0;
+  atlasDirty = true;
+  std::cerr << std::format(
+      "glyph cache: restored {} glyphs in {} fonts, {}x{} x{} layers, from "
+      "{}\n",
+      atlas->glyphs.size(), atlas->fonts.size(), size, size, layerCount,
+      file.string());
+  return true;
+}
+
+std::vector<GlyphRaster>
+GlyphCache::rasterise(const std::vector<std::string> &missed,
+                      const FontPtr &font) {
+  const auto raster = rasterFontOf(font);
+  // One batch at a time on the pool. A loader arriving while another has it
+  // draws its own batch on its own thread: loaders already run side by side,
+  // so that is parallel anyway.
+  std::unique_lock turn(rasterising, std::try_to_lock);
+  if (!turn.owns_lock() || missed.size() < parallelMisses) {
+    return rasteriseClusters(missed, raster, nullptr);
+  }
+  if (!rasterisers) {
+    rasterisers = std::make_unique<render::WorkerPool>(
+        std::max(1U, std::thread::hardware_concurrency()));
+  }
+  return rasteriseClusters(missed, raster, rasterisers.get());
 }
 // vi: set sw=2 sts=2 ts=2 et:
@@ -0,0 +1,28 @@
+/**
+ * @file citation.cpp
+ * @brief Letting go of cited glyphs.
+ */
+#include <gleditor/glyphcache/citation.hpp> // IWYU pragma: associated
+
+#include <mutex>
+
+void GlyphCitation::release() {
+  if (!ledger) {
+    return;
+  }
+  {
+    const std::scoped_lock lock(ledger->guard);
+    for (const auto glyph : glyphs) {
+      ledger->citations[glyph]--;
+      // Let go of now, so ranked behind everything long unused.
+      ledger->lastUsed[glyph] = ledger->clock;
+    }
+  }
+  glyphs.clear();
+  // A fresh serial next time: the old one may still be recorded against
+  // glyphs this no longer cites.
+  ledger.reset();
+  serial = 0;
+}
+
+// vi: set sw=2 sts=2 ts=2 et:
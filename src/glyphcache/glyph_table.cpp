@@ -0,0 +1,66 @@
+/**
+ * @file glyph_table.cpp
+ * @brief Comparing a group of control bytes at once, and the hash clusters
+ *        are filed under.
+ */
+#include <gleditor/glyphcache/glyph_table.hpp> // IWYU pragma: associated
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) &&        \
+    defined(__SSE2__)
+#define GLEDITOR_GLYPH_TABLE_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define GLEDITOR_GLYPH_TABLE_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace glyph_table {
+
+std::uint32_t matchControl(const std::uint8_t *const group,
+                           const std::uint8_t control) {
+#if defined(GLEDITOR_GLYPH_TABLE_X86)
+  const auto bytes =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+  return static_cast<std::uint32_t>(_mm_movemask_epi8(
+      _mm_cmpeq_epi8(bytes, _mm_set1_epi8(static_cast<char>(control)))));
+#elif defined(GLEDITOR_GLYPH_TABLE_NEON)
+  // NEON has no movemask: each matching lane keeps its own bit, and the two
+  // halves are summed across into a byte each.
+  static constexpr std::uint8_t weights[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+                                               1, 2, 4, 8, 16, 32, 64, 128};
+  const auto matched =
+      vandq_u8(vceqq_u8(vld1q_u8(group), vdupq_n_u8(control)),
+               vld1q_u8(weights));
+  return static_cast<std::uint32_t>(vaddv_u8(vget_low_u8(matched))) |
+         (static_cast<std::uint32_t>(vaddv_u8(vget_high_u8(matched))) << 8);
+#else
+  std::uint32_t bits = 0;
+  for (std::size_t i = 0; i < groupWidth; i++) {
+    bits |= static_cast<std::uint32_t>(group[i] == control) << i;
+  }
+  return bits;
+#endif
+}
+
+std::size_t hashCluster(const std::uint32_t font,
+                        const std::string_view cluster) {
+  // The library's string hash, with the font folded in and the whole mixed so
+  // that both the seven control bits at the bottom and the position above
+  // them depend on every byte: libstdc++'s hash is good in its high bits and
+  // the control byte is the low ones.
+  auto hash = std::hash<std::string_view>{}(cluster) ^
+              (static_cast<std::uint64_t>(font) * 0x9E3779B97F4A7C15ULL);
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDULL;
+  hash ^= hash >> 33;
+  return static_cast<std::size_t>(hash);
+}
+
+} // namespace glyph_table
+
+// vi: set sw=2 sts=2 ts=2 et:
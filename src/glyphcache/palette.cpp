@@ -4,7 +4,7 @@
  */
 #include <gleditor/glyphcache/palette.hpp> // IWYU pragma: associated
 
-#include <algorithm>                     // for sort
+#include <algorithm>                     // for max, sort
 #include <compare>                       // for strong_ordering, partial_or...
 #include <cstddef>                       // for byte
 #include <gleditor/glyphcache/lane.hpp>  // for GlyphLane, operator<=>
@@ -14,7 +14,7 @@
 #include <optional>                      // for optional, make_optional
 #include <ranges>                        // for find_if
 #include <span>                          // for span
-#include <utility>                       // for to_underlying
+#include <utility>                       // for to_underlying, move
 #include <vector>                        // for vector
 
 enum class Length : int;
@@ -82,6 +82,17 @@ void GlyphPalette::grow(const Rect &newDims,
   }
 }
 
+void GlyphPalette::restore(std::vector<GlyphLane> restored) {
+  lanes      = std::move(restored);
+  usedHeight = Length{};
+  for (const auto &lane : lanes) {
+    usedHeight = Length{std::max(std::to_underlying(usedHeight),
+                                 std::to_underlying(lane.yOffset()) +
+                                     std::to_underlying(lane.height()))};
+  }
+  std::ranges::sort(lanes);
+}
+
 [[nodiscard]] std::partial_ordering operator<=>(const GlyphPalette &left,
                                                 const GlyphPalette &right) {
   return right.usedHeight <=> left.usedHeight;
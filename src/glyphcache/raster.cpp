@@ -0,0 +1,376 @@
+/**
+ * @file raster.cpp
+ * @brief Drawing clusters into coverage, with each thread's Pango and Cairo
+ *        objects kept between glyphs.
+ *
+ * A shaped key is, after its marker, the box as two 16-bit pixel sizes and a
+ * 32-bit baseline in Pango units, then each glyph as a 32-bit ID and two
+ * 32-bit offsets, all in the host's byte order: a key is only read back on
+ * the machine that made it, from its own page cache.
+ */
+#include <gleditor/glyphcache/raster.hpp> // IWYU pragma: associated
+
+#include <algorithm>                       // for max
+#include <array>                           // for array
+#include <cairo.h>                         // for cairo_show_glyphs
+#include <cairomm/context.h>               // for Context
+#include <cairomm/surface.h>               // for ImageSurface
+#include <cstddef>                         // for byte
+#include <cstdint>                         // for uint32_t
+#include <cstring>                         // for memset
+#include <format>                          // for format
+#include <gleditor/page_cache.hpp>         // for hashText
+#include <gleditor/render/worker_pool.hpp> // for WorkerPool
+#include <hb.h>                            // for hb_face_reference_table
+#include <limits>                          // for numeric_limits
+#include <memory>                          // for shared_ptr
+#include <optional>                        // for optional
+#include <span>                            // for span
+#include <string>                          // for string
+#include <string_view>                     // for string_view
+#include <vector>                          // for vector
+
+#include "cairomm/enums.h"    // for ANTIALIAS_SUBPIXEL, Antia...
+#include "cairomm/matrix.h"   // for Matrix
+#include "glibmm/refptr.h"    // for RefPtr
+#include "pango/pangocairo.h" // for pango_cairo_font_get_scal...
+#include "pangomm/context.h"  // for Context
+#include "pangomm/layout.h"   // for Layout
+
+struct GlyphFace {
+  std::shared_ptr<cairo_font_face_t> face;
+  cairo_matrix_t matrix{};
+};
+
+namespace {
+
+constexpr auto format = Cairo::Surface::Format::ARGB32;
+
+constexpr char shapedMark = static_cast<char>(0xFF);
+
+/// A shaped key taken apart.
+struct Shaped {
+  int width{};
+  int height{};
+  int baseline{};
+  std::array<ShapedGlyph, maxShapedGlyphs> glyphs{};
+  std::size_t count{};
+};
+
+template <typename T> void put(std::string &out, const T value) {
+  out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T> T take(const std::string_view key, std::size_t &at) {
+  T value{};
+  std::memcpy(&value, key.data() + at, sizeof(value));
+  at += sizeof(value);
+  return value;
+}
+
+Shaped decode(const std::string_view key) {
+  Shaped shaped;
+  std::size_t at  = 1;
+  shaped.width    = take<std::uint16_t>(key, at);
+  shaped.height   = take<std::uint16_t>(key, at);
+  shaped.baseline = take<std::int32_t>(key, at);
+  while (at + shapedKeyBytes(1) - shapedKeyBytes(0) <= key.size() &&
+         shaped.count < maxShapedGlyphs) {
+    auto &glyph = shaped.glyphs[shaped.count++];
+    glyph.id    = take<std::uint32_t>(key, at);
+    glyph.x     = take<std::int32_t>(key, at);
+    glyph.y     = take<std::int32_t>(key, at);
+  }
+  return shaped;
+}
+
+/**
+ * @brief Convert a Cairo ARGB32 surface to tightly packed single-channel
+ *        coverage.
+ *
+ * Every backend can upload an R8 rectangle identically, whereas asking the
+ * driver to derive one channel from a BGRA upload is an OpenGL-specific
+ * convenience that Vulkan has no equivalent for. Doing the narrowing here
+ * keeps the device interface honest and the upload path the same everywhere.
+ *
+ * The glyph is drawn in opaque red on a transparent background, so in Cairo's
+ * premultiplied ARGB32 the alpha byte already holds the coverage. On a
+ * little-endian host the bytes of each pixel are ordered B, G, R, A.
+ */
+std::vector<std::byte> toCoverage(const unsigned char *surface, const int width,
+                                  const int height, const int stride) {
+  std::vector<std::byte> coverage(static_cast<std::size_t>(width) *
+                                  static_cast<std::size_t>(height));
+  for (int row = 0; row < height; row++) {
+    const auto *src =
+        surface + (static_cast<std::size_t>(row) *
+                   static_cast<std::size_t>(stride));
+    auto *dst = coverage.data() +
+                static_cast<std::size_t>(row) * static_cast<std::size_t>(width);
+    for (int col = 0; col < width; col++) {
+      dst[col] = static_cast<std::byte>(src[(col * 4) + 3]);
+    }
+  }
+  return coverage;
+}
+
+/**
+ * @brief What drawing a cluster needs besides the cluster, one per thread.
+ *
+ * The layout measures against a surface of no size, as it always has; only
+ * its text and font change from one glyph to the next. The surface drawn into
+ * is only ever replaced by a larger one, so after the first few glyphs of a
+ * font none is made at all -- a glyph is drawn into its corner, after that
+ * corner is cleared, and read back from it.
+ */
+struct Scratch {
+  Glib::RefPtr<Pango::Layout> layout;
+  std::optional<Pango::FontDescription> font;
+  Cairo::RefPtr<Cairo::ImageSurface> surface;
+  Cairo::RefPtr<Cairo::Context> context;
+  int width{};
+  int height{};
+};
+
+Scratch &scratch() {
+  thread_local Scratch held;
+  return held;
+}
+
+/// The calling thread's scratch, with its layout made.
+Scratch &withLayout() {
+  auto &held = scratch();
+  if (!held.layout) {
+    held.layout = Pango::Layout::create(
+        Cairo::Context::create(Cairo::ImageSurface::create(format, 0, 0)));
+  }
+  return held;
+}
+
+/**
+ * @brief The calling thread's scratch, with a surface at least @p width by
+ *        @p height and that corner of it cleared.
+ *
+ * Cleared by hand rather than by painting: only the corner the glyph is drawn
+ * in, and no drawing state to set up and put back for it.
+ */
+Scratch &surfaceFor(const int width, const int height) {
+  auto &held = scratch();
+  if (width > held.width || height > held.height) {
+    held.width   = std::max(width, held.width);
+    held.height  = std::max(height, held.height);
+    held.surface = Cairo::ImageSurface::create(format, held.width, held.height);
+    held.context = Cairo::Context::create(held.surface);
+    held.context->set_font_options(getFontOptions());
+    held.context->set_source_rgba(1, 0, 0, 1);
+  }
+  held.surface->flush();
+  auto *const pixels = held.surface->get_data();
+  const auto stride  = held.surface->get_stride();
+  for (int row = 0; row < height; row++) {
+    std::memset(pixels + (static_cast<std::size_t>(row) * stride), 0,
+                static_cast<std::size_t>(width) * 4);
+  }
+  held.surface->mark_dirty();
+  return held;
+}
+
+/// What was drawn into the corner surfaceFor() cleared, once Cairo has
+/// finished drawing it.
+GlyphRaster readBack(Scratch &held, const int width, const int height) {
+  // Cairo may still be holding drawing operations; flush before reading back.
+  held.surface->flush();
+  return GlyphRaster{width, height,
+                     toCoverage(held.surface->get_data(), width, height,
+                                held.surface->get_stride())};
+}
+
+/// Draw the glyphs @p key names from @p face.
+GlyphRaster rasteriseShaped(const std::string_view key,
+                            const GlyphFace *const face) {
+  const auto shaped = decode(key);
+  const auto width  = shaped.width;
+  const auto height = shaped.height;
+  if (0 == width || 0 == height) {
+    return GlyphRaster{width, height, {}};
+  }
+  if (nullptr == face) {
+    return GlyphRaster{width, height,
+                       std::vector<std::byte>(
+                           static_cast<std::size_t>(width) *
+                           static_cast<std::size_t>(height))};
+  }
+
+  std::array<cairo_glyph_t, maxShapedGlyphs> glyphs{};
+  for (std::size_t i = 0; i < shaped.count; i++) {
+    const auto &glyph = shaped.glyphs[i];
+    glyphs[i]         = cairo_glyph_t{
+        glyph.id, static_cast<double>(glyph.x) / PANGO_SCALE,
+        static_cast<double>(shaped.baseline + glyph.y) / PANGO_SCALE};
+  }
+
+  auto &held = surfaceFor(width, height);
+  // Flipped as text is below, and the font set inside the same save, so the
+  // next glyph starts from the context as it was made.
+  held.context->save();
+  held.context->transform(Cairo::Matrix(1.0, 0.0, 0.0, -1.0, 0.0, height));
+  auto *const cairo = held.context->cobj();
+  cairo_set_font_face(cairo, face->face.get());
+  cairo_set_font_matrix(cairo, &face->matrix);
+  cairo_show_glyphs(cairo, glyphs.data(), static_cast<int>(shaped.count));
+  held.context->restore();
+  return readBack(held, width, height);
+}
+
+} // namespace
+
+bool isShapedKey(const std::string_view key) {
+  return key.size() >= shapedKeyBytes(0) && shapedMark == key.front() &&
+         0 == (key.size() - shapedKeyBytes(0)) %
+                  (shapedKeyBytes(1) - shapedKeyBytes(0));
+}
+
+bool appendShapedKey(std::string &key, const int width, const int height,
+                     const int baseline,
+                     const std::span<const ShapedGlyph> glyphs) {
+  if (glyphs.size() > maxShapedGlyphs) {
+    return false;
+  }
+  constexpr int most = std::numeric_limits<std::uint16_t>::max();
+  key.push_back(shapedMark);
+  put(key, static_cast<std::uint16_t>(std::clamp(width, 0, most)));
+  put(key, static_cast<std::uint16_t>(std::clamp(height, 0, most)));
+  put(key, static_cast<std::int32_t>(baseline));
+  for (const auto &glyph : glyphs) {
+    put(key, glyph.id);
+    put(key, glyph.x);
+    put(key, glyph.y);
+  }
+  return true;
+}
+
+RasterFont rasterFontOf(const Glib::RefPtr<Pango::Font> &font) {
+  RasterFont raster{font->describe_with_absolute_size(), nullptr};
+  auto *const pango = font->gobj();
+  if (!PANGO_IS_CAIRO_FONT(pango)) {
+    return raster;
+  }
+  auto *const scaled =
+      pango_cairo_font_get_scaled_font(PANGO_CAIRO_FONT(pango));
+  if (nullptr == scaled ||
+      CAIRO_STATUS_SUCCESS != cairo_scaled_font_status(scaled)) {
+    return raster;
+  }
+  auto face  = std::make_shared<GlyphFace>();
+  face->face = std::shared_ptr<cairo_font_face_t>(
+      cairo_font_face_reference(cairo_scaled_font_get_font_face(scaled)),
+      cairo_font_face_destroy);
+  cairo_scaled_font_get_font_matrix(scaled, &face->matrix);
+  raster.face = std::move(face);
+  return raster;
+}
+
+Cairo::FontOptions getFontOptions() {
+  Cairo::FontOptions opts;
+  opts.set_antialias(Cairo::Antialias::ANTIALIAS_SUBPIXEL);
+  opts.set_hint_metrics(Cairo::FontOptions::HintMetrics::ON);
+  opts.set_hint_style(Cairo::FontOptions::HintStyle::FULL);
+  return opts;
+}
+
+std::uint64_t rasterSettings() {
+  const auto options = getFontOptions();
+  return gleditor::hashText(
+      gleditor::textHashSeed,
+      std::format("{} {} {}", cairo_font_options_hash(options.cobj()),
+                  pango_version_string(), cairo_version_string()));
+}
+
+std::uint64_t fontFingerprint(const Glib::RefPtr<Pango::Font> &font) {
+  if (!font) {
+    return 0;
+  }
+  auto *const harfbuzz = pango_font_get_hb_font(font->gobj());
+  if (nullptr == harfbuzz) {
+    return 0;
+  }
+  auto *const face = hb_font_get_face(harfbuzz);
+  auto *const head = hb_face_reference_table(face, HB_TAG('h', 'e', 'a', 'd'));
+  unsigned int length    = 0;
+  const char *const data = hb_blob_get_data(head, &length);
+  std::string print(nullptr == data ? "" : std::string_view(data, length));
+  hb_blob_destroy(head);
+  if (print.empty()) {
+    return 0;
+  }
+  print += std::format(" {}", hb_face_get_glyph_count(face));
+  if (auto *const pango = font->gobj(); PANGO_IS_CAIRO_FONT(pango)) {
+    auto *const scaled =
+        pango_cairo_font_get_scaled_font(PANGO_CAIRO_FONT(pango));
+    if (nullptr != scaled) {
+      auto *const options = cairo_font_options_create();
+      cairo_scaled_font_get_font_options(scaled, options);
+      print += std::format(" {}", cairo_font_options_hash(options));
+      cairo_font_options_destroy(options);
+    }
+  }
+  return gleditor::hashText(gleditor::textHashSeed, print);
+}
+
+std::uint64_t fontFingerprint(const std::string &description) {
+  return fontFingerprint(withLayout().layout->get_context()->load_font(
+      Pango::FontDescription(description)));
+}
+
+GlyphRaster rasteriseCluster(const std::string &chr,
+                             const Pango::FontDescription &font) {
+  auto &held = withLayout();
+  // Set only when it changes, which within a page is never: setting it throws
+  // away whatever the layout had worked out about the font.
+  if (!held.font || !(*held.font == font)) {
+    held.layout->set_font_description(font);
+    held.font = font;
+  }
+  held.layout->set_text(chr);
+
+  int width  = 0;
+  int height = 0;
+  held.layout->get_pixel_size(width, height);
+  if (0 == width || 0 == height) {
+    return GlyphRaster{width, height, {}};
+  }
+
+  surfaceFor(width, height);
+  // Flip the image vertically: texture rows are addressed from the bottom up,
+  // Cairo draws from the top down.
+  held.context->save();
+  held.context->transform(Cairo::Matrix(1.0, 0.0, 0.0, -1.0, 0.0, height));
+  held.layout->show_in_cairo_context(held.context);
+  held.context->restore();
+  return readBack(held, width, height);
+}
+
+GlyphRaster rasteriseKey(const std::string &key, const RasterFont &font) {
+  if (isShapedKey(key)) {
+    return rasteriseShaped(key, font.face.get());
+  }
+  return rasteriseCluster(key, font.description);
+}
+
+std::vector<GlyphRaster>
+rasteriseClusters(const std::span<const std::string> keys,
+                  const RasterFont &font, render::WorkerPool *const workers) {
+  std::vector<GlyphRaster> drawn(keys.size());
+  const auto draw = [&](const std::uint32_t i) {
+    drawn[i] = rasteriseKey(keys[i], font);
+  };
+  if (nullptr == workers || keys.size() < 2) {
+    for (std::uint32_t i = 0; i < keys.size(); i++) {
+      draw(i);
+    }
+    return drawn;
+  }
+  workers->run(static_cast<std::uint32_t>(keys.size()), draw);
+  return drawn;
+}
+// vi: set sw=2 sts=2 ts=2 et:
@@ -0,0 +1,165 @@
+/**
+ * @file impostor_atlas.cpp
+ * @brief Finding a cell for a page's picture, and letting pictures go.
+ */
+#include <gleditor/impostor_atlas.hpp> // IWYU pragma: associated
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace gleditor {
+
+ImpostorAtlas::ImpostorAtlas(const std::uint32_t layerSize,
+                             const std::uint32_t aMaxLayers)
+    : size(std::max(layerSize, minCell)), maxLayers(aMaxLayers) {}
+
+std::optional<ImpostorSlot> ImpostorAtlas::find(const std::uint64_t page,
+                                                const std::int32_t step) {
+  const auto found = held.find(page);
+  if (held.end() == found || found->second.step != step) {
+    return std::nullopt;
+  }
+  found->second.used = ++clock;
+  return found->second.slot;
+}
+
+void ImpostorAtlas::cut(Layer &layer, const std::uint32_t width,
+                        const std::uint32_t height) const {
+  layer.cellWidth  = width;
+  layer.cellHeight = height;
+  layer.cells.assign(static_cast<std::size_t>(size / width) * (size / height),
+                     std::nullopt);
+}
+
+template <typename Among>
+std::optional<std::uint64_t>
+ImpostorAtlas::leastRecent(const Among among) const {
+  std::optional<std::uint64_t> oldest;
+  std::uint64_t oldestUsed = 0;
+  for (const auto &[page, entry] : held) {
+    if (among(entry) && (!oldest || entry.used < oldestUsed)) {
+      oldest     = page;
+      oldestUsed = entry.used;
+    }
+  }
+  return oldest;
+}
+
+void ImpostorAtlas::release(const std::uint64_t page, const bool evicted) {
+  const auto found = held.find(page);
+  if (held.end() == found) {
+    return;
+  }
+  layers[found->second.slot.layer].cells[found->second.cell].reset();
+  freeRows.push_back(found->second.slot.row);
+  held.erase(found);
+  if (evicted) {
+    counts.evictions++;
+  }
+}
+
+void ImpostorAtlas::forget(const std::uint64_t page) { release(page, false); }
+
+std::optional<ImpostorSlot>
+ImpostorAtlas::place(const std::uint64_t page, const std::int32_t step,
+                     const std::uint32_t width, const std::uint32_t height) {
+  if (0 == width || 0 == height || width > size || height > size ||
+      0 == maxLayers) {
+    return std::nullopt;
+  }
+  release(page, false);
+  const auto cellWidth  = std::bit_ceil(std::max(width, minCell));
+  const auto cellHeight = std::bit_ceil(std::max(height, minCell));
+  const auto fits       = [&](const Layer &layer) {
+    return layer.cellWidth == cellWidth && layer.cellHeight == cellHeight;
+  };
+
+  const auto freeCell = [&]() -> std::optional<std::pair<std::size_t,
+                                                         std::size_t>> {
+    for (std::size_t l = 0; l < layers.size(); l++) {
+      if (!fits(layers[l])) {
+        continue;
+      }
+      const auto cell = std::ranges::find_if(
+          layers[l].cells, [](const auto &holder) { return !holder; });
+      if (layers[l].cells.end() != cell) {
+        return std::pair{l, static_cast<std::size_t>(
+                                cell - layers[l].cells.begin())};
+      }
+    }
+    return std::nullopt;
+  };
+
+  auto at = freeCell();
+  if (!at && layers.size() < maxLayers) {
+    cut(layers.emplace_back(), cellWidth, cellHeight);
+    at = std::pair{layers.size() - 1, std::size_t{0}};
+  }
+  if (!at) {
+    // A picture from a layer already cut to this size frees a cell that fits.
+    const auto same = leastRecent(
+        [&](const Held &entry) { return fits(layers[entry.slot.layer]); });
+    if (same) {
+      release(*same, true);
+      at = freeCell();
+    }
+  }
+  if (!at) {
+    // None is, so a layer is cut afresh: one holding nothing if there is one,
+    // and otherwise that of the picture used least recently, whatever else
+    // was in it going too.
+    const auto empty = std::ranges::find_if(layers, [](const Layer &cutUp) {
+      return std::ranges::none_of(cutUp.cells, [](const auto &holder) {
+        return holder.has_value();
+      });
+    });
+    auto layer = static_cast<std::size_t>(empty - layers.begin());
+    if (layers.end() == empty) {
+      const auto oldest = leastRecent([](const Held &) { return true; });
+      if (!oldest) {
+        return std::nullopt;
+      }
+      layer = held.at(*oldest).slot.layer;
+      for (const auto &cell : layers[layer].cells) {
+        if (cell) {
+          release(*cell, true);
+        }
+      }
+    }
+    cut(layers[layer], cellWidth, cellHeight);
+    at = std::pair{layer, std::size_t{0}};
+  }
+
+  const auto [layerIndex, cell] = *at;
+  auto &layer                   = layers[layerIndex];
+  const auto columns            = size / layer.cellWidth;
+  std::uint32_t row             = nextRow;
+  if (freeRows.empty()) {
+    nextRow++;
+  } else {
+    row = freeRows.back();
+    freeRows.pop_back();
+  }
+  const ImpostorSlot slot{
+      .layer  = static_cast<std::uint32_t>(layerIndex),
+      .x      = static_cast<std::uint32_t>(cell % columns) * layer.cellWidth,
+      .y      = static_cast<std::uint32_t>(cell / columns) * layer.cellHeight,
+      .width  = width,
+      .height = height,
+      .row    = row};
+  layer.cells[cell] = page;
+  held[page]        = Held{.slot  = slot,
+                           .step  = step,
+                           .cell  = static_cast<std::uint32_t>(cell),
+                           .used  = ++clock};
+  counts.placed++;
+  return slot;
+}
+
+} // namespace gleditor
+
+// vi: set sw=2 sts=2 ts=2 et:
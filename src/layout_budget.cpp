@@ -0,0 +1,72 @@
+/**
+ * @file layout_budget.cpp
+ * @brief Choosing which pages let their shaping go.
+ */
+#include <gleditor/layout_budget.hpp> // IWYU pragma: associated
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace gleditor {
+
+std::vector<std::uint32_t>
+LayoutBudget::keep(const std::uint32_t page, const std::size_t bytes,
+                   const std::chrono::nanoseconds cost) {
+  forget(page);
+  const auto size = std::max<std::size_t>(bytes, 1);
+  double perByte  = 0;
+  if (0 < cost.count()) {
+    measuredCost += cost;
+    measuredBytes += size;
+    perByte = static_cast<double>(cost.count()) / static_cast<double>(size);
+  } else if (0 != measuredBytes) {
+    perByte = static_cast<double>(measuredCost.count()) /
+              static_cast<double>(measuredBytes);
+  }
+  held[page] = {
+      .bytes = size, .costPerByte = perByte, .credit = floor + perByte};
+  total += size;
+
+  std::vector<std::uint32_t> chosen;
+  while (total > budget && held.size() > 1) {
+    // Linear, and there are tens of these: a heap would have to be repaired
+    // on every touch, which is far more frequent than an eviction.
+    auto victim = held.end();
+    for (auto it = held.begin(); it != held.end(); ++it) {
+      // Ties go to the earlier page, so that the order is the same from one
+      // run to the next whatever the map's.
+      if (it->first != page &&
+          (held.end() == victim || it->second.credit < victim->second.credit ||
+           (it->second.credit == victim->second.credit &&
+            it->first < victim->first))) {
+        victim = it;
+      }
+    }
+    floor = std::max(floor, victim->second.credit);
+    total -= victim->second.bytes;
+    chosen.push_back(victim->first);
+    held.erase(victim);
+  }
+  counts.evictions += chosen.size();
+  return chosen;
+}
+
+void LayoutBudget::touch(const std::uint32_t page) {
+  if (const auto found = held.find(page); held.end() != found) {
+    found->second.credit = floor + found->second.costPerByte;
+  }
+}
+
+void LayoutBudget::forget(const std::uint32_t page) {
+  if (const auto found = held.find(page); held.end() != found) {
+    total -= found->second.bytes;
+    held.erase(found);
+  }
+}
+
+} // namespace gleditor
+
+// vi: set sw=2 sts=2 ts=2 et:
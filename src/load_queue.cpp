@@ -0,0 +1,72 @@
+/**
+ * @file load_queue.cpp
+ * @brief Ordering a loading document's unbuilt pages by what is in view.
+ */
+#include <gleditor/load_queue.hpp> // IWYU pragma: associated
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <span>
+#include <vector>
+
+namespace gleditor {
+
+std::vector<LoadQueue::Deferred>
+LoadQueue::take(const std::size_t count,
+                const std::span<const std::uint32_t> focus) {
+  std::vector<Deferred> taken;
+  while (taken.size() < count && !waiting.empty()) {
+    // The waiting page nearest any focus is either the first at or after it or
+    // the last before it, so each focus costs two lookups whatever is queued.
+    auto best         = waiting.begin();
+    auto bestDistance = std::numeric_limits<std::uint32_t>::max();
+    for (const auto wanted : focus) {
+      const auto after = waiting.lower_bound(wanted);
+      const auto consider = [&](const decltype(after) candidate) {
+        const auto distance = candidate->first < wanted
+                                  ? wanted - candidate->first
+                                  : candidate->first - wanted;
+        if (distance < bestDistance ||
+            (distance == bestDistance && candidate->first < best->first)) {
+          best         = candidate;
+          bestDistance = distance;
+        }
+      };
+      if (after != waiting.end()) {
+        consider(after);
+      }
+      if (after != waiting.begin()) {
+        consider(std::prev(after));
+      }
+    }
+    taken.push_back({.index = best->first, .start = best->second});
+    waiting.erase(best);
+  }
+  return taken;
+}
+
+std::vector<LoadQueue::Deferred>
+LoadQueue::takeNear(const std::span<const std::uint32_t> focus,
+                    const std::uint32_t reach) {
+  std::vector<Deferred> taken;
+  for (const auto wanted : focus) {
+    const auto from = wanted < reach ? 0U : wanted - reach;
+    const auto to   = wanted > std::numeric_limits<std::uint32_t>::max() - reach
+                          ? std::numeric_limits<std::uint32_t>::max()
+                          : wanted + reach;
+    auto at = waiting.lower_bound(from);
+    while (at != waiting.end() && at->first <= to) {
+      taken.push_back({.index = at->first, .start = at->second});
+      at = waiting.erase(at);
+    }
+  }
+  std::ranges::sort(taken, {}, &Deferred::index);
+  return taken;
+}
+
+} // namespace gleditor
+
+// vi: set sw=2 sts=2 ts=2 et:
@@ -0,0 +1,325 @@
+/**
+ * @file page_cache.cpp
+ * @brief The on-disk form of built pages described in page_cache.hpp.
+ *
+ * A file is a header, then each page's rows, clusters, paragraphs and glyph
+ * keys in the order the pages were built, then a table saying where each
+ * page's are. The table goes last because the pages arrive out of order and
+ * the writer never holds more than one of them; the header, written last of
+ * all, says where it is. Everything is 8-byte aligned, so a mapped file can be
+ * read in place.
+ */
+#include <gleditor/page_cache.hpp> // IWYU pragma: associated
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <ios>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include <gleditor/page_paragraphs.hpp>
+
+namespace {
+
+using gleditor::CachedPageHeader;
+using gleditor::ClusterBox;
+using gleditor::PageParagraph;
+
+constexpr std::array<char, 8> magic{'G', 'L', 'E', 'D', 'P', 'A', 'G', 'E'};
+/// Bumped whenever the layout below changes.
+constexpr std::uint32_t formatVersion = 2;
+constexpr std::uint64_t alignment     = 8;
+
+struct FileHeader {
+  std::array<char, 8> magic{};
+  std::uint32_t version{};
+  std::uint32_t rowBytes{};
+  std::uint64_t key{};
+  std::uint64_t textBytes{};
+  std::uint32_t pages{};
+  std::uint32_t reserved{};
+  std::uint64_t tableAt{};
+};
+
+struct TableEntry {
+  CachedPageHeader header;
+  std::uint64_t rowsAt{};
+  std::uint64_t clustersAt{};
+  std::uint64_t paragraphsAt{};
+  std::uint64_t glyphsAt{};
+};
+
+static_assert(std::is_trivially_copyable_v<FileHeader>);
+static_assert(std::is_trivially_copyable_v<TableEntry>);
+static_assert(std::is_trivially_copyable_v<ClusterBox>);
+static_assert(std::is_trivially_copyable_v<PageParagraph>);
+static_assert(0 == sizeof(FileHeader) % alignment);
+static_assert(0 == sizeof(TableEntry) % alignment);
+
+constexpr std::uint64_t fnvPrime = 1099511628211ULL;
+
+std::uint64_t hashValue(const std::uint64_t hash, const auto &value) {
+  return gleditor::hashText(
+      hash, {reinterpret_cast<const char *>(&value), sizeof(value)});
+}
+
+/// A string with its length first, so that "ab"+"c" and "a"+"bc" differ.
+std::uint64_t hashString(const std::uint64_t hash, const std::string &value) {
+  return gleditor::hashText(hashValue(hash, value.size()), value);
+}
+
+template <typename T> std::span<const std::byte> bytesOf(std::span<T> items) {
+  return std::as_bytes(items);
+}
+
+/// Whether @p count items of @p size bytes from @p at lie before @p end.
+bool fits(const std::uint64_t at, const std::uint64_t count,
+          const std::uint64_t size, const std::uint64_t end) {
+  return at <= end && 0 == at % alignment && count * size <= end - at;
+}
+
+template <typename T>
+std::vector<T> copyOut(const std::span<const std::byte> bytes) {
+  std::vector<T> items(bytes.size() / sizeof(T));
+  if (!items.empty()) {
+    std::memcpy(items.data(), bytes.data(), items.size() * sizeof(T));
+  }
+  return items;
+}
+
+/// A name no other writer of the same cache will pick.
+std::string temporaryName(const std::string &target) {
+  static std::mutex lock;
+  static std::mt19937_64 random{std::random_device{}()};
+  const std::lock_guard guard(lock);
+  return target + "." + std::to_string(random()) + ".tmp";
+}
+
+} // namespace
+
+namespace gleditor {
+
+std::uint64_t hashText(std::uint64_t hash, const std::string_view bytes) {
+  for (const char byte : bytes) {
+    hash ^= static_cast<unsigned char>(byte);
+    hash *= fnvPrime;
+  }
+  return hash;
+}
+
+std::uint64_t PageCacheKey::digest() const {
+  auto hash = hashValue(textHashSeed, textHash);
+  hash      = hashValue(hash, textBytes);
+  hash      = hashString(hash, font);
+  hash      = hashValue(hash, pageWidth);
+  hash      = hashValue(hash, pageHeight);
+  hash      = hashValue(hash, margin);
+  hash      = hashString(hash, pango);
+  return hashValue(hash, rowBytes);
+}
+
+std::string PageCacheKey::fileName() const {
+  constexpr std::string_view digits = "0123456789abcdef";
+  auto hash                         = digest();
+  std::string name(16, '0');
+  for (auto it = name.rbegin(); it != name.rend(); ++it, hash >>= 4) {
+    *it = digits[hash & 0xf];
+  }
+  return name + ".pages";
+}
+
+std::vector<ClusterBox> CachedPage::clusterTable() const {
+  return copyOut<ClusterBox>(clusters);
+}
+
+std::vector<PageParagraph> CachedPage::paragraphTable() const {
+  return copyOut<PageParagraph>(paragraphs);
+}
+
+PageCacheWriter::PageCacheWriter(const std::filesystem::path &dir,
+                                 const PageCacheKey &key)
+    : key(key), target(dir / key.fileName()),
+      temporary(temporaryName(target.string())) {
+  std::error_code err;
+  std::filesystem::create_directories(dir, err);
+  out.open(temporary, std::ios::binary | std::ios::trunc);
+  // Room for the header, which is only known once every page is in.
+  const FileHeader blank{};
+  out.write(reinterpret_cast<const char *>(&blank), sizeof(blank));
+  failed = !out;
+}
+
+PageCacheWriter::~PageCacheWriter() { abandon(); }
+
+std::uint64_t PageCacheWriter::append(const std::span<const std::byte> bytes) {
+  const auto at = static_cast<std::uint64_t>(out.tellp());
+  out.write(reinterpret_cast<const char *>(bytes.data()),
+            static_cast<std::streamsize>(bytes.size()));
+  constexpr std::array<char, alignment> padding{};
+  out.write(padding.data(), static_cast<std::streamsize>(
+                                (alignment - bytes.size() % alignment) %
+                                alignment));
+  failed = failed || !out;
+  return at;
+}
+
+void PageCacheWriter::add(const std::uint32_t index,
+                          const CachedPageHeader &header,
+                          const std::span<const std::byte> rows,
+                          const std::span<const ClusterBox> clusters,
+                          const std::span<const PageParagraph> paragraphs,
+                          const std::span<const std::byte> glyphs) {
+  const std::lock_guard guard(lock);
+  if (failed || done) {
+    return;
+  }
+  if (rows.size() != std::size_t{header.rowCount} * key.rowBytes ||
+      clusters.size() != header.clusterCount ||
+      paragraphs.size() != header.paragraphCount ||
+      glyphs.size() != header.glyphBytes) {
+    failed = true;
+    return;
+  }
+  if (entries.size() <= index) {
+    entries.resize(index + 1);
+  }
+  auto &entry        = entries[index];
+  entry.header       = header;
+  entry.rowsAt       = append(rows);
+  entry.clustersAt   = append(bytesOf(clusters));
+  entry.paragraphsAt = append(bytesOf(paragraphs));
+  entry.glyphsAt     = append(glyphs);
+  entry.written      = true;
+}
+
+bool PageCacheWriter::finish(const std::uint32_t pages) {
+  const std::lock_guard guard(lock);
+  if (done) {
+    return false;
+  }
+  done = true;
+  auto ok =
+      !failed && entries.size() == pages &&
+      std::all_of(entries.begin(), entries.end(),
+                  [](const Entry &entry) { return entry.written; });
+  std::uint64_t textBytes = 0;
+  if (ok) {
+    std::vector<TableEntry> table;
+    table.reserve(entries.size());
+    for (const auto &entry : entries) {
+      table.push_back({.header       = entry.header,
+                       .rowsAt       = entry.rowsAt,
+                       .clustersAt   = entry.clustersAt,
+                       .paragraphsAt = entry.paragraphsAt,
+                       .glyphsAt     = entry.glyphsAt});
+      textBytes += entry.header.textBytes;
+    }
+    const FileHeader header{.magic     = magic,
+                            .version   = formatVersion,
+                            .rowBytes  = key.rowBytes,
+                            .key       = key.digest(),
+                            .textBytes = key.textBytes,
+                            .pages     = pages,
+                            .tableAt   = append(bytesOf(std::span(table)))};
+    out.seekp(0);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.close();
+    // Pages that do not add up to the text they were keyed on are not its
+    // pages, whatever went wrong; better no cache than that one.
+    ok = !failed && !out.fail() && textBytes == key.textBytes;
+  }
+  std::error_code err;
+  if (ok) {
+    std::filesystem::rename(temporary, target, err);
+    ok = !err;
+  }
+  if (!ok) {
+    out.close();
+    std::filesystem::remove(temporary, err);
+  }
+  return ok;
+}
+
+void PageCacheWriter::abandon() {
+  const std::lock_guard guard(lock);
+  if (done) {
+    return;
+  }
+  done = true;
+  out.close();
+  std::error_code err;
+  std::filesystem::remove(temporary, err);
+}
+
+std::optional<PageCacheView> PageCacheView::open(const std::string_view bytes,
+                                                 const PageCacheKey &key) {
+  FileHeader header;
+  if (bytes.size() < sizeof(header)) {
+    return std::nullopt;
+  }
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  if (header.magic != magic || formatVersion != header.version ||
+      key.rowBytes != header.rowBytes || key.digest() != header.key ||
+      key.textBytes != header.textBytes ||
+      !fits(header.tableAt, header.pages, sizeof(TableEntry), bytes.size())) {
+    return std::nullopt;
+  }
+
+  PageCacheView view;
+  view.bytes    = bytes;
+  view.entries  = header.pages;
+  view.rowBytes = header.rowBytes;
+  view.tableAt  = header.tableAt;
+  // Checked here, every page, so that page() cannot fail.
+  std::uint64_t textBytes = 0;
+  for (std::uint32_t i = 0; i < header.pages; i++) {
+    TableEntry entry;
+    std::memcpy(&entry, bytes.data() + header.tableAt + i * sizeof(entry),
+                sizeof(entry));
+    const auto &page = entry.header;
+    if (!fits(entry.rowsAt, page.rowCount, header.rowBytes, header.tableAt) ||
+        !fits(entry.clustersAt, page.clusterCount, sizeof(ClusterBox),
+              header.tableAt) ||
+        !fits(entry.paragraphsAt, page.paragraphCount, sizeof(PageParagraph),
+              header.tableAt) ||
+        !fits(entry.glyphsAt, page.glyphBytes, 1, header.tableAt)) {
+      return std::nullopt;
+    }
+    textBytes += page.textBytes;
+  }
+  if (textBytes != header.textBytes) {
+    return std::nullopt;
+  }
+  return view;
+}
+
+CachedPage PageCacheView::page(const std::size_t index) const {
+  TableEntry entry;
+  std::memcpy(&entry, bytes.data() + tableAt + index * sizeof(entry),
+              sizeof(entry));
+  const auto *base  = reinterpret_cast<const std::byte *>(bytes.data());
+  const auto &shape = entry.header;
+  return {.header     = shape,
+          .rows       = {base + entry.rowsAt,
+                         std::size_t{shape.rowCount} * rowBytes},
+          .clusters   = {base + entry.clustersAt,
+                         shape.clusterCount * sizeof(ClusterBox)},
+          .paragraphs = {base + entry.paragraphsAt,
+                         shape.paragraphCount * sizeof(PageParagraph)},
+          .glyphs     = {base + entry.glyphsAt, shape.glyphBytes}};
+}
+
+} // namespace gleditor
+
+// vi: set sw=2 sts=2 ts=2 et:
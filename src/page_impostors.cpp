@@ -0,0 +1,205 @@
+/**
+ * @file page_impostors.cpp
+ * @brief Drawing pages as pictures, and keeping the pictures on the device.
+ */
+#include <gleditor/page_impostors.hpp> // IWYU pragma: associated
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <gleditor/doc.hpp>
+#include <gleditor/render/device.hpp>
+
+namespace gleditor {
+
+namespace {
+
+/// Copy a matrix into the flat array the device uniform structs carry.
+std::array<float, 16> toArray(const glm::mat4 &mat) {
+  std::array<float, 16> out{};
+  const auto *src = glm::value_ptr(mat);
+  std::copy_n(src, out.size(), out.begin());
+  return out;
+}
+
+/// The bits of an identity word naming the document and page, without the
+/// kind: a span is recorded against the glyphs, a draw carries no kind.
+constexpr std::uint32_t identityOnly =
+    (1U << (render::tagDocBits + render::tagPageBits)) - 1U;
+
+/// Rows the pictures' storage starts with.
+constexpr std::uint32_t initialRows = 64;
+
+} // namespace
+
+PageImpostors::PageImpostors(render::RenderDevice *const aDevice)
+    : device(aDevice),
+      atlas(std::min<std::uint32_t>(
+                layerSize, static_cast<std::uint32_t>(std::max(
+                               1, aDevice->textureLimits().maxSize))),
+            std::min({maxLayers, Doc::VBORow::maxAtlasLayers,
+                      static_cast<std::uint32_t>(std::max(
+                          1, aDevice->textureLimits().maxLayers))})) {}
+
+PageImpostors::~PageImpostors() {
+  if (pictures.valid()) {
+    device->destroyTexture(pictures);
+  }
+}
+
+std::int32_t PageImpostors::stepFor(const float scale) {
+  if (!(scale > 0.0F)) {
+    return 0;
+  }
+  return static_cast<std::int32_t>(std::ceil(std::log2(scale)));
+}
+
+float PageImpostors::scaleOf(const std::int32_t step) {
+  return std::ldexp(1.0F, step);
+}
+
+void PageImpostors::beginFrame(
+    const std::span<const render::HighlightRange> highlights) {
+  frameBatches.clear();
+  wanted.clear();
+  askedBefore = std::exchange(askedNow, {});
+  spanned.clear();
+  for (const auto &range : highlights) {
+    spanned.push_back(range.identity & identityOnly);
+  }
+}
+
+bool PageImpostors::highlighted(const std::uint32_t identity) const {
+  return std::ranges::find(spanned, identity & identityOnly) != spanned.end();
+}
+
+void PageImpostors::createPipeline(const render::PipelineDesc &documentDesc) {
+  render::PipelineDesc desc = documentDesc;
+  desc.name                 = "impostor";
+  pipeline                  = device->createPipeline(desc);
+}
+
+bool PageImpostors::collect(const std::uint64_t page, const std::int32_t step,
+                            const glm::mat4 &mvp, const float pageWidth,
+                            const float pageHeight, const float opacity,
+                            const std::uint32_t identity) {
+  if (!pipeline.valid()) {
+    return false;
+  }
+  const auto slot = atlas.find(page, step);
+  if (!slot) {
+    return false;
+  }
+  // The row draws a quad the picture's size in texels, since that is what
+  // the atlas holds; stretching it to the page is the draw's business.
+  const auto fitted =
+      glm::scale(mvp, glm::vec3(pageWidth / static_cast<float>(slot->width),
+                                pageHeight / static_cast<float>(slot->height),
+                                1.0F));
+  frameBatches.push_back(render::GlyphBatch{
+      render::DrawUniforms{toArray(fitted), opacity, identity},
+      rows->buffer(),
+      rows->byteOffset(backing) + (slot->row * sizeof(Doc::VBORow)), 1});
+  return true;
+}
+
+void PageImpostors::want(ImpostorWant asked) {
+  // A picture no layer could hold would be made, let go of and asked for
+  // again every other frame.
+  const auto scale = scaleOf(asked.step);
+  if (std::ceil(asked.width * scale) > static_cast<float>(atlas.layerSize()) ||
+      std::ceil(asked.height * scale) > static_cast<float>(atlas.layerSize())) {
+    return;
+  }
+  if (pending.contains(asked.page) || !askedNow.insert(asked.page).second ||
+      !askedBefore.contains(asked.page)) {
+    return;
+  }
+  wanted.push_back(std::move(asked));
+}
+
+std::vector<ImpostorWant> PageImpostors::takeWanted() {
+  if (wanted.size() > begunPerFrame) {
+    wanted.resize(begunPerFrame);
+  }
+  for (const auto &begun : wanted) {
+    pending.insert(begun.page);
+  }
+  return std::exchange(wanted, {});
+}
+
+void PageImpostors::install(ImpostorImage image) {
+  pending.erase(image.page);
+  installed.push_back(std::move(image));
+}
+
+void PageImpostors::abandon(const std::uint64_t page) { pending.erase(page); }
+
+void PageImpostors::writeRow(const ImpostorSlot &slot) {
+  if (!rows) {
+    rows    = std::make_unique<BufferPool>(device, sizeof(Doc::VBORow),
+                                           initialRows);
+    backing = rows->reserve(initialRows);
+  }
+  if (slot.row >= rows->rowCount(backing)) {
+    rows->resize(backing, std::max(slot.row + 1, 2 * rows->rowCount(backing)));
+  }
+  const auto color = Doc::VBORow::color;
+  // Ink on paper, as a glyph is, but covering the whole page: the picture is
+  // of the paper too. Picked, it is the page, as a bar standing in for a line
+  // is.
+  const Doc::VBORow row{
+      {0.0F, 0.0F},
+      Doc::VBORow::ink(color(0), Doc::VBORow::onPaper, false),
+      Doc::VBORow::atlasAt(slot.x, slot.y),
+      Doc::VBORow::box(static_cast<unsigned char>(slot.layer), slot.width,
+                       slot.height, render::tagKindPage),
+      Doc::VBORow::paperAt(color(255), 0)};
+  rows->write(backing, slot.row,
+              std::as_bytes(std::span<const Doc::VBORow>(&row, 1)));
+}
+
+void PageImpostors::flush() {
+  for (const auto &image : installed) {
+    const auto slot =
+        atlas.place(image.page, image.step, image.width, image.height);
+    if (!slot) {
+      continue;
+    }
+    if (!pictures.valid()) {
+      pictures = device->createTextureArray(
+          static_cast<int>(atlas.layerSize()),
+          static_cast<int>(atlas.layerLimit()),
+          render::TextureFormat::R8);
+    }
+    device->updateTextureLayer(
+        pictures, static_cast<int>(slot->layer), static_cast<int>(slot->x),
+        static_cast<int>(slot->y), static_cast<int>(slot->width),
+        static_cast<int>(slot->height), image.coverage);
+    writeRow(*slot);
+  }
+  installed.clear();
+}
+
+void PageImpostors::draw() {
+  if (frameBatches.empty()) {
+    return;
+  }
+  device->bindPipeline(pipeline);
+  device->bindGlyphTexture(pictures);
+  device->drawGlyphBatches(frameBatches);
+}
+
+} // namespace gleditor
+
+// vi: set sw=2 sts=2 ts=2 et:
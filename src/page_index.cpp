@@ -0,0 +1,98 @@
+/**
+ * @file page_index.cpp
+ * @brief The Fenwick tree behind page_index.hpp.
+ */
+#include <gleditor/page_index.hpp> // IWYU pragma: associated
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <vector>
+
+namespace {
+
+/// The lowest set bit of @p index: how many entries a Fenwick node covers.
+constexpr std::size_t lowbit(const std::size_t index) {
+  return index & (~index + 1);
+}
+
+} // namespace
+
+namespace gleditor {
+
+void PageIndex::clear() {
+  spans.clear();
+  tree.assign(1, 0);
+}
+
+void PageIndex::push_back(const std::uint32_t bytes) {
+  spans.push_back(bytes);
+  // The new entry covers its own span and the lowbit - 1 spans before it,
+  // which are the difference of two prefix sums the tree already answers.
+  const auto index = spans.size();
+  tree.push_back(bytes + startOf(index - 1) - startOf(index - lowbit(index)));
+}
+
+void PageIndex::setSpan(const std::size_t page, const std::uint32_t bytes) {
+  // Unsigned arithmetic wraps, and wrapping is exactly what adding a negative
+  // difference to every covering entry needs: each one ends up correct modulo
+  // 2^64, which for a sum that never leaves the range is simply correct.
+  const auto delta = static_cast<std::uint64_t>(bytes) - spans[page];
+  spans[page]      = bytes;
+  for (auto index = page + 1; index < tree.size(); index += lowbit(index)) {
+    tree[index] += delta;
+  }
+}
+
+std::uint64_t PageIndex::startOf(std::size_t page) const {
+  std::uint64_t sum = 0;
+  for (; page > 0; page -= lowbit(page)) {
+    sum += tree[page];
+  }
+  return sum;
+}
+
+std::size_t PageIndex::pageAt(std::uint64_t offset) const {
+  if (spans.empty()) {
+    return 0;
+  }
+  // Descend from the largest power of two that fits, taking each step whose
+  // whole range still ends at or before the offset. What is taken is then the
+  // most pages that can be passed over without going beyond the offset, which
+  // is the index of the page it lands on -- and the later of two pages
+  // starting at the same byte, as a scan for the last page starting there
+  // would have found.
+  std::size_t taken = 0;
+  for (auto step = std::bit_floor(spans.size()); step > 0; step >>= 1) {
+    if (taken + step <= spans.size() && tree[taken + step] <= offset) {
+      taken += step;
+      offset -= tree[taken];
+    }
+  }
+  return taken < spans.size() ? taken : spans.size() - 1;
+}
+
+void PageIndex::splice(const std::size_t first, const std::size_t count,
+                       const std::span<const std::uint32_t> bytes) {
+  const auto from = spans.begin() + static_cast<std::ptrdiff_t>(first);
+  spans.erase(from, from + static_cast<std::ptrdiff_t>(count));
+  spans.insert(spans.begin() + static_cast<std::ptrdiff_t>(first),
+               bytes.begin(), bytes.end());
+  rebuild();
+}
+
+void PageIndex::rebuild() {
+  tree.assign(spans.size() + 1, 0);
+  for (std::size_t index = 1; index < tree.size(); index++) {
+    tree[index] += spans[index - 1];
+    if (const auto parent = index + lowbit(index); parent < tree.size()) {
+      tree[parent] += tree[index];
+    }
+  }
+}
+
+} // namespace gleditor
+
+// vi: set sw=2 sts=2 ts=2 et:
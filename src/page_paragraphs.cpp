@@ -0,0 +1,89 @@
+/**
+ * @file page_paragraphs.cpp
+ * @brief Keeping a page's cluster table in step with its paragraphs.
+ */
+#include <gleditor/page_paragraphs.hpp> // IWYU pragma: associated
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace gleditor {
+
+std::vector<std::uint32_t> paragraphStarts(const std::string_view text) {
+  std::vector<std::uint32_t> starts{0};
+  for (auto newline = text.find('\n'); std::string_view::npos != newline;
+       newline = text.find('\n', newline + 1)) {
+    if (newline + 1 < text.size()) {
+      starts.push_back(static_cast<std::uint32_t>(newline + 1));
+    }
+  }
+  return starts;
+}
+
+std::uint32_t trailingBreak(const std::string_view paragraph) {
+  if (paragraph.ends_with("\r\n")) {
+    return 2;
+  }
+  return paragraph.ends_with('\n') ? 1 : 0;
+}
+
+std::uint32_t clusterRoomFor(const std::uint32_t clusters) {
+  return clusters + std::max<std::uint32_t>(4, clusters / 8);
+}
+
+std::uint32_t spareRowsFor(const std::uint32_t glyphRows) {
+  return std::max<std::uint32_t>(128, glyphRows / 16);
+}
+
+std::optional<std::size_t>
+paragraphHolding(const std::span<const PageParagraph> paragraphs,
+                 const std::uint32_t offset) {
+  if (paragraphs.empty() ||
+      offset > paragraphs.back().byteStart + paragraphs.back().bytes) {
+    return std::nullopt;
+  }
+  const auto after = std::ranges::upper_bound(paragraphs, offset, {},
+                                              &PageParagraph::byteStart);
+  if (after == paragraphs.begin()) {
+    return std::nullopt;
+  }
+  return static_cast<std::size_t>(after - paragraphs.begin()) - 1;
+}
+
+bool relayClusters(ClusterTable &clusters,
+                   std::vector<PageParagraph> &paragraphs,
+                   const std::size_t index,
+                   const std::span<const ClusterBox> fresh,
+                   const std::int32_t delta) {
+  auto &paragraph = paragraphs[index];
+  if (fresh.size() > paragraph.clusterRoom) {
+    return false;
+  }
+  const auto shifted = [delta](const std::uint32_t offset) {
+    return static_cast<std::uint32_t>(static_cast<std::int64_t>(offset) +
+                                      delta);
+  };
+  paragraph.bytes        = shifted(paragraph.bytes);
+  paragraph.clusterCount = static_cast<std::uint32_t>(fresh.size());
+
+  // Room sits at the end of the paragraph, so that the table stays in text
+  // order with it counted in.
+  std::vector<ClusterBox> laidOut(fresh.begin(), fresh.end());
+  laidOut.resize(paragraph.clusterRoom,
+                 ClusterBox{paragraph.byteStart + paragraph.bytes, 0, 0});
+  clusters.replace(paragraph.firstCluster, laidOut, delta);
+
+  for (auto i = index + 1; i < paragraphs.size(); i++) {
+    paragraphs[i].byteStart = shifted(paragraphs[i].byteStart);
+  }
+  return true;
+}
+
+} // namespace gleditor
+
+// vi: set sw=2 sts=2 ts=2 et:
@@ -0,0 +1,202 @@
+/**
+ * @file paginator.cpp
+ * @brief The guess-and-stitch pagination described in paginator.hpp.
+ */
+#include <gleditor/paginator.hpp> // IWYU pragma: associated
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <vector>
+
+#include <gleditor/render/worker_pool.hpp>
+
+namespace {
+
+/// Guessed pages per thread per round. More than one, so that a thread that
+/// finishes early has another to take; few enough that a wrong guess, which
+/// invalidates the rest of its round, does not throw much away.
+constexpr std::uint32_t pagesPerThread = 4;
+
+/// Pieces per thread the text is cut into to find line starts, for the same
+/// reason: paragraphs are not evenly spread, and neither is the cost of
+/// shaping them.
+constexpr std::uint32_t segmentsPerThread = 4;
+
+/// Below this, one thread finishes before the others would have started
+/// earning their keep.
+constexpr std::size_t minParallelBytes = std::size_t{1024} * 1024;
+/// Text per thread below which another thread adds more setup than it saves.
+constexpr std::size_t minBytesPerThread = std::size_t{256} * 1024;
+/// Fewest threads that come out ahead of one, given that every page is shaped
+/// twice.
+constexpr std::uint32_t minParallelThreads = 3;
+
+using gleditor::PaginationLine;
+
+/// Every line of the text, found a paragraph-aligned piece at a time across
+/// the pool.
+std::vector<PaginationLine> findLines(const std::uint32_t textSize,
+                                      render::WorkerPool &pool,
+                                      const gleditor::PaginationHooks &hooks) {
+  const auto segments = pool.parallelism() * segmentsPerThread;
+  std::vector<std::uint32_t> cuts{0};
+  for (std::uint32_t i = 1; i < segments; i++) {
+    const auto cut = hooks.paragraphStart(static_cast<std::uint32_t>(
+        std::uint64_t{textSize} * i / segments));
+    // A paragraph longer than a segment swallows the cut, or several.
+    if (cut > cuts.back() && cut < textSize) {
+      cuts.push_back(cut);
+    }
+  }
+  cuts.push_back(textSize);
+
+  std::vector<std::vector<PaginationLine>> found(cuts.size() - 1);
+  pool.run(static_cast<std::uint32_t>(found.size()),
+           [&](const std::uint32_t i) {
+             hooks.lines(cuts[i], cuts[i + 1], found[i]);
+           });
+
+  std::size_t total = 0;
+  for (const auto &piece : found) {
+    total += piece.size();
+  }
+  std::vector<PaginationLine> lines;
+  lines.reserve(total);
+  for (const auto &piece : found) {
+    lines.insert(lines.end(), piece.begin(), piece.end());
+  }
+  return lines;
+}
+
+/**
+ * @brief Guess where the next @p batch pages start, the first at @p frontier.
+ *
+ * By the caller's rule when it has one, and otherwise by assuming each page
+ * holds as many lines as the page from @p lastStart to @p frontier did -- the
+ * one most recently laid out for real.
+ */
+void guessPages(const std::vector<PaginationLine> &lines,
+                const gleditor::PaginationHooks &hooks,
+                const std::uint32_t lastStart, const std::uint32_t frontier,
+                const std::size_t batch, std::vector<std::uint32_t> &guesses) {
+  const auto startOf = [](const PaginationLine &line) { return line.start; };
+  guesses.assign(1, frontier);
+  auto at = std::ranges::lower_bound(lines, frontier, {}, startOf);
+  const auto lastHeld = std::max<std::ptrdiff_t>(
+      1, std::distance(std::ranges::lower_bound(lines, lastStart, {}, startOf),
+                       at));
+  while (guesses.size() < batch) {
+    const auto held =
+        hooks.linesPerPage
+            ? std::max<std::ptrdiff_t>(
+                  1, static_cast<std::ptrdiff_t>(hooks.linesPerPage(
+                         std::span<const PaginationLine>(at, lines.end()))))
+            : lastHeld;
+    if (std::distance(at, lines.end()) <= held) {
+      break;
+    }
+    at += held;
+    guesses.push_back(at->start);
+  }
+}
+
+} // namespace
+
+namespace gleditor {
+
+std::size_t paginationSlots(const std::uint32_t parallelism) {
+  // One more than a round's guesses, for the true pages laid out at a seam.
+  return (std::size_t{std::max(parallelism, 1U)} * pagesPerThread) + 1;
+}
+
+std::uint32_t paginationParallelism(const std::size_t bytes,
+                                    const std::uint32_t cores) {
+  if (bytes < minParallelBytes) {
+    return 1;
+  }
+  const auto threads = static_cast<std::uint32_t>(
+      std::min<std::size_t>(cores, bytes / minBytesPerThread));
+  return threads < minParallelThreads ? 1 : threads;
+}
+
+PaginationStats paginate(const std::uint32_t textSize,
+                         const std::uint32_t parallelism,
+                         const PaginationHooks &hooks) {
+  PaginationStats stats;
+  stats.threads = std::max(parallelism, 1U);
+  if (0 == textSize) {
+    return stats;
+  }
+
+  // Where the next true page starts, and where the last one did.
+  std::uint32_t frontier  = 0;
+  std::uint32_t lastStart = 0;
+  const auto keep         = [&](const std::size_t slot,
+                        const std::uint32_t consumed) {
+    hooks.accept(slot, consumed);
+    lastStart = frontier;
+    frontier += consumed;
+    stats.pages++;
+  };
+  const auto layTrue = [&](const std::size_t slot) {
+    keep(slot, hooks.layPage(frontier, slot));
+  };
+
+  // Before anything is guessed, so that the first page is not kept waiting
+  // on the line starts of the whole document.
+  layTrue(0);
+  if (1 == stats.threads) {
+    while (frontier < textSize) {
+      layTrue(0);
+    }
+    return stats;
+  }
+
+  render::WorkerPool pool(stats.threads);
+  const auto lines    = findLines(textSize, pool, hooks);
+  const auto seamSlot = paginationSlots(stats.threads) - 1;
+  std::vector<std::uint32_t> guesses;
+  std::vector<std::uint32_t> consumed(seamSlot);
+
+  while (frontier < textSize) {
+    guessPages(lines, hooks, lastStart, frontier, seamSlot, guesses);
+    pool.run(static_cast<std::uint32_t>(guesses.size()),
+             [&](const std::uint32_t i) {
+               consumed[i] = hooks.layPage(guesses[i], i);
+             });
+    stats.rounds++;
+
+    // The stitch. The first guess is the frontier itself and always holds;
+    // after that, a guess holds if the page before it really stopped there.
+    std::size_t next = 0;
+    while (next < guesses.size() && frontier < textSize) {
+      if (guesses[next] == frontier) {
+        keep(next, consumed[next]);
+        next++;
+      } else {
+        // A seam: the guess was wrong. The true page is laid out here, and if
+        // it stops at a later guess, pagination has re-synced. If not, the
+        // rest of the round was guessed from starts no page has, and the next
+        // round guesses again from the truth rather than walking on alone.
+        layTrue(seamSlot);
+        stats.seamPages++;
+        while (next < guesses.size() && guesses[next] < frontier) {
+          stats.discarded++;
+          next++;
+        }
+        if (next < guesses.size() && guesses[next] != frontier) {
+          break;
+        }
+      }
+    }
+    stats.discarded += guesses.size() - next;
+  }
+  return stats;
+}
+
+} // namespace gleditor
+
+// vi: set sw=2 sts=2 ts=2 et:
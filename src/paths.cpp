@@ -11,6 +11,8 @@
 #include <string>
 #include <string_view>
 
+#include <glib.h>
+
 #include <gleditor/sdl_compat.hpp>
 
 namespace {
@@ -101,5 +103,16 @@ void resetAssetDirForTesting() {
   cachedDir.reset();
 }
 
+std::string cacheDir() {
+  // Asked every time rather than remembered: it costs a getenv, and unlike
+  // the assets nothing acts on it once and then depends on it staying put.
+  if (const auto *requested = std::getenv("GLEDITOR_CACHE_DIR");
+      nullptr != requested && '\0' != requested[0]) {
+    return requested;
+  }
+  return (std::filesystem::path(g_get_user_cache_dir()) / "gleditor")
+      .string();
+}
+
 } // namespace gleditor
 // vi: set sw=2 sts=2 ts=2 et:
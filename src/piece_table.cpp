@@ -0,0 +1,470 @@
+/**
+ * @file piece_table.cpp
+ * @brief The piece table described in piece_table.hpp, as a treap of pieces.
+ *
+ * A treap because it needs nothing but split and merge: every edit is "cut the
+ * tree at the offset, put a piece in or take a range out, join it back". The
+ * random priorities keep it balanced in expectation without the bookkeeping a
+ * red-black or AVL tree would need on every rotation.
+ */
+#include <gleditor/piece_table.hpp> // IWYU pragma: associated
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <gleditor/utf8.hpp>
+
+namespace {
+
+/**
+ * @brief Bytes an insertion buffer is opened with.
+ *
+ * Typing fills one of these a keystroke at a time, and a piece can only be
+ * lengthened while the text after it is still being written to the same
+ * buffer, so a larger block means fewer pieces per session. An insertion
+ * larger than this gets a buffer of its own size.
+ */
+constexpr std::size_t insertionBlockBytes = 64 * 1024;
+
+/// PieceTable::slice(), of anything with a forEachRun() of its own.
+template <typename Runs>
+std::string_view sliceOf(const Runs &runs, const std::size_t offset,
+                         const std::size_t bytes, std::string &scratch) {
+  std::string_view first;
+  std::size_t seen = 0;
+  runs.forEachRun(offset, bytes, [&](const std::string_view run) {
+    if (0 == seen) {
+      first = run;
+    } else {
+      // Only now is it known that the range is not one run. Everything after
+      // this is the copying case, so the first run joins it.
+      if (seen == first.size()) {
+        scratch.assign(first);
+      }
+      scratch.append(run);
+    }
+    seen += run.size();
+    return true;
+  });
+  return seen == first.size() ? first : std::string_view(scratch);
+}
+
+} // namespace
+
+namespace gleditor {
+
+struct PieceTable::Node {
+  std::uint32_t buffer{};
+  std::uint32_t priority{};
+  std::size_t start{};
+  std::size_t length{};
+  /// Bytes and pieces in this subtree, this node included. What lets an offset
+  /// be found by descending rather than by walking.
+  std::size_t bytes{};
+  std::size_t pieces{};
+  NodeIndex left{none};
+  NodeIndex right{none};
+};
+
+PieceTable::PieceTable() = default;
+
+PieceTable::PieceTable(std::string loaded) {
+  // On the heap, so that moving the table never moves the bytes it views.
+  auto owned    = std::make_shared<const std::string>(std::move(loaded));
+  original      = *owned;
+  originalOwner = std::move(owned);
+  if (!original.empty()) {
+    root = makeNode(0, 0, original.size());
+  }
+}
+
+PieceTable::PieceTable(const std::string_view bytes,
+                       std::shared_ptr<const void> owner)
+    : original(bytes), originalOwner(std::move(owner)) {
+  if (!bytes.empty()) {
+    root = makeNode(0, 0, bytes.size());
+  }
+}
+
+PieceTable::~PieceTable() = default;
+
+PieceTable::PieceTable(PieceTable &&) noexcept            = default;
+PieceTable &PieceTable::operator=(PieceTable &&) noexcept = default;
+
+std::size_t PieceTable::bytesUnder(const NodeIndex node) const {
+  return none == node ? 0 : nodes[node].bytes;
+}
+
+std::size_t PieceTable::countUnder(const NodeIndex node) const {
+  return none == node ? 0 : nodes[node].pieces;
+}
+
+std::size_t PieceTable::size() const { return bytesUnder(root); }
+
+std::size_t PieceTable::pieceCount() const { return countUnder(root); }
+
+PieceTable::NodeIndex PieceTable::makeNode(const std::uint32_t buffer,
+                                           const std::size_t start,
+                                           const std::size_t length) {
+  // xorshift32: the priorities only have to be unrelated to the text, not
+  // unpredictable.
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+
+  Node fresh;
+  fresh.buffer   = buffer;
+  fresh.priority = seed;
+  fresh.start    = start;
+  fresh.length   = length;
+  fresh.bytes    = length;
+  fresh.pieces   = 1;
+
+  if (!freeNodes.empty()) {
+    const auto index = freeNodes.back();
+    freeNodes.pop_back();
+    nodes[index] = fresh;
+    return index;
+  }
+  nodes.push_back(fresh);
+  return static_cast<NodeIndex>(nodes.size() - 1);
+}
+
+void PieceTable::freeTree(const NodeIndex node) {
+  if (none == node) {
+    return;
+  }
+  freeTree(nodes[node].left);
+  freeTree(nodes[node].right);
+  freeNodes.push_back(node);
+}
+
+void PieceTable::update(const NodeIndex node) {
+  auto &here  = nodes[node];
+  here.bytes  = here.length + bytesUnder(here.left) + bytesUnder(here.right);
+  here.pieces = 1 + countUnder(here.left) + countUnder(here.right);
+}
+
+void PieceTable::split(const NodeIndex node, const std::size_t offset,
+                       NodeIndex &left, NodeIndex &right) {
+  if (none == node) {
+    left  = none;
+    right = none;
+    return;
+  }
+  // Indices rather than references throughout: dividing a piece adds a node,
+  // and adding a node may move every node there is.
+  const auto before = bytesUnder(nodes[node].left);
+  const auto length = nodes[node].length;
+  if (offset <= before) {
+    NodeIndex rest = none;
+    split(nodes[node].left, offset, left, rest);
+    nodes[node].left = rest;
+    update(node);
+    right = node;
+    return;
+  }
+  if (offset >= before + length) {
+    NodeIndex rest = none;
+    split(nodes[node].right, offset - before - length, rest, right);
+    nodes[node].right = rest;
+    update(node);
+    left = node;
+    return;
+  }
+
+  // The offset lands inside this piece, so it becomes two. The second half
+  // takes this node's priority, which keeps it above everything in the right
+  // subtree it inherits and the tree a valid treap without any rotation.
+  const auto cut  = offset - before;
+  const auto tail = makeNode(nodes[node].buffer, nodes[node].start + cut,
+                             length - cut);
+  nodes[tail].priority = nodes[node].priority;
+  nodes[tail].right    = nodes[node].right;
+  update(tail);
+
+  nodes[node].length = cut;
+  nodes[node].right  = none;
+  update(node);
+
+  left  = node;
+  right = tail;
+}
+
+PieceTable::NodeIndex PieceTable::merge(const NodeIndex left,
+                                        const NodeIndex right) {
+  if (none == left) {
+    return right;
+  }
+  if (none == right) {
+    return left;
+  }
+  if (nodes[left].priority > nodes[right].priority) {
+    nodes[left].right = merge(nodes[left].right, right);
+    update(left);
+    return left;
+  }
+  nodes[right].left = merge(left, nodes[right].left);
+  update(right);
+  return right;
+}
+
+bool PieceTable::extendLast(const NodeIndex node, const std::uint32_t buffer,
+                            const std::size_t end, const std::size_t bytes) {
+  if (none == node) {
+    return false;
+  }
+  if (none != nodes[node].right) {
+    if (!extendLast(nodes[node].right, buffer, end, bytes)) {
+      return false;
+    }
+    nodes[node].bytes += bytes;
+    return true;
+  }
+  auto &last = nodes[node];
+  if (last.buffer != buffer || last.start + last.length != end) {
+    return false;
+  }
+  last.length += bytes;
+  last.bytes += bytes;
+  return true;
+}
+
+std::pair<std::uint32_t, std::size_t>
+PieceTable::append(const std::string_view text) {
+  const auto *current = buffers.empty() ? nullptr : buffers.back().get();
+  if (nullptr == current ||
+      current->capacity() - current->size() < text.size()) {
+    // A fresh block rather than a larger string: growing one would move what
+    // is already in it out from under every view of it.
+    auto block = std::make_shared<std::string>();
+    block->reserve(std::max(insertionBlockBytes, text.size()));
+    buffers.push_back(std::move(block));
+  }
+  auto &target     = *buffers.back();
+  const auto start = target.size();
+  target.append(text);
+  // Buffer zero is the original text, so the last block is numbered by the
+  // count of blocks.
+  return {static_cast<std::uint32_t>(buffers.size()), start};
+}
+
+void PieceTable::insert(std::size_t offset, const std::string_view text) {
+  if (text.empty()) {
+    return;
+  }
+  offset = std::min(offset, size());
+
+  NodeIndex left  = none;
+  NodeIndex right = none;
+  split(root, offset, left, right);
+
+  const auto [buffer, start] = append(text);
+  // Typing is a run of insertions each at the end of the last, and each is
+  // written straight after the last in the same buffer -- so the piece the
+  // previous keystroke made simply gets longer, and a paragraph typed in one
+  // go is one piece rather than one per character.
+  if (!extendLast(left, buffer, start, text.size())) {
+    left = merge(left, makeNode(buffer, start, text.size()));
+  }
+  root = merge(left, right);
+}
+
+void PieceTable::erase(const std::size_t offset, const std::size_t bytes) {
+  if (0 == bytes || offset >= size()) {
+    return;
+  }
+  NodeIndex left   = none;
+  NodeIndex middle = none;
+  NodeIndex right  = none;
+  split(root, offset, left, middle);
+  split(middle, bytes, middle, right);
+  freeTree(middle);
+  root = merge(left, right);
+}
+
+std::string_view PieceTable::viewOf(const Node &node) const {
+  const std::string_view buffer =
+      0 == node.buffer ? original : std::string_view(*buffers[node.buffer - 1]);
+  return buffer.substr(node.start, node.length);
+}
+
+char PieceTable::at(std::size_t offset) const {
+  auto node = root;
+  while (none != node) {
+    const auto &here  = nodes[node];
+    const auto before = bytesUnder(here.left);
+    if (offset < before) {
+      node = here.left;
+    } else if (offset < before + here.length) {
+      return viewOf(here)[offset - before];
+    } else {
+      offset -= before + here.length;
+      node = here.right;
+    }
+  }
+  return '\0';
+}
+
+bool PieceTable::visitRange(
+    const NodeIndex node, std::size_t offset, std::size_t bytes,
+    const std::function<bool(std::string_view)> &visit) const {
+  if (none == node || 0 == bytes) {
+    return true;
+  }
+  const auto &here  = nodes[node];
+  const auto before = bytesUnder(here.left);
+
+  if (offset < before) {
+    const auto taken = std::min(bytes, before - offset);
+    if (!visitRange(here.left, offset, taken, visit)) {
+      return false;
+    }
+    bytes -= taken;
+    offset = before;
+  }
+  if (0 == bytes) {
+    return true;
+  }
+
+  const auto into = offset - before;
+  if (into < here.length) {
+    const auto taken = std::min(bytes, here.length - into);
+    if (!visit(viewOf(here).substr(into, taken))) {
+      return false;
+    }
+    bytes -= taken;
+    offset += taken;
+  }
+  if (0 == bytes) {
+    return true;
+  }
+  return visitRange(here.right, offset - before - here.length, bytes, visit);
+}
+
+void PieceTable::forEachRun(
+    const std::size_t offset, const std::size_t bytes,
+    const std::function<bool(std::string_view)> &visit) const {
+  if (offset >= size()) {
+    return;
+  }
+  visitRange(root, offset, std::min(bytes, size() - offset), visit);
+}
+
+bool PieceTable::sameText(const PieceTable &other) const {
+  if (size() != other.size()) {
+    return false;
+  }
+  bool same         = true;
+  std::size_t start = 0;
+  forEachRun(0, size(), [&](const std::string_view mine) {
+    std::size_t within = 0;
+    other.forEachRun(start, mine.size(), [&](const std::string_view theirs) {
+      same = mine.substr(within, theirs.size()) == theirs;
+      within += theirs.size();
+      return same;
+    });
+    start += mine.size();
+    return same;
+  });
+  return same;
+}
+
+std::string PieceTable::substr(const std::size_t offset,
+                               const std::size_t bytes) const {
+  std::string out;
+  if (offset < size()) {
+    out.reserve(std::min(bytes, size() - offset));
+  }
+  forEachRun(offset, bytes, [&out](const std::string_view run) {
+    out.append(run);
+    return true;
+  });
+  return out;
+}
+
+std::string PieceTable::str() const { return substr(0, size()); }
+
+PieceTable::Snapshot PieceTable::snapshot() const {
+  Snapshot taken;
+  taken.bytes = size();
+  taken.runs.reserve(pieceCount());
+  visitRange(root, 0, taken.bytes, [&taken](const std::string_view run) {
+    taken.runs.push_back(run);
+    return true;
+  });
+  taken.owners.reserve(buffers.size() + 1);
+  taken.owners.push_back(originalOwner);
+  taken.owners.insert(taken.owners.end(), buffers.begin(), buffers.end());
+  return taken;
+}
+
+void PieceTable::Snapshot::forEachRun(
+    std::size_t offset, std::size_t bytes,
+    const std::function<bool(std::string_view)> &visit) const {
+  for (const auto run : runs) {
+    if (0 == bytes) {
+      return;
+    }
+    if (offset >= run.size()) {
+      offset -= run.size();
+      continue;
+    }
+    const auto taken = std::min(bytes, run.size() - offset);
+    if (!visit(run.substr(offset, taken))) {
+      return;
+    }
+    bytes -= taken;
+    offset = 0;
+  }
+}
+
+std::string_view PieceTable::Snapshot::slice(const std::size_t offset,
+                                             const std::size_t bytes,
+                                             std::string &scratch) const {
+  return sliceOf(*this, offset, bytes, scratch);
+}
+
+std::string PieceTable::Snapshot::str() const {
+  std::string out;
+  out.reserve(bytes);
+  for (const auto run : runs) {
+    out.append(run);
+  }
+  return out;
+}
+
+std::string_view PieceTable::slice(const std::size_t offset,
+                                   const std::size_t bytes,
+                                   std::string &scratch) const {
+  return sliceOf(*this, offset, bytes, scratch);
+}
+
+std::size_t PieceTable::alignToCharacterStart(std::size_t offset) const {
+  if (offset >= size()) {
+    return offset;
+  }
+  while (offset > 0 && continuesCharacter(at(offset))) {
+    offset--;
+  }
+  return offset;
+}
+
+std::size_t PieceTable::alignToCharacterEnd(std::size_t offset) const {
+  const auto end = size();
+  while (offset < end && continuesCharacter(at(offset))) {
+    offset++;
+  }
+  return offset;
+}
+
+} // namespace gleditor
+
+// vi: set sw=2 sts=2 ts=2 et:
@@ -0,0 +1,40 @@
+/**
+ * @file reflow_backlog.cpp
+ * @brief Offsets through the pages a reflow has not reached yet.
+ */
+#include <gleditor/reflow_backlog.hpp> // IWYU pragma: associated
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include <gleditor/page_index.hpp>
+
+namespace gleditor {
+
+std::uint64_t ReflowBacklog::startOf(const PageIndex &index,
+                                     const std::size_t page) const {
+  const auto indexed = index.startOf(page);
+  if (page < firstStale) {
+    return indexed;
+  }
+  return static_cast<std::uint64_t>(static_cast<std::int64_t>(indexed) + skew);
+}
+
+std::size_t ReflowBacklog::pageAt(const PageIndex &index,
+                                  const std::uint64_t offset) const {
+  // Up to where the reflow has got, the index is exact. The text between
+  // there and where the first old page starts is on both, and belongs to the
+  // new page, which is the one that agrees with everything before it.
+  const auto resume = resumeAt(index);
+  if (offset < resume || firstStale >= index.size()) {
+    return index.pageAt(offset);
+  }
+  const auto indexed =
+      static_cast<std::uint64_t>(static_cast<std::int64_t>(offset) - skew);
+  return std::max(firstStale, index.pageAt(indexed));
+}
+
+} // namespace gleditor
+
+// vi: set sw=2 sts=2 ts=2 et:
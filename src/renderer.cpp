@@ -6,10 +6,12 @@
 
 #include <algorithm>
 #include <chrono>
+#include <filesystem>
 #include <format>
 #include <fstream>
 #include <future>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <ranges>
@@ -18,7 +20,6 @@
 #include <thread>
 #include <vector>
 
-#include <glibmm/fileutils.h>
 #include <glm/ext/matrix_clip_space.hpp>
 #include <glm/ext/matrix_float4x4.hpp>
 #include <glm/ext/matrix_transform.hpp>
@@ -26,10 +27,12 @@
 
 #include <gleditor/android_bootstrap.hpp>
 #include <gleditor/doc.hpp>
+#include <gleditor/page_impostors.hpp>
 #include <gleditor/paths.hpp>
 #include <gleditor/render/device.hpp>
 #include <gleditor/render/shader_source.hpp>
 #include <gleditor/render_state.hpp>
+#include <gleditor/save_file.hpp>
 #include <gleditor/sdl_wrap.hpp>
 #include <gleditor/state.hpp>
 #include <gleditor/tqueue.hpp>
@@ -41,6 +44,12 @@ namespace {
 /// any working directory.
 std::string shaderDir() { return gleditor::assetPath("shaders"); }
 
+/// Where the glyph atlas is kept between runs, beside the pages; see
+/// gleditor/glyphcache/atlas_file.hpp.
+std::filesystem::path glyphAtlasFile() {
+  return std::filesystem::path(gleditor::cacheDir()) / "glyphs.atlas";
+}
+
 /**
  * @brief Write a captured frame as a binary PPM.
  *
@@ -82,6 +91,8 @@ void Renderer::createPipeline(RenderState &state) const {
   // depth state and the transform it is handed differ.
   toasts->createPipeline(desc);
   caret->createPipeline(desc);
+  // So do the pictures of pages, which need a texture bound of their own.
+  state.impostors.createPipeline(desc);
   // Whatever the program draws for itself needs the same two things, and this
   // is the first moment either exists.
   for (auto *const contributor : frameContributors) {
@@ -103,11 +114,47 @@ void Renderer::reapFinishedDocLoads() {
   pendingDocLoads.erase(done.begin(), done.end());
 }
 
+void Renderer::reapFinishedSaves() {
+  const auto done = std::ranges::remove_if(pendingSaves, [](auto &fut) {
+    return !fut.valid() ||
+           std::future_status::ready == fut.wait_for(std::chrono::seconds{0});
+  });
+  pendingSaves.erase(done.begin(), done.end());
+}
+
+void Renderer::reflowPending(RenderState &state) const {
+  const auto budget  = this->state->reflowBudget;
+  const auto started = std::chrono::steady_clock::now();
+  const auto deadline =
+      0 == budget.count() ? std::chrono::steady_clock::time_point::max()
+                          : started + budget;
+  std::size_t backlogBefore = 0;
+  for (const std::shared_ptr<Doc> &doc : state.docs) {
+    backlogBefore += doc->reflowBacklog();
+    doc->reflowPending(state, deadline);
+  }
+  std::size_t backlog = 0;
+  for (const std::shared_ptr<Doc> &doc : state.docs) {
+    backlog += doc->reflowBacklog();
+  }
+  // Only while a reflow is spread over frames, which is when the budget is
+  // doing anything.
+  if (0 != backlogBefore || 0 != backlog) {
+    std::cout << std::format(
+        "reflow: {:.1f} of {} ms budget, backlog {} pages\n",
+        std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - started)
+            .count(),
+        budget.count(), backlog);
+  }
+}
+
 bool Renderer::hasPendingWork() const {
   // An animation counts as pending work, which is what keeps a screenshot
   // honest: the frame a capture wants is the finished one, and a document
   // halfway through fading in is not it.
   return !renderQueue.empty() || !pendingDocLoads.empty() ||
+         !pendingSaves.empty() ||
          !timeline.empty() ||
          (nullptr != toasts && toasts->fadingIn(ToastOverlay::Clock::now())) ||
          std::ranges::any_of(frameContributors,
@@ -144,6 +191,8 @@ void Renderer::closeDoc(RenderState &state, const std::uint32_t index) {
   // fade cannot land on a document that is on its way out.
   auto departing = state.docs[which];
   state.docs.erase(state.docs.begin() + static_cast<std::ptrdiff_t>(which));
+  // Anything drawing its pages gets its own before they go with it.
+  departing->stopLending();
   departing->animateDeparture(timeline);
   fadingDocs.push_back(std::move(departing));
 
@@ -177,7 +226,6 @@ void Renderer::saveDoc(RenderState &state, const std::uint32_t index) {
                  "nothing to save this document as yet", state);
     return;
   }
-  const std::string content = doc->contents().raw();
 
 #ifdef __ANDROID__
   // Writes through the content:// Uri this document was opened from, when it
@@ -187,23 +235,60 @@ void Renderer::saveDoc(RenderState &state, const std::uint32_t index) {
   // silently save over that copy and never reach whatever the user actually
   // shared or opened in. Falls through to the plain write below for
   // anything else -- a file:// Uri, which already named a real path, or a
-  // document that was never opened from an intent at all.
-  if (gleditor::androidSaveDocument(name, content)) {
+  // document that was never opened from an intent at all. Still on this
+  // thread, since it goes through JNI, which wants a thread attached to the
+  // VM.
+  if (gleditor::androidSaveDocument(name, doc->contents().str())) {
     toasts->post(render::DiagnosticSeverity::Info,
                  std::format("saved {}", name), state);
     return;
   }
 #endif
 
-  try {
-    Glib::file_set_contents(name, content);
-  } catch (const Glib::FileError &err) {
-    toasts->post(render::DiagnosticSeverity::Error,
-                 std::format("save failed: {}", err.what()), state);
-    return;
-  }
-  toasts->post(render::DiagnosticSeverity::Info, std::format("saved {}", name),
-               state);
+  // Another document reading the same file through a mapping would see the
+  // tail rewritten under it, so then only a replace will do.
+  const auto mapsName = [&doc, &name](const std::shared_ptr<Doc> &other) {
+    return other != doc && other->mapsItsFile() && other->name() == name;
+  };
+  const bool inPlace = this->state->saveInPlace &&
+                       std::ranges::none_of(state.docs, mapsName) &&
+                       std::ranges::none_of(fadingDocs, mapsName);
+  auto save = std::make_shared<Doc::PendingSave>(doc->beginSave(inPlace));
+  reapFinishedSaves();
+  const auto previous =
+      pendingSaves.empty() ? std::shared_future<void>{} : pendingSaves.back();
+  const std::weak_ptr<Doc> saved = doc;
+  pendingSaves.push_back(
+      std::async(std::launch::async, [this, previous, save, saved] {
+        if (previous.valid()) {
+          previous.wait();
+        }
+        const auto started = std::chrono::steady_clock::now();
+        const auto outcome = gleditor::saveText(save->text, save->request);
+        const auto took    = std::chrono::duration<double, std::milli>(
+                              std::chrono::steady_clock::now() - started)
+                              .count();
+        runWithState([this, save, saved, outcome, took](RenderState &state) {
+          // Closed while it was being written, in which case there is nothing
+          // left to tell that its file now matches.
+          if (const auto doc = saved.lock()) {
+            doc->endSave(*save, outcome);
+          }
+          const auto name = save->request.path.string();
+          if (!outcome.ok()) {
+            toasts->post(render::DiagnosticSeverity::Error,
+                         std::format("save failed: {}", outcome.error), state);
+            return;
+          }
+          std::cout << std::format(
+              "save: {} by {}, {} of {} bytes written in {:.1f} ms\n", name,
+              gleditor::SaveMethod::tail == outcome.method ? "tail"
+                                                           : "replace",
+              outcome.written, save->text.size(), took);
+          toasts->post(render::DiagnosticSeverity::Info,
+                       std::format("saved {}", name), state);
+        });
+      }).share());
 }
 
 void Renderer::openDoc(RenderState &state, const gleditor::TextSource &source) {
@@ -214,10 +299,24 @@ void Renderer::openDoc(RenderState &state, const gleditor::TextSource &source) {
   auto docPtr = Doc::create(getPtr(), device.get(), newDocPosition, source);
   docPtr->setDocIndex(static_cast<std::uint32_t>(state.docs.size()));
   docPtr->animateArrival(timeline);
+  // The same file open already is the same pages: this one draws those, and
+  // lays out its own only once one of the two is edited.
+  const bool shared =
+      std::ranges::any_of(state.docs, [&docPtr](const auto &open) {
+        return docPtr->borrowPagesOf(open);
+      });
+  if (!shared) {
+    loadPages(state, docPtr);
+  }
+  state.docs.push_back(docPtr->getPtr());
+}
+
+void Renderer::loadPages(RenderState &state,
+                         const std::shared_ptr<Doc> &docPtr) {
+  docPtr->beginLoading();
   reapFinishedDocLoads();
   pendingDocLoads.push_back(std::async(
       std::launch::async, [&state, docPtr] { docPtr->makePages(state); }));
-  state.docs.push_back(docPtr->getPtr());
 }
 
 bool Renderer::update(RenderState &state, const bool settled) {
@@ -240,6 +339,21 @@ bool Renderer::update(RenderState &state, const bool settled) {
   collectPickingResults(state);
   collectDiagnostics(state);
   applyTypedText(state);
+  // A document that was drawing another's pages until one of the two was
+  // edited; its own start loading here, from its text as it now stands.
+  for (const std::shared_ptr<Doc> &doc : state.docs) {
+    if (doc->needsPages()) {
+      loadPages(state, doc);
+    }
+  }
+  // Every edit since the last frame, in one reflow per document; see
+  // gleditor/edit_span.hpp. They share one budget, which is the frame's.
+  reflowPending(state);
+  // A paste too long for that goes to a loader instead; see Doc::insert().
+  streamInsertions(state);
+  // Between frames, with the queued work: compacting moves rows and may resize
+  // the buffer, which a frame that has recorded draws over it must not see.
+  enforcePageBudget(state);
 
   if (!device->beginFrame()) {
     return this->state->alive;
@@ -266,10 +380,21 @@ bool Renderer::update(RenderState &state, const bool settled) {
   }
 
   updateHighlights(state);
+  state.impostors.beginFrame(highlights);
 
   // Any glyphs rasterised since the last frame have only reached level zero of
   // the atlas; rebuild the rest of the chain before anything samples it.
   state.glyphCache.flush();
+  // A repack in that commit moved glyphs that pages already drawn name by
+  // where they were; their rows follow before anything is drawn from them.
+  for (const std::shared_ptr<Doc> &doc : state.docs) {
+    doc->relocateGlyphs(state.glyphCache);
+  }
+  for (const std::shared_ptr<Doc> &doc : fadingDocs) {
+    doc->relocateGlyphs(state.glyphCache);
+  }
+  // And any pictures of pages made since then are placed and uploaded.
+  state.impostors.flush();
 
   device->bindPipeline(state.glyphPipeline);
   device->bindGlyphTexture(state.glyphCache.textureHandle());
@@ -279,10 +404,14 @@ bool Renderer::update(RenderState &state, const bool settled) {
   // thread; a device that cannot simply walks it in order.
   const auto collectStart = std::chrono::steady_clock::now();
   state.pageBatches.clear();
+  state.residency.beginFrame();
   DrawBudget budget;
   budget.screenWidth = static_cast<float>(screenWidth);
-  budget.coarseBelow = this->state->coarseBelow;
-  budget.cull        = this->state->cullPages;
+  budget.coarseBelow   = this->state->coarseBelow;
+  budget.impostorBelow = this->state->impostorBelow;
+  budget.impostors     = &state.impostors;
+  budget.cull          = this->state->cullPages;
+  budget.frame         = state.residency.frame();
   lastDraw           = DrawStats{};
   for (const std::shared_ptr<Doc> &doc : state.docs) {
     doc->collect(state.pageBatches, viewProjection, budget, lastDraw);
@@ -296,11 +425,16 @@ bool Renderer::update(RenderState &state, const bool settled) {
   std::erase_if(fadingDocs, [](const std::shared_ptr<Doc> &doc) {
     return doc->hasFadedOut();
   });
+  state.residency.recordDraws(lastDraw.resident, lastDraw.evicted);
+  restoreWantedPages(state);
+  prefetchLayouts(state);
+  renderImpostors(state);
   // Timed apart from the collection above: only the recording can be split
   // across threads, so an improvement there would be invisible in a figure
   // that also counted a matrix multiply per page.
   const auto recordStart = std::chrono::steady_clock::now();
   device->drawGlyphBatches(state.pageBatches);
+  state.impostors.draw();
   const auto recordEnd = std::chrono::steady_clock::now();
 
   for (const std::shared_ptr<Doc> &doc : state.docs) {
@@ -414,7 +548,21 @@ bool Renderer::update(RenderState &state, const bool settled) {
     benchFrame.push_back(end - start);
     benchCollect.push_back(recordStart - collectStart);
     benchRecord.push_back(recordEnd - recordStart);
-    benchBatches = state.pageBatches.size();
+    benchBatches     = state.pageBatches.size();
+    benchResidency   = state.residency.stats();
+    benchBudgetBytes = state.residency.budgetBytes();
+    benchDeviceBytes = 0;
+    benchLayouts     = {};
+    benchClusters    = {};
+    benchImpostors   = state.impostors.stats();
+    for (const std::shared_ptr<Doc> &doc : state.docs) {
+      benchDeviceBytes += doc->deviceBytes();
+      benchLayouts.shaped += doc->layoutStats().shaped;
+      benchLayouts.prefetched += doc->layoutStats().prefetched;
+      benchLayouts.evictions += doc->layoutStats().evictions;
+      benchClusters.held += doc->clusterMemory().held;
+      benchClusters.asBoxes += doc->clusterMemory().asBoxes;
+    }
   }
 
   return this->state->alive;
@@ -440,8 +588,122 @@ void Renderer::reportBenchmark() const {
       median(benchRecord), caps.parallelCommandRecording ? "yes" : "no",
       caps.recordingThreads);
   std::cout << std::format(
-      "pages: {} considered, {} culled, {} coarse, {} detailed\n",
-      lastDraw.pages, lastDraw.culled, lastDraw.coarse, lastDraw.detailed);
+      "pages: {} considered, {} culled with {} tree nodes tested, {} coarse, "
+      "{} as pictures, {} detailed, {} placeholders\n",
+      lastDraw.pages, lastDraw.culled, lastDraw.nodesVisited, lastDraw.coarse,
+      lastDraw.impostors, lastDraw.detailed, lastDraw.placeholders);
+  std::cout << std::format(
+      "residency: {} hits, {} misses, {} evictions, {} restores, {:.1f} MiB "
+      "of {:.1f} MiB budget\n",
+      benchResidency.hits, benchResidency.misses, benchResidency.evictions,
+      benchResidency.restores,
+      static_cast<double>(benchDeviceBytes) / (1 << 20),
+      static_cast<double>(benchBudgetBytes) / (1 << 20));
+  std::cout << std::format(
+      "layouts: {} shaped on the render thread, {} prefetched, {} evictions\n",
+      benchLayouts.shaped, benchLayouts.prefetched, benchLayouts.evictions);
+  std::cout << std::format(
+      "clusters: {:.1f} KiB held, {:.1f} KiB as a box a cluster\n",
+      static_cast<double>(benchClusters.held) / (1 << 10),
+      static_cast<double>(benchClusters.asBoxes) / (1 << 10));
+  std::cout << std::format("impostors: {} made, {} evictions\n",
+                           benchImpostors.placed, benchImpostors.evictions);
+}
+
+void Renderer::restoreWantedPages(RenderState &state) {
+  for (const std::shared_ptr<Doc> &doc : state.docs) {
+    auto wanted = doc->takeRestores();
+    if (wanted.empty()) {
+      continue;
+    }
+    // Alongside the loads, because that is what it is: a page being built off
+    // the render thread, which a settled frame has to wait for.
+    pendingDocLoads.push_back(
+        std::async(std::launch::async, [&state, doc, wanted] {
+          doc->restorePages(state, wanted);
+        }));
+  }
+}
+
+void Renderer::prefetchLayouts(RenderState &state) {
+  for (const std::shared_ptr<Doc> &doc : state.docs) {
+    auto wanted = doc->takePrefetches();
+    if (wanted.empty()) {
+      continue;
+    }
+    // Alongside the loads, as a restore is: shaping off the render thread,
+    // which a settled frame waits for.
+    pendingDocLoads.push_back(std::async(
+        std::launch::async,
+        [doc, wanted, edited = doc->editGeneration()] {
+          doc->prefetchLayouts(wanted, edited);
+        }));
+  }
+}
+
+void Renderer::streamInsertions(RenderState &state) {
+  for (const std::shared_ptr<Doc> &doc : state.docs) {
+    auto wanted = doc->takeStreamedInsert();
+    if (!wanted) {
+      continue;
+    }
+    // Alongside the loads, because that is what it is: pages laid out and
+    // built off the render thread, which a settled frame has to wait for.
+    pendingDocLoads.push_back(std::async(
+        std::launch::async, [&state, doc, wanted = std::move(*wanted)] {
+          doc->paginateInserted(state, wanted);
+        }));
+  }
+}
+
+void Renderer::renderImpostors(RenderState &state) {
+  // One worker a document, as the restores are: each shapes its own pages.
+  std::map<std::shared_ptr<Doc>, std::vector<gleditor::ImpostorWant>> byDoc;
+  for (auto &want : state.impostors.takeWanted()) {
+    auto doc = want.doc;
+    byDoc[doc].push_back(std::move(want));
+  }
+  for (auto &[doc, wanted] : byDoc) {
+    pendingDocLoads.push_back(std::async(
+        std::launch::async, [&state, doc, wanted = std::move(wanted)] {
+          doc->renderImpostors(state, wanted);
+        }));
+  }
+}
+
+void Renderer::enforcePageBudget(RenderState &state) {
+  std::size_t deviceBytes = 0;
+  for (const std::shared_ptr<Doc> &doc : state.docs) {
+    deviceBytes += doc->deviceBytes();
+  }
+  if (!state.residency.overBudget(deviceBytes)) {
+    return;
+  }
+  // Every document's pages in one list, since the least recently seen page is
+  // the one to go whichever document it is in.
+  std::vector<gleditor::PageResidency::Candidate> candidates;
+  std::vector<std::uint32_t> indices;
+  std::vector<std::size_t> firstOf;
+  for (const std::shared_ptr<Doc> &doc : state.docs) {
+    firstOf.push_back(candidates.size());
+    doc->evictionCandidates(candidates, indices);
+  }
+  firstOf.push_back(candidates.size());
+  auto chosen = state.residency.chooseEvictions(candidates, deviceBytes);
+  if (chosen.empty()) {
+    return;
+  }
+  std::ranges::sort(chosen);
+  auto next = chosen.begin();
+  for (std::size_t d = 0; d < state.docs.size(); d++) {
+    std::vector<std::uint32_t> pagesOf;
+    for (; next != chosen.end() && *next < firstOf[d + 1]; ++next) {
+      pagesOf.push_back(indices[*next]);
+    }
+    if (!pagesOf.empty()) {
+      state.docs[d]->evict(pagesOf);
+    }
+  }
 }
 
 void Renderer::placeCaretFromPick(RenderState &state,
@@ -599,14 +861,14 @@ void Renderer::advanceScript(RenderState &state) {
     if (!caret->active() || caret->documentIndex() >= state.docs.size()) {
       std::cerr << "--type with no caret to type at; use --click first\n";
     } else {
-      state.docs[caret->documentIndex()]->insert(state, caret->byteOffset(),
-                                                 step.text, caret.get());
+      state.docs[caret->documentIndex()]->insert(caret->byteOffset(), step.text,
+                                                 caret.get());
     }
-    // An edit schedules a reflow, and this frame was judged settled before it
-    // was made. So the step is not finished here: it finishes on the next
-    // frame that really is settled, which is after the pages it changed have
-    // been laid out again. Otherwise a screenshot would show the document
-    // mid-edit and the step after it would act on one.
+    // An edit is reflowed at the start of the next frame, and this frame was
+    // judged settled before it was made. So the step is not finished here: it
+    // finishes on the next frame that really is settled, which is after the
+    // pages it changed have been laid out again. Otherwise a screenshot would
+    // show the document mid-edit and the step after it would act on one.
     finishStepWhenSettled();
     return;
   case Kind::Select:
@@ -725,7 +987,7 @@ void Renderer::applyTypedText(RenderState &state) {
   if (caret->documentIndex() >= state.docs.size()) {
     return;
   }
-  state.docs[caret->documentIndex()]->insert(state, caret->byteOffset(), typed,
+  state.docs[caret->documentIndex()]->insert(caret->byteOffset(), typed,
                                              caret.get());
 }
 
@@ -804,6 +1066,14 @@ void Renderer::renderLoop(AutoSDLWindow &window) {
   }
 
   RenderState state(device.get());
+  state.residency.setBudget(this->state->pageMemoryBudget);
+  if (this->state->pageCache) {
+    state.pageCacheDir =
+        (std::filesystem::path(gleditor::cacheDir()) / "pages").string();
+    // Before any document asks for a glyph, which is the only time an atlas
+    // can be taken up whole.
+    state.glyphCache.restore(glyphAtlasFile());
+  }
   toasts = std::make_unique<ToastOverlay>(device.get(),
                                           std::string(defaultFontName()));
   caret  = std::make_unique<Caret>(device.get());
@@ -836,11 +1106,17 @@ void Renderer::renderLoop(AutoSDLWindow &window) {
     }
 
     reapFinishedDocLoads();
+    reapFinishedSaves();
 
     // Everything queued has been carried out and every document has finished
     // loading, so this frame shows the finished result. That is the frame a
     // screenshot should capture, and the point at which --profile may quit.
-    const bool settled = !hasPendingWork();
+    // A reflow still working through its backlog has pages to replace.
+    const bool settled =
+        !hasPendingWork() &&
+        std::ranges::none_of(state.docs, [](const std::shared_ptr<Doc> &doc) {
+          return doc->reflowIsPending();
+        });
 
     // still want to update once even if we don't have anything in the render
     // queue
@@ -888,6 +1164,18 @@ void Renderer::renderLoop(AutoSDLWindow &window) {
     }
   }
   pendingDocLoads.clear();
+  // A save is the person's work, and quitting before it lands loses it.
+  for (auto &fut : pendingSaves) {
+    if (fut.valid()) {
+      fut.wait();
+    }
+  }
+  pendingSaves.clear();
+  // Every loader has finished, so nothing is still reserving and the atlas is
+  // whole.
+  if (this->state->pageCache) {
+    state.glyphCache.save(glyphAtlasFile());
+  }
 
   // Documents own device buffers; they must be released while the device is
   // still alive, and after any in-flight frame has finished reading them.
@@ -0,0 +1,47 @@
+/**
+ * @file residency.cpp
+ * @brief Choosing which pages give their geometry back.
+ */
+#include <gleditor/residency.hpp> // IWYU pragma: associated
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace gleditor {
+
+std::vector<std::size_t>
+PageResidency::chooseEvictions(const std::span<const Candidate> candidates,
+                               std::size_t deviceBytes) {
+  std::vector<std::size_t> chosen;
+  if (!overBudget(deviceBytes)) {
+    return chosen;
+  }
+  std::vector<std::size_t> order;
+  order.reserve(candidates.size());
+  for (std::size_t i = 0; i < candidates.size(); i++) {
+    if (current - std::min(current, candidates[i].lastSeen) >= grace) {
+      order.push_back(i);
+    }
+  }
+  // Stable, so that among pages last seen on the same frame -- every page a
+  // document loaded and nobody has looked at -- the earlier one goes first.
+  std::ranges::stable_sort(order, {}, [candidates](const std::size_t i) {
+    return candidates[i].lastSeen;
+  });
+  for (const auto i : order) {
+    if (!overBudget(deviceBytes)) {
+      break;
+    }
+    chosen.push_back(i);
+    deviceBytes -= std::min(deviceBytes, candidates[i].bytes);
+  }
+  counts.evictions += chosen.size();
+  return chosen;
+}
+
+} // namespace gleditor
+
+// vi: set sw=2 sts=2 ts=2 et:
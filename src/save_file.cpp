@@ -0,0 +1,190 @@
+/**
+ * @file save_file.cpp
+ * @brief The two ways of writing a document described in save_file.hpp.
+ */
+#include <gleditor/save_file.hpp> // IWYU pragma: associated
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <gleditor/piece_table.hpp>
+
+namespace {
+
+using gleditor::FileStamp;
+using gleditor::PieceTable;
+using gleditor::SaveMethod;
+using gleditor::SaveOutcome;
+using gleditor::SaveRequest;
+
+using File = std::unique_ptr<std::FILE, int (*)(std::FILE *)>;
+
+File openFile(const std::filesystem::path &path, const char *mode) {
+#ifdef _WIN32
+  // The wide name, since a narrow one on Windows is in the code page and not
+  // UTF-8, and mode strings are ASCII either way.
+  const std::wstring wideMode(mode, mode + std::strlen(mode));
+  return {_wfopen(path.c_str(), wideMode.c_str()), std::fclose};
+#else
+  return {std::fopen(path.c_str(), mode), std::fclose};
+#endif
+}
+
+/// Everything written to @p file so far, on the disk rather than on its way.
+bool flushToDisk(std::FILE *file) {
+  if (0 != std::fflush(file)) {
+    return false;
+  }
+#ifdef _WIN32
+  return 0 == _commit(_fileno(file));
+#else
+  return 0 == fsync(fileno(file));
+#endif
+}
+
+/// Write @p text from @p offset on to @p file, where it stands.
+bool writeFrom(std::FILE *file, const PieceTable::Snapshot &text,
+               const std::uint64_t offset) {
+  bool ok = true;
+  text.forEachRun(offset, text.size(), [file, &ok](const std::string_view run) {
+    ok = run.size() == std::fwrite(run.data(), 1, run.size(), file);
+    return ok;
+  });
+  return ok;
+}
+
+std::string describe(const std::string_view what,
+                     const std::filesystem::path &path, const int error) {
+  return std::string(what) + " " + path.string() + ": " +
+         std::generic_category().message(error);
+}
+
+/// A name beside @p path that no other save will pick.
+std::filesystem::path temporaryBeside(const std::filesystem::path &path) {
+  static std::mutex lock;
+  static std::mt19937_64 random{std::random_device{}()};
+  const std::lock_guard guard(lock);
+  auto name = path;
+  name += "." + std::to_string(random()) + ".tmp";
+  return name;
+}
+
+SaveOutcome replace(const PieceTable::Snapshot &text,
+                    const std::filesystem::path &path) {
+  SaveOutcome outcome;
+  outcome.method = SaveMethod::replace;
+  const auto temporary = temporaryBeside(path);
+  {
+    const auto file = openFile(temporary, "wb");
+    if (!file) {
+      outcome.error = describe("cannot create", temporary, errno);
+      return outcome;
+    }
+    if (!writeFrom(file.get(), text, 0) || !flushToDisk(file.get())) {
+      outcome.error = describe("cannot write", temporary, errno);
+    }
+  }
+  std::error_code err;
+  if (outcome.ok()) {
+    // A new file, so the old one's permissions are not inherited; copied
+    // across so that saving never makes a file any more or less readable.
+    if (const auto old = std::filesystem::status(path, err);
+        std::filesystem::exists(old)) {
+      std::filesystem::permissions(temporary, old.permissions(), err);
+    }
+    std::filesystem::rename(temporary, path, err);
+    if (err) {
+      outcome.error = describe("cannot replace", path, err.value());
+    }
+  }
+  if (!outcome.ok()) {
+    std::filesystem::remove(temporary, err);
+    return outcome;
+  }
+  outcome.written = text.size();
+  return outcome;
+}
+
+SaveOutcome rewriteTail(const PieceTable::Snapshot &text,
+                        const std::filesystem::path &path,
+                        const std::uint64_t from) {
+  SaveOutcome outcome;
+  outcome.method = SaveMethod::tail;
+  // Sized first, so that one flush covers the length and the bytes.
+  std::error_code err;
+  std::filesystem::resize_file(path, text.size(), err);
+  if (err) {
+    outcome.error = describe("cannot resize", path, err.value());
+    return outcome;
+  }
+  const auto file = openFile(path, "r+b");
+  if (!file) {
+    outcome.error = describe("cannot open", path, errno);
+    return outcome;
+  }
+  if (0 != std::fseek(file.get(), static_cast<long>(from), SEEK_SET) ||
+      !writeFrom(file.get(), text, from) || !flushToDisk(file.get())) {
+    outcome.error = describe("cannot write", path, errno);
+    return outcome;
+  }
+  outcome.written = text.size() - from;
+  return outcome;
+}
+
+} // namespace
+
+namespace gleditor {
+
+std::optional<FileStamp> stampOf(const std::filesystem::path &path) {
+  std::error_code err;
+  const auto bytes = std::filesystem::file_size(path, err);
+  if (err) {
+    return std::nullopt;
+  }
+  const auto modified = std::filesystem::last_write_time(path, err);
+  if (err) {
+    return std::nullopt;
+  }
+  return FileStamp{.bytes = bytes, .modified = modified};
+}
+
+SaveOutcome saveText(const PieceTable::Snapshot &text,
+                     const SaveRequest &request) {
+  // The tail is worth rewriting only when the file is the one the unchanged
+  // bytes were counted against, and when there is a head to leave alone: from
+  // the first byte, it is a replace without the safety. Never over a file the
+  // text is still reading, which would rewrite the very bytes it writes from.
+  const auto from = std::min<std::uint64_t>(request.unchanged, text.size());
+  const bool tail = request.inPlace && !request.mapsFile && request.expected &&
+                    0 < from && stampOf(request.path) == request.expected &&
+                    from <= request.expected->bytes;
+  auto outcome = tail ? rewriteTail(text, request.path, from)
+                      : replace(text, request.path);
+  if (outcome.ok()) {
+    if (const auto stamp = stampOf(request.path)) {
+      outcome.stamp = *stamp;
+    }
+  }
+  return outcome;
+}
+
+} // namespace gleditor
+
+// vi: set sw=2 sts=2 ts=2 et:
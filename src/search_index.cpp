@@ -0,0 +1,793 @@
+/**
+ * @file search_index.cpp
+ * @brief Finding a pattern in a text, and keeping what was found true as the
+ *        text changes.
+ */
+#include <gleditor/search_index.hpp> // IWYU pragma: associated
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <regex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) &&        \
+    defined(__SSE2__)
+#define GLEDITOR_SEARCH_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define GLEDITOR_SEARCH_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+using gleditor::SearchHit;
+using gleditor::Utf8Kernel;
+
+/// Below this, loading the vectors costs more than looking a byte at a time.
+constexpr std::size_t vectorMinimumBytes = 64;
+
+const unsigned char *bytesOf(const std::string_view text) {
+  return reinterpret_cast<const unsigned char *>(text.data());
+}
+
+/// Whether the bytes between the first and the last of @p needle are at
+/// @p at + 1 -- the two ends having been compared already.
+bool middleMatches(const unsigned char *bytes, const std::size_t at,
+                   const std::string_view needle) {
+  return needle.size() <= 2 ||
+         0 == std::memcmp(bytes + at + 1, needle.data() + 1,
+                          needle.size() - 2);
+}
+
+std::size_t scalarFind(const std::string_view haystack,
+                       const std::string_view needle, const std::size_t from) {
+  return haystack.find(needle, from);
+}
+
+#if defined(GLEDITOR_SEARCH_X86)
+
+std::size_t sse2Find(const std::string_view haystack,
+                     const std::string_view needle, std::size_t pos) {
+  const auto *bytes = bytesOf(haystack);
+  const auto tail   = needle.size() - 1;
+  const auto first  = _mm_set1_epi8(needle.front());
+  const auto last   = _mm_set1_epi8(needle.back());
+  // Sixteen places a match could start, tested on the byte each would start
+  // with and the byte each would end with.
+  for (; pos + tail + 16 <= haystack.size(); pos += 16) {
+    const auto starts =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + pos));
+    const auto ends = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(bytes + pos + tail));
+    auto candidates = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(
+        _mm_cmpeq_epi8(starts, first), _mm_cmpeq_epi8(ends, last))));
+    for (; 0 != candidates; candidates &= candidates - 1) {
+      const auto at = pos + static_cast<std::size_t>(__builtin_ctz(candidates));
+      if (middleMatches(bytes, at, needle)) {
+        return at;
+      }
+    }
+  }
+  return scalarFind(haystack, needle, pos);
+}
+
+#define GLEDITOR_AVX2 __attribute__((target("avx2")))
+
+GLEDITOR_AVX2 std::size_t avx2Find(const std::string_view haystack,
+                                   const std::string_view needle,
+                                   std::size_t pos) {
+  const auto *bytes = bytesOf(haystack);
+  const auto tail   = needle.size() - 1;
+  const auto first  = _mm256_set1_epi8(needle.front());
+  const auto last   = _mm256_set1_epi8(needle.back());
+  for (; pos + tail + 32 <= haystack.size(); pos += 32) {
+    const auto starts =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bytes + pos));
+    const auto ends = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(bytes + pos + tail));
+    auto candidates = static_cast<unsigned>(
+        _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(starts, first),
+                                              _mm256_cmpeq_epi8(ends, last))));
+    for (; 0 != candidates; candidates &= candidates - 1) {
+      const auto at = pos + static_cast<std::size_t>(__builtin_ctz(candidates));
+      if (middleMatches(bytes, at, needle)) {
+        return at;
+      }
+    }
+  }
+  return sse2Find(haystack, needle, pos);
+}
+
+#endif // GLEDITOR_SEARCH_X86
+
+#if defined(GLEDITOR_SEARCH_NEON)
+
+std::size_t neonFind(const std::string_view haystack,
+                     const std::string_view needle, std::size_t pos) {
+  const auto *bytes = bytesOf(haystack);
+  const auto tail   = needle.size() - 1;
+  const auto first  = vdupq_n_u8(static_cast<std::uint8_t>(needle.front()));
+  const auto last   = vdupq_n_u8(static_cast<std::uint8_t>(needle.back()));
+  for (; pos + tail + 16 <= haystack.size(); pos += 16) {
+    const auto both = vandq_u8(vceqq_u8(vld1q_u8(bytes + pos), first),
+                               vceqq_u8(vld1q_u8(bytes + pos + tail), last));
+    // No movemask on ARM: narrowing each lane to four bits gives a mask of
+    // sixty-four, a nibble per place.
+    auto candidates = vget_lane_u64(
+        vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(both), 4)), 0);
+    while (0 != candidates) {
+      const auto place =
+          static_cast<std::size_t>(__builtin_ctzll(candidates)) / 4;
+      if (middleMatches(bytes, pos + place, needle)) {
+        return pos + place;
+      }
+      candidates &= ~(std::uint64_t{0xF} << (place * 4));
+    }
+  }
+  return scalarFind(haystack, needle, pos);
+}
+
+#endif // GLEDITOR_SEARCH_NEON
+
+/// Whether @p hit reaches into [@p from, @p to), or across @p from when the
+/// two are the same.
+bool reaches(const SearchHit &hit, const std::uint32_t from,
+             const std::uint32_t to) {
+  return hit.start < std::max(to, from) && hit.end > from;
+}
+
+bool earlier(const SearchHit &left, const SearchHit &right) {
+  return left.start != right.start ? left.start < right.start
+                                   : left.end < right.end;
+}
+
+/// Move @p hits, in order, through an edit; see SearchHits::edit().
+void moveThrough(std::vector<SearchHit> &hits, const std::uint32_t at,
+                 const std::uint32_t removed, const std::uint32_t inserted) {
+  const auto after = at + removed;
+  std::erase_if(hits, [&](const SearchHit &hit) {
+    return hit.start < after && hit.end > at;
+  });
+  for (auto &hit : hits) {
+    if (hit.start >= after) {
+      hit.start = hit.start - removed + inserted;
+      hit.end   = hit.end - removed + inserted;
+    }
+  }
+}
+
+/// Where the line holding @p at begins, looking no further back than
+/// @p limit bytes.
+std::uint32_t lineStart(const gleditor::PieceTable &text, std::uint32_t at,
+                        const std::uint32_t limit) {
+  const auto floor = at > limit ? at - limit : 0U;
+  std::string scratch;
+  // Widening steps, since the newline is usually a few dozen bytes back and
+  // is occasionally not there at all.
+  for (std::uint32_t step = 256; at > floor; step *= 16) {
+    const auto from = at - std::min(step, at - floor);
+    const auto run  = text.slice(from, at - from, scratch);
+    if (const auto found = run.rfind('\n'); std::string_view::npos != found) {
+      return from + static_cast<std::uint32_t>(found) + 1;
+    }
+    at = from;
+  }
+  return floor;
+}
+
+/// Where the line holding @p at ends, before its newline, looking no further
+/// on than @p limit bytes.
+std::uint32_t lineEnd(const gleditor::PieceTable &text, std::uint32_t at,
+                      const std::uint32_t limit) {
+  const auto size    = static_cast<std::uint32_t>(text.size());
+  const auto ceiling = size - at > limit ? at + limit : size;
+  std::string scratch;
+  for (std::uint32_t step = 256; at < ceiling; step *= 16) {
+    const auto to  = at + std::min(step, ceiling - at);
+    const auto run = text.slice(at, to - at, scratch);
+    if (const auto found = run.find('\n'); std::string_view::npos != found) {
+      return at + static_cast<std::uint32_t>(found);
+    }
+    at = to;
+  }
+  return ceiling;
+}
+
+} // namespace
+
+namespace gleditor {
+
+std::size_t findLiteral(const std::string_view haystack,
+                        const std::string_view needle, const std::size_t from) {
+  static const Utf8Kernel best = utf8Kernel();
+  return findLiteral(haystack, needle, from, best);
+}
+
+std::size_t findLiteral(const std::string_view haystack,
+                        const std::string_view needle, const std::size_t from,
+                        const Utf8Kernel kernel) {
+  // One byte is what memchr() is for, and the library's is already vector
+  // code.
+  if (needle.size() < 2 || from >= haystack.size() ||
+      haystack.size() - from < vectorMinimumBytes) {
+    return scalarFind(haystack, needle, from);
+  }
+  const auto kernels = utf8Kernels();
+  switch (std::ranges::find(kernels, kernel) != kernels.end()
+              ? kernel
+              : Utf8Kernel::scalar) {
+#if defined(GLEDITOR_SEARCH_X86)
+  case Utf8Kernel::sse2:
+    return sse2Find(haystack, needle, from);
+  case Utf8Kernel::avx2:
+    return avx2Find(haystack, needle, from);
+#elif defined(GLEDITOR_SEARCH_NEON)
+  case Utf8Kernel::neon:
+    return neonFind(haystack, needle, from);
+#endif
+  default:
+    return scalarFind(haystack, needle, from);
+  }
+}
+
+SearchPattern SearchPattern::literal(std::string bytes) {
+  SearchPattern pattern;
+  pattern.text = std::move(bytes);
+  return pattern;
+}
+
+SearchPattern SearchPattern::expression(std::string source,
+                                        const bool ignoreCase) {
+  SearchPattern pattern;
+  auto flags = std::regex::ECMAScript | std::regex::optimize;
+  if (ignoreCase) {
+    flags |= std::regex::icase;
+  }
+  pattern.compiled.emplace(source, flags);
+  pattern.text = std::move(source);
+  return pattern;
+}
+
+std::uint32_t SearchPattern::reach() const {
+  return linewise() || text.empty()
+             ? 0U
+             : static_cast<std::uint32_t>(text.size() - 1);
+}
+
+void SearchPattern::find(const std::string_view run, const std::uint32_t base,
+                         std::vector<SearchHit> &out) const {
+  if (text.empty()) {
+    return;
+  }
+  if (!linewise()) {
+    const auto length = static_cast<std::uint32_t>(text.size());
+    for (auto at = findLiteral(run, text, 0); std::string_view::npos != at;
+         at = findLiteral(run, text, at + 1)) {
+      const auto start = base + static_cast<std::uint32_t>(at);
+      out.push_back(SearchHit{start, start + length});
+    }
+    return;
+  }
+  for (std::size_t begin = 0; begin <= run.size();) {
+    auto end = run.find('\n', begin);
+    if (std::string_view::npos == end) {
+      end = run.size();
+    }
+    findInLine(run, begin, end, base, out);
+    begin = end + 1;
+  }
+}
+
+void SearchPattern::findInLine(const std::string_view run,
+                               const std::size_t begin, const std::size_t end,
+                               const std::uint32_t base,
+                               std::vector<SearchHit> &out) const {
+  for (auto from = begin;;) {
+    auto to = std::min(end, from + expressionWindow);
+    // Never through the middle of a character, which no expression of
+    // characters could match the halves of.
+    while (to < end && to > from + 1 &&
+           0x80 == (static_cast<unsigned char>(run[to]) & 0xC0)) {
+      to--;
+    }
+    const auto last = to == end;
+    // A match starting past here is the next window's, which sees more of
+    // where it goes on.
+    const auto keep =
+        last ? to : from + std::max<std::size_t>(1, (to - from) / 2);
+    // What is before the window is there to be looked at, for ^ and \b, and
+    // where it stops is neither the end of the line nor of a word unless it
+    // is.
+    auto flags = std::regex_constants::match_default;
+    if (from != begin) {
+      flags |= std::regex_constants::match_prev_avail;
+    }
+    if (!last) {
+      flags |= std::regex_constants::match_not_eol |
+               std::regex_constants::match_not_eow;
+    }
+    auto next = keep;
+    for (std::cregex_iterator match(run.data() + from, run.data() + to,
+                                    *compiled, flags),
+         done;
+         match != done; ++match) {
+      const auto at = from + static_cast<std::size_t>(match->position());
+      if (at >= keep) {
+        break;
+      }
+      if (0 == match->length()) {
+        continue;
+      }
+      const auto length = static_cast<std::size_t>(match->length());
+      const auto start  = base + static_cast<std::uint32_t>(at);
+      out.push_back(
+          SearchHit{start, start + static_cast<std::uint32_t>(length)});
+      next = std::max(keep, at + length);
+    }
+    if (last) {
+      return;
+    }
+    from = next;
+  }
+}
+
+SearchHit SearchHits::placed(const Block &block, const std::size_t i) {
+  const auto &hit = block.hits[i];
+  return SearchHit{static_cast<std::uint32_t>(hit.start + block.shift),
+                   static_cast<std::uint32_t>(hit.end + block.shift)};
+}
+
+void SearchHits::settle(Block &block) {
+  if (0 == block.shift) {
+    return;
+  }
+  for (std::size_t i = 0; i < block.hits.size(); i++) {
+    block.hits[i] = placed(block, i);
+  }
+  block.shift = 0;
+}
+
+void SearchHits::clear() {
+  blocks.clear();
+  count = 0;
+}
+
+std::size_t SearchHits::firstEndingAfter(const std::uint32_t offset) const {
+  return static_cast<std::size_t>(std::distance(
+      blocks.begin(),
+      std::ranges::partition_point(blocks, [&](const Block &block) {
+        return placed(block, block.hits.size() - 1).end <= offset;
+      })));
+}
+
+void SearchHits::split(const std::size_t index) {
+  if (blocks[index].hits.size() < 2 * blockSize) {
+    return;
+  }
+  settle(blocks[index]);
+  auto whole = std::move(blocks[index].hits);
+  std::vector<Block> pieces;
+  for (std::size_t at = 0; at < whole.size(); at += blockSize) {
+    const auto end = std::min(whole.size(), at + blockSize);
+    pieces.push_back(Block{{whole.begin() + static_cast<std::ptrdiff_t>(at),
+                            whole.begin() + static_cast<std::ptrdiff_t>(end)},
+                           0});
+  }
+  const auto where = blocks.begin() + static_cast<std::ptrdiff_t>(index);
+  *where           = std::move(pieces.front());
+  blocks.insert(where + 1, std::make_move_iterator(pieces.begin() + 1),
+                std::make_move_iterator(pieces.end()));
+}
+
+bool SearchHits::removeIfEmpty(const std::size_t index) {
+  if (!blocks[index].hits.empty()) {
+    return false;
+  }
+  blocks.erase(blocks.begin() + static_cast<std::ptrdiff_t>(index));
+  return true;
+}
+
+void SearchHits::add(const std::span<const SearchHit> found) {
+  if (blocks.empty() && !found.empty()) {
+    blocks.push_back(Block{{found.begin(), found.end()}, 0});
+    count = found.size();
+    split(0);
+    return;
+  }
+  for (std::size_t i = 0; i < found.size();) {
+    // The block these go into is the last one starting no later than the
+    // first of them, and they run up to where the block after it starts.
+    auto index = static_cast<std::size_t>(std::distance(
+        blocks.begin(),
+        std::ranges::partition_point(blocks, [&](const Block &block) {
+          return !earlier(found[i], placed(block, 0));
+        })));
+    index      = 0 == index ? 0 : index - 1;
+    auto upto  = found.size();
+    if (index + 1 < blocks.size()) {
+      const auto next = placed(blocks[index + 1], 0);
+      upto            = static_cast<std::size_t>(std::distance(
+          found.begin(),
+          std::partition_point(found.begin() + static_cast<std::ptrdiff_t>(i),
+                               found.end(), [&](const SearchHit &hit) {
+                                 return earlier(hit, next);
+                               })));
+    }
+    auto &block = blocks[index];
+    settle(block);
+    const auto taken = found.subspan(i, upto - i);
+    if (block.hits.empty() || earlier(block.hits.back(), taken.front())) {
+      // The whole of a search arriving chunk by chunk lands here: after
+      // everything already found.
+      block.hits.insert(block.hits.end(), taken.begin(), taken.end());
+    } else {
+      std::vector<SearchHit> merged;
+      merged.reserve(block.hits.size() + taken.size());
+      std::ranges::merge(block.hits, taken, std::back_inserter(merged),
+                         earlier);
+      block.hits = std::move(merged);
+    }
+    count += taken.size();
+    split(index);
+    i = upto;
+  }
+}
+
+void SearchHits::edit(const std::uint32_t at, const std::uint32_t removed,
+                      const std::uint32_t inserted) {
+  const auto after = at + removed;
+  auto index       = firstEndingAfter(at);
+  // The blocks the edit reaches into are rewritten; the rest are moved whole.
+  for (; index < blocks.size() && placed(blocks[index], 0).start < after;) {
+    auto &block = blocks[index];
+    settle(block);
+    const auto before = block.hits.size();
+    moveThrough(block.hits, at, removed, inserted);
+    count -= before - block.hits.size();
+    if (!removeIfEmpty(index)) {
+      index++;
+    }
+  }
+  for (; index < blocks.size(); index++) {
+    blocks[index].shift += std::int64_t{inserted} - std::int64_t{removed};
+  }
+}
+
+void SearchHits::drop(const std::uint32_t from, const std::uint32_t to) {
+  for (auto index = firstEndingAfter(from);
+       index < blocks.size() &&
+       placed(blocks[index], 0).start < std::max(from, to);) {
+    auto &block = blocks[index];
+    settle(block);
+    count -= std::erase_if(block.hits, [&](const SearchHit &hit) {
+      return reaches(hit, from, to);
+    });
+    if (!removeIfEmpty(index)) {
+      index++;
+    }
+  }
+}
+
+std::optional<SearchHit>
+SearchHits::firstFrom(const std::uint32_t offset) const {
+  const auto index = static_cast<std::size_t>(std::distance(
+      blocks.begin(),
+      std::ranges::partition_point(blocks, [&](const Block &block) {
+        return placed(block, block.hits.size() - 1).start < offset;
+      })));
+  if (index == blocks.size()) {
+    return std::nullopt;
+  }
+  const auto &block = blocks[index];
+  std::size_t low   = 0;
+  std::size_t high  = block.hits.size() - 1;
+  while (low < high) {
+    const auto middle = (low + high) / 2;
+    if (placed(block, middle).start < offset) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return placed(block, low);
+}
+
+std::optional<SearchHit>
+SearchHits::lastBefore(const std::uint32_t offset) const {
+  auto index = static_cast<std::size_t>(std::distance(
+      blocks.begin(),
+      std::ranges::partition_point(blocks, [&](const Block &block) {
+        return placed(block, 0).start < offset;
+      })));
+  if (0 == index) {
+    return std::nullopt;
+  }
+  const auto &block = blocks[--index];
+  std::size_t low   = 0;
+  std::size_t high  = block.hits.size() - 1;
+  while (low < high) {
+    const auto middle = (low + high + 1) / 2;
+    if (placed(block, middle).start < offset) {
+      low = middle;
+    } else {
+      high = middle - 1;
+    }
+  }
+  return placed(block, low);
+}
+
+std::optional<SearchHit> SearchHits::first() const {
+  return blocks.empty() ? std::nullopt
+                        : std::optional{placed(blocks.front(), 0)};
+}
+
+std::optional<SearchHit> SearchHits::last() const {
+  return blocks.empty() ? std::nullopt
+                        : std::optional{placed(
+                              blocks.back(), blocks.back().hits.size() - 1)};
+}
+
+void SearchHits::within(const std::uint32_t from, const std::uint32_t to,
+                        std::size_t limit, std::vector<SearchHit> &out) const {
+  for (auto index = firstEndingAfter(from); index < blocks.size(); index++) {
+    const auto &block = blocks[index];
+    for (std::size_t i = 0; i < block.hits.size(); i++) {
+      const auto hit = placed(block, i);
+      if (hit.start >= to || 0 == limit) {
+        return;
+      }
+      if (hit.end > from) {
+        out.push_back(hit);
+        limit--;
+      }
+    }
+  }
+}
+
+std::vector<SearchHit> SearchHits::all() const {
+  std::vector<SearchHit> every;
+  every.reserve(count);
+  for (const auto &block : blocks) {
+    for (std::size_t i = 0; i < block.hits.size(); i++) {
+      every.push_back(placed(block, i));
+    }
+  }
+  return every;
+}
+
+SearchIndex::SearchIndex() : worker([this] { workerLoop(); }) {}
+
+SearchIndex::~SearchIndex() {
+  {
+    const std::lock_guard lock(mutex);
+    stopping = true;
+    search++;
+  }
+  wake.notify_all();
+  worker.join();
+}
+
+void SearchIndex::start(const PieceTable &text, SearchPattern pattern) {
+  stop();
+  if (pattern.empty()) {
+    return;
+  }
+  current = std::make_shared<const SearchPattern>(std::move(pattern));
+  const auto size = static_cast<std::uint32_t>(text.size());
+  queue(text, 0, size, 0, size);
+}
+
+void SearchIndex::stop() {
+  {
+    const std::lock_guard lock(mutex);
+    search++;
+    jobs.clear();
+    batches.clear();
+  }
+  current.reset();
+  found.clear();
+  journal.clear();
+  outstanding = 0;
+}
+
+void SearchIndex::inserted(const PieceTable &text, const std::uint32_t at,
+                           const std::uint32_t bytes) {
+  changed(text, at, 0, bytes);
+}
+
+void SearchIndex::erased(const PieceTable &text, const std::uint32_t at,
+                         const std::uint32_t bytes) {
+  changed(text, at, bytes, 0);
+}
+
+void SearchIndex::changed(const PieceTable &text, const std::uint32_t at,
+                          const std::uint32_t removed,
+                          const std::uint32_t inserted) {
+  generation++;
+  if (!current) {
+    return;
+  }
+  // What the edit can have changed: for a literal, a match that includes any
+  // of the new text or runs across the place text was taken from; for an
+  // expression, anything on the lines the edit is on.
+  auto from = at;
+  auto to   = at + inserted;
+  if (current->linewise()) {
+    from = lineStart(text, from, lineLimit);
+    to   = lineEnd(text, to, lineLimit);
+  }
+  found.edit(at, removed, inserted);
+  found.drop(from, to);
+  if (0 != outstanding) {
+    journal.push_back(Edit{generation, at, removed, inserted, from, to});
+  }
+
+  const auto size     = static_cast<std::uint32_t>(text.size());
+  const auto reach    = current->reach();
+  const auto scanFrom = from > reach ? from - reach : 0U;
+  const auto scanTo   = std::min(size, std::max(to, from) + reach);
+  if (scanTo - scanFrom <= inlineBytes) {
+    searchNow(text, scanFrom, scanTo, from, to);
+  } else {
+    queue(text, scanFrom, scanTo, from, to);
+  }
+}
+
+void SearchIndex::searchNow(const PieceTable &text, const std::uint32_t from,
+                            const std::uint32_t to,
+                            const std::uint32_t keepFrom,
+                            const std::uint32_t keepTo) {
+  std::string scratch;
+  std::vector<SearchHit> hits;
+  current->find(text.slice(from, to - from, scratch), from, hits);
+  std::erase_if(hits, [&](const SearchHit &hit) {
+    return !reaches(hit, keepFrom, keepTo);
+  });
+  found.add(hits);
+}
+
+void SearchIndex::queue(const PieceTable &text, const std::uint32_t scanFrom,
+                        const std::uint32_t scanTo,
+                        const std::uint32_t keepFrom,
+                        const std::uint32_t keepTo) {
+  {
+    const std::lock_guard lock(mutex);
+    jobs.push_back(Job{search, generation, current, text.snapshot(), scanFrom,
+                       scanTo, keepFrom, keepTo});
+  }
+  outstanding++;
+  wake.notify_one();
+}
+
+bool SearchIndex::collect(const std::size_t limit) {
+  std::vector<Batch> arrived;
+  {
+    const std::lock_guard lock(mutex);
+    std::size_t taken = 0;
+    std::size_t hits  = 0;
+    while (taken < batches.size() && (0 == taken || hits < limit)) {
+      hits += batches[taken++].hits.size();
+    }
+    arrived.assign(std::make_move_iterator(batches.begin()),
+                   std::make_move_iterator(batches.begin() +
+                                           static_cast<std::ptrdiff_t>(taken)));
+    batches.erase(batches.begin(),
+                  batches.begin() + static_cast<std::ptrdiff_t>(taken));
+  }
+  bool changed = false;
+  for (auto &batch : arrived) {
+    // A stop() or a start() since the batch was found makes it an answer to
+    // a question nobody is asking now.
+    if (!current || batch.search != search) {
+      continue;
+    }
+    // Found in the text as it was, and moved through every edit since to
+    // where it is now. A window an edit left to be searched again was
+    // searched again, so what reaches into it is dropped here rather than
+    // found twice.
+    for (const auto &edit : journal) {
+      if (edit.generation > batch.generation) {
+        moveThrough(batch.hits, edit.at, edit.removed, edit.inserted);
+        std::erase_if(batch.hits, [&](const SearchHit &hit) {
+          return reaches(hit, edit.from, edit.to);
+        });
+      }
+    }
+    changed = changed || !batch.hits.empty();
+    found.add(batch.hits);
+    if (batch.last && 0 == --outstanding) {
+      journal.clear();
+    }
+  }
+  return changed;
+}
+
+void SearchIndex::finish() {
+  {
+    std::unique_lock lock(mutex);
+    idle.wait(lock, [this] { return jobs.empty() && !busy; });
+  }
+  collect(std::numeric_limits<std::size_t>::max());
+}
+
+void SearchIndex::workerLoop() {
+  std::unique_lock lock(mutex);
+  for (;;) {
+    wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+    if (stopping) {
+      return;
+    }
+    auto job = std::move(jobs.front());
+    jobs.pop_front();
+    busy = true;
+    lock.unlock();
+    scan(job);
+    lock.lock();
+    busy = false;
+    idle.notify_all();
+  }
+}
+
+void SearchIndex::scan(const Job &job) {
+  const auto &pattern = *job.pattern;
+  const auto reach    = pattern.reach();
+  std::string buffer;
+  for (auto pos = job.scanFrom; pos < job.scanTo;) {
+    // A literal's chunk is read a match's length long, so that one starting
+    // near its end is found whole; the next chunk starts where this one's
+    // starts stopped. An expression's is cut after its last newline, so that
+    // no line is matched in two halves.
+    const auto end  = std::min(job.scanTo, pos + chunkBytes);
+    const auto read = std::min(job.scanTo - pos, end - pos + reach);
+    buffer.clear();
+    job.text.forEachRun(pos, read, [&](const std::string_view run) {
+      buffer.append(run);
+      return true;
+    });
+    auto advance = end - pos;
+    if (pattern.linewise() && end < job.scanTo) {
+      if (const auto cut = buffer.rfind('\n'); std::string::npos != cut) {
+        advance = static_cast<std::uint32_t>(cut) + 1;
+      }
+    }
+    Batch batch{job.search, job.generation, {}, false};
+    pattern.find(std::string_view(buffer).substr(0, pattern.linewise()
+                                                        ? advance
+                                                        : buffer.size()),
+                 pos, batch.hits);
+    std::erase_if(batch.hits, [&](const SearchHit &hit) {
+      return hit.start >= pos + advance ||
+             !reaches(hit, job.keepFrom, job.keepTo);
+    });
+    pos += advance;
+    batch.last = pos >= job.scanTo;
+
+    const std::lock_guard lock(mutex);
+    if (job.search != search) {
+      return;
+    }
+    batches.push_back(std::move(batch));
+  }
+  if (job.scanFrom == job.scanTo) {
+    const std::lock_guard lock(mutex);
+    if (job.search == search) {
+      batches.push_back(Batch{job.search, job.generation, {}, true});
+    }
+  }
+}
+
+} // namespace gleditor
+
+// vi: set sw=2 sts=2 ts=2 et:
@@ -0,0 +1,136 @@
+/**
+ * @file text_search.cpp
+ * @brief A search of one open document, shown as highlights.
+ */
+#include <gleditor/text_search.hpp> // IWYU pragma: associated
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gleditor/doc.hpp>
+#include <gleditor/render/types.hpp>
+
+namespace gleditor {
+
+TextSearch::~TextSearch() { stop(); }
+
+void TextSearch::search(const std::shared_ptr<Doc> &doc,
+                        SearchPattern pattern) {
+  stop();
+  if (!doc) {
+    return;
+  }
+  target  = doc;
+  watched = doc.get();
+  doc->addObserver(this);
+  index.start(doc->contents(), std::move(pattern));
+}
+
+void TextSearch::stop() {
+  if (const auto doc = target.lock()) {
+    doc->removeObserver(this);
+  }
+  target.reset();
+  watched = nullptr;
+  index.stop();
+}
+
+std::optional<SearchHit> TextSearch::nextHit(const std::uint32_t offset) {
+  index.collect();
+  const auto &hits = index.hits();
+  if (auto hit = hits.firstFrom(offset + 1)) {
+    return hit;
+  }
+  return hits.first();
+}
+
+std::optional<SearchHit>
+TextSearch::previousHit(const std::uint32_t offset) {
+  index.collect();
+  const auto &hits = index.hits();
+  if (auto hit = hits.lastBefore(offset)) {
+    return hit;
+  }
+  return hits.last();
+}
+
+std::optional<TextSearch::PageHit>
+TextSearch::nextPageWithHit(const std::size_t page) {
+  const auto doc = target.lock();
+  if (!doc) {
+    return std::nullopt;
+  }
+  index.collect();
+  const auto *const from = doc->page(page);
+  auto hit               = from ? index.hits().firstFrom(from->baseOffset() +
+                                                          from->textLength())
+                                : std::nullopt;
+  if (!hit) {
+    hit = index.hits().first();
+  }
+  if (!hit) {
+    return std::nullopt;
+  }
+  const auto anchor = doc->anchorFor(hit->start);
+  return anchor ? std::optional{PageHit{anchor->pageIndex, *hit}}
+                : std::nullopt;
+}
+
+void TextSearch::textInserted(Doc &doc, const std::uint32_t at,
+                              const std::string &utf8) {
+  if (&doc == watched && !target.expired()) {
+    index.inserted(doc.contents(), at, static_cast<std::uint32_t>(utf8.size()));
+  }
+}
+
+void TextSearch::textErased(Doc &doc, const std::uint32_t at,
+                            const std::string &removed) {
+  if (&doc == watched && !target.expired()) {
+    index.erased(doc.contents(), at,
+                 static_cast<std::uint32_t>(removed.size()));
+  }
+}
+
+void TextSearch::decorate(const Doc &doc, std::vector<SpanStyle> &out) {
+  // A pointer compared, not the document locked, since this is asked once per
+  // open document per frame. One closed and another opened at its address is
+  // what the second test is for.
+  if (&doc != watched || target.expired()) {
+    return;
+  }
+  index.collect();
+  const auto view = doc.textInView();
+  if (!view) {
+    return;
+  }
+
+  // What is in view first, then what is either side of it: the view is as of
+  // the last frame, and the table the shader reads has room for so few ranges
+  // that the ones nobody can see yet must not crowd out the ones they can.
+  const auto [from, to] = *view;
+  const auto margin     = (to - from) / 4;
+  const auto room = [this] {
+    return static_cast<std::size_t>(render::maxHighlightRanges) - shown.size();
+  };
+  shown.clear();
+  index.hits().within(from, to, room(), shown);
+  index.hits().within(to, to + margin, room(), shown);
+  index.hits().within(from > margin ? from - margin : 0, from, room(), shown);
+  // A hit across either edge of the view is found twice.
+  std::ranges::sort(shown, {}, &SearchHit::start);
+  const auto repeated = std::ranges::unique(shown);
+  shown.erase(repeated.begin(), repeated.end());
+  for (const auto &hit : shown) {
+    out.push_back(SpanStyle{hit.start, hit.end, hitColour});
+  }
+}
+
+} // namespace gleditor
+
+// vi: set sw=2 sts=2 ts=2 et:
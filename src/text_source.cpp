@@ -1,8 +1,14 @@
+#include <chrono>
 #include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <optional>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <utility>
 
+#include <glib.h>
 #include <glibmm/fileutils.h>
 
 #include <gleditor/text_source.hpp>
@@ -12,11 +18,11 @@ namespace {
 /// Byte at @p index widened through unsigned char. `char` is signed on most
 /// targets, so comparing a raw one against 0xEF or 0xFF is never true and
 /// silently disables mark detection.
-unsigned char byteAt(const std::string &str, const std::size_t index) {
+unsigned char byteAt(const std::string_view str, const std::size_t index) {
   return static_cast<unsigned char>(str[index]);
 }
 
-bool startsWith(const std::string &str,
+bool startsWith(const std::string_view str,
                 const std::initializer_list<unsigned char> mark) {
   if (str.size() < mark.size()) {
     return false;
@@ -30,13 +36,35 @@ bool startsWith(const std::string &str,
   return true;
 }
 
+/**
+ * @brief How long a file has to have gone unwritten to be mapped rather than
+ *        read.
+ *
+ * A mapped file that somebody else shortens takes pages out from under the
+ * mapping, and reading one of them is SIGBUS rather than an error: the editor
+ * is gone. The files that happens to are the ones still being written -- a log
+ * that logrotate copies and truncates, say -- and those are the ones written
+ * to in the last moments before they were opened.
+ */
+constexpr std::chrono::seconds mapAfterQuiet{60};
+
+/// Whether @p path has gone unwritten for mapAfterQuiet. A file that cannot be
+/// asked counts as settled, so that opening it reports why it cannot be.
+bool settled(const std::string &path) {
+  std::error_code err;
+  const auto modified = std::filesystem::last_write_time(path, err);
+  return err ||
+         std::filesystem::file_time_type::clock::now() - modified >=
+             mapAfterQuiet;
+}
+
 } // namespace
 
 namespace gleditor {
 
-std::string stripByteOrderMark(std::string bytes) {
+std::size_t byteOrderMarkLength(const std::string_view bytes) {
   if (startsWith(bytes, {0xEF, 0xBB, 0xBF})) {
-    return bytes.substr(3);
+    return 3;
   }
   // Tested before UTF-16, because a little-endian UTF-32 mark begins with the
   // whole of a little-endian UTF-16 one: checking the shorter first would
@@ -48,13 +76,53 @@ std::string stripByteOrderMark(std::string bytes) {
   if (startsWith(bytes, {0xFE, 0xFF}) || startsWith(bytes, {0xFF, 0xFE})) {
     throw std::logic_error("utf16 not supported yet");
   }
+  return 0;
+}
+
+std::string stripByteOrderMark(std::string bytes) {
+  // Erased in place: substr() here was a second copy of the whole file.
+  bytes.erase(0, byteOrderMarkLength(bytes));
   return bytes;
 }
 
 std::string FileTextSource::text() const {
+  if (const auto shared = share()) {
+    return std::string(shared->bytes);
+  }
   return stripByteOrderMark(Glib::file_get_contents(filePath));
 }
 
+std::optional<SharedText> FileTextSource::share() const {
+  if (Access::map != access) {
+    return std::nullopt;
+  }
+  if (!settled(filePath)) {
+    // Still being written, so read, and lent from the copy: a file that is
+    // truncated under its own mapping is a crash the first time a page past
+    // the new end is read, which can be long after opening.
+    const auto copy = std::make_shared<const std::string>(
+        stripByteOrderMark(Glib::file_get_contents(filePath)));
+    return SharedText{.bytes = *copy, .owner = copy};
+  }
+  // GMappedFile rather than mmap(), for the same reason the rest of the file
+  // handling is Glib's: it is the one that works on Windows as well. Mapped
+  // read-only and private, so nothing the document does can reach the file.
+  GError *error       = nullptr;
+  GMappedFile *mapped = g_mapped_file_new(filePath.c_str(), FALSE, &error);
+  if (nullptr == mapped) {
+    // Errors from here are all in the file error domain; the wrapper takes
+    // ownership of the GError.
+    throw Glib::FileError(error);
+  }
+  const std::shared_ptr<GMappedFile> owner(mapped, g_mapped_file_unref);
+
+  // An empty file maps to a null pointer, which a view of no bytes tolerates.
+  std::string_view bytes(g_mapped_file_get_contents(mapped),
+                         g_mapped_file_get_length(mapped));
+  bytes.remove_prefix(byteOrderMarkLength(bytes));
+  return SharedText{.bytes = bytes, .owner = owner};
+}
+
 } // namespace gleditor
 
 // vi: set sw=2 sts=2 ts=2 et:
@@ -8,8 +8,10 @@
 #include <gleditor/animation.hpp>    // for toastFade
 
 #include <algorithm>
+#include <array>
 #include <cmath>
 #include <cstddef>
+#include <memory>
 #include <ranges>
 #include <span>
 #include <string>
@@ -150,7 +152,10 @@ void ToastOverlay::post(const render::DiagnosticSeverity severity,
   const auto panel = panelColour(severity);
   const auto text  = Doc::VBORow::color(236);
 
+  auto citation       = std::make_unique<GlyphCitation>();
+  const auto glyphsAt = state.glyphCache.repacks();
   std::vector<Doc::VBORow> rows;
+  std::vector<std::uint32_t> glyphOfRow{GlyphCache::noGlyph};
   // Row 0 is the panel; the glyphs follow it, drawn over it because the
   // overlay pipeline does not depth test.
   //
@@ -206,7 +211,7 @@ void ToastOverlay::post(const render::DiagnosticSeverity severity,
     const std::string_view chr(raw.data() + cluster.start,
                                static_cast<std::size_t>(length));
 
-    const auto glyph  = state.glyphCache.put(chr, font);
+    const auto glyph  = state.glyphCache.put(chr, font, citation.get());
     const auto width  = static_cast<float>(static_cast<int>(glyph.dims.width));
     const auto height = static_cast<float>(static_cast<int>(glyph.dims.height));
     if (0.0F == width || 0.0F == height) {
@@ -233,6 +238,7 @@ void ToastOverlay::post(const render::DiagnosticSeverity severity,
                                      static_cast<unsigned int>(height),
                                      render::tagKindOverlay),
                     Doc::VBORow::paperAt(panel, 0)});
+    glyphOfRow.push_back(glyph.glyph);
   }
 
   while (toasts.size() >= maxVisible) {
@@ -249,8 +255,44 @@ void ToastOverlay::post(const render::DiagnosticSeverity severity,
   toast.message       = message;
   toast.severity      = severity;
   toast.serial        = ++posted;
+  toast.glyphOfRow    = std::move(glyphOfRow);
+  toast.citation      = std::move(citation);
+  toast.glyphsAt      = glyphsAt;
   pool->write(toast.backing, 0, asBytes(rows));
-  toasts.push_back(toast);
+  toasts.push_back(std::move(toast));
+}
+
+void ToastOverlay::relocateGlyphs(Toast &toast, const RenderState &state) {
+  const auto &glyphs = state.glyphCache;
+  if (toast.glyphsAt == glyphs.committedRepacks()) {
+    return;
+  }
+  std::vector<GlyphCache::Sizes> now(toast.glyphOfRow.size());
+  const auto answered = glyphs.lookUp(toast.glyphOfRow, now);
+  if (!answered) {
+    // Planned but not made yet; the next frame's commit makes it.
+    return;
+  }
+  for (std::uint32_t row = 0; row < now.size(); row++) {
+    const auto &glyph = now[row];
+    if (GlyphCache::noGlyph == glyph.glyph) {
+      continue;
+    }
+    // The two fields post() wrote from where the glyph was.
+    const std::array<unsigned int, 2> fields{
+        Doc::VBORow::atlasAt(
+            static_cast<unsigned int>(glyph.texCoords.topLeft.x),
+            static_cast<unsigned int>(glyph.texCoords.topLeft.y)),
+        Doc::VBORow::box(static_cast<unsigned char>(glyph.layer),
+                         static_cast<unsigned int>(
+                             static_cast<int>(glyph.dims.width)),
+                         static_cast<unsigned int>(
+                             static_cast<int>(glyph.dims.height)),
+                         render::tagKindOverlay)};
+    pool->patch(toast.backing, row, offsetof(Doc::VBORow, atlas),
+                std::as_bytes(std::span(fields)));
+  }
+  toast.glyphsAt = *answered;
 }
 
 void ToastOverlay::describe(gleditor::a11y::Builder &into) {
@@ -349,6 +391,10 @@ void ToastOverlay::draw(RenderState &state, const int screenWidth,
   state.device->bindPipeline(pipeline);
   state.device->bindGlyphTexture(state.glyphCache.textureHandle());
 
+  for (auto &toast : toasts) {
+    relocateGlyphs(toast, state);
+  }
+
   // Newest nearest the corner, older ones stacked above it.
   const auto now = Clock::now();
   float penY     = marginY;
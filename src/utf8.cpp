@@ -1,15 +1,443 @@
+/**
+ * @file utf8.cpp
+ * @brief Character boundaries, and the validating and counting kernels
+ *        described in utf8.hpp.
+ *
+ * The vector validators are the lookup method of Keiser and Lemire
+ * ("Validating UTF-8 In Less Than One Instruction Per Byte", 2021): the two
+ * nibbles of the byte before and the high nibble of the byte itself index
+ * three sixteen-entry tables, and a sequence is bad exactly where the three
+ * entries have a bit in common. None of them work out where a bad sequence
+ * is; a block that fails is handed to the byte loop, which says where, from
+ * the start of the character the block began in.
+ */
 #include <gleditor/utf8.hpp> // IWYU pragma: associated
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
 #include <cstdint>
+#include <span>
 #include <string_view>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) &&        \
+    defined(__SSE2__)
+#define GLEDITOR_UTF8_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define GLEDITOR_UTF8_NEON 1
+#include <arm_neon.h>
+#endif
 
 namespace {
 
-/// Whether the byte at @p offset continues a character rather than starting
-/// one. Continuation bytes are 10xxxxxx.
-bool continues(const std::string_view text, const std::uint32_t offset) {
-  return offset < text.size() &&
-         0x80 == (static_cast<unsigned char>(text[offset]) & 0xC0);
+using gleditor::continuesCharacter;
+using gleditor::Utf8Kernel;
+
+/// Bytes validated and counted at a time. Large enough that the per-chunk
+/// overhead vanishes, small enough to still be in cache when counted.
+constexpr std::size_t scanChunkBytes = std::size_t{256} * 1024;
+
+/// Longest UTF-8 sequence past its lead byte: how far back the start of the
+/// character a block begins in can be.
+constexpr std::size_t maxContinuationBytes = 3;
+
+/// Shorter than this, a vector kernel is all set-up and no loop.
+constexpr std::size_t vectorMinimumBytes = 64;
+
+const unsigned char *bytesOf(const std::string_view text) {
+  return reinterpret_cast<const unsigned char *>(text.data());
+}
+
+/// Length of the valid sequence at @p pos, or zero when it is not one.
+std::size_t sequenceAt(const unsigned char *bytes, const std::size_t size,
+                       const std::size_t pos) {
+  const unsigned lead = bytes[pos];
+  if (lead < 0x80) {
+    return 0 == lead ? 0 : 1;
+  }
+  // The second byte's range is the one that varies: it is what rules out
+  // overlong forms, surrogates and code points past U+10FFFF.
+  std::size_t length = 0;
+  unsigned low       = 0x80;
+  unsigned high      = 0xBF;
+  if (lead >= 0xC2 && lead <= 0xDF) {
+    length = 2;
+  } else if (lead >= 0xE0 && lead <= 0xEF) {
+    length = 3;
+    low    = 0xE0 == lead ? 0xA0 : low;
+    high   = 0xED == lead ? 0x9F : high;
+  } else if (lead >= 0xF0 && lead <= 0xF4) {
+    length = 4;
+    low    = 0xF0 == lead ? 0x90 : low;
+    high   = 0xF4 == lead ? 0x8F : high;
+  } else {
+    return 0;
+  }
+  if (size - pos < length || bytes[pos + 1] < low || bytes[pos + 1] > high) {
+    return 0;
+  }
+  for (std::size_t i = 2; i < length; i++) {
+    if (!continuesCharacter(static_cast<char>(bytes[pos + i]))) {
+      return 0;
+    }
+  }
+  return length;
+}
+
+std::size_t scalarValid(const std::string_view text, std::size_t pos) {
+  const auto *bytes = bytesOf(text);
+  while (pos < text.size()) {
+    const auto length = sequenceAt(bytes, text.size(), pos);
+    if (0 == length) {
+      break;
+    }
+    pos += length;
+  }
+  return pos;
+}
+
+std::size_t scalarCount(const std::string_view text) {
+  return static_cast<std::size_t>(std::ranges::count_if(
+      text, [](const char chr) { return !continuesCharacter(chr); }));
+}
+
+/**
+ * @brief Where the byte loop takes over from a vector kernel stopped at
+ *        @p pos.
+ *
+ * Back at the lead of a multi-byte character @p pos cuts, since the kernel
+ * only vouches for characters it saw the end of; @p pos itself otherwise.
+ */
+std::size_t resumeAt(const std::string_view text, const std::size_t pos) {
+  for (std::size_t back = 1; back <= maxContinuationBytes && back <= pos;
+       back++) {
+    const char byte = text[pos - back];
+    if (!continuesCharacter(byte)) {
+      return 0 != (static_cast<unsigned char>(byte) & 0x80) ? pos - back : pos;
+    }
+  }
+  return pos;
+}
+
+#if defined(GLEDITOR_UTF8_X86) || defined(GLEDITOR_UTF8_NEON)
+
+// The lookup tables. A bit set in all three entries for a byte names what is
+// wrong there; the names are the paper's.
+constexpr std::uint8_t tooShort     = 1 << 0;
+constexpr std::uint8_t tooLong      = 1 << 1;
+constexpr std::uint8_t overlong3    = 1 << 2;
+constexpr std::uint8_t tooLarge     = 1 << 3;
+constexpr std::uint8_t surrogate    = 1 << 4;
+constexpr std::uint8_t overlong2    = 1 << 5;
+constexpr std::uint8_t tooLarge1000 = 1 << 6;
+constexpr std::uint8_t overlong4    = 1 << 6;
+constexpr std::uint8_t twoConts     = 1 << 7;
+constexpr std::uint8_t carry        = tooShort | tooLong | twoConts;
+
+/// Indexed by the high nibble of the byte before.
+alignas(16) constexpr std::array<std::uint8_t, 16> firstHigh{
+    // 0xxx: ASCII, so this byte cannot continue it.
+    tooLong, tooLong, tooLong, tooLong, tooLong, tooLong, tooLong, tooLong,
+    // 10xx: a continuation, which another may only follow if a lead wants it.
+    twoConts, twoConts, twoConts, twoConts,
+    // 1100, 1101: two-byte leads.
+    tooShort | overlong2, tooShort,
+    // 1110: three-byte leads.
+    tooShort | overlong3 | surrogate,
+    // 1111: four-byte leads, and bytes that lead nothing.
+    tooShort | tooLarge | tooLarge1000 | overlong4};
+
+/// Indexed by the low nibble of the byte before.
+alignas(16) constexpr std::array<std::uint8_t, 16> firstLow{
+    carry | overlong3 | overlong2 | overlong4,
+    carry | overlong2,
+    carry,
+    carry,
+    carry | tooLarge,
+    carry | tooLarge | tooLarge1000,
+    carry | tooLarge | tooLarge1000,
+    carry | tooLarge | tooLarge1000,
+    carry | tooLarge | tooLarge1000,
+    carry | tooLarge | tooLarge1000,
+    carry | tooLarge | tooLarge1000,
+    carry | tooLarge | tooLarge1000,
+    carry | tooLarge | tooLarge1000,
+    carry | tooLarge | tooLarge1000 | surrogate,
+    carry | tooLarge | tooLarge1000,
+    carry | tooLarge | tooLarge1000};
+
+/// Indexed by the high nibble of the byte itself.
+alignas(16) constexpr std::array<std::uint8_t, 16> secondHigh{
+    tooShort, tooShort, tooShort, tooShort,
+    tooShort, tooShort, tooShort, tooShort,
+    tooLong | overlong2 | twoConts | overlong3 | tooLarge1000 | overlong4,
+    tooLong | overlong2 | twoConts | overlong3 | tooLarge,
+    tooLong | overlong2 | twoConts | surrogate | tooLarge,
+    tooLong | overlong2 | twoConts | surrogate | tooLarge,
+    tooShort, tooShort, tooShort, tooShort};
+
+/// A block ending on a lead byte, or on the second or third byte of a
+/// character that wants more, is only good if the next block finishes it.
+/// Subtracting these leaves something non-zero exactly there.
+template <std::size_t N>
+constexpr std::array<std::uint8_t, N> incompleteAbove() {
+  std::array<std::uint8_t, N> max{};
+  max.fill(0xFF);
+  max[N - 3] = 0xF0 - 1;
+  max[N - 2] = 0xE0 - 1;
+  max[N - 1] = 0xC0 - 1;
+  return max;
+}
+
+#endif
+
+#if defined(GLEDITOR_UTF8_X86)
+
+std::size_t sse2Valid(const std::string_view text) {
+  // No byte shuffle in SSE2, so no lookup: what it does is find the next byte
+  // that is not ASCII, or is nul, sixteen at a time, and hand that character
+  // to the byte loop. Prose is mostly ASCII, and there this is most of the
+  // gain.
+  const auto *bytes = bytesOf(text);
+  const auto size   = text.size();
+  const auto zero   = _mm_setzero_si128();
+  std::size_t pos   = 0;
+  while (pos + 16 <= size) {
+    const auto input = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(bytes + pos));
+    const auto stops = static_cast<unsigned>(
+        _mm_movemask_epi8(input) |
+        _mm_movemask_epi8(_mm_cmpeq_epi8(input, zero)));
+    if (0 == stops) {
+      pos += 16;
+      continue;
+    }
+    // The rest of the block goes a byte at a time, since text that has one
+    // character that is not ASCII usually has more, and looking for each with
+    // a vector of its own would be slower than the byte loop.
+    const auto blockEnd = pos + 16;
+    for (pos += static_cast<std::size_t>(__builtin_ctz(stops));
+         pos < blockEnd;) {
+      const auto length = sequenceAt(bytes, size, pos);
+      if (0 == length) {
+        return pos;
+      }
+      pos += length;
+    }
+  }
+  return scalarValid(text, pos);
+}
+
+std::size_t sse2Count(const std::string_view text) {
+  const auto *bytes     = bytesOf(text);
+  const auto size       = text.size();
+  const auto zero       = _mm_setzero_si128();
+  // A signed byte above this is not 10xxxxxx.
+  const auto lastCont   = _mm_set1_epi8(-65);
+  std::size_t pos       = 0;
+  std::size_t total     = 0;
+  while (size - pos >= 16) {
+    // Counted a byte per lane, so at most 255 blocks before the lanes are
+    // summed into the total.
+    const auto blocks = std::min<std::size_t>((size - pos) / 16, 255);
+    auto lanes        = zero;
+    for (std::size_t i = 0; i < blocks; i++, pos += 16) {
+      const auto input = _mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(bytes + pos));
+      lanes = _mm_sub_epi8(lanes, _mm_cmpgt_epi8(input, lastCont));
+    }
+    const auto sums = _mm_sad_epu8(lanes, zero);
+    total += static_cast<std::size_t>(_mm_cvtsi128_si32(sums)) +
+             static_cast<std::size_t>(
+                 _mm_cvtsi128_si32(_mm_unpackhi_epi64(sums, sums)));
+  }
+  return total + scalarCount(text.substr(pos));
+}
+
+#define GLEDITOR_AVX2 __attribute__((target("avx2")))
+
+GLEDITOR_AVX2 __m256i avx2Table(const std::array<std::uint8_t, 16> &table) {
+  return _mm256_broadcastsi128_si256(
+      _mm_load_si128(reinterpret_cast<const __m128i *>(table.data())));
+}
+
+/// @p input with each byte replaced by the one @p N before it in the text,
+/// @p previous being the block before.
+template <int N>
+GLEDITOR_AVX2 __m256i avx2Before(const __m256i input, const __m256i previous) {
+  return _mm256_alignr_epi8(
+      input, _mm256_permute2x128_si256(previous, input, 0x21), 16 - N);
+}
+
+GLEDITOR_AVX2 __m256i avx2Nibble(const __m256i bytes) {
+  return _mm256_and_si256(_mm256_srli_epi16(bytes, 4), _mm256_set1_epi8(0x0F));
+}
+
+GLEDITOR_AVX2 std::size_t avx2Valid(const std::string_view text) {
+  const auto *bytes      = bytesOf(text);
+  const auto size        = text.size();
+  const auto zero        = _mm256_setzero_si256();
+  const auto lowNibble   = _mm256_set1_epi8(0x0F);
+  const auto high1       = avx2Table(firstHigh);
+  const auto low1        = avx2Table(firstLow);
+  const auto high2       = avx2Table(secondHigh);
+  static constexpr auto incomplete = incompleteAbove<32>();
+  const auto maxComplete = _mm256_loadu_si256(
+      reinterpret_cast<const __m256i *>(incomplete.data()));
+  auto previous          = zero;
+  auto unfinished        = zero;
+  std::size_t pos        = 0;
+  for (; pos + 32 <= size; pos += 32) {
+    const auto input = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(bytes + pos));
+    auto error = _mm256_cmpeq_epi8(input, zero);
+    if (0 == _mm256_movemask_epi8(input)) {
+      // ASCII throughout: right unless the block before wanted finishing.
+      error = _mm256_or_si256(error, unfinished);
+    } else {
+      const auto prev1  = avx2Before<1>(input, previous);
+      const auto found  = _mm256_and_si256(
+          _mm256_and_si256(_mm256_shuffle_epi8(high1, avx2Nibble(prev1)),
+                           _mm256_shuffle_epi8(
+                               low1, _mm256_and_si256(prev1, lowNibble))),
+          _mm256_shuffle_epi8(high2, avx2Nibble(input)));
+      // Two continuations in a row are right where a three- or four-byte
+      // lead two or three bytes back wants them, and wrong anywhere else.
+      const auto third  = _mm256_subs_epu8(avx2Before<2>(input, previous),
+                                           _mm256_set1_epi8(0xE0 - 0x80));
+      const auto fourth = _mm256_subs_epu8(avx2Before<3>(input, previous),
+                                           _mm256_set1_epi8(0xF0 - 0x80));
+      const auto wanted = _mm256_and_si256(_mm256_or_si256(third, fourth),
+                                           _mm256_set1_epi8(-128));
+      error = _mm256_or_si256(error, _mm256_xor_si256(wanted, found));
+    }
+    if (0 == _mm256_testz_si256(error, error)) {
+      break;
+    }
+    unfinished = _mm256_subs_epu8(input, maxComplete);
+    previous   = input;
+  }
+  return scalarValid(text, resumeAt(text, pos));
+}
+
+GLEDITOR_AVX2 std::size_t avx2Count(const std::string_view text) {
+  const auto *bytes   = bytesOf(text);
+  const auto size     = text.size();
+  const auto zero     = _mm256_setzero_si256();
+  const auto lastCont = _mm256_set1_epi8(-65);
+  std::size_t pos     = 0;
+  std::size_t total   = 0;
+  while (size - pos >= 32) {
+    const auto blocks = std::min<std::size_t>((size - pos) / 32, 255);
+    auto lanes        = zero;
+    for (std::size_t i = 0; i < blocks; i++, pos += 32) {
+      const auto input = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i *>(bytes + pos));
+      lanes = _mm256_sub_epi8(lanes, _mm256_cmpgt_epi8(input, lastCont));
+    }
+    const auto wide = _mm256_sad_epu8(lanes, zero);
+    const auto sums = _mm_add_epi64(_mm256_castsi256_si128(wide),
+                                    _mm256_extracti128_si256(wide, 1));
+    total += static_cast<std::size_t>(_mm_cvtsi128_si32(sums)) +
+             static_cast<std::size_t>(
+                 _mm_cvtsi128_si32(_mm_unpackhi_epi64(sums, sums)));
+  }
+  return total + scalarCount(text.substr(pos));
+}
+
+#undef GLEDITOR_AVX2
+
+#endif // GLEDITOR_UTF8_X86
+
+#if defined(GLEDITOR_UTF8_NEON)
+
+std::size_t neonValid(const std::string_view text) {
+  const auto *bytes      = bytesOf(text);
+  const auto size        = text.size();
+  const auto zero        = vdupq_n_u8(0);
+  const auto lowNibble   = vdupq_n_u8(0x0F);
+  const auto high1       = vld1q_u8(firstHigh.data());
+  const auto low1        = vld1q_u8(firstLow.data());
+  const auto high2       = vld1q_u8(secondHigh.data());
+  static constexpr auto incomplete = incompleteAbove<16>();
+  const auto maxComplete = vld1q_u8(incomplete.data());
+  auto previous          = zero;
+  auto unfinished        = zero;
+  std::size_t pos        = 0;
+  for (; pos + 16 <= size; pos += 16) {
+    const auto input = vld1q_u8(bytes + pos);
+    auto error       = vceqq_u8(input, zero);
+    if (vmaxvq_u8(input) < 0x80) {
+      error = vorrq_u8(error, unfinished);
+    } else {
+      const auto prev1  = vextq_u8(previous, input, 16 - 1);
+      const auto found  = vandq_u8(
+          vandq_u8(vqtbl1q_u8(high1, vshrq_n_u8(prev1, 4)),
+                   vqtbl1q_u8(low1, vandq_u8(prev1, lowNibble))),
+          vqtbl1q_u8(high2, vshrq_n_u8(input, 4)));
+      const auto third  = vqsubq_u8(vextq_u8(previous, input, 16 - 2),
+                                    vdupq_n_u8(0xE0 - 0x80));
+      const auto fourth = vqsubq_u8(vextq_u8(previous, input, 16 - 3),
+                                    vdupq_n_u8(0xF0 - 0x80));
+      const auto wanted =
+          vandq_u8(vorrq_u8(third, fourth), vdupq_n_u8(0x80));
+      error = vorrq_u8(error, veorq_u8(wanted, found));
+    }
+    if (0 != vmaxvq_u8(error)) {
+      break;
+    }
+    unfinished = vqsubq_u8(input, maxComplete);
+    previous   = input;
+  }
+  return scalarValid(text, resumeAt(text, pos));
+}
+
+std::size_t neonCount(const std::string_view text) {
+  const auto *bytes   = bytesOf(text);
+  const auto size     = text.size();
+  const auto lastCont = vdupq_n_s8(-65);
+  std::size_t pos     = 0;
+  std::size_t total   = 0;
+  while (size - pos >= 16) {
+    const auto blocks = std::min<std::size_t>((size - pos) / 16, 255);
+    auto lanes        = vdupq_n_u8(0);
+    for (std::size_t i = 0; i < blocks; i++, pos += 16) {
+      const auto input = vreinterpretq_s8_u8(vld1q_u8(bytes + pos));
+      lanes            = vsubq_u8(lanes, vcgtq_s8(input, lastCont));
+    }
+    total += vaddlvq_u8(lanes);
+  }
+  return total + scalarCount(text.substr(pos));
+}
+
+#endif // GLEDITOR_UTF8_NEON
+
+/// Found out once: the instructions a machine has do not change under it.
+const std::vector<Utf8Kernel> &supported() {
+  static const std::vector<Utf8Kernel> kernels = [] {
+    std::vector<Utf8Kernel> found{Utf8Kernel::scalar};
+#if defined(GLEDITOR_UTF8_X86)
+    found.push_back(Utf8Kernel::sse2);
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      found.push_back(Utf8Kernel::avx2);
+    }
+#elif defined(GLEDITOR_UTF8_NEON)
+    // Part of the architecture on 64-bit ARM, so there is nothing to ask.
+    found.push_back(Utf8Kernel::neon);
+#endif
+    return found;
+  }();
+  return kernels;
+}
+
+Utf8Kernel usable(const Utf8Kernel kernel) {
+  const auto &kernels = supported();
+  return std::ranges::find(kernels, kernel) != kernels.end()
+             ? kernel
+             : Utf8Kernel::scalar;
 }
 
 } // namespace
@@ -18,7 +446,8 @@ namespace gleditor {
 
 std::uint32_t alignToCharacterStart(const std::string_view text,
                                     std::uint32_t offset) {
-  while (offset > 0 && continues(text, offset)) {
+  while (offset > 0 && offset < text.size() &&
+         continuesCharacter(text[offset])) {
     offset--;
   }
   return offset;
@@ -26,12 +455,119 @@ std::uint32_t alignToCharacterStart(const std::string_view text,
 
 std::uint32_t alignToCharacterEnd(const std::string_view text,
                                   std::uint32_t offset) {
-  while (continues(text, offset)) {
+  while (offset < text.size() && continuesCharacter(text[offset])) {
     offset++;
   }
   return offset;
 }
 
+std::size_t nextCharacter(const std::string_view text, std::size_t offset) {
+  offset = std::min(offset + 1, text.size());
+  while (offset < text.size() && continuesCharacter(text[offset])) {
+    offset++;
+  }
+  return offset;
+}
+
+std::span<const Utf8Kernel> utf8Kernels() { return supported(); }
+
+Utf8Kernel utf8Kernel() {
+  static const Utf8Kernel best = supported().back();
+  return best;
+}
+
+std::string_view nameOf(const Utf8Kernel kernel) {
+  switch (kernel) {
+  case Utf8Kernel::scalar:
+    return "scalar";
+  case Utf8Kernel::sse2:
+    return "sse2";
+  case Utf8Kernel::avx2:
+    return "avx2";
+  case Utf8Kernel::neon:
+    return "neon";
+  }
+  return "unknown";
+}
+
+std::size_t validUtf8(const std::string_view text) {
+  return validUtf8(text, utf8Kernel());
+}
+
+std::size_t validUtf8(const std::string_view text, const Utf8Kernel kernel) {
+  if (text.size() < vectorMinimumBytes) {
+    return scalarValid(text, 0);
+  }
+  switch (usable(kernel)) {
+#if defined(GLEDITOR_UTF8_X86)
+  case Utf8Kernel::sse2:
+    return sse2Valid(text);
+  case Utf8Kernel::avx2:
+    return avx2Valid(text);
+#elif defined(GLEDITOR_UTF8_NEON)
+  case Utf8Kernel::neon:
+    return neonValid(text);
+#endif
+  default:
+    return scalarValid(text, 0);
+  }
+}
+
+std::size_t countCharacters(const std::string_view text) {
+  // Most calls are for one cluster, a few bytes long, and go no further.
+  if (text.size() < vectorMinimumBytes) {
+    return scalarCount(text);
+  }
+  return countCharacters(text, utf8Kernel());
+}
+
+std::size_t countCharacters(const std::string_view text,
+                            const Utf8Kernel kernel) {
+  if (text.size() < vectorMinimumBytes) {
+    return scalarCount(text);
+  }
+  switch (usable(kernel)) {
+#if defined(GLEDITOR_UTF8_X86)
+  case Utf8Kernel::sse2:
+    return sse2Count(text);
+  case Utf8Kernel::avx2:
+    return avx2Count(text);
+#elif defined(GLEDITOR_UTF8_NEON)
+  case Utf8Kernel::neon:
+    return neonCount(text);
+#endif
+  default:
+    return scalarCount(text);
+  }
+}
+
+Utf8Scan scanUtf8(const std::string_view text) {
+  return scanUtf8(text, utf8Kernel());
+}
+
+Utf8Scan scanUtf8(const std::string_view text, const Utf8Kernel kernel) {
+  Utf8Scan scan;
+  while (scan.valid < text.size()) {
+    // Each chunk ends on a character boundary, so that none is judged in two
+    // halves: the cut moves forward past the continuation bytes it lands on.
+    auto end = std::min(text.size(), scan.valid + scanChunkBytes);
+    for (std::size_t moved = 0; moved < maxContinuationBytes &&
+                                end < text.size() &&
+                                continuesCharacter(text[end]);
+         moved++) {
+      end++;
+    }
+    const auto chunk = text.substr(scan.valid, end - scan.valid);
+    const auto good  = validUtf8(chunk, kernel);
+    scan.characters += countCharacters(chunk.substr(0, good), kernel);
+    scan.valid += good;
+    if (good != chunk.size()) {
+      break;
+    }
+  }
+  return scan;
+}
+
 } // namespace gleditor
 
 // vi: set sw=2 sts=2 ts=2 et:
@@ -115,6 +115,22 @@ TEST_F(BufferPoolTest, writeTargetsTheAllocationsOffset) {
   pool.write(alloc, 1, row);
 }
 
+TEST_F(BufferPoolTest, patchWritesWithinOneRow) {
+  BufferPool pool(device.get(), kStride, 100);
+  pool.reserve(5);
+  const auto alloc = pool.reserve(3);
+
+  EXPECT_CALL(*device, updateBuffer(render::BufferHandle{1},
+                                    pool.byteOffset(alloc) + kStride * 2 + 16,
+                                    _))
+      .Times(1);
+  const std::vector<std::byte> field(8);
+  pool.patch(alloc, 2, 16, field);
+  EXPECT_THROW(pool.patch(alloc, 2, kStride - 4, field),
+               std::invalid_argument);
+  EXPECT_THROW(pool.patch(alloc, 3, 0, field), std::out_of_range);
+}
+
 // Growth has to overshoot, but a pool that doubles has room for a second
 // document by the time it holds the first. What bounds the waste is the size
 // of the step, and this is the test that says what that step is: filling a
@@ -471,6 +487,47 @@ TEST_F(BufferPoolTest, aReleasedAllocationIsNoLongerAddressable) {
   pool.release(alloc);
 }
 
+// Pages scattered through a document giving their rows back leave the room in
+// holes a trim cannot reach. Compacting moves what is behind them forward.
+TEST_F(BufferPoolTest, compactingMovesAllocationsIntoHolesAndTrims) {
+  BufferPool pool(device.get(), kStride, 64);
+  pool.reserveCapacity(20000);
+  std::vector<BufferPool::Allocation> pages;
+  for (int page = 0; page < 100; page++) {
+    pages.push_back(pool.reserve(150));
+  }
+  for (std::size_t page = 0; page < pages.size(); page += 2) {
+    pool.release(pages[page]);
+  }
+  const auto before = pool.capacityRows();
+
+  ON_CALL(*device, copyBufferRange)
+      .WillByDefault([](render::BufferHandle, const std::size_t src,
+                        const std::size_t dst, const std::size_t bytes) {
+        EXPECT_LT(dst, src) << "nothing moves further back";
+        EXPECT_LE(dst + bytes, src) << "the copy overlaps itself";
+      });
+  EXPECT_GT(pool.compact(), 0U);
+
+  EXPECT_LT(pool.capacityRows(), before);
+  const auto room = pool.roomFor(pages[1]);
+  for (std::size_t page = 1; page < pages.size(); page += 2) {
+    EXPECT_EQ(pool.rowCount(pages[page]), 150U);
+    EXPECT_LE(pool.byteOffset(pages[page]) / kStride + room,
+              pool.capacityRows());
+  }
+}
+
+TEST_F(BufferPoolTest, compactingAPoolWithNoHolesMovesNothing) {
+  BufferPool pool(device.get(), kStride, 1000);
+  const auto first  = pool.reserve(100);
+  const auto second = pool.reserve(100);
+  EXPECT_CALL(*device, copyBufferRange).Times(0);
+  EXPECT_EQ(pool.compact(), 0U);
+  EXPECT_EQ(pool.byteOffset(first), 0U);
+  EXPECT_EQ(pool.byteOffset(second), pool.roomFor(first) * kStride);
+}
+
 TEST_F(BufferPoolTest, rejectsZeroStride) {
   EXPECT_THROW(BufferPool(device.get(), 0, 10), std::invalid_argument);
 }
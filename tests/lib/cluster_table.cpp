@@ -0,0 +1,219 @@
+/**
+ * @file cluster_table.cpp
+ * @brief A page's clusters held as runs come back as they went in.
+ */
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <gleditor/cluster_table.hpp>
+
+namespace {
+
+using gleditor::ClusterBox;
+using gleditor::ClusterTable;
+using Covered = std::optional<std::pair<std::size_t, std::size_t>>;
+
+/// Clusters of @p lengths bytes, one character each, end to end.
+std::vector<ClusterBox> endToEnd(const std::vector<std::uint32_t> &lengths) {
+  std::vector<ClusterBox> out;
+  std::uint32_t at = 0;
+  for (const auto length : lengths) {
+    out.push_back({at, length, 0 == length ? 0U : 1U});
+    at += length;
+  }
+  return out;
+}
+
+/**
+ * @brief A page's worth of clusters, as a page of mixed text comes out.
+ *
+ * Mostly one byte, with runs of two and three, the odd long cluster and
+ * ligature, and a paragraph's room every so often.
+ */
+std::vector<ClusterBox> pageLike(const std::size_t clusters,
+                                 const std::uint32_t seed) {
+  std::mt19937 random{seed};
+  std::vector<ClusterBox> out;
+  std::uint32_t at = 0;
+  while (out.size() < clusters) {
+    const auto pick = random() % 100;
+    if (pick < 3) {
+      // A paragraph's room: empty clusters where the paragraph ends.
+      for (auto room = 4 + (random() % 8); 0 != room; room--) {
+        out.push_back({at, 0, 0});
+      }
+      continue;
+    }
+    std::uint32_t length = 1;
+    std::uint32_t chars  = 1;
+    if (pick < 5) {
+      length = 300 + (random() % 50); // longer than a run can count
+      chars  = length / 3;
+    } else if (pick < 10) {
+      length = 3;
+      chars  = 3; // a ligature
+    } else if (pick < 40) {
+      length = 2 + (random() % 2);
+    }
+    out.push_back({at, length, chars});
+    at += length;
+  }
+  out.resize(clusters);
+  return out;
+}
+
+/// What ClusterTable::covering() answers, worked out one cluster at a time.
+Covered coveringByHand(const std::vector<ClusterBox> &boxes,
+                       const std::uint32_t from, const std::uint32_t to) {
+  Covered out;
+  for (std::size_t i = 0; i < boxes.size(); i++) {
+    const auto &box = boxes[i];
+    if (0 != box.byteLength && box.byteStart + box.byteLength > from &&
+        box.byteStart < to) {
+      out = std::pair{out ? out->first : i, i};
+    }
+  }
+  return to > from ? out : std::nullopt;
+}
+
+void expectSame(const ClusterTable &table,
+                const std::vector<ClusterBox> &boxes) {
+  ASSERT_EQ(table.size(), boxes.size());
+  EXPECT_EQ(table.boxes(), boxes);
+  for (std::size_t i = 0; i < boxes.size(); i++) {
+    ASSERT_EQ(table[i], boxes[i]) << "cluster " << i;
+  }
+}
+
+TEST(ClusterTableTest, anEmptyTableHoldsNothing) {
+  const ClusterTable table;
+  EXPECT_TRUE(table.empty());
+  EXPECT_TRUE(table.boxes().empty());
+  EXPECT_FALSE(table.covering(0, 10));
+}
+
+TEST(ClusterTableTest, everyClusterComesBackAsItWent) {
+  for (const std::size_t size : {1, 63, 64, 65, 500, 5000}) {
+    const auto boxes = pageLike(size, static_cast<std::uint32_t>(size));
+    expectSame(ClusterTable(boxes), boxes);
+  }
+}
+
+TEST(ClusterTableTest, clustersThatAreNotEndToEndComeBackToo) {
+  // Out of order, overlapping, and one with a gap before it: none of it is
+  // what Pango hands over, and all of it is held as it was.
+  const std::vector<ClusterBox> boxes{
+      {0, 1, 1}, {5, 1, 1}, {2, 4, 2}, {3, 1, 1}, {4, 1, 1}, {4, 0, 0}};
+  expectSame(ClusterTable(boxes), boxes);
+}
+
+TEST(ClusterTableTest, plainTextTakesAFractionOfABoxACluster) {
+  // Ten thousand one-byte clusters with a two-byte line break every sixty.
+  std::vector<std::uint32_t> lengths;
+  for (std::size_t i = 0; i < 10000; i++) {
+    lengths.push_back(59 == i % 60 ? 2 : 1);
+  }
+  const auto boxes = endToEnd(lengths);
+  const ClusterTable table(boxes);
+  expectSame(table, boxes);
+  EXPECT_LT(table.memoryBytes(), boxes.size() * sizeof(ClusterBox) / 10);
+}
+
+TEST(ClusterTableTest, coveringFindsTheFirstAndLastClusterOfARange) {
+  // "ab" "ffi" "c" then room, then "d".
+  const std::vector<ClusterBox> boxes{
+      {0, 1, 1}, {1, 1, 1}, {2, 3, 3}, {5, 1, 1}, {6, 0, 0}, {6, 1, 1}};
+  const ClusterTable table(boxes);
+  EXPECT_EQ(table.covering(0, 2), (Covered{{0, 1}}));
+  // Any byte of a cluster is enough to cover it.
+  EXPECT_EQ(table.covering(3, 4), (Covered{{2, 2}}));
+  EXPECT_EQ(table.covering(1, 6), (Covered{{1, 3}}));
+  // Room is never an end, even where it sits inside the range.
+  EXPECT_EQ(table.covering(5, 7), (Covered{{3, 5}}));
+  EXPECT_FALSE(table.covering(7, 9));
+  EXPECT_FALSE(table.covering(4, 4));
+}
+
+TEST(ClusterTableTest, coveringAgreesWithAskingEveryCluster) {
+  const auto boxes = pageLike(3000, 7);
+  const ClusterTable table(boxes);
+  const auto end = boxes.back().byteStart + boxes.back().byteLength;
+  std::mt19937 random{11};
+  for (int i = 0; i < 2000; i++) {
+    const auto from = static_cast<std::uint32_t>(random() % (end + 10));
+    const auto to   = static_cast<std::uint32_t>(random() % (end + 10));
+    ASSERT_EQ(table.covering(from, to), coveringByHand(boxes, from, to))
+        << from << ".." << to;
+  }
+  // And of a table that is not in order, which is searched end to end.
+  const std::vector<ClusterBox> jumbled{
+      {4, 2, 2}, {0, 2, 2}, {2, 2, 2}, {6, 0, 0}};
+  const ClusterTable mixed(jumbled);
+  EXPECT_EQ(mixed.covering(0, 3), coveringByHand(jumbled, 0, 3));
+  EXPECT_EQ(mixed.covering(5, 6), coveringByHand(jumbled, 5, 6));
+}
+
+TEST(ClusterTableTest, replacingMovesEverythingAfterAndNothingBefore) {
+  auto boxes = pageLike(1000, 3);
+  ClusterTable table(boxes);
+  std::mt19937 random{5};
+  for (int edit = 0; edit < 200; edit++) {
+    // A stretch of clusters laid out again, by a paragraph's relayout: the
+    // new ones start where the old did, and whatever is after moves by the
+    // difference.
+    const auto first = random() % (boxes.size() - 40);
+    const auto span  = 1 + (random() % 40);
+    const auto start = boxes[first].byteStart;
+    const auto oldEnd =
+        boxes[first + span - 1].byteStart + boxes[first + span - 1].byteLength;
+    std::vector<ClusterBox> fresh;
+    std::uint32_t at = start;
+    for (std::size_t i = 0; i < span; i++) {
+      const auto length = static_cast<std::uint32_t>(random() % 4);
+      fresh.push_back({at, length, 0 == length ? 0U : 1U});
+      at += length;
+    }
+    const auto shift = static_cast<std::int32_t>(at) -
+                       static_cast<std::int32_t>(oldEnd);
+    table.replace(first, fresh, shift);
+    std::ranges::copy(fresh, boxes.begin() +
+                                 static_cast<std::ptrdiff_t>(first));
+    for (auto i = first + span; i < boxes.size(); i++) {
+      boxes[i].byteStart = static_cast<std::uint32_t>(
+          static_cast<std::int64_t>(boxes[i].byteStart) + shift);
+    }
+    expectSame(table, boxes);
+  }
+  const auto end = boxes.back().byteStart + boxes.back().byteLength;
+  for (std::uint32_t from = 0; from < end; from += 37) {
+    ASSERT_EQ(table.covering(from, from + 50),
+              coveringByHand(boxes, from, from + 50));
+  }
+}
+
+TEST(ClusterTableTest, replacingCanPutTheTableOutOfOrderAndBackIn) {
+  auto boxes = endToEnd(std::vector<std::uint32_t>(200, 1));
+  ClusterTable table(boxes);
+  // A cluster that starts before the one ahead of it has ended: searched end
+  // to end from then on, and still right.
+  const std::vector<ClusterBox> overlapping{{99, 3, 1}};
+  table.replace(100, overlapping, 0);
+  boxes[100] = overlapping.front();
+  expectSame(table, boxes);
+  EXPECT_EQ(table.covering(100, 101), coveringByHand(boxes, 100, 101));
+  const std::vector<ClusterBox> mended{{100, 1, 1}};
+  table.replace(100, mended, 0);
+  boxes[100] = mended.front();
+  expectSame(table, boxes);
+  EXPECT_EQ(table.covering(100, 101), (Covered{{100, 100}}));
+}
+
+} // namespace
+
+// vi: set sw=2 sts=2 ts=2 et:
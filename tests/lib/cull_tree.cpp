@@ -0,0 +1,184 @@
+/**
+ * @file cull_tree.cpp
+ * @brief Which page boxes a view reaches, found through the tree.
+ *
+ * The tree is only worth having if it finds exactly what testing every box
+ * would have: a page it misses is a page missing from the frame.
+ */
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <gleditor/cull_tree.hpp>
+
+namespace {
+
+using gleditor::CullBox;
+using gleditor::CullFrustum;
+using gleditor::CullHit;
+using gleditor::CullPlane;
+using gleditor::CullTree;
+
+/// A view of x and y both within [-@p half, @p half], as an orthographic
+/// camera looking straight down at the pages would have.
+CullFrustum square(const float half) {
+  return {CullPlane{1.0F, 0.0F, 0.0F, half}, CullPlane{-1.0F, 0.0F, 0.0F, half},
+          CullPlane{0.0F, 1.0F, 0.0F, half},
+          CullPlane{0.0F, -1.0F, 0.0F, half}};
+}
+
+/// @p count page-sized boxes stacked downwards, a hundred apart, as a
+/// document's pages are.
+std::vector<CullBox> column(const std::size_t count) {
+  std::vector<CullBox> boxes;
+  for (std::size_t i = 0; i < count; i++) {
+    boxes.push_back(CullBox{0.0F, -100.0F * static_cast<float>(i), 35.0F,
+                            45.0F});
+  }
+  return boxes;
+}
+
+/// Every box tested on its own, which is what the tree has to agree with.
+std::vector<CullHit> everyBox(const std::vector<CullBox> &boxes,
+                              const CullFrustum &frustum, const float grow,
+                              const float depth) {
+  const auto furthest = [&](const CullPlane &plane, const CullBox &box,
+                            const float scale) {
+    return (plane.x * box.centreX) + (plane.y * box.centreY) +
+           (plane.z * depth / 2.0F) + plane.w +
+           (std::abs(plane.x) * box.halfWidth * scale) +
+           (std::abs(plane.y) * box.halfHeight * scale) +
+           (std::abs(plane.z) * depth / 2.0F);
+  };
+  std::vector<CullHit> hits;
+  for (std::size_t i = 0; i < boxes.size(); i++) {
+    bool near  = true;
+    bool exact = true;
+    for (const auto &plane : frustum) {
+      near  = near && furthest(plane, boxes[i], grow) >= 0.0F;
+      exact = exact && furthest(plane, boxes[i], 1.0F) >= 0.0F;
+    }
+    if (near) {
+      hits.push_back(CullHit{static_cast<std::uint32_t>(i), exact});
+    }
+  }
+  return hits;
+}
+
+void expectSame(const std::vector<CullHit> &found,
+                const std::vector<CullHit> &wanted) {
+  ASSERT_EQ(found.size(), wanted.size());
+  for (std::size_t i = 0; i < found.size(); i++) {
+    EXPECT_EQ(found[i].index, wanted[i].index) << "hit " << i;
+    EXPECT_EQ(found[i].inView, wanted[i].inView) << "hit " << i;
+  }
+}
+
+TEST(CullTreeTest, findsOnlyThePagesInView) {
+  CullTree tree;
+  const auto boxes = column(200);
+  tree.rebuild(boxes, 0.1F);
+  std::vector<CullHit> hits;
+  // Looking at the third page: it alone reaches the view.
+  auto frustum = square(10.0F);
+  frustum[2].w = 10.0F + 200.0F;
+  frustum[3].w = 10.0F - 200.0F;
+  tree.query(frustum, 1.0F, hits);
+  ASSERT_EQ(hits.size(), 1U);
+  EXPECT_EQ(hits[0].index, 2U);
+  EXPECT_TRUE(hits[0].inView);
+}
+
+TEST(CullTreeTest, pagesNearTheViewAreFoundButNotInIt) {
+  CullTree tree;
+  const auto boxes = column(50);
+  tree.rebuild(boxes, 0.1F);
+  std::vector<CullHit> hits;
+  // Three times as tall, the second page reaches up to y = 35.
+  tree.query(square(10.0F), 3.0F, hits);
+  ASSERT_EQ(hits.size(), 2U);
+  EXPECT_EQ(hits[0].index, 0U);
+  EXPECT_TRUE(hits[0].inView);
+  EXPECT_EQ(hits[1].index, 1U);
+  EXPECT_FALSE(hits[1].inView);
+}
+
+TEST(CullTreeTest, aLongDocumentIsMostlyNeverVisited) {
+  CullTree tree;
+  const auto boxes = column(10000);
+  tree.rebuild(boxes, 0.1F);
+  std::vector<CullHit> hits;
+  const auto tested = tree.query(square(10.0F), 1.0F, hits);
+  EXPECT_EQ(hits.size(), 1U);
+  // A path down the tree and the siblings turned away along it, rather than
+  // anything like a node per page.
+  EXPECT_LT(tested, 64U);
+}
+
+TEST(CullTreeTest, agreesWithTestingEveryBox) {
+  // Boxes scattered sideways as well as down, of several sizes, under a view
+  // whose planes lean in every direction, depth included.
+  std::vector<CullBox> boxes;
+  for (std::size_t i = 0; i < 1000; i++) {
+    const auto step = static_cast<float>(i);
+    boxes.push_back(CullBox{std::fmod(step * 37.0F, 400.0F) - 200.0F,
+                            -10.0F * step, 5.0F + std::fmod(step, 7.0F),
+                            3.0F + std::fmod(step, 11.0F)});
+  }
+  const CullFrustum frustum{CullPlane{0.9F, 0.01F, 0.3F, 120.0F},
+                            CullPlane{-0.8F, 0.02F, -0.4F, 90.0F},
+                            CullPlane{0.1F, 1.0F, 0.2F, 3000.0F},
+                            CullPlane{-0.2F, -1.0F, 0.1F, -1500.0F}};
+  CullTree tree;
+  tree.rebuild(boxes, 0.5F);
+  for (const float grow : {1.0F, 3.0F}) {
+    std::vector<CullHit> hits;
+    tree.query(frustum, grow, hits);
+    EXPECT_FALSE(hits.empty());
+    expectSame(hits, everyBox(boxes, frustum, grow, 0.5F));
+  }
+}
+
+TEST(CullTreeTest, aPartLeafHoldsOnlyItsOwnBoxes) {
+  CullTree tree;
+  const auto boxes = column(CullTree::leafSize + 5);
+  tree.rebuild(boxes, 0.1F);
+  EXPECT_EQ(tree.size(), boxes.size());
+  std::vector<CullHit> hits;
+  tree.query(square(1e6F), 1.0F, hits);
+  ASSERT_EQ(hits.size(), boxes.size());
+  for (std::size_t i = 0; i < hits.size(); i++) {
+    EXPECT_EQ(hits[i].index, i);
+    EXPECT_TRUE(hits[i].inView);
+  }
+}
+
+TEST(CullTreeTest, theDepthOfABoxCounts) {
+  // In front of the box's plane, by less than the depth its glyphs reach.
+  auto frustum = square(10.0F);
+  frustum[0]   = CullPlane{0.0F, 0.0F, 1.0F, -0.05F};
+  std::vector<CullHit> hits;
+  CullTree tree;
+  tree.rebuild(column(1), 0.1F);
+  tree.query(frustum, 1.0F, hits);
+  EXPECT_EQ(hits.size(), 1U);
+  hits.clear();
+  tree.rebuild(column(1), 0.01F);
+  tree.query(frustum, 1.0F, hits);
+  EXPECT_TRUE(hits.empty());
+}
+
+TEST(CullTreeTest, anEmptyTreeFindsNothing) {
+  CullTree tree;
+  tree.rebuild({}, 0.1F);
+  std::vector<CullHit> hits;
+  EXPECT_EQ(tree.query(square(10.0F), 1.0F, hits), 0U);
+  EXPECT_TRUE(hits.empty());
+}
+
+} // namespace
+
+// vi: set sw=2 sts=2 ts=2 et:
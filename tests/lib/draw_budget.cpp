@@ -10,6 +10,10 @@
  */
 #include <gtest/gtest.h>
 
+#include <cstdint>
+#include <vector>
+
+#include <gleditor/cull_tree.hpp>
 #include <gleditor/draw_budget.hpp>
 
 #include <glm/ext/matrix_clip_space.hpp>
@@ -93,6 +97,38 @@ TEST(Frustum, mostPagesOfALongDocumentAreRejected) {
   EXPECT_LT(kept, 10) << "kept " << kept << " of 1000 pages";
 }
 
+// The tree finds pages through the planes of the view rather than by
+// transforming corners, and has to find exactly the ones the corners would.
+TEST(Frustum, theTreeKeepsWhatTestingEachPageKeeps) {
+  for (const float distance : {200.0F, 2000.0F}) {
+    const auto base = viewProjection(distance, 60.0F) *
+                      glm::translate(glm::mat4(1.0F),
+                                     glm::vec3(25.0F, 300.0F, 0.0F));
+    std::vector<gleditor::CullBox> boxes;
+    std::vector<std::uint32_t> kept;
+    for (std::uint32_t page = 0; page < 1000; page++) {
+      const auto downwards = -100.0F * static_cast<float>(page);
+      boxes.push_back(gleditor::CullBox{0.0F, downwards, halfW, halfH});
+      const auto mvp =
+          base *
+          glm::translate(glm::mat4(1.0F), glm::vec3(0.0F, downwards, 0.0F));
+      if (!outsideFrustum(mvp, halfW, halfH, depth)) {
+        kept.push_back(page);
+      }
+    }
+    gleditor::CullTree tree;
+    tree.rebuild(boxes, depth);
+    std::vector<gleditor::CullHit> hits;
+    tree.query(frustumPlanes(base), 1.0F, hits);
+    std::vector<std::uint32_t> found;
+    for (const auto &hit : hits) {
+      found.push_back(hit.index);
+    }
+    EXPECT_FALSE(kept.empty());
+    EXPECT_EQ(found, kept) << "at " << distance;
+  }
+}
+
 TEST(ScreenScale, movingTheCameraBackShrinksThings) {
   const auto near = screenScaleAt(viewProjection(200.0F), 800.0F);
   const auto far  = screenScaleAt(viewProjection(2000.0F), 800.0F);
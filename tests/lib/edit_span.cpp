@@ -0,0 +1,64 @@
+/**
+ * @file edit_span.cpp
+ * @brief Merging a burst of edits into one range and one shift.
+ */
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include <gleditor/edit_span.hpp>
+
+namespace {
+
+using gleditor::EditSpan;
+
+TEST(EditSpanTest, typingRunsOnFromWhereItStarted) {
+  auto span = EditSpan::of(100, 0, 1);
+  for (std::uint32_t i = 1; i < 5; i++) {
+    span.merge(100 + i, 0, 1);
+  }
+  EXPECT_EQ(span.from, 100U);
+  EXPECT_EQ(span.to, 105U);
+  EXPECT_EQ(span.delta, 5);
+  EXPECT_EQ(span.edits, 5U);
+}
+
+TEST(EditSpanTest, backspacingPullsTheStartBack) {
+  auto span = EditSpan::of(100, 1, 0);
+  span.merge(99, 1, 0);
+  span.merge(98, 1, 0);
+  EXPECT_EQ(span.from, 98U);
+  EXPECT_EQ(span.to, 98U);
+  EXPECT_EQ(span.delta, -3);
+}
+
+TEST(EditSpanTest, typedThenErasedLeavesTheRangeItTouched) {
+  auto span = EditSpan::of(10, 0, 4);
+  span.merge(12, 2, 0);
+  EXPECT_EQ(span.from, 10U);
+  EXPECT_EQ(span.to, 12U);
+  EXPECT_EQ(span.delta, 2);
+}
+
+TEST(EditSpanTest, editsFarApartCoverEverythingBetween) {
+  auto span = EditSpan::of(5000, 0, 3);
+  // Earlier in the text, so the end moves along with what it inserted.
+  span.merge(10, 0, 2);
+  EXPECT_EQ(span.from, 10U);
+  EXPECT_EQ(span.to, 5005U);
+  // Later, past everything so far.
+  span.merge(9000, 100, 0);
+  EXPECT_EQ(span.to, 9000U);
+  EXPECT_EQ(span.delta, -95);
+}
+
+TEST(EditSpanTest, anErasureSwallowingTheEndStopsItAtTheErasure) {
+  auto span = EditSpan::of(100, 0, 10);
+  span.merge(105, 20, 0);
+  EXPECT_EQ(span.to, 105U);
+  EXPECT_EQ(span.delta, -10);
+}
+
+} // namespace
+
+// vi: set sw=2 sts=2 ts=2 et:
@@ -0,0 +1,180 @@
+/**
+ * @file glyph_atlas_file.cpp
+ * @brief Writing the glyph atlas down and reading it back.
+ */
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <gleditor/glyphcache/atlas_file.hpp>
+
+namespace {
+
+constexpr std::uint64_t settings = 0x5e771265;
+
+/// Two layers of a 64-texel atlas: one with two lanes and three glyphs, the
+/// other with one lane and one, and a blank glyph placed nowhere.
+struct Sample {
+  std::vector<std::byte> first;
+  std::vector<std::byte> second;
+  AtlasFile atlas;
+
+  Sample() {
+    // Odd widths, so that nothing the writer pads falls on a boundary.
+    first.resize(std::size_t{21} * 30);
+    second.resize(std::size_t{13} * 17);
+    for (std::size_t i = 0; i < first.size(); i++) {
+      first[i] = static_cast<std::byte>(i * 7);
+    }
+    for (std::size_t i = 0; i < second.size(); i++) {
+      second[i] = static_cast<std::byte>(255 - i);
+    }
+    atlas.size   = 64;
+    atlas.layers = 2;
+    atlas.palettes = {{.layer = 0, .usedHeight = 30, .imageWidth = 21},
+                      {.layer = 1, .usedHeight = 17, .imageWidth = 13}};
+    atlas.lanes    = {{.palette = 0, .yOffset = 0, .height = 18,
+                       .usedWidth = 21},
+                      {.palette = 0, .yOffset = 18, .height = 12,
+                       .usedWidth = 9},
+                      {.palette = 1, .yOffset = 0, .height = 17,
+                       .usedWidth = 13}};
+    atlas.placements = {
+        {.layer = 0, .x = 0, .y = 0, .width = 11, .height = 18},
+        {.layer = 0, .x = 11, .y = 0, .width = 10, .height = 18},
+        {.layer = 0, .x = 0, .y = 18, .width = 9, .height = 12},
+        {.layer = 1, .x = 0, .y = 0, .width = 13, .height = 17}};
+    atlas.names = "sans 16pxabcd\n";
+    atlas.fonts = {{.fingerprint = 42, .nameAt = 0, .nameBytes = 9}};
+    for (std::uint32_t i = 0; i < 5; i++) {
+      atlas.glyphs.push_back({.keyAt      = 9 + i,
+                              .keyBytes   = 1,
+                              .font       = 0,
+                              .layer      = i == 3 ? 1 : 0,
+                              .x          = static_cast<float>(i),
+                              .pixelWidth = i == 4 ? 0 : 3,
+                              .ink        = 0.25F * static_cast<float>(i)});
+    }
+    atlas.images = {first, second};
+  }
+};
+
+std::filesystem::path scratchFile(const std::string &name) {
+  const auto dir =
+      std::filesystem::temp_directory_path() / "gleditor-atlas-file-test";
+  std::filesystem::create_directories(dir);
+  return dir / name;
+}
+
+std::string contentsOf(const std::filesystem::path &path) {
+  std::ifstream in(path, std::ios::binary);
+  return {std::istreambuf_iterator<char>(in),
+          std::istreambuf_iterator<char>()};
+}
+
+template <typename T>
+void expectSameBytes(const std::vector<T> &left, const std::vector<T> &right) {
+  ASSERT_EQ(left.size(), right.size());
+  for (std::size_t i = 0; i < left.size(); i++) {
+    EXPECT_EQ(0, std::memcmp(&left[i], &right[i], sizeof(T))) << i;
+  }
+}
+
+} // namespace
+
+TEST(GlyphAtlasFile, readsBackWhatWasWritten) {
+  const Sample sample;
+  const auto file = scratchFile("round-trip");
+  ASSERT_TRUE(writeAtlasFile(file, sample.atlas, settings));
+  const auto bytes = contentsOf(file);
+  const auto read  = readAtlasFile(bytes, settings);
+  ASSERT_TRUE(read.has_value());
+
+  EXPECT_EQ(64, read->size);
+  EXPECT_EQ(2, read->layers);
+  EXPECT_EQ(sample.atlas.names, read->names);
+  ASSERT_EQ(2U, read->palettes.size());
+  EXPECT_EQ(30, read->palettes[0].usedHeight);
+  EXPECT_EQ(13, read->palettes[1].imageWidth);
+  expectSameBytes(sample.atlas.lanes, read->lanes);
+  expectSameBytes(sample.atlas.placements, read->placements);
+  expectSameBytes(sample.atlas.fonts, read->fonts);
+  expectSameBytes(sample.atlas.glyphs, read->glyphs);
+  EXPECT_EQ("sans 16px", read->fontName(read->fonts[0]));
+  EXPECT_EQ("c", read->key(read->glyphs[2]));
+
+  // Each layer's pixels are views of the file itself, ready to upload.
+  ASSERT_EQ(2U, read->images.size());
+  EXPECT_TRUE(std::equal(sample.first.begin(), sample.first.end(),
+                         read->images[0].begin(), read->images[0].end()));
+  EXPECT_TRUE(std::equal(sample.second.begin(), sample.second.end(),
+                         read->images[1].begin(), read->images[1].end()));
+  EXPECT_EQ(reinterpret_cast<const std::byte *>(bytes.data()),
+            read->images[0].data() - read->palettes[0].imageAt);
+}
+
+TEST(GlyphAtlasFile, anAtlasDrawnOtherwiseIsNotRead) {
+  const Sample sample;
+  const auto file = scratchFile("settings");
+  ASSERT_TRUE(writeAtlasFile(file, sample.atlas, settings));
+  EXPECT_FALSE(readAtlasFile(contentsOf(file), settings + 1).has_value());
+}
+
+TEST(GlyphAtlasFile, aShortFileIsNotRead) {
+  const Sample sample;
+  const auto file = scratchFile("short");
+  ASSERT_TRUE(writeAtlasFile(file, sample.atlas, settings));
+  const auto bytes = contentsOf(file);
+  // The last layer's pixels are padded out to eight bytes; cutting eight off
+  // is cutting into them.
+  for (const auto keep : {std::size_t{0}, std::size_t{40}, bytes.size() / 2,
+                          bytes.size() - 8}) {
+    EXPECT_FALSE(readAtlasFile(bytes.substr(0, keep), settings).has_value())
+        << keep;
+  }
+}
+
+TEST(GlyphAtlasFile, aGlyphOutsideItsLayerIsNotRead) {
+  Sample sample;
+  sample.atlas.placements[1].x = 12;
+  const auto file              = scratchFile("outside");
+  ASSERT_TRUE(writeAtlasFile(file, sample.atlas, settings));
+  EXPECT_FALSE(readAtlasFile(contentsOf(file), settings).has_value());
+}
+
+TEST(GlyphAtlasFile, aLayerHeldTwiceIsNotRead) {
+  Sample sample;
+  sample.atlas.palettes[1].layer = 0;
+  const auto file                = scratchFile("twice");
+  ASSERT_TRUE(writeAtlasFile(file, sample.atlas, settings));
+  EXPECT_FALSE(readAtlasFile(contentsOf(file), settings).has_value());
+}
+
+TEST(GlyphAtlasFile, aKeyPastTheNamesIsNotRead) {
+  Sample sample;
+  sample.atlas.glyphs[0].keyAt = 14;
+  const auto file              = scratchFile("key");
+  ASSERT_TRUE(writeAtlasFile(file, sample.atlas, settings));
+  EXPECT_FALSE(readAtlasFile(contentsOf(file), settings).has_value());
+}
+
+TEST(GlyphAtlasFile, aWriteThatFailsLeavesNothingBehind) {
+  Sample sample;
+  sample.atlas.images.pop_back();
+  const auto file = scratchFile("unmatched");
+  std::filesystem::remove(file);
+  EXPECT_FALSE(writeAtlasFile(file, sample.atlas, settings));
+  EXPECT_FALSE(std::filesystem::exists(file));
+}
+
+// vi: set sw=2 sts=2 ts=2 et:
@@ -1,18 +1,31 @@
 #include <gtest/gtest.h>
 
 #include <gleditor/glyphcache/cache.hpp>
+#include <gleditor/glyphcache/citation.hpp>
 #include <gleditor/render/types.hpp>
 
+#include <algorithm>
 #include <cairomm/context.h>
 #include <cairomm/surface.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
 #include <gmock/gmock.h>
+#include <map>
 #include <memory>
+#include <optional>
 #include <pangomm/context.h>
 #include <pangomm/fontdescription.h>
 #include <pangomm/init.h>
 #include <pangomm/layout.h>
+#include <span>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include "mocks/device.hpp"
@@ -212,3 +225,446 @@ TEST_F(GlyphCacheTest, survivesAGlyphItCannotHold) {
   EXPECT_NO_THROW(cache->put("a", small));
   EXPECT_LE(cache->atlasSize(), 256);
 }
+
+// A loader thread reserves; only the render thread may touch the device. So a
+// reservation, even one that outgrows the atlas, must leave the device alone
+// until commit() -- and the coordinates it hands out must be the ones the
+// glyph is then uploaded at.
+TEST_F(GlyphCacheTest, reservingLeavesTheDeviceToCommit) {
+  const auto cache = makeCache(4096, 8);
+  const auto face  = font("Serif 150");
+  const auto start = cache->atlasSize();
+
+  std::vector<GlyphCache::Sizes> reserved;
+  for (const auto &chr : alphabet(12)) {
+    reserved.push_back(cache->reserve(chr, face));
+  }
+  EXPECT_EQ(uploads, 0);
+  EXPECT_EQ(allocations.size(), 1U);
+  EXPECT_EQ(cache->atlasSize(), start);
+
+  cache->commit();
+  EXPECT_GT(cache->atlasSize(), start);
+  EXPECT_EQ(allocations.size(), 2U)
+      << "however many doublings were planned, the texture grows once";
+  EXPECT_EQ(uploads, 12);
+
+  const auto glyphs = alphabet(12);
+  for (std::size_t i = 0; i < glyphs.size(); i++) {
+    const auto again = cache->put(glyphs[i], face);
+    EXPECT_EQ(again.texCoords.topLeft.x, reserved[i].texCoords.topLeft.x);
+    EXPECT_EQ(again.texCoords.topLeft.y, reserved[i].texCoords.topLeft.y);
+    EXPECT_EQ(again.layer, reserved[i].layer);
+  }
+  EXPECT_EQ(uploads, 12) << "a cached glyph was uploaded again";
+}
+
+TEST_F(GlyphCacheTest, threadsReservingTheSameGlyphsAgree) {
+  const auto cache  = makeCache(4096, 8);
+  const auto glyphs = alphabet(40);
+  constexpr std::size_t threads = 4;
+
+  std::vector<std::vector<GlyphCache::Sizes>> seen(threads);
+  std::vector<std::thread> loaders;
+  for (std::size_t t = 0; t < threads; t++) {
+    loaders.emplace_back([&, t] {
+      // A font per thread, as each loader thread loads its own.
+      const auto face = font("Serif 24");
+      for (const auto &chr : glyphs) {
+        seen[t].push_back(cache->reserve(chr, face));
+      }
+    });
+  }
+  for (auto &loader : loaders) {
+    loader.join();
+  }
+  cache->commit();
+
+  EXPECT_EQ(uploads, static_cast<int>(glyphs.size()))
+      << "a glyph two threads raced on was placed twice";
+  for (std::size_t t = 1; t < threads; t++) {
+    for (std::size_t i = 0; i < glyphs.size(); i++) {
+      EXPECT_EQ(seen[t][i].texCoords.topLeft.x, seen[0][i].texCoords.topLeft.x);
+      EXPECT_EQ(seen[t][i].texCoords.topLeft.y, seen[0][i].texCoords.topLeft.y);
+      EXPECT_EQ(seen[t][i].layer, seen[0][i].layer);
+    }
+  }
+}
+
+// A page's clusters reserved at once land where reserving them one by one
+// would have put them, and each distinct one is drawn and uploaded once
+// however often it repeats or was cached before.
+TEST_F(GlyphCacheTest, reservingABatchAgreesWithReservingEach) {
+  const auto face  = font("Serif 24");
+  const auto glyph = alphabet(30);
+  std::vector<GlyphCache::Sizes> each;
+  {
+    // Gone before the next makeCache() replaces the device it was made on.
+    const auto one = makeCache(4096, 8);
+    for (const auto &chr : glyph) {
+      each.push_back(one->reserve(chr, face));
+    }
+  }
+
+  const auto cache = makeCache(4096, 8);
+  cache->put(glyph[3], face);
+  std::vector<std::string_view> page;
+  for (std::size_t i = 0; i < glyph.size(); i++) {
+    page.emplace_back(glyph[i]);
+    page.emplace_back(glyph[i % 4]);
+  }
+  const auto batch = cache->reserveAll(page, face);
+  cache->commit();
+
+  ASSERT_EQ(batch.size(), page.size());
+  EXPECT_EQ(uploads, static_cast<int>(glyph.size()));
+  for (std::size_t i = 0; i < page.size(); i++) {
+    const auto again = cache->reserve(page[i], face);
+    EXPECT_EQ(batch[i].texCoords.topLeft.x, again.texCoords.topLeft.x);
+    EXPECT_EQ(batch[i].texCoords.topLeft.y, again.texCoords.topLeft.y);
+    EXPECT_EQ(batch[i].layer, again.layer);
+    const auto &alone = each[i % 2 == 0 ? i / 2 : (i / 2) % 4];
+    EXPECT_EQ(batch[i].dims.width, alone.dims.width);
+    EXPECT_EQ(batch[i].dims.height, alone.dims.height);
+  }
+  EXPECT_EQ(uploads, static_cast<int>(glyph.size()))
+      << "a glyph the batch placed was placed again";
+}
+
+TEST_F(GlyphCacheTest, aBatchWithAnOverlongClusterIsRefusedWhole) {
+  const auto cache = makeCache(4096, 8);
+  const std::string longest(GlyphCache::maxClusterBytes + 1, 'a');
+  const std::vector<std::string_view> page{"A", longest};
+  EXPECT_THROW(cache->reserveAll(page, font("Serif 24")),
+               std::invalid_argument);
+  cache->commit();
+  EXPECT_EQ(uploads, 0);
+}
+
+/// A file of the test's own in the temporary directory, not there yet.
+static std::filesystem::path atlasFile(const std::string &name) {
+  const auto file = std::filesystem::temp_directory_path() /
+                    ("gleditor-glyph-cache-" + name + ".atlas");
+  std::filesystem::remove(file);
+  return file;
+}
+
+TEST_F(GlyphCacheTest, aSavedAtlasIsTakenUpAsItWas) {
+  const auto file = atlasFile("round-trip");
+  const auto face = font("Serif 150");
+  const auto glyph = alphabet(12);
+  std::vector<GlyphCache::Sizes> before;
+  int savedSize = 0;
+  {
+    const auto cache = makeCache(4096, 8);
+    for (const auto &chr : glyph) {
+      before.push_back(cache->put(chr, face));
+    }
+    ASSERT_GT(allocations.size(), 1U) << "the atlas did not grow";
+    savedSize = cache->atlasSize();
+    ASSERT_TRUE(cache->save(file));
+    EXPECT_FALSE(cache->save(file)) << "saved again with nothing new";
+  }
+
+  const auto cache = makeCache(4096, 8);
+  ASSERT_TRUE(cache->restore(file));
+  EXPECT_EQ(cache->atlasSize(), savedSize);
+  EXPECT_EQ(uploads, cache->atlasLayers()) << "not one upload per layer";
+  const auto restored = uploads;
+  for (std::size_t i = 0; i < glyph.size(); i++) {
+    const auto again = cache->put(glyph[i], face);
+    EXPECT_EQ(again.texCoords.topLeft.x, before[i].texCoords.topLeft.x);
+    EXPECT_EQ(again.texCoords.topLeft.y, before[i].texCoords.topLeft.y);
+    EXPECT_EQ(again.texCoords.box.width, before[i].texCoords.box.width);
+    EXPECT_EQ(again.layer, before[i].layer);
+    EXPECT_EQ(again.dims.width, before[i].dims.width);
+    EXPECT_FLOAT_EQ(again.ink, before[i].ink);
+  }
+  EXPECT_EQ(uploads, restored) << "a restored glyph was drawn again";
+
+  // A glyph that was not there is placed beside the others, not over them.
+  const auto fresh = cache->put("Z'''", face);
+  for (const auto &sizes : before) {
+    EXPECT_FALSE(fresh.layer == sizes.layer &&
+                 fresh.texCoords.topLeft.x == sizes.texCoords.topLeft.x &&
+                 fresh.texCoords.topLeft.y == sizes.texCoords.topLeft.y);
+  }
+}
+
+TEST_F(GlyphCacheTest, onlyAnEmptyCacheTakesUpAnAtlas) {
+  const auto file = atlasFile("occupied");
+  {
+    const auto cache = makeCache(4096, 8);
+    cache->put("A", font("Serif 24"));
+    ASSERT_TRUE(cache->save(file));
+  }
+  const auto cache = makeCache(4096, 8);
+  cache->put("B", font("Serif 24"));
+  EXPECT_FALSE(cache->restore(file));
+}
+
+TEST_F(GlyphCacheTest, anAtlasTooLargeForTheDeviceIsNotTakenUp) {
+  const auto file = atlasFile("too-large");
+  {
+    const auto cache = makeCache(4096, 8);
+    for (const auto &chr : alphabet(12)) {
+      cache->put(chr, font("Serif 150"));
+    }
+    ASSERT_GT(cache->atlasSize(), 512);
+    ASSERT_TRUE(cache->save(file));
+  }
+  const auto cache = makeCache(512, 8);
+  EXPECT_FALSE(cache->restore(file));
+  EXPECT_EQ(uploads, 0);
+}
+
+TEST_F(GlyphCacheTest, noFileIsNoAtlas) {
+  const auto cache = makeCache(4096, 8);
+  EXPECT_FALSE(cache->restore(atlasFile("absent")));
+  EXPECT_FALSE(cache->save(atlasFile("empty"))) << "saved an empty atlas";
+}
+
+// A session drawing more distinct glyphs than the atlas can ever hold goes on
+// drawing them: what nothing cites is evicted, and the atlas stays at the
+// ceiling rather than failing at it.
+TEST_F(GlyphCacheTest, evictsWhatNothingCitesOnceItCannotGrow) {
+  const auto cache = makeCache(512, 2);
+  const auto face  = font("Serif 150");
+  for (const auto &chr : alphabet(60)) {
+    EXPECT_NO_THROW(cache->put(chr, face)) << chr;
+  }
+  EXPECT_GT(cache->committedRepacks(), 0U);
+  EXPECT_EQ(cache->atlasSize(), 512);
+  EXPECT_EQ(cache->atlasLayers(), 2);
+
+  // The glyph asked for last is still there.
+  const auto last    = alphabet(60).back();
+  const auto uploads = this->uploads;
+  cache->put(last, face);
+  EXPECT_EQ(this->uploads, uploads);
+}
+
+// Cited glyphs are never evicted, only moved, and lookUp() says where to.
+TEST_F(GlyphCacheTest, keepsWhatIsCitedThroughARepack) {
+  const auto cache = makeCache(512, 2);
+  const auto face  = font("Serif 150");
+  const auto glyph = alphabet(40);
+  GlyphCitation held;
+  std::vector<std::uint32_t> numbers;
+  std::vector<GlyphCache::Sizes> before;
+  for (std::size_t i = 0; i < 3; i++) {
+    before.push_back(cache->put(glyph[i], face, &held));
+    numbers.push_back(before.back().glyph);
+  }
+  for (std::size_t i = 3; i < glyph.size(); i++) {
+    cache->put(glyph[i], face);
+  }
+  ASSERT_GT(cache->committedRepacks(), 0U);
+
+  std::vector<GlyphCache::Sizes> now(numbers.size());
+  ASSERT_EQ(cache->lookUp(numbers, now), cache->committedRepacks());
+  const auto uploads = this->uploads;
+  for (std::size_t i = 0; i < numbers.size(); i++) {
+    EXPECT_EQ(now[i].glyph, numbers[i]);
+    EXPECT_EQ(now[i].dims.width, before[i].dims.width);
+    EXPECT_EQ(now[i].dims.height, before[i].dims.height);
+    const auto again = cache->put(glyph[i], face);
+    EXPECT_EQ(again.texCoords.topLeft.x, now[i].texCoords.topLeft.x);
+    EXPECT_EQ(again.texCoords.topLeft.y, now[i].texCoords.topLeft.y);
+    EXPECT_EQ(again.layer, now[i].layer);
+  }
+  EXPECT_EQ(this->uploads, uploads) << "a cited glyph was evicted";
+}
+
+// Room is never taken from what is cited: with everything cited, a full
+// atlas refuses as it always did, and takes glyphs again once let go of.
+TEST_F(GlyphCacheTest, refusesOnceEverythingLeftIsCited) {
+  const auto cache = makeCache(512, 2);
+  const auto face  = font("Serif 150");
+  GlyphCitation held;
+  const auto glyph = alphabet(60);
+  std::size_t refusedAt = glyph.size();
+  for (std::size_t i = 0; i < glyph.size(); i++) {
+    try {
+      cache->put(glyph[i], face, &held);
+    } catch (const std::overflow_error &) {
+      refusedAt = i;
+      break;
+    }
+  }
+  ASSERT_LT(refusedAt, glyph.size()) << "held more than the atlas can";
+  EXPECT_EQ(cache->committedRepacks(), 0U);
+
+  held.release();
+  cache->commit();
+  EXPECT_NO_THROW(cache->put(glyph[refusedAt], face));
+}
+
+// A repack planned off the render thread moves glyphs the texture does not
+// have there yet: nothing is looked up until commit() has made it.
+TEST_F(GlyphCacheTest, aRepackIsLookedUpOnlyOnceCommitted) {
+  const auto cache = makeCache(512, 2);
+  const auto face  = font("Serif 150");
+  const auto glyph = alphabet(60);
+  GlyphCitation held;
+  const std::vector<std::uint32_t> numbers{
+      cache->put(glyph[0], face, &held).glyph};
+  std::size_t next = 1;
+  for (; next < glyph.size() && cache->repacks() == 0; next++) {
+    cache->reserve(glyph[next], face);
+    cache->commit();
+  }
+  ASSERT_GT(cache->repacks(), 0U);
+  for (; next < glyph.size() &&
+         cache->repacks() == cache->committedRepacks();
+       next++) {
+    cache->reserve(glyph[next], face);
+  }
+  ASSERT_NE(cache->repacks(), cache->committedRepacks());
+
+  std::vector<GlyphCache::Sizes> now(1);
+  EXPECT_FALSE(cache->lookUp(numbers, now).has_value());
+  cache->commit();
+  EXPECT_EQ(cache->lookUp(numbers, now), cache->committedRepacks());
+  EXPECT_EQ(now[0].glyph, numbers[0]);
+}
+
+// Glyphs read back from a file are numbered like any other, so a session
+// that starts from a full atlas can still evict from it.
+TEST_F(GlyphCacheTest, aRestoredAtlasCanBeEvictedFrom) {
+  const auto file = atlasFile("evicted");
+  const auto face = font("Serif 150");
+  const auto glyph = alphabet(40);
+  {
+    const auto cache = makeCache(512, 2);
+    GlyphCitation held;
+    for (std::size_t i = 0; i < glyph.size(); i++) {
+      try {
+        cache->put(glyph[i], face, &held);
+      } catch (const std::overflow_error &) {
+        break;
+      }
+    }
+    ASSERT_TRUE(cache->save(file));
+  }
+  const auto cache = makeCache(512, 2);
+  ASSERT_TRUE(cache->restore(file));
+  cache->commit();
+  for (const auto &chr : alphabet(80)) {
+    EXPECT_NO_THROW(cache->put(chr + "~", face)) << chr;
+  }
+  EXPECT_GT(cache->committedRepacks(), 0U);
+}
+
+// A session at the ceiling, as a document scrolled through a small atlas has
+// it: pages come and go, each citing its glyphs, the atlas opens small, grows
+// to what the device allows and then repacks again and again. After every
+// frame, each resident page's rows -- moved as Page::relocateGlyphs() moves
+// them -- must name texels holding the glyph they were written for.
+TEST_F(GlyphCacheTest, aSessionAtTheCeilingKeepsEveryRowOnItsGlyph) {
+  const auto *const opening = std::getenv("GLEDITOR_ATLAS_SIZE");
+  const std::optional<std::string> restore =
+      nullptr == opening ? std::nullopt : std::optional<std::string>(opening);
+  setenv("GLEDITOR_ATLAS_SIZE", "256", 1);
+  const auto cache = makeCache(512, 2);
+  if (restore) {
+    setenv("GLEDITOR_ATLAS_SIZE", restore->c_str(), 1);
+  } else {
+    unsetenv("GLEDITOR_ATLAS_SIZE");
+  }
+  ASSERT_EQ(cache->atlasSize(), 256);
+
+  // Every upload, kept per texture and layer at the ceiling's size, so what a
+  // row names can be read back.
+  constexpr int side = 512;
+  std::map<std::pair<std::uint32_t, int>, std::vector<std::byte>> texels;
+  ON_CALL(*device,
+          updateTextureLayer(testing::_, testing::_, testing::_, testing::_,
+                             testing::_, testing::_, testing::_))
+      .WillByDefault([this, &texels](const render::TextureHandle texture,
+                                     const int layer, const int x, const int y,
+                                     const int width, const int height,
+                                     const std::span<const std::byte> data) {
+        uploads++;
+        auto &plane = texels[{texture.id, layer}];
+        plane.resize(static_cast<std::size_t>(side) * side);
+        for (int row = 0; row < height; row++) {
+          const auto from = static_cast<std::ptrdiff_t>(row) * width;
+          const auto to   = (static_cast<std::ptrdiff_t>(y + row) * side) + x;
+          std::copy_n(data.begin() + from, width, plane.begin() + to);
+        }
+      });
+  const auto read = [&](const GlyphCache::Sizes &glyph) {
+    const auto &plane = texels[{cache->textureHandle().id, glyph.layer}];
+    const auto x      = static_cast<int>(glyph.texCoords.topLeft.x);
+    const auto y      = static_cast<int>(glyph.texCoords.topLeft.y);
+    const auto width  = static_cast<int>(std::to_underlying(glyph.dims.width));
+    const auto height = static_cast<int>(std::to_underlying(glyph.dims.height));
+    std::vector<std::byte> out;
+    if (plane.empty()) {
+      return out;
+    }
+    for (int row = 0; row < height; row++) {
+      const auto from = plane.begin() +
+                        (static_cast<std::ptrdiff_t>(y + row) * side) + x;
+      out.insert(out.end(), from, from + width);
+    }
+    return out;
+  };
+
+  struct Page {
+    std::vector<std::string> clusters;
+    std::vector<std::uint32_t> numbers;
+    std::vector<GlyphCache::Sizes> rows;
+    std::uint64_t glyphsAt{};
+    GlyphCitation citation;
+  };
+  const auto face  = font("Serif 150");
+  const auto glyph = alphabet(120);
+  std::deque<std::unique_ptr<Page>> resident;
+  // What each cluster looked like the first time a row drew it.
+  std::map<std::string, std::vector<std::byte>> drawn;
+  // Each page shares a glyph with the one before it. Two resident pages and
+  // the one being built cite no more than the atlas holds at 150 points.
+  constexpr std::size_t perPage = 2;
+  for (std::size_t frame = 0; frame + perPage <= glyph.size(); frame++) {
+    auto page      = std::make_unique<Page>();
+    page->glyphsAt = cache->repacks();
+    for (std::size_t i = frame; i < frame + perPage; i++) {
+      const auto placed = cache->reserve(glyph[i], face, &page->citation);
+      page->clusters.push_back(glyph[i]);
+      page->numbers.push_back(placed.glyph);
+      page->rows.push_back(placed);
+    }
+    cache->commit();
+    resident.push_back(std::move(page));
+    if (resident.size() > 2) {
+      resident.pop_front();
+    }
+
+    for (const auto &held : resident) {
+      if (held->glyphsAt != cache->committedRepacks()) {
+        std::vector<GlyphCache::Sizes> now(held->numbers.size());
+        const auto answered = cache->lookUp(held->numbers, now);
+        ASSERT_TRUE(answered.has_value()) << "frame " << frame;
+        held->rows     = now;
+        held->glyphsAt = *answered;
+      }
+      for (std::size_t row = 0; row < held->rows.size(); row++) {
+        const auto &cluster = held->clusters[row];
+        const auto seen     = read(held->rows[row]);
+        ASSERT_FALSE(seen.empty()) << cluster << " at frame " << frame;
+        EXPECT_EQ(drawn.try_emplace(cluster, seen).first->second, seen)
+            << cluster << " moved away from its rows at frame " << frame;
+      }
+    }
+  }
+
+  EXPECT_EQ(cache->atlasSize(), 512);
+  EXPECT_EQ(cache->atlasLayers(), 2);
+  EXPECT_GT(cache->committedRepacks(), 1U);
+  for (const auto &[size, layers] : allocations) {
+    EXPECT_LE(size, 512);
+    EXPECT_LE(layers, 2);
+  }
+}
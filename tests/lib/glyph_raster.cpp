@@ -0,0 +1,131 @@
+/**
+ * @file glyph_raster.cpp
+ * @brief Tests for drawing clusters into coverage with reused scratch.
+ */
+#include <gtest/gtest.h>
+
+#include <gleditor/glyphcache/raster.hpp>
+#include <gleditor/render/worker_pool.hpp>
+
+#include <algorithm>
+#include <cairomm/context.h>
+#include <cairomm/surface.h>
+#include <cstddef>
+#include <pango/pango-layout.h>
+#include <pangomm/context.h>
+#include <pangomm/fontdescription.h>
+#include <pangomm/init.h>
+#include <pangomm/layout.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+/// Distinct CJK ideographs from U+4E00, @p count of them.
+std::vector<std::string> ideographs(const std::size_t count) {
+  std::vector<std::string> out;
+  for (std::size_t i = 0; i < count; i++) {
+    const auto code = static_cast<unsigned>(0x4E00 + i);
+    out.push_back({static_cast<char>(0xE0 | (code >> 12)),
+                   static_cast<char>(0x80 | ((code >> 6) & 0x3F)),
+                   static_cast<char>(0x80 | (code & 0x3F))});
+  }
+  return out;
+}
+
+} // namespace
+
+class GlyphRasterTest : public testing::Test {
+protected:
+  void SetUp() override { Pango::init(); }
+};
+
+// The drawing surface is reused and only ever grows, so a small glyph drawn
+// after a large one must come out as it would have on a surface of its own.
+TEST_F(GlyphRasterTest, aGlyphDrawnAfterALargerOneIsUnchanged) {
+  const Pango::FontDescription small("Serif 12");
+  const Pango::FontDescription large("Serif 120");
+  const auto first = rasteriseCluster("i", small);
+  static_cast<void>(rasteriseCluster("W", large));
+  const auto again = rasteriseCluster("i", small);
+  EXPECT_EQ(first.width, again.width);
+  EXPECT_EQ(first.height, again.height);
+  EXPECT_EQ(first.coverage, again.coverage);
+  EXPECT_FALSE(first.coverage.empty());
+}
+
+TEST_F(GlyphRasterTest, aClusterWithNothingToDrawHasNoCoverage) {
+  const auto drawn = rasteriseCluster("", Pango::FontDescription("Serif 12"));
+  EXPECT_TRUE(drawn.coverage.empty());
+}
+
+// Each worker draws with its own layout and surface; what it draws has to be
+// what the calling thread would have drawn, byte for byte and in order.
+TEST_F(GlyphRasterTest, drawingOnAPoolMatchesDrawingInTurn) {
+  const Pango::FontDescription font("Sans 18");
+  const auto clusters = ideographs(96);
+  render::WorkerPool pool(4);
+
+  // Text keys only, which are laid out in the description and need no face.
+  const RasterFont raster{.description = font, .face = nullptr};
+  const auto serial   = rasteriseClusters(clusters, raster, nullptr);
+  const auto parallel = rasteriseClusters(clusters, raster, &pool);
+  ASSERT_EQ(serial.size(), clusters.size());
+  ASSERT_EQ(parallel.size(), clusters.size());
+  for (std::size_t i = 0; i < clusters.size(); i++) {
+    EXPECT_EQ(serial[i].width, parallel[i].width) << "cluster " << i;
+    EXPECT_EQ(serial[i].height, parallel[i].height) << "cluster " << i;
+    EXPECT_EQ(serial[i].coverage, parallel[i].coverage) << "cluster " << i;
+  }
+}
+
+TEST_F(GlyphRasterTest, shapedKeysAreToldFromText) {
+  const std::vector<ShapedGlyph> glyphs{{36, 0, 0}, {1021, 2048, -512}};
+  std::string key;
+  ASSERT_TRUE(appendShapedKey(key, 12, 20, 15360, glyphs));
+  EXPECT_EQ(key.size(), shapedKeyBytes(glyphs.size()));
+  EXPECT_TRUE(isShapedKey(key));
+  for (const std::string text : {"A", "ffi", "\xE4\xB8\x80", ""}) {
+    EXPECT_FALSE(isShapedKey(text)) << text;
+  }
+
+  const std::vector<ShapedGlyph> tooMany(maxShapedGlyphs + 1);
+  std::string refused = "kept";
+  EXPECT_FALSE(appendShapedKey(refused, 12, 20, 0, tooMany));
+  EXPECT_EQ(refused, "kept");
+}
+
+// A cluster drawn from the glyph Pango shaped it into comes out the size its
+// text does, and inked: it is the same glyph, only not laid out again.
+TEST_F(GlyphRasterTest, aShapedClusterIsDrawnFromItsGlyphs) {
+  const auto layout = Pango::Layout::create(Cairo::Context::create(
+      Cairo::ImageSurface::create(Cairo::Surface::Format::ARGB32, 0, 0)));
+  const Pango::FontDescription desc("Serif 40");
+  layout->set_font_description(desc);
+  layout->set_text("A");
+
+  auto iter = layout->get_iter();
+  Pango::Rectangle ink;
+  Pango::Rectangle logical;
+  iter.get_cluster_extents(ink, logical);
+  const auto *const run = pango_layout_iter_get_run_readonly(iter.gobj());
+  ASSERT_NE(run, nullptr);
+  ASSERT_EQ(run->glyphs->num_glyphs, 1);
+  const auto &info = run->glyphs->glyphs[0];
+  const std::vector<ShapedGlyph> glyphs{
+      {info.glyph, info.geometry.x_offset, info.geometry.y_offset}};
+  std::string key;
+  ASSERT_TRUE(appendShapedKey(key, PANGO_PIXELS_CEIL(logical.get_width()),
+                              PANGO_PIXELS_CEIL(logical.get_height()),
+                              iter.get_baseline() - logical.get_y(), glyphs));
+
+  const auto font = rasterFontOf(layout->get_context()->load_font(desc));
+  const auto shaped = rasteriseKey(key, font);
+  const auto text   = rasteriseKey("A", font);
+  EXPECT_EQ(shaped.width, text.width);
+  EXPECT_EQ(shaped.height, text.height);
+  ASSERT_EQ(shaped.coverage.size(), text.coverage.size());
+  EXPECT_TRUE(std::any_of(shaped.coverage.begin(), shaped.coverage.end(),
+                          [](const std::byte b) { return b != std::byte{}; }));
+}
+// vi: set sw=2 sts=2 ts=2 et:
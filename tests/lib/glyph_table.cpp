@@ -0,0 +1,200 @@
+/**
+ * @file glyph_table.cpp
+ * @brief The glyph cache's flat index.
+ */
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <gleditor/glyphcache/glyph_table.hpp>
+
+namespace {
+
+using Table = GlyphTable<int, 64>;
+
+/// A cluster for @p index: distinct for distinct indices, and of a length
+/// that varies from one byte up to several.
+std::string cluster(const std::size_t index) {
+  std::string out(1 + (index % 7), static_cast<char>('a' + (index % 26)));
+  out += std::to_string(index);
+  return out;
+}
+
+} // namespace
+
+TEST(GlyphTable, findsWhatWasFiled) {
+  Table table;
+  EXPECT_TRUE(table.empty());
+  EXPECT_EQ(nullptr, table.find(0, "a"));
+  const auto [value, fresh] = table.insert(0, "a", 7);
+  EXPECT_TRUE(fresh);
+  EXPECT_EQ(7, *value);
+  ASSERT_NE(nullptr, table.find(0, "a"));
+  EXPECT_EQ(7, *table.find(0, "a"));
+  EXPECT_EQ(1U, table.size());
+}
+
+TEST(GlyphTable, keepsTheFirstValueFiled) {
+  Table table;
+  table.insert(3, "fi", 1);
+  const auto [value, fresh] = table.insert(3, "fi", 2);
+  EXPECT_FALSE(fresh);
+  EXPECT_EQ(1, *value);
+  EXPECT_EQ(1U, table.size());
+}
+
+TEST(GlyphTable, tellsFontsApart) {
+  Table table;
+  table.insert(0, "g", 10);
+  table.insert(1, "g", 11);
+  EXPECT_EQ(10, *table.find(0, "g"));
+  EXPECT_EQ(11, *table.find(1, "g"));
+  EXPECT_EQ(nullptr, table.find(2, "g"));
+}
+
+TEST(GlyphTable, tellsAClusterFromItsPrefix) {
+  Table table;
+  table.insert(0, "f", 1);
+  table.insert(0, "ff", 2);
+  table.insert(0, "ffi", 3);
+  EXPECT_EQ(1, *table.find(0, "f"));
+  EXPECT_EQ(2, *table.find(0, "ff"));
+  EXPECT_EQ(3, *table.find(0, "ffi"));
+  EXPECT_EQ(nullptr, table.find(0, "ffl"));
+}
+
+TEST(GlyphTable, holdsBytesThatAreNotText) {
+  Table table;
+  const std::string shaped{"\xFF\0\0\x01\0", 5};
+  const std::string other{"\xFF\0\0\x02\0", 5};
+  table.insert(0, shaped, 1);
+  table.insert(0, other, 2);
+  table.insert(0, "", 3);
+  EXPECT_EQ(1, *table.find(0, shaped));
+  EXPECT_EQ(2, *table.find(0, other));
+  EXPECT_EQ(3, *table.find(0, ""));
+}
+
+TEST(GlyphTable, holdsTheLongestCluster) {
+  Table table;
+  const std::string longest(64, 'x');
+  table.insert(0, longest, 5);
+  EXPECT_EQ(5, *table.find(0, longest));
+  EXPECT_EQ(nullptr, table.find(0, longest.substr(1)));
+}
+
+// Enough entries to grow the table many times over, with everything still
+// found after every growth.
+TEST(GlyphTable, findsEverythingAsItGrows) {
+  Table table;
+  constexpr std::size_t entries = 20000;
+  for (std::size_t i = 0; i < entries; i++) {
+    const auto font = static_cast<std::uint32_t>(i % 3);
+    ASSERT_TRUE(table.insert(font, cluster(i), static_cast<int>(i)).second);
+    if (0 == (i & (i + 1))) {
+      for (std::size_t j = 0; j <= i; j++) {
+        const auto *const found =
+            table.find(static_cast<std::uint32_t>(j % 3), cluster(j));
+        ASSERT_NE(nullptr, found) << j << " of " << i;
+        ASSERT_EQ(static_cast<int>(j), *found);
+      }
+    }
+  }
+  EXPECT_EQ(entries, table.size());
+  EXPECT_EQ(nullptr, table.find(3, cluster(0)));
+}
+
+TEST(GlyphTable, visitsEveryEntryOnce) {
+  Table table;
+  std::map<std::pair<std::uint32_t, std::string>, int> filed;
+  for (std::size_t i = 0; i < 500; i++) {
+    const auto font = static_cast<std::uint32_t>(i % 5);
+    table.insert(font, cluster(i), static_cast<int>(i));
+    filed[{font, cluster(i)}] = static_cast<int>(i);
+  }
+  std::map<std::pair<std::uint32_t, std::string>, int> visited;
+  table.forEach([&](const std::uint32_t font, const std::string_view chr,
+                    const int value) {
+    EXPECT_TRUE(visited.emplace(std::pair{font, std::string(chr)}, value)
+                    .second);
+  });
+  EXPECT_EQ(filed, visited);
+}
+
+TEST(GlyphTable, forgetsWhatWasErased) {
+  Table table;
+  table.insert(0, "a", 1);
+  table.insert(1, "a", 2);
+  EXPECT_TRUE(table.erase(0, "a"));
+  EXPECT_FALSE(table.erase(0, "a"));
+  EXPECT_EQ(nullptr, table.find(0, "a"));
+  EXPECT_EQ(2, *table.find(1, "a"));
+  EXPECT_EQ(1U, table.size());
+  const auto [value, fresh] = table.insert(0, "a", 3);
+  EXPECT_TRUE(fresh);
+  EXPECT_EQ(3, *value);
+}
+
+// Everything filed after an entry in its probe is still found once the entry
+// is gone, and erasing and refiling over and over neither loses entries nor
+// fills the table with tombstones.
+TEST(GlyphTable, findsPastWhatWasErased) {
+  Table table;
+  constexpr std::size_t entries = 3000;
+  for (std::size_t i = 0; i < entries; i++) {
+    table.insert(0, cluster(i), static_cast<int>(i));
+  }
+  for (int round = 0; round < 20; round++) {
+    for (std::size_t i = round % 2; i < entries; i += 2) {
+      ASSERT_TRUE(table.erase(0, cluster(i))) << i;
+    }
+    for (std::size_t i = 0; i < entries; i++) {
+      const auto *const found = table.find(0, cluster(i));
+      if (i % 2 == static_cast<std::size_t>(round % 2)) {
+        ASSERT_EQ(nullptr, found) << i;
+      } else {
+        ASSERT_NE(nullptr, found) << i;
+        ASSERT_EQ(static_cast<int>(i), *found);
+      }
+    }
+    for (std::size_t i = round % 2; i < entries; i += 2) {
+      ASSERT_TRUE(table.insert(0, cluster(i), static_cast<int>(i)).second);
+    }
+  }
+  EXPECT_EQ(entries, table.size());
+  std::size_t visited = 0;
+  table.forEach([&](std::uint32_t, std::string_view, int) { visited++; });
+  EXPECT_EQ(entries, visited);
+}
+
+TEST(GlyphTable, changesAValueInPlace) {
+  Table table;
+  table.insert(2, "q", 1);
+  *table.find(2, "q") = 5;
+  EXPECT_EQ(5, *std::as_const(table).find(2, "q"));
+}
+
+TEST(GlyphTable, matchesEveryByteOfAGroup) {
+  // Laid out past a group's end too, since a probe reads wherever it starts.
+  std::array<std::uint8_t, glyph_table::groupWidth * 2> control{};
+  control.fill(glyph_table::emptyControl);
+  for (std::size_t at = 0; at < glyph_table::groupWidth; at++) {
+    control[at] = 0x2A;
+    control[at + glyph_table::groupWidth] = 0x2A;
+    EXPECT_EQ(1U << at, glyph_table::matchControl(control.data(), 0x2A))
+        << at;
+    EXPECT_EQ(0xFFFFU & ~(1U << at),
+              glyph_table::matchControl(control.data(),
+                                        glyph_table::emptyControl))
+        << at;
+    control[at] = glyph_table::emptyControl;
+  }
+}
+
+// vi: set sw=2 sts=2 ts=2 et:
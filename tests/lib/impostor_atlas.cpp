@@ -0,0 +1,119 @@
+/**
+ * @file impostor_atlas.cpp
+ * @brief Which pages' pictures are kept, and where.
+ */
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <set>
+#include <tuple>
+
+#include <gleditor/impostor_atlas.hpp>
+
+namespace {
+
+using gleditor::ImpostorAtlas;
+using gleditor::ImpostorSlot;
+
+/// Where a slot is, for telling two apart.
+auto placeOf(const ImpostorSlot &slot) {
+  return std::tuple{slot.layer, slot.x, slot.y};
+}
+
+TEST(ImpostorAtlasTest, aPictureIsFoundAtTheStepItWasMadeAt) {
+  ImpostorAtlas atlas(1024, 2);
+  const auto placed = atlas.place(1, -1, 400, 520);
+  ASSERT_TRUE(placed);
+  EXPECT_EQ(placed->width, 400U);
+  EXPECT_EQ(placed->height, 520U);
+  const auto found = atlas.find(1, -1);
+  ASSERT_TRUE(found);
+  EXPECT_EQ(placeOf(*found), placeOf(*placed));
+  // Made for a page further off, so not the picture wanted closer up.
+  EXPECT_FALSE(atlas.find(1, 0));
+  EXPECT_FALSE(atlas.find(2, -1));
+}
+
+TEST(ImpostorAtlasTest, picturesOfOneSizeShareALayerWithoutOverlapping) {
+  ImpostorAtlas atlas(1024, 1);
+  // 200 by 260 takes a 256 by 512 cell: eight to the layer.
+  std::set<std::tuple<std::uint32_t, std::uint32_t, std::uint32_t>> seen;
+  std::set<std::uint32_t> rows;
+  for (std::uint64_t page = 1; page <= 8; page++) {
+    const auto slot = atlas.place(page, -2, 200, 260);
+    ASSERT_TRUE(slot);
+    EXPECT_EQ(slot->layer, 0U);
+    EXPECT_EQ(slot->x % 256, 0U);
+    EXPECT_EQ(slot->y % 512, 0U);
+    seen.insert(placeOf(*slot));
+    rows.insert(slot->row);
+  }
+  EXPECT_EQ(seen.size(), 8U);
+  EXPECT_EQ(rows.size(), 8U);
+  EXPECT_EQ(atlas.layersUsed(), 1U);
+  EXPECT_EQ(atlas.stats().evictions, 0U);
+}
+
+TEST(ImpostorAtlasTest, theLeastRecentlyUsedPictureGoesFirst) {
+  ImpostorAtlas atlas(512, 1);
+  // Four 256 by 256 cells.
+  for (std::uint64_t page = 1; page <= 4; page++) {
+    ASSERT_TRUE(atlas.place(page, -1, 250, 250));
+  }
+  ASSERT_TRUE(atlas.find(1, -1));
+  const auto fifth = atlas.place(5, -1, 250, 250);
+  ASSERT_TRUE(fifth);
+  EXPECT_TRUE(atlas.holds(1));
+  EXPECT_FALSE(atlas.holds(2));
+  EXPECT_TRUE(atlas.holds(5));
+  EXPECT_EQ(atlas.stats().evictions, 1U);
+}
+
+TEST(ImpostorAtlasTest, aLayerIsCutAfreshForAnotherSize) {
+  ImpostorAtlas atlas(512, 1);
+  ASSERT_TRUE(atlas.place(1, -1, 250, 250));
+  ASSERT_TRUE(atlas.place(2, -1, 250, 250));
+  // Closer up, so larger than any cell the layer has: the layer goes, and
+  // both pictures in it.
+  const auto larger = atlas.place(3, 0, 500, 500);
+  ASSERT_TRUE(larger);
+  EXPECT_EQ(placeOf(*larger), (std::tuple{0U, 0U, 0U}));
+  EXPECT_FALSE(atlas.holds(1));
+  EXPECT_FALSE(atlas.holds(2));
+  EXPECT_EQ(atlas.stats().evictions, 2U);
+}
+
+TEST(ImpostorAtlasTest, placingAPageAgainReplacesItsPicture) {
+  ImpostorAtlas atlas(512, 1);
+  ASSERT_TRUE(atlas.place(1, -2, 100, 130));
+  const auto closer = atlas.place(1, -1, 200, 260);
+  ASSERT_TRUE(closer);
+  EXPECT_FALSE(atlas.find(1, -2));
+  EXPECT_TRUE(atlas.find(1, -1));
+  // Its own, not an eviction.
+  EXPECT_EQ(atlas.stats().evictions, 0U);
+}
+
+TEST(ImpostorAtlasTest, rowsAreHandedOutAgainOnceGiven) {
+  ImpostorAtlas atlas(512, 1);
+  const auto first = atlas.place(1, -1, 100, 100);
+  ASSERT_TRUE(first);
+  atlas.forget(1);
+  EXPECT_FALSE(atlas.holds(1));
+  const auto second = atlas.place(2, -1, 100, 100);
+  ASSERT_TRUE(second);
+  EXPECT_EQ(second->row, first->row);
+}
+
+TEST(ImpostorAtlasTest, aPictureLargerThanALayerIsNotHeld) {
+  ImpostorAtlas atlas(512, 1);
+  ASSERT_TRUE(atlas.place(1, -1, 100, 100));
+  EXPECT_FALSE(atlas.place(2, 0, 600, 100));
+  EXPECT_FALSE(atlas.place(3, 0, 0, 100));
+  // And nothing was let go of to find out.
+  EXPECT_TRUE(atlas.holds(1));
+}
+
+} // namespace
+
+// vi: set sw=2 sts=2 ts=2 et:
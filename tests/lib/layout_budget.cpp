@@ -0,0 +1,129 @@
+/**
+ * @file layout_budget.cpp
+ * @brief Which pages let their shaping go when over budget.
+ */
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <gleditor/layout_budget.hpp>
+
+namespace {
+
+using gleditor::LayoutBudget;
+using std::chrono::nanoseconds;
+using Pages = std::vector<std::uint32_t>;
+
+TEST(LayoutBudgetTest, withinBudgetEverythingIsKept) {
+  LayoutBudget budget(1000);
+  EXPECT_TRUE(budget.keep(0, 400, nanoseconds{400}).empty());
+  EXPECT_TRUE(budget.keep(1, 400, nanoseconds{400}).empty());
+  EXPECT_EQ(budget.heldBytes(), 800U);
+  EXPECT_TRUE(budget.holds(0));
+  EXPECT_TRUE(budget.holds(1));
+  EXPECT_EQ(budget.stats().evictions, 0U);
+}
+
+TEST(LayoutBudgetTest, theCheapestToShapeAgainGoesFirst) {
+  LayoutBudget budget(1000);
+  // The same size, so what decides is what each cost to make.
+  static_cast<void>(budget.keep(0, 300, nanoseconds{9000}));
+  static_cast<void>(budget.keep(1, 300, nanoseconds{300}));
+  static_cast<void>(budget.keep(2, 300, nanoseconds{3000}));
+  EXPECT_EQ(budget.keep(3, 300, nanoseconds{3000}), (Pages{1}));
+  EXPECT_FALSE(budget.holds(1));
+  EXPECT_EQ(budget.heldBytes(), 900U);
+}
+
+TEST(LayoutBudgetTest, sizeCountsAgainstAPageAsMuchAsCost) {
+  LayoutBudget budget(1000);
+  // Page 0 cost as much as page 1 to make but holds four times the memory,
+  // so it is worth a quarter as much per byte.
+  static_cast<void>(budget.keep(0, 800, nanoseconds{800}));
+  static_cast<void>(budget.keep(1, 200, nanoseconds{800}));
+  EXPECT_EQ(budget.keep(2, 200, nanoseconds{800}), (Pages{0}));
+}
+
+TEST(LayoutBudgetTest, onlyAsManyGoAsTheBudgetNeeds) {
+  LayoutBudget budget(1000);
+  static_cast<void>(budget.keep(0, 250, nanoseconds{250}));
+  static_cast<void>(budget.keep(1, 250, nanoseconds{500}));
+  static_cast<void>(budget.keep(2, 250, nanoseconds{750}));
+  static_cast<void>(budget.keep(3, 250, nanoseconds{1000}));
+  EXPECT_EQ(budget.keep(4, 600, nanoseconds{6000}), (Pages{0, 1, 2}));
+  EXPECT_EQ(budget.heldBytes(), 850U);
+  EXPECT_EQ(budget.stats().evictions, 3U);
+}
+
+TEST(LayoutBudgetTest, thePageJustShapedStaysHoweverLarge) {
+  LayoutBudget budget(100);
+  static_cast<void>(budget.keep(0, 50, nanoseconds{5000}));
+  // Over the budget on its own: everything else goes, and it is kept anyway.
+  EXPECT_EQ(budget.keep(1, 500, nanoseconds{1}), (Pages{0}));
+  EXPECT_TRUE(budget.holds(1));
+  EXPECT_EQ(budget.heldBytes(), 500U);
+}
+
+TEST(LayoutBudgetTest, ageWearsDownWhatALayoutWasWorth) {
+  LayoutBudget budget(300);
+  // Page 0 is the most expensive, but every eviction raises the floor the
+  // others are renewed against, and it is never used again.
+  static_cast<void>(budget.keep(0, 100, nanoseconds{500}));
+  for (std::uint32_t page = 1; page < 8; page++) {
+    static_cast<void>(budget.keep(page, 100, nanoseconds{200}));
+    budget.touch(page);
+  }
+  EXPECT_FALSE(budget.holds(0));
+}
+
+TEST(LayoutBudgetTest, aLayoutUsedAgainIsRenewed) {
+  LayoutBudget budget(300);
+  static_cast<void>(budget.keep(0, 100, nanoseconds{100}));
+  static_cast<void>(budget.keep(1, 100, nanoseconds{100}));
+  static_cast<void>(budget.keep(2, 100, nanoseconds{100}));
+  // Evicting page 0 raises the floor; page 1, used since, has its credit
+  // renewed above page 2's and outlasts it.
+  EXPECT_EQ(budget.keep(3, 100, nanoseconds{100}), (Pages{0}));
+  budget.touch(1);
+  EXPECT_EQ(budget.keep(4, 100, nanoseconds{100}), (Pages{2}));
+}
+
+TEST(LayoutBudgetTest, anUnmeasuredLayoutIsPricedAtTheGoingRate) {
+  LayoutBudget budget(300);
+  static_cast<void>(budget.keep(0, 100, nanoseconds{1000}));
+  static_cast<void>(budget.keep(1, 100, nanoseconds{3000}));
+  // Twenty nanoseconds a byte so far, between the two, so page 2 sits between
+  // them and page 0 is the one to go.
+  static_cast<void>(budget.keep(2, 100, nanoseconds{0}));
+  EXPECT_EQ(budget.keep(3, 100, nanoseconds{10000}), (Pages{0}));
+  EXPECT_EQ(budget.keep(4, 100, nanoseconds{10000}), (Pages{2}));
+}
+
+TEST(LayoutBudgetTest, keepingAPageAgainReplacesItsRecord) {
+  LayoutBudget budget(1000);
+  static_cast<void>(budget.keep(0, 400, nanoseconds{400}));
+  static_cast<void>(budget.keep(0, 300, nanoseconds{300}));
+  EXPECT_EQ(budget.heldBytes(), 300U);
+  budget.forget(0);
+  EXPECT_FALSE(budget.holds(0));
+  EXPECT_EQ(budget.heldBytes(), 0U);
+  // Forgetting what is not held, or touching it, changes nothing.
+  budget.forget(7);
+  budget.touch(7);
+  EXPECT_EQ(budget.heldBytes(), 0U);
+}
+
+TEST(LayoutBudgetTest, shapingIsCounted) {
+  LayoutBudget budget(1000);
+  budget.recordShaped();
+  budget.recordShaped();
+  budget.recordPrefetched();
+  EXPECT_EQ(budget.stats().shaped, 2U);
+  EXPECT_EQ(budget.stats().prefetched, 1U);
+}
+
+} // namespace
+
+// vi: set sw=2 sts=2 ts=2 et:
@@ -0,0 +1,83 @@
+/**
+ * @file load_queue.cpp
+ * @brief The order a loading document's unbuilt pages are built in.
+ */
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include <gleditor/load_queue.hpp>
+
+namespace {
+
+using gleditor::LoadQueue;
+
+/// A queue holding pages [from, to), page i starting at byte 100 * i.
+LoadQueue queueOf(const std::uint32_t from, const std::uint32_t to) {
+  LoadQueue queue;
+  for (auto i = from; i < to; i++) {
+    queue.defer({.index = i, .start = 100 * i});
+  }
+  return queue;
+}
+
+std::vector<std::uint32_t> indices(const std::vector<LoadQueue::Deferred> &of) {
+  std::vector<std::uint32_t> out;
+  for (const auto &page : of) {
+    out.push_back(page.index);
+  }
+  return out;
+}
+
+TEST(LoadQueueTest, withoutFocusPagesComeInTextOrder) {
+  auto queue = queueOf(3, 10);
+  EXPECT_EQ(indices(queue.take(3, {})), (std::vector<std::uint32_t>{3, 4, 5}));
+  EXPECT_EQ(queue.size(), 4U);
+}
+
+TEST(LoadQueueTest, pagesNearestTheFocusComeFirst) {
+  auto queue = queueOf(0, 100);
+  const std::vector<std::uint32_t> focus{80};
+  EXPECT_EQ(indices(queue.take(5, focus)),
+            (std::vector<std::uint32_t>{80, 79, 81, 78, 82}));
+}
+
+TEST(LoadQueueTest, severalFocusesShareTheFront) {
+  auto queue = queueOf(0, 100);
+  const std::vector<std::uint32_t> focus{10, 90};
+  EXPECT_EQ(indices(queue.take(4, focus)),
+            (std::vector<std::uint32_t>{10, 90, 9, 11}));
+}
+
+TEST(LoadQueueTest, aFocusPastTheQueueReachesItsEnd) {
+  // Placeholders estimated beyond what has been paginated are in view, so
+  // the last pages paginated are the nearest there are.
+  auto queue = queueOf(0, 20);
+  const std::vector<std::uint32_t> focus{500};
+  EXPECT_EQ(indices(queue.take(2, focus)),
+            (std::vector<std::uint32_t>{19, 18}));
+}
+
+TEST(LoadQueueTest, takeNearLeavesTheRest) {
+  auto queue = queueOf(0, 50);
+  const std::vector<std::uint32_t> focus{20, 22, 1};
+  const auto near = queue.takeNear(focus, 1);
+  EXPECT_EQ(indices(near),
+            (std::vector<std::uint32_t>{0, 1, 2, 19, 20, 21, 22, 23}));
+  EXPECT_EQ(near.front().start, 0U);
+  EXPECT_EQ(near.back().start, 2300U);
+  EXPECT_EQ(queue.size(), 42U);
+  EXPECT_TRUE(queue.takeNear(focus, 1).empty());
+}
+
+TEST(LoadQueueTest, drains) {
+  auto queue = queueOf(0, 5);
+  EXPECT_EQ(queue.take(10, {}).size(), 5U);
+  EXPECT_TRUE(queue.empty());
+  EXPECT_TRUE(queue.take(10, {}).empty());
+}
+
+} // namespace
+
+// vi: set sw=2 sts=2 ts=2 et:
@@ -0,0 +1,218 @@
+/**
+ * @file page_cache.cpp
+ * @brief Writing built pages down and reading them back.
+ */
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <gleditor/page_cache.hpp>
+#include <gleditor/page_paragraphs.hpp>
+
+namespace {
+
+using gleditor::CachedPageHeader;
+using gleditor::ClusterBox;
+using gleditor::PageCacheKey;
+using gleditor::PageCacheView;
+using gleditor::PageCacheWriter;
+using gleditor::PageParagraph;
+
+/// Rows of three bytes, so that nothing the writer pads falls on a boundary.
+constexpr std::uint32_t rowBytes = 3;
+
+PageCacheKey keyFor(const std::string &text) {
+  return {.textHash   = gleditor::hashText(gleditor::textHashSeed, text),
+          .textBytes  = text.size(),
+          .font       = "Monospace 12",
+          .pageWidth  = 500 * 1024,
+          .pageHeight = 700 * 1024,
+          .margin     = 20 * 1024,
+          .pango      = "1.50.0",
+          .rowBytes   = rowBytes};
+}
+
+/// A page of @p textBytes bytes in @p rows rows and as many clusters.
+struct BuiltPage {
+  CachedPageHeader header;
+  std::vector<std::byte> rows;
+  std::vector<ClusterBox> clusters;
+  std::vector<PageParagraph> paragraphs;
+  /// An odd length, so that what follows has to be realigned.
+  std::vector<std::byte> glyphs;
+
+  BuiltPage(const std::uint32_t textBytes, const std::uint32_t rowCount) {
+    header = {.textBytes      = textBytes,
+              .rowCount       = rowCount,
+              .clusterCount   = rowCount,
+              .paragraphCount = 1,
+              .pageWidth      = 500,
+              .pageHeight     = 700};
+    for (std::uint32_t i = 0; i < rowCount * rowBytes; i++) {
+      rows.push_back(static_cast<std::byte>(textBytes + i));
+    }
+    for (std::uint32_t i = 0; i < rowCount; i++) {
+      clusters.push_back({.byteStart = i, .byteLength = 1, .charCount = 1});
+    }
+    paragraphs.push_back({.bytes = textBytes, .clusterCount = rowCount});
+    for (std::uint32_t i = 0; i < (rowCount * 3) + 1; i++) {
+      glyphs.push_back(static_cast<std::byte>(rowCount + i));
+    }
+    header.glyphBytes = static_cast<std::uint32_t>(glyphs.size());
+  }
+
+  void addTo(PageCacheWriter &writer, const std::uint32_t index) const {
+    writer.add(index, header, rows, clusters, paragraphs, glyphs);
+  }
+};
+
+class PageCacheTest : public ::testing::Test {
+protected:
+  std::filesystem::path dir;
+
+  void SetUp() override {
+    dir = std::filesystem::temp_directory_path() /
+          ("gleditor-page-cache-" +
+           std::string(::testing::UnitTest::GetInstance()
+                           ->current_test_info()
+                           ->name()));
+    std::filesystem::remove_all(dir);
+  }
+
+  void TearDown() override { std::filesystem::remove_all(dir); }
+
+  static std::string slurp(const std::filesystem::path &path) {
+    std::ifstream in(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(in), {}};
+  }
+
+  /// Files in the cache directory, finished or not.
+  [[nodiscard]] std::size_t filesInDir() const {
+    return static_cast<std::size_t>(std::distance(
+        std::filesystem::directory_iterator(dir), {}));
+  }
+};
+
+TEST(PageCacheKeyTest, hashingInPiecesIsHashingTheWhole) {
+  const auto whole = gleditor::hashText(gleditor::textHashSeed, "abcdef");
+  const auto split = gleditor::hashText(
+      gleditor::hashText(gleditor::textHashSeed, "abc"), "def");
+  EXPECT_EQ(whole, split);
+}
+
+TEST(PageCacheKeyTest, anythingPagesDependOnNamesAnotherFile) {
+  const auto key = keyFor("some text");
+  auto font      = key;
+  font.font      = "Monospace 13";
+  auto width     = key;
+  width.pageWidth += 1;
+  auto pango     = key;
+  pango.pango    = "1.50.1";
+  auto rows      = key;
+  rows.rowBytes += 1;
+  for (const auto &other : {font, width, pango, rows, keyFor("some text!")}) {
+    EXPECT_NE(other.fileName(), key.fileName());
+  }
+  EXPECT_EQ(keyFor("some text").fileName(), key.fileName());
+}
+
+TEST_F(PageCacheTest, pagesComeBackAsTheyWereWritten) {
+  const auto key = keyFor(std::string(30, 'x'));
+  const std::array pages{BuiltPage(10, 4), BuiltPage(15, 5), BuiltPage(5, 1)};
+  PageCacheWriter writer(dir, key);
+  // In the order a loader finishes them, not the order they go in.
+  pages[1].addTo(writer, 1);
+  pages[0].addTo(writer, 0);
+  pages[2].addTo(writer, 2);
+  ASSERT_TRUE(writer.finish(3));
+
+  const auto bytes = slurp(writer.path());
+  const auto view  = PageCacheView::open(bytes, key);
+  ASSERT_TRUE(view.has_value());
+  ASSERT_EQ(view->size(), 3U);
+  for (std::size_t i = 0; i < pages.size(); i++) {
+    const auto page = view->page(i);
+    EXPECT_EQ(page.header.textBytes, pages[i].header.textBytes);
+    EXPECT_EQ(page.header.pageHeight, 700.0F);
+    ASSERT_EQ(page.rows.size(), pages[i].rows.size());
+    EXPECT_TRUE(std::equal(page.rows.begin(), page.rows.end(),
+                           pages[i].rows.begin()));
+    const auto clusters = page.clusterTable();
+    ASSERT_EQ(clusters.size(), pages[i].clusters.size());
+    EXPECT_EQ(clusters.back().byteStart, pages[i].clusters.back().byteStart);
+    const auto paragraphs = page.paragraphTable();
+    ASSERT_EQ(paragraphs.size(), 1U);
+    EXPECT_EQ(paragraphs[0].bytes, pages[i].header.textBytes);
+    ASSERT_EQ(page.glyphs.size(), pages[i].glyphs.size());
+    EXPECT_TRUE(std::equal(page.glyphs.begin(), page.glyphs.end(),
+                           pages[i].glyphs.begin()));
+  }
+  // Nothing left behind but the cache.
+  EXPECT_EQ(filesInDir(), 1U);
+}
+
+TEST_F(PageCacheTest, anotherKeyFindsNothingInTheFile) {
+  const auto key = keyFor("0123456789");
+  PageCacheWriter writer(dir, key);
+  BuiltPage(10, 2).addTo(writer, 0);
+  ASSERT_TRUE(writer.finish(1));
+  const auto bytes = slurp(writer.path());
+  auto other       = key;
+  other.font       = "Serif 12";
+  EXPECT_FALSE(PageCacheView::open(bytes, other).has_value());
+}
+
+TEST_F(PageCacheTest, aTruncatedFileIsNoCache) {
+  const auto key = keyFor(std::string(20, 'y'));
+  PageCacheWriter writer(dir, key);
+  BuiltPage(10, 6).addTo(writer, 0);
+  BuiltPage(10, 6).addTo(writer, 1);
+  ASSERT_TRUE(writer.finish(2));
+  const auto bytes = slurp(writer.path());
+  ASSERT_TRUE(PageCacheView::open(bytes, key).has_value());
+  for (std::size_t cut = 0; cut < bytes.size(); cut += 7) {
+    EXPECT_FALSE(
+        PageCacheView::open(std::string_view(bytes).substr(0, cut), key))
+        << "cut at " << cut;
+  }
+}
+
+TEST_F(PageCacheTest, aMissingPagePublishesNothing) {
+  const auto key = keyFor(std::string(20, 'z'));
+  PageCacheWriter writer(dir, key);
+  BuiltPage(10, 2).addTo(writer, 0);
+  BuiltPage(10, 2).addTo(writer, 2);
+  EXPECT_FALSE(writer.finish(3));
+  EXPECT_FALSE(std::filesystem::exists(writer.path()));
+  EXPECT_EQ(filesInDir(), 0U);
+}
+
+TEST_F(PageCacheTest, pagesThatDoNotAddUpToTheTextPublishNothing) {
+  const auto key = keyFor(std::string(25, 'w'));
+  PageCacheWriter writer(dir, key);
+  BuiltPage(10, 2).addTo(writer, 0);
+  BuiltPage(10, 2).addTo(writer, 1);
+  EXPECT_FALSE(writer.finish(2));
+  EXPECT_EQ(filesInDir(), 0U);
+}
+
+TEST_F(PageCacheTest, anAbandonedWriterLeavesNoTemporary) {
+  {
+    PageCacheWriter writer(dir, keyFor("abc"));
+    BuiltPage(3, 1).addTo(writer, 0);
+  }
+  EXPECT_EQ(filesInDir(), 0U);
+}
+
+} // namespace
+
+// vi: set sw=2 sts=2 ts=2 et:
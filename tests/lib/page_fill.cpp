@@ -17,6 +17,7 @@
 
 #include <cstddef>
 #include <string>
+#include <string_view>
 
 #include <pangomm/cairofontmap.h>
 #include <pangomm/fontdescription.h>
@@ -25,6 +26,7 @@
 #include <pangomm/layoutline.h>
 
 #include <gleditor/doc.hpp>
+#include <gleditor/piece_table.hpp>
 
 namespace {
 
@@ -185,6 +187,33 @@ TEST_F(PageFillTest, shapingTheSameBytesTwiceGivesTheSameAnswers) {
   }
 }
 
+TEST_F(PageFillTest, aFragmentedDocumentFillsThePageTheSameWay) {
+  // A document that has been typed into is many pieces rather than one
+  // string, and the page laid out from it must not be able to tell. Cut the
+  // same text into pieces a few hundred bytes long, and at an offset inside
+  // the first, and both pages must hold the same bytes.
+  const auto text = unbrokenText(64 * 1024);
+  gleditor::PieceTable pieces;
+  for (std::size_t at = 0; at < text.size(); at += 311) {
+    pieces.insert(pieces.size(), std::string_view(text).substr(at, 311));
+    // Something else typed in between, then removed, so consecutive pieces
+    // are not written next to each other and cannot merge.
+    pieces.insert(0, "x");
+    pieces.erase(0, 1);
+  }
+  ASSERT_EQ(pieces.str(), text);
+  ASSERT_GT(pieces.pieceCount(), 100U);
+
+  constexpr std::size_t from = 1000;
+  const auto fragmented      = pageLayout();
+  Doc::fillPage(fragmented, pieces, from);
+  const auto contiguous = pageLayout();
+  Doc::fillPage(contiguous, text.data() + from, text.size() - from);
+
+  EXPECT_EQ(fragmented->get_text().raw(), contiguous->get_text().raw());
+  EXPECT_EQ(Doc::consumedBytes(fragmented), Doc::consumedBytes(contiguous));
+}
+
 } // namespace
 
 // vi: set sw=2 sts=2 ts=2 et:
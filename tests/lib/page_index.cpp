@@ -0,0 +1,118 @@
+/**
+ * @file page_index.cpp
+ * @brief Page offsets as prefix sums, checked against the scan they replaced.
+ */
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <gleditor/page_index.hpp>
+
+namespace {
+
+using gleditor::PageIndex;
+
+/// The lookup Doc used to do: the last page whose start is at or before.
+std::size_t scanFor(const std::vector<std::uint64_t> &starts,
+                    const std::uint64_t offset) {
+  std::size_t found = 0;
+  for (std::size_t i = 0; i < starts.size(); i++) {
+    if (offset >= starts[i]) {
+      found = i;
+    }
+  }
+  return found;
+}
+
+PageIndex indexOf(const std::vector<std::uint32_t> &spans) {
+  PageIndex index;
+  for (const auto span : spans) {
+    index.push_back(span);
+  }
+  return index;
+}
+
+TEST(PageIndexTest, startsAreTheSumsOfTheSpansBefore) {
+  const auto index = indexOf({100, 250, 75, 4000});
+  EXPECT_EQ(index.startOf(0), 0U);
+  EXPECT_EQ(index.startOf(1), 100U);
+  EXPECT_EQ(index.startOf(2), 350U);
+  EXPECT_EQ(index.startOf(3), 425U);
+  EXPECT_EQ(index.total(), 4425U);
+}
+
+TEST(PageIndexTest, anOffsetFindsThePageItIsOn) {
+  const auto index = indexOf({100, 250, 75, 4000});
+  EXPECT_EQ(index.pageAt(0), 0U);
+  EXPECT_EQ(index.pageAt(99), 0U);
+  EXPECT_EQ(index.pageAt(100), 1U);
+  EXPECT_EQ(index.pageAt(424), 2U);
+  EXPECT_EQ(index.pageAt(425), 3U);
+  // Past the end is the last page, as the scan had it.
+  EXPECT_EQ(index.pageAt(1'000'000), 3U);
+}
+
+TEST(PageIndexTest, changingOneSpanMovesEveryLaterPage) {
+  // The reason for the index: an edit on page one moves pages two and three
+  // without anything being written to either.
+  auto index = indexOf({100, 250, 75, 4000});
+  index.setSpan(1, 260);
+  EXPECT_EQ(index.startOf(1), 100U);
+  EXPECT_EQ(index.startOf(2), 360U);
+  EXPECT_EQ(index.startOf(3), 435U);
+  index.setSpan(1, 10);
+  EXPECT_EQ(index.startOf(3), 185U);
+  EXPECT_EQ(index.pageAt(184), 2U);
+}
+
+TEST(PageIndexTest, splicingRenumbersTheRest) {
+  auto index = indexOf({10, 20, 30, 40});
+  const std::vector<std::uint32_t> replacement{5, 5, 5};
+  index.splice(1, 2, replacement);
+  ASSERT_EQ(index.size(), 5U);
+  EXPECT_EQ(index.startOf(4), 25U);
+  EXPECT_EQ(index.total(), 65U);
+  EXPECT_EQ(index.pageAt(24), 3U);
+}
+
+TEST(PageIndexTest, agreesWithTheScanItReplaced) {
+  PageIndex index;
+  std::vector<std::uint32_t> spans;
+  std::uint32_t state = 7;
+  const auto next     = [&state] {
+    state = state * 1664525U + 1013904223U;
+    return state >> 12;
+  };
+  for (int i = 0; i < 1152; i++) {
+    // An empty page now and again: two pages starting at the same byte is the
+    // case where "the last page starting there" has to mean the later one.
+    const auto span = 0 == i % 97 ? 0U : 3000 + (next() % 3000);
+    spans.push_back(span);
+    index.push_back(span);
+  }
+  for (int edit = 0; edit < 200; edit++) {
+    const auto page = next() % spans.size();
+    spans[page]     = 3000 + (next() % 3000);
+    index.setSpan(page, spans[page]);
+  }
+  std::vector<std::uint64_t> starts;
+  std::uint64_t sum = 0;
+  for (const auto span : spans) {
+    starts.push_back(sum);
+    sum += span;
+  }
+  ASSERT_EQ(index.total(), sum);
+  for (std::size_t page = 0; page < spans.size(); page++) {
+    ASSERT_EQ(index.startOf(page), starts[page]) << page;
+  }
+  for (std::uint64_t offset = 0; offset < sum + 10; offset += 1237) {
+    ASSERT_EQ(index.pageAt(offset), scanFor(starts, offset)) << offset;
+  }
+}
+
+} // namespace
+
+// vi: set sw=2 sts=2 ts=2 et:
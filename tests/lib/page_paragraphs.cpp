@@ -0,0 +1,116 @@
+/**
+ * @file page_paragraphs.cpp
+ * @brief A page's paragraphs, and its cluster table when one is laid out again.
+ */
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include <gleditor/page_paragraphs.hpp>
+
+namespace {
+
+using gleditor::ClusterBox;
+using gleditor::PageParagraph;
+
+TEST(PageParagraphsTest, paragraphsStartAfterEveryNewline) {
+  EXPECT_EQ(gleditor::paragraphStarts("one\ntwo\n\nfour"),
+            (std::vector<std::uint32_t>{0, 4, 8, 9}));
+  // A newline at the very end starts nothing on this page.
+  EXPECT_EQ(gleditor::paragraphStarts("one\n"),
+            (std::vector<std::uint32_t>{0}));
+  EXPECT_EQ(gleditor::paragraphStarts(""), (std::vector<std::uint32_t>{0}));
+}
+
+TEST(PageParagraphsTest, lineBreaksAreMeasuredAtTheEnd) {
+  EXPECT_EQ(gleditor::trailingBreak("text\n"), 1U);
+  EXPECT_EQ(gleditor::trailingBreak("text\r\n"), 2U);
+  EXPECT_EQ(gleditor::trailingBreak("text"), 0U);
+  EXPECT_EQ(gleditor::trailingBreak("\n"), 1U);
+}
+
+TEST(PageParagraphsTest, roomGrowsWithTheParagraph) {
+  EXPECT_EQ(gleditor::clusterRoomFor(0), 4U);
+  EXPECT_EQ(gleditor::clusterRoomFor(80), 90U);
+  EXPECT_GE(gleditor::spareRowsFor(0), 100U);
+  EXPECT_EQ(gleditor::spareRowsFor(16000), 1000U);
+}
+
+TEST(PageParagraphsTest, anOffsetIsHeldByTheParagraphItFallsIn) {
+  const std::vector<PageParagraph> paragraphs{
+      {.byteStart = 0, .bytes = 4}, {.byteStart = 4, .bytes = 6}};
+  EXPECT_EQ(gleditor::paragraphHolding(paragraphs, 0), 0U);
+  EXPECT_EQ(gleditor::paragraphHolding(paragraphs, 3), 0U);
+  EXPECT_EQ(gleditor::paragraphHolding(paragraphs, 4), 1U);
+  // The end of the page is still the last paragraph's.
+  EXPECT_EQ(gleditor::paragraphHolding(paragraphs, 10), 1U);
+  EXPECT_FALSE(gleditor::paragraphHolding(paragraphs, 11));
+  EXPECT_FALSE(gleditor::paragraphHolding({}, 0));
+}
+
+/// "ab\n" then "cd", each given room for four clusters.
+struct TwoParagraphs {
+  gleditor::ClusterTable clusters{std::vector<ClusterBox>{
+      {0, 1, 1}, {1, 2, 2}, {3, 0, 0}, {3, 0, 0},
+      {3, 1, 1}, {4, 1, 1}, {5, 0, 0}, {5, 0, 0}}};
+  std::vector<PageParagraph> paragraphs{
+      {.byteStart = 0,
+       .bytes = 3,
+       .firstCluster = 0,
+       .clusterCount = 2,
+       .clusterRoom = 4},
+      {.byteStart = 3,
+       .bytes = 2,
+       .firstCluster = 4,
+       .clusterCount = 2,
+       .clusterRoom = 4}};
+};
+
+TEST(PageParagraphsTest, aParagraphLaidOutAgainGrowsIntoItsRoom) {
+  TwoParagraphs page;
+  // "ab\n" became "aXb\n".
+  const std::vector<ClusterBox> fresh{{0, 1, 1}, {1, 1, 1}, {2, 2, 2}};
+  ASSERT_TRUE(gleditor::relayClusters(page.clusters, page.paragraphs, 0, fresh,
+                                      1));
+
+  EXPECT_EQ(page.paragraphs[0].bytes, 4U);
+  EXPECT_EQ(page.paragraphs[0].clusterCount, 3U);
+  EXPECT_EQ(page.clusters[2].byteLength, 2U);
+  // What is left of the room is empty and sits at the paragraph's end.
+  EXPECT_EQ(page.clusters[3].byteStart, 4U);
+  EXPECT_EQ(page.clusters[3].byteLength, 0U);
+  // Everything after moved by the byte inserted, and kept its index.
+  EXPECT_EQ(page.paragraphs[1].byteStart, 4U);
+  EXPECT_EQ(page.paragraphs[1].firstCluster, 4U);
+  EXPECT_EQ(page.clusters[4].byteStart, 4U);
+  EXPECT_EQ(page.clusters[5].byteStart, 5U);
+  EXPECT_EQ(page.clusters[7].byteStart, 6U);
+}
+
+TEST(PageParagraphsTest, aParagraphThatShrankEmptiesWhatItLeft) {
+  TwoParagraphs page;
+  // "ab\n" became "a\n".
+  const std::vector<ClusterBox> fresh{{0, 2, 2}};
+  ASSERT_TRUE(gleditor::relayClusters(page.clusters, page.paragraphs, 0, fresh,
+                                      -1));
+  EXPECT_EQ(page.clusters[1].byteLength, 0U);
+  EXPECT_EQ(page.clusters[1].byteStart, 2U);
+  EXPECT_EQ(page.paragraphs[1].byteStart, 2U);
+  EXPECT_EQ(page.clusters[4].byteStart, 2U);
+}
+
+TEST(PageParagraphsTest, aParagraphThatOutgrewItsRoomChangesNothing) {
+  TwoParagraphs page;
+  const auto before = page.paragraphs[1].byteStart;
+  const std::vector<ClusterBox> fresh(5, ClusterBox{0, 1, 1});
+  EXPECT_FALSE(gleditor::relayClusters(page.clusters, page.paragraphs, 0,
+                                       fresh, 3));
+  EXPECT_EQ(page.paragraphs[0].clusterCount, 2U);
+  EXPECT_EQ(page.paragraphs[1].byteStart, before);
+  EXPECT_EQ(page.clusters[1].byteLength, 2U);
+}
+
+} // namespace
+
+// vi: set sw=2 sts=2 ts=2 et:
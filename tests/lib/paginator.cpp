@@ -0,0 +1,229 @@
+/**
+ * @file paginator.cpp
+ * @brief Parallel pagination, checked against the chain one thread walks.
+ *
+ * Pango is not needed to check the stitching, only something with the
+ * property it relies on: lines restart at paragraphs, and a page laid out
+ * from a line start breaks where the whole document would. The stand-in here
+ * wraps every paragraph at a fixed width and fills a page by height, with some
+ * lines taller than others so that pages do not all hold the same number.
+ */
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gleditor/paginator.hpp>
+
+namespace {
+
+using gleditor::PaginationHooks;
+using gleditor::PaginationLine;
+
+class FakeDocument {
+public:
+  /// @param tallEvery one paragraph in this many is set in lines three times
+  ///        the usual height; zero for none.
+  FakeDocument(const std::size_t bytes, const std::uint32_t tallEvery) {
+    std::uint32_t state = 2463534242U;
+    std::uint32_t count = 0;
+    while (text.size() < bytes) {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      const bool tall = 0 != tallEvery && 0 == (++count % tallEvery);
+      text.push_back(tall ? '#' : 'p');
+      text.append(state % 400, 'x');
+      text.push_back('\n');
+    }
+  }
+
+  [[nodiscard]] std::uint32_t size() const {
+    return static_cast<std::uint32_t>(text.size());
+  }
+
+  [[nodiscard]] std::uint32_t
+  paragraphStart(const std::uint32_t offset) const {
+    const auto newline = text.find('\n', offset);
+    return std::string::npos == newline
+               ? size()
+               : static_cast<std::uint32_t>(newline + 1);
+  }
+
+  void lines(std::uint32_t from, const std::uint32_t to,
+             std::vector<PaginationLine> &out) const {
+    while (from < to) {
+      const auto end    = paragraphStart(from);
+      const auto height = heightOf(from);
+      for (auto line = from; line < end && line < to; line += lineBytes) {
+        out.push_back({.start = line, .height = height});
+      }
+      from = end;
+    }
+  }
+
+  /// The rule layPage() follows, told the heights rather than finding them.
+  [[nodiscard]] static std::size_t
+  linesPerPage(const std::span<const PaginationLine> lines) {
+    std::int32_t height = 0;
+    std::size_t held    = 0;
+    while (held < lines.size() &&
+           (0 == held || height + lines[held].height <= pageHeight)) {
+      height += lines[held++].height;
+    }
+    return held;
+  }
+
+  /// A page from @p start: lines while they fit, and always at least one.
+  [[nodiscard]] std::uint32_t layPage(const std::uint32_t start) const {
+    std::uint32_t line  = start;
+    std::int32_t height = 0;
+    while (line < size()) {
+      const auto tall = heightOf(line);
+      if (height + tall > pageHeight && line != start) {
+        break;
+      }
+      height += tall;
+      line = std::min(line + lineBytes, paragraphStart(line));
+    }
+    return line - start;
+  }
+
+private:
+  static constexpr std::uint32_t lineBytes = 60;
+  static constexpr std::int32_t pageHeight = 40;
+
+  std::string text;
+
+  /// Lines of a '#' paragraph are tall. Finding the paragraph a line is in is
+  /// a search backwards, which is slow and does not matter here.
+  [[nodiscard]] std::int32_t heightOf(const std::uint32_t line) const {
+    const auto newline = text.rfind('\n', line == 0 ? 0 : line - 1);
+    const auto first   = std::string::npos == newline || 0 == line
+                             ? 0
+                             : newline + 1;
+    return '#' == text[first] ? 3 : 1;
+  }
+};
+
+/// How paginateFake() guesses how many lines a page holds.
+enum class Guess : std::uint8_t {
+  /// As many as the last page did: paginate()'s own fallback.
+  lastPage,
+  /// By the rule the pages follow.
+  exactly,
+  /// Always one line too few.
+  wrongly,
+};
+
+/// Every page paginate() handed on, as (start, bytes), having checked that
+/// each came from the slot it was laid out in.
+std::vector<std::pair<std::uint32_t, std::uint32_t>>
+paginateFake(const FakeDocument &doc, const std::uint32_t parallelism,
+             const Guess guess                = Guess::lastPage,
+             gleditor::PaginationStats *stats = nullptr) {
+  std::vector<std::uint32_t> slotStarts(
+      gleditor::paginationSlots(parallelism));
+  std::vector<std::pair<std::uint32_t, std::uint32_t>> pages;
+  std::uint32_t expected = 0;
+
+  PaginationHooks hooks;
+  hooks.layPage = [&](const std::uint32_t start, const std::size_t slot) {
+    EXPECT_LT(slot, slotStarts.size());
+    slotStarts[slot] = start;
+    return doc.layPage(start);
+  };
+  hooks.lines = [&doc](const std::uint32_t from, const std::uint32_t to,
+                       std::vector<PaginationLine> &out) {
+    doc.lines(from, to, out);
+  };
+  if (Guess::lastPage != guess) {
+    hooks.linesPerPage = [guess](const std::span<const PaginationLine> lines) {
+      const auto held = FakeDocument::linesPerPage(lines);
+      return Guess::wrongly == guess ? std::max<std::size_t>(held, 2) - 1
+                                     : held;
+    };
+  }
+  hooks.paragraphStart = [&doc](const std::uint32_t offset) {
+    return doc.paragraphStart(offset);
+  };
+  hooks.accept = [&](const std::size_t slot, const std::uint32_t consumed) {
+    EXPECT_EQ(slotStarts[slot], expected) << "page " << pages.size();
+    pages.emplace_back(slotStarts[slot], consumed);
+    expected += consumed;
+  };
+
+  const auto ran = gleditor::paginate(doc.size(), parallelism, hooks);
+  EXPECT_EQ(ran.pages, pages.size());
+  if (nullptr != stats) {
+    *stats = ran;
+  }
+  return pages;
+}
+
+TEST(PaginatorTest, oneThreadWalksTheChain) {
+  const FakeDocument doc(20000, 0);
+  gleditor::PaginationStats stats;
+  const auto pages = paginateFake(doc, 1, Guess::lastPage, &stats);
+  ASSERT_FALSE(pages.empty());
+  EXPECT_EQ(pages.back().first + pages.back().second, doc.size());
+  EXPECT_EQ(stats.rounds, 0U);
+  EXPECT_EQ(stats.discarded, 0U);
+}
+
+TEST(PaginatorTest, uniformPagesAreGuessedFromTheLastOne) {
+  // Every page holds the same number of lines, so after the first page every
+  // guess holds and nothing is laid out twice.
+  const FakeDocument doc(300000, 0);
+  gleditor::PaginationStats stats;
+  const auto parallel = paginateFake(doc, 6, Guess::lastPage, &stats);
+  EXPECT_EQ(parallel, paginateFake(doc, 1));
+  EXPECT_EQ(stats.seamPages, 0U);
+  EXPECT_EQ(stats.discarded, 0U);
+  EXPECT_GT(stats.rounds, 1U);
+}
+
+TEST(PaginatorTest, irregularPagesAreGuessedByTheRule) {
+  const FakeDocument doc(300000, 7);
+  gleditor::PaginationStats stats;
+  EXPECT_EQ(paginateFake(doc, 8, Guess::exactly, &stats),
+            paginateFake(doc, 1));
+  EXPECT_EQ(stats.seamPages, 0U);
+}
+
+TEST(PaginatorTest, wrongGuessesComeOutAsTheChainDoes) {
+  // Tall paragraphs change how many lines a page holds, so guessing from the
+  // last page goes wrong and seams have to be laid out again; so does a rule
+  // that is simply mistaken. What comes out must not show it.
+  const FakeDocument doc(300000, 7);
+  const auto chain = paginateFake(doc, 1);
+  gleditor::PaginationStats stats;
+  for (const std::uint32_t threads : {2U, 3U, 8U, 16U}) {
+    for (const auto guess : {Guess::lastPage, Guess::wrongly}) {
+      EXPECT_EQ(paginateFake(doc, threads, guess, &stats), chain) << threads;
+      EXPECT_GT(stats.seamPages, 0U) << threads;
+    }
+  }
+}
+
+TEST(PaginatorTest, emptyTextHasNoPages) {
+  const FakeDocument doc(0, 0);
+  EXPECT_TRUE(paginateFake(doc, 4).empty());
+}
+
+TEST(PaginatorTest, parallelismIsOnlyForLargeTextOnSeveralCores) {
+  EXPECT_EQ(gleditor::paginationParallelism(64 * 1024, 16), 1U);
+  EXPECT_EQ(gleditor::paginationParallelism(64 * 1024 * 1024, 2), 1U);
+  EXPECT_EQ(gleditor::paginationParallelism(64 * 1024 * 1024, 16), 16U);
+  // Not more threads than there is text to give them.
+  EXPECT_EQ(gleditor::paginationParallelism(1536 * 1024, 16), 6U);
+}
+
+} // namespace
+
+// vi: set sw=2 sts=2 ts=2 et:
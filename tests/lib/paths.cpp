@@ -81,3 +81,13 @@ TEST_F(AssetPathTest, theSourceTreeFallbackNamesRealShaders) {
                                       "/glyph.vert.glsl"))
       << "run the tests from the repository root";
 }
+
+// The cache can be moved, which is how the tests and a read-only home keep
+// the page cache out of the user's own.
+TEST(CacheDirTest, theEnvironmentOverridesThePlatform) {
+  setenv("GLEDITOR_CACHE_DIR", "/tmp/somewhere", 1);
+  EXPECT_EQ(gleditor::cacheDir(), "/tmp/somewhere");
+  unsetenv("GLEDITOR_CACHE_DIR");
+  EXPECT_EQ(std::filesystem::path(gleditor::cacheDir()).filename(),
+            "gleditor");
+}
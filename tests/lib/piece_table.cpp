@@ -0,0 +1,230 @@
+/**
+ * @file piece_table.cpp
+ * @brief A document's text as pieces, checked against the string it replaced.
+ */
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <gleditor/piece_table.hpp>
+
+namespace {
+
+using gleditor::PieceTable;
+
+TEST(PieceTableTest, startsAsTheTextItWasGiven) {
+  const PieceTable table("hello world");
+  EXPECT_EQ(table.size(), 11U);
+  EXPECT_EQ(table.str(), "hello world");
+  EXPECT_EQ(table.pieceCount(), 1U);
+}
+
+TEST(PieceTableTest, anEmptyTableCanBeTypedInto) {
+  PieceTable table;
+  EXPECT_TRUE(table.empty());
+  table.insert(0, "abc");
+  table.insert(99, "def");
+  EXPECT_EQ(table.str(), "abcdef");
+}
+
+TEST(PieceTableTest, insertionLandsBeforeTheOffset) {
+  PieceTable table("held");
+  table.insert(2, "llo wor");
+  EXPECT_EQ(table.str(), "hello world");
+  table.insert(0, ">");
+  table.insert(table.size(), "<");
+  EXPECT_EQ(table.str(), ">hello world<");
+}
+
+TEST(PieceTableTest, typingInOneRunIsOnePiece) {
+  // The case the table is for: each keystroke lands where the last one ended
+  // and is written where the last one was, so the piece simply grows.
+  PieceTable table("0123456789");
+  std::size_t caret = 5;
+  for (const char chr : std::string_view("typed text")) {
+    table.insert(caret++, std::string_view(&chr, 1));
+  }
+  EXPECT_EQ(table.str(), "01234typed text56789");
+  EXPECT_EQ(table.pieceCount(), 3U);
+}
+
+TEST(PieceTableTest, erasureSpanningPiecesRemovesExactlyTheRange) {
+  PieceTable table("aaaa");
+  table.insert(2, "bbbb");
+  table.insert(8, "cccc");
+  ASSERT_EQ(table.str(), "aabbbbaacccc");
+  table.erase(1, 9);
+  EXPECT_EQ(table.str(), "acc");
+  table.erase(2, 99);
+  EXPECT_EQ(table.str(), "ac");
+  table.erase(5, 1);
+  EXPECT_EQ(table.str(), "ac");
+}
+
+TEST(PieceTableTest, aSliceWithinOnePieceIsNotCopied) {
+  const std::string original = "the original text";
+  PieceTable table(original);
+  std::string scratch;
+  const auto view = table.slice(4, 8, scratch);
+  EXPECT_EQ(view, "original");
+  EXPECT_TRUE(scratch.empty());
+}
+
+TEST(PieceTableTest, aSliceAcrossPiecesIsGathered) {
+  PieceTable table("one three");
+  table.insert(4, "two ");
+  std::string scratch;
+  const auto view = table.slice(0, 100, scratch);
+  EXPECT_EQ(view, "one two three");
+  EXPECT_EQ(view.data(), scratch.data());
+}
+
+TEST(PieceTableTest, lentTextIsReadWhereItIsUntilEdited) {
+  // A mapped file, in miniature: bytes the table does not own, and something
+  // standing for the mapping that has to outlive every view of them.
+  const auto mapping = std::make_shared<const std::string>("lent bytes here");
+  PieceTable table(*mapping, mapping);
+  std::string scratch;
+  EXPECT_EQ(table.slice(0, 4, scratch).data(), mapping->data());
+
+  table.insert(5, "and typed ");
+  EXPECT_EQ(table.str(), "lent and typed bytes here");
+  // The pieces either side of the edit still point into the lent bytes.
+  EXPECT_EQ(table.slice(15, 5, scratch).data(), mapping->data() + 5);
+  EXPECT_EQ(*mapping, "lent bytes here");
+}
+
+TEST(PieceTableTest, theTableKeepsWhatItBorrowsAlive) {
+  std::weak_ptr<const std::string> watch;
+  PieceTable table;
+  {
+    const auto mapping = std::make_shared<const std::string>("borrowed");
+    watch              = mapping;
+    table              = PieceTable(*mapping, mapping);
+  }
+  EXPECT_FALSE(watch.expired());
+  EXPECT_EQ(table.str(), "borrowed");
+  table = PieceTable();
+  EXPECT_TRUE(watch.expired());
+}
+
+TEST(PieceTableTest, runsCoverTheRangeInOrder) {
+  PieceTable table("ace");
+  table.insert(1, "b");
+  table.insert(3, "d");
+  std::string joined;
+  std::size_t runs = 0;
+  table.forEachRun(1, 3, [&](const std::string_view run) {
+    joined.append(run);
+    runs++;
+    return true;
+  });
+  EXPECT_EQ(joined, "bcd");
+  EXPECT_EQ(runs, 3U);
+}
+
+TEST(PieceTableTest, alignmentSeesAcrossPieceBoundaries) {
+  // An e-acute whose two bytes end up in different pieces: the boundary is a
+  // property of the text, not of how it happens to be stored.
+  PieceTable table("h\xC3");
+  table.insert(2, "\xA9llo");
+  ASSERT_EQ(table.str(), "h\xC3\xA9llo");
+  EXPECT_EQ(table.alignToCharacterStart(2), 1U);
+  EXPECT_EQ(table.alignToCharacterEnd(2), 3U);
+  EXPECT_EQ(table.alignToCharacterStart(99), 99U);
+}
+
+TEST(PieceTableTest, agreesWithAStringOverManyEdits) {
+  // Against the thing it replaced, over enough edits to build a deep tree and
+  // to reuse the nodes erasure frees.
+  std::string expected = "The quick brown fox jumps over the lazy dog.";
+  PieceTable table(expected);
+  std::uint32_t state = 12345;
+  const auto next     = [&state] {
+    state = state * 1103515245U + 12345U;
+    return state >> 8;
+  };
+  for (int i = 0; i < 4000; i++) {
+    const auto at = next() % (expected.size() + 1);
+    if (0 == next() % 3 && !expected.empty()) {
+      const auto bytes = 1 + next() % 7;
+      expected.erase(at, bytes);
+      table.erase(at, bytes);
+    } else {
+      const std::string text(1 + next() % 5,
+                             static_cast<char>('a' + (next() % 26)));
+      expected.insert(std::min<std::size_t>(at, expected.size()), text);
+      table.insert(at, text);
+    }
+    ASSERT_EQ(table.size(), expected.size()) << i;
+  }
+  EXPECT_EQ(table.str(), expected);
+  for (std::size_t i = 0; i < expected.size(); i += 97) {
+    EXPECT_EQ(table.at(i), expected[i]) << i;
+  }
+  EXPECT_EQ(table.substr(10, 50), expected.substr(10, 50));
+}
+
+TEST(PieceTableTest, aSnapshotIsTheTextWhenItWasTaken) {
+  PieceTable table(std::string("hello world"));
+  table.insert(5, ",");
+  const auto snapshot = table.snapshot();
+  table.insert(0, "oh, ");
+  table.erase(10, 3);
+  table.insert(table.size(), "!");
+  EXPECT_EQ(snapshot.size(), 12U);
+  EXPECT_EQ(snapshot.str(), "hello, world");
+  std::string tail;
+  snapshot.forEachRun(4, 5, [&tail](const std::string_view run) {
+    tail.append(run);
+    return true;
+  });
+  EXPECT_EQ(tail, "o, wo");
+}
+
+TEST(PieceTableTest, aSnapshotIsSlicedAsTheTableWas) {
+  PieceTable table(std::string("one three"));
+  table.insert(4, "two ");
+  const auto snapshot = table.snapshot();
+  table.erase(0, 8);
+  std::string scratch;
+  EXPECT_EQ(snapshot.slice(4, 3, scratch), "two");
+  EXPECT_TRUE(scratch.empty());
+  const auto view = snapshot.slice(0, 100, scratch);
+  EXPECT_EQ(view, "one two three");
+  EXPECT_EQ(view.data(), scratch.data());
+}
+
+TEST(PieceTableTest, aSnapshotOutlivesItsTable) {
+  std::optional<PieceTable::Snapshot> snapshot;
+  {
+    PieceTable table(std::string("kept"));
+    table.insert(4, " after all");
+    snapshot = table.snapshot();
+  }
+  EXPECT_EQ(snapshot->str(), "kept after all");
+}
+
+TEST(PieceTableTest, theSameTextIsTheSameHoweverItIsCutUp) {
+  PieceTable whole(std::string("one two three"));
+  PieceTable edited(std::string("one three"));
+  edited.insert(4, "tw");
+  edited.insert(6, "o ");
+  ASSERT_GT(edited.pieceCount(), whole.pieceCount());
+  EXPECT_TRUE(whole.sameText(edited));
+  EXPECT_TRUE(edited.sameText(whole));
+  edited.erase(0, 1);
+  edited.insert(0, "O");
+  EXPECT_FALSE(whole.sameText(edited));
+  EXPECT_FALSE(whole.sameText(PieceTable(std::string("one two thre"))));
+}
+
+} // namespace
+
+// vi: set sw=2 sts=2 ts=2 et:
@@ -0,0 +1,73 @@
+/**
+ * @file reflow_backlog.cpp
+ * @brief Offsets on pages a reflow stopped short of.
+ */
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include <gleditor/page_index.hpp>
+#include <gleditor/reflow_backlog.hpp>
+
+namespace {
+
+using gleditor::PageIndex;
+using gleditor::ReflowBacklog;
+
+/// Four pages of a hundred bytes, thirty bytes typed on the first, and the
+/// reflow out of time after two new pages of 120 and 100 bytes. The second old
+/// page, which now starts at 130, is the first the reflow has not reached.
+struct HalfReflowed {
+  PageIndex index;
+  ReflowBacklog backlog{.firstStale = 2, .skew = 130 - 220};
+
+  HalfReflowed() {
+    for (const std::uint32_t span : {120, 100, 100, 100, 100}) {
+      index.push_back(span);
+    }
+  }
+};
+
+TEST(ReflowBacklogTest, newPagesStartWhereTheIndexSays) {
+  const HalfReflowed doc;
+  EXPECT_EQ(doc.backlog.startOf(doc.index, 0), 0U);
+  EXPECT_EQ(doc.backlog.startOf(doc.index, 1), 120U);
+  EXPECT_EQ(doc.backlog.resumeAt(doc.index), 220U);
+}
+
+TEST(ReflowBacklogTest, oldPagesStartWhereTheyMovedTo) {
+  const HalfReflowed doc;
+  EXPECT_EQ(doc.backlog.startOf(doc.index, 2), 130U);
+  EXPECT_EQ(doc.backlog.startOf(doc.index, 3), 230U);
+  // The end of the last page is the end of the text.
+  EXPECT_EQ(doc.backlog.startOf(doc.index, 5), 430U);
+  EXPECT_EQ(doc.backlog.pagesLeft(doc.index), 3U);
+}
+
+TEST(ReflowBacklogTest, textOnBothBelongsToTheNewPage) {
+  const HalfReflowed doc;
+  EXPECT_EQ(doc.backlog.pageAt(doc.index, 100), 0U);
+  EXPECT_EQ(doc.backlog.pageAt(doc.index, 150), 1U);
+  EXPECT_EQ(doc.backlog.pageAt(doc.index, 219), 1U);
+}
+
+TEST(ReflowBacklogTest, pastTheNewPagesOffsetsFindTheOldOnes) {
+  const HalfReflowed doc;
+  EXPECT_EQ(doc.backlog.pageAt(doc.index, 220), 2U);
+  EXPECT_EQ(doc.backlog.pageAt(doc.index, 229), 2U);
+  EXPECT_EQ(doc.backlog.pageAt(doc.index, 230), 3U);
+  EXPECT_EQ(doc.backlog.pageAt(doc.index, 429), 4U);
+}
+
+TEST(ReflowBacklogTest, withoutASkewItIsTheIndex) {
+  const HalfReflowed doc;
+  const ReflowBacklog caughtUp{.firstStale = 2};
+  for (const std::uint64_t offset : {0, 119, 120, 220, 321, 519}) {
+    EXPECT_EQ(caughtUp.pageAt(doc.index, offset), doc.index.pageAt(offset));
+  }
+}
+
+} // namespace
+
+// vi: set sw=2 sts=2 ts=2 et:
@@ -0,0 +1,85 @@
+/**
+ * @file residency.cpp
+ * @brief Which pages give their geometry back when over budget.
+ */
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <vector>
+
+#include <gleditor/residency.hpp>
+
+namespace {
+
+using gleditor::PageResidency;
+
+/// A residency @p frames frames in.
+PageResidency residencyAt(const std::size_t budget, const std::uint64_t frames,
+                          const std::uint64_t grace = 10) {
+  PageResidency residency(budget, grace);
+  for (std::uint64_t i = 0; i < frames; i++) {
+    residency.beginFrame();
+  }
+  return residency;
+}
+
+TEST(ResidencyTest, withinBudgetNothingIsEvicted) {
+  auto residency = residencyAt(1000, 100);
+  const std::vector<PageResidency::Candidate> pages{{400, 0}, {400, 0}};
+  EXPECT_TRUE(residency.chooseEvictions(pages, 800).empty());
+  EXPECT_EQ(residency.stats().evictions, 0U);
+}
+
+TEST(ResidencyTest, noBudgetIsNoLimit) {
+  auto residency = residencyAt(0, 100);
+  EXPECT_FALSE(residency.overBudget(std::size_t{1} << 40));
+  const std::vector<PageResidency::Candidate> pages{{400, 0}};
+  EXPECT_TRUE(residency.chooseEvictions(pages, std::size_t{1} << 40).empty());
+}
+
+TEST(ResidencyTest, leastRecentlySeenGoesFirstAndOnlyAsFarAsTheBudget) {
+  auto residency = residencyAt(1000, 100);
+  const std::vector<PageResidency::Candidate> pages{
+      {300, 50}, {300, 10}, {300, 30}, {300, 20}};
+  // 1200 bytes against 1000: one page is enough, and it is the one out of
+  // view the longest.
+  EXPECT_EQ(residency.chooseEvictions(pages, 1200),
+            (std::vector<std::size_t>{1}));
+  EXPECT_EQ(residency.chooseEvictions(pages, 1700),
+            (std::vector<std::size_t>{1, 3, 2}));
+  EXPECT_EQ(residency.stats().evictions, 4U);
+}
+
+TEST(ResidencyTest, pagesSeenWithinTheGracePeriodStay) {
+  auto residency = residencyAt(100, 100, 10);
+  // Seen five frames ago, and a moment ago: neither has been away long enough,
+  // so the budget is overrun rather than met by evicting what is about to be
+  // drawn again.
+  const std::vector<PageResidency::Candidate> pages{{300, 95}, {300, 100}};
+  EXPECT_TRUE(residency.chooseEvictions(pages, 600).empty());
+  const std::vector<PageResidency::Candidate> older{{300, 90}, {300, 100}};
+  EXPECT_EQ(residency.chooseEvictions(older, 600),
+            (std::vector<std::size_t>{0}));
+}
+
+TEST(ResidencyTest, tiesGoToTheEarlierPage) {
+  auto residency = residencyAt(100, 100);
+  const std::vector<PageResidency::Candidate> pages{
+      {50, 0}, {50, 0}, {50, 0}, {50, 0}};
+  EXPECT_EQ(residency.chooseEvictions(pages, 200),
+            (std::vector<std::size_t>{0, 1}));
+}
+
+TEST(ResidencyTest, drawsAndRestoresAreCounted) {
+  PageResidency residency(100);
+  residency.recordDraws(7, 2);
+  residency.recordDraws(3, 0);
+  residency.recordRestore();
+  EXPECT_EQ(residency.stats().hits, 10U);
+  EXPECT_EQ(residency.stats().misses, 2U);
+  EXPECT_EQ(residency.stats().restores, 1U);
+}
+
+} // namespace
+
+// vi: set sw=2 sts=2 ts=2 et:
@@ -0,0 +1,174 @@
+/**
+ * @file save_file.cpp
+ * @brief Writing a snapshot of the text, whole or from where it changed.
+ */
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <utility>
+
+#include <gleditor/piece_table.hpp>
+#include <gleditor/save_file.hpp>
+#include <gleditor/text_source.hpp>
+
+namespace {
+
+using gleditor::PieceTable;
+using gleditor::SaveMethod;
+using gleditor::SaveRequest;
+
+/// A save that may only replace.
+SaveRequest onlyTo(const std::filesystem::path &path) {
+  SaveRequest request;
+  request.path = path;
+  return request;
+}
+
+class SaveFileTest : public ::testing::Test {
+protected:
+  std::filesystem::path dir;
+  std::filesystem::path file;
+
+  void SetUp() override {
+    dir = std::filesystem::temp_directory_path() /
+          ("gleditor-save-" + std::string(::testing::UnitTest::GetInstance()
+                                              ->current_test_info()
+                                              ->name()));
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    file = dir / "doc.txt";
+  }
+
+  void TearDown() override { std::filesystem::remove_all(dir); }
+
+  void put(const std::string &bytes) const {
+    std::ofstream(file, std::ios::binary) << bytes;
+  }
+
+  [[nodiscard]] std::string onDisk() const {
+    std::ifstream in(file, std::ios::binary);
+    return {std::istreambuf_iterator<char>(in), {}};
+  }
+
+  [[nodiscard]] std::size_t filesInDir() const {
+    return static_cast<std::size_t>(
+        std::distance(std::filesystem::directory_iterator(dir), {}));
+  }
+};
+
+TEST_F(SaveFileTest, aReplaceWritesTheWholeTextAndLeavesNothingBehind) {
+  put("old text");
+  PieceTable table(std::string("new"));
+  table.insert(3, " text, longer");
+  const auto outcome = gleditor::saveText(table.snapshot(), onlyTo(file));
+  ASSERT_TRUE(outcome.ok()) << outcome.error;
+  EXPECT_EQ(outcome.method, SaveMethod::replace);
+  EXPECT_EQ(outcome.written, 16U);
+  EXPECT_EQ(onDisk(), "new text, longer");
+  EXPECT_EQ(outcome.stamp, gleditor::stampOf(file));
+  EXPECT_EQ(filesInDir(), 1U);
+}
+
+TEST_F(SaveFileTest, theTailIsWrittenAndTheHeadLeftAlone) {
+  put("hello world");
+  const auto stamp = gleditor::stampOf(file);
+  // The head changed behind the stamp's back, which only a write that never
+  // touched it would leave in place.
+  put("HELLO world");
+  std::filesystem::last_write_time(file, stamp->modified);
+
+  PieceTable table(std::string("hello world"));
+  table.erase(6, 5);
+  table.insert(6, "there!");
+  const auto outcome = gleditor::saveText(
+      table.snapshot(),
+      {.path = file, .unchanged = 6, .expected = stamp, .inPlace = true});
+  ASSERT_TRUE(outcome.ok()) << outcome.error;
+  EXPECT_EQ(outcome.method, SaveMethod::tail);
+  EXPECT_EQ(outcome.written, 6U);
+  EXPECT_EQ(onDisk(), "HELLO there!");
+}
+
+TEST_F(SaveFileTest, aShorterTailTruncatesTheFile) {
+  put("keep this, drop the rest");
+  PieceTable table(std::string("keep this"));
+  const SaveRequest request{.path      = file,
+                            .unchanged = 9,
+                            .expected  = gleditor::stampOf(file),
+                            .inPlace   = true};
+  const auto outcome = gleditor::saveText(table.snapshot(), request);
+  ASSERT_TRUE(outcome.ok()) << outcome.error;
+  EXPECT_EQ(outcome.method, SaveMethod::tail);
+  EXPECT_EQ(onDisk(), "keep this");
+}
+
+TEST_F(SaveFileTest, aFileChangedSinceIsReplacedWhole) {
+  put("hello world");
+  const auto stamp = gleditor::stampOf(file);
+  put("somebody else's longer text");
+  PieceTable table(std::string("hello there"));
+  const auto outcome = gleditor::saveText(
+      table.snapshot(),
+      {.path = file, .unchanged = 6, .expected = stamp, .inPlace = true});
+  ASSERT_TRUE(outcome.ok()) << outcome.error;
+  EXPECT_EQ(outcome.method, SaveMethod::replace);
+  EXPECT_EQ(onDisk(), "hello there");
+}
+
+// A document opened from disk reads its unedited text out of a mapping of the
+// file. Rewriting the tail under it would shift that text by whatever was
+// inserted -- "ABCDEF" with an X at 2 would come back as "ABXXCDE" -- so the
+// first save replaces, and only once the mapping is on the file it replaced
+// can the next one rewrite in place.
+TEST_F(SaveFileTest, aMappedFileIsReplacedBeforeItIsRewritten) {
+  put("ABCDEF");
+  // Long unwritten, or the source reads it rather than mapping it.
+  std::filesystem::last_write_time(
+      file,
+      std::filesystem::file_time_type::clock::now() - std::chrono::hours(1));
+  const gleditor::FileTextSource source(
+      file.string(), gleditor::FileTextSource::Access::map);
+  auto shared = source.share();
+  ASSERT_TRUE(shared.has_value());
+  PieceTable table(shared->bytes, std::move(shared->owner));
+  table.insert(2, "X");
+
+  const auto first = gleditor::saveText(table.snapshot(),
+                                        {.path      = file,
+                                         .unchanged = 2,
+                                         .expected  = gleditor::stampOf(file),
+                                         .inPlace   = true,
+                                         .mapsFile  = true});
+  ASSERT_TRUE(first.ok()) << first.error;
+  EXPECT_EQ(first.method, SaveMethod::replace);
+  EXPECT_EQ(onDisk(), "ABXCDEF");
+  EXPECT_EQ(table.str(), "ABXCDEF");
+
+  table.insert(5, "Y");
+  const auto second = gleditor::saveText(table.snapshot(),
+                                         {.path      = file,
+                                          .unchanged = 5,
+                                          .expected  = first.stamp,
+                                          .inPlace   = true,
+                                          .mapsFile  = false});
+  ASSERT_TRUE(second.ok()) << second.error;
+  EXPECT_EQ(second.method, SaveMethod::tail);
+  EXPECT_EQ(onDisk(), "ABXCDYEF");
+  EXPECT_EQ(table.str(), "ABXCDYEF");
+}
+
+TEST_F(SaveFileTest, aFailedSaveSaysWhy) {
+  PieceTable table(std::string("text"));
+  const auto outcome =
+      gleditor::saveText(table.snapshot(), onlyTo(dir / "no" / "such.txt"));
+  EXPECT_FALSE(outcome.ok());
+  EXPECT_NE(outcome.error.find("such.txt"), std::string::npos);
+}
+
+} // namespace
+
+// vi: set sw=2 sts=2 ts=2 et:
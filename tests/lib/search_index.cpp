@@ -0,0 +1,338 @@
+/**
+ * @file search_index.cpp
+ * @brief Hits of a pattern, checked after every edit against searching the
+ *        whole text again.
+ *
+ * The index is only worth having if what it keeps up to date agrees with what
+ * a search from scratch would find; each test that edits ends by asking.
+ */
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <gleditor/piece_table.hpp>
+#include <gleditor/search_index.hpp>
+#include <gleditor/utf8.hpp>
+
+namespace {
+
+using gleditor::findLiteral;
+using gleditor::PieceTable;
+using gleditor::SearchHit;
+using gleditor::SearchHits;
+using gleditor::SearchIndex;
+using gleditor::SearchPattern;
+using gleditor::Utf8Kernel;
+
+/// What searching all of @p text for @p pattern finds.
+std::vector<SearchHit> everyHit(const PieceTable &text,
+                                const SearchPattern &pattern) {
+  std::vector<SearchHit> hits;
+  pattern.find(text.str(), 0, hits);
+  return hits;
+}
+
+/// Words and newlines, some of them the word being looked for.
+std::string prose(const std::size_t words, const unsigned seed) {
+  static constexpr std::string_view vocabulary[] = {
+      "ant", "bee", "antenna", "cat", "pant", "\n", "an", "t", "dog", "\n\n"};
+  std::mt19937 random(seed);
+  std::string text;
+  for (std::size_t i = 0; i < words; i++) {
+    text += vocabulary[random() % std::size(vocabulary)];
+    text += ' ';
+  }
+  return text;
+}
+
+/// Type, delete and paste at random places, checking after each.
+void editAndCompare(const SearchPattern &pattern, const unsigned seed) {
+  PieceTable text(prose(2000, seed));
+  SearchIndex index;
+  index.start(text, pattern);
+  index.finish();
+  std::mt19937 random(seed);
+  for (int step = 0; step < 300; step++) {
+    const auto at = static_cast<std::uint32_t>(random() % (text.size() + 1));
+    if (0 == random() % 2) {
+      const std::string typed = 0 == random() % 3 ? "ant\n" : "an";
+      text.insert(at, typed);
+      index.inserted(text, at, static_cast<std::uint32_t>(typed.size()));
+    } else {
+      const auto bytes = std::min<std::uint32_t>(
+          static_cast<std::uint32_t>(text.size()) - at, random() % 12);
+      text.erase(at, bytes);
+      index.erased(text, at, bytes);
+    }
+    ASSERT_EQ(index.hits().all(), everyHit(text, pattern)) << "step " << step;
+  }
+}
+
+class FindLiteralTest : public ::testing::TestWithParam<Utf8Kernel> {};
+
+TEST_P(FindLiteralTest, agreesWithTheStandardLibrary) {
+  std::mt19937 random(7);
+  std::string haystack;
+  // A small alphabet, so that the first and last bytes agree often and the
+  // middle has to be compared.
+  for (int i = 0; i < 5000; i++) {
+    haystack += static_cast<char>('a' + (random() % 3));
+  }
+  for (const std::string needle :
+       {"ab", "abc", "aab", "cbacba", "abcabcabcabcab",
+        "abcabcabcabcabcabcabcabcabcabcabcabca"}) {
+    for (std::size_t from = 0; from < haystack.size(); from++) {
+      const auto wanted = std::string_view(haystack).find(needle, from);
+      ASSERT_EQ(findLiteral(haystack, needle, from, GetParam()), wanted)
+          << needle << " from " << from;
+      if (std::string_view::npos == wanted) {
+        break;
+      }
+      from = wanted;
+    }
+  }
+}
+
+TEST_P(FindLiteralTest, aMatchEndingAtTheLastByteIsFound) {
+  for (std::size_t length = 60; length < 140; length++) {
+    const auto haystack = std::string(length, 'x') + "needle";
+    EXPECT_EQ(findLiteral(haystack, "needle", 0, GetParam()), length);
+    EXPECT_EQ(findLiteral(haystack, "needles", 0, GetParam()),
+              std::string_view::npos);
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    Kernels, FindLiteralTest, ::testing::ValuesIn(gleditor::utf8Kernels()),
+    [](const ::testing::TestParamInfo<Utf8Kernel> &info) {
+      return std::string(gleditor::nameOf(info.param));
+    });
+
+TEST(SearchPatternTest, aLiteralIsFoundOverlappingItself) {
+  std::vector<SearchHit> hits;
+  SearchPattern::literal("aa").find("aaaa", 10, hits);
+  EXPECT_EQ(hits, (std::vector<SearchHit>{{10, 12}, {11, 13}, {12, 14}}));
+}
+
+TEST(SearchPatternTest, anExpressionIsMatchedALineAtATime) {
+  std::vector<SearchHit> hits;
+  const auto pattern = SearchPattern::expression("^a.*$");
+  pattern.find("ab\nxa\nac", 0, hits);
+  // Not across the newline, and anchored to each line rather than the run.
+  EXPECT_EQ(hits, (std::vector<SearchHit>{{0, 2}, {6, 8}}));
+}
+
+TEST(SearchPatternTest, anEmptyMatchIsNotAHit) {
+  std::vector<SearchHit> hits;
+  SearchPattern::expression("x*").find("abxxc", 0, hits);
+  EXPECT_EQ(hits, (std::vector<SearchHit>{{2, 4}}));
+}
+
+TEST(SearchPatternTest, aLongLineIsMatchedAWindowAtATime) {
+  // Matched whole, this recurses once a byte inside std::regex and ends the
+  // process long before the end of the line. Matched in windows, it is longer
+  // than any of them and is not found.
+  const std::string line = "a" + std::string(60000, 'b') + "z";
+  std::vector<SearchHit> hits;
+  SearchPattern::expression("a.*z").find(line, 0, hits);
+  EXPECT_TRUE(hits.empty());
+
+  // Matches straddling every cut between windows are found once each.
+  std::string repeated;
+  for (int i = 0; i < 20000; i++) {
+    repeated += "abbbc";
+  }
+  hits.clear();
+  SearchPattern::expression("b+c").find(repeated, 7, hits);
+  ASSERT_EQ(hits.size(), 20000U);
+  for (std::uint32_t i = 0; i < hits.size(); i++) {
+    EXPECT_EQ(hits[i], (SearchHit{7 + (i * 5) + 1, 7 + (i * 5) + 5}));
+  }
+}
+
+TEST(SearchPatternTest, aLongLineIsAnchoredToItsEndsNotItsWindows) {
+  const std::string line(SearchPattern::expressionWindow * 5, 'a');
+  const auto size = static_cast<std::uint32_t>(line.size());
+  std::vector<SearchHit> hits;
+  SearchPattern::expression("^a").find(line, 0, hits);
+  EXPECT_EQ(hits, (std::vector<SearchHit>{{0, 1}}));
+  hits.clear();
+  SearchPattern::expression("a$").find(line, 0, hits);
+  EXPECT_EQ(hits, (std::vector<SearchHit>{{size - 1, size}}));
+  hits.clear();
+  SearchPattern::expression("\\ba|a\\b").find(line, 0, hits);
+  EXPECT_EQ(hits, (std::vector<SearchHit>{{0, 1}, {size - 1, size}}));
+}
+
+TEST(SearchHitsTest, hitsFoundOutOfOrderAreKeptInOrder) {
+  SearchHits hits;
+  hits.add(std::vector<SearchHit>{{10, 12}, {30, 32}});
+  hits.add(std::vector<SearchHit>{{0, 2}, {20, 22}, {40, 42}});
+  EXPECT_EQ(hits.all(), (std::vector<SearchHit>{
+                            {0, 2}, {10, 12}, {20, 22}, {30, 32}, {40, 42}}));
+  EXPECT_EQ(hits.size(), 5U);
+}
+
+TEST(SearchHitsTest, anEditMovesWhatIsAfterItAndDropsWhatItCut) {
+  SearchHits hits;
+  hits.add(std::vector<SearchHit>{{0, 3}, {5, 8}, {10, 13}});
+  // Four bytes inserted inside the second hit.
+  hits.edit(6, 0, 4);
+  EXPECT_EQ(hits.all(), (std::vector<SearchHit>{{0, 3}, {14, 17}}));
+  // Two removed from just before the last.
+  hits.edit(12, 2, 0);
+  EXPECT_EQ(hits.all(), (std::vector<SearchHit>{{0, 3}, {12, 15}}));
+}
+
+TEST(SearchHitsTest, aLongListIsMovedABlockAtATime) {
+  SearchHits hits;
+  std::vector<SearchHit> many;
+  for (std::uint32_t i = 0; i < 100000; i++) {
+    many.push_back(SearchHit{i * 10, (i * 10) + 3});
+  }
+  hits.add(many);
+  EXPECT_GT(hits.blockCount(), 50U);
+  hits.edit(5, 0, 7);
+  // Between the second hit and the third, after the first edit.
+  hits.edit(21, 2, 0);
+  for (auto &hit : many) {
+    if (hit.start >= 5) {
+      hit.start += 7;
+      hit.end += 7;
+    }
+  }
+  for (auto &hit : many) {
+    if (hit.start >= 23) {
+      hit.start -= 2;
+      hit.end -= 2;
+    }
+  }
+  EXPECT_EQ(hits.all(), many);
+  EXPECT_EQ(hits.size(), many.size());
+}
+
+TEST(SearchHitsTest, neighboursAreFoundEitherSideOfAnOffset) {
+  SearchHits hits;
+  std::vector<SearchHit> many;
+  for (std::uint32_t i = 0; i < 5000; i++) {
+    many.push_back(SearchHit{i * 4, (i * 4) + 2});
+  }
+  hits.add(many);
+  hits.edit(0, 0, 1);
+  EXPECT_EQ(hits.firstFrom(8001), (SearchHit{8001, 8003}));
+  EXPECT_EQ(hits.firstFrom(8002), (SearchHit{8005, 8007}));
+  EXPECT_EQ(hits.lastBefore(8001), (SearchHit{7997, 7999}));
+  EXPECT_FALSE(hits.lastBefore(1).has_value());
+  EXPECT_FALSE(hits.firstFrom(20000).has_value());
+  EXPECT_EQ(hits.last(), (SearchHit{19997, 19999}));
+
+  std::vector<SearchHit> shown;
+  hits.within(98, 110, 64, shown);
+  EXPECT_EQ(shown, (std::vector<SearchHit>{{97, 99}, {101, 103},
+                                           {105, 107}, {109, 111}}));
+  shown.clear();
+  hits.within(0, 20000, 3, shown);
+  EXPECT_EQ(shown.size(), 3U);
+}
+
+TEST(SearchIndexTest, findsWhatSearchingEverythingFinds) {
+  // Longer than a chunk, so the scanning thread hands it back in parts.
+  const PieceTable text(prose(600000, 3));
+  ASSERT_GT(text.size(), SearchIndex::chunkBytes);
+  for (const auto &pattern : {SearchPattern::literal("ant"),
+                              SearchPattern::expression("^an[a-z]*")}) {
+    SearchIndex index;
+    index.start(text, pattern);
+    index.finish();
+    EXPECT_FALSE(index.scanning());
+    EXPECT_EQ(index.hits().all(), everyHit(text, pattern)) << pattern.source();
+  }
+}
+
+TEST(SearchIndexTest, aLiteralIsKeptTrueThroughEdits) {
+  editAndCompare(SearchPattern::literal("ant"), 11);
+}
+
+TEST(SearchIndexTest, anExpressionIsKeptTrueThroughEdits) {
+  editAndCompare(SearchPattern::expression("an+t?|^t"), 12);
+}
+
+TEST(SearchIndexTest, editsWhileTheTextIsStillBeingSearchedAreFollowed) {
+  PieceTable text(prose(800000, 5));
+  const auto pattern = SearchPattern::literal("ant");
+  SearchIndex index;
+  index.start(text, pattern);
+  // Before anything has been collected: every hit the scan finds is of the
+  // text as it was, and has to be moved through these to be right.
+  std::mt19937 random(5);
+  for (int step = 0; step < 100; step++) {
+    const auto at = static_cast<std::uint32_t>(random() % text.size());
+    if (0 == step % 2) {
+      text.insert(at, "pants");
+      index.inserted(text, at, 5);
+    } else {
+      text.erase(at, 3);
+      index.erased(text, at, 3);
+    }
+    index.collect(1000);
+  }
+  index.finish();
+  EXPECT_EQ(index.hits().all(), everyHit(text, pattern));
+}
+
+TEST(SearchIndexTest, aLargePasteIsSearchedOffThread) {
+  PieceTable text("pant\n");
+  const auto pattern = SearchPattern::expression("a+n");
+  SearchIndex index;
+  index.start(text, pattern);
+  index.finish();
+  const auto paste = prose(100000, 9);
+  ASSERT_GT(paste.size(), SearchIndex::inlineBytes);
+  text.insert(2, paste);
+  index.inserted(text, 2, static_cast<std::uint32_t>(paste.size()));
+  EXPECT_TRUE(index.scanning());
+  index.finish();
+  EXPECT_FALSE(index.scanning());
+  EXPECT_EQ(index.hits().all(), everyHit(text, pattern));
+}
+
+TEST(SearchIndexTest, anEditToALongLineIsSearchedAgainWithoutCrashing) {
+  // Short enough to be searched again at once, on the thread editing it.
+  std::string line;
+  for (int i = 0; i < 12000; i++) {
+    line += "pant ";
+  }
+  ASSERT_LT(line.size(), SearchIndex::inlineBytes);
+  PieceTable text("x\n" + line + "\ny");
+  const auto pattern = SearchPattern::expression("p.*t|a+n");
+  SearchIndex index;
+  index.start(text, pattern);
+  index.finish();
+  EXPECT_EQ(index.hits().all(), everyHit(text, pattern));
+  text.insert(30000, "paan");
+  index.inserted(text, 30000, 4);
+  EXPECT_FALSE(index.scanning());
+  EXPECT_EQ(index.hits().all(), everyHit(text, pattern));
+}
+
+TEST(SearchIndexTest, stoppingForgetsTheSearch) {
+  PieceTable text(prose(300000, 4));
+  SearchIndex index;
+  index.start(text, SearchPattern::literal("ant"));
+  index.stop();
+  index.finish();
+  EXPECT_TRUE(index.hits().empty());
+  EXPECT_EQ(nullptr, index.pattern());
+  text.insert(0, "ant");
+  index.inserted(text, 0, 3);
+  EXPECT_TRUE(index.hits().empty());
+}
+
+} // namespace
+
+// vi: set sw=2 sts=2 ts=2 et:
@@ -5,13 +5,21 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
 #include <stdexcept>
 #include <string>
 
+#include <glibmm/fileutils.h>
+
 #include <gleditor/text_source.hpp>
 
 namespace {
 
+using gleditor::byteOrderMarkLength;
+using gleditor::FileTextSource;
 using gleditor::MemoryTextSource;
 using gleditor::stripByteOrderMark;
 
@@ -73,6 +81,94 @@ TEST(ByteOrderMarkTest, aLittleEndianUtf32MarkIsNotReportedAsUtf16) {
   }
 }
 
+TEST(ByteOrderMarkTest, theLengthIsWhatStrippingWouldRemove) {
+  EXPECT_EQ(byteOrderMarkLength(bytes({0xEF, 0xBB, 0xBF, 'h'})), 3U);
+  EXPECT_EQ(byteOrderMarkLength("hello"), 0U);
+  EXPECT_THROW((void)byteOrderMarkLength(bytes({0xFF, 0xFE, 'h', 0x00})),
+               std::logic_error);
+}
+
+/// A file holding @p contents, removed again when the test is done with it.
+class FileTextSourceTest : public testing::Test {
+protected:
+  void TearDown() override { std::filesystem::remove(path); }
+
+  void write(const std::string &contents) const {
+    std::ofstream(path, std::ios::binary) << contents;
+  }
+
+  /// Make the file look long unwritten, as one has to be to be mapped.
+  void settle() const {
+    std::filesystem::last_write_time(
+        path, std::filesystem::file_time_type::clock::now() -
+                  std::chrono::hours(1));
+  }
+
+  /// One per test, so that tests run in parallel do not share a file.
+  const std::string path =
+      (std::filesystem::temp_directory_path() /
+       (std::string("gleditor-text-source-") +
+        testing::UnitTest::GetInstance()->current_test_info()->name()))
+          .string();
+};
+
+TEST_F(FileTextSourceTest, aReadFileIsNotLent) {
+  write(bytes({0xEF, 0xBB, 0xBF, 'h', 'i'}));
+  const FileTextSource source(path);
+  EXPECT_FALSE(source.share().has_value());
+  EXPECT_EQ(source.text(), "hi");
+}
+
+TEST_F(FileTextSourceTest, aMappedFileIsLentPastItsMark) {
+  write(bytes({0xEF, 0xBB, 0xBF, 'h', 'i'}));
+  settle();
+  const FileTextSource source(path, FileTextSource::Access::map);
+  const auto shared = source.share();
+  ASSERT_TRUE(shared.has_value());
+  EXPECT_EQ(shared->bytes, "hi");
+  EXPECT_NE(shared->owner, nullptr);
+  EXPECT_EQ(source.text(), "hi");
+}
+
+TEST_F(FileTextSourceTest, theMappingOutlivesTheFile) {
+  // What saving does to a mapped document's file: replaces it. The document
+  // still has the text it opened.
+  write("before");
+  settle();
+  const FileTextSource source(path, FileTextSource::Access::map);
+  const auto shared = source.share();
+  ASSERT_TRUE(shared.has_value());
+  std::filesystem::remove(path);
+  write("after, and longer");
+  EXPECT_EQ(shared->bytes, "before");
+}
+
+TEST_F(FileTextSourceTest, anEmptyMappedFileIsEmptyText) {
+  write("");
+  settle();
+  const FileTextSource source(path, FileTextSource::Access::map);
+  const auto shared = source.share();
+  ASSERT_TRUE(shared.has_value());
+  EXPECT_TRUE(shared->bytes.empty());
+}
+
+TEST_F(FileTextSourceTest, aFileStillBeingWrittenIsLentFromACopy) {
+  // What logrotate's copytruncate does to a log while it is open. Through a
+  // mapping, reading the text after this is SIGBUS.
+  write("a log line\n");
+  const FileTextSource source(path, FileTextSource::Access::map);
+  const auto shared = source.share();
+  ASSERT_TRUE(shared.has_value());
+  std::filesystem::resize_file(path, 0);
+  EXPECT_EQ(shared->bytes, "a log line\n");
+}
+
+TEST_F(FileTextSourceTest, aMissingFileIsAFileErrorEitherWay) {
+  EXPECT_THROW((void)FileTextSource(path).text(), Glib::FileError);
+  EXPECT_THROW((void)FileTextSource(path, FileTextSource::Access::map).share(),
+               Glib::FileError);
+}
+
 TEST(MemoryTextSourceTest, reportsWhatItWasGiven) {
   const MemoryTextSource source("some text", "a name");
   EXPECT_EQ(source.text(), "some text");
@@ -84,6 +180,10 @@ TEST(MemoryTextSourceTest, theNameIsOptional) {
   EXPECT_EQ(source.name(), "");
 }
 
+TEST(MemoryTextSourceTest, hasNothingToLend) {
+  EXPECT_FALSE(MemoryTextSource("some text").share().has_value());
+}
+
 } // namespace
 
 // vi: set sw=2 sts=2 ts=2 et:
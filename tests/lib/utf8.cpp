@@ -5,7 +5,10 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <cstddef>
+#include <random>
 #include <string>
+#include <vector>
 
 #include <gleditor/utf8.hpp>
 
@@ -13,6 +16,10 @@ namespace {
 
 using gleditor::alignToCharacterEnd;
 using gleditor::alignToCharacterStart;
+using gleditor::countCharacters;
+using gleditor::scanUtf8;
+using gleditor::Utf8Kernel;
+using gleditor::validUtf8;
 
 /// "hello" with an e-acute: h, C3 A9, l, l, o. The acute occupies bytes 1 and
 /// 2, so offset 2 is the one that lands inside a character.
@@ -70,6 +77,121 @@ TEST(Utf8Test, aLeadingContinuationByteTerminates) {
   EXPECT_EQ(alignToCharacterEnd(truncated, 0), 1U);
 }
 
+TEST(Utf8ScanTest, validTextIsCountedInCharacters) {
+  const auto scan = scanUtf8(accented + emoji);
+  EXPECT_EQ(scan.valid, accented.size() + emoji.size());
+  EXPECT_EQ(scan.characters, 7U);
+}
+
+TEST(Utf8ScanTest, theFirstBadSequenceIsWhereItStops) {
+  const auto scan = scanUtf8("ab\xC3\xA9\xFF" "cd");
+  EXPECT_EQ(scan.valid, 4U);
+  EXPECT_EQ(scan.characters, 3U);
+}
+
+TEST(Utf8ScanTest, aCharacterTruncatedAtTheEndIsInvalid) {
+  EXPECT_EQ(scanUtf8("ab\xF0\x9F").valid, 2U);
+}
+
+TEST(Utf8ScanTest, aCharacterAcrossAChunkBoundaryIsOneCharacter) {
+  // Validation goes in chunks of a size this does not know, so an accented
+  // character is put across every plausible cut: whichever one the scan
+  // makes, the character either side of it has to come out whole.
+  std::string text;
+  for (std::size_t bytes = 4096; text.size() < 1024 * 1024;) {
+    text.append(bytes - 1 - (text.size() % bytes), 'a');
+    text.append("\xC3\xA9");
+  }
+  const auto scan = scanUtf8(text);
+  EXPECT_EQ(scan.valid, text.size());
+  EXPECT_EQ(scan.characters, text.size() - (text.size() / 4096));
+}
+
+TEST(Utf8ScanTest, aNulByteIsInvalid) {
+  EXPECT_EQ(scanUtf8(std::string("ab\0cd", 5)).valid, 2U);
+}
+
+TEST(Utf8ValidTest, formsThatDecodeButAreNotUtf8AreInvalid) {
+  // Each after a character, so that the offset shows it is the sequence that
+  // is refused and not the text.
+  for (const std::string bad : {
+           "\xC0\x80",         // nul, overlong in two bytes
+           "\xE0\x9F\xBF",     // U+07FF, overlong in three
+           "\xF0\x8F\xBF\xBF", // U+FFFF, overlong in four
+           "\xED\xA0\x80",     // a surrogate
+           "\xF4\x90\x80\x80", // past U+10FFFF
+           "\xF8\x88\x80\x80", // a five-byte lead
+           "\x80",             // a continuation with no lead
+       }) {
+    EXPECT_EQ(validUtf8("a" + bad), 1U) << testing::PrintToString(bad);
+  }
+  EXPECT_EQ(validUtf8("a\xED\x9F\xBF\xF4\x8F\xBF\xBF"), 8U);
+}
+
+/// Characters of every length, at random, with ASCII the most common.
+std::string mixedText(std::mt19937 &random, const std::size_t bytes) {
+  static const std::vector<std::string> pieces{
+      "a", "b", " ", "\n", "\xC3\xA9", "\xD0\x96", "\xE2\x82\xAC",
+      "\xE4\xB8\xAD", "\xEF\xBF\xBD", "\xF0\x9F\x99\x82",
+      "\xF4\x8F\xBF\xBF"};
+  std::discrete_distribution<std::size_t> pick{20, 20, 10, 2, 3, 3,
+                                               3,  3,  1,  2, 1};
+  std::string text;
+  while (text.size() < bytes) {
+    text += pieces[pick(random)];
+  }
+  return text;
+}
+
+class Utf8KernelTest : public ::testing::TestWithParam<Utf8Kernel> {};
+
+TEST_P(Utf8KernelTest, validTextIsAllValidAndCountedAsTheByteLoopCountsIt) {
+  std::mt19937 random(7);
+  for (const std::size_t bytes : {0, 1, 15, 16, 17, 31, 33, 63, 64, 65, 100,
+                                  1000, 4096, 70000}) {
+    const auto text = mixedText(random, bytes);
+    EXPECT_EQ(validUtf8(text, GetParam()), text.size()) << bytes;
+    EXPECT_EQ(countCharacters(text, GetParam()),
+              countCharacters(text, Utf8Kernel::scalar))
+        << bytes;
+  }
+}
+
+TEST_P(Utf8KernelTest, aBadByteIsFoundWhereTheByteLoopFindsIt) {
+  // Every position across a few blocks of each size, so that a bad sequence
+  // falls at the start, middle and end of a block and across the boundary
+  // between two; and every kind of bad byte, so each table entry is reached.
+  std::mt19937 random(11);
+  const auto good = mixedText(random, 200);
+  for (const unsigned char bad : {0x00, 0x80, 0xBF, 0xC0, 0xC2, 0xE0, 0xED,
+                                  0xF0, 0xF4, 0xF5, 0xFF}) {
+    for (std::size_t at = 0; at < good.size(); at++) {
+      auto text = good;
+      text[at]  = static_cast<char>(bad);
+      EXPECT_EQ(validUtf8(text, GetParam()),
+                validUtf8(text, Utf8Kernel::scalar))
+          << "byte " << unsigned{bad} << " at " << at;
+    }
+  }
+}
+
+TEST_P(Utf8KernelTest, aCharacterCutOffAtTheEndIsInvalid) {
+  // The end of the text as a block ending mid-character would see it, at each
+  // length around the sizes the kernels work in.
+  for (std::size_t bytes = 60; bytes < 140; bytes++) {
+    for (const std::string tail : {"\xC3", "\xE2\x82", "\xF0\x9F\x99"}) {
+      const auto text = std::string(bytes, 'x') + tail;
+      EXPECT_EQ(validUtf8(text, GetParam()), bytes) << bytes;
+    }
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    Kernels, Utf8KernelTest, ::testing::ValuesIn(gleditor::utf8Kernels()),
+    [](const ::testing::TestParamInfo<Utf8Kernel> &info) {
+      return std::string(gleditor::nameOf(info.param));
+    });
+
 } // namespace
 
 // vi: set sw=2 sts=2 ts=2 et:
@@ -0,0 +1,238 @@
+/**
+ * @file glyph-lookup-benchmark.cpp
+ * @brief What finding a glyph the cache already holds costs, as the cache
+ *        used to look it up and as it does now.
+ *
+ * Every cluster of every page is looked up in the glyph cache, and once a
+ * document has been open for a page or two nearly every lookup is a hit. The
+ * cache used to find one through a map from the font's address to a key
+ * holding its casefolded description, then a map from the cluster's text to a
+ * map from those keys to the glyph. It now numbers each font once and files
+ * every glyph in one flat table, probed sixteen control bytes at a time (see
+ * glyph_table.hpp). This walks a text the size of the 4.6 MB sample cluster by
+ * cluster both ways, after a first walk has filed every cluster, and counts
+ * hits a second and what each hit allocated.
+ *
+ * The text is a file named as the only argument -- the sample itself, say --
+ * or else 4.6 MB of prose with accented and CJK characters mixed in. Each
+ * character is taken as a cluster, as it is for nearly all of any real
+ * document, in one font, as a document is laid out in.
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <new>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <gleditor/glyphcache/glyph_table.hpp>
+#include <gleditor/utf8.hpp>
+
+namespace {
+
+/// Operator new calls so far, so that a hit which allocates shows. Only new
+/// is replaced: the library's delete already hands its block to free().
+std::atomic<std::size_t> allocations{0};
+
+} // namespace
+
+void *operator new(const std::size_t bytes) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *const block = std::malloc(std::max<std::size_t>(bytes, 1))) {
+    return block;
+  }
+  throw std::bad_alloc();
+}
+
+namespace {
+
+using Clock   = std::chrono::steady_clock;
+using Seconds = std::chrono::duration<double>;
+
+/// Runs of each measurement; the best is reported, as the one least
+/// disturbed by everything else the machine was doing.
+constexpr int runs = 3;
+
+constexpr std::size_t sampleBytes = std::size_t{4600} * 1024;
+constexpr std::size_t maxClusterBytes = 64;
+
+/// What the cache hands out for a glyph: the same 36 bytes as
+/// GlyphCache::Sizes, without Pango to get them from.
+struct Entry {
+  float x{};
+  float y{};
+  float width{};
+  float height{};
+  int pixelWidth{};
+  int pixelHeight{};
+  int layer{};
+  float ink{};
+  std::uint32_t glyph{};
+};
+
+/// The font key the cache used to file glyphs under: the casefolded
+/// description and its hash, worked out once per font.
+struct FontKey {
+  std::string key;
+  std::size_t hash{};
+  bool operator==(const FontKey &oth) const {
+    return hash == oth.hash && key == oth.key;
+  }
+};
+struct FontKeyHash {
+  std::size_t operator()(const FontKey &font) const { return font.hash; }
+};
+struct ClusterHash {
+  using is_transparent = void;
+  std::size_t operator()(const std::string_view chr) const {
+    return std::hash<std::string_view>{}(chr);
+  }
+};
+
+/// The three maps a hit used to go through, recreated.
+struct NestedMaps {
+  std::unordered_map<const void *, FontKey> fontKeys;
+  std::unordered_map<std::string,
+                     std::unordered_map<FontKey, Entry, FontKeyHash>,
+                     ClusterHash, std::equal_to<>>
+      glyphs;
+
+  const Entry *find(const void *font, const std::string_view chr) {
+    const auto &key = fontKeys.at(font);
+    const auto byCluster = glyphs.find(chr);
+    if (byCluster == glyphs.end()) {
+      return nullptr;
+    }
+    const auto byFont = byCluster->second.find(key);
+    return byFont == byCluster->second.end() ? nullptr : &byFont->second;
+  }
+};
+
+std::string generated() {
+  const std::string_view prose =
+      "And God said, Let there be light: and there was light. Caf\xC3\xA9 "
+      "na\xC3\xAFve r\xC3\xA9sum\xC3\xA9, \xE5\x9C\xA8\xE5\x88\x9D\xE4\xB8\x8A"
+      "\xE5\xB8\x9D\xE5\x88\x9B\xE9\x80\xA0\xE5\xA4\xA9\xE5\x9C\xB0. "
+      "The quick brown fox jumps over the lazy dog 0123456789.\n";
+  std::string out;
+  out.reserve(sampleBytes + prose.size());
+  while (out.size() < sampleBytes) {
+    out += prose;
+  }
+  return out;
+}
+
+/// The clusters of @p text in order, one a character, as views of it.
+std::vector<std::string_view> clustersOf(const std::string &text) {
+  std::vector<std::string_view> out;
+  std::size_t start = 0;
+  for (std::size_t i = 1; i <= text.size(); i++) {
+    if (i == text.size() || !gleditor::continuesCharacter(text[i])) {
+      out.emplace_back(text.data() + start, i - start);
+      start = i;
+    }
+  }
+  return out;
+}
+
+struct Measured {
+  double hitsPerSecond{};
+  double allocationsPerHit{};
+};
+
+template <typename Walk>
+Measured measure(const std::size_t hits, const Walk &walk) {
+  Measured best;
+  for (int run = 0; run < runs; run++) {
+    const auto before = allocations.load();
+    const auto start  = Clock::now();
+    walk();
+    const auto seconds = Seconds(Clock::now() - start).count();
+    best.hitsPerSecond =
+        std::max(best.hitsPerSecond, static_cast<double>(hits) / seconds);
+    best.allocationsPerHit = static_cast<double>(allocations.load() - before) /
+                             static_cast<double>(hits);
+  }
+  return best;
+}
+
+void report(const std::string &name, const Measured &measured,
+            const double base) {
+  std::cout << std::left << std::setw(14) << name << std::right
+            << std::setw(14) << std::fixed << std::setprecision(0)
+            << measured.hitsPerSecond << std::setw(10) << std::setprecision(2)
+            << measured.hitsPerSecond / base << "x" << std::setw(14)
+            << std::setprecision(3) << measured.allocationsPerHit << "\n";
+}
+
+} // namespace
+
+int main(const int argc, char **argv) {
+  std::string text;
+  if (argc > 1) {
+    std::ifstream in(argv[1], std::ios::binary);
+    text.assign(std::istreambuf_iterator<char>(in),
+                std::istreambuf_iterator<char>());
+    if (text.empty()) {
+      std::cerr << "nothing to read in " << argv[1] << "\n";
+      return 1;
+    }
+  } else {
+    text = generated();
+  }
+  auto clusters = clustersOf(text);
+  // Longer than the cache takes is refused before it is looked up.
+  std::erase_if(clusters, [](const std::string_view chr) {
+    return chr.size() > maxClusterBytes;
+  });
+
+  // A font object's address, as the old maps were keyed on, and its number.
+  const int font = 0;
+  NestedMaps nested;
+  nested.fontKeys.emplace(&font, FontKey{"dejavu sans 16px",
+                                         std::hash<std::string>{}(
+                                             "dejavu sans 16px")});
+  GlyphTable<Entry, maxClusterBytes> table;
+  for (const auto chr : clusters) {
+    const Entry entry{.pixelWidth = static_cast<int>(chr.size())};
+    nested.glyphs[std::string(chr)].try_emplace(nested.fontKeys.at(&font),
+                                                entry);
+    table.insert(0, chr, entry);
+  }
+
+  std::cout << text.size() << " bytes, " << clusters.size() << " clusters, "
+            << table.size() << " distinct\n"
+            << std::left << std::setw(14) << "lookup" << std::right
+            << std::setw(14) << "hits/s" << std::setw(11) << "speed-up"
+            << std::setw(14) << "allocs/hit\n";
+
+  // Summed so that the lookups cannot be optimised away.
+  std::size_t sum = 0;
+  const auto old  = measure(clusters.size(), [&] {
+    for (const auto chr : clusters) {
+      sum += static_cast<std::size_t>(nested.find(&font, chr)->pixelWidth);
+    }
+  });
+  report("nested maps", old, old.hitsPerSecond);
+  const auto flat = measure(clusters.size(), [&] {
+    for (const auto chr : clusters) {
+      sum += static_cast<std::size_t>(table.find(0, chr)->pixelWidth);
+    }
+  });
+  report("flat table", flat, old.hitsPerSecond);
+
+  std::cout << "\n(checksum " << sum << ")\n";
+  return 0;
+}
+
+// vi: set sw=2 sts=2 ts=2 et:
@@ -0,0 +1,249 @@
+/**
+ * @file glyph-raster-benchmark.cpp
+ * @brief What drawing a page's glyph misses costs, one at a time against a
+ *        batch spread over a pool.
+ *
+ * Opening a document in a script with thousands of distinct clusters -- a
+ * Chinese novel, say -- misses the glyph cache on nearly every cluster of the
+ * first pages. Each miss used to make a measuring surface and context, a
+ * layout on them and a drawing surface and context, and draw on the loader
+ * thread alone. raster.cpp now keeps one of each per thread and the cache
+ * hands a page's misses to a WorkerPool together, each named by the glyph its
+ * page shaped it into so that nothing is laid out again. This draws the same
+ * ideographs four ways: as a miss used to be drawn, recreated here; one at a
+ * time from their text with the kept scratch; one at a time from their
+ * glyphs; and from their glyphs as a batch on pools of increasing size.
+ *
+ * Figures are glyphs a second, the best of a few runs, and the speed-up over
+ * the old way. The number of ideographs, from U+4E00, can be given as the
+ * first argument and the point size as the second. The header says how many
+ * threads the machine has and what font the glyphs came from, without which
+ * the figures cannot be compared with anybody else's: on one core the pool
+ * can only cost, and a font without ideographs measures its fallback.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <cairomm/context.h>
+#include <cairomm/matrix.h>
+#include <cairomm/surface.h>
+#include <pango/pango-layout.h>
+#include <pangomm/context.h>
+#include <pangomm/fontdescription.h>
+#include <pangomm/init.h>
+#include <pangomm/layout.h>
+
+#include <gleditor/glyphcache/raster.hpp>
+#include <gleditor/render/worker_pool.hpp>
+
+namespace {
+
+using Clock   = std::chrono::steady_clock;
+using Seconds = std::chrono::duration<double>;
+
+/// Runs of each measurement; the best is reported, as the one least
+/// disturbed by everything else the machine was doing.
+constexpr int runs = 3;
+
+/// @p count distinct ideographs from U+4E00, each a cluster of its own.
+std::vector<std::string> ideographs(const std::size_t count) {
+  std::vector<std::string> out;
+  for (std::size_t i = 0; i < count; i++) {
+    const auto code = static_cast<unsigned>(0x4E00 + (i % 0x5000));
+    out.push_back({static_cast<char>(0xE0 | (code >> 12)),
+                   static_cast<char>(0x80 | ((code >> 6) & 0x3F)),
+                   static_cast<char>(0x80 | (code & 0x3F))});
+  }
+  return out;
+}
+
+/// A miss as the cache drew it before raster.cpp: everything made for the
+/// one glyph and thrown away after it.
+std::size_t drawAfresh(const std::string &chr,
+                       const Pango::FontDescription &font) {
+  constexpr auto format = Cairo::Surface::Format::ARGB32;
+  const auto layout     = Pango::Layout::create(
+      Cairo::Context::create(Cairo::ImageSurface::create(format, 0, 0)));
+  layout->set_font_description(font);
+  layout->set_text(chr);
+  int width  = 0;
+  int height = 0;
+  layout->get_pixel_size(width, height);
+  if (0 == width || 0 == height) {
+    return 0;
+  }
+  const auto stride =
+      Cairo::ImageSurface::format_stride_for_width(format, width);
+  std::vector<unsigned char> data(static_cast<std::size_t>(height) * stride);
+  const auto surface =
+      Cairo::ImageSurface::create(data.data(), format, width, height, stride);
+  const auto context = Cairo::Context::create(surface);
+  context->set_source_rgba(0, 0, 0, 0);
+  context->rectangle(0, 0, width, height);
+  context->fill();
+  context->transform(Cairo::Matrix(1.0, 0.0, 0.0, -1.0, 0.0, height));
+  context->set_source_rgba(1, 0, 0, 1);
+  context->set_font_options(getFontOptions());
+  layout->show_in_cairo_context(context);
+  surface->flush();
+  std::vector<std::byte> coverage(static_cast<std::size_t>(width) * height);
+  for (int row = 0; row < height; row++) {
+    for (int col = 0; col < width; col++) {
+      coverage[(static_cast<std::size_t>(row) * width) + col] =
+          static_cast<std::byte>(
+              data[(static_cast<std::size_t>(row) * stride) + (col * 4) + 3]);
+    }
+  }
+  return coverage.size();
+}
+
+/**
+ * @brief @p clusters as the shaped keys a page laid out from them asks for,
+ *        and the font those are drawn in.
+ *
+ * Only the glyphs of the first run's font: an ideograph the font lacks is
+ * drawn in another, and that is not what is being measured.
+ */
+std::pair<std::vector<std::string>, RasterFont>
+shapedKeys(const std::vector<std::string> &clusters,
+           const Pango::FontDescription &font) {
+  const auto layout = Pango::Layout::create(Cairo::Context::create(
+      Cairo::ImageSurface::create(Cairo::Surface::Format::ARGB32, 0, 0)));
+  layout->set_font_description(font);
+  std::string all;
+  for (const auto &chr : clusters) {
+    all += chr;
+  }
+  layout->set_text(all);
+
+  std::vector<std::string> keys;
+  std::optional<RasterFont> raster;
+  PangoFont *face = nullptr;
+  auto iter       = layout->get_iter();
+  do {
+    const auto *const run = pango_layout_iter_get_run_readonly(iter.gobj());
+    if (nullptr == run) {
+      continue;
+    }
+    if (nullptr == face) {
+      face   = run->item->analysis.font;
+      raster = rasterFontOf(Glib::wrap(face, true));
+    }
+    if (face != run->item->analysis.font) {
+      continue;
+    }
+    Pango::Rectangle ink;
+    Pango::Rectangle logical;
+    iter.get_run_extents(ink, logical);
+    for (int i = 0; i < run->glyphs->num_glyphs; i++) {
+      const auto &info = run->glyphs->glyphs[i];
+      const ShapedGlyph glyph{info.glyph, info.geometry.x_offset,
+                              info.geometry.y_offset};
+      std::string key;
+      appendShapedKey(key, PANGO_PIXELS_CEIL(info.geometry.width),
+                      PANGO_PIXELS_CEIL(logical.get_height()),
+                      iter.get_baseline() - logical.get_y(),
+                      std::span(&glyph, 1));
+      keys.push_back(std::move(key));
+    }
+  } while (iter.next_run());
+  return {std::move(keys),
+          raster.value_or(RasterFont{.description = font, .face = nullptr})};
+}
+
+template <typename Work>
+double glyphsPerSecond(const std::size_t glyphs, const Work &work) {
+  double best = 0;
+  for (int run = 0; run < runs; run++) {
+    const auto start = Clock::now();
+    work();
+    const auto seconds = Seconds(Clock::now() - start).count();
+    best = std::max(best, static_cast<double>(glyphs) / seconds);
+  }
+  return best;
+}
+
+void report(const std::string &name, const double rate, const double base) {
+  std::cout << std::left << std::setw(16) << name << std::right
+            << std::setw(12) << std::fixed << std::setprecision(0) << rate
+            << std::setw(10) << std::setprecision(2) << rate / base << "x\n";
+}
+
+} // namespace
+
+int main(const int argc, char **argv) {
+  std::size_t count = 2000;
+  int points        = 16;
+  if (argc > 1) {
+    count = std::strtoull(argv[1], nullptr, 10);
+  }
+  if (argc > 2) {
+    points = std::atoi(argv[2]);
+  }
+  Pango::init();
+  const auto clusters = ideographs(count);
+  const Pango::FontDescription font("Sans " + std::to_string(points));
+
+  const auto [keys, face] = shapedKeys(clusters, font);
+  const auto cores        = std::max(1U, std::thread::hardware_concurrency());
+  std::cout << count << " ideographs at " << points << " points, "
+            << keys.size() << " of them from glyphs in "
+            << face.description.to_string() << ", on " << cores
+            << (1 == cores ? " thread\n" : " threads\n")
+            << std::left << std::setw(16) << "path" << std::right
+            << std::setw(12) << "glyphs/s" << std::setw(11) << "speed-up\n";
+
+  const auto afresh = glyphsPerSecond(count, [&] {
+    for (const auto &chr : clusters) {
+      static_cast<void>(drawAfresh(chr, font));
+    }
+  });
+  report("afresh", afresh, afresh);
+
+  const auto serial = glyphsPerSecond(count, [&] {
+    static_cast<void>(rasteriseClusters(
+        clusters, RasterFont{.description = font, .face = nullptr}, nullptr));
+  });
+  report("kept scratch", serial, afresh);
+
+  const auto glyphs = glyphsPerSecond(keys.size(), [&] {
+    static_cast<void>(rasteriseClusters(keys, face, nullptr));
+  });
+  report("from glyphs", glyphs, afresh);
+
+  // Doubling up to the machine's width, and then the width itself: that is the
+  // pool the cache draws on, and on six cores doubling alone stops at four.
+  for (auto threads = std::min(2U, cores);;
+       threads     = std::min(threads * 2, cores)) {
+    render::WorkerPool pool(threads);
+    // The first batch on a pool pays for each worker's scratch; a loader's
+    // pool is kept for the editor's lifetime, so that is not measured.
+    static_cast<void>(rasteriseClusters(keys, face, &pool));
+    const auto pooled = glyphsPerSecond(keys.size(), [&] {
+      static_cast<void>(rasteriseClusters(keys, face, &pool));
+    });
+    report("pool of " + std::to_string(threads), pooled, afresh);
+    if (threads == cores) {
+      break;
+    }
+  }
+
+  std::cout << "\nafresh is how a miss was drawn before. The editor draws a\n"
+               "page's misses from their glyphs, with kept scratch when\n"
+               "there are only a few and on a pool as wide as the machine\n"
+               "otherwise.\n";
+  return 0;
+}
+
+// vi: set sw=2 sts=2 ts=2 et:
@@ -0,0 +1,134 @@
+/**
+ * @file utf8-benchmark.cpp
+ * @brief What validating and counting UTF-8 cost, per kernel, against size.
+ *
+ * Every document is validated and counted when it is opened, and every
+ * cluster of every page is counted again when the page is built. Both used to
+ * go a byte at a time; utf8.cpp now has vector kernels for them, picked by
+ * what the processor can do. This shows what each kernel this machine can run
+ * does, from a megabyte to a gigabyte, so that the choice is seen rather than
+ * assumed.
+ *
+ * Two texts: English prose, which is nearly all ASCII and is what the vector
+ * kernels skip fastest, and a mix in which most characters are two to four
+ * bytes long, which is where the lookup method earns its place over skipping
+ * ASCII. Figures are gigabytes a second, the best of a few runs -- a
+ * throughput, so the number to read is how each column holds up down the
+ * table once the text no longer fits in cache.
+ *
+ * The largest size is a gigabyte of each text, allocated at once; a smaller
+ * limit, in megabytes, can be given as the only argument.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <gleditor/utf8.hpp>
+
+namespace {
+
+using Clock   = std::chrono::steady_clock;
+using Seconds = std::chrono::duration<double>;
+
+constexpr std::size_t megabyte = std::size_t{1024} * 1024;
+
+/// Runs of each measurement; the best is reported, as the one least
+/// disturbed by everything else the machine was doing.
+constexpr int runs = 3;
+
+/// @p pattern repeated to @p bytes, cut back to a character boundary.
+std::string repeated(const std::string_view pattern, const std::size_t bytes) {
+  std::string out;
+  out.reserve(bytes + pattern.size());
+  while (out.size() < bytes) {
+    out += pattern;
+  }
+  out.resize(gleditor::alignToCharacterStart(
+      out, static_cast<std::uint32_t>(std::min(bytes, out.size()))));
+  return out;
+}
+
+std::string proseOf(const std::size_t bytes) {
+  return repeated(
+      "The quick brown fox jumped over the lazy dog, and then considered "
+      "at some length whether the exercise had been worth the trouble.\n",
+      bytes);
+}
+
+std::string mixedOf(const std::size_t bytes) {
+  // Latin with accents, Cyrillic, CJK and an emoji, with the spaces between.
+  return repeated("caf\xC3\xA9 \xD0\x9C\xD0\xBE\xD1\x81\xD0\xBA\xD0\xB2"
+                  "\xD0\xB0 \xE4\xB8\xAD\xE6\x96\x87\xE6\x96\x87\xE5\xAD"
+                  "\x97 \xF0\x9F\x99\x82 na\xC3\xAFve\n",
+                  bytes);
+}
+
+template <typename Work>
+double gigabytesPerSecond(const std::string &text, const Work &work) {
+  double best = 0;
+  for (int run = 0; run < runs; run++) {
+    const auto start = Clock::now();
+    const volatile auto result = work(text);
+    static_cast<void>(result);
+    const auto seconds = Seconds(Clock::now() - start).count();
+    best = std::max(best, static_cast<double>(text.size()) / 1e9 / seconds);
+  }
+  return best;
+}
+
+void measure(const std::string_view name, const std::size_t size,
+             const std::string &text) {
+  std::cout << std::left << std::setw(8) << name << std::setw(8)
+            << size / megabyte;
+  for (const auto kernel : gleditor::utf8Kernels()) {
+    const auto valid = gigabytesPerSecond(text, [kernel](const auto &bytes) {
+      return gleditor::validUtf8(bytes, kernel);
+    });
+    const auto count = gigabytesPerSecond(text, [kernel](const auto &bytes) {
+      return gleditor::countCharacters(bytes, kernel);
+    });
+    std::cout << std::fixed << std::setprecision(2) << std::setw(8) << valid
+              << std::setw(8) << count;
+  }
+  std::cout << "\n";
+}
+
+} // namespace
+
+int main(const int argc, char **argv) {
+  std::size_t limit = 1024 * megabyte;
+  if (argc > 1) {
+    limit = std::strtoull(argv[1], nullptr, 10) * megabyte;
+  }
+
+  std::cout << std::left << std::setw(16) << "GB/s";
+  for (const auto kernel : gleditor::utf8Kernels()) {
+    std::cout << std::setw(16) << gleditor::nameOf(kernel);
+  }
+  std::cout << "\n" << std::setw(8) << "text" << std::setw(8) << "MB";
+  for (std::size_t i = 0; i < gleditor::utf8Kernels().size(); i++) {
+    std::cout << std::setw(8) << "valid" << std::setw(8) << "count";
+  }
+  std::cout << "\n";
+
+  for (std::size_t size = megabyte; size <= limit; size *= 4) {
+    measure("prose", size, proseOf(size));
+    measure("mixed", size, mixedOf(size));
+  }
+
+  std::cout << "\n" << gleditor::nameOf(gleditor::utf8Kernel())
+            << " is what the editor uses on this machine. scalar is the byte\n"
+               "at a time the others replaced. sse2 validates by skipping\n"
+               "ASCII, so on the mixed text it goes no faster than scalar;\n"
+               "the others should be well ahead of it at every size.\n";
+  return 0;
+}
+
+// vi: set sw=2 sts=2 ts=2 et: